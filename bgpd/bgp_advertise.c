@@ -27,6 +27,7 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "thread.h"
 #include "queue.h"
 #include "filter.h"
+#include "jhash.h"
 
 #include "bgpd/bgpd.h"
 #include "bgpd/bgp_table.h"
@@ -188,67 +189,233 @@ bgp_adj_out_lookup (struct peer *peer, struct bgp_node *rn,
 }
 
 
-void
+/* The routes kept from a peer go in the slot of their node or, when it
+   is taken, in the next free one.  Removing one shifts back those after
+   it that would otherwise no longer be found, so that the routes of a
+   node are all found before the next free slot.  */
+#define BGP_ADJ_IN_TABLE_MIN 16
+
+static unsigned int
+bgp_adj_in_slot (struct bgp_adj_in_table *t, struct bgp_node *rn)
+{
+  return jhash_1word ((uintptr_t) rn, 0) & (t->size - 1);
+}
+
+static void
+bgp_adj_in_resize (struct bgp_adj_in_table *t, unsigned int size)
+{
+  struct bgp_adj_in *old = t->entries;
+  unsigned int old_size = t->size;
+  unsigned int i, j;
+
+  t->entries = XCALLOC (MTYPE_BGP_ADJ_IN, size * sizeof (struct bgp_adj_in));
+  t->size = size;
+
+  for (i = 0; i < old_size; i++)
+    if (old[i].rn)
+      {
+	for (j = bgp_adj_in_slot (t, old[i].rn); t->entries[j].rn;
+	     j = (j + 1) & (size - 1))
+	  ;
+	t->entries[j] = old[i];
+      }
+
+  if (old)
+    XFREE (MTYPE_BGP_ADJ_IN, old);
+}
+
+static struct bgp_adj_in *
+bgp_adj_in_used (struct bgp_adj_in_table *t, struct bgp_adj_in *adj)
+{
+  for (; adj < t->entries + t->size; adj++)
+    if (adj->rn)
+      return adj;
+  return NULL;
+}
+
+/* Iterate over all the routes kept from a peer, in no particular order. */
+struct bgp_adj_in *
+bgp_adj_in_first (struct bgp_adj_in_table *t)
+{
+  if (!t)
+    return NULL;
+  return bgp_adj_in_used (t, t->entries);
+}
+
+struct bgp_adj_in *
+bgp_adj_in_next (struct bgp_adj_in_table *t, struct bgp_adj_in *adj)
+{
+  return bgp_adj_in_used (t, adj + 1);
+}
+
+/* Iterate over the routes kept from a peer for a node. */
+struct bgp_adj_in *
+bgp_adj_in_node_first (struct bgp_adj_in_table *t, struct bgp_node *rn)
+{
+  unsigned int i;
+
+  if (!t || !t->size)
+    return NULL;
+
+  for (i = bgp_adj_in_slot (t, rn); t->entries[i].rn;
+       i = (i + 1) & (t->size - 1))
+    if (t->entries[i].rn == rn)
+      return &t->entries[i];
+  return NULL;
+}
+
+struct bgp_adj_in *
+bgp_adj_in_node_next (struct bgp_adj_in_table *t, struct bgp_adj_in *adj)
+{
+  unsigned int i;
+
+  for (i = (adj - t->entries + 1) & (t->size - 1); t->entries[i].rn;
+       i = (i + 1) & (t->size - 1))
+    if (t->entries[i].rn == adj->rn)
+      return &t->entries[i];
+  return NULL;
+}
+
+struct bgp_adj_in *
 bgp_adj_in_set (struct bgp_node *rn, struct peer *peer, struct attr *attr,
                 u_int32_t addpath_id)
 {
+  struct bgp_table *table = bgp_node_table (rn);
+  struct bgp_adj_in_table *t;
   struct bgp_adj_in *adj;
+  unsigned int i;
 
-  for (adj = rn->adj_in; adj; adj = adj->next)
+  t = peer->adj_in[table->afi][table->safi];
+  if (!t)
+    t = peer->adj_in[table->afi][table->safi] =
+      XCALLOC (MTYPE_BGP_ADJ_IN, sizeof (struct bgp_adj_in_table));
+
+  for (adj = bgp_adj_in_node_first (t, rn); adj;
+       adj = bgp_adj_in_node_next (t, adj))
     {
-      if (adj->peer == peer && adj->addpath_rx_id == addpath_id)
+      if (adj->addpath_rx_id == addpath_id)
 	{
 	  if (adj->attr != attr)
 	    {
 	      bgp_attr_unintern (&adj->attr);
 	      adj->attr = bgp_attr_intern (attr);
 	    }
-	  return;
+	  adj->stale = 0;
+	  return adj;
 	}
     }
-  adj = XCALLOC (MTYPE_BGP_ADJ_IN, sizeof (struct bgp_adj_in));
-  adj->peer = peer_lock (peer); /* adj_in peer reference */
+
+  /* Keep a quarter of the slots free, for short probes. */
+  if ((t->count + 1) * 4 > t->size * 3)
+    bgp_adj_in_resize (t, t->size ? t->size * 2 : BGP_ADJ_IN_TABLE_MIN);
+
+  for (i = bgp_adj_in_slot (t, rn); t->entries[i].rn;
+       i = (i + 1) & (t->size - 1))
+    ;
+  adj = &t->entries[i];
+  adj->rn = bgp_lock_node (rn);
   adj->attr = bgp_attr_intern (attr);
   adj->addpath_rx_id = addpath_id;
-  BGP_ADJ_IN_ADD (rn, adj);
-  bgp_lock_node (rn);
+  adj->stale = 0;
+  t->count++;
+  return adj;
 }
 
-void
-bgp_adj_in_remove (struct bgp_node *rn, struct bgp_adj_in *bai)
+static void
+bgp_adj_in_remove (struct bgp_adj_in_table *t, struct bgp_adj_in *adj)
 {
-  bgp_attr_unintern (&bai->attr);
-  BGP_ADJ_IN_DEL (rn, bai);
-  peer_unlock (bai->peer); /* adj_in peer reference */
-  XFREE (MTYPE_BGP_ADJ_IN, bai);
+  unsigned int mask = t->size - 1;
+  unsigned int i, j, k;
+
+  bgp_attr_unintern (&adj->attr);
+  bgp_unlock_node (adj->rn);
+  t->count--;
+
+  /* Fill the hole with the next route that may go there, and so on. */
+  i = adj - t->entries;
+  for (j = (i + 1) & mask; t->entries[j].rn; j = (j + 1) & mask)
+    {
+      k = bgp_adj_in_slot (t, t->entries[j].rn);
+      if (i <= j ? (i < k && k <= j) : (i < k || k <= j))
+	continue;
+      t->entries[i] = t->entries[j];
+      i = j;
+    }
+  memset (&t->entries[i], 0, sizeof (struct bgp_adj_in));
+
+  if (t->size > BGP_ADJ_IN_TABLE_MIN && t->count * 8 < t->size)
+    bgp_adj_in_resize (t, t->size / 2);
 }
 
 int
 bgp_adj_in_unset (struct bgp_node *rn, struct peer *peer,
                   u_int32_t addpath_id)
 {
+  struct bgp_table *table = bgp_node_table (rn);
+  struct bgp_adj_in_table *t;
   struct bgp_adj_in *adj;
-  struct bgp_adj_in *adj_next;
 
-  adj = rn->adj_in;
+  t = peer->adj_in[table->afi][table->safi];
+  for (adj = bgp_adj_in_node_first (t, rn); adj;
+       adj = bgp_adj_in_node_next (t, adj))
+    if (adj->addpath_rx_id == addpath_id)
+      {
+	bgp_adj_in_remove (t, adj);
+	return 1;
+      }
+
+  return 0;
+}
+
+/* Drop all the routes kept from a peer for an afi/safi at once. */
+void
+bgp_adj_in_clear (struct peer *peer, afi_t afi, safi_t safi)
+{
+  struct bgp_adj_in_table *t = peer->adj_in[afi][safi];
+  struct bgp_adj_in *adj;
 
-  if (!adj)
-    return 0;
+  if (!t)
+    return;
 
-  while (adj)
+  for (adj = bgp_adj_in_first (t); adj; adj = bgp_adj_in_next (t, adj))
     {
-      adj_next = adj->next;
+      bgp_attr_unintern (&adj->attr);
+      bgp_unlock_node (adj->rn);
+    }
 
-      if (adj->peer == peer && adj->addpath_rx_id == addpath_id)
-        {
-          bgp_adj_in_remove (rn, adj);
-          bgp_unlock_node (rn);
-        }
+  if (t->entries)
+    XFREE (MTYPE_BGP_ADJ_IN, t->entries);
+  XFREE (MTYPE_BGP_ADJ_IN, peer->adj_in[afi][safi]);
+}
 
-      adj = adj_next;
-    }
+/* Drop the routes kept from a peer that are still stale.  Removing one
+   moves others around, so they are looked up again one by one. */
+void
+bgp_adj_in_clear_stale (struct peer *peer, afi_t afi, safi_t safi)
+{
+  struct bgp_adj_in_table *t = peer->adj_in[afi][safi];
+  struct bgp_adj_in *adj, *stale;
+  unsigned int i, n = 0;
+
+  if (!t)
+    return;
+
+  for (adj = bgp_adj_in_first (t); adj; adj = bgp_adj_in_next (t, adj))
+    if (adj->stale)
+      n++;
+  if (!n)
+    return;
+
+  stale = XMALLOC (MTYPE_TMP, n * sizeof (struct bgp_adj_in));
+  n = 0;
+  for (adj = bgp_adj_in_first (t); adj; adj = bgp_adj_in_next (t, adj))
+    if (adj->stale)
+      stale[n++] = *adj;
+
+  for (i = 0; i < n; i++)
+    bgp_adj_in_unset (stale[i].rn, peer, stale[i].addpath_rx_id);
 
-  return 1;
+  XFREE (MTYPE_TMP, stale);
 }
 
 void
@@ -93,21 +93,31 @@ struct bgp_adj_out
   struct bgp_advertise *adv;
 };
 
-/* BGP adjacency in. */
+/* BGP adjacency in, a route kept as received for soft reconfiguration.
+   The peer is the one whose table it is in.  */
 struct bgp_adj_in
 {
-  /* Linked list pointer.  */
-  struct bgp_adj_in *next;
-  struct bgp_adj_in *prev;
-
-  /* Received peer.  */
-  struct peer *peer;
+  /* Node it is kept on, locked, or NULL for a free slot.  */
+  struct bgp_node *rn;
 
   /* Received attribute.  */
   struct attr *attr;
 
   /* Addpath identifier */
   u_int32_t addpath_rx_id;
+
+  /* Loaded from a checkpoint, and not received again since.  */
+  u_char stale;
+};
+
+/* The routes kept from a peer for an afi/safi, peer->adj_in.  They are
+   stored in one array, open addressed on the node, so that they need no
+   links and the routes of a node sit together.  */
+struct bgp_adj_in_table
+{
+  struct bgp_adj_in *entries;
+  unsigned int size;		/* a power of 2, or 0 */
+  unsigned int count;
 };
 
 /* BGP advertisement list.  */
@@ -138,8 +148,6 @@ struct bgp_synchronize
       (N)->TYPE = (A)->next;                          \
   } while (0)
 
-#define BGP_ADJ_IN_ADD(N,A)    BGP_INFO_ADD(N,A,adj_in)
-#define BGP_ADJ_IN_DEL(N,A)    BGP_INFO_DEL(N,A,adj_in)
 #define BGP_ADJ_OUT_ADD(N,A)   BGP_INFO_ADD(N,A,adj_out)
 #define BGP_ADJ_OUT_DEL(N,A)   BGP_INFO_DEL(N,A,adj_out)
 
@@ -173,9 +181,18 @@ struct bgp_synchronize
 
 /* Prototypes.  */
 extern int bgp_adj_out_lookup (struct peer *, struct bgp_node *, u_int32_t);
-extern void bgp_adj_in_set (struct bgp_node *, struct peer *, struct attr *, u_int32_t);
+extern struct bgp_adj_in *bgp_adj_in_set (struct bgp_node *, struct peer *,
+                                         struct attr *, u_int32_t);
 extern int bgp_adj_in_unset (struct bgp_node *, struct peer *, u_int32_t);
-extern void bgp_adj_in_remove (struct bgp_node *, struct bgp_adj_in *);
+extern struct bgp_adj_in *bgp_adj_in_first (struct bgp_adj_in_table *);
+extern struct bgp_adj_in *bgp_adj_in_next (struct bgp_adj_in_table *,
+                                           struct bgp_adj_in *);
+extern struct bgp_adj_in *bgp_adj_in_node_first (struct bgp_adj_in_table *,
+                                                 struct bgp_node *);
+extern struct bgp_adj_in *bgp_adj_in_node_next (struct bgp_adj_in_table *,
+                                                struct bgp_adj_in *);
+extern void bgp_adj_in_clear (struct peer *, afi_t, safi_t);
+extern void bgp_adj_in_clear_stale (struct peer *, afi_t, safi_t);
 
 extern void bgp_sync_init (struct peer *);
 extern void bgp_sync_delete (struct peer *);
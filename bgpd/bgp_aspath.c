@@ -536,19 +536,10 @@ aspath_make_str_count (struct aspath *as)
   int str_size;
   int len = 0;
   char *str_buf;
-  json_object *jaspath_segments = NULL;
-  json_object *jseg = NULL;
-  json_object *jseg_list = NULL;
-
-  as->json = json_object_new_object();
-  jaspath_segments = json_object_new_array();
 
   /* Empty aspath. */
   if (!as->segments)
     {
-      json_object_string_add(as->json, "string", "Local");
-      json_object_object_add(as->json, "segments", jaspath_segments);
-      json_object_int_add(as->json, "length", 0);
       as->str = XMALLOC (MTYPE_AS_STR, 1);
       as->str[0] = '\0';
       as->str_len = 0;
@@ -591,8 +582,6 @@ aspath_make_str_count (struct aspath *as)
             XFREE (MTYPE_AS_STR, str_buf);
             as->str = NULL;
             as->str_len = 0;
-            json_object_free(as->json);
-            as->json = NULL;
             return;
         }
       
@@ -618,24 +607,15 @@ aspath_make_str_count (struct aspath *as)
         len += snprintf (str_buf + len, str_size - len, 
 			 "%c", 
                          aspath_delimiter_char (seg->type, AS_SEG_START));
-
-      jseg_list = json_object_new_array();
       
       /* write out the ASNs, with their seperators, bar the last one*/
       for (i = 0; i < seg->length; i++)
         {
-          json_object_array_add(jseg_list, json_object_new_int(seg->as[i]));
-
           len += snprintf (str_buf + len, str_size - len, "%u", seg->as[i]);
           
           if (i < (seg->length - 1))
             len += snprintf (str_buf + len, str_size - len, "%c", seperator);
         }
-
-      jseg = json_object_new_object();
-      json_object_string_add(jseg, "type", aspath_segment_type_str[seg->type]);
-      json_object_object_add(jseg, "list", jseg_list);
-      json_object_array_add(jaspath_segments, jseg);
       
       if (seg->type != AS_SEQUENCE)
         len += snprintf (str_buf + len, str_size - len, "%c", 
@@ -651,18 +631,58 @@ aspath_make_str_count (struct aspath *as)
   str_buf[len] = '\0';
   as->str = str_buf;
   as->str_len = len;
+  return;
+}
+
+/* Convert aspath structure to its json object. */
+static void
+aspath_make_json (struct aspath *as)
+{
+  struct assegment *seg;
+  json_object *jaspath_segments = NULL;
+  json_object *jseg = NULL;
+  json_object *jseg_list = NULL;
+  int i;
+
+  as->json = json_object_new_object();
+  jaspath_segments = json_object_new_array();
+
+  /* Empty aspath. */
+  if (!as->segments)
+    {
+      json_object_string_add(as->json, "string", "Local");
+      json_object_object_add(as->json, "segments", jaspath_segments);
+      json_object_int_add(as->json, "length", 0);
+      return;
+    }
+
+  for (seg = as->segments; seg; seg = seg->next)
+    {
+      jseg_list = json_object_new_array();
+      for (i = 0; i < seg->length; i++)
+        json_object_array_add(jseg_list, json_object_new_int(seg->as[i]));
+
+      jseg = json_object_new_object();
+      json_object_string_add(jseg, "type", aspath_segment_type_str[seg->type]);
+      json_object_object_add(jseg, "list", jseg_list);
+      json_object_array_add(jaspath_segments, jseg);
+    }
 
-  json_object_string_add(as->json, "string", str_buf);
+  json_object_string_add(as->json, "string", aspath_print (as));
   json_object_object_add(as->json, "segments", jaspath_segments);
   json_object_int_add(as->json, "length", aspath_count_hops (as));
-  return;
 }
 
+/* The segments changed: drop the string and json forms, they are built
+   again when next asked for, and the access-list results. */
 static void
 aspath_str_update (struct aspath *as)
 {
   if (as->str)
-    XFREE (MTYPE_AS_STR, as->str);
+    {
+      XFREE (MTYPE_AS_STR, as->str);
+      as->str_len = 0;
+    }
 
   if (as->json)
     {
@@ -670,7 +690,7 @@ aspath_str_update (struct aspath *as)
       as->json = NULL;
     }
 
-  aspath_make_str_count (as);
+  memset (as->filter_cache, 0, sizeof (as->filter_cache));
 }
 
 /* Intern allocated AS path. */
@@ -679,10 +699,8 @@ aspath_intern (struct aspath *aspath)
 {
   struct aspath *find;
 
-  /* Assert this AS path structure is not interned and has the string
-     representation built. */
+  /* Assert this AS path structure is not interned. */
   assert (aspath->refcnt == 0);
-  assert (aspath->str);
 
   /* Check AS path hash. */
   find = hash_get (ashash, aspath, hash_alloc_intern);
@@ -729,9 +747,6 @@ aspath_hash_alloc (void *arg)
   const struct aspath *aspath = arg;
   struct aspath *new;
 
-  /* Malformed AS path value. */
-  assert (aspath->str);
-
   /* New aspath structure is needed. */
   new = XMALLOC (MTYPE_AS_PATH, sizeof (struct aspath));
 
@@ -741,6 +756,7 @@ aspath_hash_alloc (void *arg)
   new->str = aspath->str;
   new->str_len = aspath->str_len;
   new->json = aspath->json;
+  memcpy (new->filter_cache, aspath->filter_cache, sizeof (new->filter_cache));
 
   return new;
 }
@@ -875,16 +891,7 @@ aspath_parse (struct stream *s, size_t length, int use32bit)
 
   /* if the aspath was already hashed free temporary memory. */
   if (find->refcnt)
-    {
-      assegment_free_all (as.segments);
-      /* aspath_key_make() always updates the string */
-      XFREE (MTYPE_AS_STR, as.str);
-      if (as.json)
-	{
-	  json_object_free(as.json);
-	  as.json = NULL;
-	}
-    }
+    assegment_free_all (as.segments);
 
   find->refcnt++;
 
@@ -1739,7 +1746,7 @@ aspath_reconcile_as4 ( struct aspath *aspath, struct aspath *as4path)
   
   if ( BGP_DEBUG(as4, AS4))
     zlog_debug("[AS4] got AS_PATH %s and AS4_PATH %s synthesizing now",
-               aspath->str, as4path->str);
+               aspath_print (aspath), aspath_print (as4path));
 
   while (seg && hops > 0)
     {
@@ -1798,7 +1805,7 @@ aspath_reconcile_as4 ( struct aspath *aspath, struct aspath *as4path)
   
   if ( BGP_DEBUG(as4, AS4))
     zlog_debug ("[AS4] result of synthesizing is %s",
-                mergedpath->str);
+                aspath_print (mergedpath));
   
   return mergedpath;
 }
@@ -1927,7 +1934,6 @@ aspath_empty_get (void)
   struct aspath *aspath;
 
   aspath = aspath_new ();
-  aspath_make_str_count (aspath);
   return aspath;
 }
 
@@ -2086,8 +2092,6 @@ aspath_str2aspath (const char *str)
 	}
     }
 
-  aspath_make_str_count (aspath);
-
   return aspath;
 }
 
@@ -2096,12 +2100,14 @@ unsigned int
 aspath_key_make (void *p)
 {
   struct aspath *aspath = (struct aspath *) p;
-  unsigned int key = 0;
-
-  if (!aspath->str)
-    aspath_str_update (aspath);
+  struct assegment *seg;
+  unsigned int key = 2334325;
 
-  key = jhash (aspath->str, aspath->str_len, 2334325);
+  for (seg = aspath->segments; seg; seg = seg->next)
+    {
+      key = jhash_2words (seg->type, seg->length, key);
+      key = jhash2 (seg->as, seg->length, key);
+    }
 
   return key;
 }
@@ -2149,11 +2155,24 @@ aspath_finish (void)
     stream_free (snmp_stream);
 }
 
-/* return and as path value */
+/* return and as path value, building the string the first time */
 const char *
 aspath_print (struct aspath *as)
 {
-  return (as ? as->str : NULL);
+  if (!as)
+    return NULL;
+  if (!as->str)
+    aspath_make_str_count (as);
+  return as->str;
+}
+
+/* return the json form of an as path, building it the first time */
+json_object *
+aspath_get_json (struct aspath *as)
+{
+  if (!as->json)
+    aspath_make_json (as);
+  return as->json;
 }
 
 /* Printing functions */
@@ -2164,7 +2183,7 @@ void
 aspath_print_vty (struct vty *vty, const char *format, struct aspath *as, const char * suffix)
 {
   assert (format);
-  vty_out (vty, format, as->str);
+  vty_out (vty, format, aspath_print (as));
   if (as->str_len && strlen (suffix))
     vty_out (vty, "%s", suffix);
 }
@@ -2177,7 +2196,7 @@ aspath_show_all_iterator (struct hash_backet *backet, struct vty *vty)
   as = (struct aspath *) backet->data;
 
   vty_out (vty, "[%p:%u] (%ld) ", (void *)backet, backet->key, as->refcnt);
-  vty_out (vty, "%s%s", as->str, VTY_NEWLINE);
+  vty_out (vty, "%s%s", aspath_print (as), VTY_NEWLINE);
 }
 
 /* Print all aspath and hash information.  This function is used from
@@ -57,6 +57,9 @@ struct assegment
 };
 
 /* AS path may be include some AsSegments.  */
+/* Number of access-list results remembered per AS path. */
+#define ASPATH_FILTER_CACHE 4
+
 struct aspath 
 {
   /* Reference count to this aspath.  */
@@ -65,13 +68,23 @@ struct aspath
   /* segment data */
   struct assegment *segments;
   
-  /* AS path as a json object */
+  /* AS path as a json object, built on demand by aspath_get_json() */
   json_object *json;
 
   /* String expression of AS path.  This string is used by vty output
-     and AS path regular expression match.  */
+     and AS path regular expression match.  Built on demand by
+     aspath_print(), and dropped when the segments change; hashing and
+     comparison work on the segments.  */
   char *str;
   unsigned short str_len;
+
+  /* Recent results of AS path access-lists on this path, by list
+     generation; see as_list_apply().  Cleared with the string.  */
+  struct
+  {
+    u_int32_t gen;
+    u_char result;
+  } filter_cache[ASPATH_FILTER_CACHE];
 };
 
 #define ASPATH_STR_DEFAULT_LEN 32
@@ -98,6 +111,7 @@ extern void aspath_free (struct aspath *);
 extern struct aspath *aspath_intern (struct aspath *);
 extern void aspath_unintern (struct aspath **);
 extern const char *aspath_print (struct aspath *);
+extern json_object *aspath_get_json (struct aspath *);
 extern void aspath_print_vty (struct vty *, const char *, struct aspath *, const char *);
 extern void aspath_print_all_vty (struct vty *);
 extern unsigned int aspath_key_make (void *);
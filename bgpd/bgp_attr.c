@@ -113,7 +113,7 @@ cluster_hash_alloc (void *p)
 }
 
 /* Cluster list related functions. */
-static struct cluster_list *
+struct cluster_list *
 cluster_parse (struct in_addr * pnt, int length)
 {
   struct cluster_list tmp;
@@ -466,6 +466,22 @@ transit_intern (struct transit *transit)
   return find;
 }
 
+/* An interned transit attribute with a copy of the given value. */
+struct transit *
+transit_parse (u_char *pnt, int length)
+{
+  struct transit *transit;
+
+  transit = XCALLOC (MTYPE_TRANSIT, sizeof (struct transit));
+  transit->length = length;
+  if (length)
+    {
+      transit->val = XMALLOC (MTYPE_TRANSIT_VAL, length);
+      memcpy (transit->val, pnt, length);
+    }
+  return transit_intern (transit);
+}
+
 void
 transit_unintern (struct transit *transit)
 {
@@ -803,12 +819,10 @@ bgp_attr_hash_alloc (void *p)
   return attr;
 }
 
-/* Internet argument attribute. */
-struct attr *
-bgp_attr_intern (struct attr *attr)
+/* Intern just the sub-components of the attr, but not the attr */
+void
+bgp_attr_intern_sub (struct attr *attr)
 {
-  struct attr *find;
-
   /* Intern referenced strucutre. */
   if (attr->aspath)
     {
@@ -867,7 +881,16 @@ bgp_attr_intern (struct attr *attr)
         }
 #endif
     }
-  
+}
+
+/* Internet argument attribute. */
+struct attr *
+bgp_attr_intern (struct attr *attr)
+{
+  struct attr *find;
+
+  bgp_attr_intern_sub (attr);
+
   find = (struct attr *) hash_get (attrhash, attr, bgp_attr_hash_alloc);
   find->refcnt++;
 
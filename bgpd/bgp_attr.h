@@ -216,6 +216,7 @@ extern void bgp_attr_dup (struct attr *, struct attr *);
 extern void bgp_attr_deep_dup (struct attr *, struct attr *);
 extern void bgp_attr_deep_free (struct attr *);
 extern struct attr *bgp_attr_intern (struct attr *attr);
+extern void bgp_attr_intern_sub (struct attr *);
 extern struct attr *bgp_attr_refcount (struct attr *attr);
 extern void bgp_attr_unintern_sub (struct attr *);
 extern void bgp_attr_unintern (struct attr **);
@@ -240,10 +241,12 @@ extern unsigned long int attr_count (void);
 extern unsigned long int attr_unknown_count (void);
 
 /* Cluster list prototypes. */
+extern struct cluster_list *cluster_parse (struct in_addr *, int);
 extern int cluster_loop_check (struct cluster_list *, struct in_addr);
 extern void cluster_unintern (struct cluster_list *);
 
 /* Transit attribute prototypes. */
+extern struct transit *transit_parse (u_char *, int);
 void transit_unintern (struct transit *);
 
 /* Below exported for unit-test purposes only */
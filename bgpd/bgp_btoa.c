@@ -112,7 +112,7 @@ attr_parse (struct stream *s, u_int16_t len)
 	    struct aspath *aspath;
 
 	    aspath = aspath_parse (s, length, 1);
-	    printf ("ASPATH: %s\n", aspath->str);
+	    printf ("ASPATH: %s\n", aspath_print (aspath));
 	    aspath_free(aspath);
 	  }
 	  break;
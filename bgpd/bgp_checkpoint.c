@@ -0,0 +1,1291 @@
+/* BGP RIB checkpoint, for warm restarts
+ *
+ * This file is part of GNU Zebra.
+ *
+ * GNU Zebra is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * GNU Zebra is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Zebra; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+/*
+ * With a checkpoint file given (-K), bgpd writes the routes it has
+ * received from its peers to the file when it shuts down cleanly, and,
+ * if asked to (-w), every so many seconds while it runs.  It puts them
+ * back when it starts again, unless the file is older than the limit
+ * (-k): those routes would be too far out of date.  The file is renamed
+ * to FILE.loaded once read, so that it is not read again by the start
+ * after the next one if that is not clean.  The loaded routes are marked
+ * stale, as graceful restart would, and are used until the peer sends
+ * them again.  The ones the peer has not sent again by its End-of-RIB,
+ * or by the time the graceful restart stalepath time has run out, are
+ * removed then.  So a restart does not take all the routes away while
+ * the sessions come back up, and peers only change what has changed.
+ *
+ * Both the paths in the table and, for peers with soft reconfiguration,
+ * the routes kept as received are written.  The file is a header
+ * followed by records, in the byte order of the host that wrote it:
+ *
+ *   INSTANCE  the instance the records after it are for, by name
+ *   PEER      a peer of that instance, by address and AS
+ *   OBJ       an AS path, communities, extended communities, cluster
+ *             list or unknown attributes, in their wire format
+ *   ATTR      an attribute, referring to the objects it uses
+ *   TABLE     the afi/safi the routes after it are in
+ *   PATH      a path in the table: peer, attribute, prefix
+ *   ADJ_IN    a route kept as received: peer, attribute, prefix
+ *   END       the counts, so a short file is noticed
+ *
+ * Peers, objects and attributes are numbered from 1 in the order they
+ * appear, and each is written only once, before it is first used.  The
+ * file is mapped in when it is loaded, and each attribute and object is
+ * interned once, however many paths use it.
+ *
+ * Only unicast and multicast, IPv4 and IPv6, are written.  Routes of
+ * peers that are no longer configured, or are now of another AS, are
+ * skipped when loading.
+ */
+
+#include <zebra.h>
+#include <sys/mman.h>
+
+#include "log.h"
+#include "memory.h"
+#include "thread.h"
+#include "command.h"
+#include "stream.h"
+#include "prefix.h"
+#include "sockunion.h"
+#include "linklist.h"
+#include "hash.h"
+#include "jhash.h"
+#include "monotime.h"
+
+#include "bgpd/bgpd.h"
+#include "bgpd/bgp_table.h"
+#include "bgpd/bgp_route.h"
+#include "bgpd/bgp_attr.h"
+#include "bgpd/bgp_aspath.h"
+#include "bgpd/bgp_community.h"
+#include "bgpd/bgp_ecommunity.h"
+#include "bgpd/bgp_advertise.h"
+#include "bgpd/bgp_memory.h"
+#include "bgpd/bgp_checkpoint.h"
+
+/* Large enough for any AS path bgpd keeps. */
+#define BGP_CHECKPOINT_ASPATH_MAX 65535
+
+/* Buffer for writing the file. */
+#define BGP_CHECKPOINT_BUFSIZ (1024 * 1024)
+
+struct bgp_checkpoint_peer
+{
+  u_int32_t as;
+  u_int16_t family;
+  u_int16_t pad;
+  u_char addr[16];
+};
+
+/* The objects are by number, 0 for none.  The attr_extra fields are
+   only used if has_extra is set. */
+struct bgp_checkpoint_attr
+{
+  u_int32_t flag;
+  struct in_addr nexthop;
+  u_int32_t med;
+  u_int32_t local_pref;
+  int32_t nh_ifindex;
+  u_int32_t rmap_change_flags;
+  u_int32_t aspath;
+  u_int32_t community;
+  u_int32_t ecommunity;
+  u_int32_t cluster;
+  u_int32_t transit;
+  struct in6_addr mp_nexthop_global;
+  struct in6_addr mp_nexthop_local;
+  struct in_addr mp_nexthop_global_in;
+  struct in_addr aggregator_addr;
+  struct in_addr originator_id;
+  u_int32_t weight;
+  u_int32_t aggregator_as;
+  u_int32_t tag;
+  u_int16_t encap_tunneltype;
+  u_char origin;
+  u_char has_extra;
+  u_char mp_nexthop_len;
+  u_char mp_nexthop_prefer_global;
+  u_char pad[2];
+};
+
+struct bgp_checkpoint_table
+{
+  u_int16_t afi;
+  u_int16_t safi;
+};
+
+/* Followed by the prefix, in as many bytes as its length needs. */
+struct bgp_checkpoint_route
+{
+  u_int32_t peer;
+  u_int32_t attr;
+  u_int32_t addpath_id;
+  u_char prefixlen;
+  u_char pad[3];
+};
+
+/* What was done last, for "show bgp checkpoint". */
+struct bgp_checkpoint_stats
+{
+  time_t time;
+  unsigned long paths;
+  unsigned long adj_in;
+  unsigned long skipped;
+  unsigned long attrs;
+  unsigned long objs;
+  unsigned long bytes;
+  unsigned long msecs;
+  int error;
+};
+
+static char *bgp_checkpoint_path;
+static unsigned long bgp_checkpoint_max_age = BGP_CHECKPOINT_MAX_AGE_DEFAULT;
+static unsigned long bgp_checkpoint_interval;
+static struct thread *bgp_checkpoint_t_load;
+static struct thread *bgp_checkpoint_t_stale;
+static struct thread *bgp_checkpoint_t_save;
+static struct bgp_checkpoint_stats bgp_checkpoint_saved;
+static struct bgp_checkpoint_stats bgp_checkpoint_loaded;
+
+void
+bgp_checkpoint_set (const char *path)
+{
+  if (bgp_checkpoint_path)
+    XFREE (MTYPE_BGP_CHECKPOINT, bgp_checkpoint_path);
+  bgp_checkpoint_path = XSTRDUP (MTYPE_BGP_CHECKPOINT, path);
+}
+
+/* Files written more than this many seconds ago are not loaded, 0 for
+   no limit. */
+void
+bgp_checkpoint_set_max_age (unsigned long seconds)
+{
+  bgp_checkpoint_max_age = seconds;
+}
+
+/* Also write the file every this many seconds, 0 for only at shutdown. */
+void
+bgp_checkpoint_set_interval (unsigned long seconds)
+{
+  bgp_checkpoint_interval = seconds;
+}
+
+static int
+bgp_checkpoint_afi_safi (afi_t afi, safi_t safi)
+{
+  return (afi == AFI_IP || afi == AFI_IP6)
+         && (safi == SAFI_UNICAST || safi == SAFI_MULTICAST);
+}
+
+/*
+ * Writing.
+ */
+
+/* The number an object or attribute was written as. */
+struct bgp_checkpoint_ref
+{
+  const void *ptr;
+  u_int32_t num;
+};
+
+struct bgp_checkpoint_writer
+{
+  FILE *fp;
+  struct hash *refs;
+  struct stream *s;
+  u_int32_t peers;
+  u_int32_t objs;
+  u_int32_t attrs;
+  u_int32_t paths;
+  u_int32_t adj_in;
+  unsigned long bytes;
+};
+
+static unsigned int
+bgp_checkpoint_ref_key (void *p)
+{
+  const struct bgp_checkpoint_ref *ref = p;
+
+  return jhash (&ref->ptr, sizeof (ref->ptr), 0);
+}
+
+static int
+bgp_checkpoint_ref_cmp (const void *p1, const void *p2)
+{
+  const struct bgp_checkpoint_ref *ref1 = p1;
+  const struct bgp_checkpoint_ref *ref2 = p2;
+
+  return ref1->ptr == ref2->ptr;
+}
+
+static void *
+bgp_checkpoint_ref_alloc (void *p)
+{
+  const struct bgp_checkpoint_ref *val = p;
+  struct bgp_checkpoint_ref *ref;
+
+  ref = XMALLOC (MTYPE_BGP_CHECKPOINT, sizeof (struct bgp_checkpoint_ref));
+  ref->ptr = val->ptr;
+  ref->num = 0;
+  return ref;
+}
+
+static void
+bgp_checkpoint_ref_free (void *ref)
+{
+  XFREE (MTYPE_BGP_CHECKPOINT, ref);
+}
+
+static void
+bgp_checkpoint_put (struct bgp_checkpoint_writer *w, int type, int subtype,
+                    const void *data, size_t length,
+                    const void *data2, size_t length2)
+{
+  static const u_char pad[4];
+  struct bgp_checkpoint_record rec;
+  size_t padlen = (4 - ((length + length2) & 3)) & 3;
+
+  rec.type = type;
+  rec.subtype = subtype;
+  rec.length = length + length2;
+
+  fwrite (&rec, sizeof (rec), 1, w->fp);
+  if (length)
+    fwrite (data, length, 1, w->fp);
+  if (length2)
+    fwrite (data2, length2, 1, w->fp);
+  if (padlen)
+    fwrite (pad, padlen, 1, w->fp);
+  w->bytes += sizeof (rec) + length + length2 + padlen;
+}
+
+/* The number of an object, writing it first if it has not been. */
+static u_int32_t
+bgp_checkpoint_put_obj (struct bgp_checkpoint_writer *w, int subtype,
+                        const void *obj)
+{
+  struct bgp_checkpoint_ref tmp;
+  struct bgp_checkpoint_ref *ref;
+
+  if (!obj)
+    return 0;
+
+  tmp.ptr = obj;
+  ref = hash_get (w->refs, &tmp, bgp_checkpoint_ref_alloc);
+  if (ref->num)
+    return ref->num;
+
+  switch (subtype)
+    {
+    case BGP_CHECKPOINT_ASPATH:
+      stream_reset (w->s);
+      aspath_put (w->s, (struct aspath *) obj, 1);
+      bgp_checkpoint_put (w, BGP_CHECKPOINT_OBJ, subtype,
+                          STREAM_DATA (w->s), stream_get_endp (w->s), NULL, 0);
+      break;
+    case BGP_CHECKPOINT_COMMUNITY:
+      {
+        const struct community *com = obj;
+
+        bgp_checkpoint_put (w, BGP_CHECKPOINT_OBJ, subtype,
+                            com->val, com->size * 4, NULL, 0);
+      }
+      break;
+    case BGP_CHECKPOINT_ECOMMUNITY:
+      {
+        const struct ecommunity *ecom = obj;
+
+        bgp_checkpoint_put (w, BGP_CHECKPOINT_OBJ, subtype,
+                            ecom->val, ecom->size * ECOMMUNITY_SIZE, NULL, 0);
+      }
+      break;
+    case BGP_CHECKPOINT_CLUSTER:
+      {
+        const struct cluster_list *cluster = obj;
+
+        bgp_checkpoint_put (w, BGP_CHECKPOINT_OBJ, subtype,
+                            cluster->list, cluster->length, NULL, 0);
+      }
+      break;
+    case BGP_CHECKPOINT_TRANSIT:
+      {
+        const struct transit *transit = obj;
+
+        bgp_checkpoint_put (w, BGP_CHECKPOINT_OBJ, subtype,
+                            transit->val, transit->length, NULL, 0);
+      }
+      break;
+    }
+
+  ref->num = ++w->objs;
+  return ref->num;
+}
+
+/* Likewise for an attribute, with the objects it uses. */
+static u_int32_t
+bgp_checkpoint_put_attr (struct bgp_checkpoint_writer *w, struct attr *attr)
+{
+  struct bgp_checkpoint_ref tmp;
+  struct bgp_checkpoint_ref *ref;
+  struct bgp_checkpoint_attr ca;
+  struct attr_extra *ae = attr->extra;
+
+  tmp.ptr = attr;
+  ref = hash_get (w->refs, &tmp, bgp_checkpoint_ref_alloc);
+  if (ref->num)
+    return ref->num;
+
+  memset (&ca, 0, sizeof (ca));
+  ca.flag = attr->flag;
+  ca.nexthop = attr->nexthop;
+  ca.med = attr->med;
+  ca.local_pref = attr->local_pref;
+  ca.nh_ifindex = attr->nh_ifindex;
+  ca.rmap_change_flags = attr->rmap_change_flags;
+  ca.origin = attr->origin;
+  ca.aspath = bgp_checkpoint_put_obj (w, BGP_CHECKPOINT_ASPATH, attr->aspath);
+  ca.community = bgp_checkpoint_put_obj (w, BGP_CHECKPOINT_COMMUNITY,
+                                         attr->community);
+  if (ae)
+    {
+      ca.has_extra = 1;
+      ca.ecommunity = bgp_checkpoint_put_obj (w, BGP_CHECKPOINT_ECOMMUNITY,
+                                              ae->ecommunity);
+      ca.cluster = bgp_checkpoint_put_obj (w, BGP_CHECKPOINT_CLUSTER,
+                                           ae->cluster);
+      ca.transit = bgp_checkpoint_put_obj (w, BGP_CHECKPOINT_TRANSIT,
+                                           ae->transit);
+      ca.mp_nexthop_global = ae->mp_nexthop_global;
+      ca.mp_nexthop_local = ae->mp_nexthop_local;
+      ca.mp_nexthop_global_in = ae->mp_nexthop_global_in;
+      ca.aggregator_addr = ae->aggregator_addr;
+      ca.originator_id = ae->originator_id;
+      ca.weight = ae->weight;
+      ca.aggregator_as = ae->aggregator_as;
+      ca.tag = ae->tag;
+      ca.encap_tunneltype = ae->encap_tunneltype;
+      ca.mp_nexthop_len = ae->mp_nexthop_len;
+      ca.mp_nexthop_prefer_global = ae->mp_nexthop_prefer_global;
+    }
+
+  bgp_checkpoint_put (w, BGP_CHECKPOINT_ATTR, 0, &ca, sizeof (ca), NULL, 0);
+  ref->num = ++w->attrs;
+  return ref->num;
+}
+
+static void
+bgp_checkpoint_put_route (struct bgp_checkpoint_writer *w, int type,
+                          u_int32_t peer, struct attr *attr,
+                          u_int32_t addpath_id, struct prefix *p)
+{
+  struct bgp_checkpoint_route cr;
+
+  memset (&cr, 0, sizeof (cr));
+  cr.attr = bgp_checkpoint_put_attr (w, attr);
+  cr.peer = peer;
+  cr.addpath_id = addpath_id;
+  cr.prefixlen = p->prefixlen;
+  bgp_checkpoint_put (w, type, 0, &cr, sizeof (cr),
+                      &p->u.prefix, PSIZE (p->prefixlen));
+}
+
+/* The peers whose routes are kept. */
+static int
+bgp_checkpoint_peer_ok (struct peer *peer)
+{
+  return peer != peer->bgp->peer_self
+         && !peer_dynamic_neighbor (peer)
+         && !CHECK_FLAG (peer->sflags, PEER_STATUS_ACCEPT_PEER)
+         && (peer->su.sa.sa_family == AF_INET
+             || peer->su.sa.sa_family == AF_INET6);
+}
+
+static void
+bgp_checkpoint_put_instance (struct bgp_checkpoint_writer *w,
+                             struct bgp *bgp)
+{
+  struct bgp_checkpoint_peer cp;
+  struct bgp_checkpoint_table ct;
+  struct listnode *node;
+  struct peer *peer;
+  struct bgp_info *ri;
+  struct bgp_adj_in *adj;
+  u_int32_t first;
+  u_int32_t num;
+  afi_t afi;
+  safi_t safi;
+
+  bgp_checkpoint_put (w, BGP_CHECKPOINT_INSTANCE, 0,
+                      bgp->name, bgp->name ? strlen (bgp->name) : 0, NULL, 0);
+
+  first = w->peers + 1;
+  for (ALL_LIST_ELEMENTS_RO (bgp->peer, node, peer))
+    {
+      if (!bgp_checkpoint_peer_ok (peer))
+        continue;
+
+      memset (&cp, 0, sizeof (cp));
+      cp.as = peer->as;
+      cp.family = peer->su.sa.sa_family;
+      if (cp.family == AF_INET)
+        memcpy (cp.addr, &peer->su.sin.sin_addr, 4);
+      else
+        memcpy (cp.addr, &peer->su.sin6.sin6_addr, 16);
+      bgp_checkpoint_put (w, BGP_CHECKPOINT_PEER, 0, &cp, sizeof (cp),
+                          NULL, 0);
+      w->peers++;
+    }
+
+  for (afi = AFI_IP; afi < AFI_MAX; afi++)
+    for (safi = SAFI_UNICAST; safi < SAFI_MAX; safi++)
+      {
+        if (!bgp_checkpoint_afi_safi (afi, safi))
+          continue;
+
+        ct.afi = afi;
+        ct.safi = safi;
+        bgp_checkpoint_put (w, BGP_CHECKPOINT_TABLE, 0, &ct, sizeof (ct),
+                            NULL, 0);
+
+        /* Peers are numbered in the order written above. */
+        num = first;
+        for (ALL_LIST_ELEMENTS_RO (bgp->peer, node, peer))
+          {
+            if (!bgp_checkpoint_peer_ok (peer))
+              continue;
+
+            for (ri = peer->paths[afi][safi]; ri; ri = ri->peer_next)
+              {
+                if (ri->type != ZEBRA_ROUTE_BGP
+                    || ri->sub_type != BGP_ROUTE_NORMAL
+                    || CHECK_FLAG (ri->flags,
+                                   BGP_INFO_REMOVED | BGP_INFO_HISTORY))
+                  continue;
+                bgp_checkpoint_put_route (w, BGP_CHECKPOINT_PATH, num,
+                                          ri->attr, ri->addpath_rx_id,
+                                          &ri->net->p);
+                w->paths++;
+              }
+
+            for (adj = bgp_adj_in_first (peer->adj_in[afi][safi]); adj;
+                 adj = bgp_adj_in_next (peer->adj_in[afi][safi], adj))
+              {
+                bgp_checkpoint_put_route (w, BGP_CHECKPOINT_ADJ_IN, num,
+                                          adj->attr, adj->addpath_rx_id,
+                                          &adj->rn->p);
+                w->adj_in++;
+              }
+            num++;
+          }
+      }
+}
+
+/* Write the checkpoint, to a temporary file that then replaces the
+   file, so that a file that is there is always whole. */
+int
+bgp_checkpoint_save (void)
+{
+  struct bgp_checkpoint_writer w;
+  struct bgp_checkpoint_header hdr;
+  struct bgp_checkpoint_end end;
+  struct listnode *node;
+  struct bgp *bgp;
+  struct timeval start;
+  char *tmp;
+  char *buf;
+  int ret;
+
+  if (!bgp_checkpoint_path || !bm->bgp)
+    return 0;
+
+  monotime (&start);
+  memset (&bgp_checkpoint_saved, 0, sizeof (bgp_checkpoint_saved));
+
+  tmp = XMALLOC (MTYPE_TMP, strlen (bgp_checkpoint_path) + 5);
+  sprintf (tmp, "%s.tmp", bgp_checkpoint_path);
+
+  memset (&w, 0, sizeof (w));
+  w.fp = fopen (tmp, "w");
+  if (!w.fp)
+    {
+      zlog_err ("BGP checkpoint: can't open %s: %s", tmp,
+                safe_strerror (errno));
+      XFREE (MTYPE_TMP, tmp);
+      bgp_checkpoint_saved.error = errno;
+      return -1;
+    }
+  buf = XMALLOC (MTYPE_BGP_CHECKPOINT, BGP_CHECKPOINT_BUFSIZ);
+  setvbuf (w.fp, buf, _IOFBF, BGP_CHECKPOINT_BUFSIZ);
+  w.refs = hash_create (bgp_checkpoint_ref_key, bgp_checkpoint_ref_cmp);
+  w.s = stream_new (BGP_CHECKPOINT_ASPATH_MAX);
+
+  memset (&hdr, 0, sizeof (hdr));
+  memcpy (hdr.magic, BGP_CHECKPOINT_MAGIC, sizeof (hdr.magic));
+  hdr.version = BGP_CHECKPOINT_VERSION;
+  hdr.byteorder = BGP_CHECKPOINT_BYTEORDER;
+  hdr.time = time (NULL);
+  fwrite (&hdr, sizeof (hdr), 1, w.fp);
+  w.bytes = sizeof (hdr);
+
+  for (ALL_LIST_ELEMENTS_RO (bm->bgp, node, bgp))
+    bgp_checkpoint_put_instance (&w, bgp);
+
+  end.peers = w.peers;
+  end.objs = w.objs;
+  end.attrs = w.attrs;
+  end.paths = w.paths;
+  end.adj_in = w.adj_in;
+  bgp_checkpoint_put (&w, BGP_CHECKPOINT_END, 0, &end, sizeof (end), NULL, 0);
+
+  ret = ferror (w.fp) ? -1 : 0;
+  if (fclose (w.fp) != 0)
+    ret = -1;
+  if (ret == 0 && rename (tmp, bgp_checkpoint_path) < 0)
+    ret = -1;
+  if (ret < 0)
+    {
+      bgp_checkpoint_saved.error = errno;
+      zlog_err ("BGP checkpoint: can't write %s: %s", bgp_checkpoint_path,
+                safe_strerror (errno));
+      unlink (tmp);
+    }
+  else
+    {
+      bgp_checkpoint_saved.time = hdr.time;
+      bgp_checkpoint_saved.paths = w.paths;
+      bgp_checkpoint_saved.adj_in = w.adj_in;
+      bgp_checkpoint_saved.attrs = w.attrs;
+      bgp_checkpoint_saved.objs = w.objs;
+      bgp_checkpoint_saved.bytes = w.bytes;
+      bgp_checkpoint_saved.msecs = monotime_since (&start, NULL) / 1000;
+      zlog_info ("BGP checkpoint: wrote %u paths and %u received routes "
+                 "to %s in %lu ms", w.paths, w.adj_in, bgp_checkpoint_path,
+                 bgp_checkpoint_saved.msecs);
+    }
+
+  hash_clean (w.refs, bgp_checkpoint_ref_free);
+  hash_free (w.refs);
+  stream_free (w.s);
+  XFREE (MTYPE_BGP_CHECKPOINT, buf);
+  XFREE (MTYPE_TMP, tmp);
+  return ret;
+}
+
+/*
+ * Loading.
+ */
+
+struct bgp_checkpoint_loader
+{
+  struct stream *s;
+
+  /* By number, less one; NULL where skipped. */
+  void **objs;
+  u_char *objtypes;
+  u_int32_t nobjs;
+  struct attr **attrs;
+  u_int32_t nattrs;
+  struct peer **peers;
+  u_int32_t npeers;
+
+  /* Where the records are going. */
+  struct bgp *bgp;
+  afi_t afi;
+  safi_t safi;
+
+  /* Records read, against the counts at the end. */
+  u_int32_t path_recs;
+  u_int32_t adj_in_recs;
+
+  unsigned long paths;
+  unsigned long adj_in;
+  unsigned long skipped;
+};
+
+/* Make room for one more in an array of n. */
+static void *
+bgp_checkpoint_grow (void *array, u_int32_t n, size_t size)
+{
+  if ((n & (n - 1)) == 0)
+    array = XREALLOC (MTYPE_BGP_CHECKPOINT, array, (n ? n * 2 : 64) * size);
+  return array;
+}
+
+static int
+bgp_checkpoint_get_instance (struct bgp_checkpoint_loader *l,
+                             const u_char *data, u_int32_t length)
+{
+  char name[256];
+
+  if (length >= sizeof (name))
+    return -1;
+  memcpy (name, data, length);
+  name[length] = '\0';
+
+  l->bgp = length ? bgp_lookup_by_name (name) : bgp_get_default ();
+  if (!l->bgp)
+    zlog_warn ("BGP checkpoint: instance %s is not configured, skipped",
+               length ? name : "default");
+  return 0;
+}
+
+static int
+bgp_checkpoint_get_peer (struct bgp_checkpoint_loader *l,
+                         const u_char *data, u_int32_t length)
+{
+  const struct bgp_checkpoint_peer *cp = (const void *) data;
+  struct peer *peer = NULL;
+  union sockunion su;
+
+  if (length < sizeof (*cp))
+    return -1;
+
+  memset (&su, 0, sizeof (su));
+  su.sa.sa_family = cp->family;
+  if (cp->family == AF_INET)
+    memcpy (&su.sin.sin_addr, cp->addr, 4);
+  else if (cp->family == AF_INET6)
+    memcpy (&su.sin6.sin6_addr, cp->addr, 16);
+  else
+    return -1;
+
+  /* Routes from a session that is up already are current. */
+  if (l->bgp)
+    peer = peer_lookup (l->bgp, &su);
+  if (peer && (peer->as != cp->as || peer->status == Established
+               || !bgp_checkpoint_peer_ok (peer)))
+    peer = NULL;
+
+  l->peers = bgp_checkpoint_grow (l->peers, l->npeers, sizeof (struct peer *));
+  l->peers[l->npeers++] = peer;
+  return 0;
+}
+
+static int
+bgp_checkpoint_get_obj (struct bgp_checkpoint_loader *l, int subtype,
+                        const u_char *data, u_int32_t length)
+{
+  void *obj = NULL;
+
+  switch (subtype)
+    {
+    case BGP_CHECKPOINT_ASPATH:
+      if (length > BGP_CHECKPOINT_ASPATH_MAX)
+        return -1;
+      stream_reset (l->s);
+      stream_put (l->s, data, length);
+      obj = aspath_parse (l->s, length, 1);
+      break;
+    case BGP_CHECKPOINT_COMMUNITY:
+      if (length > 0xffff)
+        return -1;
+      obj = community_parse ((u_int32_t *) data, length);
+      break;
+    case BGP_CHECKPOINT_ECOMMUNITY:
+      if (length > 0xffff)
+        return -1;
+      obj = ecommunity_parse ((u_int8_t *) data, length);
+      break;
+    case BGP_CHECKPOINT_CLUSTER:
+      if (length % 4)
+        return -1;
+      obj = cluster_parse ((struct in_addr *) data, length);
+      break;
+    case BGP_CHECKPOINT_TRANSIT:
+      obj = transit_parse ((u_char *) data, length);
+      break;
+    default:
+      return -1;
+    }
+  if (!obj)
+    return -1;
+
+  l->objs = bgp_checkpoint_grow (l->objs, l->nobjs, sizeof (void *));
+  l->objtypes = bgp_checkpoint_grow (l->objtypes, l->nobjs, 1);
+  l->objs[l->nobjs] = obj;
+  l->objtypes[l->nobjs] = subtype;
+  l->nobjs++;
+  return 0;
+}
+
+/* An object an attribute refers to, which must be of the right type. */
+static int
+bgp_checkpoint_obj (struct bgp_checkpoint_loader *l, u_int32_t num,
+                    int subtype, void **obj)
+{
+  *obj = NULL;
+  if (!num)
+    return 0;
+  if (num > l->nobjs || l->objtypes[num - 1] != subtype)
+    return -1;
+  *obj = l->objs[num - 1];
+  return 0;
+}
+
+static int
+bgp_checkpoint_get_attr (struct bgp_checkpoint_loader *l,
+                         const u_char *data, u_int32_t length)
+{
+  const struct bgp_checkpoint_attr *ca = (const void *) data;
+  struct attr attr;
+  struct attr_extra extra;
+  void *obj;
+
+  if (length < sizeof (*ca))
+    return -1;
+
+  memset (&attr, 0, sizeof (attr));
+  memset (&extra, 0, sizeof (extra));
+  attr.flag = ca->flag;
+  attr.nexthop = ca->nexthop;
+  attr.med = ca->med;
+  attr.local_pref = ca->local_pref;
+  attr.nh_ifindex = ca->nh_ifindex;
+  attr.rmap_change_flags = ca->rmap_change_flags;
+  attr.origin = ca->origin;
+  if (bgp_checkpoint_obj (l, ca->aspath, BGP_CHECKPOINT_ASPATH, &obj) < 0)
+    return -1;
+  attr.aspath = obj;
+  if (bgp_checkpoint_obj (l, ca->community, BGP_CHECKPOINT_COMMUNITY,
+                          &obj) < 0)
+    return -1;
+  attr.community = obj;
+
+  if (ca->has_extra)
+    {
+      attr.extra = &extra;
+      if (bgp_checkpoint_obj (l, ca->ecommunity, BGP_CHECKPOINT_ECOMMUNITY,
+                              &obj) < 0)
+        return -1;
+      extra.ecommunity = obj;
+      if (bgp_checkpoint_obj (l, ca->cluster, BGP_CHECKPOINT_CLUSTER,
+                              &obj) < 0)
+        return -1;
+      extra.cluster = obj;
+      if (bgp_checkpoint_obj (l, ca->transit, BGP_CHECKPOINT_TRANSIT,
+                              &obj) < 0)
+        return -1;
+      extra.transit = obj;
+      extra.mp_nexthop_global = ca->mp_nexthop_global;
+      extra.mp_nexthop_local = ca->mp_nexthop_local;
+      extra.mp_nexthop_global_in = ca->mp_nexthop_global_in;
+      extra.aggregator_addr = ca->aggregator_addr;
+      extra.originator_id = ca->originator_id;
+      extra.weight = ca->weight;
+      extra.aggregator_as = ca->aggregator_as;
+      extra.tag = ca->tag;
+      extra.encap_tunneltype = ca->encap_tunneltype;
+      extra.mp_nexthop_len = ca->mp_nexthop_len;
+      extra.mp_nexthop_prefer_global = ca->mp_nexthop_prefer_global;
+    }
+  else if (ca->ecommunity || ca->cluster || ca->transit)
+    return -1;
+
+  l->attrs = bgp_checkpoint_grow (l->attrs, l->nattrs, sizeof (struct attr *));
+  l->attrs[l->nattrs++] = bgp_attr_intern (&attr);
+  return 0;
+}
+
+static int
+bgp_checkpoint_get_table (struct bgp_checkpoint_loader *l,
+                          const u_char *data, u_int32_t length)
+{
+  const struct bgp_checkpoint_table *ct = (const void *) data;
+
+  if (length < sizeof (*ct) || !bgp_checkpoint_afi_safi (ct->afi, ct->safi))
+    return -1;
+  l->afi = ct->afi;
+  l->safi = ct->safi;
+  return 0;
+}
+
+static int
+bgp_checkpoint_get_route (struct bgp_checkpoint_loader *l, int type,
+                          const u_char *data, u_int32_t length)
+{
+  const struct bgp_checkpoint_route *cr = (const void *) data;
+  struct bgp_adj_in *adj;
+  struct bgp_node *rn;
+  struct peer *peer;
+  struct attr *attr;
+  struct prefix p;
+
+  if (length < sizeof (*cr) || !l->afi)
+    return -1;
+  if (!cr->peer || cr->peer > l->npeers || !cr->attr || cr->attr > l->nattrs)
+    return -1;
+  if (cr->prefixlen > (l->afi == AFI_IP ? IPV4_MAX_BITLEN : IPV6_MAX_BITLEN)
+      || length < sizeof (*cr) + PSIZE (cr->prefixlen))
+    return -1;
+
+  if (type == BGP_CHECKPOINT_PATH)
+    l->path_recs++;
+  else
+    l->adj_in_recs++;
+
+  peer = l->peers[cr->peer - 1];
+  if (!peer || !peer->afc[l->afi][l->safi])
+    {
+      l->skipped++;
+      return 0;
+    }
+
+  /* Its routes are used while it is down, as with graceful restart. */
+  SET_FLAG (peer->sflags, PEER_STATUS_CHECKPOINT);
+
+  memset (&p, 0, sizeof (p));
+  p.family = afi2family (l->afi);
+  p.prefixlen = cr->prefixlen;
+  memcpy (&p.u.prefix, data + sizeof (*cr), PSIZE (cr->prefixlen));
+  apply_mask (&p);
+
+  attr = l->attrs[cr->attr - 1];
+  if (type == BGP_CHECKPOINT_PATH)
+    {
+      attr = bgp_attr_intern (attr);
+      if (bgp_update_stale (peer, &p, cr->addpath_id, attr, l->afi, l->safi))
+        l->paths++;
+      else
+        bgp_attr_unintern (&attr);
+    }
+  else if (CHECK_FLAG (peer->af_flags[l->afi][l->safi],
+                       PEER_FLAG_SOFT_RECONFIG))
+    {
+      rn = bgp_afi_node_get (peer->bgp->rib[l->afi][l->safi], l->afi,
+                             l->safi, &p, NULL);
+      adj = bgp_adj_in_set (rn, peer, attr, cr->addpath_id);
+      adj->stale = 1;
+      bgp_unlock_node (rn);
+      l->adj_in++;
+    }
+  else
+    l->skipped++;
+  return 0;
+}
+
+/* Drop the references the loader holds; the routes have their own. */
+static void
+bgp_checkpoint_loader_free (struct bgp_checkpoint_loader *l)
+{
+  struct community *com;
+  struct ecommunity *ecom;
+  struct aspath *as;
+  u_int32_t i;
+
+  for (i = 0; i < l->nattrs; i++)
+    bgp_attr_unintern (&l->attrs[i]);
+
+  for (i = 0; i < l->nobjs; i++)
+    switch (l->objtypes[i])
+      {
+      case BGP_CHECKPOINT_ASPATH:
+        as = l->objs[i];
+        aspath_unintern (&as);
+        break;
+      case BGP_CHECKPOINT_COMMUNITY:
+        com = l->objs[i];
+        community_unintern (&com);
+        break;
+      case BGP_CHECKPOINT_ECOMMUNITY:
+        ecom = l->objs[i];
+        ecommunity_unintern (&ecom);
+        break;
+      case BGP_CHECKPOINT_CLUSTER:
+        cluster_unintern (l->objs[i]);
+        break;
+      case BGP_CHECKPOINT_TRANSIT:
+        transit_unintern (l->objs[i]);
+        break;
+      }
+
+  if (l->attrs)
+    XFREE (MTYPE_BGP_CHECKPOINT, l->attrs);
+  if (l->objs)
+    XFREE (MTYPE_BGP_CHECKPOINT, l->objs);
+  if (l->objtypes)
+    XFREE (MTYPE_BGP_CHECKPOINT, l->objtypes);
+  if (l->peers)
+    XFREE (MTYPE_BGP_CHECKPOINT, l->peers);
+  stream_free (l->s);
+}
+
+/* Go through the records.  Returns -1 if the file is not valid, after
+   which the routes up to there are left, and -2 if it is too old. */
+static int
+bgp_checkpoint_parse (struct bgp_checkpoint_loader *l, const u_char *data,
+                      size_t size)
+{
+  const struct bgp_checkpoint_header *hdr = (const void *) data;
+  const struct bgp_checkpoint_record *rec;
+  const struct bgp_checkpoint_end *end;
+  size_t pos, len;
+  time_t now;
+  int ret;
+
+  if (size < sizeof (*hdr)
+      || memcmp (hdr->magic, BGP_CHECKPOINT_MAGIC, sizeof (hdr->magic)))
+    {
+      zlog_err ("BGP checkpoint: %s is not a checkpoint", bgp_checkpoint_path);
+      return -1;
+    }
+  if (hdr->version != BGP_CHECKPOINT_VERSION
+      || hdr->byteorder != BGP_CHECKPOINT_BYTEORDER)
+    {
+      zlog_err ("BGP checkpoint: %s is of another version or byte order",
+                bgp_checkpoint_path);
+      return -1;
+    }
+  bgp_checkpoint_loaded.time = hdr->time;
+
+  now = time (NULL);
+  if (bgp_checkpoint_max_age && hdr->time < (u_int64_t) now
+      && now - hdr->time > bgp_checkpoint_max_age)
+    {
+      zlog_warn ("BGP checkpoint: %s was written %llu seconds ago, over "
+                 "the %lu allowed, starting cold", bgp_checkpoint_path,
+                 (unsigned long long) (now - hdr->time),
+                 bgp_checkpoint_max_age);
+      return -2;
+    }
+
+  pos = sizeof (*hdr);
+  while (pos + sizeof (*rec) <= size)
+    {
+      rec = (const void *) (data + pos);
+      pos += sizeof (*rec);
+      len = rec->length;
+      if (len > size - pos)
+        break;
+
+      switch (rec->type)
+        {
+        case BGP_CHECKPOINT_INSTANCE:
+          ret = bgp_checkpoint_get_instance (l, data + pos, len);
+          break;
+        case BGP_CHECKPOINT_PEER:
+          ret = bgp_checkpoint_get_peer (l, data + pos, len);
+          break;
+        case BGP_CHECKPOINT_OBJ:
+          ret = bgp_checkpoint_get_obj (l, rec->subtype, data + pos, len);
+          break;
+        case BGP_CHECKPOINT_ATTR:
+          ret = bgp_checkpoint_get_attr (l, data + pos, len);
+          break;
+        case BGP_CHECKPOINT_TABLE:
+          ret = bgp_checkpoint_get_table (l, data + pos, len);
+          break;
+        case BGP_CHECKPOINT_PATH:
+        case BGP_CHECKPOINT_ADJ_IN:
+          ret = bgp_checkpoint_get_route (l, rec->type, data + pos, len);
+          break;
+        case BGP_CHECKPOINT_END:
+          end = (const void *) (data + pos);
+          if (len >= sizeof (*end) && end->peers == l->npeers
+              && end->objs == l->nobjs && end->attrs == l->nattrs
+              && end->paths == l->path_recs && end->adj_in == l->adj_in_recs)
+            return 0;
+          ret = -1;
+          break;
+        default:
+          /* Unknown records are skipped. */
+          ret = 0;
+          break;
+        }
+      if (ret < 0)
+        break;
+
+      pos += (len + 3) & ~3;
+    }
+
+  zlog_err ("BGP checkpoint: %s is damaged at offset %zu",
+            bgp_checkpoint_path, pos);
+  return -1;
+}
+
+static int
+bgp_checkpoint_stale_expire (struct thread *thread)
+{
+  struct listnode *node, *pnode;
+  struct bgp *bgp;
+  struct peer *peer;
+  afi_t afi;
+  safi_t safi;
+
+  bgp_checkpoint_t_stale = NULL;
+
+  for (ALL_LIST_ELEMENTS_RO (bm->bgp, node, bgp))
+    for (ALL_LIST_ELEMENTS_RO (bgp->peer, pnode, peer))
+      {
+        if (!CHECK_FLAG (peer->sflags, PEER_STATUS_CHECKPOINT))
+          continue;
+
+        UNSET_FLAG (peer->sflags, PEER_STATUS_CHECKPOINT);
+        for (afi = AFI_IP; afi < AFI_MAX; afi++)
+          for (safi = SAFI_UNICAST; safi < SAFI_MAX; safi++)
+            if (bgp_checkpoint_afi_safi (afi, safi) && !peer->nsf[afi][safi])
+              bgp_clear_stale_route (peer, afi, safi);
+      }
+
+  zlog_info ("BGP checkpoint: stale routes removed");
+  return 0;
+}
+
+/* The peer has sent End-of-RIB, and the stale routes of that table are
+   gone.  Once it has for all the tables its routes were loaded in, they
+   are no longer used while it is down; those of tables it no longer
+   sends go too. */
+void
+bgp_checkpoint_eor (struct peer *peer)
+{
+  afi_t afi;
+  safi_t safi;
+
+  for (afi = AFI_IP; afi < AFI_MAX; afi++)
+    for (safi = SAFI_UNICAST; safi < SAFI_MAX; safi++)
+      if (bgp_checkpoint_afi_safi (afi, safi) && peer->afc_nego[afi][safi]
+          && !CHECK_FLAG (peer->af_sflags[afi][safi],
+                          PEER_STATUS_EOR_RECEIVED))
+        return;
+
+  UNSET_FLAG (peer->sflags, PEER_STATUS_CHECKPOINT);
+  for (afi = AFI_IP; afi < AFI_MAX; afi++)
+    for (safi = SAFI_UNICAST; safi < SAFI_MAX; safi++)
+      if (bgp_checkpoint_afi_safi (afi, safi) && !peer->afc_nego[afi][safi]
+          && !peer->nsf[afi][safi])
+        bgp_clear_stale_route (peer, afi, safi);
+}
+
+/* Move the file out of the way, so that it is read only once. */
+static void
+bgp_checkpoint_retire (void)
+{
+  char *loaded;
+
+  loaded = XMALLOC (MTYPE_TMP, strlen (bgp_checkpoint_path) + 8);
+  sprintf (loaded, "%s.loaded", bgp_checkpoint_path);
+  if (rename (bgp_checkpoint_path, loaded) < 0)
+    zlog_warn ("BGP checkpoint: can't rename %s to %s: %s",
+               bgp_checkpoint_path, loaded, safe_strerror (errno));
+  XFREE (MTYPE_TMP, loaded);
+}
+
+/* Put back the routes in the file.  Returns -1 if there is no file, or
+   it is too old or damaged. */
+int
+bgp_checkpoint_read (void)
+{
+  struct bgp_checkpoint_loader l;
+  struct listnode *node;
+  struct bgp *bgp;
+  struct timeval start;
+  struct stat st;
+  u_int32_t stalepath_time = 0;
+  void *data;
+  int fd;
+  int ret;
+
+  memset (&bgp_checkpoint_loaded, 0, sizeof (bgp_checkpoint_loaded));
+  monotime (&start);
+
+  fd = open (bgp_checkpoint_path, O_RDONLY);
+  if (fd < 0)
+    {
+      bgp_checkpoint_loaded.error = errno;
+      if (errno == ENOENT)
+        zlog_info ("BGP checkpoint: no %s, starting cold",
+                   bgp_checkpoint_path);
+      else
+        zlog_err ("BGP checkpoint: can't open %s: %s", bgp_checkpoint_path,
+                  safe_strerror (errno));
+      return -1;
+    }
+
+  /* Whatever is in it, it is not for the next start. */
+  bgp_checkpoint_retire ();
+
+  if (fstat (fd, &st) < 0 || st.st_size == 0)
+    {
+      bgp_checkpoint_loaded.error = errno ? errno : EINVAL;
+      close (fd);
+      return -1;
+    }
+
+  data = mmap (NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close (fd);
+  if (data == MAP_FAILED)
+    {
+      bgp_checkpoint_loaded.error = errno;
+      zlog_err ("BGP checkpoint: can't map %s: %s", bgp_checkpoint_path,
+                safe_strerror (errno));
+      return -1;
+    }
+#ifdef MADV_SEQUENTIAL
+  madvise (data, st.st_size, MADV_SEQUENTIAL);
+#endif
+
+  memset (&l, 0, sizeof (l));
+  l.s = stream_new (BGP_CHECKPOINT_ASPATH_MAX);
+  ret = bgp_checkpoint_parse (&l, data, st.st_size);
+  if (ret < 0)
+    bgp_checkpoint_loaded.error = (ret == -2) ? ESTALE : EINVAL;
+  munmap (data, st.st_size);
+
+  bgp_checkpoint_loaded.paths = l.paths;
+  bgp_checkpoint_loaded.adj_in = l.adj_in;
+  bgp_checkpoint_loaded.skipped = l.skipped;
+  bgp_checkpoint_loaded.attrs = l.nattrs;
+  bgp_checkpoint_loaded.objs = l.nobjs;
+  bgp_checkpoint_loaded.bytes = st.st_size;
+  bgp_checkpoint_loader_free (&l);
+  bgp_checkpoint_loaded.msecs = monotime_since (&start, NULL) / 1000;
+
+  zlog_info ("BGP checkpoint: loaded %lu paths and %lu received routes "
+             "from %s in %lu ms, %lu skipped", l.paths, l.adj_in,
+             bgp_checkpoint_path, bgp_checkpoint_loaded.msecs, l.skipped);
+
+  /* The routes a peer has not sent again go, as with graceful restart,
+     at its End-of-RIB or after the stalepath time. */
+  if (l.paths || l.adj_in)
+    {
+      for (ALL_LIST_ELEMENTS_RO (bm->bgp, node, bgp))
+        if (bgp->stalepath_time > stalepath_time)
+          stalepath_time = bgp->stalepath_time;
+      bgp_checkpoint_t_stale =
+        thread_add_timer (bm->master, bgp_checkpoint_stale_expire, NULL,
+                          stalepath_time);
+    }
+  return ret < 0 ? -1 : 0;
+}
+
+static int
+bgp_checkpoint_load (struct thread *thread)
+{
+  bgp_checkpoint_t_load = NULL;
+  bgp_checkpoint_read ();
+  return 0;
+}
+
+static int
+bgp_checkpoint_save_timer (struct thread *thread)
+{
+  bgp_checkpoint_t_save = NULL;
+  bgp_checkpoint_save ();
+  bgp_checkpoint_t_save =
+    thread_add_timer (bm->master, bgp_checkpoint_save_timer, NULL,
+                      bgp_checkpoint_interval);
+  return 0;
+}
+
+/* Load the checkpoint once the configuration is read.  It is done from
+   an event, so that the connection to zebra is set up first. */
+void
+bgp_checkpoint_start (void)
+{
+  if (!bgp_checkpoint_path)
+    return;
+
+  bgp_checkpoint_t_load = thread_add_event (bm->master, bgp_checkpoint_load,
+                                            NULL, 0);
+  if (bgp_checkpoint_interval)
+    bgp_checkpoint_t_save =
+      thread_add_timer (bm->master, bgp_checkpoint_save_timer, NULL,
+                        bgp_checkpoint_interval);
+}
+
+static void
+bgp_checkpoint_show_stats (struct vty *vty, const char *what,
+                           struct bgp_checkpoint_stats *stats)
+{
+  char buf[32];
+  time_t t = stats->time;
+
+  if (!stats->time && !stats->error)
+    {
+      vty_out (vty, "  Not %s%s", what, VTY_NEWLINE);
+      return;
+    }
+  if (stats->error == ESTALE)
+    {
+      strftime (buf, sizeof (buf), "%Y-%m-%d %H:%M:%S", localtime (&t));
+      vty_out (vty, "  Not %s: written %s, over %lu seconds before%s", what,
+               buf, bgp_checkpoint_max_age, VTY_NEWLINE);
+      return;
+    }
+  if (stats->error && !stats->paths && !stats->adj_in)
+    {
+      vty_out (vty, "  Not %s: %s%s", what, safe_strerror (stats->error),
+               VTY_NEWLINE);
+      return;
+    }
+
+  strftime (buf, sizeof (buf), "%Y-%m-%d %H:%M:%S", localtime (&t));
+  vty_out (vty, "  %s%s, of %s, in %lu ms%s",
+           stats->error ? "Partly " : "", what, buf, stats->msecs,
+           VTY_NEWLINE);
+  vty_out (vty, "    %lu paths, %lu received routes, %lu attributes, "
+           "%lu objects, %lu bytes%s", stats->paths, stats->adj_in,
+           stats->attrs, stats->objs, stats->bytes, VTY_NEWLINE);
+  if (stats->skipped)
+    vty_out (vty, "    %lu routes skipped%s", stats->skipped, VTY_NEWLINE);
+}
+
+DEFUN (show_bgp_checkpoint,
+       show_bgp_checkpoint_cmd,
+       "show bgp checkpoint",
+       SHOW_STR
+       BGP_STR
+       "Routing table checkpoint for warm restarts\n")
+{
+  if (!bgp_checkpoint_path)
+    {
+      vty_out (vty, "No checkpoint file%s", VTY_NEWLINE);
+      return CMD_SUCCESS;
+    }
+
+  vty_out (vty, "Checkpoint file %s%s", bgp_checkpoint_path, VTY_NEWLINE);
+  bgp_checkpoint_show_stats (vty, "loaded", &bgp_checkpoint_loaded);
+  if (bgp_checkpoint_t_stale)
+    vty_out (vty, "    Stale routes removed in %lu seconds, or at "
+             "End-of-RIB%s", thread_timer_remain_second (bgp_checkpoint_t_stale),
+             VTY_NEWLINE);
+  bgp_checkpoint_show_stats (vty, "written", &bgp_checkpoint_saved);
+  if (bgp_checkpoint_t_save)
+    vty_out (vty, "    Written again in %lu seconds%s",
+             thread_timer_remain_second (bgp_checkpoint_t_save), VTY_NEWLINE);
+  return CMD_SUCCESS;
+}
+
+void
+bgp_checkpoint_init (void)
+{
+  install_element (VIEW_NODE, &show_bgp_checkpoint_cmd);
+}
+
+void
+bgp_checkpoint_finish (void)
+{
+  THREAD_OFF (bgp_checkpoint_t_load);
+  THREAD_TIMER_OFF (bgp_checkpoint_t_stale);
+  THREAD_TIMER_OFF (bgp_checkpoint_t_save);
+  if (bgp_checkpoint_path)
+    XFREE (MTYPE_BGP_CHECKPOINT, bgp_checkpoint_path);
+}
@@ -0,0 +1,84 @@
+/* BGP RIB checkpoint, for warm restarts
+ *
+ * This file is part of GNU Zebra.
+ *
+ * GNU Zebra is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * GNU Zebra is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Zebra; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#ifndef _QUAGGA_BGP_CHECKPOINT_H
+#define _QUAGGA_BGP_CHECKPOINT_H
+
+#define BGP_CHECKPOINT_MAGIC     "FRRBGPCK"
+#define BGP_CHECKPOINT_VERSION   1
+#define BGP_CHECKPOINT_BYTEORDER 0x01020304
+
+/* Files older than this many seconds are not loaded, by default. */
+#define BGP_CHECKPOINT_MAX_AGE_DEFAULT 600
+
+/* The framing of the file, see bgp_checkpoint.c. */
+struct bgp_checkpoint_header
+{
+  char magic[8];
+  u_int32_t version;
+  u_int32_t byteorder;
+  u_int64_t time;
+};
+
+/* Each record has this in front of it, and is padded to 4 bytes.  The
+   length is that of what follows, without the padding. */
+struct bgp_checkpoint_record
+{
+  u_int16_t type;
+  u_int16_t subtype;
+  u_int32_t length;
+};
+
+#define BGP_CHECKPOINT_INSTANCE  1
+#define BGP_CHECKPOINT_PEER      2
+#define BGP_CHECKPOINT_OBJ       3
+#define BGP_CHECKPOINT_ATTR      4
+#define BGP_CHECKPOINT_TABLE     5
+#define BGP_CHECKPOINT_PATH      6
+#define BGP_CHECKPOINT_ADJ_IN    7
+#define BGP_CHECKPOINT_END       8
+
+/* OBJ subtypes. */
+#define BGP_CHECKPOINT_ASPATH      1
+#define BGP_CHECKPOINT_COMMUNITY   2
+#define BGP_CHECKPOINT_ECOMMUNITY  3
+#define BGP_CHECKPOINT_CLUSTER     4
+#define BGP_CHECKPOINT_TRANSIT     5
+
+struct bgp_checkpoint_end
+{
+  u_int32_t peers;
+  u_int32_t objs;
+  u_int32_t attrs;
+  u_int32_t paths;
+  u_int32_t adj_in;
+};
+
+extern void bgp_checkpoint_set (const char *path);
+extern void bgp_checkpoint_set_max_age (unsigned long);
+extern void bgp_checkpoint_set_interval (unsigned long);
+extern void bgp_checkpoint_init (void);
+extern void bgp_checkpoint_start (void);
+extern int bgp_checkpoint_save (void);
+extern int bgp_checkpoint_read (void);
+extern void bgp_checkpoint_eor (struct peer *);
+extern void bgp_checkpoint_finish (void);
+
+#endif /* _QUAGGA_BGP_CHECKPOINT_H */
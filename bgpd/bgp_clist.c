@@ -656,10 +656,11 @@ community_list_match_delete (struct community *com,
          }
      }
 
-  /* Delete all of the communities we flagged for deletion */
+  /* Delete all of the communities we flagged for deletion.  They are
+     compared as kept, in network byte order. */
   for (i = delete_index-1; i >= 0; i--)
     {
-      val = community_val_get (com, com_index_to_delete[i]);
+      val = htonl (community_val_get (com, com_index_to_delete[i]));
       community_del_val (com, &val);
     }
 
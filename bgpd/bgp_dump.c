@@ -19,6 +19,10 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 02111-1307, USA.  */
 
 #include <zebra.h>
+#include <pthread.h>
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
 
 #include "log.h"
 #include "stream.h"
@@ -30,11 +34,13 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "queue.h"
 #include "memory.h"
 #include "filter.h"
+#include "network.h"
 
 #include "bgpd/bgp_table.h"
 #include "bgpd/bgpd.h"
 #include "bgpd/bgp_route.h"
 #include "bgpd/bgp_attr.h"
+#include "bgpd/bgp_memory.h"
 #include "bgpd/bgp_dump.h"
 
 enum bgp_dump_type
@@ -76,19 +82,97 @@ enum MRT_MSG_TYPES {
    MSG_TABLE_DUMP_V2            /* routing table dump, version 2 */
 };
 
+/* Records are encoded on the main thread into a ring per open file, and
+   a writer thread drains the rings to the files, so that a slow disk
+   does not hold up the event loop.  A file whose name ends in ".gz" is
+   written gzip compressed.  When a ring is full, packet and state records
+   are dropped and counted rather than wait for the disk; a routes dump
+   instead waits for room, walking the table a batch of nodes at a time.
+
+   The writer thread makes no logging or lib allocation calls, lib is not
+   thread safe: files are set up and freed by the main thread, which also
+   reports what the writer ran into.
+
+   The configuration is read before the daemon forks into the background,
+   and the thread would not survive it: files opened before bgp_dump_start()
+   is called have their records queued until then.  */
+
+#define BGP_DUMP_RING_SIZE	(4 * 1024 * 1024)	/* a power of 2 */
+
+/* Room a routes dump waits for before dumping a node; a node with very
+   many paths could take more, and have records dropped. */
+#define BGP_DUMP_ROUTES_ROOM	(BGP_DUMP_RING_SIZE / 4)
+
+/* Nodes a routes dump walks before going back to the event loop. */
+#define BGP_DUMP_ROUTES_BATCH	1000
+
+struct bgp_dump_file
+{
+  /* Main thread only. */
+  char *path;
+
+  /* Not changed while open. */
+  int fd;
+#ifdef HAVE_ZLIB
+  gzFile gz;
+#endif
+  u_char *buf;
+
+  /* The rest is under the writer mutex.  What is queued in the ring, and
+     the list of files for the writer. */
+  size_t head;
+  size_t len;
+  unsigned long long written;
+  int error;			/* of the first write that failed */
+  int closing;
+  int closed;
+  struct bgp_dump_file *next;
+};
+
+static struct
+{
+  pthread_t thread;
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  int started;
+  int running;
+  int stopping;
+
+  struct bgp_dump_file *files;
+
+  /* Main thread, frees the files the writer is done with. */
+  struct thread *t_reap;
+} writer =
+{
+  .mutex = PTHREAD_MUTEX_INITIALIZER,
+  .cond = PTHREAD_COND_INITIALIZER,
+};
+
 struct bgp_dump
 {
   enum bgp_dump_type type;
 
   char *filename;
 
-  FILE *fp;
+  struct bgp_dump_file *file;
 
   unsigned int interval;
 
   char *interval_str;
 
   struct thread *t_interval;
+
+  /* Records written and dropped since configured. */
+  unsigned long records;
+  unsigned long dropped;
+
+  /* A routes dump in progress. */
+  struct bgp *snap_bgp;
+  afi_t snap_afi;
+  struct bgp_table *snap_table;
+  struct bgp_node *snap_rn;
+  unsigned int snap_seq;
+  struct thread *t_snapshot;
 };
 
 static int bgp_dump_unset (struct vty *vty, struct bgp_dump *bgp_dump);
@@ -106,7 +190,272 @@ struct bgp_dump bgp_dump_updates;
 /* BGP dump structure for 'dump bgp routes' */
 struct bgp_dump bgp_dump_routes;
 
-static FILE *
+static int
+bgp_dump_file_write (struct bgp_dump_file *file, const u_char *p, size_t n)
+{
+  ssize_t ret;
+
+#ifdef HAVE_ZLIB
+  if (file->gz)
+    return gzwrite (file->gz, p, n) == (int) n ? 0 : EIO;
+#endif
+
+  while (n > 0)
+    {
+      ret = write (file->fd, p, n);
+      if (ret < 0)
+	{
+	  if (errno == EINTR)
+	    continue;
+	  return errno;
+	}
+      p += ret;
+      n -= ret;
+    }
+  return 0;
+}
+
+static void *
+bgp_dump_writer (void *arg)
+{
+  struct bgp_dump_file *file;
+  size_t n;
+  int busy;
+  int error;
+
+  pthread_mutex_lock (&writer.mutex);
+  for (;;)
+    {
+      busy = 0;
+
+      /* Files are only unlinked once closed, so the list can be followed
+         across the unlocked writes. */
+      for (file = writer.files; file; file = file->next)
+	{
+	  if (file->len)
+	    {
+	      n = MIN (file->len, BGP_DUMP_RING_SIZE - file->head);
+	      pthread_mutex_unlock (&writer.mutex);
+
+	      /* After an error, the rest is discarded. */
+	      error = file->error ? 0
+		: bgp_dump_file_write (file, file->buf + file->head, n);
+
+	      pthread_mutex_lock (&writer.mutex);
+	      file->head = (file->head + n) & (BGP_DUMP_RING_SIZE - 1);
+	      file->len -= n;
+	      if (error)
+		file->error = error;
+	      else if (!file->error)
+		file->written += n;
+	      busy = 1;
+	    }
+	  else if (file->closing && !file->closed)
+	    {
+	      pthread_mutex_unlock (&writer.mutex);
+#ifdef HAVE_ZLIB
+	      if (file->gz)
+		error = gzclose (file->gz) == Z_OK ? 0 : EIO;
+	      else
+#endif
+		error = close (file->fd) < 0 ? errno : 0;
+
+	      pthread_mutex_lock (&writer.mutex);
+	      if (error && !file->error)
+		file->error = error;
+	      file->closed = 1;
+	      busy = 1;
+	    }
+	}
+
+      if (!busy)
+	{
+	  if (writer.stopping)
+	    break;
+	  pthread_cond_wait (&writer.cond, &writer.mutex);
+	}
+    }
+  pthread_mutex_unlock (&writer.mutex);
+
+  return NULL;
+}
+
+static int
+bgp_dump_writer_start (void)
+{
+  sigset_t set, oset;
+  int ret;
+
+  if (writer.running)
+    return 0;
+
+  /* Signals are for the main thread. */
+  sigfillset (&set);
+  pthread_sigmask (SIG_SETMASK, &set, &oset);
+  writer.stopping = 0;
+  ret = pthread_create (&writer.thread, NULL, bgp_dump_writer, NULL);
+  pthread_sigmask (SIG_SETMASK, &oset, NULL);
+
+  if (ret)
+    {
+      zlog_err ("Can't create dump writer thread: %s", safe_strerror (ret));
+      return -1;
+    }
+
+  writer.running = 1;
+  return 0;
+}
+
+static void
+bgp_dump_file_free (struct bgp_dump_file *file)
+{
+  if (file->error)
+    zlog_warn ("bgp_dump: %s: %s", file->path, safe_strerror (file->error));
+
+  XFREE (MTYPE_BGP_DUMP_STR, file->path);
+  XFREE (MTYPE_BGP_DUMP_BUF, file->buf);
+  XFREE (MTYPE_BGP_DUMP, file);
+}
+
+/* Free the files the writer has closed. */
+static int
+bgp_dump_reap (struct thread *t)
+{
+  struct bgp_dump_file *file, **prev, *done = NULL;
+  int pending = 0;
+
+  writer.t_reap = NULL;
+
+  pthread_mutex_lock (&writer.mutex);
+  for (prev = &writer.files; (file = *prev) != NULL; )
+    {
+      if (file->closed)
+	{
+	  *prev = file->next;
+	  file->next = done;
+	  done = file;
+	  continue;
+	}
+      if (file->closing)
+	pending = 1;
+      prev = &file->next;
+    }
+  pthread_mutex_unlock (&writer.mutex);
+
+  while ((file = done) != NULL)
+    {
+      done = file->next;
+      bgp_dump_file_free (file);
+    }
+
+  if (pending)
+    writer.t_reap = thread_add_timer_msec (bm->master, bgp_dump_reap, NULL,
+                                           100);
+  return 0;
+}
+
+static struct bgp_dump_file *
+bgp_dump_file_new (const char *path)
+{
+  struct bgp_dump_file *file;
+  mode_t oldumask;
+  size_t len;
+  int fd;
+
+  if (writer.started && bgp_dump_writer_start () < 0)
+    return NULL;
+
+  oldumask = umask(0777 & ~LOGFILE_MASK);
+  fd = open (path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+  umask(oldumask);
+
+  if (fd < 0)
+    {
+      zlog_warn ("bgp_dump_open_file: %s: %s", path, safe_strerror (errno));
+      return NULL;
+    }
+
+  file = XCALLOC (MTYPE_BGP_DUMP, sizeof (struct bgp_dump_file));
+  file->path = XSTRDUP (MTYPE_BGP_DUMP_STR, path);
+  file->fd = fd;
+  file->buf = XMALLOC (MTYPE_BGP_DUMP_BUF, BGP_DUMP_RING_SIZE);
+
+  len = strlen (path);
+  if (len > 3 && strcmp (path + len - 3, ".gz") == 0)
+    {
+#ifdef HAVE_ZLIB
+      file->gz = gzdopen (fd, "wb");
+      if (file->gz == NULL)
+	zlog_warn ("bgp_dump_open_file: %s: can't compress, writing it as is",
+		   path);
+#else
+      zlog_warn ("bgp_dump_open_file: %s: built without zlib, writing it "
+		 "uncompressed", path);
+#endif
+    }
+
+  pthread_mutex_lock (&writer.mutex);
+  file->next = writer.files;
+  writer.files = file;
+  pthread_mutex_unlock (&writer.mutex);
+
+  return file;
+}
+
+/* Leave the file to the writer to finish, it is freed once closed. */
+static void
+bgp_dump_file_close (struct bgp_dump_file *file)
+{
+  pthread_mutex_lock (&writer.mutex);
+  file->closing = 1;
+  pthread_cond_signal (&writer.cond);
+  pthread_mutex_unlock (&writer.mutex);
+
+  if (!writer.t_reap)
+    writer.t_reap = thread_add_timer_msec (bm->master, bgp_dump_reap, NULL,
+                                           100);
+}
+
+static size_t
+bgp_dump_file_room (struct bgp_dump_file *file)
+{
+  size_t room;
+
+  pthread_mutex_lock (&writer.mutex);
+  room = BGP_DUMP_RING_SIZE - file->len;
+  pthread_mutex_unlock (&writer.mutex);
+
+  return room;
+}
+
+/* Queue the record in obuf to be written, or drop it if there is no room. */
+static void
+bgp_dump_put (struct bgp_dump *bgp_dump, struct stream *obuf)
+{
+  struct bgp_dump_file *file = bgp_dump->file;
+  size_t len = stream_get_endp (obuf);
+  size_t tail, n;
+
+  pthread_mutex_lock (&writer.mutex);
+  if (BGP_DUMP_RING_SIZE - file->len < len)
+    {
+      pthread_mutex_unlock (&writer.mutex);
+      bgp_dump->dropped++;
+      return;
+    }
+
+  tail = (file->head + file->len) & (BGP_DUMP_RING_SIZE - 1);
+  n = MIN (len, BGP_DUMP_RING_SIZE - tail);
+  memcpy (file->buf + tail, STREAM_DATA (obuf), n);
+  memcpy (file->buf, STREAM_DATA (obuf) + n, len - n);
+  file->len += len;
+  pthread_cond_signal (&writer.cond);
+  pthread_mutex_unlock (&writer.mutex);
+
+  bgp_dump->records++;
+}
+
+static struct bgp_dump_file *
 bgp_dump_open_file (struct bgp_dump *bgp_dump)
 {
   int ret;
@@ -114,7 +463,6 @@ bgp_dump_open_file (struct bgp_dump *bgp_dump)
   struct tm *tm;
   char fullpath[MAXPATHLEN];
   char realpath[MAXPATHLEN];
-  mode_t oldumask;
 
   time (&clock);
   tm = localtime (&clock);
@@ -133,22 +481,11 @@ bgp_dump_open_file (struct bgp_dump *bgp_dump)
       return NULL;
     }
 
-  if (bgp_dump->fp)
-    fclose (bgp_dump->fp);
+  if (bgp_dump->file)
+    bgp_dump_file_close (bgp_dump->file);
 
-
-  oldumask = umask(0777 & ~LOGFILE_MASK);
-  bgp_dump->fp = fopen (realpath, "w");
-
-  if (bgp_dump->fp == NULL)
-    {
-      zlog_warn ("bgp_dump_open_file: %s: %s", realpath, strerror (errno));
-      umask(oldumask);
-      return NULL;
-    }
-  umask(oldumask);  
-
-  return bgp_dump->fp;
+  bgp_dump->file = bgp_dump_file_new (realpath);
+  return bgp_dump->file;
 }
 
 static int
@@ -224,7 +561,7 @@ bgp_dump_set_size (struct stream *s, int type)
 }
 
 static void
-bgp_dump_routes_index_table(struct bgp *bgp)
+bgp_dump_routes_index_table(struct bgp_dump *bgp_dump, struct bgp *bgp)
 {
   struct peer *peer;
   struct listnode *node;
@@ -304,15 +641,15 @@ bgp_dump_routes_index_table(struct bgp *bgp)
 
   bgp_dump_set_size(obuf, MSG_TABLE_DUMP_V2);
 
-  fwrite (STREAM_DATA (obuf), stream_get_endp (obuf), 1, bgp_dump_routes.fp);
-  fflush (bgp_dump_routes.fp);
+  bgp_dump_put (bgp_dump, obuf);
 }
 
 
 static struct bgp_info *
-bgp_dump_route_node_record (int afi, struct bgp_node *rn,
-			    struct bgp_info *info, unsigned int seq)
+bgp_dump_route_node_record (struct bgp_dump *bgp_dump, struct bgp_node *rn,
+			    struct bgp_info *info)
 {
+  afi_t afi = bgp_dump->snap_afi;
   struct stream *obuf;
   size_t sizep;
   size_t endp;
@@ -329,7 +666,7 @@ bgp_dump_route_node_record (int afi, struct bgp_node *rn,
                      BGP_DUMP_ROUTES);
 
   /* Sequence number */
-  stream_putl (obuf, seq);
+  stream_putl (obuf, bgp_dump->snap_seq);
 
   /* Prefix length */
   stream_putc (obuf, rn->p.prefixlen);
@@ -360,6 +697,11 @@ bgp_dump_route_node_record (int afi, struct bgp_node *rn,
   {
     size_t cur_endp;
 
+    /* Peers that came up since the peer index table are left out. */
+    if (info->peer->table_dump_index == 0
+        && info->peer != bgp_dump->snap_bgp->peer_self)
+      continue;
+
     /* Peer index */
     stream_putw (obuf, info->peer->table_dump_index);
 
@@ -382,54 +724,131 @@ bgp_dump_route_node_record (int afi, struct bgp_node *rn,
     endp = cur_endp;
   }
 
+  if (entry_count == 0)
+    return info;
+
   /* Overwrite the entry count, now that we know the right number */
   stream_putw_at (obuf, sizep, entry_count);
 
   bgp_dump_set_size (obuf, MSG_TABLE_DUMP_V2);
-  fwrite (STREAM_DATA (obuf), stream_get_endp (obuf), 1, bgp_dump_routes.fp);
+  bgp_dump_put (bgp_dump, obuf);
+  bgp_dump->snap_seq++;
 
   return info;
 }
 
 
-/* Runs under child process. */
-static unsigned int
-bgp_dump_routes_func (int afi, int first_run, unsigned int seq)
+static void
+bgp_dump_routes_table (struct bgp_dump *bgp_dump, afi_t afi)
+{
+  bgp_dump->snap_afi = afi;
+  bgp_dump->snap_table = bgp_dump->snap_bgp->rib[afi][SAFI_UNICAST];
+  bgp_table_lock (bgp_dump->snap_table);
+  bgp_dump->snap_rn = bgp_table_top (bgp_dump->snap_table);
+}
+
+/* End a routes dump, finished or not.  There is no point in leaving the
+   file open until the next scheduled dump starts. */
+static void
+bgp_dump_routes_stop (struct bgp_dump *bgp_dump)
+{
+  THREAD_OFF (bgp_dump->t_snapshot);
+
+  if (bgp_dump->snap_rn)
+    bgp_unlock_node (bgp_dump->snap_rn);
+  if (bgp_dump->snap_table)
+    bgp_table_unlock (bgp_dump->snap_table);
+  bgp_dump->snap_rn = NULL;
+  bgp_dump->snap_table = NULL;
+  bgp_dump->snap_bgp = NULL;
+
+  if (bgp_dump->file)
+    bgp_dump_file_close (bgp_dump->file);
+  bgp_dump->file = NULL;
+}
+
+/* Dump a batch of nodes, from where the last batch stopped; the nodes
+   and table are kept locked in between. */
+static int
+bgp_dump_routes_func (struct thread *t)
 {
+  struct bgp_dump *bgp_dump;
   struct bgp_info *info;
-  struct bgp_node *rn;
-  struct bgp *bgp;
-  struct bgp_table *table;
+  int n;
 
-  bgp = bgp_get_default ();
-  if (!bgp)
-    return seq;
+  bgp_dump = THREAD_ARG (t);
+  bgp_dump->t_snapshot = NULL;
 
-  if (bgp_dump_routes.fp == NULL)
-    return seq;
+  for (n = 0; n < BGP_DUMP_ROUTES_BATCH; n++)
+    {
+      /* Wait for the writer rather than leave routes out. */
+      if (bgp_dump_file_room (bgp_dump->file) < BGP_DUMP_ROUTES_ROOM)
+	{
+	  bgp_dump->t_snapshot =
+	    thread_add_timer_msec (bm->master, bgp_dump_routes_func,
+				   bgp_dump, 10);
+	  return 0;
+	}
 
-  /* Note that bgp_dump_routes_index_table will do ipv4 and ipv6 peers,
-     so this should only be done on the first call to bgp_dump_routes_func.
-     ( this function will be called once for ipv4 and once for ipv6 ) */
-  if (first_run)
-    bgp_dump_routes_index_table(bgp);
+      if (bgp_dump->snap_rn == NULL)
+	{
+	  bgp_table_unlock (bgp_dump->snap_table);
+	  bgp_dump->snap_table = NULL;
 
-  /* Walk down each BGP route. */
-  table = bgp->rib[afi][SAFI_UNICAST];
+	  if (bgp_dump->snap_afi == AFI_IP)
+	    {
+	      bgp_dump_routes_table (bgp_dump, AFI_IP6);
+	      continue;
+	    }
 
-  for (rn = bgp_table_top (table); rn; rn = bgp_route_next (rn))
-    {
-      info = rn->info;
+	  bgp_dump_routes_stop (bgp_dump);
+	  return 0;
+	}
+
+      info = bgp_dump->snap_rn->info;
       while (info)
-      {
-        info = bgp_dump_route_node_record (afi, rn, info, seq);
-        seq++;
-      }
+	info = bgp_dump_route_node_record (bgp_dump, bgp_dump->snap_rn, info);
+
+      bgp_dump->snap_rn = bgp_route_next (bgp_dump->snap_rn);
     }
 
-  fflush (bgp_dump_routes.fp);
+  bgp_dump->t_snapshot = thread_add_event (bm->master, bgp_dump_routes_func,
+					   bgp_dump, 0);
+  return 0;
+}
 
-  return seq;
+static void
+bgp_dump_routes_start (struct bgp_dump *bgp_dump)
+{
+  struct bgp *bgp;
+
+  bgp = bgp_get_default ();
+  if (!bgp)
+    {
+      bgp_dump_routes_stop (bgp_dump);
+      return;
+    }
+
+  /* Note that bgp_dump_routes_index_table will do ipv4 and ipv6 peers,
+     so it is done once for both tables. */
+  bgp_dump_routes_index_table (bgp_dump, bgp);
+
+  bgp_dump->snap_bgp = bgp;
+  bgp_dump->snap_seq = 0;
+  bgp_dump_routes_table (bgp_dump, AFI_IP);
+  bgp_dump->t_snapshot = thread_add_event (bm->master, bgp_dump_routes_func,
+					   bgp_dump, 0);
+}
+
+/* The instance is going away, stop dumping it. */
+void
+bgp_dump_instance_delete (struct bgp *bgp)
+{
+  if (bgp_dump_routes.snap_bgp == bgp)
+    {
+      zlog_warn ("bgp_dump: routes dump stopped, the instance is deleted");
+      bgp_dump_routes_stop (&bgp_dump_routes);
+    }
 }
 
 static int
@@ -439,18 +858,16 @@ bgp_dump_interval_func (struct thread *t)
   bgp_dump = THREAD_ARG (t);
   bgp_dump->t_interval = NULL;
 
+  /* A routes dump still going on is left to finish. */
+  if (bgp_dump->snap_bgp)
+    zlog_warn ("bgp_dump: routes dump still in progress, skipping this one");
+
   /* Reschedule dump even if file couldn't be opened this time... */
-  if (bgp_dump_open_file (bgp_dump) != NULL)
+  else if (bgp_dump_open_file (bgp_dump) != NULL)
     {
       /* In case of bgp_dump_routes, we need special route dump function. */
       if (bgp_dump->type == BGP_DUMP_ROUTES)
-	{
-	  unsigned int seq = bgp_dump_routes_func (AFI_IP, 1, 0);
-	  bgp_dump_routes_func (AFI_IP6, 0, seq);
-	  /* Close the file now. For a RIB dump there's no point in leaving
-	   * it open until the next scheduled dump starts. */
-	  fclose(bgp_dump->fp); bgp_dump->fp = NULL;
-	}
+	bgp_dump_routes_start (bgp_dump);
     }
 
   /* if interval is set reschedule */
@@ -513,7 +930,7 @@ bgp_dump_state (struct peer *peer, int status_old, int status_new)
   struct stream *obuf;
 
   /* If dump file pointer is disabled return immediately. */
-  if (bgp_dump_all.fp == NULL)
+  if (bgp_dump_all.file == NULL)
     return;
 
   /* Make dump stream. */
@@ -531,8 +948,7 @@ bgp_dump_state (struct peer *peer, int status_old, int status_new)
   bgp_dump_set_size (obuf, MSG_PROTOCOL_BGP4MP);
 
   /* Write to the stream. */
-  fwrite (STREAM_DATA (obuf), stream_get_endp (obuf), 1, bgp_dump_all.fp);
-  fflush (bgp_dump_all.fp);
+  bgp_dump_put (&bgp_dump_all, obuf);
 }
 
 static void
@@ -542,7 +958,7 @@ bgp_dump_packet_func (struct bgp_dump *bgp_dump, struct peer *peer,
   struct stream *obuf;
 
   /* If dump file pointer is disabled return immediately. */
-  if (bgp_dump->fp == NULL)
+  if (bgp_dump->file == NULL)
     return;
 
   /* Make dump stream. */
@@ -569,8 +985,7 @@ bgp_dump_packet_func (struct bgp_dump *bgp_dump, struct peer *peer,
   bgp_dump_set_size (obuf, MSG_PROTOCOL_BGP4MP);
 
   /* Write to the stream. */
-  fwrite (STREAM_DATA (obuf), stream_get_endp (obuf), 1, bgp_dump->fp);
-  fflush (bgp_dump->fp);
+  bgp_dump_put (bgp_dump, obuf);
 }
 
 /* Called from bgp_packet.c when BGP packet is received. */
@@ -705,11 +1120,15 @@ bgp_dump_unset (struct vty *vty, struct bgp_dump *bgp_dump)
       bgp_dump->filename = NULL;
     }
 
+  /* Stopping a routes dump in progress. */
+  if (bgp_dump->snap_bgp)
+    bgp_dump_routes_stop (bgp_dump);
+
   /* Closing file. */
-  if (bgp_dump->fp)
+  if (bgp_dump->file)
     {
-      fclose (bgp_dump->fp);
-      bgp_dump->fp = NULL;
+      bgp_dump_file_close (bgp_dump->file);
+      bgp_dump->file = NULL;
     }
 
   /* Removing interval thread. */
@@ -720,6 +1139,8 @@ bgp_dump_unset (struct vty *vty, struct bgp_dump *bgp_dump)
     }
 
   bgp_dump->interval = 0;
+  bgp_dump->records = 0;
+  bgp_dump->dropped = 0;
 
   /* Removing interval string. */
   if (bgp_dump->interval_str)
@@ -820,6 +1241,66 @@ DEFUN (no_dump_bgp_all,
   return bgp_dump_unset (vty, bgp_dump_struct);
 }
 
+static void
+bgp_dump_show (struct vty *vty, struct bgp_dump *bgp_dump)
+{
+  const struct bgp_dump_type_map *map;
+  struct bgp_dump_file *file = bgp_dump->file;
+  unsigned long long written;
+  size_t queued;
+  int error;
+
+  if (!bgp_dump->filename)
+    return;
+
+  for (map = bgp_dump_type_map; map->str; map++)
+    if (map->type == bgp_dump->type)
+      break;
+
+  vty_out (vty, "dump bgp %s %s%s", map->str, bgp_dump->filename,
+	   VTY_NEWLINE);
+  vty_out (vty, "  %lu records, %lu dropped%s", bgp_dump->records,
+	   bgp_dump->dropped, VTY_NEWLINE);
+
+  if (file)
+    {
+      pthread_mutex_lock (&writer.mutex);
+      written = file->written;
+      queued = file->len;
+      error = file->error;
+      pthread_mutex_unlock (&writer.mutex);
+
+      vty_out (vty, "  Writing %s%s, %llu bytes written, %lu queued%s",
+	       file->path,
+#ifdef HAVE_ZLIB
+	       file->gz ? " (gzip)" : "",
+#else
+	       "",
+#endif
+	       written, (unsigned long) queued, VTY_NEWLINE);
+      if (error)
+	vty_out (vty, "  Write error: %s%s", safe_strerror (error),
+		 VTY_NEWLINE);
+    }
+
+  if (bgp_dump->snap_bgp)
+    vty_out (vty, "  Routes dump in progress, %s table, %u records so far%s",
+	     afi2str (bgp_dump->snap_afi), bgp_dump->snap_seq, VTY_NEWLINE);
+}
+
+DEFUN (show_dump_bgp,
+       show_dump_bgp_cmd,
+       "show dump bgp",
+       SHOW_STR
+       "Dump packet\n"
+       "BGP packet dump\n")
+{
+  bgp_dump_show (vty, &bgp_dump_all);
+  bgp_dump_show (vty, &bgp_dump_updates);
+  bgp_dump_show (vty, &bgp_dump_routes);
+  return CMD_SUCCESS;
+}
+
 /* BGP node structure. */
 static struct cmd_node bgp_dump_node =
 {
@@ -914,11 +1395,40 @@ bgp_dump_init (void)
 
   install_element (CONFIG_NODE, &dump_bgp_all_cmd);
   install_element (CONFIG_NODE, &no_dump_bgp_all_cmd);
+  install_element (VIEW_NODE, &show_dump_bgp_cmd);
+}
+
+/* Start writing the files, from now on. */
+void
+bgp_dump_start (void)
+{
+  writer.started = 1;
+  if (writer.files)
+    bgp_dump_writer_start ();
 }
 
 void
 bgp_dump_finish (void)
 {
+  bgp_dump_unset (NULL, &bgp_dump_all);
+  bgp_dump_unset (NULL, &bgp_dump_updates);
+  bgp_dump_unset (NULL, &bgp_dump_routes);
+
+  /* Let the writer finish with the files before stopping it. */
+  if (writer.running)
+    {
+      pthread_mutex_lock (&writer.mutex);
+      writer.stopping = 1;
+      pthread_cond_signal (&writer.cond);
+      pthread_mutex_unlock (&writer.mutex);
+
+      pthread_join (writer.thread, NULL);
+      writer.running = 0;
+    }
+
+  THREAD_OFF (writer.t_reap);
+  bgp_dump_reap (NULL);
+
   stream_free (bgp_dump_obuf);
   bgp_dump_obuf = NULL;
 }
@@ -63,7 +63,7 @@ struct as_filter
 
   enum as_filter_type type;
 
-  regex_t *reg;
+  struct bgp_asregex *reg;
   char *reg_str;
 };
 
@@ -79,8 +79,15 @@ struct as_list
 
   struct as_filter *head;
   struct as_filter *tail;
+
+  /* Changed whenever the filters do, and unique across lists; the key
+     of the results cached in struct aspath. */
+  u_int32_t gen;
 };
 
+/* Last AS path filter list generation given out. */
+static u_int32_t as_list_gen;
+
 /* ip as-path access-list 10 permit AS1. */
 
 static struct as_list_master as_list_master =
@@ -103,7 +110,7 @@ static void
 as_filter_free (struct as_filter *asfilter)
 {
   if (asfilter->reg)
-    bgp_regex_free (asfilter->reg);
+    bgp_asregex_free (asfilter->reg);
   if (asfilter->reg_str)
     XFREE (MTYPE_AS_FILTER_STR, asfilter->reg_str);
   XFREE (MTYPE_AS_FILTER, asfilter);
@@ -111,7 +118,8 @@ as_filter_free (struct as_filter *asfilter)
 
 /* Make new AS filter. */
 static struct as_filter *
-as_filter_make (regex_t *reg, const char *reg_str, enum as_filter_type type)
+as_filter_make (struct bgp_asregex *reg, const char *reg_str,
+		enum as_filter_type type)
 {
   struct as_filter *asfilter;
 
@@ -135,6 +143,15 @@ as_filter_lookup (struct as_list *aslist, const char *reg_str,
   return NULL;
 }
 
+/* The filters of the list changed; results cached for it are stale. */
+static void
+as_list_changed (struct as_list *aslist)
+{
+  if (++as_list_gen == 0)
+    as_list_gen = 1;
+  aslist->gen = as_list_gen;
+}
+
 static void
 as_list_filter_add (struct as_list *aslist, struct as_filter *asfilter)
 {
@@ -146,6 +163,7 @@ as_list_filter_add (struct as_list *aslist, struct as_filter *asfilter)
   else
     aslist->head = asfilter;
   aslist->tail = asfilter;
+  as_list_changed (aslist);
 
   /* Run hook function. */
   if (as_list_master.add_hook)
@@ -205,6 +223,7 @@ as_list_insert (const char *name)
   aslist = as_list_new ();
   aslist->name = XSTRDUP(MTYPE_AS_STR, name);
   assert (aslist->name);
+  as_list_changed (aslist);
 
   /* If name is made by all digit character.  We treat it as
      number. */
@@ -358,6 +377,7 @@ as_list_filter_delete (struct as_list *aslist, struct as_filter *asfilter)
     aslist->head = asfilter->next;
 
   as_filter_free (asfilter);
+  as_list_changed (aslist);
 
   /* If access_list becomes empty delete it from access_master. */
   if (as_list_empty (aslist))
@@ -373,9 +393,7 @@ as_list_filter_delete (struct as_list *aslist, struct as_filter *asfilter)
 static int
 as_filter_match (struct as_filter *asfilter, struct aspath *aspath)
 {
-  if (bgp_regexec (asfilter->reg, aspath) != REG_NOMATCH)
-    return 1;
-  return 0;
+  return bgp_asregex_match (asfilter->reg, aspath);
 }
 
 /* Apply AS path filter to AS. */
@@ -384,18 +402,32 @@ as_list_apply (struct as_list *aslist, void *object)
 {
   struct as_filter *asfilter;
   struct aspath *aspath;
+  enum as_filter_type type = AS_FILTER_DENY;
+  int slot;
 
   aspath = (struct aspath *) object;
 
   if (aslist == NULL)
     return AS_FILTER_DENY;
 
+  /* Interned paths are shared by many routes, each list is only run
+     once on them until either changes. */
+  slot = aslist->gen % ASPATH_FILTER_CACHE;
+  if (aspath->filter_cache[slot].gen == aslist->gen)
+    return aspath->filter_cache[slot].result;
+
   for (asfilter = aslist->head; asfilter; asfilter = asfilter->next)
     {
       if (as_filter_match (asfilter, aspath))
-	return asfilter->type;
+	{
+	  type = asfilter->type;
+	  break;
+	}
     }
-  return AS_FILTER_DENY;
+
+  aspath->filter_cache[slot].gen = aslist->gen;
+  aspath->filter_cache[slot].result = type;
+  return type;
 }
 
 /* Add hook function. */
@@ -441,7 +473,7 @@ DEFUN (ip_as_path,
   enum as_filter_type type;
   struct as_filter *asfilter;
   struct as_list *aslist;
-  regex_t *regex;
+  struct bgp_asregex *regex;
   char *regstr;
 
   /* Retrieve access list name */
@@ -454,7 +486,7 @@ DEFUN (ip_as_path,
   argv_find (argv, argc, "LINE", &idx);
   regstr = argv_concat(argv, argc, idx);
 
-  regex = bgp_regcomp (regstr);
+  regex = bgp_asregex_comp (regstr);
   if (!regex)
     {
       vty_out (vty, "can't compile regexp %s%s", regstr, VTY_NEWLINE);
@@ -495,7 +527,7 @@ DEFUN (no_ip_as_path,
   struct as_filter *asfilter;
   struct as_list *aslist;
   char *regstr;
-  regex_t *regex;
+  struct bgp_asregex *regex;
 
   char *aslistname = argv_find (argv, argc, "WORD", &idx) ? argv[idx]->arg : NULL;
 
@@ -523,7 +555,7 @@ DEFUN (no_ip_as_path,
   argv_find (argv, argc, "LINE", &idx);
   regstr = argv_concat(argv, argc, idx);
 
-  regex = bgp_regcomp (regstr);
+  regex = bgp_asregex_comp (regstr);
   if (!regex)
     {
       vty_out (vty, "can't compile regexp %s%s", regstr, VTY_NEWLINE);
@@ -535,7 +567,7 @@ DEFUN (no_ip_as_path,
   asfilter = as_filter_lookup (aslist, regstr, type);
 
   XFREE (MTYPE_TMP, regstr);
-  bgp_regex_free (regex);
+  bgp_asregex_free (regex);
 
   if (asfilter == NULL)
     {
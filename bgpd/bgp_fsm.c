@@ -53,6 +53,7 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "bgpd/bgp_nht.h"
 #include "bgpd/bgp_bfd.h"
 #include "bgpd/bgp_memory.h"
+#include "bgpd/bgp_io.h"
 
 /* Definition of display strings corresponding to FSM events. This should be
  * kept consistent with the events defined in bgpd.h
@@ -139,6 +140,7 @@ peer_xfer_conn(struct peer *from_peer)
   fd = peer->fd;
   peer->fd = from_peer->fd;
   from_peer->fd = fd;
+  bgp_io_xfer (peer, from_peer);
   stream_reset(peer->ibuf);
   stream_fifo_clean(peer->obuf);
   stream_fifo_clean(from_peer->obuf);
@@ -221,7 +223,8 @@ peer_xfer_conn(struct peer *from_peer)
         }
     }
 
-  BGP_READ_ON(peer->t_read, bgp_read, peer->fd);
+  if (!peer->io)
+    BGP_READ_ON(peer->t_read, bgp_read, peer->fd);
   BGP_WRITE_ON(peer->t_write, bgp_write, peer->fd);
 
   if (from_peer)
@@ -315,13 +318,16 @@ bgp_timer_set (struct peer *peer)
 	{
 	  BGP_TIMER_OFF (peer->t_holdtime);
 	  BGP_TIMER_OFF (peer->t_keepalive);
+	  bgp_io_keepalive (peer, 0);
 	}
       else
 	{
 	  BGP_TIMER_ON (peer->t_holdtime, bgp_holdtime_timer,
 			peer->v_holdtime);
-	  BGP_TIMER_ON (peer->t_keepalive, bgp_keepalive_timer, 
-			peer->v_keepalive);
+	  /* The I/O thread sends keepalives itself, if it has the socket. */
+	  if (bgp_io_keepalive (peer, peer->v_keepalive) < 0)
+	    BGP_TIMER_ON (peer->t_keepalive, bgp_keepalive_timer, 
+			  peer->v_keepalive);
 	}
       BGP_TIMER_OFF (peer->t_routeadv);
       break;
@@ -338,13 +344,15 @@ bgp_timer_set (struct peer *peer)
 	{
 	  BGP_TIMER_OFF (peer->t_holdtime);
 	  BGP_TIMER_OFF (peer->t_keepalive);
+	  bgp_io_keepalive (peer, 0);
 	}
       else
 	{
 	  BGP_TIMER_ON (peer->t_holdtime, bgp_holdtime_timer,
 			peer->v_holdtime);
-	  BGP_TIMER_ON (peer->t_keepalive, bgp_keepalive_timer,
-			peer->v_keepalive);
+	  if (bgp_io_keepalive (peer, peer->v_keepalive) < 0)
+	    BGP_TIMER_ON (peer->t_keepalive, bgp_keepalive_timer,
+			  peer->v_keepalive);
 	}
       break;
     case Deleted:
@@ -417,6 +425,20 @@ bgp_holdtime_timer (struct thread *thread)
   peer = THREAD_ARG (thread);
   peer->t_holdtime = NULL;
 
+  /* The I/O thread may have read messages the main thread has not got
+     round to yet; they count as well. */
+  if (peer->io)
+    {
+      time_t elapsed = monotime (NULL) - bgp_io_readtime (peer);
+
+      if (elapsed >= 0 && elapsed < peer->v_holdtime)
+	{
+	  BGP_TIMER_ON (peer->t_holdtime, bgp_holdtime_timer,
+			peer->v_holdtime - elapsed);
+	  return 0;
+	}
+    }
+
   if (bgp_debug_neighbor_events(peer))
     zlog_debug ("%s [FSM] Timer (holdtime timer expire)", peer->host);
 
@@ -1075,6 +1097,7 @@ bgp_stop (struct peer *peer)
   /* Stop read and write threads when exists. */
   BGP_READ_OFF (peer->t_read);
   BGP_WRITE_OFF (peer->t_write);
+  bgp_io_detach (peer);
 
   /* Stop all timers. */
   BGP_TIMER_OFF (peer->t_start);
@@ -1230,7 +1253,9 @@ bgp_connect_success (struct peer *peer)
       return -1;
     }
 
-  BGP_READ_ON (peer->t_read, bgp_read, peer->fd);
+  /* Hand the socket to the I/O thread, or read it here. */
+  if (bgp_io_attach (peer) < 0)
+    BGP_READ_ON (peer->t_read, bgp_read, peer->fd);
 
   if (bgp_debug_neighbor_events(peer))
     {
@@ -35,16 +35,28 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
       THREAD_READ_OFF(T);			\
   } while (0)
 
+/* With the I/O thread writing to the socket, bgp_write() only hands
+   packets over to it, so it need not wait for the socket. */
 #define BGP_WRITE_ON(T,F,V)			\
   do {						\
     if (!(T) && (peer->status != Deleted))	\
-      THREAD_WRITE_ON(bm->master,(T),(F),peer,(V)); \
+      {						\
+	if (peer->io)				\
+	  (T) = thread_add_event (bm->master, (F), peer, (V)); \
+	else					\
+	  THREAD_WRITE_ON(bm->master,(T),(F),peer,(V)); \
+      }						\
   } while (0)
 
 #define BGP_PEER_WRITE_ON(T,F,V, peer)			\
   do {							\
     if (!(T) && ((peer)->status != Deleted))		\
-      THREAD_WRITE_ON(bm->master,(T),(F),(peer),(V));	\
+      {							\
+	if ((peer)->io)					\
+	  (T) = thread_add_event (bm->master, (F), (peer), (V)); \
+	else						\
+	  THREAD_WRITE_ON(bm->master,(T),(F),(peer),(V));	\
+      }							\
   } while (0)
 
 #define BGP_WRITE_OFF(T)			\
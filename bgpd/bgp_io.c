@@ -0,0 +1,966 @@
+/* BGP peer socket I/O thread
+ *
+ * This file is part of GNU Zebra.
+ *
+ * GNU Zebra is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * GNU Zebra is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Zebra; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+/*
+ * Once a peer's TCP connection is up, its socket is handed to a separate
+ * pthread, so that a busy main thread neither holds up keepalives nor
+ * leaves received messages unread until the hold timer runs out.
+ *
+ * The I/O thread reads ahead into a ring buffer per peer and frames the
+ * input into BGP messages; the main thread copies complete messages out
+ * one at a time into peer->ibuf and processes them as before.  Packets
+ * queued on peer->obuf are handed over to the I/O thread, which writes
+ * them and hands them back to be counted and freed.  Keepalives are sent
+ * by the I/O thread itself, on the peer's keepalive interval.  A pipe
+ * wakes the main thread when a peer has something for it.
+ *
+ * The I/O thread makes no logging or allocation calls, since lib is not
+ * thread safe.  All state shared with it is protected by a single mutex.
+ * A connection is only taken out of the I/O thread's list while it is
+ * paused between two passes, so a connection is never freed under it.
+ *
+ * NOTIFICATIONs are written by the main thread, after taking the socket
+ * back from the I/O thread.
+ */
+
+#include <zebra.h>
+#include <pthread.h>
+#include <poll.h>
+
+#include "log.h"
+#include "memory.h"
+#include "thread.h"
+#include "stream.h"
+#include "network.h"
+
+#include "bgpd/bgpd.h"
+#include "bgpd/bgp_attr.h"
+#include "bgpd/bgp_fsm.h"
+#include "bgpd/bgp_packet.h"
+#include "bgpd/bgp_memory.h"
+#include "bgpd/bgp_io.h"
+
+#define BGP_IO_IBUF_MASK (BGP_IO_IBUF_SIZE - 1)
+
+/* Packets written with one writev(). */
+#define BGP_IO_IOV_MAX 64
+
+struct bgp_io
+{
+  /* Main thread only. */
+  struct peer *peer;
+  int rx_reported;
+  int tx_reported;
+
+  /* Not changed while attached. */
+  int fd;
+  u_char *ibuf;
+
+  /* The rest is under the mutex.  The list of connections, and whether
+     the connection is waiting for the main thread. */
+  struct bgp_io *next;
+  struct bgp_io *prev;
+  struct bgp_io *rnext;
+  int queued;
+
+  /* Input.  Positions are byte counts into ibuf: the I/O thread reads
+     up to rx_in and frames complete messages up to rx_framed, and the
+     main thread takes them up to rx_out. */
+  unsigned long rx_in;
+  unsigned long rx_framed;
+  unsigned long rx_out;
+  int rx_error;		/* errno, or -1 once the peer closed */
+  int rx_bad;		/* a header at rx_framed has a bad length */
+  int rx_stalled;	/* ibuf is full */
+  time_t readtime;	/* when a message was last framed */
+
+  /* Output.  Packets to write, the first of which may be partly
+     written, and packets written. */
+  struct stream_fifo obuf;
+  struct stream_fifo sent;
+  int tx_partial;
+  int tx_error;
+  int tx_want;		/* the main thread waits for room in obuf */
+  int tx_ready;
+
+  /* Keepalives. */
+  unsigned int keepalive;
+  struct timeval keepalive_next;
+  int ka_pending;
+  size_t ka_pos;
+  u_int32_t keepalives;
+};
+
+static struct
+{
+  int off;
+  int running;
+  pthread_t thread;
+
+  /* Shared with the I/O thread, under the mutex. */
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  int stopping;
+  int pause;
+  int busy;
+  struct bgp_io *conns;
+  unsigned int nconns;
+  struct bgp_io *ready_head, *ready_tail;
+  unsigned int nready;
+  int wake_main;
+
+  /* The I/O thread's poll set; only resized while it is paused. */
+  struct pollfd *pfds;
+  struct bgp_io **polled;
+  unsigned int size;
+
+  /* Main thread only. */
+  int kick[2];
+  int wakeup[2];
+  struct thread *t_wakeup;
+  struct thread *t_serve;
+} pool =
+{
+  .mutex = PTHREAD_MUTEX_INITIALIZER,
+  .cond = PTHREAD_COND_INITIALIZER,
+  .kick = { -1, -1 },
+  .wakeup = { -1, -1 },
+};
+
+static const u_char bgp_io_keepalive_pkt[BGP_HEADER_SIZE] =
+{
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0x00, BGP_HEADER_SIZE, BGP_MSG_KEEPALIVE,
+};
+
+static void
+bgp_io_kick (void)
+{
+  /* If the pipe is full the I/O thread is awake anyway. */
+  (void) write (pool.kick[1], "", 1);
+}
+
+/* Queue a connection for the main thread.  Called with the mutex held. */
+static void
+bgp_io_ready (struct bgp_io *io)
+{
+  if (io->queued)
+    return;
+
+  io->queued = 1;
+  io->rnext = NULL;
+  if (pool.ready_tail)
+    pool.ready_tail->rnext = io;
+  else
+    {
+      pool.ready_head = io;
+      pool.wake_main = 1;
+    }
+  pool.ready_tail = io;
+  pool.nready++;
+}
+
+static void
+bgp_fifo_move (struct stream_fifo *to, struct stream_fifo *from)
+{
+  if (!from->head)
+    return;
+
+  if (to->tail)
+    to->tail->next = from->head;
+  else
+    to->head = from->head;
+  to->tail = from->tail;
+  to->count += from->count;
+  memset (from, 0, sizeof (*from));
+}
+
+static u_int16_t
+bgp_io_ibuf_getw (struct bgp_io *io, unsigned long pos)
+{
+  return (io->ibuf[pos & BGP_IO_IBUF_MASK] << 8)
+         | io->ibuf[(pos + 1) & BGP_IO_IBUF_MASK];
+}
+
+/* Read what the socket has, and frame it. */
+static void
+bgp_io_do_read (struct bgp_io *io)
+{
+  struct iovec iov[2];
+  unsigned long in, space, off;
+  int cnt = 1, framed = 0;
+  ssize_t nbytes;
+  u_int16_t size;
+
+  pthread_mutex_lock (&pool.mutex);
+  in = io->rx_in;
+  space = BGP_IO_IBUF_SIZE - (in - io->rx_out);
+  pthread_mutex_unlock (&pool.mutex);
+
+  if (!space)
+    return;
+
+  off = in & BGP_IO_IBUF_MASK;
+  iov[0].iov_base = io->ibuf + off;
+  iov[0].iov_len = MIN (space, BGP_IO_IBUF_SIZE - off);
+  if (iov[0].iov_len < space)
+    {
+      iov[1].iov_base = io->ibuf;
+      iov[1].iov_len = space - iov[0].iov_len;
+      cnt = 2;
+    }
+
+  nbytes = readv (io->fd, iov, cnt);
+  if (nbytes < 0 && ERRNO_IO_RETRY (errno))
+    return;
+
+  pthread_mutex_lock (&pool.mutex);
+  if (nbytes <= 0)
+    io->rx_error = nbytes ? errno : -1;
+  else
+    {
+      io->rx_in += nbytes;
+      while (io->rx_in - io->rx_framed >= BGP_HEADER_SIZE)
+        {
+          size = bgp_io_ibuf_getw (io, io->rx_framed + BGP_MARKER_SIZE);
+          if (size < BGP_HEADER_SIZE || size > BGP_MAX_PACKET_SIZE)
+            {
+              io->rx_bad = 1;
+              break;
+            }
+          if (io->rx_in - io->rx_framed < size)
+            break;
+          io->rx_framed += size;
+          framed = 1;
+        }
+      if (framed)
+        io->readtime = monotime (NULL);
+    }
+  if (framed || io->rx_error || io->rx_bad)
+    bgp_io_ready (io);
+  pthread_mutex_unlock (&pool.mutex);
+}
+
+/* Write as much of the queued packets as the socket takes. */
+static void
+bgp_io_do_write (struct bgp_io *io)
+{
+  struct iovec iov[BGP_IO_IOV_MAX];
+  struct stream *s;
+  ssize_t nbytes;
+  size_t left;
+  int cnt = 0, done = 0;
+
+  pthread_mutex_lock (&pool.mutex);
+  if (io->ka_pending)
+    {
+      iov[cnt].iov_base = (void *) (bgp_io_keepalive_pkt + io->ka_pos);
+      iov[cnt++].iov_len = BGP_HEADER_SIZE - io->ka_pos;
+    }
+  for (s = io->obuf.head; s && cnt < BGP_IO_IOV_MAX; s = s->next)
+    {
+      iov[cnt].iov_base = STREAM_PNT (s);
+      iov[cnt++].iov_len = stream_get_endp (s) - stream_get_getp (s);
+    }
+  pthread_mutex_unlock (&pool.mutex);
+
+  if (!cnt)
+    return;
+
+  nbytes = writev (io->fd, iov, cnt);
+  if (nbytes < 0 && ERRNO_IO_RETRY (errno))
+    return;
+
+  pthread_mutex_lock (&pool.mutex);
+  if (nbytes < 0)
+    {
+      io->tx_error = errno;
+      bgp_io_ready (io);
+      pthread_mutex_unlock (&pool.mutex);
+      return;
+    }
+
+  if (io->ka_pending)
+    {
+      left = MIN ((size_t) nbytes, BGP_HEADER_SIZE - io->ka_pos);
+      io->ka_pos += left;
+      nbytes -= left;
+      if (io->ka_pos == BGP_HEADER_SIZE)
+        {
+          io->ka_pending = 0;
+          io->keepalives++;
+          done = 1;
+        }
+    }
+
+  while (nbytes > 0 && (s = io->obuf.head))
+    {
+      left = stream_get_endp (s) - stream_get_getp (s);
+      if ((size_t) nbytes < left)
+        {
+          stream_forward_getp (s, nbytes);
+          io->tx_partial = 1;
+          break;
+        }
+      nbytes -= left;
+      stream_fifo_pop (&io->obuf);
+      s->next = NULL;
+      stream_fifo_push (&io->sent, s);
+      io->tx_partial = 0;
+      done = 1;
+    }
+
+  if (io->tx_want && io->obuf.count <= BGP_IO_OBUF_MAX / 2)
+    {
+      io->tx_want = 0;
+      io->tx_ready = 1;
+      done = 1;
+    }
+  if (done)
+    bgp_io_ready (io);
+  pthread_mutex_unlock (&pool.mutex);
+}
+
+/* Queue the keepalives that are due, and return the milliseconds until
+   the next one.  Called with the mutex held. */
+static int
+bgp_io_keepalives (void)
+{
+  struct bgp_io *io;
+  struct timeval now, next;
+  int64_t wait, timeout = -1;
+
+  monotime (&now);
+  for (io = pool.conns; io; io = io->next)
+    {
+      if (!io->keepalive || io->tx_error)
+        continue;
+
+      if (timercmp (&now, &io->keepalive_next, >=))
+        {
+          /* Not in the middle of another packet, and if packets are
+             waiting to be written they will do as well. */
+          if (!io->ka_pending && !io->tx_partial)
+            {
+              io->ka_pending = 1;
+              io->ka_pos = 0;
+            }
+          next.tv_sec = io->keepalive;
+          next.tv_usec = 0;
+          timeradd (&now, &next, &io->keepalive_next);
+        }
+
+      timersub (&io->keepalive_next, &now, &next);
+      wait = next.tv_sec * 1000 + next.tv_usec / 1000 + 1;
+      if (timeout < 0 || wait < timeout)
+        timeout = wait;
+    }
+
+  return timeout;
+}
+
+static void *
+bgp_io_thread (void *arg)
+{
+  struct bgp_io *io;
+  unsigned int n, i;
+  int timeout, wake;
+  char buf[64];
+
+  pthread_mutex_lock (&pool.mutex);
+  for (;;)
+    {
+      while (pool.pause && !pool.stopping)
+        pthread_cond_wait (&pool.cond, &pool.mutex);
+      if (pool.stopping)
+        break;
+      pool.busy = 1;
+
+      timeout = bgp_io_keepalives ();
+
+      n = 0;
+      for (io = pool.conns; io; io = io->next)
+        {
+          short events = 0;
+
+          io->rx_stalled = 0;
+          if (!io->rx_error && !io->rx_bad)
+            {
+              if (io->rx_in - io->rx_out < BGP_IO_IBUF_SIZE)
+                events |= POLLIN;
+              else
+                io->rx_stalled = 1;
+            }
+          if (!io->tx_error && (io->ka_pending || io->obuf.head))
+            events |= POLLOUT;
+          if (!events)
+            continue;
+
+          pool.pfds[n].fd = io->fd;
+          pool.pfds[n].events = events;
+          pool.pfds[n].revents = 0;
+          pool.polled[n++] = io;
+        }
+      pool.pfds[n].fd = pool.kick[0];
+      pool.pfds[n].events = POLLIN;
+      pool.pfds[n].revents = 0;
+      pthread_mutex_unlock (&pool.mutex);
+
+      if (poll (pool.pfds, n + 1, timeout) > 0)
+        {
+          if (pool.pfds[n].revents)
+            while (read (pool.kick[0], buf, sizeof buf) > 0)
+              ;
+
+          for (i = 0; i < n; i++)
+            {
+              short revents = pool.pfds[i].revents;
+
+              if (!revents)
+                continue;
+              if (pool.pfds[i].events & POLLIN
+                  && revents & (POLLIN | POLLHUP | POLLERR))
+                bgp_io_do_read (pool.polled[i]);
+              if (pool.pfds[i].events & POLLOUT
+                  && revents & (POLLOUT | POLLHUP | POLLERR))
+                bgp_io_do_write (pool.polled[i]);
+            }
+        }
+
+      pthread_mutex_lock (&pool.mutex);
+      pool.busy = 0;
+      pthread_cond_broadcast (&pool.cond);
+      wake = pool.wake_main;
+      pool.wake_main = 0;
+      if (wake)
+        {
+          pthread_mutex_unlock (&pool.mutex);
+          (void) write (pool.wakeup[1], "", 1);
+          pthread_mutex_lock (&pool.mutex);
+        }
+    }
+  pthread_mutex_unlock (&pool.mutex);
+
+  return NULL;
+}
+
+/* Keep the I/O thread between two passes, and take the mutex. */
+static void
+bgp_io_pause (void)
+{
+  pthread_mutex_lock (&pool.mutex);
+  if (!pool.running)
+    return;
+
+  pool.pause++;
+  bgp_io_kick ();
+  while (pool.busy)
+    pthread_cond_wait (&pool.cond, &pool.mutex);
+}
+
+static void
+bgp_io_resume (void)
+{
+  if (pool.running)
+    {
+      pool.pause--;
+      pthread_cond_broadcast (&pool.cond);
+    }
+  pthread_mutex_unlock (&pool.mutex);
+}
+
+/* Deal with what the I/O thread did for a peer. */
+static void
+bgp_io_service (struct bgp_io *io)
+{
+  struct peer *peer = io->peer;
+  struct stream_fifo sent;
+  u_int32_t keepalives;
+  int tx_error, tx_ready;
+
+  pthread_mutex_lock (&pool.mutex);
+  sent = io->sent;
+  memset (&io->sent, 0, sizeof (io->sent));
+  keepalives = io->keepalives;
+  io->keepalives = 0;
+  tx_error = io->tx_error;
+  tx_ready = io->tx_ready;
+  io->tx_ready = 0;
+  pthread_mutex_unlock (&pool.mutex);
+
+  peer_lock (peer);
+
+  bgp_write_done (peer, &sent, keepalives);
+
+  if (tx_error)
+    {
+      if (!io->tx_reported)
+        {
+          io->tx_reported = 1;
+          BGP_EVENT_ADD (peer, TCP_fatal_error);
+        }
+    }
+  else
+    {
+      if (tx_ready)
+        BGP_WRITE_ON (peer->t_write, bgp_write, peer->fd);
+
+      /* Packets are left for later, after the events they raised. */
+      if (bgp_read_io (peer))
+        {
+          pthread_mutex_lock (&pool.mutex);
+          bgp_io_ready (io);
+          pthread_mutex_unlock (&pool.mutex);
+        }
+    }
+
+  peer_unlock (peer);
+}
+
+static int bgp_io_serve_event (struct thread *);
+
+/* Serve the peers that were waiting when this was called; the ones that
+   come back are served after the events queued meanwhile. */
+static void
+bgp_io_serve (void)
+{
+  struct bgp_io *io;
+  unsigned int count;
+  int more;
+
+  pthread_mutex_lock (&pool.mutex);
+  count = pool.nready;
+  pthread_mutex_unlock (&pool.mutex);
+
+  while (count--)
+    {
+      pthread_mutex_lock (&pool.mutex);
+      io = pool.ready_head;
+      if (io)
+        {
+          pool.ready_head = io->rnext;
+          if (!pool.ready_head)
+            pool.ready_tail = NULL;
+          pool.nready--;
+          io->queued = 0;
+        }
+      pthread_mutex_unlock (&pool.mutex);
+
+      if (!io)
+        break;
+      bgp_io_service (io);
+    }
+
+  pthread_mutex_lock (&pool.mutex);
+  more = (pool.ready_head != NULL);
+  pthread_mutex_unlock (&pool.mutex);
+
+  if (more && !pool.t_serve)
+    pool.t_serve = thread_add_event (bm->master, bgp_io_serve_event, NULL, 0);
+}
+
+static int
+bgp_io_serve_event (struct thread *thread)
+{
+  pool.t_serve = NULL;
+  bgp_io_serve ();
+  return 0;
+}
+
+static int
+bgp_io_wakeup (struct thread *thread)
+{
+  char buf[64];
+
+  pool.t_wakeup = NULL;
+
+  while (read (pool.wakeup[0], buf, sizeof buf) > 0)
+    ;
+
+  bgp_io_serve ();
+
+  pool.t_wakeup = thread_add_read (bm->master, bgp_io_wakeup, NULL,
+                                   pool.wakeup[0]);
+  return 0;
+}
+
+/* Give a connection to another peer; messages it has read and not yet
+   processed are processed for that peer. */
+static void
+bgp_io_requeue (struct bgp_io *io, struct peer *peer)
+{
+  io->peer = peer;
+
+  pthread_mutex_lock (&pool.mutex);
+  if (io->rx_framed != io->rx_out || io->rx_error || io->rx_bad == 1)
+    bgp_io_ready (io);
+  pthread_mutex_unlock (&pool.mutex);
+
+  if (!pool.t_serve)
+    pool.t_serve = thread_add_event (bm->master, bgp_io_serve_event, NULL, 0);
+}
+
+/* Hand the peer's socket over to the I/O thread.  Returns -1 if it is
+   not running, and the main thread is to do the I/O itself. */
+int
+bgp_io_attach (struct peer *peer)
+{
+  struct bgp_io *io;
+
+  if (!pool.running)
+    return -1;
+
+  if (peer->io)
+    return 0;
+
+  io = XCALLOC (MTYPE_BGP_IO, sizeof (struct bgp_io));
+  io->ibuf = XMALLOC (MTYPE_BGP_IO_BUF, BGP_IO_IBUF_SIZE);
+  io->peer = peer;
+  io->fd = peer->fd;
+
+  BGP_READ_OFF (peer->t_read);
+  BGP_WRITE_OFF (peer->t_write);
+
+  bgp_io_pause ();
+  if (pool.size < pool.nconns + 2)
+    {
+      pool.size = MAX (pool.size * 2, 64U);
+      pool.pfds = XREALLOC (MTYPE_BGP_IO, pool.pfds,
+                            pool.size * sizeof (struct pollfd));
+      pool.polled = XREALLOC (MTYPE_BGP_IO, pool.polled,
+                              pool.size * sizeof (struct bgp_io *));
+    }
+  io->next = pool.conns;
+  if (pool.conns)
+    pool.conns->prev = io;
+  pool.conns = io;
+  pool.nconns++;
+  bgp_io_resume ();
+
+  peer->io = io;
+  return 0;
+}
+
+/* Take the peer's socket back from the I/O thread.  Input not yet
+   processed and packets not yet written are dropped. */
+void
+bgp_io_detach (struct peer *peer)
+{
+  struct bgp_io *io = peer->io;
+  struct bgp_io **prevp;
+  struct stream_fifo sent;
+  struct stream *s;
+  u_int32_t keepalives;
+
+  if (!io)
+    return;
+
+  bgp_io_pause ();
+  if (io->prev)
+    io->prev->next = io->next;
+  else
+    pool.conns = io->next;
+  if (io->next)
+    io->next->prev = io->prev;
+  pool.nconns--;
+
+  if (io->queued)
+    {
+      struct bgp_io *last = NULL;
+
+      for (prevp = &pool.ready_head; *prevp != io; prevp = &(*prevp)->rnext)
+        last = *prevp;
+      *prevp = io->rnext;
+      if (pool.ready_tail == io)
+        pool.ready_tail = last;
+      pool.nready--;
+    }
+
+  sent = io->sent;
+  keepalives = io->keepalives;
+  bgp_io_resume ();
+
+  peer->io = NULL;
+  bgp_write_done (peer, &sent, keepalives);
+
+  while ((s = stream_fifo_pop (&io->obuf)))
+    stream_free (s);
+  XFREE (MTYPE_BGP_IO_BUF, io->ibuf);
+  XFREE (MTYPE_BGP_IO, io);
+}
+
+/* The connections of two peers are swapped, see peer_xfer_conn(). */
+void
+bgp_io_xfer (struct peer *peer, struct peer *from_peer)
+{
+  struct bgp_io *io = peer->io;
+
+  peer->io = from_peer->io;
+  from_peer->io = io;
+  if (peer->io)
+    bgp_io_requeue (peer->io, peer);
+  if (from_peer->io)
+    bgp_io_requeue (from_peer->io, from_peer);
+}
+
+/* Have the I/O thread send keepalives every interval seconds, or none.
+   Returns -1 if the peer's socket is not with the I/O thread. */
+int
+bgp_io_keepalive (struct peer *peer, unsigned int interval)
+{
+  struct bgp_io *io = peer->io;
+  struct timeval tv;
+
+  if (!io)
+    return -1;
+
+  pthread_mutex_lock (&pool.mutex);
+  if (io->keepalive != interval)
+    {
+      io->keepalive = interval;
+      monotime (&io->keepalive_next);
+      tv.tv_sec = interval;
+      tv.tv_usec = 0;
+      timeradd (&io->keepalive_next, &tv, &io->keepalive_next);
+      bgp_io_kick ();
+    }
+  pthread_mutex_unlock (&pool.mutex);
+  return 0;
+}
+
+/* Hand the packets queued on peer->obuf over to the I/O thread. */
+void
+bgp_io_write (struct peer *peer)
+{
+  struct bgp_io *io = peer->io;
+  int kick;
+
+  if (!peer->obuf->head)
+    return;
+
+  pthread_mutex_lock (&pool.mutex);
+  kick = !io->obuf.head && !io->ka_pending;
+  bgp_fifo_move (&io->obuf, peer->obuf);
+  if (kick)
+    bgp_io_kick ();
+  pthread_mutex_unlock (&pool.mutex);
+}
+
+/* Whether the I/O thread has enough packets to write for now.  If so,
+   the peer is served with tx_ready once it has room again. */
+int
+bgp_io_write_full (struct peer *peer)
+{
+  struct bgp_io *io = peer->io;
+  int full;
+
+  pthread_mutex_lock (&pool.mutex);
+  full = (io->obuf.count >= BGP_IO_OBUF_MAX);
+  if (full)
+    io->tx_want = 1;
+  pthread_mutex_unlock (&pool.mutex);
+  return full;
+}
+
+/* Copy the next message read for the peer into s.  Returns its size, 0
+   if there is none yet, or -1 once if the connection failed, with errno
+   set, to 0 if the peer closed it.  If the I/O thread found a header
+   with a bad length, the header alone is returned. */
+int
+bgp_io_read (struct peer *peer, struct stream *s)
+{
+  struct bgp_io *io = peer->io;
+  unsigned long out;
+  size_t size, off, len;
+  int error = 0, kick;
+
+  pthread_mutex_lock (&pool.mutex);
+  out = io->rx_out;
+  if (io->rx_framed != out)
+    size = bgp_io_ibuf_getw (io, out + BGP_MARKER_SIZE);
+  else if (io->rx_bad == 1)
+    {
+      size = BGP_HEADER_SIZE;
+      io->rx_bad = 2;
+    }
+  else
+    {
+      size = 0;
+      if (io->rx_error && !io->rx_reported)
+        {
+          io->rx_reported = 1;
+          error = (io->rx_error > 0) ? io->rx_error : 0;
+          size = -1;
+        }
+    }
+  pthread_mutex_unlock (&pool.mutex);
+
+  if (size == 0 || size == (size_t) -1)
+    {
+      errno = error;
+      return size;
+    }
+
+  off = out & BGP_IO_IBUF_MASK;
+  len = MIN (size, BGP_IO_IBUF_SIZE - off);
+  stream_put (s, io->ibuf + off, len);
+  if (len < size)
+    stream_put (s, io->ibuf, size - len);
+
+  pthread_mutex_lock (&pool.mutex);
+  io->rx_out += size;
+  kick = io->rx_stalled;
+  io->rx_stalled = 0;
+  if (kick)
+    bgp_io_kick ();
+  pthread_mutex_unlock (&pool.mutex);
+
+  return size;
+}
+
+/* When the I/O thread last read a complete message from the peer. */
+time_t
+bgp_io_readtime (struct peer *peer)
+{
+  time_t readtime;
+
+  pthread_mutex_lock (&pool.mutex);
+  readtime = peer->io->readtime;
+  pthread_mutex_unlock (&pool.mutex);
+  return readtime;
+}
+
+/* Packets with the I/O thread yet to be written. */
+unsigned long
+bgp_io_outq (struct peer *peer)
+{
+  unsigned long count;
+
+  if (!peer->io)
+    return 0;
+
+  pthread_mutex_lock (&pool.mutex);
+  count = peer->io->obuf.count;
+  pthread_mutex_unlock (&pool.mutex);
+  return count;
+}
+
+/* Whether to use the I/O thread; must be called before bgp_io_start(). */
+int
+bgp_io_set (const char *arg)
+{
+  if (strcmp (arg, "on") == 0)
+    pool.off = 0;
+  else if (strcmp (arg, "off") == 0)
+    pool.off = 1;
+  else
+    return -1;
+  return 0;
+}
+
+int
+bgp_io_running (void)
+{
+  return pool.running;
+}
+
+void
+bgp_io_start (void)
+{
+  sigset_t set, oset;
+  int ret;
+
+  if (pool.running || pool.off)
+    return;
+
+  if (pipe (pool.kick) < 0)
+    {
+      zlog_err ("Can't create I/O thread pipe: %s", safe_strerror (errno));
+      return;
+    }
+  if (pipe (pool.wakeup) < 0)
+    {
+      zlog_err ("Can't create I/O thread pipe: %s", safe_strerror (errno));
+      close (pool.kick[0]);
+      close (pool.kick[1]);
+      return;
+    }
+  set_nonblocking (pool.kick[0]);
+  set_nonblocking (pool.kick[1]);
+  set_nonblocking (pool.wakeup[0]);
+  set_nonblocking (pool.wakeup[1]);
+
+  pool.size = 64;
+  pool.pfds = XCALLOC (MTYPE_BGP_IO, pool.size * sizeof (struct pollfd));
+  pool.polled = XCALLOC (MTYPE_BGP_IO, pool.size * sizeof (struct bgp_io *));
+
+  /* Signals are for the main thread. */
+  sigfillset (&set);
+  pthread_sigmask (SIG_SETMASK, &set, &oset);
+  pool.stopping = 0;
+  ret = pthread_create (&pool.thread, NULL, bgp_io_thread, NULL);
+  pthread_sigmask (SIG_SETMASK, &oset, NULL);
+
+  if (ret)
+    {
+      zlog_err ("Can't create I/O thread: %s", safe_strerror (ret));
+      close (pool.kick[0]);
+      close (pool.kick[1]);
+      close (pool.wakeup[0]);
+      close (pool.wakeup[1]);
+      XFREE (MTYPE_BGP_IO, pool.pfds);
+      XFREE (MTYPE_BGP_IO, pool.polled);
+      pool.size = 0;
+      return;
+    }
+
+  pool.running = 1;
+  pool.t_wakeup = thread_add_read (bm->master, bgp_io_wakeup, NULL,
+                                   pool.wakeup[0]);
+
+  zlog_info ("Peer I/O thread started");
+}
+
+/* Stop the I/O thread; peers must have been detached by now. */
+void
+bgp_io_stop (void)
+{
+  if (!pool.running)
+    return;
+
+  pthread_mutex_lock (&pool.mutex);
+  pool.stopping = 1;
+  bgp_io_kick ();
+  pthread_mutex_unlock (&pool.mutex);
+
+  pthread_join (pool.thread, NULL);
+  pool.running = 0;
+
+  THREAD_OFF (pool.t_wakeup);
+  THREAD_OFF (pool.t_serve);
+  close (pool.kick[0]);
+  close (pool.kick[1]);
+  close (pool.wakeup[0]);
+  close (pool.wakeup[1]);
+  XFREE (MTYPE_BGP_IO, pool.pfds);
+  XFREE (MTYPE_BGP_IO, pool.polled);
+  pool.size = 0;
+}
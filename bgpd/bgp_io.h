@@ -0,0 +1,47 @@
+/* BGP peer socket I/O thread
+ *
+ * This file is part of GNU Zebra.
+ *
+ * GNU Zebra is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * GNU Zebra is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Zebra; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#ifndef _QUAGGA_BGP_IO_H
+#define _QUAGGA_BGP_IO_H
+
+/* Bytes of input read ahead per peer; a power of two. */
+#define BGP_IO_IBUF_SIZE (BGP_MAX_PACKET_SIZE * 16)
+
+/* Packets handed to the I/O thread per peer before it is asked to
+   tell the main thread when there is room for more. */
+#define BGP_IO_OBUF_MAX 64
+
+extern int bgp_io_set (const char *arg);
+extern void bgp_io_start (void);
+extern void bgp_io_stop (void);
+extern int bgp_io_running (void);
+
+extern int bgp_io_attach (struct peer *);
+extern void bgp_io_detach (struct peer *);
+extern void bgp_io_xfer (struct peer *, struct peer *);
+extern int bgp_io_keepalive (struct peer *, unsigned int interval);
+
+extern void bgp_io_write (struct peer *);
+extern int bgp_io_write_full (struct peer *);
+extern int bgp_io_read (struct peer *, struct stream *);
+extern time_t bgp_io_readtime (struct peer *);
+extern unsigned long bgp_io_outq (struct peer *);
+
+#endif /* _QUAGGA_BGP_IO_H */
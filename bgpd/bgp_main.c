@@ -53,6 +53,9 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "bgpd/bgp_debug.h"
 #include "bgpd/bgp_filter.h"
 #include "bgpd/bgp_zebra.h"
+#include "bgpd/bgp_io.h"
+#include "bgpd/bgp_checkpoint.h"
+#include "bgpd/bgp_select.h"
 
 #ifdef ENABLE_BGP_VNC
 #include "bgpd/rfapi/rfapi_backend.h"
@@ -76,6 +79,10 @@ static const struct option longopts[] =
   { "skip_runas",  no_argument,       NULL, 'S'},
   { "version",     no_argument,       NULL, 'v'},
   { "dryrun",      no_argument,       NULL, 'C'},
+  { "io_thread",   required_argument, NULL, 'I'},
+  { "checkpoint",  required_argument, NULL, 'K'},
+  { "checkpoint_age", required_argument, NULL, 'k'},
+  { "checkpoint_write", required_argument, NULL, 'w'},
   { "help",        no_argument,       NULL, 'h'},
   { 0 }
 };
@@ -172,6 +179,10 @@ redistribution between different routing protocols.\n\n\
 -S, --skip_runas   Skip user and group run as\n\
 -v, --version      Print program version\n\
 -C, --dryrun       Check configuration for validity and exit\n\
+-I, --io_thread    Do peer socket I/O on a separate thread (on|off)\n\
+-K, --checkpoint   Keep the routes in this file across restarts\n\
+-k, --checkpoint_age Don't load a checkpoint older than this many seconds\n\
+-w, --checkpoint_write Also write the checkpoint every this many seconds\n\
 -h, --help         Display this help and exit\n\
 \n\
 Report bugs to %s\n", progname, FRR_BUG_ADDRESS);
@@ -206,6 +217,9 @@ sigint (void)
 {
   zlog_notice ("Terminating on signal");
 
+  /* While the routes are all still there. */
+  bgp_checkpoint_save ();
+
   if (! retain_mode)
     {
       bgp_terminate ();
@@ -253,9 +267,15 @@ bgp_exit (int status)
     bgp_delete (bgp);
   list_free (bm->bgp);
 
+  /* The peers are gone, and with them their connections. */
+  bgp_io_stop ();
+
   /* reverse bgp_dump_init */
   bgp_dump_finish ();
 
+  /* reverse bgp_checkpoint_init */
+  bgp_checkpoint_finish ();
+
   /* reverse bgp_route_init */
   bgp_route_finish ();
 
@@ -426,7 +446,7 @@ main (int argc, char **argv)
   /* Command line argument treatment. */
   while (1) 
     {
-      opt = getopt_long (argc, argv, "df:i:z:hp:l:A:P:rnu:g:vCS", longopts, 0);
+      opt = getopt_long (argc, argv, "df:i:z:hp:l:A:P:rnu:g:vCSI:K:k:w:", longopts, 0);
     
       if (opt == EOF)
 	break;
@@ -494,6 +514,35 @@ main (int argc, char **argv)
 	case 'C':
 	  dryrun = 1;
 	  break;
+	case 'I':
+	  if (bgp_io_set (optarg) < 0)
+	    {
+	      fprintf (stderr, "Invalid I/O thread setting: %s\n", optarg);
+	      usage (progname, 1);
+	    }
+	  break;
+	case 'K':
+	  bgp_checkpoint_set (optarg);
+	  break;
+	case 'k':
+	case 'w':
+	  {
+	    char *end;
+	    unsigned long seconds;
+
+	    errno = 0;
+	    seconds = strtoul (optarg, &end, 10);
+	    if (errno || *end || end == optarg)
+	      {
+		fprintf (stderr, "Invalid number of seconds: %s\n", optarg);
+		usage (progname, 1);
+	      }
+	    if (opt == 'k')
+	      bgp_checkpoint_set_max_age (seconds);
+	    else
+	      bgp_checkpoint_set_interval (seconds);
+	  }
+	  break;
 	case 'h':
 	  usage (progname, 0);
 	  break;
@@ -539,6 +588,10 @@ main (int argc, char **argv)
       return (1);
     }
 
+  /* Threads do not survive daemon(), so they are started only now. */
+  bgp_io_start ();
+  bgp_select_start ();
+  bgp_dump_start ();
 
   /* Process ID file creation. */
   pid_output (pid_file);
@@ -546,6 +599,9 @@ main (int argc, char **argv)
   /* Make bgp vty socket. */
   vty_serv_sock (vty_addr, vty_port, BGP_VTYSH_PATH);
 
+  /* Put back the routes from before the restart. */
+  bgp_checkpoint_start ();
+
   /* Print banner. */
   zlog_notice ("BGPd %s starting: vty@%d, bgp@%s:%d", FRR_COPYRIGHT,
 	       vty_port, 
@@ -43,6 +43,7 @@ DEFINE_MTYPE(BGPD, BGP_PEER_AF,		"BGP peer af")
 DEFINE_MTYPE(BGPD, BGP_UPDGRP,		"BGP update group")
 DEFINE_MTYPE(BGPD, BGP_UPD_SUBGRP,	"BGP update subgroup")
 DEFINE_MTYPE(BGPD, BGP_PACKET, 	        "BGP packet")
+DEFINE_MTYPE(BGPD, BGP_ATTR_CACHE,	"BGP encoded attribute cache")
 DEFINE_MTYPE(BGPD, ATTR,			"BGP attribute")
 DEFINE_MTYPE(BGPD, ATTR_EXTRA,		"BGP extra attributes")
 DEFINE_MTYPE(BGPD, AS_PATH,		"BGP aspath")
@@ -51,16 +52,16 @@ DEFINE_MTYPE(BGPD, AS_SEG_DATA,		"BGP aspath segment data")
 DEFINE_MTYPE(BGPD, AS_STR,			"BGP aspath str")
 
 DEFINE_MTYPE(BGPD, BGP_TABLE,		"BGP table")
-DEFINE_MTYPE(BGPD, BGP_NODE,		"BGP node")
-DEFINE_MTYPE(BGPD, BGP_ROUTE,		"BGP route")
+DEFINE_MTYPE_SLAB(BGPD, BGP_NODE,		"BGP node")
+DEFINE_MTYPE_SLAB(BGPD, BGP_ROUTE,		"BGP route")
 DEFINE_MTYPE(BGPD, BGP_ROUTE_EXTRA,	"BGP ancillary route info")
 DEFINE_MTYPE(BGPD, BGP_CONN,		"BGP connected")
 DEFINE_MTYPE(BGPD, BGP_STATIC,		"BGP static")
 DEFINE_MTYPE(BGPD, BGP_ADVERTISE_ATTR,	"BGP adv attr")
-DEFINE_MTYPE(BGPD, BGP_ADVERTISE,		"BGP adv")
+DEFINE_MTYPE_SLAB(BGPD, BGP_ADVERTISE,		"BGP adv")
 DEFINE_MTYPE(BGPD, BGP_SYNCHRONISE,	"BGP synchronise")
 DEFINE_MTYPE(BGPD, BGP_ADJ_IN,		"BGP adj in")
-DEFINE_MTYPE(BGPD, BGP_ADJ_OUT,		"BGP adj out")
+DEFINE_MTYPE_SLAB(BGPD, BGP_ADJ_OUT,		"BGP adj out")
 DEFINE_MTYPE(BGPD, BGP_MPATH_INFO,		"BGP multipath info")
 
 DEFINE_MTYPE(BGPD, AS_LIST,		"BGP AS list")
@@ -85,6 +86,9 @@ DEFINE_MTYPE(BGPD, CLUSTER,		"Cluster list")
 DEFINE_MTYPE(BGPD, CLUSTER_VAL,		"Cluster list val")
 
 DEFINE_MTYPE(BGPD, BGP_PROCESS_QUEUE,	"BGP Process queue")
+DEFINE_MTYPE(BGPD, BGP_SELECT,		"BGP selection workers")
+DEFINE_MTYPE(BGPD, BGP_IO,		"BGP peer I/O connection")
+DEFINE_MTYPE(BGPD, BGP_IO_BUF,		"BGP peer I/O buffer")
 DEFINE_MTYPE(BGPD, BGP_CLEAR_NODE_QUEUE,	"BGP node clear queue")
 
 DEFINE_MTYPE(BGPD, TRANSIT,		"BGP transit attr")
@@ -106,7 +110,11 @@ DEFINE_MTYPE(BGPD, BGP_ADDR,		"BGP own address")
 
 DEFINE_MTYPE(BGPD, BGP_REDIST,		"BGP redistribution")
 DEFINE_MTYPE(BGPD, BGP_FILTER_NAME,	"BGP Filter Information")
+DEFINE_MTYPE(BGPD, BGP_RMAP_CACHE,	"BGP route-map cache")
 DEFINE_MTYPE(BGPD, BGP_DUMP_STR,	"BGP Dump String Information")
+DEFINE_MTYPE(BGPD, BGP_DUMP,		"BGP dump file")
+DEFINE_MTYPE(BGPD, BGP_DUMP_BUF,	"BGP dump buffer")
+DEFINE_MTYPE(BGPD, BGP_CHECKPOINT,	"BGP checkpoint")
 DEFINE_MTYPE(BGPD, ENCAP_TLV,		"ENCAP TLV")
 
 DEFINE_MTYPE(BGPD, BGP_TEA_OPTIONS,	  "BGP TEA Options")
@@ -39,6 +39,7 @@ DECLARE_MTYPE(BGP_PEER_AF)
 DECLARE_MTYPE(BGP_UPDGRP)
 DECLARE_MTYPE(BGP_UPD_SUBGRP)
 DECLARE_MTYPE(BGP_PACKET)
+DECLARE_MTYPE(BGP_ATTR_CACHE)
 DECLARE_MTYPE(ATTR)
 DECLARE_MTYPE(ATTR_EXTRA)
 DECLARE_MTYPE(AS_PATH)
@@ -81,6 +82,9 @@ DECLARE_MTYPE(CLUSTER)
 DECLARE_MTYPE(CLUSTER_VAL)
 
 DECLARE_MTYPE(BGP_PROCESS_QUEUE)
+DECLARE_MTYPE(BGP_SELECT)
+DECLARE_MTYPE(BGP_IO)
+DECLARE_MTYPE(BGP_IO_BUF)
 DECLARE_MTYPE(BGP_CLEAR_NODE_QUEUE)
 
 DECLARE_MTYPE(TRANSIT)
@@ -102,7 +106,11 @@ DECLARE_MTYPE(BGP_ADDR)
 
 DECLARE_MTYPE(BGP_REDIST)
 DECLARE_MTYPE(BGP_FILTER_NAME)
+DECLARE_MTYPE(BGP_RMAP_CACHE)
 DECLARE_MTYPE(BGP_DUMP_STR)
+DECLARE_MTYPE(BGP_DUMP)
+DECLARE_MTYPE(BGP_DUMP_BUF)
+DECLARE_MTYPE(BGP_CHECKPOINT)
 DECLARE_MTYPE(ENCAP_TLV)
 
 DECLARE_MTYPE(BGP_TEA_OPTIONS)
@@ -315,10 +315,46 @@ bgp_delete_connected_nexthop (afi_t afi, struct peer *peer)
     }
 }
 
-void
-bgp_parse_nexthop_update (int command, vrf_id_t vrf_id)
+/* Skip what is left of an entry of a nexthop update message once its
+ * prefix has been read.
+ */
+static void
+bgp_skip_nexthop_entry (struct stream *s)
+{
+  u_char nexthop_num;
+  int i;
+
+  (void)stream_getl (s);
+  nexthop_num = stream_getc (s);
+  for (i = 0; i < nexthop_num; i++)
+    switch (stream_getc (s))
+      {
+      case NEXTHOP_TYPE_IPV4:
+        stream_forward_getp (s, IPV4_MAX_BYTELEN);
+        break;
+      case NEXTHOP_TYPE_IFINDEX:
+        stream_forward_getp (s, 4);
+        break;
+      case NEXTHOP_TYPE_IPV4_IFINDEX:
+        stream_forward_getp (s, IPV4_MAX_BYTELEN + 4);
+        break;
+      case NEXTHOP_TYPE_IPV6:
+        stream_forward_getp (s, IPV6_MAX_BYTELEN);
+        break;
+      case NEXTHOP_TYPE_IPV6_IFINDEX:
+        stream_forward_getp (s, IPV6_MAX_BYTELEN + 4);
+        break;
+      default:
+        break;
+      }
+}
+
+/* Parse one entry of a nexthop update message and update the nexthop
+ * cache entry it is for.  Returns the entry, or NULL if there is none.
+ */
+static struct bgp_nexthop_cache *
+bgp_parse_nexthop_entry (struct bgp *bgp, int command, struct stream *s)
 {
-  struct stream *s;
   struct bgp_node *rn = NULL;
   struct bgp_nexthop_cache *bnc;
   struct nexthop *nexthop;
@@ -329,16 +365,6 @@ bgp_parse_nexthop_update (int command, vrf_id_t vrf_id)
   u_char nexthop_num;
   struct prefix p;
   int i;
-  struct bgp *bgp;
-
-  bgp = bgp_lookup_by_vrf_id (vrf_id);
-  if (!bgp)
-    {
-      zlog_err("parse nexthop update: instance not found for vrf_id %d", vrf_id);
-      return;
-    }
-
-  s = zclient->ibuf;
 
   memset(&p, 0, sizeof(struct prefix));
   p.family = stream_getw(s);
@@ -370,13 +396,13 @@ bgp_parse_nexthop_update (int command, vrf_id_t vrf_id)
 	}
       if (rn)
         bgp_unlock_node (rn);
-      return;
+      bgp_skip_nexthop_entry (s);
+      return NULL;
     }
 
   bnc = rn->info;
   bgp_unlock_node (rn);
   bnc->last_update = bgp_clock();
-  bnc->change_flags = 0;
   metric = stream_getl (s);
   nexthop_num = stream_getc (s);
 
@@ -386,7 +412,7 @@ bgp_parse_nexthop_update (int command, vrf_id_t vrf_id)
       char buf[PREFIX2STR_BUFFER];
       prefix2str(&p, buf, sizeof (buf));
       zlog_debug("%d: NH update for %s - metric %d (cur %d) #nhops %d (cur %d)",
-                 vrf_id, buf, metric, bnc->metric, nexthop_num, bnc->nexthop_num);
+                 bgp->vrf_id, buf, metric, bnc->metric, nexthop_num, bnc->nexthop_num);
     }
 
   if (metric != bnc->metric)
@@ -479,7 +505,49 @@ bgp_parse_nexthop_update (int command, vrf_id_t vrf_id)
       bnc->nexthop = NULL;
     }
 
-  evaluate_paths(bnc);
+  return bnc;
+}
+
+/* A nexthop update message carries one entry after the other.  All of
+ * them are parsed before any paths are evaluated, so that a nexthop
+ * which comes up more than once in a message has its paths evaluated
+ * once, with what changed in all of the entries for it.
+ */
+void
+bgp_parse_nexthop_update (int command, vrf_id_t vrf_id)
+{
+  struct stream *s;
+  struct bgp *bgp;
+  struct bgp_nexthop_cache *bnc;
+  struct list *updated;
+  struct listnode *node;
+
+  bgp = bgp_lookup_by_vrf_id (vrf_id);
+  if (!bgp)
+    {
+      zlog_err("parse nexthop update: instance not found for vrf_id %d", vrf_id);
+      return;
+    }
+
+  s = zclient->ibuf;
+  updated = list_new ();
+
+  while (STREAM_READABLE (s))
+    {
+      bnc = bgp_parse_nexthop_entry (bgp, command, s);
+      if (bnc && !CHECK_FLAG (bnc->flags, BGP_NEXTHOP_EVALUATE))
+        {
+          SET_FLAG (bnc->flags, BGP_NEXTHOP_EVALUATE);
+          listnode_add (updated, bnc);
+        }
+    }
+
+  for (ALL_LIST_ELEMENTS_RO (updated, node, bnc))
+    {
+      UNSET_FLAG (bnc->flags, BGP_NEXTHOP_EVALUATE);
+      evaluate_paths (bnc);
+    }
+  list_delete (updated);
 }
 
 /**
@@ -588,10 +656,12 @@ sendmsg_zebra_rnh (struct bgp_nexthop_cache *bnc, int command)
     }
   stream_putw_at (s, 0, stream_get_endp (s));
 
-  ret = zclient_send_message(zclient);
+  /* Registrations come in bursts as tables are loaded, have them merged
+     into one message. */
+  ret = zclient_send_rnh(zclient);
   /* TBD: handle the failure */
   if (ret < 0)
-    zlog_warn("sendmsg_nexthop: zclient_send_message() failed");
+    zlog_warn("sendmsg_nexthop: zclient_send_rnh() failed");
 
   if ((command == ZEBRA_NEXTHOP_REGISTER) ||
       (command == ZEBRA_IMPORT_ROUTE_REGISTER))
@@ -23,7 +23,9 @@
 #define _BGP_NHT_H
 
 /**
- * bgp_parse_nexthop_update() - parse a nexthop update message from Zebra.
+ * bgp_parse_nexthop_update() - parse a nexthop update message from Zebra,
+ * which may carry updates for several nexthops, and evaluate the paths
+ * of the nexthops updated.
  */
 extern void bgp_parse_nexthop_update(int command, vrf_id_t vrf_id);
 
@@ -52,6 +52,8 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "bgpd/bgp_advertise.h"
 #include "bgpd/bgp_vty.h"
 #include "bgpd/bgp_updgrp.h"
+#include "bgpd/bgp_io.h"
+#include "bgpd/bgp_checkpoint.h"
 
 /* Set up BGP packet marker and packet type. */
 int
@@ -337,12 +339,108 @@ bgp_write_proceed_actions (struct peer *peer)
     }
 }
 
+/* Count a packet written to the peer.  Returns 1 for a NOTIFICATION,
+   after which the peer is to be stopped. */
+static int
+bgp_packet_sent (struct peer *peer, struct stream *s)
+{
+  switch (stream_getc_from (s, BGP_MARKER_SIZE + 2))
+    {
+    case BGP_MSG_OPEN:
+      peer->open_out++;
+      break;
+    case BGP_MSG_UPDATE:
+      peer->update_out++;
+      break;
+    case BGP_MSG_NOTIFY:
+      peer->notify_out++;
+      /* Double start timer. */
+      peer->v_start *= 2;
+
+      /* Overflow check. */
+      if (peer->v_start >= (60 * 2))
+	peer->v_start = (60 * 2);
+
+      /* Flush any existing events */
+      BGP_EVENT_ADD (peer, BGP_Stop);
+      return 1;
+
+    case BGP_MSG_KEEPALIVE:
+      peer->keepalive_out++;
+      break;
+    case BGP_MSG_ROUTE_REFRESH_NEW:
+    case BGP_MSG_ROUTE_REFRESH_OLD:
+      peer->refresh_out++;
+      break;
+    case BGP_MSG_CAPABILITY:
+      peer->dynamic_cap_out++;
+      break;
+    }
+  return 0;
+}
+
+/* Count and free the packets the I/O thread wrote to the peer, and the
+   keepalives it sent on its own. */
+void
+bgp_write_done (struct peer *peer, struct stream_fifo *sent,
+		u_int32_t keepalives)
+{
+  struct stream *s;
+  u_int32_t oc;
+  int update_last_write = 0;
+
+  oc = peer->update_out;
+
+  while ((s = stream_fifo_pop (sent)))
+    {
+      bgp_packet_sent (peer, s);
+      stream_free (s);
+      update_last_write = 1;
+    }
+
+  if (keepalives)
+    {
+      peer->keepalive_out += keepalives;
+      update_last_write = 1;
+    }
+
+  /* Update last_update if UPDATEs were written. */
+  if (peer->update_out > oc)
+    peer->last_update = bgp_clock ();
+
+  /* If we TXed any flavor of packet update last_write */
+  if (update_last_write)
+    peer->last_write = bgp_clock ();
+}
+
+/* Hand packets to the I/O thread, as many as bgp_write() would write
+   at once, or fewer if it has enough to write for now. */
+static void
+bgp_write_io (struct peer *peer)
+{
+  unsigned int count = 0;
+
+  while (count < peer->bgp->wpkt_quanta)
+    {
+      if (bgp_io_write_full (peer))
+	return;
+      if (!bgp_write_packet (peer))
+	break;
+      bgp_io_write (peer);
+      count++;
+    }
+
+  if (count == peer->bgp->wpkt_quanta)
+    BGP_WRITE_ON (peer->t_write, bgp_write, peer->fd);
+  else
+    bgp_write_proceed_actions (peer);
+}
+
 /* Write packet to the peer. */
 int
 bgp_write (struct thread *thread)
 {
   struct peer *peer;
-  u_char type;
   struct stream *s;
   int num;
   int update_last_write = 0;
@@ -360,6 +458,12 @@ bgp_write (struct thread *thread)
       return 0;
     }
 
+  if (peer->io)
+    {
+      bgp_write_io (peer);
+      return 0;
+    }
+
   s = bgp_write_packet (peer);
   if (!s)
     {
@@ -398,42 +502,8 @@ bgp_write (struct thread *thread)
 	  break;
 	}
 
-      /* Retrieve BGP packet type. */
-      stream_set_getp (s, BGP_MARKER_SIZE + 2);
-      type = stream_getc (s);
-
-      switch (type)
-	{
-	case BGP_MSG_OPEN:
-	  peer->open_out++;
-	  break;
-	case BGP_MSG_UPDATE:
-	  peer->update_out++;
-	  break;
-	case BGP_MSG_NOTIFY:
-	  peer->notify_out++;
-	  /* Double start timer. */
-	  peer->v_start *= 2;
-
-	  /* Overflow check. */
-	  if (peer->v_start >= (60 * 2))
-	    peer->v_start = (60 * 2);
-
-	  /* Flush any existing events */
-	  BGP_EVENT_ADD (peer, BGP_Stop);
-	  goto done;
-
-	case BGP_MSG_KEEPALIVE:
-	  peer->keepalive_out++;
-	  break;
-	case BGP_MSG_ROUTE_REFRESH_NEW:
-	case BGP_MSG_ROUTE_REFRESH_OLD:
-	  peer->refresh_out++;
-	  break;
-	case BGP_MSG_CAPABILITY:
-	  peer->dynamic_cap_out++;
-	  break;
-	}
+      if (bgp_packet_sent (peer, s))
+	goto done;
 
       /* OK we send packet so delete it. */
       bgp_packet_delete (peer);
@@ -677,6 +747,9 @@ bgp_notify_send_with_data (struct peer *peer, u_char code, u_char sub_code,
   /* Call immediately. */
   BGP_WRITE_OFF (peer->t_write);
 
+  /* Take the socket back from the I/O thread, to write it here. */
+  bgp_io_detach (peer);
+
   bgp_write_notify (peer);
 }
 
@@ -1588,9 +1661,12 @@ bgp_update_receive (struct peer *peer, bgp_size_t size)
               bgp_update_explicit_eors(peer);
             }
 
-          /* NSF delete stale route */
-          if (peer->nsf[afi][safi])
+          /* NSF delete stale route, or those loaded from a checkpoint */
+          if (peer->nsf[afi][safi]
+              || CHECK_FLAG (peer->sflags, PEER_STATUS_CHECKPOINT))
             bgp_clear_stale_route (peer, afi, safi);
+          if (CHECK_FLAG (peer->sflags, PEER_STATUS_CHECKPOINT))
+            bgp_checkpoint_eor (peer);
 
           if (bgp_debug_neighbor_events(peer))
             {
@@ -2072,6 +2148,34 @@ bgp_capability_receive (struct peer *peer, bgp_size_t size)
   return bgp_capability_msg_parse (peer, pnt, size);
 }
 
+/* The connection to the peer failed, or with nbytes 0, was closed. */
+static void
+bgp_read_fail (struct peer *peer, int nbytes)
+{
+  if (nbytes < 0)
+    zlog_err ("%s [Error] bgp_read_packet error: %s",
+	      peer->host, safe_strerror (errno));
+  else if (bgp_debug_neighbor_events(peer))
+    zlog_debug ("%s [Event] BGP connection closed fd %d",
+		peer->host, peer->fd);
+
+  if (peer->status == Established) 
+    {
+      if (CHECK_FLAG (peer->sflags, PEER_STATUS_NSF_MODE))
+	{
+	  peer->last_reset = PEER_DOWN_NSF_CLOSE_SESSION;
+	  SET_FLAG (peer->sflags, PEER_STATUS_NSF_WAIT);
+	}
+      else
+	peer->last_reset = PEER_DOWN_CLOSE_SESSION;
+    }
+
+  if (nbytes < 0)
+    BGP_EVENT_ADD (peer, TCP_fatal_error);
+  else
+    BGP_EVENT_ADD (peer, TCP_connection_closed);
+}
+
 /* BGP read utility function. */
 static int
 bgp_read_packet (struct peer *peer)
@@ -2095,43 +2199,14 @@ bgp_read_packet (struct peer *peer)
       if (nbytes == -2)
 	return -1;
 
-      zlog_err ("%s [Error] bgp_read_packet error: %s",
-		peer->host, safe_strerror (errno));
-
-      if (peer->status == Established) 
-	{
-	  if (CHECK_FLAG (peer->sflags, PEER_STATUS_NSF_MODE))
-	    {
-	      peer->last_reset = PEER_DOWN_NSF_CLOSE_SESSION;
-	      SET_FLAG (peer->sflags, PEER_STATUS_NSF_WAIT);
-	    }
-	  else
-	    peer->last_reset = PEER_DOWN_CLOSE_SESSION;
-	}
-
-      BGP_EVENT_ADD (peer, TCP_fatal_error);
+      bgp_read_fail (peer, -1);
       return -1;
     }  
 
   /* When read byte is zero : clear bgp peer and return */
   if (nbytes == 0) 
     {
-      if (bgp_debug_neighbor_events(peer))
-	zlog_debug ("%s [Event] BGP connection closed fd %d",
-		    peer->host, peer->fd);
-
-      if (peer->status == Established) 
-	{
-	  if (CHECK_FLAG (peer->sflags, PEER_STATUS_NSF_MODE))
-	    {
-	      peer->last_reset = PEER_DOWN_NSF_CLOSE_SESSION;
-	      SET_FLAG (peer->sflags, PEER_STATUS_NSF_WAIT);
-	    }
-	  else
-	    peer->last_reset = PEER_DOWN_CLOSE_SESSION;
-	}
-
-      BGP_EVENT_ADD (peer, TCP_connection_closed);
+      bgp_read_fail (peer, 0);
       return -1;
     }
 
@@ -2155,114 +2230,82 @@ bgp_marker_all_one (struct stream *s, int length)
   return 1;
 }
 
-/* Starting point of packet process function. */
-int
-bgp_read (struct thread *thread)
+/* Check the header in peer->ibuf, and set the packet size from it.
+   Returns -1 if the header is bad, after sending a NOTIFICATION. */
+static int
+bgp_read_header (struct peer *peer)
 {
-  int ret;
   u_char type = 0;
-  struct peer *peer;
   bgp_size_t size;
   char notify_data_length[2];
-  u_int32_t notify_out;
 
-  /* Yes first of all get peer pointer. */
-  peer = THREAD_ARG (thread);
-  peer->t_read = NULL;
-
-  /* Note notify_out so we can check later to see if we sent another one */
-  notify_out = peer->notify_out;
+  /* Get size and type. */
+  stream_forward_getp (peer->ibuf, BGP_MARKER_SIZE);
+  memcpy (notify_data_length, stream_pnt (peer->ibuf), 2);
+  size = stream_getw (peer->ibuf);
+  type = stream_getc (peer->ibuf);
 
-  /* For non-blocking IO check. */
-  if (peer->status == Connect)
+  /* Marker check */
+  if (((type == BGP_MSG_OPEN) || (type == BGP_MSG_KEEPALIVE))
+      && ! bgp_marker_all_one (peer->ibuf, BGP_MARKER_SIZE))
     {
-      bgp_connect_check (peer, 1);
-      goto done;
+      bgp_notify_send (peer,
+		       BGP_NOTIFY_HEADER_ERR, 
+		       BGP_NOTIFY_HEADER_NOT_SYNC);
+      return -1;
     }
-  else
+
+  /* BGP type check. */
+  if (type != BGP_MSG_OPEN && type != BGP_MSG_UPDATE 
+      && type != BGP_MSG_NOTIFY && type != BGP_MSG_KEEPALIVE 
+      && type != BGP_MSG_ROUTE_REFRESH_NEW
+      && type != BGP_MSG_ROUTE_REFRESH_OLD
+      && type != BGP_MSG_CAPABILITY)
     {
-      if (peer->fd < 0)
-	{
-	  zlog_err ("bgp_read peer's fd is negative value %d", peer->fd);
-	  return -1;
-	}
-      BGP_READ_ON (peer->t_read, bgp_read, peer->fd);
+      if (bgp_debug_neighbor_events(peer))
+	zlog_debug ("%s unknown message type 0x%02x",
+		    peer->host, type);
+      bgp_notify_send_with_data (peer,
+				 BGP_NOTIFY_HEADER_ERR,
+				 BGP_NOTIFY_HEADER_BAD_MESTYPE,
+				 &type, 1);
+      return -1;
     }
-
-  /* Read packet header to determine type of the packet */
-  if (peer->packet_size == 0)
-    peer->packet_size = BGP_HEADER_SIZE;
-
-  if (stream_get_endp (peer->ibuf) < BGP_HEADER_SIZE)
+  /* Mimimum packet length check. */
+  if ((size < BGP_HEADER_SIZE)
+      || (size > BGP_MAX_PACKET_SIZE)
+      || (type == BGP_MSG_OPEN && size < BGP_MSG_OPEN_MIN_SIZE)
+      || (type == BGP_MSG_UPDATE && size < BGP_MSG_UPDATE_MIN_SIZE)
+      || (type == BGP_MSG_NOTIFY && size < BGP_MSG_NOTIFY_MIN_SIZE)
+      || (type == BGP_MSG_KEEPALIVE && size != BGP_MSG_KEEPALIVE_MIN_SIZE)
+      || (type == BGP_MSG_ROUTE_REFRESH_NEW && size < BGP_MSG_ROUTE_REFRESH_MIN_SIZE)
+      || (type == BGP_MSG_ROUTE_REFRESH_OLD && size < BGP_MSG_ROUTE_REFRESH_MIN_SIZE)
+      || (type == BGP_MSG_CAPABILITY && size < BGP_MSG_CAPABILITY_MIN_SIZE))
     {
-      ret = bgp_read_packet (peer);
-
-      /* Header read error or partial read packet. */
-      if (ret < 0) 
-	goto done;
-
-      /* Get size and type. */
-      stream_forward_getp (peer->ibuf, BGP_MARKER_SIZE);
-      memcpy (notify_data_length, stream_pnt (peer->ibuf), 2);
-      size = stream_getw (peer->ibuf);
-      type = stream_getc (peer->ibuf);
-
-      /* Marker check */
-      if (((type == BGP_MSG_OPEN) || (type == BGP_MSG_KEEPALIVE))
-	  && ! bgp_marker_all_one (peer->ibuf, BGP_MARKER_SIZE))
-	{
-	  bgp_notify_send (peer,
-			   BGP_NOTIFY_HEADER_ERR, 
-			   BGP_NOTIFY_HEADER_NOT_SYNC);
-	  goto done;
-	}
-
-      /* BGP type check. */
-      if (type != BGP_MSG_OPEN && type != BGP_MSG_UPDATE 
-	  && type != BGP_MSG_NOTIFY && type != BGP_MSG_KEEPALIVE 
-	  && type != BGP_MSG_ROUTE_REFRESH_NEW
-	  && type != BGP_MSG_ROUTE_REFRESH_OLD
-	  && type != BGP_MSG_CAPABILITY)
-	{
-          if (bgp_debug_neighbor_events(peer))
-	    zlog_debug ("%s unknown message type 0x%02x",
-		        peer->host, type);
-	  bgp_notify_send_with_data (peer,
-				     BGP_NOTIFY_HEADER_ERR,
-			 	     BGP_NOTIFY_HEADER_BAD_MESTYPE,
-				     &type, 1);
-	  goto done;
-	}
-      /* Mimimum packet length check. */
-      if ((size < BGP_HEADER_SIZE)
-	  || (size > BGP_MAX_PACKET_SIZE)
-	  || (type == BGP_MSG_OPEN && size < BGP_MSG_OPEN_MIN_SIZE)
-	  || (type == BGP_MSG_UPDATE && size < BGP_MSG_UPDATE_MIN_SIZE)
-	  || (type == BGP_MSG_NOTIFY && size < BGP_MSG_NOTIFY_MIN_SIZE)
-	  || (type == BGP_MSG_KEEPALIVE && size != BGP_MSG_KEEPALIVE_MIN_SIZE)
-	  || (type == BGP_MSG_ROUTE_REFRESH_NEW && size < BGP_MSG_ROUTE_REFRESH_MIN_SIZE)
-	  || (type == BGP_MSG_ROUTE_REFRESH_OLD && size < BGP_MSG_ROUTE_REFRESH_MIN_SIZE)
-	  || (type == BGP_MSG_CAPABILITY && size < BGP_MSG_CAPABILITY_MIN_SIZE))
-	{
-          if (bgp_debug_neighbor_events(peer))
-	    zlog_debug ("%s bad message length - %d for %s",
-		        peer->host, size,
-		        type == 128 ? "ROUTE-REFRESH" :
-		        bgp_type_str[(int) type]);
-	  bgp_notify_send_with_data (peer,
-				     BGP_NOTIFY_HEADER_ERR,
-			  	     BGP_NOTIFY_HEADER_BAD_MESLEN,
-				     (u_char *) notify_data_length, 2);
-	  goto done;
-	}
-
-      /* Adjust size to message length. */
-      peer->packet_size = size;
+      if (bgp_debug_neighbor_events(peer))
+	zlog_debug ("%s bad message length - %d for %s",
+		    peer->host, size,
+		    type == 128 ? "ROUTE-REFRESH" :
+		    bgp_type_str[(int) type]);
+      bgp_notify_send_with_data (peer,
+				 BGP_NOTIFY_HEADER_ERR,
+				 BGP_NOTIFY_HEADER_BAD_MESLEN,
+				 (u_char *) notify_data_length, 2);
+      return -1;
     }
 
-  ret = bgp_read_packet (peer);
-  if (ret < 0) 
-    goto done;
+  /* Adjust size to message length. */
+  peer->packet_size = size;
+  return 0;
+}
+
+/* Process the complete message in peer->ibuf, and clear it.  Returns
+   the message type. */
+static u_char
+bgp_read_message (struct peer *peer, u_int32_t notify_out)
+{
+  u_char type;
+  bgp_size_t size;
 
   /* Get size and type again. */
   (void)stream_getw_from (peer->ibuf, BGP_MARKER_SIZE);
@@ -2309,7 +2352,6 @@ bgp_read (struct thread *thread)
     {
       memcpy(peer->last_reset_cause, peer->ibuf->data, peer->packet_size);
       peer->last_reset_cause_size = peer->packet_size;
-      notify_out = peer->notify_out;
     }
 
   /* Clear input buffer. */
@@ -2317,6 +2359,63 @@ bgp_read (struct thread *thread)
   if (peer->ibuf)
     stream_reset (peer->ibuf);
 
+  return type;
+}
+
+/* Starting point of packet process function. */
+int
+bgp_read (struct thread *thread)
+{
+  int ret;
+  struct peer *peer;
+  u_int32_t notify_out;
+
+  /* Yes first of all get peer pointer. */
+  peer = THREAD_ARG (thread);
+  peer->t_read = NULL;
+
+  /* Note notify_out so we can check later to see if we sent another one */
+  notify_out = peer->notify_out;
+
+  /* For non-blocking IO check. */
+  if (peer->status == Connect)
+    {
+      bgp_connect_check (peer, 1);
+      goto done;
+    }
+  else
+    {
+      if (peer->fd < 0)
+	{
+	  zlog_err ("bgp_read peer's fd is negative value %d", peer->fd);
+	  return -1;
+	}
+      BGP_READ_ON (peer->t_read, bgp_read, peer->fd);
+    }
+
+  /* Read packet header to determine type of the packet */
+  if (peer->packet_size == 0)
+    peer->packet_size = BGP_HEADER_SIZE;
+
+  if (stream_get_endp (peer->ibuf) < BGP_HEADER_SIZE)
+    {
+      ret = bgp_read_packet (peer);
+
+      /* Header read error or partial read packet. */
+      if (ret < 0) 
+	goto done;
+
+      if (bgp_read_header (peer) < 0)
+	goto done;
+    }
+
+  ret = bgp_read_packet (peer);
+  if (ret < 0) 
+    goto done;
+
+  bgp_read_message (peer, notify_out);
+  return 0;
+
  done:
   /* If reading this packet caused us to send a NOTIFICATION then store a copy
    * of the packet for troubleshooting purposes
@@ -2329,3 +2428,55 @@ bgp_read (struct thread *thread)
 
   return 0;
 }
+
+/* Process messages the I/O thread read for the peer.  UPDATEs and
+   KEEPALIVEs of an Established session are processed a few at a time;
+   anything else is processed on its own, so that the events it raises
+   run before the next message.  Returns 1 if there may be more. */
+int
+bgp_read_io (struct peer *peer)
+{
+  struct bgp_io *io = peer->io;
+  u_int32_t notify_out;
+  unsigned int count;
+  u_char type;
+  int ret;
+
+  for (count = 0; count < BGP_READ_IO_QUANTA; count++)
+    {
+      notify_out = peer->notify_out;
+
+      stream_reset (peer->ibuf);
+      ret = bgp_io_read (peer, peer->ibuf);
+      if (ret == 0)
+	return 0;
+      if (ret < 0)
+	{
+	  bgp_read_fail (peer, errno ? -1 : 0);
+	  return 0;
+	}
+
+      peer->packet_size = BGP_HEADER_SIZE;
+      if (bgp_read_header (peer) < 0)
+	{
+	  if (notify_out < peer->notify_out)
+	    {
+	      memcpy(peer->last_reset_cause, peer->ibuf->data,
+		     BGP_HEADER_SIZE);
+	      peer->last_reset_cause_size = BGP_HEADER_SIZE;
+	    }
+	  peer->packet_size = 0;
+	  return 0;
+	}
+
+      type = bgp_read_message (peer, notify_out);
+
+      if (peer->io != io)
+	return 0;
+      if (peer->status != Established
+	  || (type != BGP_MSG_UPDATE && type != BGP_MSG_KEEPALIVE))
+	return 1;
+    }
+
+  return 1;
+}
@@ -84,7 +84,7 @@ bgp_regcomp (const char *regstr)
 int
 bgp_regexec (regex_t *regex, struct aspath *aspath)
 {
-  return regexec (regex, aspath->str, 0, NULL, 0);
+  return regexec (regex, aspath_print (aspath), 0, NULL, 0);
 }
 
 void
@@ -93,3 +93,147 @@ bgp_regex_free (regex_t *regex)
   regfree (regex);
   XFREE (MTYPE_BGP_REGEXP, regex);
 }
+
+/* Parse the AS number at the start of str, as it is printed in an AS
+   path, and return the number of characters used, or 0. */
+static int
+bgp_asregex_asn (const char *str, as_t *as)
+{
+  unsigned long long val = 0;
+  int i;
+
+  for (i = 0; isdigit ((int) str[i]); i++)
+    {
+      /* No leading zeros, the string form has none. */
+      if (i == 1 && str[0] == '0')
+	return 0;
+      val = val * 10 + (str[i] - '0');
+      if (val > UINT32_MAX)
+	return 0;
+    }
+
+  *as = val;
+  return i;
+}
+
+/* Find which of the forms matched on the segments str is, if any. */
+static int
+bgp_asregex_type (const char *str, as_t *as)
+{
+  char first, last;
+  int len;
+
+  if (strcmp (str, ".*") == 0)
+    return BGP_ASREGEX_ANY;
+  if (strcmp (str, "^$") == 0)
+    return BGP_ASREGEX_EMPTY;
+
+  first = str[0];
+  if (first != '^' && first != '_')
+    return BGP_ASREGEX_REGEX;
+
+  len = bgp_asregex_asn (str + 1, as);
+  if (len == 0)
+    return BGP_ASREGEX_REGEX;
+
+  last = str[len + 1];
+  if ((last != '$' && last != '_') || str[len + 2] != '\0')
+    return BGP_ASREGEX_REGEX;
+
+  if (first == '_')
+    return last == '_' ? BGP_ASREGEX_CONTAINS : BGP_ASREGEX_LAST;
+  else
+    return last == '_' ? BGP_ASREGEX_FIRST : BGP_ASREGEX_ONLY;
+}
+
+struct bgp_asregex *
+bgp_asregex_comp (const char *str)
+{
+  struct bgp_asregex *asregex;
+  regex_t *regex = NULL;
+  as_t as = 0;
+  int type;
+
+  type = bgp_asregex_type (str, &as);
+  if (type == BGP_ASREGEX_REGEX)
+    {
+      regex = bgp_regcomp (str);
+      if (! regex)
+	return NULL;
+    }
+
+  asregex = XCALLOC (MTYPE_BGP_REGEXP, sizeof (struct bgp_asregex));
+  asregex->type = type;
+  asregex->as = as;
+  asregex->reg = regex;
+
+  return asregex;
+}
+
+static int
+bgp_asregex_contains (struct aspath *aspath, as_t as)
+{
+  struct assegment *seg;
+  int i, first, last;
+
+  for (seg = aspath->segments; seg; seg = seg->next)
+    {
+      /* `_' does not match the brackets of a confederation set, so
+	 neither can its first and last members. */
+      first = 0;
+      last = seg->length - 1;
+      if (seg->type == AS_CONFED_SET)
+	{
+	  first++;
+	  last--;
+	}
+
+      for (i = first; i <= last; i++)
+	if (seg->as[i] == as)
+	  return 1;
+    }
+  return 0;
+}
+
+/* Return 1 if the AS path matches, as bgp_regexec() on the string form
+   would. */
+int
+bgp_asregex_match (struct bgp_asregex *asregex, struct aspath *aspath)
+{
+  struct assegment *seg = aspath->segments;
+
+  switch (asregex->type)
+    {
+    case BGP_ASREGEX_ANY:
+      return 1;
+    case BGP_ASREGEX_EMPTY:
+      return seg == NULL;
+    case BGP_ASREGEX_CONTAINS:
+      return bgp_asregex_contains (aspath, asregex->as);
+    case BGP_ASREGEX_FIRST:
+      /* Sets and confederation segments are printed in brackets. */
+      return (seg && seg->type == AS_SEQUENCE && seg->length
+	      && seg->as[0] == asregex->as);
+    case BGP_ASREGEX_LAST:
+      if (! seg)
+	return 0;
+      while (seg->next)
+	seg = seg->next;
+      return (seg->type == AS_SEQUENCE && seg->length
+	      && seg->as[seg->length - 1] == asregex->as);
+    case BGP_ASREGEX_ONLY:
+      return (seg && ! seg->next && seg->type == AS_SEQUENCE
+	      && seg->length == 1 && seg->as[0] == asregex->as);
+    case BGP_ASREGEX_REGEX:
+    default:
+      return bgp_regexec (asregex->reg, aspath) != REG_NOMATCH;
+    }
+}
+
+void
+bgp_asregex_free (struct bgp_asregex *asregex)
+{
+  if (asregex->reg)
+    bgp_regex_free (asregex->reg);
+  XFREE (MTYPE_BGP_REGEXP, asregex);
+}
@@ -33,4 +33,29 @@ extern void bgp_regex_free (regex_t *regex);
 extern regex_t *bgp_regcomp (const char *str);
 extern int bgp_regexec (regex_t *regex, struct aspath *aspath);
 
+/* AS path regular expression, compiled for matching AS paths.  The
+   common forms are matched on the AS path segments directly, anything
+   else with a regex on the AS path string. */
+struct bgp_asregex
+{
+  enum
+  {
+    BGP_ASREGEX_REGEX,		/* anything else */
+    BGP_ASREGEX_ANY,		/* .* */
+    BGP_ASREGEX_EMPTY,		/* ^$ */
+    BGP_ASREGEX_CONTAINS,	/* _N_ */
+    BGP_ASREGEX_FIRST,		/* ^N_ */
+    BGP_ASREGEX_LAST,		/* _N$ */
+    BGP_ASREGEX_ONLY,		/* ^N$ */
+  } type;
+
+  as_t as;
+  regex_t *reg;
+};
+
+extern struct bgp_asregex *bgp_asregex_comp (const char *str);
+extern int bgp_asregex_match (struct bgp_asregex *asregex,
+			      struct aspath *aspath);
+extern void bgp_asregex_free (struct bgp_asregex *asregex);
+
 #endif /* _QUAGGA_BGP_REGEX_H */
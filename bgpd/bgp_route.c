@@ -59,6 +59,7 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "bgpd/bgp_mpath.h"
 #include "bgpd/bgp_nht.h"
 #include "bgpd/bgp_updgrp.h"
+#include "bgpd/bgp_select.h"
 
 #if ENABLE_BGP_VNC
 #include "bgpd/rfapi/rfapi_backend.h"
@@ -196,6 +197,8 @@ bgp_info_unlock (struct bgp_info *binfo)
 void
 bgp_info_add (struct bgp_node *rn, struct bgp_info *ri)
 {
+  struct bgp_table *table = bgp_node_table (rn);
+  struct bgp_info **head = &ri->peer->paths[table->afi][table->safi];
   struct bgp_info *top;
 
   top = rn->info;
@@ -205,6 +208,13 @@ bgp_info_add (struct bgp_node *rn, struct bgp_info *ri)
   if (top)
     top->prev = ri;
   rn->info = ri;
+  ri->net = rn;
+
+  ri->peer_next = *head;
+  ri->peer_prev = NULL;
+  if (*head)
+    (*head)->peer_prev = ri;
+  *head = ri;
   
   bgp_info_lock (ri);
   bgp_lock_node (rn);
@@ -216,12 +226,22 @@ bgp_info_add (struct bgp_node *rn, struct bgp_info *ri)
 static void
 bgp_info_reap (struct bgp_node *rn, struct bgp_info *ri)
 {
+  struct bgp_table *table = bgp_node_table (rn);
+
   if (ri->next)
     ri->next->prev = ri->prev;
   if (ri->prev)
     ri->prev->next = ri->next;
   else
     rn->info = ri->next;
+
+  if (ri->peer_next)
+    ri->peer_next->peer_prev = ri->peer_prev;
+  if (ri->peer_prev)
+    ri->peer_prev->peer_next = ri->peer_next;
+  else
+    ri->peer->paths[table->afi][table->safi] = ri->peer_next;
+  ri->peer_next = ri->peer_prev = NULL;
   
   bgp_info_mpath_dequeue (ri);
   bgp_info_unlock (ri);
@@ -628,8 +648,8 @@ bgp_info_cmp (struct bgp *bgp, struct bgp_info *new, struct bgp_info *exist,
      path with smaller cluster list length.                       */
   if (newm == existm)
     {
-      if (peer_sort (new->peer) == BGP_PEER_IBGP
-	  && peer_sort (exist->peer) == BGP_PEER_IBGP
+      if (new_sort == BGP_PEER_IBGP
+	  && exist_sort == BGP_PEER_IBGP
 	  && (mpath_cfg == NULL ||
               CHECK_FLAG (mpath_cfg->ibgp_flags,
                           BGP_FLAG_IBGP_MULTIPATH_SAME_CLUSTERLEN)))
@@ -1047,7 +1067,7 @@ bgp_input_modifier (struct peer *peer, struct prefix *p, struct attr *attr,
       SET_FLAG (peer->rmap_type, PEER_RMAP_TYPE_IN); 
 
       /* Apply BGP route map to the attribute. */
-      ret = route_map_apply (rmap, p, RMAP_BGP, &info);
+      ret = bgp_route_map_apply (rmap, p, &info);
 
       peer->rmap_type = 0;
 
@@ -1104,7 +1124,7 @@ bgp_output_modifier (struct peer *peer, struct prefix *p, struct attr *attr,
       SET_FLAG (peer->rmap_type, PEER_RMAP_TYPE_OUT);
 
       /* Apply BGP route map to the attribute. */
-      ret = route_map_apply (rmap, p, RMAP_BGP, &info);
+      ret = bgp_route_map_apply (rmap, p, &info);
 
       peer->rmap_type = 0;
 
@@ -1492,9 +1512,9 @@ subgroup_announce_check (struct bgp_info *ri, struct update_subgroup *subgrp,
       SET_FLAG (peer->rmap_type, PEER_RMAP_TYPE_OUT);
 
       if (ri->extra && ri->extra->suppress)
-	ret = route_map_apply (UNSUPPRESS_MAP (filter), p, RMAP_BGP, &info);
+	ret = bgp_route_map_apply (UNSUPPRESS_MAP (filter), p, &info);
       else
-	ret = route_map_apply (ROUTE_MAP_OUT (filter), p, RMAP_BGP, &info);
+	ret = bgp_route_map_apply (ROUTE_MAP_OUT (filter), p, &info);
 
       peer->rmap_type = 0;
 
@@ -1570,27 +1590,44 @@ struct bgp_info_pair
   struct bgp_info *new;
 };
 
+struct bgp_process_queue
+{
+  struct bgp *bgp;
+  struct bgp_node *rn;
+  afi_t afi;
+  safi_t safi;
+
+  /* Best paths, when computed ahead by the selection workers. */
+  struct bgp_info_pair result;
+
+  /* Already processed as part of a batch. */
+  int done;
+};
+
+/*
+ * First half of best path selection: find the old and the new best path
+ * of a node, and mark the paths that qualify as multipaths with
+ * BGP_INFO_MPATH_CAND.  Only the paths of the node are written to, so
+ * with debugging off this may run for several nodes at once on the
+ * selection workers (see bgp_select.c).  bgp_best_selection() does the
+ * rest.
+ */
 static void
-bgp_best_selection (struct bgp *bgp, struct bgp_node *rn,
-		    struct bgp_maxpaths_cfg *mpath_cfg,
-		    struct bgp_info_pair *result)
+bgp_best_path_compute (struct bgp *bgp, struct bgp_node *rn,
+		       struct bgp_maxpaths_cfg *mpath_cfg, int debug,
+		       struct bgp_info_pair *result)
 {
   struct bgp_info *new_select;
   struct bgp_info *old_select;
   struct bgp_info *ri;
   struct bgp_info *ri1;
   struct bgp_info *ri2;
-  struct bgp_info *nextri = NULL;
-  int paths_eq, do_mpath, debug;
-  struct list mp_list;
+  int paths_eq, do_mpath;
   char pfx_buf[PREFIX2STR_BUFFER];
   char path_buf[PATH_ADDPATH_STR_BUFFER];
 
-  bgp_mp_list_init (&mp_list);
   do_mpath = (mpath_cfg->maxpaths_ebgp > 1 || mpath_cfg->maxpaths_ibgp > 1);
 
-  debug = bgp_debug_bestpath(&rn->p);
-
   if (debug)
     prefix2str (&rn->p, pfx_buf, sizeof (pfx_buf));
 
@@ -1609,7 +1646,8 @@ bgp_best_selection (struct bgp *bgp, struct bgp_node *rn,
             continue;
           if (BGP_INFO_HOLDDOWN (ri1))
             continue;
-          if (ri1->peer && ri1->peer != bgp->peer_self)
+          if (ri1->peer && ri1->peer != bgp->peer_self &&
+              !CHECK_FLAG (ri1->peer->sflags, PEER_STATUS_CHECKPOINT))
             if (ri1->peer->status != Established)
               continue;
 
@@ -1624,7 +1662,8 @@ bgp_best_selection (struct bgp *bgp, struct bgp_node *rn,
                     continue;
                   if (ri2->peer &&
                       ri2->peer != bgp->peer_self &&
-                      !CHECK_FLAG (ri2->peer->sflags, PEER_STATUS_NSF_WAIT))
+                      !CHECK_FLAG (ri2->peer->sflags,
+                                   PEER_STATUS_NSF_WAIT | PEER_STATUS_CHECKPOINT))
                     if (ri2->peer->status != Established)
                       continue;
 
@@ -1658,26 +1697,22 @@ bgp_best_selection (struct bgp *bgp, struct bgp_node *rn,
   /* Check old selected route and new selected route. */
   old_select = NULL;
   new_select = NULL;
-  for (ri = rn->info; (ri != NULL) && (nextri = ri->next, 1); ri = nextri)
+  for (ri = rn->info; ri; ri = ri->next)
     {
+      /* Left over if an earlier computation was not used. */
+      UNSET_FLAG (ri->flags, BGP_INFO_MPATH_CAND);
+
       if (CHECK_FLAG (ri->flags, BGP_INFO_SELECTED))
 	old_select = ri;
 
+      /* REMOVED routes are reaped by bgp_best_selection(). */
       if (BGP_INFO_HOLDDOWN (ri))
-        {
-          /* reap REMOVED routes, if needs be 
-           * selected route must stay for a while longer though
-           */
-          if (CHECK_FLAG (ri->flags, BGP_INFO_REMOVED)
-              && (ri != old_select))
-              bgp_info_reap (rn, ri);
-          
-          continue;
-        }
+        continue;
 
       if (ri->peer &&
           ri->peer != bgp->peer_self &&
-          !CHECK_FLAG (ri->peer->sflags, PEER_STATUS_NSF_WAIT))
+          !CHECK_FLAG (ri->peer->sflags,
+                       PEER_STATUS_NSF_WAIT | PEER_STATUS_CHECKPOINT))
         if (ri->peer->status != Established)
           continue;
 
@@ -1712,7 +1747,7 @@ bgp_best_selection (struct bgp *bgp, struct bgp_node *rn,
 
   if (do_mpath && new_select)
     {
-      for (ri = rn->info; (ri != NULL) && (nextri = ri->next, 1); ri = nextri)
+      for (ri = rn->info; ri; ri = ri->next)
         {
 
           if (debug)
@@ -1723,7 +1758,7 @@ bgp_best_selection (struct bgp *bgp, struct bgp_node *rn,
               if (debug)
                 zlog_debug("%s: %s is the bestpath, add to the multipath list",
                            pfx_buf, path_buf);
-              bgp_mp_list_add (&mp_list, ri);
+              SET_FLAG (ri->flags, BGP_INFO_MPATH_CAND);
               continue;
             }
 
@@ -1732,7 +1767,8 @@ bgp_best_selection (struct bgp *bgp, struct bgp_node *rn,
 
           if (ri->peer &&
               ri->peer != bgp->peer_self &&
-              !CHECK_FLAG (ri->peer->sflags, PEER_STATUS_NSF_WAIT))
+              !CHECK_FLAG (ri->peer->sflags,
+                           PEER_STATUS_NSF_WAIT | PEER_STATUS_CHECKPOINT))
             if (ri->peer->status != Established)
               continue;
 
@@ -1751,19 +1787,69 @@ bgp_best_selection (struct bgp *bgp, struct bgp_node *rn,
               if (debug)
                 zlog_debug("%s: %s is equivalent to the bestpath, add to the multipath list",
                            pfx_buf, path_buf);
-	      bgp_mp_list_add (&mp_list, ri);
+	      SET_FLAG (ri->flags, BGP_INFO_MPATH_CAND);
             }
         }
     }
 
-  bgp_info_mpath_update (rn, new_select, old_select, &mp_list, mpath_cfg);
-  bgp_info_mpath_aggregate_update (new_select, old_select);
-  bgp_mp_list_clear (&mp_list);
-
   result->old = old_select;
   result->new = new_select;
+}
 
-  return;
+/*
+ * Best path selection for a node.  If computed is set, result already
+ * holds what bgp_best_path_compute() found for the node and its paths
+ * are marked; this finishes the job on the main thread.
+ */
+static void
+bgp_best_selection (struct bgp *bgp, struct bgp_node *rn,
+		    struct bgp_maxpaths_cfg *mpath_cfg, int computed,
+		    struct bgp_info_pair *result)
+{
+  struct bgp_info *ri;
+  struct bgp_info *nextri = NULL;
+  struct list mp_list;
+
+  if (!computed)
+    bgp_best_path_compute (bgp, rn, mpath_cfg, bgp_debug_bestpath (&rn->p),
+			   result);
+
+  bgp_mp_list_init (&mp_list);
+
+  for (ri = rn->info; (ri != NULL) && (nextri = ri->next, 1); ri = nextri)
+    {
+      /* reap REMOVED routes, if needs be
+       * selected route must stay for a while longer though
+       */
+      if (BGP_INFO_HOLDDOWN (ri)
+          && CHECK_FLAG (ri->flags, BGP_INFO_REMOVED)
+          && ri != result->old)
+        {
+          bgp_info_reap (rn, ri);
+          continue;
+        }
+
+      if (CHECK_FLAG (ri->flags, BGP_INFO_MPATH_CAND))
+        {
+          UNSET_FLAG (ri->flags, BGP_INFO_MPATH_CAND);
+          bgp_mp_list_add (&mp_list, ri);
+        }
+    }
+
+  bgp_info_mpath_update (rn, result->new, result->old, &mp_list, mpath_cfg);
+  bgp_info_mpath_aggregate_update (result->new, result->old);
+  bgp_mp_list_clear (&mp_list);
+}
+
+/* Run on the selection workers. */
+static void
+bgp_process_compute (void *arg)
+{
+  struct bgp_process_queue *pq = arg;
+
+  bgp_best_path_compute (pq->bgp, pq->rn,
+			 &pq->bgp->maxpaths[pq->afi][pq->safi], 0,
+			 &pq->result);
 }
 
 /*
@@ -1867,18 +1953,9 @@ bgp_zebra_has_route_changed (struct bgp_node *rn, struct bgp_info *selected)
   return 0;
 }
 
-struct bgp_process_queue
-{
-  struct bgp *bgp;
-  struct bgp_node *rn;
-  afi_t afi;
-  safi_t safi;
-};
-
-static wq_item_status
-bgp_process_main (struct work_queue *wq, void *data)
+static void
+bgp_process_node (struct bgp_process_queue *pq)
 {
-  struct bgp_process_queue *pq = data;
   struct bgp *bgp = pq->bgp;
   struct bgp_node *rn = pq->rn;
   afi_t afi = pq->afi;
@@ -1886,30 +1963,15 @@ bgp_process_main (struct work_queue *wq, void *data)
   struct prefix *p = &rn->p;
   struct bgp_info *new_select;
   struct bgp_info *old_select;
-  struct bgp_info_pair old_and_new;
-
-  /* Is it end of initial update? (after startup) */
-  if (!rn)
-    {
-      quagga_timestamp(3, bgp->update_delay_zebra_resume_time,
-                       sizeof(bgp->update_delay_zebra_resume_time));
-
-      bgp->main_zebra_update_hold = 0;
-      for (afi = AFI_IP; afi < AFI_MAX; afi++)
-        for (safi = SAFI_UNICAST; safi < SAFI_MAX; safi++)
-          {
-            bgp_zebra_announce_table(bgp, afi, safi);
-          }
-      bgp->main_peers_update_hold = 0;
-
-      bgp_start_routeadv(bgp);
-      return WQ_SUCCESS;
-    }
+  int computed;
 
   /* Best path selection. */
-  bgp_best_selection (bgp, rn, &bgp->maxpaths[afi][safi], &old_and_new);
-  old_select = old_and_new.old;
-  new_select = old_and_new.new;
+  computed = CHECK_FLAG (rn->flags, BGP_NODE_SELECT_COMPUTED);
+  UNSET_FLAG (rn->flags, BGP_NODE_SELECT_COMPUTED);
+  bgp_best_selection (bgp, rn, &bgp->maxpaths[afi][safi], computed,
+		      &pq->result);
+  old_select = pq->result.old;
+  new_select = pq->result.new;
 
   /* Nothing to do. */
   if (old_select && old_select == new_select &&
@@ -1928,7 +1990,7 @@ bgp_process_main (struct work_queue *wq, void *data)
       UNSET_FLAG (old_select->flags, BGP_INFO_MULTIPATH_CHG);
       bgp_zebra_clear_route_change_flags (rn);
       UNSET_FLAG (rn->flags, BGP_NODE_PROCESS_SCHEDULED);
-      return WQ_SUCCESS;
+      return;
     }
 
   /* If the user did "clear ip bgp prefix x.x.x.x" this flag will be set */
@@ -2003,6 +2065,110 @@ bgp_process_main (struct work_queue *wq, void *data)
     bgp_info_reap (rn, old_select);
   
   UNSET_FLAG (rn->flags, BGP_NODE_PROCESS_SCHEDULED);
+}
+
+/* Most nodes processed in one go with selection workers. */
+#define BGP_PROCESS_BATCH 1024
+
+/*
+ * Process the node of pq and those queued right behind it: compute their
+ * best paths on the selection workers, then process them one by one in
+ * queue order.  It is all done within this call, so nothing can change
+ * in between but what processing the nodes itself does; a node that is
+ * changed that way goes through bgp_process() again, which makes it
+ * compute its best paths anew.  The other items of the batch are marked
+ * done and are dropped when the queue gets to them.
+ *
+ * A batch takes no more nodes than the queue runs between checks whether
+ * it should yield, so that it does not hold the thread any longer than
+ * processing the nodes one at a time would.
+ */
+static void
+bgp_process_batch (struct work_queue *wq, struct bgp_process_queue *pq)
+{
+  struct bgp_process_queue **batch;
+  void **compute;
+  struct listnode *node;
+  struct work_queue_item *item;
+  unsigned int max, count = 0, ncompute = 0, i;
+  int started = 0;
+
+  max = MIN (MAX (wq->cycles.granularity, 1), BGP_PROCESS_BATCH);
+  batch = XMALLOC (MTYPE_TMP, max * sizeof (*batch));
+  compute = XMALLOC (MTYPE_TMP, max * sizeof (*compute));
+
+  for (ALL_LIST_ELEMENTS_RO (wq->items, node, item))
+    {
+      if (item->data == pq)
+        started = 1;
+      if (!started)
+        continue;
+
+      pq = item->data;
+
+      /* The end of initial update is handled on its own, in turn. */
+      if (!pq->rn || count == max)
+        break;
+
+      batch[count++] = pq;
+
+      /* Debug output goes out from the main thread, in order. */
+      if (!bgp_debug_bestpath (&pq->rn->p))
+        compute[ncompute++] = pq;
+    }
+
+  bgp_select_run (compute, ncompute, bgp_process_compute);
+
+  for (i = 0; i < ncompute; i++)
+    {
+      pq = compute[i];
+      SET_FLAG (pq->rn->flags, BGP_NODE_SELECT_COMPUTED);
+    }
+
+  for (i = 0; i < count; i++)
+    {
+      bgp_process_node (batch[i]);
+      batch[i]->done = 1;
+    }
+
+  XFREE (MTYPE_TMP, compute);
+  XFREE (MTYPE_TMP, batch);
+}
+
+static wq_item_status
+bgp_process_main (struct work_queue *wq, void *data)
+{
+  struct bgp_process_queue *pq = data;
+  struct bgp *bgp = pq->bgp;
+  afi_t afi;
+  safi_t safi;
+
+  /* Is it end of initial update? (after startup) */
+  if (!pq->rn)
+    {
+      quagga_timestamp(3, bgp->update_delay_zebra_resume_time,
+                       sizeof(bgp->update_delay_zebra_resume_time));
+
+      bgp->main_zebra_update_hold = 0;
+      for (afi = AFI_IP; afi < AFI_MAX; afi++)
+        for (safi = SAFI_UNICAST; safi < SAFI_MAX; safi++)
+          {
+            bgp_zebra_announce_table(bgp, afi, safi);
+          }
+      bgp->main_peers_update_hold = 0;
+
+      bgp_start_routeadv(bgp);
+      return WQ_SUCCESS;
+    }
+
+  if (pq->done)
+    return WQ_SUCCESS;
+
+  if (bgp_select_workers ())
+    bgp_process_batch (wq, pq);
+  else
+    bgp_process_node (pq);
+
   return WQ_SUCCESS;
 }
 
@@ -2052,7 +2218,11 @@ bgp_process (struct bgp *bgp, struct bgp_node *rn, afi_t afi, safi_t safi)
   
   /* already scheduled for processing? */
   if (CHECK_FLAG (rn->flags, BGP_NODE_PROCESS_SCHEDULED))
-    return;
+    {
+      /* Best paths computed ahead are out of date now. */
+      UNSET_FLAG (rn->flags, BGP_NODE_SELECT_COMPUTED);
+      return;
+    }
 
   if (bm->process_main_queue == NULL)
     bgp_process_queue_init ();
@@ -2802,6 +2972,61 @@ bgp_update (struct peer *peer, struct prefix *p, u_int32_t addpath_id,
   return 0;
 }
 
+/* Install a route from a peer as stale, as it was before a restart.  The
+   attribute is interned already and taken over; the route stays until
+   the peer announces it again, or it is cleared with the other stale
+   routes.  Returns 0 if there is a route from the peer there already. */
+int
+bgp_update_stale (struct peer *peer, struct prefix *p, u_int32_t addpath_id,
+                  struct attr *attr, afi_t afi, safi_t safi)
+{
+  struct bgp *bgp = peer->bgp;
+  struct bgp_node *rn;
+  struct bgp_info *ri;
+  struct bgp_info *new;
+  int connected;
+
+  rn = bgp_afi_node_get (bgp->rib[afi][safi], afi, safi, p, NULL);
+
+  for (ri = rn->info; ri; ri = ri->next)
+    if (ri->peer == peer && ri->type == ZEBRA_ROUTE_BGP
+        && ri->sub_type == BGP_ROUTE_NORMAL
+        && ri->addpath_rx_id == addpath_id)
+      {
+        bgp_unlock_node (rn);
+        return 0;
+      }
+
+  new = info_make (ZEBRA_ROUTE_BGP, BGP_ROUTE_NORMAL, 0, peer, attr, rn);
+  new->addpath_rx_id = addpath_id;
+  SET_FLAG (new->flags, BGP_INFO_STALE);
+
+  /* Nexthop reachability check, as for a received route. */
+  if ((afi == AFI_IP || afi == AFI_IP6) && safi == SAFI_UNICAST)
+    {
+      if (peer->sort == BGP_PEER_EBGP && peer->ttl == 1 &&
+	  ! CHECK_FLAG (peer->flags, PEER_FLAG_DISABLE_CONNECTED_CHECK)
+	  && ! bgp_flag_check(bgp, BGP_FLAG_DISABLE_NH_CONNECTED_CHK))
+	connected = 1;
+      else
+	connected = 0;
+
+      if (bgp_find_or_add_nexthop (bgp, afi, new, NULL, connected))
+	bgp_info_set_flag (rn, new, BGP_INFO_VALID);
+      else
+	bgp_info_unset_flag (rn, new, BGP_INFO_VALID);
+    }
+  else
+    bgp_info_set_flag (rn, new, BGP_INFO_VALID);
+
+  bgp_aggregate_increment (bgp, p, new, afi, safi);
+  bgp_info_add (rn, new);
+  bgp_unlock_node (rn);
+
+  bgp_process (bgp, rn, afi, safi);
+  return 1;
+}
+
 int
 bgp_withdraw (struct peer *peer, struct prefix *p, u_int32_t addpath_id,
               struct attr *attr, afi_t afi, safi_t safi, int type, int sub_type,
@@ -2982,27 +3207,23 @@ bgp_soft_reconfig_table (struct peer *peer, afi_t afi, safi_t safi,
   int ret;
   struct bgp_node *rn;
   struct bgp_adj_in *ain;
-
-  if (! table)
-    table = peer->bgp->rib[afi][safi];
+  struct bgp_adj_in_table *adj_in = peer->adj_in[afi][safi];
 
   for (rn = bgp_table_top (table); rn; rn = bgp_route_next (rn))
-    for (ain = rn->adj_in; ain; ain = ain->next)
+    for (ain = bgp_adj_in_node_first (adj_in, rn); ain;
+         ain = bgp_adj_in_node_next (adj_in, ain))
       {
-	if (ain->peer == peer)
-	  {
-	    struct bgp_info *ri = rn->info;
-	    u_char *tag = (ri && ri->extra) ? ri->extra->tag : NULL;
+	struct bgp_info *ri = rn->info;
+	u_char *tag = (ri && ri->extra) ? ri->extra->tag : NULL;
 
-	    ret = bgp_update (peer, &rn->p, ain->addpath_rx_id, ain->attr,
-                              afi, safi, ZEBRA_ROUTE_BGP, BGP_ROUTE_NORMAL,
-			      prd, tag, 1);
+	ret = bgp_update (peer, &rn->p, ain->addpath_rx_id, ain->attr,
+                          afi, safi, ZEBRA_ROUTE_BGP, BGP_ROUTE_NORMAL,
+			  prd, tag, 1);
 
-	    if (ret < 0)
-	      {
-		bgp_unlock_node (rn);
-		return;
-	      }
+	if (ret < 0)
+	  {
+	    bgp_unlock_node (rn);
+	    return;
 	  }
       }
 }
@@ -3012,12 +3233,27 @@ bgp_soft_reconfig_in (struct peer *peer, afi_t afi, safi_t safi)
 {
   struct bgp_node *rn;
   struct bgp_table *table;
+  struct bgp_adj_in *ain;
 
   if (peer->status != Established)
     return;
 
+  /* The routes kept from the peer are in its table, but in the two level
+     tables the RD is only known from the table they are in. */
   if ((safi != SAFI_MPLS_VPN) && (safi != SAFI_ENCAP))
-    bgp_soft_reconfig_table (peer, afi, safi, NULL, NULL);
+    {
+      for (ain = bgp_adj_in_first (peer->adj_in[afi][safi]); ain;
+           ain = bgp_adj_in_next (peer->adj_in[afi][safi], ain))
+        {
+          struct bgp_info *ri = ain->rn->info;
+          u_char *tag = (ri && ri->extra) ? ri->extra->tag : NULL;
+
+          if (bgp_update (peer, &ain->rn->p, ain->addpath_rx_id, ain->attr,
+                          afi, safi, ZEBRA_ROUTE_BGP, BGP_ROUTE_NORMAL,
+                          NULL, tag, 1) < 0)
+            return;
+        }
+    }
   else
     for (rn = bgp_table_top (peer->bgp->rib[afi][safi]); rn;
 	 rn = bgp_route_next (rn))
@@ -3032,7 +3268,6 @@ bgp_soft_reconfig_in (struct peer *peer, afi_t afi, safi_t safi)
         }
 }
 
-
 struct bgp_clear_node_queue
 {
   struct bgp_node *rn;
@@ -3114,106 +3349,54 @@ bgp_clear_node_queue_init (struct peer *peer)
   peer->clear_node_queue->spec.data = peer;
 }
 
+/* Queue the nodes with paths from the peer for clearing, or remove the
+ * paths at once if there is no processing queue.  Only the peer's own
+ * paths and kept routes are visited; its adj-outs are left for the
+ * update groups.
+ */
 static void
-bgp_clear_route_table (struct peer *peer, afi_t afi, safi_t safi,
-                       struct bgp_table *table)
+bgp_clear_route_table (struct peer *peer, afi_t afi, safi_t safi)
 {
   struct bgp_node *rn;
+  struct bgp_info *ri, *next, *first;
   int force = bm->process_main_queue ? 0 : 1;
-  
-  if (! table)
-    table = peer->bgp->rib[afi][safi];
-  
-  /* If still no table => afi/safi isn't configured at all or smth. */
-  if (! table)
-    return;
-  
-  for (rn = bgp_table_top (table); rn; rn = bgp_route_next (rn))
-    {
-      struct bgp_info *ri, *next;
-      struct bgp_adj_in *ain;
-      struct bgp_adj_in *ain_next;
-
-      /* XXX:TODO: This is suboptimal, every non-empty route_node is
-       * queued for every clearing peer, regardless of whether it is
-       * relevant to the peer at hand.
-       *
-       * Overview: There are 3 different indices which need to be
-       * scrubbed, potentially, when a peer is removed:
-       *
-       * 1 peer's routes visible via the RIB (ie accepted routes)
-       * 2 peer's routes visible by the (optional) peer's adj-in index
-       * 3 other routes visible by the peer's adj-out index
-       *
-       * 3 there is no hurry in scrubbing, once the struct peer is
-       * removed from bgp->peer, we could just GC such deleted peer's
-       * adj-outs at our leisure.
-       *
-       * 1 and 2 must be 'scrubbed' in some way, at least made
-       * invisible via RIB index before peer session is allowed to be
-       * brought back up. So one needs to know when such a 'search' is
-       * complete.
-       *
-       * Ideally:
-       *
-       * - there'd be a single global queue or a single RIB walker
-       * - rather than tracking which route_nodes still need to be
-       *   examined on a peer basis, we'd track which peers still
-       *   aren't cleared
-       *
-       * Given that our per-peer prefix-counts now should be reliable,
-       * this may actually be achievable. It doesn't seem to be a huge
-       * problem at this time,
-       *
-       * It is possible that we have multiple paths for a prefix from a peer
-       * if that peer is using AddPath.
-       */
-      ain = rn->adj_in;
-      while (ain)
-        {
-          ain_next = ain->next;
 
-          if (ain->peer == peer)
-            {
-              bgp_adj_in_remove (rn, ain);
-              bgp_unlock_node (rn);
-            }
+  bgp_adj_in_clear (peer, afi, safi);
+
+  for (ri = peer->paths[afi][safi]; ri; ri = next)
+    {
+      next = ri->peer_next;
+      rn = ri->net;
 
-          ain = ain_next;
+      if (force)
+        {
+          bgp_info_reap (rn, ri);
+          continue;
         }
 
-      for (ri = rn->info; ri; ri = next)
-	{
-	  next = ri->next;
-	  if (ri->peer != peer)
-	    continue;
+      /* A peer using AddPath may have several paths on a node, queue
+       * the node once, for the first of them.
+       */
+      for (first = rn->info; first->peer != peer; first = first->next)
+        ;
+      if (first == ri)
+        {
+          struct bgp_clear_node_queue *cnq;
 
-	  if (force)
-	    bgp_info_reap (rn, ri);
-	  else
-	    {
-	      struct bgp_clear_node_queue *cnq;
-
-	      /* both unlocked in bgp_clear_node_queue_del */
-	      bgp_table_lock (bgp_node_table (rn));
-	      bgp_lock_node (rn);
-	      cnq = XCALLOC (MTYPE_BGP_CLEAR_NODE_QUEUE,
-			     sizeof (struct bgp_clear_node_queue));
-	      cnq->rn = rn;
-	      work_queue_add (peer->clear_node_queue, cnq);
-	      break;
-	    }
-	}
+          /* both unlocked in bgp_clear_node_queue_del */
+          bgp_table_lock (bgp_node_table (rn));
+          bgp_lock_node (rn);
+          cnq = XCALLOC (MTYPE_BGP_CLEAR_NODE_QUEUE,
+                         sizeof (struct bgp_clear_node_queue));
+          cnq->rn = rn;
+          work_queue_add (peer->clear_node_queue, cnq);
+        }
     }
-  return;
 }
 
 void
 bgp_clear_route (struct peer *peer, afi_t afi, safi_t safi)
 {
-  struct bgp_node *rn;
-  struct bgp_table *table;
-
   if (peer->clear_node_queue == NULL)
     bgp_clear_node_queue_init (peer);
   
@@ -3237,13 +3420,7 @@ bgp_clear_route (struct peer *peer, afi_t afi, safi_t safi)
   if (!peer->clear_node_queue->thread)
     peer_lock (peer);
 
-  if (safi != SAFI_MPLS_VPN && safi != SAFI_ENCAP)
-    bgp_clear_route_table (peer, afi, safi, NULL);
-  else
-    for (rn = bgp_table_top (peer->bgp->rib[afi][safi]); rn;
-         rn = bgp_route_next (rn))
-      if ((table = rn->info) != NULL)
-        bgp_clear_route_table (peer, afi, safi, table);
+  bgp_clear_route_table (peer, afi, safi);
 
   /* unlock if no nodes got added to the clear-node-queue. */
   if (!peer->clear_node_queue->thread)
@@ -3269,74 +3446,24 @@ bgp_clear_route_all (struct peer *peer)
 void
 bgp_clear_adj_in (struct peer *peer, afi_t afi, safi_t safi)
 {
-  struct bgp_table *table;
-  struct bgp_node *rn;
-  struct bgp_adj_in *ain;
-  struct bgp_adj_in *ain_next;
-
-  table = peer->bgp->rib[afi][safi];
-
-  /* It is possible that we have multiple paths for a prefix from a peer
-   * if that peer is using AddPath.
-   */
-  for (rn = bgp_table_top (table); rn; rn = bgp_route_next (rn))
-    {
-      ain = rn->adj_in;
-
-      while (ain)
-        {
-          ain_next = ain->next;
-
-          if (ain->peer == peer)
-            {
-              bgp_adj_in_remove (rn, ain);
-              bgp_unlock_node (rn);
-	    }
-
-          ain = ain_next;
-        }
-    }
+  bgp_adj_in_clear (peer, afi, safi);
 }
 
 void
 bgp_clear_stale_route (struct peer *peer, afi_t afi, safi_t safi)
 {
-  struct bgp_node *rn;
   struct bgp_info *ri;
-  struct bgp_table *table;
-
-  if ( safi == SAFI_MPLS_VPN)
-    {
-      for (rn = bgp_table_top (peer->bgp->rib[afi][safi]); rn; rn = bgp_route_next (rn))
-        {
-          struct bgp_node *rm;
-          struct bgp_info *ri;
+  struct bgp_info *next;
 
-          /* look for neighbor in tables */
-          if ((table = rn->info) != NULL)
-            {
-              for (rm = bgp_table_top (table); rm; rm = bgp_route_next (rm))
-                for (ri = rm->info; ri; ri = ri->next)
-                  if (ri->peer == peer)
-                    {
-                      if (CHECK_FLAG (ri->flags, BGP_INFO_STALE))
-                        bgp_rib_remove (rm, ri, peer, afi, safi);
-                      break;
-                    }
-            }
-        }
-    }
-  else
+  for (ri = peer->paths[afi][safi]; ri; ri = next)
     {
-      for (rn = bgp_table_top (peer->bgp->rib[afi][safi]); rn; rn = bgp_route_next (rn))
-        for (ri = rn->info; ri; ri = ri->next)
-          if (ri->peer == peer)
-            {
-              if (CHECK_FLAG (ri->flags, BGP_INFO_STALE))
-                bgp_rib_remove (rn, ri, peer, afi, safi);
-              break;
-            }
+      next = ri->peer_next;
+      if (CHECK_FLAG (ri->flags, BGP_INFO_STALE))
+        bgp_rib_remove (ri->net, ri, peer, afi, safi);
     }
+
+  if (peer->adj_in[afi][safi])
+    bgp_adj_in_clear_stale (peer, afi, safi);
 }
 
 static void
@@ -6046,7 +6173,7 @@ route_vty_out (struct vty *vty, struct prefix *p,
       if (attr->aspath)
         {
           if (json_paths)
-            json_object_string_add(json_path, "aspath", attr->aspath->str);
+            json_object_string_add(json_path, "aspath", aspath_print (attr->aspath));
           else
             aspath_print_vty (vty, "%s", attr->aspath, " ");
         }
@@ -6156,7 +6283,7 @@ route_vty_out_tmp (struct vty *vty, struct prefix *p, struct attr *attr, safi_t
 
           /* Print aspath */
           if (attr->aspath)
-            json_object_string_add(json_net, "asPath", attr->aspath->str);
+            json_object_string_add(json_net, "asPath", aspath_print (attr->aspath));
 
           /* Print origin */
           json_object_string_add(json_net, "bgpOriginCode", bgp_origin_str[attr->origin]);
@@ -6372,7 +6499,7 @@ damp_route_vty_out (struct vty *vty, struct prefix *p, struct bgp_info *binfo,
       if (attr->aspath)
         {
           if (use_json)
-            json_object_string_add(json, "asPath", attr->aspath->str);
+            json_object_string_add(json, "asPath", aspath_print (attr->aspath));
           else
             aspath_print_vty (vty, "%s", attr->aspath, " ");
         }
@@ -6472,7 +6599,7 @@ flap_route_vty_out (struct vty *vty, struct prefix *p, struct bgp_info *binfo,
       if (attr->aspath)
         {
           if (use_json)
-            json_object_string_add(json, "asPath", attr->aspath->str);
+            json_object_string_add(json, "asPath", aspath_print (attr->aspath));
           else
             aspath_print_vty (vty, "%s", attr->aspath, " ");
         }
@@ -6583,8 +6710,10 @@ route_vty_out_detail (struct vty *vty, struct bgp *bgp, struct prefix *p,
 	{
           if (json_paths)
            {
-            json_object_lock(attr->aspath->json);
-            json_object_object_add(json_path, "aspath", attr->aspath->json);
+            json_object *json_aspath = aspath_get_json (attr->aspath);
+
+            json_object_lock(json_aspath);
+            json_object_object_add(json_path, "aspath", json_aspath);
            }
           else
             {
@@ -8860,68 +8989,60 @@ struct peer_pcounts
 {
   unsigned int count[PCOUNT_MAX];
   const struct peer *peer;
-  const struct bgp_table *table;
+  afi_t afi;
+  safi_t safi;
 };
 
 static int
 bgp_peer_count_walker (struct thread *t)
 {
-  struct bgp_node *rn;
+  struct bgp_info *ri;
   struct peer_pcounts *pc = THREAD_ARG (t);
   const struct peer *peer = pc->peer;
   
-  for (rn = bgp_table_top (pc->table); rn; rn = bgp_route_next (rn))
+  if (peer->adj_in[pc->afi][pc->safi])
+    pc->count[PCOUNT_ADJ_IN] = peer->adj_in[pc->afi][pc->safi]->count;
+
+  for (ri = peer->paths[pc->afi][pc->safi]; ri; ri = ri->peer_next)
     {
-      struct bgp_adj_in *ain;
-      struct bgp_info *ri;
+      struct bgp_node *rn = ri->net;
+      char buf[SU_ADDRSTRLEN];
       
-      for (ain = rn->adj_in; ain; ain = ain->next)
-        if (ain->peer == peer)
-          pc->count[PCOUNT_ADJ_IN]++;
-
-      for (ri = rn->info; ri; ri = ri->next)
+      pc->count[PCOUNT_ALL]++;
+      
+      if (CHECK_FLAG (ri->flags, BGP_INFO_DAMPED))
+        pc->count[PCOUNT_DAMPED]++;
+      if (CHECK_FLAG (ri->flags, BGP_INFO_HISTORY))
+        pc->count[PCOUNT_HISTORY]++;
+      if (CHECK_FLAG (ri->flags, BGP_INFO_REMOVED))
+        pc->count[PCOUNT_REMOVED]++;
+      if (CHECK_FLAG (ri->flags, BGP_INFO_STALE))
+        pc->count[PCOUNT_STALE]++;
+      if (CHECK_FLAG (ri->flags, BGP_INFO_VALID))
+        pc->count[PCOUNT_VALID]++;
+      if (!CHECK_FLAG (ri->flags, BGP_INFO_UNUSEABLE))
+        pc->count[PCOUNT_PFCNT]++;
+      
+      if (CHECK_FLAG (ri->flags, BGP_INFO_COUNTED))
+        {
+          pc->count[PCOUNT_COUNTED]++;
+          if (CHECK_FLAG (ri->flags, BGP_INFO_UNUSEABLE))
+            zlog_warn ("%s [pcount] %s/%d is counted but flags 0x%x",
+                       peer->host,
+                       inet_ntop(rn->p.family, &rn->p.u.prefix,
+                                 buf, SU_ADDRSTRLEN),
+                       rn->p.prefixlen,
+                       ri->flags);
+        }
+      else
         {
-          char buf[SU_ADDRSTRLEN];
-          
-          if (ri->peer != peer)
-            continue;
-          
-          pc->count[PCOUNT_ALL]++;
-          
-          if (CHECK_FLAG (ri->flags, BGP_INFO_DAMPED))
-            pc->count[PCOUNT_DAMPED]++;
-          if (CHECK_FLAG (ri->flags, BGP_INFO_HISTORY))
-            pc->count[PCOUNT_HISTORY]++;
-          if (CHECK_FLAG (ri->flags, BGP_INFO_REMOVED))
-            pc->count[PCOUNT_REMOVED]++;
-          if (CHECK_FLAG (ri->flags, BGP_INFO_STALE))
-            pc->count[PCOUNT_STALE]++;
-          if (CHECK_FLAG (ri->flags, BGP_INFO_VALID))
-            pc->count[PCOUNT_VALID]++;
           if (!CHECK_FLAG (ri->flags, BGP_INFO_UNUSEABLE))
-            pc->count[PCOUNT_PFCNT]++;
-          
-          if (CHECK_FLAG (ri->flags, BGP_INFO_COUNTED))
-            {
-              pc->count[PCOUNT_COUNTED]++;
-              if (CHECK_FLAG (ri->flags, BGP_INFO_UNUSEABLE))
-                zlog_warn ("%s [pcount] %s/%d is counted but flags 0x%x",
-                           peer->host,
-                           inet_ntop(rn->p.family, &rn->p.u.prefix,
-                                     buf, SU_ADDRSTRLEN),
-                           rn->p.prefixlen,
-                           ri->flags);
-            }
-          else
-            {
-              if (!CHECK_FLAG (ri->flags, BGP_INFO_UNUSEABLE))
-                zlog_warn ("%s [pcount] %s/%d not counted but flags 0x%x",
-                           peer->host,
-                           inet_ntop(rn->p.family, &rn->p.u.prefix,
-                                     buf, SU_ADDRSTRLEN),
-                           rn->p.prefixlen,
-                           ri->flags);
-            }
+            zlog_warn ("%s [pcount] %s/%d not counted but flags 0x%x",
+                       peer->host,
+                       inet_ntop(rn->p.family, &rn->p.u.prefix,
+                                 buf, SU_ADDRSTRLEN),
+                       rn->p.prefixlen,
+                       ri->flags);
         }
     }
   return 0;
@@ -8958,7 +9079,8 @@ bgp_peer_counts (struct vty *vty, struct peer *peer, afi_t afi, safi_t safi, u_c
   
   memset (&pcounts, 0, sizeof(pcounts));
   pcounts.peer = peer;
-  pcounts.table = peer->bgp->rib[afi][safi];
+  pcounts.afi = afi;
+  pcounts.safi = safi;
   
   /* in-place call via thread subsystem so as to record execution time
  *    * stats for the thread-walk (i.e. ensure this can't be blamed on
@@ -9290,44 +9412,42 @@ show_adj_route (struct vty *vty, struct peer *peer, afi_t afi, safi_t safi,
     {
       if (in)
         {
-          for (ain = rn->adj_in; ain; ain = ain->next)
+          for (ain = bgp_adj_in_node_first (peer->adj_in[afi][safi], rn); ain;
+               ain = bgp_adj_in_node_next (peer->adj_in[afi][safi], ain))
             {
-              if (ain->peer == peer)
+              if (header1)
                 {
-                  if (header1)
+                  if (use_json)
                     {
-                      if (use_json)
-                        {
-                          json_object_int_add(json, "bgpTableVersion", 0);
-                          json_object_string_add(json, "bgpLocalRouterId", inet_ntoa (bgp->router_id));
-                          json_object_object_add(json, "bgpStatusCodes", json_scode);
-                          json_object_object_add(json, "bgpOriginCodes", json_ocode);
-                        }
-                      else
-                        {
-                          vty_out (vty, "BGP table version is 0, local router ID is %s%s", inet_ntoa (bgp->router_id), VTY_NEWLINE);
-                          vty_out (vty, BGP_SHOW_SCODE_HEADER, VTY_NEWLINE, VTY_NEWLINE);
-                          vty_out (vty, BGP_SHOW_OCODE_HEADER, VTY_NEWLINE, VTY_NEWLINE);
-                        }
-                      header1 = 0;
+                      json_object_int_add(json, "bgpTableVersion", 0);
+                      json_object_string_add(json, "bgpLocalRouterId", inet_ntoa (bgp->router_id));
+                      json_object_object_add(json, "bgpStatusCodes", json_scode);
+                      json_object_object_add(json, "bgpOriginCodes", json_ocode);
                     }
-                  if (header2)
+                  else
                     {
-                      if (!use_json)
-                        vty_out (vty, BGP_SHOW_HEADER, VTY_NEWLINE);
-                      header2 = 0;
+                      vty_out (vty, "BGP table version is 0, local router ID is %s%s", inet_ntoa (bgp->router_id), VTY_NEWLINE);
+                      vty_out (vty, BGP_SHOW_SCODE_HEADER, VTY_NEWLINE, VTY_NEWLINE);
+                      vty_out (vty, BGP_SHOW_OCODE_HEADER, VTY_NEWLINE, VTY_NEWLINE);
                     }
-                  if (ain->attr)
+                  header1 = 0;
+                }
+              if (header2)
+                {
+                  if (!use_json)
+                    vty_out (vty, BGP_SHOW_HEADER, VTY_NEWLINE);
+                  header2 = 0;
+                }
+              if (ain->attr)
+                {
+                  bgp_attr_dup(&attr, ain->attr);
+                  if (bgp_input_modifier(peer, &rn->p, &attr, afi, safi, rmap_name) != RMAP_DENY)
                     {
-                      bgp_attr_dup(&attr, ain->attr);
-                      if (bgp_input_modifier(peer, &rn->p, &attr, afi, safi, rmap_name) != RMAP_DENY)
-                        {
-                          route_vty_out_tmp (vty, &rn->p, &attr, safi, use_json, json_ar);
-                          output_count++;
-                        }
-                      else
-                        filtered_count++;
+                      route_vty_out_tmp (vty, &rn->p, &attr, safi, use_json, json_ar);
+                      output_count++;
                     }
+                  else
+                    filtered_count++;
                 }
             }
         }
@@ -93,6 +93,10 @@ struct bgp_info
   /* Peer structure.  */
   struct peer *peer;
 
+  /* For the list of the peer's paths, peer->paths */
+  struct bgp_info *peer_next;
+  struct bgp_info *peer_prev;
+
   /* Attribute structure.  */
   struct attr *attr;
   
@@ -124,6 +128,7 @@ struct bgp_info
 #define BGP_INFO_COUNTED	(1 << 10)
 #define BGP_INFO_MULTIPATH      (1 << 11)
 #define BGP_INFO_MULTIPATH_CHG  (1 << 12)
+#define BGP_INFO_MPATH_CAND     (1 << 13)
 
   /* BGP route type.  This can be static, RIP, OSPF, BGP etc.  */
   u_char type;
@@ -298,6 +303,8 @@ extern int bgp_update (struct peer *, struct prefix *, u_int32_t, struct attr *,
 		       u_char *, int);
 extern int bgp_withdraw (struct peer *, struct prefix *, u_int32_t, struct attr *,
 			 afi_t, safi_t, int, int, struct prefix_rd *, u_char *);
+extern int bgp_update_stale (struct peer *, struct prefix *, u_int32_t,
+                             struct attr *, afi_t, safi_t);
 
 /* for bgp_nexthop and bgp_damp */
 extern void bgp_process (struct bgp *, struct bgp_node *, afi_t, safi_t);
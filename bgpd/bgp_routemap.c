@@ -37,6 +37,7 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "buffer.h"
 #include "sockunion.h"
 #include "hash.h"
+#include "jhash.h"
 #include "queue.h"
 
 #include "bgpd/bgpd.h"
@@ -211,6 +212,15 @@ route_value_free (void *rule)
   XFREE (MTYPE_ROUTE_MAP_COMPILED, rule);
 }
 
+/* rtt is the peer's, not the route's. */
+static int
+route_value_attr_only (void *rule)
+{
+  struct rmap_value *rv = rule;
+
+  return rv->variable == 0;
+}
+
  /* generic as path object to be shared in multiple rules */
 
 static void *
@@ -420,7 +430,8 @@ struct route_map_rule_cmd route_match_ip_next_hop_cmd =
   "ip next-hop",
   route_match_ip_next_hop,
   route_match_ip_next_hop_compile,
-  route_match_ip_next_hop_free
+  route_match_ip_next_hop_free,
+  route_map_rule_attr_only
 };
 
 /* `match ip route-source ACCESS-LIST' */
@@ -565,7 +576,8 @@ struct route_map_rule_cmd route_match_ip_next_hop_prefix_list_cmd =
   "ip next-hop prefix-list",
   route_match_ip_next_hop_prefix_list,
   route_match_ip_next_hop_prefix_list_compile,
-  route_match_ip_next_hop_prefix_list_free
+  route_match_ip_next_hop_prefix_list_free,
+  route_map_rule_attr_only
 };
 
 /* `match ip route-source prefix-list PREFIX_LIST' */
@@ -684,7 +696,8 @@ struct route_map_rule_cmd route_match_local_pref_cmd =
   "local-preference",
   route_match_local_pref,
   route_match_local_pref_compile,
-  route_match_local_pref_free
+  route_match_local_pref_free,
+  route_map_rule_attr_only
 };
 
 /* `match metric METRIC' */
@@ -713,6 +726,7 @@ struct route_map_rule_cmd route_match_metric_cmd =
   route_match_metric,
   route_value_compile,
   route_value_free,
+  route_map_rule_attr_only,
 };
 
 /* `match as-path ASPATH' */
@@ -760,7 +774,8 @@ struct route_map_rule_cmd route_match_aspath_cmd =
   "as-path",
   route_match_aspath,
   route_match_aspath_compile,
-  route_match_aspath_free
+  route_match_aspath_free,
+  route_map_rule_attr_only
 };
 
 /* `match community COMMUNIY' */
@@ -844,7 +859,8 @@ struct route_map_rule_cmd route_match_community_cmd =
   "community",
   route_match_community,
   route_match_community_compile,
-  route_match_community_free
+  route_match_community_free,
+  route_map_rule_attr_only
 };
 
 /* Match function for extcommunity match. */
@@ -893,7 +909,8 @@ struct route_map_rule_cmd route_match_ecommunity_cmd =
   "extcommunity",
   route_match_ecommunity,
   route_match_ecommunity_compile,
-  route_match_ecommunity_free
+  route_match_ecommunity_free,
+  route_map_rule_attr_only
 };
 
 /* `match nlri` and `set nlri` are replaced by `address-family ipv4`
@@ -949,7 +966,8 @@ struct route_map_rule_cmd route_match_origin_cmd =
   "origin",
   route_match_origin,
   route_match_origin_compile,
-  route_match_origin_free
+  route_match_origin_free,
+  route_map_rule_attr_only
 };
 
 /* match probability  { */
@@ -1092,6 +1110,7 @@ static struct route_map_rule_cmd route_match_tag_cmd =
   route_match_tag,
   route_map_rule_tag_compile,
   route_map_rule_tag_free,
+  route_map_rule_attr_only,
 };
 
 
@@ -1203,13 +1222,22 @@ route_set_ip_nexthop_free (void *rule)
   XFREE (MTYPE_ROUTE_MAP_COMPILED, rins);
 }
 
+static int
+route_set_ip_nexthop_attr_only (void *rule)
+{
+  struct rmap_ip_nexthop_set *rins = rule;
+
+  return ! rins->peer_address;
+}
+
 /* Route map commands for ip nexthop set. */
 struct route_map_rule_cmd route_set_ip_nexthop_cmd =
 {
   "ip next-hop",
   route_set_ip_nexthop,
   route_set_ip_nexthop_compile,
-  route_set_ip_nexthop_free
+  route_set_ip_nexthop_free,
+  route_set_ip_nexthop_attr_only
 };
 
 /* `set local-preference LOCAL_PREF' */
@@ -1247,6 +1275,7 @@ struct route_map_rule_cmd route_set_local_pref_cmd =
   route_set_local_pref,
   route_value_compile,
   route_value_free,
+  route_value_attr_only,
 };
 
 /* `set weight WEIGHT' */
@@ -1284,6 +1313,7 @@ struct route_map_rule_cmd route_set_weight_cmd =
   route_set_weight,
   route_value_compile,
   route_value_free,
+  route_value_attr_only,
 };
 
 /* `set metric METRIC' */
@@ -1319,6 +1349,7 @@ struct route_map_rule_cmd route_set_metric_cmd =
   route_set_metric,
   route_value_compile,
   route_value_free,
+  route_value_attr_only,
 };
 
 /* `set as-path prepend ASPATH' */
@@ -1376,6 +1407,13 @@ route_set_aspath_prepend_free (void *rule)
     route_aspath_free(rule);
 }
 
+/* last-as falls back on the peer's AS. */
+static int
+route_set_aspath_prepend_attr_only (void *rule)
+{
+  return (uintptr_t)rule > 10;
+}
+
 
 /* Set as-path prepend rule structure. */
 struct route_map_rule_cmd route_set_aspath_prepend_cmd =
@@ -1384,6 +1422,7 @@ struct route_map_rule_cmd route_set_aspath_prepend_cmd =
   route_set_aspath_prepend,
   route_set_aspath_prepend_compile,
   route_set_aspath_prepend_free,
+  route_set_aspath_prepend_attr_only,
 };
 
 /* `set as-path exclude ASn' */
@@ -1418,6 +1457,7 @@ struct route_map_rule_cmd route_set_aspath_exclude_cmd =
   route_set_aspath_exclude,
   route_aspath_compile,
   route_aspath_free,
+  route_map_rule_attr_only,
 };
 
 /* `set community COMMUNITY' */
@@ -1542,6 +1582,7 @@ struct route_map_rule_cmd route_set_community_cmd =
   route_set_community,
   route_set_community_compile,
   route_set_community_free,
+  route_map_rule_attr_only,
 };
 
 /* `set comm-list (<1-99>|<100-500>|WORD) delete' */
@@ -1631,6 +1672,7 @@ struct route_map_rule_cmd route_set_community_delete_cmd =
   route_set_community_delete,
   route_set_community_delete_compile,
   route_set_community_delete_free,
+  route_map_rule_attr_only,
 };
 
 /* `set extcommunity rt COMMUNITY' */
@@ -1703,6 +1745,7 @@ struct route_map_rule_cmd route_set_ecommunity_rt_cmd =
   route_set_ecommunity,
   route_set_ecommunity_rt_compile,
   route_set_ecommunity_free,
+  route_map_rule_attr_only,
 };
 
 /* `set extcommunity soo COMMUNITY' */
@@ -1727,6 +1770,7 @@ struct route_map_rule_cmd route_set_ecommunity_soo_cmd =
   route_set_ecommunity,
   route_set_ecommunity_soo_compile,
   route_set_ecommunity_free,
+  route_map_rule_attr_only,
 };
 
 /* `set origin ORIGIN' */
@@ -1781,6 +1825,7 @@ struct route_map_rule_cmd route_set_origin_cmd =
   route_set_origin,
   route_set_origin_compile,
   route_set_origin_free,
+  route_map_rule_attr_only,
 };
 
 /* `set atomic-aggregate' */
@@ -1822,6 +1867,7 @@ struct route_map_rule_cmd route_set_atomic_aggregate_cmd =
   route_set_atomic_aggregate,
   route_set_atomic_aggregate_compile,
   route_set_atomic_aggregate_free,
+  route_map_rule_attr_only,
 };
 
 /* `set aggregator as AS A.B.C.D' */
@@ -1881,6 +1927,7 @@ struct route_map_rule_cmd route_set_aggregator_as_cmd =
   route_set_aggregator_as,
   route_set_aggregator_as_compile,
   route_set_aggregator_as_free,
+  route_map_rule_attr_only,
 };
 
 /* Set tag to object. object must be pointer to struct bgp_info */
@@ -1913,6 +1960,7 @@ static struct route_map_rule_cmd route_set_tag_cmd =
   route_set_tag,
   route_map_rule_tag_compile,
   route_map_rule_tag_free,
+  route_map_rule_attr_only,
 };
 
 
@@ -2015,7 +2063,8 @@ struct route_map_rule_cmd route_match_ipv6_next_hop_cmd =
   "ipv6 next-hop",
   route_match_ipv6_next_hop,
   route_match_ipv6_next_hop_compile,
-  route_match_ipv6_next_hop_free
+  route_match_ipv6_next_hop_free,
+  route_map_rule_attr_only
 };
 
 /* `match ipv6 address prefix-list PREFIX_LIST' */
@@ -2122,7 +2171,8 @@ struct route_map_rule_cmd route_set_ipv6_nexthop_global_cmd =
   "ipv6 next-hop global",
   route_set_ipv6_nexthop_global,
   route_set_ipv6_nexthop_global_compile,
-  route_set_ipv6_nexthop_global_free
+  route_set_ipv6_nexthop_global_free,
+  route_map_rule_attr_only
 };
 
 /* Set next-hop preference value. */
@@ -2250,7 +2300,8 @@ struct route_map_rule_cmd route_set_ipv6_nexthop_local_cmd =
   "ipv6 next-hop local",
   route_set_ipv6_nexthop_local,
   route_set_ipv6_nexthop_local_compile,
-  route_set_ipv6_nexthop_local_free
+  route_set_ipv6_nexthop_local_free,
+  route_map_rule_attr_only
 };
 
 /* `set ipv6 nexthop peer-address' */
@@ -2435,7 +2486,8 @@ struct route_map_rule_cmd route_set_vpnv4_nexthop_cmd =
   "ip vpn next-hop",
   route_set_vpnv4_nexthop,
   route_set_vpnv4_nexthop_compile,
-  route_set_vpn_nexthop_free
+  route_set_vpn_nexthop_free,
+  route_map_rule_attr_only
 };
 
 /* Route map commands for ip nexthop set. */
@@ -2444,7 +2496,8 @@ struct route_map_rule_cmd route_set_vpnv6_nexthop_cmd =
   "ipv6 vpn next-hop",
   route_set_vpnv6_nexthop,
   route_set_vpnv6_nexthop_compile,
-  route_set_vpn_nexthop_free
+  route_set_vpn_nexthop_free,
+  route_map_rule_attr_only
 };
 
 /* `set originator-id' */
@@ -2502,8 +2555,30 @@ struct route_map_rule_cmd route_set_originator_id_cmd =
   route_set_originator_id,
   route_set_originator_id_compile,
   route_set_originator_id_free,
+  route_map_rule_attr_only,
 };
 
+/* Note that the route-map RMAP_NAME uses, or no longer uses, the
+   community-list ARG starts with, as in "NAME exact-match" or "NAME
+   delete".  Edits to the list then flush what the map has cached.  The
+   map stays dependent while another of its rules names the list. */
+static void
+bgp_route_map_clist_dependency (route_map_event_t type, const char *arg,
+				const char *rmap_name)
+{
+  char *name;
+  char *p;
+
+  name = XSTRDUP (MTYPE_ROUTE_MAP_RULE, arg);
+  if ((p = strchr (name, ' ')) != NULL)
+    *p = '\0';
+  if (type != RMAP_EVENT_CLIST_DELETED
+      || ! (route_map_rule_names (rmap_name, "community", name)
+	    || route_map_rule_names (rmap_name, "comm-list", name)))
+    route_map_upd8_dependency (type, name, rmap_name);
+  XFREE (MTYPE_ROUTE_MAP_RULE, name);
+}
+
 /* Add bgp route map rule. */
 static int
 bgp_route_match_add (struct vty *vty,
@@ -2527,7 +2602,9 @@ bgp_route_match_add (struct vty *vty,
 	}
     }
 
-  if (type != RMAP_EVENT_MATCH_ADDED)
+  if (type == RMAP_EVENT_CLIST_ADDED)
+    bgp_route_map_clist_dependency (type, arg, index->map->name);
+  else if (type != RMAP_EVENT_MATCH_ADDED)
     {
       route_map_upd8_dependency (type, arg, index->map->name);
     }
@@ -2581,7 +2658,9 @@ bgp_route_match_delete (struct vty *vty,
       return CMD_WARNING;
     }
 
-  if (type != RMAP_EVENT_MATCH_DELETED && dep_name)
+  if (type == RMAP_EVENT_CLIST_DELETED && dep_name)
+    bgp_route_map_clist_dependency (type, dep_name, rmap_name);
+  else if (type != RMAP_EVENT_MATCH_DELETED && dep_name)
     route_map_upd8_dependency(type, dep_name, rmap_name);
 
   if (dep_name)
@@ -2931,6 +3010,159 @@ bgp_route_map_event (route_map_event_t event, const char *rmap_name)
   route_map_notify_dependencies(rmap_name, RMAP_EVENT_MATCH_ADDED);
 }
 
+/* Result of applying a route-map to a set of attributes.  Only route-maps
+   whose rules look at nothing but the attributes are cached this way, so
+   the result holds for every prefix and peer with the same attributes. */
+struct bgp_rmap_cache
+{
+  /* Attributes given to the route-map, and what it made of them.  A
+     reference is held on all their parts. */
+  struct attr in;
+  struct attr out;
+  struct attr_extra in_extra;
+  struct attr_extra out_extra;
+
+  /* Direction the route-map was applied in, see PEER_RMAP_TYPE_*. */
+  u_char rmap_type;
+
+  route_map_result_t ret;
+};
+
+/* Past this, results are no longer added to a route-map's cache until it
+   is updated. */
+#define BGP_RMAP_CACHE_MAX 65536
+
+static unsigned int
+bgp_rmap_cache_key (void *p)
+{
+  struct bgp_rmap_cache *cache = p;
+
+  return jhash_1word (cache->rmap_type, attrhash_key_make (&cache->in));
+}
+
+static int
+bgp_rmap_cache_cmp (const void *p1, const void *p2)
+{
+  const struct bgp_rmap_cache *c1 = p1;
+  const struct bgp_rmap_cache *c2 = p2;
+
+  /* attrhash_cmp does not look at everything a route-map may. */
+  return c1->rmap_type == c2->rmap_type
+         && c1->in.nh_ifindex == c2->in.nh_ifindex
+         && attrhash_cmp (&c1->in, &c2->in)
+         && (! c1->in.extra
+             || c1->in.extra->mp_nexthop_prefer_global
+                == c2->in.extra->mp_nexthop_prefer_global);
+}
+
+static void
+bgp_rmap_cache_free (void *p)
+{
+  struct bgp_rmap_cache *cache = p;
+
+  bgp_attr_unintern_sub (&cache->in);
+  if (cache->ret != RMAP_DENYMATCH)
+    bgp_attr_unintern_sub (&cache->out);
+  XFREE (MTYPE_BGP_RMAP_CACHE, cache);
+}
+
+/* Whether all parts of ATTR are interned, so that they can be shared with
+   the cache without being taken away from their owner. */
+static int
+bgp_rmap_cache_interned (struct attr *attr)
+{
+  struct attr_extra *attre = attr->extra;
+
+  if ((attr->aspath && ! attr->aspath->refcnt)
+      || (attr->community && ! attr->community->refcnt))
+    return 0;
+  if (attre
+      && ((attre->ecommunity && ! attre->ecommunity->refcnt)
+          || (attre->cluster && ! attre->cluster->refcnt)
+          || (attre->transit && ! attre->transit->refcnt)
+          || (attre->encap_subtlvs && ! attre->encap_subtlvs->refcnt)))
+    return 0;
+#if ENABLE_BGP_VNC
+  if (attre && attre->vnc_subtlvs && ! attre->vnc_subtlvs->refcnt)
+    return 0;
+#endif
+  return 1;
+}
+
+/* Copy ATTR in the cache, in the space given for its extra part. */
+static void
+bgp_rmap_cache_save (struct attr *to, struct attr_extra *extra,
+                     struct attr *attr)
+{
+  *to = *attr;
+  if (attr->extra)
+    {
+      *extra = *attr->extra;
+      to->extra = extra;
+    }
+}
+
+/* Apply MAP to the attributes of INFO in the direction given by the
+   rmap_type of its peer, like route_map_apply() does.  If every rule of
+   the map only looks at attributes, the outcome is remembered in the map
+   for the next route with the same attributes, whatever its prefix. */
+route_map_result_t
+bgp_route_map_apply (struct route_map *map, struct prefix *p,
+                     struct bgp_info *info)
+{
+  struct bgp_rmap_cache key;
+  struct bgp_rmap_cache *cache;
+  struct attr *attr = info->attr;
+  struct attr_extra *extra;
+  unsigned long refcnt;
+
+  if (! map || ! route_map_cacheable (map)
+      || ! bgp_rmap_cache_interned (attr))
+    return route_map_apply (map, p, RMAP_BGP, info);
+
+  if (! map->cache)
+    map->cache = hash_create (bgp_rmap_cache_key, bgp_rmap_cache_cmp);
+
+  key.in = *attr;
+  key.rmap_type = info->peer->rmap_type;
+  cache = hash_lookup (map->cache, &key);
+  if (cache)
+    {
+      if (cache->ret != RMAP_DENYMATCH)
+        {
+          extra = attr->extra;
+          refcnt = attr->refcnt;
+          *attr = cache->out;
+          attr->extra = extra;
+          attr->refcnt = refcnt;
+          if (cache->out.extra)
+            *bgp_attr_extra_get (attr) = cache->out_extra;
+        }
+      return cache->ret;
+    }
+
+  if (map->cache->count >= BGP_RMAP_CACHE_MAX)
+    return route_map_apply (map, p, RMAP_BGP, info);
+
+  cache = XCALLOC (MTYPE_BGP_RMAP_CACHE, sizeof (struct bgp_rmap_cache));
+  bgp_rmap_cache_save (&cache->in, &cache->in_extra, attr);
+  bgp_attr_intern_sub (&cache->in);
+  cache->rmap_type = key.rmap_type;
+
+  cache->ret = route_map_apply (map, p, RMAP_BGP, info);
+
+  /* The parts the route-map made are only the caller's, and can be
+     interned in place. */
+  if (cache->ret != RMAP_DENYMATCH)
+    {
+      bgp_attr_intern_sub (attr);
+      bgp_rmap_cache_save (&cache->out, &cache->out_extra, attr);
+    }
+
+  hash_get (map->cache, cache, hash_alloc_intern);
+  return cache->ret;
+}
+
 
 DEFUN (match_peer,
        match_peer_cmd,
@@ -3569,17 +3801,35 @@ DEFUN (set_community_delete,
        "Community-list name\n"
        "Delete matching communities\n")
 {
+  VTY_DECLVAR_CONTEXT(route_map_index, index);
   int idx_comm_list = 2;
+  const char *arg;
+  char *old = NULL;
   char *str;
+  int ret;
+
+  /* The rule may replace one deleting with another list. */
+  if ((arg = route_map_get_set_arg (index, "comm-list")) != NULL)
+    old = XSTRDUP (MTYPE_ROUTE_MAP_RULE, arg);
 
   str = XCALLOC (MTYPE_TMP, strlen (argv[idx_comm_list]->arg) + strlen (" delete") + 1);
   strcpy (str, argv[idx_comm_list]->arg);
   strcpy (str + strlen (argv[idx_comm_list]->arg), " delete");
 
-  generic_set_add (vty, VTY_GET_CONTEXT(route_map_index), "comm-list", str);
+  ret = generic_set_add (vty, index, "comm-list", str);
+  if (ret == CMD_SUCCESS)
+    {
+      if (old)
+	bgp_route_map_clist_dependency (RMAP_EVENT_CLIST_DELETED, old,
+					index->map->name);
+      route_map_upd8_dependency (RMAP_EVENT_CLIST_ADDED,
+				 argv[idx_comm_list]->arg, index->map->name);
+    }
 
+  if (old)
+    XFREE (MTYPE_ROUTE_MAP_RULE, old);
   XFREE (MTYPE_TMP, str);
-  return CMD_SUCCESS;
+  return ret;
 }
 
 DEFUN (no_set_community_delete,
@@ -3593,8 +3843,22 @@ DEFUN (no_set_community_delete,
        "Community-list name\n"
        "Delete matching communities\n")
 {
-  return generic_set_delete (vty, VTY_GET_CONTEXT(route_map_index),
-                             "comm-list", NULL);
+  VTY_DECLVAR_CONTEXT(route_map_index, index);
+  const char *arg;
+  char *dep_name = NULL;
+  int ret;
+
+  if ((arg = route_map_get_set_arg (index, "comm-list")) != NULL)
+    dep_name = XSTRDUP (MTYPE_ROUTE_MAP_RULE, arg);
+
+  ret = generic_set_delete (vty, index, "comm-list", NULL);
+  if (ret == CMD_SUCCESS && dep_name)
+    bgp_route_map_clist_dependency (RMAP_EVENT_CLIST_DELETED, dep_name,
+				    index->map->name);
+
+  if (dep_name)
+    XFREE (MTYPE_ROUTE_MAP_RULE, dep_name);
+  return ret;
 }
 
 
@@ -4089,6 +4353,7 @@ bgp_route_map_init (void)
   route_map_add_hook (bgp_route_map_add);
   route_map_delete_hook (bgp_route_map_delete);
   route_map_event_hook (bgp_route_map_event);
+  route_map_cache_hook (bgp_rmap_cache_free);
 
   route_map_match_interface_hook (generic_match_add);
   route_map_no_match_interface_hook (generic_match_delete);
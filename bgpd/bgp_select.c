@@ -0,0 +1,225 @@
+/* BGP best path selection workers
+ *
+ * This file is part of GNU Zebra.
+ *
+ * GNU Zebra is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * GNU Zebra is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Zebra; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+/*
+ * A pool of pthreads that bgp_process_main() hands the best path
+ * computation of a batch of nodes to.  bgp_select_run() calls a function
+ * on every item of an array, spread over the workers and the main thread,
+ * and returns when all of them are done.  The main thread does nothing
+ * else meanwhile, so the function may read anything the main thread owns,
+ * but must write to nothing shared between items, and must not allocate:
+ * memory statistics are not kept per thread.
+ *
+ * Items are taken CHUNK at a time under the mutex, which protects all of
+ * the state below.
+ */
+
+#include <zebra.h>
+#include <pthread.h>
+
+#include "log.h"
+#include "memory.h"
+
+#include "bgpd/bgp_memory.h"
+#include "bgpd/bgp_select.h"
+
+#define CHUNK 32
+
+static struct
+{
+  int configured;
+  int started;
+  int workers;
+  pthread_t *threads;
+
+  pthread_mutex_t mutex;
+  pthread_cond_t work_cond;
+  pthread_cond_t done_cond;
+  int stopping;
+
+  /* Current run. */
+  unsigned long generation;
+  void **items;
+  unsigned int count;
+  unsigned int next;
+  unsigned int busy;
+  void (*func) (void *);
+} pool =
+{
+  .mutex = PTHREAD_MUTEX_INITIALIZER,
+  .work_cond = PTHREAD_COND_INITIALIZER,
+  .done_cond = PTHREAD_COND_INITIALIZER,
+};
+
+/* Work on the current run until all its items are taken.  Called and
+   returns with the mutex held. */
+static void
+select_work (void)
+{
+  void **items = pool.items;
+  void (*func) (void *) = pool.func;
+  unsigned int i, end;
+
+  while (pool.next < pool.count)
+    {
+      i = pool.next;
+      end = MIN (i + CHUNK, pool.count);
+      pool.next = end;
+
+      pthread_mutex_unlock (&pool.mutex);
+      for (; i < end; i++)
+        func (items[i]);
+      pthread_mutex_lock (&pool.mutex);
+    }
+}
+
+static void *
+select_thread (void *arg)
+{
+  unsigned long seen = 0;
+
+  pthread_mutex_lock (&pool.mutex);
+  for (;;)
+    {
+      while (!pool.stopping && pool.generation == seen)
+        pthread_cond_wait (&pool.work_cond, &pool.mutex);
+      if (pool.stopping)
+        break;
+      seen = pool.generation;
+
+      pool.busy++;
+      select_work ();
+      if (--pool.busy == 0)
+        pthread_cond_signal (&pool.done_cond);
+    }
+  pthread_mutex_unlock (&pool.mutex);
+
+  return NULL;
+}
+
+static void
+select_stop (void)
+{
+  int i;
+
+  pthread_mutex_lock (&pool.mutex);
+  pool.stopping = 1;
+  pthread_cond_broadcast (&pool.work_cond);
+  pthread_mutex_unlock (&pool.mutex);
+
+  for (i = 0; i < pool.workers; i++)
+    pthread_join (pool.threads[i], NULL);
+
+  XFREE (MTYPE_BGP_SELECT, pool.threads);
+  pool.workers = 0;
+  pool.stopping = 0;
+}
+
+/* Run the configured number of workers.  Returns -1 if they could not
+   all be started, with as many as could running. */
+static int
+select_apply (void)
+{
+  int workers = pool.configured;
+  int i, ret;
+
+  if (workers == pool.workers)
+    return 0;
+
+  if (pool.workers)
+    select_stop ();
+  if (!workers)
+    return 0;
+
+  pool.threads = XCALLOC (MTYPE_BGP_SELECT, workers * sizeof (pthread_t));
+  for (i = 0; i < workers; i++)
+    {
+      ret = pthread_create (&pool.threads[i], NULL, select_thread, NULL);
+      if (ret)
+        {
+          zlog_err ("%s: pthread_create: %s", __func__, safe_strerror (ret));
+          break;
+        }
+      pool.workers++;
+    }
+
+  if (!pool.workers)
+    XFREE (MTYPE_BGP_SELECT, pool.threads);
+
+  return (pool.workers == workers) ? 0 : -1;
+}
+
+/* Use this many workers, 0 for none.  They are started only once
+   bgp_select_start() has been called, since the configuration is read
+   before the daemon forks into the background. */
+int
+bgp_select_workers_set (int workers)
+{
+  pool.configured = workers;
+  if (!pool.started)
+    return 0;
+  return select_apply ();
+}
+
+/* Start the configured workers, from now on. */
+void
+bgp_select_start (void)
+{
+  pool.started = 1;
+  if (select_apply () < 0)
+    zlog_warn ("Only %d of %d best path workers could be started",
+               pool.workers, pool.configured);
+}
+
+int
+bgp_select_workers (void)
+{
+  return pool.configured;
+}
+
+/* Call func on each of the items, on the workers and this thread. */
+void
+bgp_select_run (void **items, unsigned int count, void (*func) (void *))
+{
+  unsigned int i;
+
+  if (!pool.workers || count <= CHUNK)
+    {
+      for (i = 0; i < count; i++)
+        func (items[i]);
+      return;
+    }
+
+  pthread_mutex_lock (&pool.mutex);
+  pool.items = items;
+  pool.count = count;
+  pool.next = 0;
+  pool.func = func;
+  pool.generation++;
+  pthread_cond_broadcast (&pool.work_cond);
+
+  select_work ();
+  while (pool.busy)
+    pthread_cond_wait (&pool.done_cond, &pool.mutex);
+
+  pool.items = NULL;
+  pool.count = pool.next = 0;
+  pthread_mutex_unlock (&pool.mutex);
+}
@@ -52,14 +52,13 @@ struct bgp_node
 
   struct bgp_adj_out *adj_out;
 
-  struct bgp_adj_in *adj_in;
-
   struct bgp_node *prn;
 
   uint64_t version;
   u_char flags;
 #define BGP_NODE_PROCESS_SCHEDULED	(1 << 0)
 #define BGP_NODE_USER_CLEAR             (1 << 1)
+#define BGP_NODE_SELECT_COMPUTED        (1 << 2)
 };
 
 /*
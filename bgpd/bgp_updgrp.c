@@ -103,6 +103,7 @@ sync_init (struct update_subgroup *subgrp)
    */
   subgrp->work = stream_new (BGP_MAX_PACKET_SIZE + BGP_MAX_PACKET_SIZE_OVERFLOW);
   subgrp->scratch = stream_new (BGP_MAX_PACKET_SIZE);
+  subgroup_attr_cache_init (subgrp);
 }
 
 static void
@@ -120,6 +121,7 @@ sync_delete (struct update_subgroup *subgrp)
   if (subgrp->scratch)
     stream_free (subgrp->scratch);
   subgrp->scratch = NULL;
+  subgroup_attr_cache_free (subgrp);
 }
 
 /**
@@ -621,6 +623,10 @@ update_group_show_walkcb (struct update_group *updgrp, void *arg)
 	     bpacket_queue_hwm_length (SUBGRP_PKTQ (subgrp)), VTY_NEWLINE);
     vty_out (vty, "    Adj-out list count: %u%s",
 	     subgrp->adj_count, VTY_NEWLINE);
+    vty_out (vty, "    Attribute cache: %lu entries, %u hits, %u misses%s",
+	     subgrp->attr_cache ? subgrp->attr_cache->count : 0,
+	     subgrp->attr_cache_hits, subgrp->attr_cache_misses,
+	     VTY_NEWLINE);
     vty_out (vty, "    Advertise list: %s%s",
 	     advertise_list_is_empty (subgrp) ? "empty" : "not empty",
 	     VTY_NEWLINE);
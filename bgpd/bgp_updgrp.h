@@ -87,6 +87,40 @@ typedef struct bpacket_attr_vec_arr
   bpacket_attr_vec entries[BGP_ATTR_VEC_MAX];
 } bpacket_attr_vec_arr;
 
+/*
+ * The attributes of an UPDATE as encoded for a subgroup, so that the
+ * next UPDATE with the same attributes can copy them instead of
+ * encoding them again.  The nexthop is left as the attribute has it,
+ * and is patched for each peer through the vectors, as usual.
+ */
+struct bpacket_attr_cache
+{
+  /* Key: the interned attribute, which we hold a reference to, and
+   * what the encoding takes from the peer the route was learnt from. */
+  struct attr *attr;
+  struct in_addr from_id;
+  u_char from_ibgp;
+  u_char from_enhe;
+
+  TAILQ_ENTRY (bpacket_attr_cache) lru;
+
+  /* All the attributes but MP_REACH_NLRI, and the vectors into them. */
+  u_char *data;
+  bgp_size_t len;
+  bpacket_attr_vec_arr vecarr;
+
+  /* MP_REACH_NLRI up to the NLRI, once it has been needed, and the
+   * vectors after it was written. */
+  u_char *mp_data;
+  size_t mp_len;
+  size_t mp_attrlen_pos;
+  bpacket_attr_vec_arr mp_vecarr;
+};
+
+/* Encoded attribute sets kept per subgroup, 0 disables the cache. */
+#define BPACKET_ATTR_CACHE_SIZE 64
+extern unsigned int bpacket_attr_cache_size;
+
 struct bpacket
 {
   /* for being part of an update subgroup's message list */
@@ -203,6 +237,12 @@ struct update_subgroup
    */
   struct stream *scratch;
 
+  /* encoded attributes, least recently used first */
+  struct hash *attr_cache;
+  TAILQ_HEAD (attr_cache_lru, bpacket_attr_cache) attr_cache_lru;
+  u_int32_t attr_cache_hits;
+  u_int32_t attr_cache_misses;
+
   /* synchronization list and time */
   struct bgp_synchronize *sync;
 
@@ -430,6 +470,9 @@ extern void
 subgroup_default_update_packet (struct update_subgroup *subgrp,
 				struct attr *attr, struct peer *from);
 extern void subgroup_default_withdraw_packet (struct update_subgroup *subgrp);
+extern void subgroup_attr_cache_init (struct update_subgroup *subgrp);
+extern void subgroup_attr_cache_flush (struct update_subgroup *subgrp);
+extern void subgroup_attr_cache_free (struct update_subgroup *subgrp);
 
 /* bgp_updgrp_adv.c */
 extern struct bgp_advertise *bgp_advertise_clean_subgroup (struct
@@ -809,6 +809,9 @@ subgroup_announce_all (struct update_subgroup *subgrp)
   if (!subgrp)
     return;
 
+  /* Whatever calls for this may also change how attributes encode. */
+  subgroup_attr_cache_flush (subgrp);
+
   /*
    * If coalesce timer value is not set, announce routes immediately.
    */
@@ -42,6 +42,7 @@
 #include "linklist.h"
 #include "workqueue.h"
 #include "hash.h"
+#include "jhash.h"
 #include "queue.h"
 
 #include "bgpd/bgpd.h"
@@ -621,11 +622,194 @@ bgp_info_addpath_tx_str (int addpath_encode, u_int32_t addpath_tx_id,
     sprintf(buf, " with addpath ID %d", addpath_tx_id);
 }
 
+/*
+ * Encoded attribute cache.
+ *
+ * Within a subgroup, bgp_packet_attribute() gives the same bytes for the
+ * same interned attribute, but for what it takes from the peer the route
+ * was learnt from, which goes in the key.  The instance settings it looks
+ * at either reset the sessions when changed, or announce again through
+ * subgroup_announce_all(), which flushes the cache.
+ */
+unsigned int bpacket_attr_cache_size = BPACKET_ATTR_CACHE_SIZE;
+
+static unsigned int
+bpacket_attr_cache_hash_key (void *p)
+{
+  struct bpacket_attr_cache *ace = p;
+
+  return jhash_3words ((uintptr_t) ace->attr, ace->from_id.s_addr,
+		       (ace->from_ibgp << 1) | ace->from_enhe, 0);
+}
+
+static int
+bpacket_attr_cache_hash_cmp (const void *p1, const void *p2)
+{
+  const struct bpacket_attr_cache *ace1 = p1;
+  const struct bpacket_attr_cache *ace2 = p2;
+
+  return (ace1->attr == ace2->attr
+	  && ace1->from_id.s_addr == ace2->from_id.s_addr
+	  && ace1->from_ibgp == ace2->from_ibgp
+	  && ace1->from_enhe == ace2->from_enhe);
+}
+
+/* Fill in the key, leaving out what does not change the encoding. */
+static void
+bpacket_attr_cache_key (struct bpacket_attr_cache *key,
+			struct update_subgroup *subgrp, struct attr *attr,
+			struct peer *from)
+{
+  struct peer *peer = SUBGRP_PEER (subgrp);
+
+  key->attr = attr;
+  key->from_id.s_addr = 0;
+  key->from_ibgp = 0;
+  key->from_enhe = 0;
+  if (!from)
+    return;
+
+  /* ORIGINATOR_ID, when reflecting */
+  if (peer->sort == BGP_PEER_IBGP && from->sort == BGP_PEER_IBGP)
+    {
+      key->from_ibgp = 1;
+      if (!(attr->flag & ATTR_FLAG_BIT (BGP_ATTR_ORIGINATOR_ID)))
+	key->from_id = from->remote_id;
+    }
+
+  /* NEXT_HOP for an IPv4 route learnt with an IPv6 nexthop */
+  if (!(attr->flag & ATTR_FLAG_BIT (BGP_ATTR_NEXT_HOP)))
+    key->from_enhe = peer_cap_enhe (from) ? 1 : 0;
+}
+
+static void
+bpacket_attr_cache_free (void *p)
+{
+  struct bpacket_attr_cache *ace = p;
+
+  bgp_attr_unintern (&ace->attr);
+  if (ace->mp_data)
+    XFREE (MTYPE_BGP_ATTR_CACHE, ace->mp_data);
+  XFREE (MTYPE_BGP_ATTR_CACHE, ace->data);
+  XFREE (MTYPE_BGP_ATTR_CACHE, ace);
+}
+
+/* Look up the encoding of attr, and make it the most recently used. */
+static struct bpacket_attr_cache *
+bpacket_attr_cache_lookup (struct update_subgroup *subgrp, struct attr *attr,
+			   struct peer *from)
+{
+  struct bpacket_attr_cache key;
+  struct bpacket_attr_cache *ace;
+
+  if (!bpacket_attr_cache_size || !subgrp->attr_cache)
+    return NULL;
+
+  bpacket_attr_cache_key (&key, subgrp, attr, from);
+  ace = hash_lookup (subgrp->attr_cache, &key);
+  if (!ace)
+    {
+      subgrp->attr_cache_misses++;
+      return NULL;
+    }
+
+  subgrp->attr_cache_hits++;
+  TAILQ_REMOVE (&subgrp->attr_cache_lru, ace, lru);
+  TAILQ_INSERT_TAIL (&subgrp->attr_cache_lru, ace, lru);
+  return ace;
+}
+
+/*
+ * Remember the len bytes of attributes just encoded at pos in s, with
+ * the vectors into them.  Returns the new entry, or NULL if there is no
+ * cache.
+ */
+static struct bpacket_attr_cache *
+bpacket_attr_cache_add (struct update_subgroup *subgrp, struct attr *attr,
+			struct peer *from, struct stream *s, size_t pos,
+			bgp_size_t len, struct bpacket_attr_vec_arr *vecarr)
+{
+  struct bpacket_attr_cache *ace;
+
+  if (!bpacket_attr_cache_size || !subgrp->attr_cache)
+    return NULL;
+
+  /* Make room by taking over the least recently used. */
+  if (subgrp->attr_cache->count >= bpacket_attr_cache_size)
+    {
+      ace = TAILQ_FIRST (&subgrp->attr_cache_lru);
+      TAILQ_REMOVE (&subgrp->attr_cache_lru, ace, lru);
+      hash_release (subgrp->attr_cache, ace);
+      bgp_attr_unintern (&ace->attr);
+      if (ace->mp_data)
+	XFREE (MTYPE_BGP_ATTR_CACHE, ace->mp_data);
+      ace->data = XREALLOC (MTYPE_BGP_ATTR_CACHE, ace->data, len);
+    }
+  else
+    {
+      ace = XCALLOC (MTYPE_BGP_ATTR_CACHE, sizeof (struct bpacket_attr_cache));
+      ace->data = XMALLOC (MTYPE_BGP_ATTR_CACHE, len);
+    }
+
+  bpacket_attr_cache_key (ace, subgrp, attr, from);
+  ace->attr = bgp_attr_intern (attr);
+  memcpy (ace->data, STREAM_DATA (s) + pos, len);
+  ace->len = len;
+  ace->vecarr = *vecarr;
+
+  hash_get (subgrp->attr_cache, ace, hash_alloc_intern);
+  TAILQ_INSERT_TAIL (&subgrp->attr_cache_lru, ace, lru);
+  return ace;
+}
+
+/* Remember the start of MP_REACH_NLRI, which is all there is in s. */
+static void
+bpacket_attr_cache_set_mp (struct bpacket_attr_cache *ace, struct stream *s,
+			   size_t attrlen_pos,
+			   struct bpacket_attr_vec_arr *vecarr)
+{
+  ace->mp_len = stream_get_endp (s);
+  ace->mp_data = XMALLOC (MTYPE_BGP_ATTR_CACHE, ace->mp_len);
+  memcpy (ace->mp_data, STREAM_DATA (s), ace->mp_len);
+  ace->mp_attrlen_pos = attrlen_pos;
+  ace->mp_vecarr = *vecarr;
+}
+
+void
+subgroup_attr_cache_init (struct update_subgroup *subgrp)
+{
+  subgrp->attr_cache = hash_create (bpacket_attr_cache_hash_key,
+				    bpacket_attr_cache_hash_cmp);
+  TAILQ_INIT (&subgrp->attr_cache_lru);
+}
+
+void
+subgroup_attr_cache_flush (struct update_subgroup *subgrp)
+{
+  if (!subgrp->attr_cache)
+    return;
+
+  hash_clean (subgrp->attr_cache, bpacket_attr_cache_free);
+  TAILQ_INIT (&subgrp->attr_cache_lru);
+}
+
+void
+subgroup_attr_cache_free (struct update_subgroup *subgrp)
+{
+  if (!subgrp->attr_cache)
+    return;
+
+  subgroup_attr_cache_flush (subgrp);
+  hash_free (subgrp->attr_cache);
+  subgrp->attr_cache = NULL;
+}
+
 /* Make BGP update packet.  */
 struct bpacket *
 subgroup_update_packet (struct update_subgroup *subgrp)
 {
   struct bpacket_attr_vec_arr vecarr;
+  struct bpacket_attr_cache *ace = NULL;
   struct bpacket *pkt;
   struct peer *peer;
   struct stream *s;
@@ -712,11 +896,25 @@ subgroup_update_packet (struct update_subgroup *subgrp)
 	   */
 	  mpattr_pos = stream_get_endp (s);
 
-	  /* 5: Encode all the attributes, except MP_REACH_NLRI attr. */
-	  total_attr_len = bgp_packet_attribute (NULL, peer, s,
-						 adv->baa->attr, &vecarr,
-						 NULL, afi, safi,
-						 from, NULL, NULL, 0, 0);
+	  /* 5: Encode all the attributes, except MP_REACH_NLRI attr, unless
+	   * they were for an earlier UPDATE. */
+	  ace = bpacket_attr_cache_lookup (subgrp, adv->baa->attr, from);
+	  if (ace)
+	    {
+	      stream_put (s, ace->data, ace->len);
+	      total_attr_len = ace->len;
+	      vecarr = ace->vecarr;
+	    }
+	  else
+	    {
+	      total_attr_len = bgp_packet_attribute (NULL, peer, s,
+						     adv->baa->attr, &vecarr,
+						     NULL, afi, safi,
+						     from, NULL, NULL, 0, 0);
+	      ace = bpacket_attr_cache_add (subgrp, adv->baa->attr, from,
+					    s, mpattr_pos, total_attr_len,
+					    &vecarr);
+	    }
 
           space_remaining = STREAM_CONCAT_REMAIN (s, snlri, STREAM_SIZE(s)) -
                             BGP_MAX_PACKET_SIZE_OVERFLOW;
@@ -759,11 +957,21 @@ subgroup_update_packet (struct update_subgroup *subgrp)
 	  if (binfo && binfo->extra)
 	    tag = binfo->extra->tag;
 
-	  if (stream_empty (snlri))
-	    mpattrlen_pos = bgp_packet_mpattr_start (snlri, afi, safi,
+	  if (stream_empty (snlri) && ace && ace->mp_data)
+	    {
+	      stream_put (snlri, ace->mp_data, ace->mp_len);
+	      mpattrlen_pos = ace->mp_attrlen_pos;
+	      vecarr = ace->mp_vecarr;
+	    }
+	  else if (stream_empty (snlri))
+	    {
+	      mpattrlen_pos = bgp_packet_mpattr_start (snlri, afi, safi,
                                          (peer_cap_enhe(peer) ? AFI_IP6 :
                                           AFI_MAX), /* get from NH */
 				          &vecarr, adv->baa->attr);
+	      if (ace)
+		bpacket_attr_cache_set_mp (ace, snlri, mpattrlen_pos, &vecarr);
+	    }
           bgp_packet_mpattr_prefix (snlri, afi, safi, &rn->p, prd, tag,
                                     addpath_encode, addpath_tx_id);
 	}
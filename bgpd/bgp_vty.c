@@ -56,6 +56,8 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "bgpd/bgp_packet.h"
 #include "bgpd/bgp_updgrp.h"
 #include "bgpd/bgp_bfd.h"
+#include "bgpd/bgp_select.h"
+#include "bgpd/bgp_io.h"
 
 static struct peer_group *
 listen_range_exists (struct bgp *bgp, struct prefix *range, int exact);
@@ -4697,6 +4699,40 @@ DEFUN (no_bgp_set_route_map_delay_timer,
   return CMD_SUCCESS;
 }
 
+/* Threads that compute best paths in parallel */
+DEFUN (bgp_bestpath_workers,
+       bgp_bestpath_workers_cmd,
+       "bgp bestpath-workers (1-64)",
+       BGP_STR
+       "Compute best paths on worker threads\n"
+       "Number of worker threads\n")
+{
+  int idx_number = 2;
+  int workers;
+
+  VTY_GET_INTEGER_RANGE ("workers", workers, argv[idx_number]->arg,
+                         1, BGP_SELECT_WORKERS_MAX);
+  if (bgp_select_workers_set (workers) < 0)
+    {
+      vty_out (vty, "%% Could not start all worker threads%s",
+               VTY_NEWLINE);
+      return CMD_WARNING;
+    }
+  return CMD_SUCCESS;
+}
+
+DEFUN (no_bgp_bestpath_workers,
+       no_bgp_bestpath_workers_cmd,
+       "no bgp bestpath-workers [(1-64)]",
+       NO_STR
+       BGP_STR
+       "Compute best paths on worker threads\n"
+       "Number of worker threads\n")
+{
+  bgp_select_workers_set (0);
+  return CMD_SUCCESS;
+}
+
 
 /* neighbor interface */
 static int
@@ -6052,6 +6088,30 @@ DEFUN (show_bgp_vrfs,
   return CMD_SUCCESS;
 }
 
+/* The routes kept for soft reconfiguration, and the slots they take. */
+static unsigned long
+bgp_adj_in_count (unsigned long *slots)
+{
+  struct listnode *node, *pnode;
+  struct bgp *bgp;
+  struct peer *peer;
+  afi_t afi;
+  safi_t safi;
+  unsigned long count = 0;
+
+  *slots = 0;
+  for (ALL_LIST_ELEMENTS_RO (bm->bgp, node, bgp))
+    for (ALL_LIST_ELEMENTS_RO (bgp->peer, pnode, peer))
+      for (afi = AFI_IP; afi < AFI_MAX; afi++)
+        for (safi = SAFI_UNICAST; safi < SAFI_MAX; safi++)
+          if (peer->adj_in[afi][safi])
+            {
+              count += peer->adj_in[afi][safi]->count;
+              *slots += peer->adj_in[afi][safi]->size;
+            }
+  return count;
+}
+
 DEFUN (show_bgp_memory,
        show_bgp_memory_cmd,
        "show [ip] bgp memory",
@@ -6061,7 +6121,7 @@ DEFUN (show_bgp_memory,
        "Global BGP memory statistics\n")
 {
   char memstrbuf[MTYPE_MEMSTR_LEN];
-  unsigned long count;
+  unsigned long count, slots;
 
   /* RIB related usage stats */
   count = mtype_stats_alloc (MTYPE_BGP_NODE);
@@ -6094,10 +6154,10 @@ DEFUN (show_bgp_memory,
              VTY_NEWLINE);
 
   /* Adj-In/Out */
-  if ((count = mtype_stats_alloc (MTYPE_BGP_ADJ_IN)))
+  if ((count = bgp_adj_in_count (&slots)))
     vty_out (vty, "%ld Adj-In entries, using %s of memory%s", count,
              mtype_memstr (memstrbuf, sizeof (memstrbuf),
-                           count * sizeof (struct bgp_adj_in)),
+                           slots * sizeof (struct bgp_adj_in)),
              VTY_NEWLINE);
   if ((count = mtype_stats_alloc (MTYPE_BGP_ADJ_OUT)))
     vty_out (vty, "%ld Adj-Out entries, using %s of memory%s", count,
@@ -6440,7 +6500,8 @@ bgp_show_summary (struct vty *vty, struct bgp *bgp, int afi, int safi,
                                   + peer->dynamic_cap_out);
 
               json_object_int_add(json_peer, "tableVersion", peer->version[afi][safi]);
-              json_object_int_add(json_peer, "outq", peer->obuf->count);
+              json_object_int_add(json_peer, "outq",
+                                  peer->obuf->count + bgp_io_outq (peer));
               json_object_int_add(json_peer, "inq", 0);
               peer_uptime (peer->uptime, timebuf, BGP_UPTIME_LEN, use_json, json_peer);
               json_object_int_add(json_peer, "prefixReceivedCount", peer->pcount[afi][safi]);
@@ -6490,7 +6551,7 @@ bgp_show_summary (struct vty *vty, struct bgp *bgp, int afi, int safi,
                        + peer->dynamic_cap_out,
                        peer->version[afi][safi],
                        0,
-                       peer->obuf->count,
+                       peer->obuf->count + bgp_io_outq (peer),
                        peer_uptime (peer->uptime, timebuf, BGP_UPTIME_LEN, 0, NULL));
 
               if (peer->status == Established)
@@ -8044,7 +8105,7 @@ bgp_show_peer (struct vty *vty, struct peer *p, u_char use_json, json_object *js
       json_stat = json_object_new_object();
       /* Packet counts. */
       json_object_int_add(json_stat, "depthInq", 0);
-      json_object_int_add(json_stat, "depthOutq", (unsigned long) p->obuf->count);
+      json_object_int_add(json_stat, "depthOutq", (unsigned long) p->obuf->count + bgp_io_outq (p));
       json_object_int_add(json_stat, "opensSent",  p->open_out);
       json_object_int_add(json_stat, "opensRecv", p->open_in);
       json_object_int_add(json_stat, "notificationsSent", p->notify_out);
@@ -8066,7 +8127,7 @@ bgp_show_peer (struct vty *vty, struct peer *p, u_char use_json, json_object *js
       /* Packet counts. */
       vty_out (vty, "  Message statistics:%s", VTY_NEWLINE);
       vty_out (vty, "    Inq depth is 0%s", VTY_NEWLINE);
-      vty_out (vty, "    Outq depth is %lu%s", (unsigned long) p->obuf->count, VTY_NEWLINE);
+      vty_out (vty, "    Outq depth is %lu%s", (unsigned long) p->obuf->count + bgp_io_outq (p), VTY_NEWLINE);
       vty_out (vty, "                         Sent       Rcvd%s", VTY_NEWLINE);
       vty_out (vty, "    Opens:         %10d %10d%s", p->open_out, p->open_in, VTY_NEWLINE);
       vty_out (vty, "    Notifications: %10d %10d%s", p->notify_out, p->notify_in, VTY_NEWLINE);
@@ -8346,7 +8407,7 @@ bgp_show_peer (struct vty *vty, struct peer *p, u_char use_json, json_object *js
           json_object_int_add(json_neigh, "mraiTimerExpireInMsecs", thread_timer_remain_second (p->t_routeadv) * 1000);
         }
 
-      if (p->t_read)
+      if (p->t_read || p->io)
         json_object_string_add(json_neigh, "readThread", "on");
       else
         json_object_string_add(json_neigh, "readThread", "off");
@@ -8377,6 +8438,8 @@ bgp_show_peer (struct vty *vty, struct peer *p, u_char use_json, json_object *js
                p->t_read ? "on" : "off",
                p->t_write ? "on" : "off",
                VTY_NEWLINE);
+      if (p->io)
+        vty_out (vty, "Socket I/O is done by the I/O thread%s", VTY_NEWLINE);
     }
 
   if (p->notify.code == BGP_NOTIFY_OPEN_ERR
@@ -9896,6 +9959,10 @@ bgp_vty_init (void)
   install_element (CONFIG_NODE, &bgp_set_route_map_delay_timer_cmd);
   install_element (CONFIG_NODE, &no_bgp_set_route_map_delay_timer_cmd);
 
+  /* "bgp bestpath-workers" commands. */
+  install_element (CONFIG_NODE, &bgp_bestpath_workers_cmd);
+  install_element (CONFIG_NODE, &no_bgp_bestpath_workers_cmd);
+
   /* Dummy commands (Currently not supported) */
   install_element (BGP_NODE, &no_synchronization_cmd);
   install_element (BGP_NODE, &no_auto_summary_cmd);
@@ -77,6 +77,9 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "bgpd/bgp_updgrp.h"
 #include "bgpd/bgp_bfd.h"
 #include "bgpd/bgp_memory.h"
+#include "bgpd/bgp_select.h"
+#include "bgpd/bgp_io.h"
+#include "bgpd/bgp_checkpoint.h"
 
 DEFINE_QOBJ_TYPE(bgp_master)
 DEFINE_QOBJ_TYPE(bgp)
@@ -1049,6 +1052,9 @@ peer_sort (struct peer *peer)
 static void
 peer_free (struct peer *peer)
 {
+  afi_t afi;
+  safi_t safi;
+
   assert (peer->status == Deleted);
 
   QOBJ_UNREG (peer);
@@ -1059,6 +1065,7 @@ peer_free (struct peer *peer)
   bgp_timer_set (peer);
   BGP_READ_OFF (peer->t_read);
   BGP_WRITE_OFF (peer->t_write);
+  bgp_io_detach (peer);
   BGP_EVENT_FLUSH (peer);
   
   /* Free connected nexthop, if present */
@@ -1116,6 +1123,11 @@ peer_free (struct peer *peer)
 
   bgp_sync_delete (peer);
 
+  /* The routes kept from the peer no longer hold a lock on it. */
+  for (afi = AFI_IP; afi < AFI_MAX; afi++)
+    for (safi = SAFI_UNICAST; safi < SAFI_MAX; safi++)
+      bgp_adj_in_clear (peer, afi, safi);
+
   if (peer->conf_if)
     {
       XFREE (MTYPE_PEER_CONF_IF, peer->conf_if);
@@ -2041,6 +2053,7 @@ peer_delete (struct peer *peer)
     }
       
   /* Buffers.  */
+  bgp_io_detach (peer);
   if (peer->ibuf)
     {
       stream_free (peer->ibuf);
@@ -3173,6 +3186,9 @@ bgp_delete (struct bgp *bgp)
 
   THREAD_OFF (bgp->t_startup);
 
+  /* A routes dump may be part way through the tables. */
+  bgp_dump_instance_delete (bgp);
+
   if (BGP_DEBUG (zebra, ZEBRA))
     {
       if (bgp->inst_type == BGP_INSTANCE_TYPE_DEFAULT)
@@ -7270,6 +7286,10 @@ bgp_config_write (struct vty *vty)
     vty_out (vty, "bgp route-map delay-timer %d%s", bm->rmap_update_timer,
              VTY_NEWLINE);
 
+  if (bgp_select_workers ())
+    vty_out (vty, "bgp bestpath-workers %d%s", bgp_select_workers (),
+             VTY_NEWLINE);
+
   /* BGP configuration. */
   for (ALL_LIST_ELEMENTS (bm->bgp, mnode, mnnode, bgp))
     {
@@ -7587,6 +7607,7 @@ bgp_init (void)
   bgp_attr_init ();
   bgp_debug_init ();
   bgp_dump_init ();
+  bgp_checkpoint_init ();
   bgp_route_init ();
   bgp_route_map_init ();
   bgp_scan_vty_init();
@@ -7657,6 +7678,8 @@ bgp_terminate (void)
       bm->process_main_queue = NULL;
     }
 
+  bgp_select_workers_set (0);
+
   if (bm->t_rmap_update)
     BGP_TIMER_OFF(bm->t_rmap_update);
 }
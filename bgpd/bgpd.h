@@ -39,6 +39,7 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 
 struct update_subgroup;
 struct bpacket;
+struct bgp_io;
 
 /*
  * Allow the neighbor XXXX remote-as to take internal or external
@@ -560,6 +561,9 @@ struct peer
   struct stream_fifo *obuf;
   struct stream *work;
 
+  /* Connection with the I/O thread, if it does the socket I/O. */
+  struct bgp_io *io;
+
   /* We use a separate stream to encode MP_REACH_NLRI for efficient
    * NLRI packing. peer->work stores all the other attributes. The
    * actual packet is then constructed by concatenating the two.
@@ -725,6 +729,7 @@ struct peer
 #define PEER_STATUS_GROUP             (1 << 4) /* peer-group conf */
 #define PEER_STATUS_NSF_MODE          (1 << 5) /* NSF aware peer */
 #define PEER_STATUS_NSF_WAIT          (1 << 6) /* wait comeback peer */
+#define PEER_STATUS_CHECKPOINT        (1 << 7) /* stale routes from checkpoint */
 
   /* Peer status af flags (reset in bgp_stop) */
   u_int16_t af_sflags[AFI_MAX][SAFI_MAX];
@@ -825,6 +830,11 @@ struct peer
   /* Prefix count. */
   unsigned long pcount[AFI_MAX][SAFI_MAX];
 
+  /* Paths in the RIB from this peer, and the routes kept as received
+     from it, so they can be found without walking the tables. */
+  struct bgp_info *paths[AFI_MAX][SAFI_MAX];
+  struct bgp_adj_in_table *adj_in[AFI_MAX][SAFI_MAX];
+
   /* Max prefix count. */
   unsigned long pmax[AFI_MAX][SAFI_MAX];
   u_char pmax_threshold[AFI_MAX][SAFI_MAX];
@@ -1350,6 +1360,9 @@ extern int peer_ttl_security_hops_set (struct peer *, int);
 extern int peer_ttl_security_hops_unset (struct peer *);
 
 extern int bgp_route_map_update_timer (struct thread *thread);
+extern route_map_result_t bgp_route_map_apply (struct route_map *,
+                                               struct prefix *,
+                                               struct bgp_info *);
 extern void bgp_route_map_terminate(void);
 
 extern int peer_cmp (struct peer *p1, struct peer *p2);
@@ -219,6 +219,9 @@ isis_adj_state_change (struct isis_adjacency *adj, enum isis_adj_state new_state
         if (new_state == ISIS_ADJ_UP)
         {
           circuit->upadjcount[level - 1]++;
+          /* Send what was flagged while there was no adj to send it to. */
+          if (circuit->upadjcount[level - 1] == 1)
+            lsp_flood_circuit (circuit, level);
           isis_event_adjacency_state_change (adj, new_state);
           /* update counter & timers for debugging purposes */
           adj->last_flap = time (NULL);
@@ -231,8 +234,7 @@ isis_adj_state_change (struct isis_adjacency *adj, enum isis_adj_state new_state
           if (circuit->upadjcount[level - 1] == 0)
             {
               /* Clean lsp_queue when no adj is up. */
-              if (circuit->lsp_queue)
-                list_delete_all_node (circuit->lsp_queue);
+              isis_circuit_lsp_queue_clear (circuit, level);
             }
           isis_event_adjacency_state_change (adj, new_state);
           isis_delete_adj (adj);
@@ -259,6 +261,9 @@ isis_adj_state_change (struct isis_adjacency *adj, enum isis_adj_state new_state
         if (new_state == ISIS_ADJ_UP)
         {
           circuit->upadjcount[level - 1]++;
+          /* Send what was flagged while there was no adj to send it to. */
+          if (circuit->upadjcount[level - 1] == 1)
+            lsp_flood_circuit (circuit, level);
           isis_event_adjacency_state_change (adj, new_state);
 
           if (adj->sys_type == ISIS_SYSTYPE_UNKNOWN)
@@ -280,8 +285,7 @@ isis_adj_state_change (struct isis_adjacency *adj, enum isis_adj_state new_state
           if (circuit->upadjcount[level - 1] == 0)
             {
               /* Clean lsp_queue when no adj is up. */
-              if (circuit->lsp_queue)
-                list_delete_all_node (circuit->lsp_queue);
+              isis_circuit_lsp_queue_clear (circuit, level);
             }
           isis_event_adjacency_state_change (adj, new_state);
           isis_delete_adj (adj);
@@ -722,11 +722,39 @@ isis_circuit_up (struct isis_circuit *circuit)
   isis_circuit_prepare (circuit);
 
   circuit->lsp_queue = list_new ();
-  circuit->lsp_queue_last_cleared = time (NULL);
+  circuit->lsp_retransmit = list_new ();
 
   return ISIS_OK;
 }
 
+/*
+ * Drops the LSPs of the given levels from the transmit and retransmit
+ * queues of a circuit, when it has no adjacency left to send them to.
+ */
+void
+isis_circuit_lsp_queue_clear (struct isis_circuit *circuit, int level)
+{
+  struct listnode *node, *nnode;
+  struct isis_lsp *lsp;
+
+  if (circuit->lsp_queue)
+    for (ALL_LIST_ELEMENTS (circuit->lsp_queue, node, nnode, lsp))
+      if (lsp->level & level)
+        {
+          ISIS_CLEAR_FLAG (lsp->TXQflags, circuit);
+          list_delete_node (circuit->lsp_queue, node);
+        }
+  if (circuit->lsp_retransmit)
+    for (ALL_LIST_ELEMENTS (circuit->lsp_retransmit, node, nnode, lsp))
+      if (lsp->level & level)
+        list_delete_node (circuit->lsp_retransmit, node);
+
+  if (circuit->lsp_queue == NULL || list_isempty (circuit->lsp_queue))
+    THREAD_OFF (circuit->t_send_lsp);
+  if (circuit->lsp_retransmit == NULL || list_isempty (circuit->lsp_retransmit))
+    THREAD_TIMER_OFF (circuit->t_lsp_retransmit);
+}
+
 void
 isis_circuit_down (struct isis_circuit *circuit)
 {
@@ -801,9 +829,11 @@ isis_circuit_down (struct isis_circuit *circuit)
 
   if (circuit->lsp_queue)
     {
-      circuit->lsp_queue->del = NULL;
+      isis_circuit_lsp_queue_clear (circuit, IS_LEVEL_1_AND_2);
       list_delete (circuit->lsp_queue);
       circuit->lsp_queue = NULL;
+      list_delete (circuit->lsp_retransmit);
+      circuit->lsp_retransmit = NULL;
     }
 
   /* send one gratuitous hello to spead up convergence */
@@ -83,10 +83,9 @@ struct isis_circuit
   struct thread *t_send_csnp[2];
   struct thread *t_send_psnp[2];
   struct list *lsp_queue;	/* LSPs to be txed (both levels) */
-  time_t lsp_queue_last_cleared;/* timestamp used to enforce transmit interval;
-                                 * for scalability, use one timestamp per 
-                                 * circuit, instead of one per lsp per circuit
-                                 */
+  struct thread *t_send_lsp;	/* txes lsp_queue, a burst at a time */
+  struct list *lsp_retransmit;	/* LSPs txed with the SRM flag left set */
+  struct thread *t_lsp_retransmit;	/* requeues lsp_retransmit */
   /* there is no real point in two streams, just for programming kicker */
   int (*rx) (struct isis_circuit * circuit, u_char * ssnpa);
   struct stream *rcv_stream;	/* Stream for receiving */
@@ -169,6 +168,7 @@ void isis_circuit_del_addr (struct isis_circuit *circuit,
 void isis_circuit_prepare (struct isis_circuit *circuit);
 int isis_circuit_up (struct isis_circuit *circuit);
 void isis_circuit_down (struct isis_circuit *);
+void isis_circuit_lsp_queue_clear (struct isis_circuit *circuit, int level);
 void circuit_update_nlpids (struct isis_circuit *circuit);
 void isis_circuit_print_vty (struct isis_circuit *circuit, struct vty *vty,
                              char detail);
@@ -74,6 +74,8 @@
 #define DEFAULT_MIN_LSP_GEN_INTERVAL  30
 
 #define MIN_LSP_TRANS_INTERVAL        5
+#define LSP_TX_BURST                  32   /* LSPs per run of send_lsp */
+#define LSP_TX_INTERVAL               10   /* msecs between bursts */
 
 #define MIN_CSNP_INTERVAL             1
 #define MAX_CSNP_INTERVAL             600
@@ -35,8 +35,10 @@
 #include "hash.h"
 #include "if.h"
 #include "checksum.h"
+#include "jhash.h"
 #include "md5.h"
 #include "table.h"
+#include "monotime.h"
 
 #include "isisd/dict.h"
 #include "isisd/isis_constants.h"
@@ -137,15 +139,22 @@ lsp_destroy (struct isis_lsp *lsp)
   if (lsp->area->circuit_list) {
     for (ALL_LIST_ELEMENTS_RO (lsp->area->circuit_list, cnode, circuit))
       {
-        if (circuit->lsp_queue == NULL)
-          continue;
-        for (ALL_LIST_ELEMENTS (circuit->lsp_queue, lnode, lnnode, lsp_in_list))
-          if (lsp_in_list == lsp)
-            list_delete_node(circuit->lsp_queue, lnode);
+        if (circuit->lsp_queue && ISIS_CHECK_FLAG (lsp->TXQflags, circuit))
+          for (ALL_LIST_ELEMENTS (circuit->lsp_queue, lnode, lnnode,
+                                  lsp_in_list))
+            if (lsp_in_list == lsp)
+              list_delete_node (circuit->lsp_queue, lnode);
+        if (circuit->lsp_retransmit)
+          for (ALL_LIST_ELEMENTS (circuit->lsp_retransmit, lnode, lnnode,
+                                  lsp_in_list))
+            if (lsp_in_list == lsp)
+              list_delete_node (circuit->lsp_retransmit, lnode);
       }
   }
   ISIS_FLAGS_CLEAR_ALL (lsp->SSNflags);
   ISIS_FLAGS_CLEAR_ALL (lsp->SRMflags);
+  ISIS_FLAGS_CLEAR_ALL (lsp->TXQflags);
+  THREAD_TIMER_OFF (lsp->t_lifetime);
 
   lsp_clear_data (lsp);
 
@@ -155,8 +164,7 @@ lsp_destroy (struct isis_lsp *lsp)
       lsp->lspu.frags = NULL;
     }
 
-  isis_spf_schedule (lsp->area, lsp->level);
-  isis_spf_schedule6 (lsp->area, lsp->level);
+  isis_spf_schedule_lsp (lsp, ISIS_LSP_CHANGE_TOPOLOGY);
 
   if (lsp->pdu)
     stream_free (lsp->pdu);
@@ -238,6 +246,98 @@ lsp_search_and_destroy (u_char * id, dict_t * lspdb)
     }
 }
 
+/*
+ * The remaining lifetime in the header of an LSP, and its age_out once that
+ * is zero, are not counted down every second.  They hold as of
+ * lsp->last_aged, lsp_set_time () brings them up to date for whoever looks
+ * at them, and lsp->t_lifetime fires when they run out.
+ */
+void
+lsp_set_time (struct isis_lsp *lsp)
+{
+  time_t now, elapsed;
+  u_int16_t rem_lifetime;
+
+  assert (lsp);
+
+  now = monotime (NULL);
+  elapsed = now - lsp->last_aged;
+  if (elapsed <= 0)
+    return;
+  lsp->last_aged = now;
+
+  rem_lifetime = ntohs (lsp->lsp_header->rem_lifetime);
+  if (rem_lifetime == 0)
+    {
+      lsp->age_out = (lsp->age_out > elapsed) ? lsp->age_out - elapsed : 0;
+      return;
+    }
+
+  /* Reaching zero is left to lsp_lifetime_expire (). */
+  rem_lifetime = (rem_lifetime > elapsed) ? rem_lifetime - elapsed : 1;
+  lsp->lsp_header->rem_lifetime = htons (rem_lifetime);
+}
+
+static int
+lsp_lifetime_expire (struct thread *thread)
+{
+  struct isis_lsp *lsp;
+  dict_t *lspdb;
+  dnode_t *dnode;
+
+  lsp = THREAD_ARG (thread);
+  assert (lsp);
+  lsp->t_lifetime = NULL;
+  lsp->last_aged = monotime (NULL);
+
+  if (lsp->lsp_header->rem_lifetime != 0)
+    {
+      /* ISO 10589 - 7.3.16.4, the remaining lifetime has run out */
+      lsp->lsp_header->rem_lifetime = 0;
+      if (lsp->lsp_header->seq_num != 0)
+        {
+          /* 7.3.16.4 a) set SRM flags on all */
+          lsp_set_all_srmflags (lsp);
+          /* 7.3.16.4 b) retain only the header FIXME  */
+          /* 7.3.16.4 c) record the time to purge FIXME */
+          isis_spf_schedule_lsp (lsp, ISIS_LSP_CHANGE_TOPOLOGY);
+        }
+      THREAD_TIMER_ON (master, lsp->t_lifetime, lsp_lifetime_expire, lsp,
+                       lsp->age_out);
+      return ISIS_OK;
+    }
+
+  lspdb = lsp->area->lspdb[lsp->level - 1];
+  dnode = lspdb ? dict_lookup (lspdb, lsp->lsp_header->lsp_id) : NULL;
+  if (!dnode || dnode_get (dnode) != lsp)
+    return ISIS_OK;
+
+  zlog_debug ("ISIS-Upd (%s): L%u LSP %s seq 0x%08x aged out",
+              lsp->area->area_tag, lsp->level,
+              rawlspid_print (lsp->lsp_header->lsp_id),
+              ntohl (lsp->lsp_header->seq_num));
+  lsp_destroy (lsp);
+  dict_delete_free (lspdb, dnode);
+
+  return ISIS_OK;
+}
+
+/*
+ * Starts counting down the remaining lifetime just set in the header of an
+ * LSP, or its age_out if the remaining lifetime is zero.
+ */
+static void
+lsp_lifetime_reset (struct isis_lsp *lsp)
+{
+  u_int16_t rem_lifetime;
+
+  rem_lifetime = ntohs (lsp->lsp_header->rem_lifetime);
+  lsp->last_aged = monotime (NULL);
+  THREAD_TIMER_OFF (lsp->t_lifetime);
+  THREAD_TIMER_ON (master, lsp->t_lifetime, lsp_lifetime_expire, lsp,
+                   rem_lifetime ? rem_lifetime : lsp->age_out);
+}
+
 /*
  * Compares a LSP to given values
  * Params are given in net order
@@ -424,8 +524,7 @@ lsp_inc_seqnum (struct isis_lsp *lsp, u_int32_t seq_num)
   fletcher_checksum(STREAM_DATA (lsp->pdu) + 12,
                     ntohs (lsp->lsp_header->pdu_len) - 12, 12);
 
-  isis_spf_schedule (lsp->area, lsp->level);
-  isis_spf_schedule6 (lsp->area, lsp->level);
+  isis_spf_schedule_lsp (lsp, ISIS_LSP_CHANGE_TOPOLOGY);
 
   return;
 }
@@ -488,26 +587,21 @@ lsp_update_data (struct isis_lsp *lsp, struct stream *stream,
   lsp->level = level;
   lsp->age_out = ZERO_AGE_LIFETIME;
   lsp->installed = time (NULL);
+  lsp_lifetime_reset (lsp);
   /*
    * Get LSP data i.e. TLVs
+   * The neighbours and reachabilities are not parsed into lists, SPF and
+   * the show commands walk them in the PDU with lsp_tlv_view_init ().
    */
   expected |= TLVFLAG_AUTH_INFO;
   expected |= TLVFLAG_AREA_ADDRS;
-  expected |= TLVFLAG_IS_NEIGHS;
   expected |= TLVFLAG_NLPID;
   if (area->dynhostname)
     expected |= TLVFLAG_DYN_HOSTNAME;
   if (area->newmetric)
-    {
-      expected |= TLVFLAG_TE_IS_NEIGHS;
-      expected |= TLVFLAG_TE_IPV4_REACHABILITY;
-      expected |= TLVFLAG_TE_ROUTER_ID;
-    }
+    expected |= TLVFLAG_TE_ROUTER_ID;
   expected |= TLVFLAG_IPV4_ADDR;
-  expected |= TLVFLAG_IPV4_INT_REACHABILITY;
-  expected |= TLVFLAG_IPV4_EXT_REACHABILITY;
   expected |= TLVFLAG_IPV6_ADDR;
-  expected |= TLVFLAG_IPV6_REACHABILITY;
 
   retval = parse_tlvs (area->area_tag, STREAM_DATA (lsp->pdu) +
                        ISIS_FIXED_HDR_LEN + ISIS_LSP_HDR_LEN,
@@ -531,11 +625,142 @@ lsp_update_data (struct isis_lsp *lsp, struct stream *stream,
   return;
 }
 
+/* Views the entries of one type of TLV in the PDU of an LSP. */
+void
+lsp_tlv_view_init (struct tlv_view *view, struct stream *pdu, u_char type)
+{
+  tlv_view_init (view, type,
+                 STREAM_DATA (pdu) + ISIS_FIXED_HDR_LEN + ISIS_LSP_HDR_LEN,
+                 (int) stream_get_endp (pdu) - ISIS_FIXED_HDR_LEN
+                 - ISIS_LSP_HDR_LEN);
+}
+
+/* Whether two PDUs have the same TLV entries of a type, as far as SPF
+ * goes. */
+static int
+lsp_tlv_same (struct stream *pdu1, struct stream *pdu2, u_char type,
+              int (*same) (void *, void *))
+{
+  struct tlv_view v1, v2;
+  void *e1, *e2;
+
+  lsp_tlv_view_init (&v1, pdu1, type);
+  lsp_tlv_view_init (&v2, pdu2, type);
+  for (;;)
+    {
+      e1 = tlv_view_next (&v1);
+      e2 = tlv_view_next (&v2);
+      if (e1 == NULL || e2 == NULL)
+        return e1 == e2;
+      if (!same (e1, e2))
+        return 0;
+    }
+}
+
+static int
+is_neigh_same (void *arg1, void *arg2)
+{
+  struct is_neigh *n1 = arg1, *n2 = arg2;
+
+  return (n1->metrics.metric_default == n2->metrics.metric_default
+          && !memcmp (n1->neigh_id, n2->neigh_id, ISIS_SYS_ID_LEN + 1));
+}
+
+static int
+te_is_neigh_same (void *arg1, void *arg2)
+{
+  struct te_is_neigh *n1 = arg1, *n2 = arg2;
+
+  return (GET_TE_METRIC (n1) == GET_TE_METRIC (n2)
+          && !memcmp (n1->neigh_id, n2->neigh_id, ISIS_SYS_ID_LEN + 1));
+}
+
+static int
+ipv4_reach_same (void *arg1, void *arg2)
+{
+  struct ipv4_reachability *r1 = arg1, *r2 = arg2;
+
+  return (r1->metrics.metric_default == r2->metrics.metric_default
+          && r1->prefix.s_addr == r2->prefix.s_addr
+          && r1->mask.s_addr == r2->mask.s_addr);
+}
+
+static int
+te_ipv4_reach_same (void *arg1, void *arg2)
+{
+  struct te_ipv4_reachability *r1 = arg1, *r2 = arg2;
+
+  return (r1->te_metric == r2->te_metric && r1->control == r2->control
+          && !memcmp (&r1->prefix_start, &r2->prefix_start,
+                      PSIZE (r1->control & 0x3F)));
+}
+
+static int
+ipv6_reach_same (void *arg1, void *arg2)
+{
+  struct ipv6_reachability *r1 = arg1, *r2 = arg2;
+
+  return (r1->metric == r2->metric && r1->control_info == r2->control_info
+          && r1->prefix_len == r2->prefix_len
+          && !memcmp (r1->prefix, r2->prefix, PSIZE (r1->prefix_len)));
+}
+
+/*
+ * What a new instance of an LSP changes for SPF: its neighbours, or only
+ * the prefixes it reaches, or nothing SPF looks at, as for a refresh.
+ */
+static enum isis_lsp_change
+lsp_spf_change (struct stream *old_pdu, struct tlvs *old,
+                struct isis_lsp *lsp)
+{
+  struct isis_link_state_hdr *old_hdr, *hdr = lsp->lsp_header;
+  struct tlvs *new = &lsp->tlv_data;
+  int te = lsp->area->newmetric;
+
+  if (old_pdu == NULL)
+    return ISIS_LSP_CHANGE_TOPOLOGY;
+  old_hdr = (struct isis_link_state_hdr *) (STREAM_DATA (old_pdu)
+                                             + ISIS_FIXED_HDR_LEN);
+
+  if ((old_hdr->rem_lifetime == 0) != (hdr->rem_lifetime == 0)
+      || (old_hdr->seq_num == 0) != (hdr->seq_num == 0)
+      || ISIS_MASK_LSP_OL_BIT (old_hdr->lsp_bits)
+         != ISIS_MASK_LSP_OL_BIT (hdr->lsp_bits))
+    return ISIS_LSP_CHANGE_TOPOLOGY;
+
+  if ((old->nlpids == NULL) != (new->nlpids == NULL)
+      || (old->nlpids
+          && (old->nlpids->count != new->nlpids->count
+              || memcmp (old->nlpids->nlpids, new->nlpids->nlpids,
+                         old->nlpids->count))))
+    return ISIS_LSP_CHANGE_TOPOLOGY;
+
+  if (!lsp_tlv_same (old_pdu, lsp->pdu, IS_NEIGHBOURS, is_neigh_same)
+      || (te && !lsp_tlv_same (old_pdu, lsp->pdu, TE_IS_NEIGHBOURS,
+                               te_is_neigh_same)))
+    return ISIS_LSP_CHANGE_TOPOLOGY;
+
+  if (!lsp_tlv_same (old_pdu, lsp->pdu, IPV4_INT_REACHABILITY,
+                     ipv4_reach_same)
+      || !lsp_tlv_same (old_pdu, lsp->pdu, IPV4_EXT_REACHABILITY,
+                        ipv4_reach_same)
+      || (te && !lsp_tlv_same (old_pdu, lsp->pdu, TE_IPV4_REACHABILITY,
+                               te_ipv4_reach_same))
+      || !lsp_tlv_same (old_pdu, lsp->pdu, IPV6_REACHABILITY,
+                        ipv6_reach_same))
+    return ISIS_LSP_CHANGE_REACH;
+
+  return ISIS_LSP_CHANGE_NONE;
+}
+
 void
 lsp_update (struct isis_lsp *lsp, struct stream *stream,
             struct isis_area *area, int level)
 {
   dnode_t *dnode = NULL;
+  struct stream *old_pdu;
+  struct tlvs old_tlvs;
+  enum isis_lsp_change change;
 
   /* Remove old LSP from database. This is required since the
    * lsp_update_data will free the lsp->pdu (which has the key, lsp_id)
@@ -552,11 +777,27 @@ lsp_update (struct isis_lsp *lsp, struct stream *stream,
       lsp->own_lsp = 0;
     }
 
+  /* Keep the old instance until the new one is compared with it, the
+   * TLVs point into its PDU. */
+  if (lsp->tlv_data.hostname)
+    isis_dynhn_remove (lsp->lsp_header->lsp_id);
+  old_pdu = lsp->pdu;
+  old_tlvs = lsp->tlv_data;
+  lsp->pdu = NULL;
+  memset (&lsp->tlv_data, 0, sizeof (struct tlvs));
+
   /* rebuild the lsp data */
   lsp_update_data (lsp, stream, area, level);
+  change = lsp_spf_change (old_pdu, &old_tlvs, lsp);
+
+  free_tlvs (&old_tlvs);
+  if (old_pdu)
+    stream_free (old_pdu);
 
   /* insert the lsp back into the database */
-  lsp_insert (lsp, area->lspdb[level - 1]);
+  dict_alloc_insert (area->lspdb[level - 1], lsp->lsp_header->lsp_id, lsp);
+  if (lsp->lsp_header->seq_num != 0)
+    isis_spf_schedule_lsp (lsp, change);
 }
 
 /* creation of LSP directly from what we received */
@@ -620,6 +861,7 @@ lsp_new(struct isis_area *area, u_char * lsp_id,
   lsp->lsp_header->lsp_bits = lsp_bits;
   lsp->level = level;
   lsp->age_out = ZERO_AGE_LIFETIME;
+  lsp_lifetime_reset (lsp);
 
   stream_forward_endp (lsp->pdu, ISIS_FIXED_HDR_LEN + ISIS_LSP_HDR_LEN);
 
@@ -638,10 +880,7 @@ lsp_insert (struct isis_lsp *lsp, dict_t * lspdb)
 {
   dict_alloc_insert (lspdb, lsp->lsp_header->lsp_id, lsp);
   if (lsp->lsp_header->seq_num != 0)
-    {
-      isis_spf_schedule (lsp->area, lsp->level);
-      isis_spf_schedule6 (lsp->area, lsp->level);
-    }
+    isis_spf_schedule_lsp (lsp, ISIS_LSP_CHANGE_TOPOLOGY);
 }
 
 /*
@@ -742,22 +981,6 @@ lsp_build_list_ssn (struct isis_circuit *circuit, u_char num_lsps,
   return;
 }
 
-static void
-lsp_set_time (struct isis_lsp *lsp)
-{
-  assert (lsp);
-
-  if (lsp->lsp_header->rem_lifetime == 0)
-    {
-      if (lsp->age_out > 0)
-        lsp->age_out--;
-      return;
-    }
-
-  lsp->lsp_header->rem_lifetime =
-    htons (ntohs (lsp->lsp_header->rem_lifetime) - 1);
-}
-
 static void
 lspid_print (u_char * lsp_id, u_char * trg, char dynhost, char frag)
 {
@@ -812,6 +1035,7 @@ lsp_print (struct isis_lsp *lsp, struct vty *vty, char dynhost)
   u_char LSPid[255];
   char age_out[8];
 
+  lsp_set_time (lsp);
   lspid_print (lsp->lsp_header->lsp_id, LSPid, dynhost, 1);
   vty_out (vty, "%-21s%c  ", LSPid, lsp->own_lsp ? '*' : ' ');
   vty_out (vty, "%5u   ", ntohs (lsp->lsp_header->pdu_len));
@@ -841,6 +1065,7 @@ lsp_print_detail (struct isis_lsp *lsp, struct vty *vty, char dynhost)
   struct in_addr *ipv4_addr;
   struct te_ipv4_reachability *te_ipv4_reach;
   struct ipv6_reachability *ipv6_reach;
+  struct tlv_view view;
   struct in6_addr in6;
   u_char buff[BUFSIZ];
   u_char LSPid[255];
@@ -914,18 +1139,17 @@ lsp_print_detail (struct isis_lsp *lsp, struct vty *vty, char dynhost)
       }
 
   /* for the IS neighbor tlv */
-  if (lsp->tlv_data.is_neighs)
-    for (ALL_LIST_ELEMENTS_RO (lsp->tlv_data.is_neighs, lnode, is_neigh))
-      {
-	lspid_print (is_neigh->neigh_id, LSPid, dynhost, 0);
-	vty_out (vty, "  Metric      : %-8d IS            : %s%s",
-		 is_neigh->metrics.metric_default, LSPid, VTY_NEWLINE);
-      }
+  lsp_tlv_view_init (&view, lsp->pdu, IS_NEIGHBOURS);
+  while ((is_neigh = tlv_view_next (&view)))
+    {
+      lspid_print (is_neigh->neigh_id, LSPid, dynhost, 0);
+      vty_out (vty, "  Metric      : %-8d IS            : %s%s",
+	       is_neigh->metrics.metric_default, LSPid, VTY_NEWLINE);
+    }
   
   /* for the internal reachable tlv */
-  if (lsp->tlv_data.ipv4_int_reachs)
-    for (ALL_LIST_ELEMENTS_RO (lsp->tlv_data.ipv4_int_reachs, lnode,
-			       ipv4_reach))
+  lsp_tlv_view_init (&view, lsp->pdu, IPV4_INT_REACHABILITY);
+  while ((ipv4_reach = tlv_view_next (&view)))
     {
       memcpy (ipv4_reach_prefix, inet_ntoa (ipv4_reach->prefix),
 	      sizeof (ipv4_reach_prefix));
@@ -937,9 +1161,8 @@ lsp_print_detail (struct isis_lsp *lsp, struct vty *vty, char dynhost)
     }
 
   /* for the external reachable tlv */
-  if (lsp->tlv_data.ipv4_ext_reachs)
-    for (ALL_LIST_ELEMENTS_RO (lsp->tlv_data.ipv4_ext_reachs, lnode, 
-			       ipv4_reach))
+  lsp_tlv_view_init (&view, lsp->pdu, IPV4_EXT_REACHABILITY);
+  while ((ipv4_reach = tlv_view_next (&view)))
     {
       memcpy (ipv4_reach_prefix, inet_ntoa (ipv4_reach->prefix),
 	      sizeof (ipv4_reach_prefix));
@@ -951,8 +1174,8 @@ lsp_print_detail (struct isis_lsp *lsp, struct vty *vty, char dynhost)
     }
   
   /* IPv6 tlv */
-  if (lsp->tlv_data.ipv6_reachs)
-    for (ALL_LIST_ELEMENTS_RO (lsp->tlv_data.ipv6_reachs, lnode, ipv6_reach))
+  lsp_tlv_view_init (&view, lsp->pdu, IPV6_REACHABILITY);
+  while ((ipv6_reach = tlv_view_next (&view)))
     {
       memset (&in6, 0, sizeof (in6));
       memcpy (in6.s6_addr, ipv6_reach->prefix,
@@ -970,8 +1193,8 @@ lsp_print_detail (struct isis_lsp *lsp, struct vty *vty, char dynhost)
     }
 
   /* TE IS neighbor tlv */
-  if (lsp->tlv_data.te_is_neighs)
-    for (ALL_LIST_ELEMENTS_RO (lsp->tlv_data.te_is_neighs, lnode, te_is_neigh))
+  lsp_tlv_view_init (&view, lsp->pdu, TE_IS_NEIGHBOURS);
+  while ((te_is_neigh = tlv_view_next (&view)))
     {
       lspid_print (te_is_neigh->neigh_id, LSPid, dynhost, 0);
       vty_out (vty, "  Metric      : %-8d IS-Extended   : %s%s",
@@ -981,9 +1204,8 @@ lsp_print_detail (struct isis_lsp *lsp, struct vty *vty, char dynhost)
     }
 
   /* TE IPv4 tlv */
-  if (lsp->tlv_data.te_ipv4_reachs)
-    for (ALL_LIST_ELEMENTS_RO (lsp->tlv_data.te_ipv4_reachs, lnode,
-			       te_ipv4_reach))
+  lsp_tlv_view_init (&view, lsp->pdu, TE_IPV4_REACHABILITY);
+  while ((te_ipv4_reach = tlv_view_next (&view)))
     {
       /* FIXME: There should be better way to output this stuff. */
       vty_out (vty, "  Metric      : %-8d IPv4-Extended : %s/%d%s",
@@ -1038,56 +1260,6 @@ lsp_print_all (struct vty *vty, dict_t * lspdb, char detail, char dynhost)
 #define FRAG_NEEDED(S,T,I) \
   (STREAM_SIZE(S)-STREAM_REMAIN(S)+(I) > FRAG_THOLD(S,T))
 
-/* FIXME: It shouldn't be necessary to pass tlvsize here, TLVs can have
- * variable length (TE TLVs, sub TLVs). */
-static void
-lsp_tlv_fit (struct isis_lsp *lsp, struct list **from, struct list **to,
-	     int tlvsize, int frag_thold,
-	     int tlv_build_func (struct list *, struct stream *))
-{
-  int count, i;
-
-  /* can we fit all ? */
-  if (!FRAG_NEEDED (lsp->pdu, frag_thold, listcount (*from) * tlvsize + 2))
-    {
-      tlv_build_func (*from, lsp->pdu);
-      if (listcount (*to) != 0)
-	{
-	  struct listnode *node, *nextnode;
-	  void *elem;
-
-	  for (ALL_LIST_ELEMENTS (*from, node, nextnode, elem))
-	    {
-	      listnode_add (*to, elem);
-	      list_delete_node (*from, node);
-	    }
-	}
-      else
-	{
-	  list_free (*to);
-	  *to = *from;
-	  *from = NULL;
-	}
-    }
-  else if (!FRAG_NEEDED (lsp->pdu, frag_thold, tlvsize + 2))
-    {
-      /* fit all we can */
-      count = FRAG_THOLD (lsp->pdu, frag_thold) - 2 -
-	(STREAM_SIZE (lsp->pdu) - STREAM_REMAIN (lsp->pdu));
-      count = count / tlvsize;
-      if (count > (int)listcount (*from))
-	count = listcount (*from);
-      for (i = 0; i < count; i++)
-	{
-	  listnode_add (*to, listgetdata (listhead (*from)));
-	  listnode_delete (*from, listgetdata (listhead (*from)));
-	}
-      tlv_build_func (*to, lsp->pdu);
-    }
-  lsp->lsp_header->pdu_len = htons (stream_get_endp (lsp->pdu));
-  return;
-}
-
 /* Process IS_NEIGHBOURS TLV with TE subTLVs */
 void
 lsp_te_tlv_fit (struct isis_lsp *lsp, struct list **from, struct list **to, int frag_thold)
@@ -1328,9 +1500,368 @@ lsp_build_ext_reach (struct isis_lsp *lsp, struct isis_area *area,
   lsp_build_ext_reach_ipv6(lsp, area, tlv_data);
 }
 
+/*
+ * The entries of the reachability and neighbour TLVs are spread over the
+ * fragments of our own LSP.  An entry stays in the fragment it was in the
+ * last time the LSP was built as long as it fits there, and new entries go
+ * to the first fragment with room, so that a change to one entry changes
+ * one fragment only.
+ */
+#define LSP_FRAGS 256
+
+/* The TLVs spread over the fragments, in the order they are added. */
+static const u_char lsp_frag_tlvs[] =
+{
+  IPV4_INT_REACHABILITY, IPV4_EXT_REACHABILITY, TE_IPV4_REACHABILITY,
+  IPV6_REACHABILITY, IS_NEIGHBOURS, TE_IS_NEIGHBOURS,
+};
+#define LSP_FRAG_TLVS array_size (lsp_frag_tlvs)
+
+/* What identifies an entry, whatever its metric, and its fragment. */
+struct lsp_frag_key
+{
+  u_char type;
+  u_char frag;
+  u_char len;
+  u_char id[1 + IPV6_MAX_BYTELEN];
+};
+
+/* Room of a fragment, counted as the TLV encoders lay the entries out. */
+struct lsp_frag
+{
+  struct isis_lsp *lsp;		/* NULL until an entry goes there */
+  int used;			/* octets of the PDU */
+  int limit;			/* octets the PDU may take */
+  int tlv_used[LSP_FRAG_TLVS];	/* octets in the last TLV of each type */
+};
+
+static struct list **
+lsp_frag_tlv_list (struct tlvs *tlvs, u_char type)
+{
+  switch (type)
+    {
+    case IPV4_INT_REACHABILITY:
+      return &tlvs->ipv4_int_reachs;
+    case IPV4_EXT_REACHABILITY:
+      return &tlvs->ipv4_ext_reachs;
+    case TE_IPV4_REACHABILITY:
+      return &tlvs->te_ipv4_reachs;
+    case IPV6_REACHABILITY:
+      return &tlvs->ipv6_reachs;
+    case IS_NEIGHBOURS:
+      return &tlvs->is_neighs;
+    case TE_IS_NEIGHBOURS:
+      return &tlvs->te_is_neighs;
+    }
+  assert (0);
+  return NULL;
+}
+
+static int
+lsp_frag_tlv_add (u_char type, struct list *list, struct stream *stream)
+{
+  switch (type)
+    {
+    case IPV4_INT_REACHABILITY:
+      return tlv_add_ipv4_int_reachs (list, stream);
+    case IPV4_EXT_REACHABILITY:
+      return tlv_add_ipv4_ext_reachs (list, stream);
+    case TE_IPV4_REACHABILITY:
+      return tlv_add_te_ipv4_reachs (list, stream);
+    case IPV6_REACHABILITY:
+      return tlv_add_ipv6_reachs (list, stream);
+    case IS_NEIGHBOURS:
+      return tlv_add_is_neighs (list, stream);
+    case TE_IS_NEIGHBOURS:
+      return tlv_add_te_is_neighs (list, stream);
+    }
+  return ISIS_ERROR;
+}
+
+/* Octets an entry takes in its TLV.  The encoder starts a new TLV unless
+ * room octets are left in the current one. */
+static int
+lsp_frag_entry_len (u_char type, void *entry, int *room)
+{
+  struct te_ipv4_reachability *te_ipreach;
+  struct ipv6_reachability *ip6reach;
+  struct te_is_neigh *te_is_neigh;
+  int len = 0;
+
+  switch (type)
+    {
+    case IPV4_INT_REACHABILITY:
+    case IPV4_EXT_REACHABILITY:
+      len = IPV4_REACH_LEN;
+      break;
+    case TE_IPV4_REACHABILITY:
+      te_ipreach = entry;
+      len = 5 + PSIZE (te_ipreach->control & 0x3F);
+      break;
+    case IPV6_REACHABILITY:
+      ip6reach = entry;
+      *room = IPV6_REACH_LEN;
+      return 6 + PSIZE (ip6reach->prefix_len);
+    case IS_NEIGHBOURS:
+      len = IS_NEIGHBOURS_LEN;
+      break;
+    case TE_IS_NEIGHBOURS:
+      te_is_neigh = entry;
+      len = IS_NEIGHBOURS_LEN + te_is_neigh->sub_tlvs_length;
+      break;
+    }
+  *room = len;
+  return len;
+}
+
+static void
+lsp_frag_key_set (struct lsp_frag_key *key, u_char type, void *entry)
+{
+  struct ipv4_reachability *ipreach;
+  struct te_ipv4_reachability *te_ipreach;
+  struct ipv6_reachability *ip6reach;
+
+  memset (key, 0, sizeof (*key));
+  key->type = type;
+  switch (type)
+    {
+    case IPV4_INT_REACHABILITY:
+    case IPV4_EXT_REACHABILITY:
+      ipreach = entry;
+      memcpy (key->id, &ipreach->prefix, IPV4_MAX_BYTELEN);
+      memcpy (key->id + IPV4_MAX_BYTELEN, &ipreach->mask, IPV4_MAX_BYTELEN);
+      key->len = 2 * IPV4_MAX_BYTELEN;
+      break;
+    case TE_IPV4_REACHABILITY:
+      te_ipreach = entry;
+      key->id[0] = te_ipreach->control & 0x3F;
+      memcpy (key->id + 1, &te_ipreach->prefix_start, PSIZE (key->id[0]));
+      key->len = 1 + PSIZE (key->id[0]);
+      break;
+    case IPV6_REACHABILITY:
+      ip6reach = entry;
+      key->id[0] = ip6reach->prefix_len;
+      memcpy (key->id + 1, ip6reach->prefix, PSIZE (key->id[0]));
+      key->len = 1 + PSIZE (key->id[0]);
+      break;
+    case IS_NEIGHBOURS:
+      memcpy (key->id, ((struct is_neigh *) entry)->neigh_id,
+              ISIS_SYS_ID_LEN + 1);
+      key->len = ISIS_SYS_ID_LEN + 1;
+      break;
+    case TE_IS_NEIGHBOURS:
+      memcpy (key->id, ((struct te_is_neigh *) entry)->neigh_id,
+              ISIS_SYS_ID_LEN + 1);
+      key->len = ISIS_SYS_ID_LEN + 1;
+      break;
+    }
+}
+
+static unsigned int
+lsp_frag_key_hash (void *arg)
+{
+  struct lsp_frag_key *key = arg;
+
+  return jhash (key->id, key->len, key->type);
+}
+
+static int
+lsp_frag_key_cmp (const void *arg1, const void *arg2)
+{
+  const struct lsp_frag_key *k1 = arg1, *k2 = arg2;
+
+  return (k1->type == k2->type && k1->len == k2->len
+          && !memcmp (k1->id, k2->id, k1->len));
+}
+
+/*
+ * Notes in map which fragment each entry of our own LSP is in, then
+ * clears the data of the fragments.  The keys are allocated in one go,
+ * and returned for the caller to free.
+ */
+static struct lsp_frag_key *
+lsp_frags_collect (struct isis_lsp *lsp0, struct lsp_frag *frags,
+                   struct hash *map)
+{
+  struct lsp_frag_key *keys = NULL, *key;
+  struct isis_lsp *lsp;
+  struct listnode *node;
+  struct list *list;
+  void *entry;
+  unsigned int t, count = 0;
+  int i;
+
+  frags[0].lsp = lsp0;
+  if (lsp0->lspu.frags)
+    for (ALL_LIST_ELEMENTS_RO (lsp0->lspu.frags, node, lsp))
+      frags[LSP_FRAGMENT (lsp->lsp_header->lsp_id)].lsp = lsp;
+
+  for (i = 0; i < LSP_FRAGS; i++)
+    for (t = 0; frags[i].lsp && t < LSP_FRAG_TLVS; t++)
+      {
+        list = *lsp_frag_tlv_list (&frags[i].lsp->tlv_data, lsp_frag_tlvs[t]);
+        if (list)
+          count += listcount (list);
+      }
+  if (count)
+    keys = XCALLOC (MTYPE_ISIS_TMP, count * sizeof (struct lsp_frag_key));
+
+  key = keys;
+  for (i = 0; i < LSP_FRAGS; i++)
+    {
+      if ((lsp = frags[i].lsp) == NULL)
+        continue;
+      for (t = 0; t < LSP_FRAG_TLVS; t++)
+        {
+          list = *lsp_frag_tlv_list (&lsp->tlv_data, lsp_frag_tlvs[t]);
+          if (list == NULL)
+            continue;
+          for (ALL_LIST_ELEMENTS_RO (list, node, entry))
+            {
+              lsp_frag_key_set (key, lsp_frag_tlvs[t], entry);
+              key->frag = i;
+              hash_get (map, key, hash_alloc_intern);
+              key++;
+            }
+        }
+      lsp_clear_data (lsp);
+    }
+
+  return keys;
+}
+
+/* Takes an entry into a fragment if there is room for it. */
+static int
+lsp_frag_take (struct lsp_frag *frag, unsigned int t, void *entry)
+{
+  u_char type = lsp_frag_tlvs[t];
+  int len, room, start, cost, tlv_used;
+
+  len = lsp_frag_entry_len (type, entry, &room);
+  /* IS neighbours TLVs start with the virtual flag */
+  start = (type == IS_NEIGHBOURS) ? 1 : 0;
+  if (frag->tlv_used[t] == 0 || frag->tlv_used[t] + room > 255)
+    {
+      cost = 2 + start + len;
+      tlv_used = start + len;
+    }
+  else
+    {
+      cost = len;
+      tlv_used = frag->tlv_used[t] + len;
+    }
+  if (frag->used + cost > frag->limit)
+    return 0;
+
+  frag->used += cost;
+  frag->tlv_used[t] = tlv_used;
+  return 1;
+}
+
+static void
+lsp_frag_add (struct isis_lsp *lsp, u_char type, void *entry)
+{
+  struct list **list = lsp_frag_tlv_list (&lsp->tlv_data, type);
+
+  if (*list == NULL)
+    {
+      *list = list_new ();
+      (*list)->del = free_tlv;
+    }
+  listnode_add (*list, entry);
+}
+
+/*
+ * Moves the entries from tlv_data to the fragments: first those that fit
+ * in the fragment they were in, then the others to the first fragment
+ * with room, which is created if need be.  Each fragment gets its entries
+ * in the order of tlv_data, so that one that keeps its entries encodes
+ * the same as before.
+ */
+static void
+lsp_frags_assign (struct isis_lsp *lsp0, struct isis_area *area, int level,
+                  struct lsp_frag *frags, struct hash *map,
+                  struct tlvs *tlv_data)
+{
+  struct lsp_frag_key lookup, *key;
+  struct listnode *node, *nnode;
+  struct list *list;
+  void *entry;
+  unsigned int t;
+  int *dest;
+  int i, n, left;
+
+  for (i = 0; i < LSP_FRAGS; i++)
+    {
+      frags[i].limit = FRAG_THOLD (frags[i].lsp ? frags[i].lsp->pdu
+                                   : lsp0->pdu, area->lsp_frag_threshold);
+      frags[i].used = ISIS_FIXED_HDR_LEN + ISIS_LSP_HDR_LEN;
+    }
+  frags[0].used = stream_get_endp (lsp0->pdu);
+
+  for (t = 0; t < LSP_FRAG_TLVS; t++)
+    {
+      list = *lsp_frag_tlv_list (tlv_data, lsp_frag_tlvs[t]);
+      if (list == NULL || listcount (list) == 0)
+        continue;
+      dest = XCALLOC (MTYPE_ISIS_TMP, listcount (list) * sizeof (int));
+
+      n = 0;
+      for (ALL_LIST_ELEMENTS_RO (list, node, entry))
+        {
+          lsp_frag_key_set (&lookup, lsp_frag_tlvs[t], entry);
+          key = hash_lookup (map, &lookup);
+          if (key && frags[key->frag].lsp
+              && lsp_frag_take (&frags[key->frag], t, entry))
+            dest[n] = key->frag;
+          else
+            dest[n] = -1;
+          n++;
+        }
+
+      i = 0;
+      n = 0;
+      left = 0;
+      for (ALL_LIST_ELEMENTS_RO (list, node, entry))
+        {
+          if (dest[n] < 0)
+            {
+              while (i < LSP_FRAGS && !lsp_frag_take (&frags[i], t, entry))
+                i++;
+              if (i < LSP_FRAGS)
+                {
+                  if (frags[i].lsp == NULL)
+                    frags[i].lsp = lsp_next_frag (i, lsp0, area, level);
+                  dest[n] = i;
+                }
+              else
+                left++;
+            }
+          n++;
+        }
+      if (left)
+        zlog_warn ("ISIS (%s): L%d LSP is full, %d entries left out",
+                   area->area_tag, level, left);
+
+      n = 0;
+      for (ALL_LIST_ELEMENTS (list, node, nnode, entry))
+        {
+          if (dest[n] >= 0)
+            {
+              lsp_frag_add (frags[dest[n]].lsp, lsp_frag_tlvs[t], entry);
+              list_delete_node (list, node);
+            }
+          n++;
+        }
+      XFREE (MTYPE_ISIS_TMP, dest);
+    }
+}
+
 /*
  * Builds the LSP data part. This func creates a new frag whenever 
- * area->lsp_frag_threshold is exceeded.
+ * area->lsp_frag_threshold is exceeded, and keeps the entries in the
+ * frags they were in.  Only the PDUs are rewritten, the callers decide
+ * which frags get a new sequence number.
  */
 static void
 lsp_build (struct isis_lsp *lsp, struct isis_area *area)
@@ -1352,11 +1883,21 @@ lsp_build (struct isis_lsp *lsp, struct isis_area *area)
   uint32_t expected = 0, found = 0;
   uint32_t metric;
   u_char zero_id[ISIS_SYS_ID_LEN + 1];
+  struct lsp_frag *frags;
+  struct lsp_frag_key *keys;
+  struct hash *map;
+  unsigned int t;
   int retval = ISIS_OK;
+  int i;
   char buf[BUFSIZ];
 
   lsp_debug("ISIS (%s): Constructing local system LSP for level %d", area->area_tag, level);
 
+  /* Note the frag of each entry, before the data is cleared */
+  frags = XCALLOC (MTYPE_ISIS_TMP, LSP_FRAGS * sizeof (struct lsp_frag));
+  map = hash_create (lsp_frag_key_hash, lsp_frag_key_cmp);
+  keys = lsp_frags_collect (lsp0, frags, map);
+
   /*
    * Building the zero lsp
    */
@@ -1743,86 +2284,34 @@ lsp_build (struct isis_lsp *lsp, struct isis_area *area)
 
   lsp_debug("ISIS (%s): LSP construction is complete. Serializing...", area->area_tag);
 
-  while (tlv_data.ipv4_int_reachs && listcount (tlv_data.ipv4_int_reachs))
-    {
-      if (lsp->tlv_data.ipv4_int_reachs == NULL)
-	lsp->tlv_data.ipv4_int_reachs = list_new ();
-      lsp_tlv_fit (lsp, &tlv_data.ipv4_int_reachs,
-		   &lsp->tlv_data.ipv4_int_reachs,
-		   IPV4_REACH_LEN, area->lsp_frag_threshold,
-		   tlv_add_ipv4_int_reachs);
-      if (tlv_data.ipv4_int_reachs && listcount (tlv_data.ipv4_int_reachs))
-	lsp = lsp_next_frag (LSP_FRAGMENT (lsp->lsp_header->lsp_id) + 1,
-			     lsp0, area, level);
-    }
-
-  while (tlv_data.ipv4_ext_reachs && listcount (tlv_data.ipv4_ext_reachs))
-    {
-      if (lsp->tlv_data.ipv4_ext_reachs == NULL)
-	lsp->tlv_data.ipv4_ext_reachs = list_new ();
-      lsp_tlv_fit (lsp, &tlv_data.ipv4_ext_reachs,
-		   &lsp->tlv_data.ipv4_ext_reachs,
-		   IPV4_REACH_LEN, area->lsp_frag_threshold,
-		   tlv_add_ipv4_ext_reachs);
-      if (tlv_data.ipv4_ext_reachs && listcount (tlv_data.ipv4_ext_reachs))
-	lsp = lsp_next_frag (LSP_FRAGMENT (lsp->lsp_header->lsp_id) + 1,
-			     lsp0, area, level);
-    }
-
-  /* FIXME: We pass maximum te_ipv4_reachability length to the lsp_tlv_fit()
-   * for now. lsp_tlv_fit() needs to be fixed to deal with variable length
-   * TLVs (sub TLVs!). */
-  while (tlv_data.te_ipv4_reachs && listcount (tlv_data.te_ipv4_reachs))
-    {
-      if (lsp->tlv_data.te_ipv4_reachs == NULL)
-	lsp->tlv_data.te_ipv4_reachs = list_new ();
-      lsp_tlv_fit (lsp, &tlv_data.te_ipv4_reachs,
-		   &lsp->tlv_data.te_ipv4_reachs,
-		   TE_IPV4_REACH_LEN, area->lsp_frag_threshold,
-		   tlv_add_te_ipv4_reachs);
-      if (tlv_data.te_ipv4_reachs && listcount (tlv_data.te_ipv4_reachs))
-	lsp = lsp_next_frag (LSP_FRAGMENT (lsp->lsp_header->lsp_id) + 1,
-			     lsp0, area, level);
-    }
-
-  while (tlv_data.ipv6_reachs && listcount (tlv_data.ipv6_reachs))
-    {
-      if (lsp->tlv_data.ipv6_reachs == NULL)
-	lsp->tlv_data.ipv6_reachs = list_new ();
-      lsp_tlv_fit (lsp, &tlv_data.ipv6_reachs,
-		   &lsp->tlv_data.ipv6_reachs,
-		   IPV6_REACH_LEN, area->lsp_frag_threshold,
-		   tlv_add_ipv6_reachs);
-      if (tlv_data.ipv6_reachs && listcount (tlv_data.ipv6_reachs))
-	lsp = lsp_next_frag (LSP_FRAGMENT (lsp->lsp_header->lsp_id) + 1,
-			     lsp0, area, level);
-    }
+  lsp_frags_assign (lsp0, area, level, frags, map, &tlv_data);
+  hash_clean (map, NULL);
+  hash_free (map);
+  if (keys)
+    XFREE (MTYPE_ISIS_TMP, keys);
 
-  while (tlv_data.is_neighs && listcount (tlv_data.is_neighs))
+  for (i = 0; i < LSP_FRAGS; i++)
     {
-      if (lsp->tlv_data.is_neighs == NULL)
-	lsp->tlv_data.is_neighs = list_new ();
-      lsp_tlv_fit (lsp, &tlv_data.is_neighs,
-		   &lsp->tlv_data.is_neighs,
-		   IS_NEIGHBOURS_LEN, area->lsp_frag_threshold,
-		   tlv_add_is_neighs);
-      if (tlv_data.is_neighs && listcount (tlv_data.is_neighs))
-	lsp = lsp_next_frag (LSP_FRAGMENT (lsp->lsp_header->lsp_id) + 1,
-			     lsp0, area, level);
-    }
+      if ((lsp = frags[i].lsp) == NULL)
+        continue;
+      /* The zero LSP already has the TLVs of the area in it */
+      if (i != 0)
+        {
+          stream_reset (lsp->pdu);
+          stream_forward_endp (lsp->pdu, ISIS_FIXED_HDR_LEN + ISIS_LSP_HDR_LEN);
+        }
+      for (t = 0; t < LSP_FRAG_TLVS; t++)
+        {
+          struct list *list;
 
-  while (tlv_data.te_is_neighs && listcount (tlv_data.te_is_neighs))
-    {
-      if (lsp->tlv_data.te_is_neighs == NULL)
-	lsp->tlv_data.te_is_neighs = list_new ();
-      lsp_tlv_fit (lsp, &tlv_data.te_is_neighs, &lsp->tlv_data.te_is_neighs,
-		   IS_NEIGHBOURS_LEN, area->lsp_frag_threshold,
-		   tlv_add_te_is_neighs);
-      if (tlv_data.te_is_neighs && listcount (tlv_data.te_is_neighs))
-	lsp = lsp_next_frag (LSP_FRAGMENT (lsp->lsp_header->lsp_id) + 1,
-			     lsp0, area, level);
+          list = *lsp_frag_tlv_list (&lsp->tlv_data, lsp_frag_tlvs[t]);
+          if (list && listcount (list))
+            lsp_frag_tlv_add (lsp_frag_tlvs[t], list, lsp->pdu);
+        }
+      lsp->lsp_header->pdu_len = htons (stream_get_endp (lsp->pdu));
     }
-  lsp->lsp_header->pdu_len = htons (stream_get_endp (lsp->pdu));
+  XFREE (MTYPE_ISIS_TMP, frags);
+  lsp = lsp0;
 
   free_tlvs (&tlv_data);
 
@@ -1843,7 +2332,8 @@ lsp_build (struct isis_lsp *lsp, struct isis_area *area)
 int
 lsp_generate (struct isis_area *area, int level)
 {
-  struct isis_lsp *oldlsp, *newlsp;
+  struct isis_lsp *oldlsp, *newlsp, *frag;
+  struct listnode *node;
   u_int32_t seq_num = 0;
   u_char lspid[ISIS_SYS_ID_LEN + 2];
   u_int16_t rem_lifetime, refresh_time;
@@ -1877,6 +2367,8 @@ lsp_generate (struct isis_area *area, int level)
   lsp_seqnum_update (newlsp);
   newlsp->last_generated = time(NULL);
   lsp_set_all_srmflags (newlsp);
+  for (ALL_LIST_ELEMENTS_RO (newlsp->lspu.frags, node, frag))
+    lsp_set_all_srmflags (frag);
 
   refresh_time = lsp_refresh_time (newlsp, rem_lifetime);
 
@@ -1908,7 +2400,68 @@ lsp_generate (struct isis_area *area, int level)
 }
 
 /*
- * Search own LSPs, update holding time and set SRM
+ * Whether a rebuilt frag of our own LSP is the same as its old PDU.  The
+ * sequence number is still the old one, so the checksum tells the contents
+ * apart; the octets are compared as well in case of a collision.
+ */
+static int
+lsp_frag_same (struct isis_lsp *lsp, struct stream *old)
+{
+  struct isis_link_state_hdr *old_hdr;
+  size_t len = stream_get_endp (lsp->pdu);
+
+  lsp_auth_update (lsp);
+  fletcher_checksum (STREAM_DATA (lsp->pdu) + 12, len - 12, 12);
+
+  old_hdr = (struct isis_link_state_hdr *) (STREAM_DATA (old)
+                                             + ISIS_FIXED_HDR_LEN);
+  return (stream_get_endp (old) == len
+          && old_hdr->checksum == lsp->lsp_header->checksum
+          && !memcmp (STREAM_DATA (old) + 12, STREAM_DATA (lsp->pdu) + 12,
+                      len - 12));
+}
+
+/*
+ * Gives a rebuilt frag of our own LSP a new sequence number and floods it,
+ * unless it is the same as before and can wait half a refresh time before
+ * it has to be refreshed, 300 seconds ahead of expiring.  The refresh
+ * timer is then brought forward to that point.  Returns whether the frag
+ * was reissued.
+ */
+static int
+lsp_frag_reissue (struct isis_lsp *lsp, struct stream *old,
+                  u_int16_t rem_lifetime, u_int16_t refresh_time,
+                  u_int16_t *next_refresh)
+{
+  struct isis_area *area = lsp->area;
+  u_int16_t frag_lifetime;
+
+  lsp->lsp_header->lsp_bits = lsp_bits_generate (lsp->level,
+                                                 area->overload_bit,
+                                                 area->attached_bit);
+  lsp_set_time (lsp);
+  frag_lifetime = ntohs (lsp->lsp_header->rem_lifetime);
+  if (old && lsp->lsp_header->seq_num != 0
+      && frag_lifetime >= 300 + refresh_time / 2
+      && lsp_frag_same (lsp, old))
+    {
+      if (frag_lifetime - 300 < *next_refresh)
+        *next_refresh = frag_lifetime - 300;
+      return 0;
+    }
+
+  /* Set the lifetime values of all the reissued fragments to the same
+   * value */
+  lsp->lsp_header->rem_lifetime = htons (rem_lifetime);
+  lsp_lifetime_reset (lsp);
+  lsp_inc_seqnum (lsp, 0);
+  lsp_set_all_srmflags (lsp);
+  return 1;
+}
+
+/*
+ * Search own LSPs, rebuild them, and update holding time and set SRM on
+ * the fragments that changed
  */
 static int
 lsp_regenerate (struct isis_area *area, int level)
@@ -1916,8 +2469,10 @@ lsp_regenerate (struct isis_area *area, int level)
   dict_t *lspdb;
   struct isis_lsp *lsp, *frag;
   struct listnode *node;
+  struct stream *old[LSP_FRAGS];
   u_char lspid[ISIS_SYS_ID_LEN + 2];
-  u_int16_t rem_lifetime, refresh_time;
+  u_int16_t rem_lifetime, refresh_time, next_refresh;
+  int i, reissued;
 
   if ((area == NULL) || (area->is_type & level) != level)
     return ISIS_ERROR;
@@ -1936,35 +2491,35 @@ lsp_regenerate (struct isis_area *area, int level)
       return ISIS_ERROR;
     }
 
-  lsp_clear_data (lsp);
+  /* Keep the old PDUs, to tell which fragments change */
+  memset (old, 0, sizeof (old));
+  old[0] = stream_dup (lsp->pdu);
+  for (ALL_LIST_ELEMENTS_RO (lsp->lspu.frags, node, frag))
+    old[LSP_FRAGMENT (frag->lsp_header->lsp_id)] = stream_dup (frag->pdu);
+
   lsp_build (lsp, area);
-  lsp->lsp_header->lsp_bits = lsp_bits_generate (level, area->overload_bit,
-                                                 area->attached_bit);
   rem_lifetime = lsp_rem_lifetime (area, level);
-  lsp->lsp_header->rem_lifetime = htons (rem_lifetime);
-  lsp_seqnum_update (lsp);
+  refresh_time = lsp_refresh_time (lsp, rem_lifetime);
 
-  lsp->last_generated = time (NULL);
-  lsp_set_all_srmflags (lsp);
+  next_refresh = refresh_time;
+  reissued = lsp_frag_reissue (lsp, old[0], rem_lifetime, refresh_time,
+                               &next_refresh);
   for (ALL_LIST_ELEMENTS_RO (lsp->lspu.frags, node, frag))
-    {
-      frag->lsp_header->lsp_bits = lsp_bits_generate (level,
-                                                      area->overload_bit,
-                                                      area->attached_bit);
-      /* Set the lifetime values of all the fragments to the same value,
-       * so that no fragment expires before the lsp is refreshed.
-       */
-      frag->lsp_header->rem_lifetime = htons (rem_lifetime);
-      lsp_set_all_srmflags (frag);
-    }
+    reissued += lsp_frag_reissue (frag,
+                                  old[LSP_FRAGMENT (frag->lsp_header->lsp_id)],
+                                  rem_lifetime, refresh_time, &next_refresh);
+  for (i = 0; i < LSP_FRAGS; i++)
+    if (old[i])
+      stream_free (old[i]);
+
+  lsp->last_generated = time (NULL);
 
-  refresh_time = lsp_refresh_time (lsp, rem_lifetime);
   if (level == IS_LEVEL_1)
     THREAD_TIMER_ON (master, area->t_lsp_refresh[level - 1],
-                     lsp_l1_refresh, area, refresh_time);
+                     lsp_l1_refresh, area, next_refresh);
   else if (level == IS_LEVEL_2)
     THREAD_TIMER_ON (master, area->t_lsp_refresh[level - 1],
-                     lsp_l2_refresh, area, refresh_time);
+                     lsp_l2_refresh, area, next_refresh);
   area->lsp_regenerate_pending[level - 1] = 0;
 
   if (isis->debugs & DEBUG_UPDATE_PACKETS)
@@ -1977,7 +2532,10 @@ lsp_regenerate (struct isis_area *area, int level)
                   ntohl (lsp->lsp_header->seq_num),
                   ntohs (lsp->lsp_header->checksum),
                   ntohs (lsp->lsp_header->rem_lifetime),
-                  refresh_time);
+                  next_refresh);
+      zlog_debug ("ISIS-Upd (%s): Reissued %d of %d L%d LSP fragments",
+                  area->area_tag, reissued,
+                  listcount (lsp->lspu.frags) + 1, level);
     }
   sched_debug("ISIS (%s): Rebuilt L%d LSP. Set triggered regenerate to non-pending.",
               area->area_tag, level);
@@ -2371,6 +2929,7 @@ lsp_regenerate_pseudo (struct isis_circuit *circuit, int level)
                                                  circuit->area->attached_bit);
   rem_lifetime = lsp_rem_lifetime (circuit->area, level);
   lsp->lsp_header->rem_lifetime = htons (rem_lifetime);
+  lsp_lifetime_reset (lsp);
   lsp_inc_seqnum (lsp, 0);
   lsp->last_generated = time (NULL);
   lsp_set_all_srmflags (lsp);
@@ -2549,121 +3108,6 @@ lsp_regenerate_schedule_pseudo (struct isis_circuit *circuit, int level)
   return ISIS_OK;
 }
 
-/*
- * Walk through LSPs for an area
- *  - set remaining lifetime
- *  - set LSPs with SRMflag set for sending
- */
-int
-lsp_tick (struct thread *thread)
-{
-  struct isis_area *area;
-  struct isis_circuit *circuit;
-  struct isis_lsp *lsp;
-  struct list *lsp_list;
-  struct listnode *lspnode, *cnode;
-  dnode_t *dnode, *dnode_next;
-  int level;
-  u_int16_t rem_lifetime;
-
-  lsp_list = list_new ();
-
-  area = THREAD_ARG (thread);
-  assert (area);
-  area->t_tick = NULL;
-  THREAD_TIMER_ON (master, area->t_tick, lsp_tick, area, 1);
-
-  /*
-   * Build a list of LSPs with (any) SRMflag set
-   * and removed the ones that have aged out
-   */
-  for (level = 0; level < ISIS_LEVELS; level++)
-    {
-      if (area->lspdb[level] && dict_count (area->lspdb[level]) > 0)
-        {
-          for (dnode = dict_first (area->lspdb[level]);
-               dnode != NULL; dnode = dnode_next)
-            {
-              dnode_next = dict_next (area->lspdb[level], dnode);
-              lsp = dnode_get (dnode);
-
-              /*
-               * The lsp rem_lifetime is kept at 0 for MaxAge or
-               * ZeroAgeLifetime depending on explicit purge or
-               * natural age out. So schedule spf only once when
-               * the first time rem_lifetime becomes 0.
-               */
-              rem_lifetime = ntohs(lsp->lsp_header->rem_lifetime);
-              lsp_set_time (lsp);
-
-              /*
-               * Schedule may run spf which should be done only after
-               * the lsp rem_lifetime becomes 0 for the first time.
-               * ISO 10589 - 7.3.16.4 first paragraph.
-               */
-              if (rem_lifetime == 1 && lsp->lsp_header->seq_num != 0)
-                {
-                  /* 7.3.16.4 a) set SRM flags on all */
-                  lsp_set_all_srmflags (lsp);
-                  /* 7.3.16.4 b) retain only the header FIXME  */
-                  /* 7.3.16.4 c) record the time to purge FIXME */
-                  /* run/schedule spf */
-                  /* isis_spf_schedule is called inside lsp_destroy() below;
-                   * so it is not needed here. */
-                  /* isis_spf_schedule (lsp->area, lsp->level); */
-                }
-
-              if (lsp->age_out == 0)
-                {
-                  zlog_debug ("ISIS-Upd (%s): L%u LSP %s seq 0x%08x aged out",
-                              area->area_tag,
-                              lsp->level,
-                              rawlspid_print (lsp->lsp_header->lsp_id),
-                              ntohl (lsp->lsp_header->seq_num));
-                  lsp_destroy (lsp);
-                  lsp = NULL;
-                  dict_delete_free (area->lspdb[level], dnode);
-                }
-              else if (flags_any_set (lsp->SRMflags))
-                listnode_add (lsp_list, lsp);
-            }
-
-          /*
-           * Send LSPs on circuits indicated by the SRMflags
-           */
-          if (listcount (lsp_list) > 0)
-            {
-              for (ALL_LIST_ELEMENTS_RO (area->circuit_list, cnode, circuit))
-                {
-                  int diff = time (NULL) - circuit->lsp_queue_last_cleared;
-                  if (circuit->lsp_queue == NULL ||
-                      diff < MIN_LSP_TRANS_INTERVAL)
-                    continue;
-                  for (ALL_LIST_ELEMENTS_RO (lsp_list, lspnode, lsp))
-                    {
-                      if (circuit->upadjcount[lsp->level - 1] &&
-                          ISIS_CHECK_FLAG (lsp->SRMflags, circuit))
-                        {
-                          /* Add the lsp only if it is not already in lsp
-                           * queue */
-                          if (! listnode_lookup (circuit->lsp_queue, lsp))
-                            {
-                              listnode_add (circuit->lsp_queue, lsp);
-                              thread_add_event (master, send_lsp, circuit, 0);
-                            }
-                        }
-                    }
-                }
-              list_delete_all_node (lsp_list);
-            }
-        }
-    }
-
-  list_delete (lsp_list);
-
-  return ISIS_OK;
-}
-
 void
 lsp_purge_pseudo (u_char * id, struct isis_circuit *circuit, int level)
 {
@@ -2692,6 +3136,7 @@ lsp_purge_pseudo (u_char * id, struct isis_circuit *circuit, int level)
   lsp->lsp_header->lsp_bits = lsp_bits;
   lsp->level = level;
   lsp->age_out = lsp->area->max_lsp_lifetime[level-1];
+  lsp_lifetime_reset (lsp);
   stream_forward_endp (lsp->pdu, ISIS_FIXED_HDR_LEN + ISIS_LSP_HDR_LEN);
 
   /*
@@ -2738,6 +3183,8 @@ lsp_purge_non_exist (int level,
    * Set the remaining lifetime to 0
    */
   lsp->lsp_header->rem_lifetime = 0;
+  lsp->age_out = ZERO_AGE_LIFETIME;
+  lsp_lifetime_reset (lsp);
 
   /*
    * Add and update the authentication info if its present
@@ -2763,6 +3210,34 @@ lsp_purge_non_exist (int level,
   return;
 }
 
+/*
+ * Queues an LSP for transmission on a circuit, if it has an adjacency up
+ * on the level of the LSP to send it to.  The circuit's send_lsp thread
+ * works through the queue, a burst at a time.
+ */
+static void
+lsp_queue (struct isis_lsp *lsp, struct isis_circuit *circuit)
+{
+  if (circuit->lsp_queue == NULL
+      || !(lsp->level & circuit->is_type)
+      || circuit->upadjcount[lsp->level - 1] == 0
+      || ISIS_CHECK_FLAG (lsp->TXQflags, circuit))
+    return;
+
+  listnode_add (circuit->lsp_queue, lsp);
+  ISIS_SET_FLAG (lsp->TXQflags, circuit);
+  if (!circuit->t_send_lsp)
+    circuit->t_send_lsp = thread_add_event (master, send_lsp, circuit, 0);
+}
+
+void lsp_set_srmflag (struct isis_lsp *lsp, struct isis_circuit *circuit)
+{
+  assert (lsp);
+
+  ISIS_SET_FLAG (lsp->SRMflags, circuit);
+  lsp_queue (lsp, circuit);
+}
+
 void lsp_set_all_srmflags (struct isis_lsp *lsp)
 {
   struct listnode *node;
@@ -2778,6 +3253,26 @@ void lsp_set_all_srmflags (struct isis_lsp *lsp)
       for (ALL_LIST_ELEMENTS_RO (circuit_list, node, circuit))
         {
           ISIS_SET_FLAG(lsp->SRMflags, circuit);
+          lsp_queue (lsp, circuit);
         }
     }
 }
+
+void
+lsp_flood_circuit (struct isis_circuit *circuit, int level)
+{
+  dict_t *lspdb;
+  dnode_t *dnode;
+  struct isis_lsp *lsp;
+
+  lspdb = circuit->area->lspdb[level - 1];
+  if (lspdb == NULL)
+    return;
+
+  for (dnode = dict_first (lspdb); dnode; dnode = dict_next (lspdb, dnode))
+    {
+      lsp = dnode_get (dnode);
+      if (ISIS_CHECK_FLAG (lsp->SRMflags, circuit))
+        lsp_queue (lsp, circuit);
+    }
+}
@@ -41,6 +41,7 @@ struct isis_lsp
   u_int32_t auth_tlv_offset;    /* authentication TLV position in the pdu */
   u_int32_t SRMflags[ISIS_MAX_CIRCUITS];
   u_int32_t SSNflags[ISIS_MAX_CIRCUITS];
+  u_int32_t TXQflags[ISIS_MAX_CIRCUITS];	/* on the circuit's lsp_queue */
   int level;			/* L1 or L2? */
   int scheduled;		/* scheduled for sending */
   time_t installed;
@@ -48,13 +49,14 @@ struct isis_lsp
   int own_lsp;
   /* used for 60 second counting when rem_lifetime is zero */
   int age_out;
+  time_t last_aged;		/* rem_lifetime and age_out are as of then */
+  struct thread *t_lifetime;	/* lifetime or age_out running out */
   struct isis_area *area;
   struct tlvs tlv_data;		/* Simplifies TLV access */
 };
 
 dict_t *lsp_db_init (void);
 void lsp_db_destroy (dict_t * lspdb);
-int lsp_tick (struct thread *thread);
 
 int lsp_generate (struct isis_area *area, int level);
 int lsp_regenerate_schedule (struct isis_area *area, int level,
@@ -103,6 +105,7 @@ int lsp_compare (char *areatag, struct isis_lsp *lsp, u_int32_t seq_num,
 void lsp_update (struct isis_lsp *lsp, struct stream *stream,
                  struct isis_area *area, int level);
 void lsp_inc_seqnum (struct isis_lsp *lsp, u_int32_t seq_num);
+void lsp_set_time (struct isis_lsp *lsp);
 void lsp_print (struct isis_lsp *lsp, struct vty *vty, char dynhost);
 void lsp_print_detail (struct isis_lsp *lsp, struct vty *vty, char dynhost);
 int lsp_print_all (struct vty *vty, dict_t * lspdb, char detail,
@@ -113,5 +116,12 @@ void lsp_te_tlv_fit (struct isis_lsp *lsp, struct list **from,
 
 /* sets SRMflags for all active circuits of an lsp */
 void lsp_set_all_srmflags (struct isis_lsp *lsp);
+/* sets the SRMflag of an lsp for one circuit */
+void lsp_set_srmflag (struct isis_lsp *lsp, struct isis_circuit *circuit);
+/* queues the lsps with SRMflag set on a circuit that got an adjacency */
+void lsp_flood_circuit (struct isis_circuit *circuit, int level);
+/* views the entries of one type of TLV in the pdu of an lsp */
+void lsp_tlv_view_init (struct tlv_view *view, struct stream *pdu,
+                        u_char type);
 
 #endif /* ISIS_LSP */
@@ -38,6 +38,8 @@ DEFINE_MTYPE(ISISD, ISIS_TLV,           "ISIS TLV")
 DEFINE_MTYPE(ISISD, ISIS_DYNHN,         "ISIS dyn hostname")
 DEFINE_MTYPE(ISISD, ISIS_SPFTREE,       "ISIS SPFtree")
 DEFINE_MTYPE(ISISD, ISIS_VERTEX,        "ISIS vertex")
+DEFINE_MTYPE(ISISD, ISIS_SPF_TENT,      "ISIS SPF TENT")
+DEFINE_MTYPE_SLAB(ISISD, ISIS_SPF_EDGE, "ISIS SPF edge")
 DEFINE_MTYPE(ISISD, ISIS_ROUTE_INFO,    "ISIS route info")
 DEFINE_MTYPE(ISISD, ISIS_NEXTHOP,       "ISIS nexthop")
 DEFINE_MTYPE(ISISD, ISIS_NEXTHOP6,      "ISIS nexthop6")
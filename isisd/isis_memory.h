@@ -37,6 +37,8 @@ DECLARE_MTYPE(ISIS_TLV)
 DECLARE_MTYPE(ISIS_DYNHN)
 DECLARE_MTYPE(ISIS_SPFTREE)
 DECLARE_MTYPE(ISIS_VERTEX)
+DECLARE_MTYPE(ISIS_SPF_TENT)
+DECLARE_MTYPE(ISIS_SPF_EDGE)
 DECLARE_MTYPE(ISIS_ROUTE_INFO)
 DECLARE_MTYPE(ISIS_NEXTHOP)
 DECLARE_MTYPE(ISIS_NEXTHOP6)
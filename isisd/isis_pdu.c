@@ -1531,7 +1531,7 @@ dontcheckadj:
 		}		/* 7.3.16.4 b) 3) */
 	      else
 		{
-		  ISIS_SET_FLAG (lsp->SRMflags, circuit);
+		  lsp_set_srmflag (lsp, circuit);
 		  ISIS_CLEAR_FLAG (lsp->SSNflags, circuit);
 		}
 	    }
@@ -1545,7 +1545,7 @@ dontcheckadj:
                 }
               else
                 {
-                  ISIS_SET_FLAG (lsp->SRMflags, circuit);
+                  lsp_set_srmflag (lsp, circuit);
                   ISIS_CLEAR_FLAG (lsp->SSNflags, circuit);
                 }
               if (isis->debugs & DEBUG_UPDATE_PACKETS)
@@ -1641,7 +1641,7 @@ dontcheckadj:
       /* 7.3.15.1 e) 3) LSP older than the one in db */
       else
 	{
-	  ISIS_SET_FLAG (lsp->SRMflags, circuit);
+	  lsp_set_srmflag (lsp, circuit);
 	  ISIS_CLEAR_FLAG (lsp->SSNflags, circuit);
 	}
     }
@@ -1668,9 +1668,12 @@ process_snp (int snp_type, int level, struct isis_circuit *circuit,
   uint32_t found = 0, expected = 0, auth_tlv_offset = 0;
   struct isis_lsp *lsp;
   struct lsp_entry *entry;
-  struct listnode *node, *nnode;
+  struct listnode *node;
   struct listnode *node2, *nnode2;
   struct tlvs tlvs;
+  struct tlv_view view;
+  u_char *entries;
+  int entries_len;
   struct list *lsp_list = NULL;
   struct isis_passwd *passwd;
 
@@ -1793,10 +1796,11 @@ process_snp (int snp_type, int level, struct isis_circuit *circuit,
 
   memset (&tlvs, 0, sizeof (struct tlvs));
 
-  /* parse the SNP */
-  expected |= TLVFLAG_LSP_ENTRIES;
+  /* parse the SNP, the LSP entries are walked in place below */
   expected |= TLVFLAG_AUTH_INFO;
 
+  entries = STREAM_PNT (circuit->rcv_stream);
+  entries_len = pdu_len - stream_get_getp (circuit->rcv_stream);
   auth_tlv_offset = stream_get_getp (circuit->rcv_stream);
   retval = parse_tlvs (circuit->area->area_tag,
 		       STREAM_PNT (circuit->rcv_stream),
@@ -1840,77 +1844,73 @@ process_snp (int snp_type, int level, struct isis_circuit *circuit,
 		  circuit->area->area_tag,
 		  level,
 		  typechar, snpa_print (ssnpa), circuit->interface->name);
-      if (tlvs.lsp_entries)
+      tlv_view_init (&view, LSP_ENTRIES, entries, entries_len);
+      while ((entry = tlv_view_next (&view)))
 	{
-	  for (ALL_LIST_ELEMENTS_RO (tlvs.lsp_entries, node, entry))
-	  {
-	    zlog_debug ("ISIS-Snp (%s):         %cSNP entry %s, seq 0x%08x,"
-			" cksum 0x%04x, lifetime %us",
-			circuit->area->area_tag,
-			typechar,
-			rawlspid_print (entry->lsp_id),
-			ntohl (entry->seq_num),
-			ntohs (entry->checksum), ntohs (entry->rem_lifetime));
-	  }
+	  zlog_debug ("ISIS-Snp (%s):         %cSNP entry %s, seq 0x%08x,"
+		      " cksum 0x%04x, lifetime %us",
+		      circuit->area->area_tag,
+		      typechar,
+		      rawlspid_print (entry->lsp_id),
+		      ntohl (entry->seq_num),
+		      ntohs (entry->checksum), ntohs (entry->rem_lifetime));
 	}
     }
 
   /* 7.3.15.2 b) Actions on LSP_ENTRIES reported */
-  if (tlvs.lsp_entries)
+  tlv_view_init (&view, LSP_ENTRIES, entries, entries_len);
+  while ((entry = tlv_view_next (&view)))
     {
-      for (ALL_LIST_ELEMENTS_RO (tlvs.lsp_entries, node, entry))
-      {
-	lsp = lsp_search (entry->lsp_id, circuit->area->lspdb[level - 1]);
-	own_lsp = !memcmp (entry->lsp_id, isis->sysid, ISIS_SYS_ID_LEN);
-	if (lsp)
-	  {
-	    /* 7.3.15.2 b) 1) is this LSP newer */
-	    cmp = lsp_compare (circuit->area->area_tag, lsp, entry->seq_num,
-			       entry->checksum, entry->rem_lifetime);
-	    /* 7.3.15.2 b) 2) if it equals, clear SRM on p2p */
-	    if (cmp == LSP_EQUAL)
-	      {
-		/* if (circuit->circ_type != CIRCUIT_T_BROADCAST) */
-	        ISIS_CLEAR_FLAG (lsp->SRMflags, circuit);
-	      }
-	    /* 7.3.15.2 b) 3) if it is older, clear SSN and set SRM */
-	    else if (cmp == LSP_OLDER)
-	      {
-		ISIS_CLEAR_FLAG (lsp->SSNflags, circuit);
-		ISIS_SET_FLAG (lsp->SRMflags, circuit);
-	      }
-	    /* 7.3.15.2 b) 4) if it is newer, set SSN and clear SRM on p2p */
-	    else
-	      {
-		if (own_lsp)
-		  {
-		    lsp_inc_seqnum (lsp, ntohl (entry->seq_num));
-		    ISIS_SET_FLAG (lsp->SRMflags, circuit);
-		  }
-		else
-		  {
-		    ISIS_SET_FLAG (lsp->SSNflags, circuit);
-		    /* if (circuit->circ_type != CIRCUIT_T_BROADCAST) */
-		    ISIS_CLEAR_FLAG (lsp->SRMflags, circuit);
-		  }
-	      }
-	  }
-	else
-	  {
-	    /* 7.3.15.2 b) 5) if it was not found, and all of those are not 0, 
-	     * insert it and set SSN on it */
-	    if (entry->rem_lifetime && entry->checksum && entry->seq_num &&
-		memcmp (entry->lsp_id, isis->sysid, ISIS_SYS_ID_LEN))
-	      {
-		lsp = lsp_new(circuit->area, entry->lsp_id,
-			      ntohs(entry->rem_lifetime),
-			      0, 0, entry->checksum, level);
-		lsp_insert (lsp, circuit->area->lspdb[level - 1]);
-		ISIS_FLAGS_CLEAR_ALL (lsp->SRMflags);
-		ISIS_SET_FLAG (lsp->SSNflags, circuit);
-	      }
-	  }
-      }
+      lsp = lsp_search (entry->lsp_id, circuit->area->lspdb[level - 1]);
+      own_lsp = !memcmp (entry->lsp_id, isis->sysid, ISIS_SYS_ID_LEN);
+      if (lsp)
+	{
+	  /* 7.3.15.2 b) 1) is this LSP newer */
+	  cmp = lsp_compare (circuit->area->area_tag, lsp, entry->seq_num,
+			     entry->checksum, entry->rem_lifetime);
+	  /* 7.3.15.2 b) 2) if it equals, clear SRM on p2p */
+	  if (cmp == LSP_EQUAL)
+	    {
+	      /* if (circuit->circ_type != CIRCUIT_T_BROADCAST) */
+	      ISIS_CLEAR_FLAG (lsp->SRMflags, circuit);
+	    }
+	  /* 7.3.15.2 b) 3) if it is older, clear SSN and set SRM */
+	  else if (cmp == LSP_OLDER)
+	    {
+	      ISIS_CLEAR_FLAG (lsp->SSNflags, circuit);
+	      lsp_set_srmflag (lsp, circuit);
+	    }
+	  /* 7.3.15.2 b) 4) if it is newer, set SSN and clear SRM on p2p */
+	  else
+	    {
+	      if (own_lsp)
+		{
+		  lsp_inc_seqnum (lsp, ntohl (entry->seq_num));
+		  lsp_set_srmflag (lsp, circuit);
+		}
+	      else
+		{
+		  ISIS_SET_FLAG (lsp->SSNflags, circuit);
+		  /* if (circuit->circ_type != CIRCUIT_T_BROADCAST) */
+		  ISIS_CLEAR_FLAG (lsp->SRMflags, circuit);
+		}
+	    }
+	}
+      else
+	{
+	  /* 7.3.15.2 b) 5) if it was not found, and all of those are not 0, 
+	   * insert it and set SSN on it */
+	  if (entry->rem_lifetime && entry->checksum && entry->seq_num &&
+	      memcmp (entry->lsp_id, isis->sysid, ISIS_SYS_ID_LEN))
+	    {
+	      lsp = lsp_new(circuit->area, entry->lsp_id,
+			    ntohs(entry->rem_lifetime),
+			    0, 0, entry->checksum, level);
+	      lsp_insert (lsp, circuit->area->lspdb[level - 1]);
+	      ISIS_FLAGS_CLEAR_ALL (lsp->SRMflags);
+	      ISIS_SET_FLAG (lsp->SSNflags, circuit);
+	    }
+	}
     }
 
   /* 7.3.15.2 c) on CSNP set SRM for all in range which were not reported */
@@ -1925,23 +1925,21 @@ process_snp (int snp_type, int level, struct isis_circuit *circuit,
 				 lsp_list, circuit->area->lspdb[level - 1]);
 
       /* Fixme: Find a better solution */
-      if (tlvs.lsp_entries)
+      tlv_view_init (&view, LSP_ENTRIES, entries, entries_len);
+      while ((entry = tlv_view_next (&view)))
 	{
-	  for (ALL_LIST_ELEMENTS (tlvs.lsp_entries, node, nnode, entry))
+	  for (ALL_LIST_ELEMENTS (lsp_list, node2, nnode2, lsp))
 	  {
-	    for (ALL_LIST_ELEMENTS (lsp_list, node2, nnode2, lsp))
-	    {
-	      if (lsp_id_cmp (lsp->lsp_header->lsp_id, entry->lsp_id) == 0)
-		{
-		  list_delete_node (lsp_list, node2);
-		  break;
-		}
-	    }
+	    if (lsp_id_cmp (lsp->lsp_header->lsp_id, entry->lsp_id) == 0)
+	      {
+		list_delete_node (lsp_list, node2);
+		break;
+	      }
 	  }
 	}
       /* on remaining LSPs we set SRM (neighbor knew not of) */
       for (ALL_LIST_ELEMENTS_RO (lsp_list, node, lsp))
-	ISIS_SET_FLAG (lsp->SRMflags, circuit);
+	lsp_set_srmflag (lsp, circuit);
       /* lets free it */
       list_delete (lsp_list);
 
@@ -3022,45 +3020,12 @@ send_l2_psnp (struct thread *thread)
 /*
  * ISO 10589 - 7.3.14.3
  */
-int
-send_lsp (struct thread *thread)
+static int
+send_lsp_pdu (struct isis_circuit *circuit, struct isis_lsp *lsp)
 {
-  struct isis_circuit *circuit;
-  struct isis_lsp *lsp;
-  struct listnode *node;
   int clear_srm = 1;
   int retval = ISIS_OK;
 
-  circuit = THREAD_ARG (thread);
-  assert (circuit);
-
-  if (!circuit->lsp_queue)
-    return ISIS_OK;
-
-  node = listhead (circuit->lsp_queue);
-
-  /*
-   * Handle case where there are no LSPs on the queue. This can
-   * happen, for instance, if an adjacency goes down before this
-   * thread gets a chance to run.
-   */
-  if (!node)
-    return ISIS_OK;
-
-  /*
-   * Delete LSP from lsp_queue. If it's still in queue, it is assumed
-   * as 'transmit pending', but send_lsp may never be called again.
-   * Retry will happen because SRM flag will not be cleared.
-   */
-  lsp = listgetdata(node);
-  list_delete_node (circuit->lsp_queue, node);
-
-  /* Set the last-cleared time if the queue is empty. */
-  /* TODO: Is is possible that new lsps keep being added to the queue
-   * that the queue is never empty? */
-  if (list_isempty (circuit->lsp_queue))
-    circuit->lsp_queue_last_cleared = time (NULL);
-
   if (circuit->state != C_STATE_UP || circuit->is_passive == 1)
     goto out;
 
@@ -3097,7 +3062,8 @@ send_lsp (struct thread *thread)
       goto out;
     }
 
-  /* copy our lsp to the send buffer */
+  /* copy our lsp to the send buffer, with its lifetime up to date */
+  lsp_set_time (lsp);
   stream_copy (circuit->snd_stream, lsp->pdu);
 
   if (isis->debugs & DEBUG_UPDATE_PACKETS)
@@ -3142,6 +3108,82 @@ out:
   return retval;
 }
 
+/*
+ * Requeues the LSPs sent on a circuit whose SRM flag is still set: on a
+ * point-to-point circuit, those not acknowledged yet.
+ */
+static int
+send_lsp_retransmit (struct thread *thread)
+{
+  struct isis_circuit *circuit;
+  struct isis_lsp *lsp;
+  struct listnode *node;
+
+  circuit = THREAD_ARG (thread);
+  assert (circuit);
+  circuit->t_lsp_retransmit = NULL;
+
+  if (!circuit->lsp_retransmit)
+    return ISIS_OK;
+
+  for (ALL_LIST_ELEMENTS_RO (circuit->lsp_retransmit, node, lsp))
+    if (ISIS_CHECK_FLAG (lsp->SRMflags, circuit))
+      lsp_set_srmflag (lsp, circuit);
+  list_delete_all_node (circuit->lsp_retransmit);
+
+  return ISIS_OK;
+}
+
+/*
+ * Sends a burst of LSPs off the head of the circuit's lsp_queue, and
+ * comes back for the rest after LSP_TX_INTERVAL.
+ */
+int
+send_lsp (struct thread *thread)
+{
+  struct isis_circuit *circuit;
+  struct isis_lsp *lsp;
+  struct listnode *node;
+  int count = 0;
+  int retval = ISIS_OK;
+
+  circuit = THREAD_ARG (thread);
+  assert (circuit);
+  circuit->t_send_lsp = NULL;
+
+  if (!circuit->lsp_queue)
+    return ISIS_OK;
+
+  while (count < LSP_TX_BURST && (node = listhead (circuit->lsp_queue)))
+    {
+      lsp = listgetdata (node);
+      list_delete_node (circuit->lsp_queue, node);
+      ISIS_CLEAR_FLAG (lsp->TXQflags, circuit);
+
+      /* The SRM flag may have been cleared since the LSP was queued. */
+      if (!ISIS_CHECK_FLAG (lsp->SRMflags, circuit))
+        continue;
+
+      retval = send_lsp_pdu (circuit, lsp);
+      count++;
+
+      /* Sent again, unless the SRM flag is cleared in the meantime. */
+      if (ISIS_CHECK_FLAG (lsp->SRMflags, circuit))
+        {
+          listnode_add (circuit->lsp_retransmit, lsp);
+          THREAD_TIMER_ON (master, circuit->t_lsp_retransmit,
+                           send_lsp_retransmit, circuit,
+                           MIN_LSP_TRANS_INTERVAL);
+        }
+    }
+
+  if (!list_isempty (circuit->lsp_queue))
+    THREAD_TIMER_MSEC_ON (master, circuit->t_send_lsp, send_lsp, circuit,
+                          LSP_TX_INTERVAL);
+
+  return retval;
+}
+
 int
 ack_lsp (struct isis_link_state_hdr *hdr, struct isis_circuit *circuit,
 	 int level)
@@ -630,6 +630,41 @@ isis_route_validate (struct isis_area *area)
   return;
 }
 
+/* Propagate the route for a single prefix into the RIB, as
+ * isis_route_validate does for all of them after a partial SPF run.  In
+ * an L1L2 area the L1 route is preferred, as in the merge above. */
+void
+isis_route_validate_prefix (struct isis_area *area, struct prefix *prefix)
+{
+  struct route_table *table = NULL;
+  struct route_node *rnode;
+  struct isis_route_info *rinfo = NULL;
+  int level;
+
+  for (level = ISIS_LEVEL1; level <= ISIS_LEVEL2; level++)
+    {
+      if (!(area->is_type & level))
+        continue;
+      if (prefix->family == AF_INET)
+        table = area->route_table[level - 1];
+      else
+        table = area->route_table6[level - 1];
+      rnode = route_node_lookup (table, prefix);
+      if (rnode == NULL)
+        continue;
+      rinfo = rnode->info;
+      route_unlock_node (rnode);
+      if (rinfo)
+        break;
+    }
+  if (rinfo == NULL)
+    return;
+
+  isis_zebra_route_update (prefix, rinfo);
+  if (!CHECK_FLAG (rinfo->flag, ISIS_ROUTE_FLAG_ACTIVE))
+    isis_route_delete (prefix, table);
+}
+
 void
 isis_route_invalidate_table (struct isis_area *area, struct route_table *table)
 {
@@ -653,3 +688,26 @@ isis_route_invalidate (struct isis_area *area)
   if (area->is_type & IS_LEVEL_2)
     isis_route_invalidate_table (area, area->route_table[1]);
 }
+
+/* Make the route for a single prefix inactive, before SPF computes it
+ * again. */
+void
+isis_route_invalidate_prefix (struct isis_area *area, int level,
+                              struct prefix *prefix)
+{
+  struct route_table *table;
+  struct route_node *rode;
+  struct isis_route_info *rinfo;
+
+  if (prefix->family == AF_INET)
+    table = area->route_table[level - 1];
+  else
+    table = area->route_table6[level - 1];
+  rode = route_node_lookup (table, prefix);
+  if (rode == NULL)
+    return;
+  rinfo = rode->info;
+  if (rinfo)
+    UNSET_FLAG (rinfo->flag, ISIS_ROUTE_FLAG_ACTIVE);
+  route_unlock_node (rode);
+}
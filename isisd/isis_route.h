@@ -59,8 +59,12 @@ struct isis_route_info *isis_route_create (struct prefix *prefix,
 					   struct isis_area *area, int level);
 
 void isis_route_validate (struct isis_area *area);
+void isis_route_validate_prefix (struct isis_area *area,
+                                 struct prefix *prefix);
 void isis_route_invalidate_table (struct isis_area *area,
                                   struct route_table *table);
 void isis_route_invalidate (struct isis_area *area);
+void isis_route_invalidate_prefix (struct isis_area *area, int level,
+                                   struct prefix *prefix);
 
 #endif /* _ZEBRA_ISIS_ROUTE_H */
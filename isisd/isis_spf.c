@@ -31,6 +31,7 @@
 #include "memory.h"
 #include "prefix.h"
 #include "hash.h"
+#include "jhash.h"
 #include "if.h"
 #include "table.h"
 
@@ -179,13 +180,10 @@ vid2string (struct isis_vertex *vertex, char * buff, int size)
   return (char *) buff;
 }
 
-static struct isis_vertex *
-isis_vertex_new (void *id, enum vertextype vtype)
+static void
+isis_vertex_id_init (struct isis_vertex *vertex, void *id,
+		     enum vertextype vtype)
 {
-  struct isis_vertex *vertex;
-
-  vertex = XCALLOC (MTYPE_ISIS_VERTEX, sizeof (struct isis_vertex));
-
   vertex->type = vtype;
   switch (vtype)
     {
@@ -209,7 +207,17 @@ isis_vertex_new (void *id, enum vertextype vtype)
     default:
       zlog_err ("WTF!");
     }
+}
 
+static struct isis_vertex *
+isis_vertex_new (void *id, enum vertextype vtype)
+{
+  struct isis_vertex *vertex;
+
+  vertex = XCALLOC (MTYPE_ISIS_VERTEX, sizeof (struct isis_vertex));
+
+  isis_vertex_id_init (vertex, id, vtype);
+  vertex->tent_index = -1;
   vertex->Adj_N = list_new ();
   vertex->parents = list_new ();
   vertex->children = list_new ();
@@ -217,9 +225,66 @@ isis_vertex_new (void *id, enum vertextype vtype)
   return vertex;
 }
 
+/* tent_index of a vertex a partial run has taken off the tree */
+#define ISIS_VERTEX_DETACHED -2
+
+/*
+ * Every path offered to a vertex is kept as an edge, so that a partial run
+ * can offer them again to the vertices it has to compute again.
+ */
+struct isis_spf_edge
+{
+  struct isis_vertex *from;
+  struct isis_adjacency *adj;	/* set for the adjacencies of the root */
+  u_int32_t metric;
+  struct isis_spf_edge *next_in, **prev_in;
+  struct isis_spf_edge *next_out, **prev_out;
+};
+
+static void
+isis_spf_edge_add (struct isis_vertex *from, struct isis_vertex *to,
+		   u_int32_t metric, struct isis_adjacency *adj)
+{
+  struct isis_spf_edge *edge;
+
+  edge = XCALLOC (MTYPE_ISIS_SPF_EDGE, sizeof (struct isis_spf_edge));
+  edge->from = from;
+  edge->adj = adj;
+  edge->metric = metric;
+
+  edge->next_in = to->edges_in;
+  if (edge->next_in)
+    edge->next_in->prev_in = &edge->next_in;
+  edge->prev_in = &to->edges_in;
+  to->edges_in = edge;
+
+  edge->next_out = from->edges_out;
+  if (edge->next_out)
+    edge->next_out->prev_out = &edge->next_out;
+  edge->prev_out = &from->edges_out;
+  from->edges_out = edge;
+}
+
+static void
+isis_spf_edge_del (struct isis_spf_edge *edge)
+{
+  *edge->prev_in = edge->next_in;
+  if (edge->next_in)
+    edge->next_in->prev_in = edge->prev_in;
+  *edge->prev_out = edge->next_out;
+  if (edge->next_out)
+    edge->next_out->prev_out = edge->prev_out;
+  XFREE (MTYPE_ISIS_SPF_EDGE, edge);
+}
+
 static void
 isis_vertex_del (struct isis_vertex *vertex)
 {
+  while (vertex->edges_in)
+    isis_spf_edge_del (vertex->edges_in);
+  while (vertex->edges_out)
+    isis_spf_edge_del (vertex->edges_out);
+
   list_delete (vertex->Adj_N);
   vertex->Adj_N = NULL;
   list_delete (vertex->parents);
@@ -233,6 +298,160 @@ isis_vertex_del (struct isis_vertex *vertex)
   return;
 }
 
+/* The vertices of a tree are hashed on the same bits of their id that
+ * tell them apart. */
+static unsigned int
+isis_vertex_hash_key (void *arg)
+{
+  struct isis_vertex *vertex = arg;
+  struct prefix *p;
+
+  switch (vertex->type)
+    {
+    case VTYPE_PSEUDO_IS:
+    case VTYPE_PSEUDO_TE_IS:
+      return jhash (vertex->N.id, ISIS_SYS_ID_LEN + 1, vertex->type);
+    case VTYPE_IPREACH_INTERNAL:
+    case VTYPE_IPREACH_EXTERNAL:
+    case VTYPE_IPREACH_TE:
+    case VTYPE_IP6REACH_INTERNAL:
+    case VTYPE_IP6REACH_EXTERNAL:
+      p = &vertex->N.prefix;
+      return jhash (&p->u.prefix, PSIZE (p->prefixlen),
+		    (vertex->type << 16) | (p->family << 8) | p->prefixlen);
+    default:
+      return jhash (vertex->N.id, ISIS_SYS_ID_LEN, vertex->type);
+    }
+}
+
+static int
+isis_vertex_hash_cmp (const void *arg1, const void *arg2)
+{
+  const struct isis_vertex *v1 = arg1;
+  const struct isis_vertex *v2 = arg2;
+  const struct prefix *p1, *p2;
+
+  if (v1->type != v2->type)
+    return 0;
+  switch (v1->type)
+    {
+    case VTYPE_PSEUDO_IS:
+    case VTYPE_PSEUDO_TE_IS:
+      return memcmp (v1->N.id, v2->N.id, ISIS_SYS_ID_LEN + 1) == 0;
+    case VTYPE_IPREACH_INTERNAL:
+    case VTYPE_IPREACH_EXTERNAL:
+    case VTYPE_IPREACH_TE:
+    case VTYPE_IP6REACH_INTERNAL:
+    case VTYPE_IP6REACH_EXTERNAL:
+      p1 = &v1->N.prefix;
+      p2 = &v2->N.prefix;
+      return (p1->family == p2->family && p1->prefixlen == p2->prefixlen
+	      && memcmp (&p1->u.prefix, &p2->u.prefix,
+			 PSIZE (p1->prefixlen)) == 0);
+    default:
+      return memcmp (v1->N.id, v2->N.id, ISIS_SYS_ID_LEN) == 0;
+    }
+}
+
+/*
+ * TENT is a binary heap, ordered by cost, then by vertextype, then by
+ * the order the vertices were added in.
+ */
+static int
+isis_tent_less (struct isis_vertex *v1, struct isis_vertex *v2)
+{
+  if (v1->d_N != v2->d_N)
+    return v1->d_N < v2->d_N;
+  if (v1->type != v2->type)
+    return v1->type < v2->type;
+  return v1->serial < v2->serial;
+}
+
+static void
+isis_tent_set (struct isis_spftree *spftree, unsigned int i,
+	       struct isis_vertex *vertex)
+{
+  spftree->tents[i] = vertex;
+  vertex->tent_index = i;
+}
+
+static void
+isis_tent_up (struct isis_spftree *spftree, unsigned int i)
+{
+  struct isis_vertex *vertex = spftree->tents[i];
+  unsigned int parent;
+
+  while (i > 0)
+    {
+      parent = (i - 1) / 2;
+      if (!isis_tent_less (vertex, spftree->tents[parent]))
+	break;
+      isis_tent_set (spftree, i, spftree->tents[parent]);
+      i = parent;
+    }
+  isis_tent_set (spftree, i, vertex);
+}
+
+static void
+isis_tent_down (struct isis_spftree *spftree, unsigned int i)
+{
+  struct isis_vertex *vertex = spftree->tents[i];
+  unsigned int child;
+
+  while ((child = 2 * i + 1) < spftree->tents_count)
+    {
+      if (child + 1 < spftree->tents_count
+	  && isis_tent_less (spftree->tents[child + 1],
+			     spftree->tents[child]))
+	child++;
+      if (!isis_tent_less (spftree->tents[child], vertex))
+	break;
+      isis_tent_set (spftree, i, spftree->tents[child]);
+      i = child;
+    }
+  isis_tent_set (spftree, i, vertex);
+}
+
+static void
+isis_tent_add (struct isis_spftree *spftree, struct isis_vertex *vertex)
+{
+  if (spftree->tents_count == spftree->tents_size)
+    {
+      spftree->tents_size = spftree->tents_size ? spftree->tents_size * 2 : 64;
+      spftree->tents = XREALLOC (MTYPE_ISIS_SPF_TENT, spftree->tents,
+				 spftree->tents_size * sizeof (*spftree->tents));
+    }
+  vertex->serial = spftree->serial++;
+  isis_tent_set (spftree, spftree->tents_count++, vertex);
+  isis_tent_up (spftree, vertex->tent_index);
+}
+
+static void
+isis_tent_remove (struct isis_spftree *spftree, struct isis_vertex *vertex)
+{
+  unsigned int i = vertex->tent_index;
+
+  assert (vertex->tent_index >= 0 && spftree->tents[i] == vertex);
+  vertex->tent_index = -1;
+  if (i == --spftree->tents_count)
+    return;
+  isis_tent_set (spftree, i, spftree->tents[spftree->tents_count]);
+  isis_tent_down (spftree, i);
+  isis_tent_up (spftree, spftree->tents[i]->tent_index);
+}
+
+static struct isis_vertex *
+isis_tent_pop (struct isis_spftree *spftree)
+{
+  struct isis_vertex *vertex;
+
+  if (spftree->tents_count == 0)
+    return NULL;
+  vertex = spftree->tents[0];
+  isis_tent_remove (spftree, vertex);
+  return vertex;
+}
+
 static void
 isis_vertex_adj_del (struct isis_vertex *vertex, struct isis_adjacency *adj)
 {
@@ -248,6 +467,17 @@ isis_vertex_adj_del (struct isis_vertex *vertex, struct isis_adjacency *adj)
   return;
 }
 
+/* Free the vertices a partial run has taken off the tree. */
+static void
+isis_spf_detached_free (struct isis_spftree *spftree)
+{
+  list_delete_all_node (spftree->touched);
+  list_delete_all_node (spftree->reseed);
+  spftree->detached->del = (void (*)(void *)) isis_vertex_del;
+  list_delete_all_node (spftree->detached);
+  spftree->detached->del = NULL;
+}
+
 struct isis_spftree *
 isis_spftree_new (struct isis_area *area)
 {
@@ -260,8 +490,11 @@ isis_spftree_new (struct isis_area *area)
       return NULL;
     }
 
-  tree->tents = list_new ();
   tree->paths = list_new ();
+  tree->detached = list_new ();
+  tree->reseed = list_new ();
+  tree->touched = list_new ();
+  tree->vertices = hash_create (isis_vertex_hash_key, isis_vertex_hash_cmp);
   tree->area = area;
   tree->last_run_timestamp = 0;
   tree->last_run_duration = 0;
@@ -275,9 +508,19 @@ isis_spftree_del (struct isis_spftree *spftree)
 {
   THREAD_TIMER_OFF (spftree->t_spf);
 
-  spftree->tents->del = (void (*)(void *)) isis_vertex_del;
-  list_delete (spftree->tents);
-  spftree->tents = NULL;
+  isis_spf_detached_free (spftree);
+  list_delete (spftree->detached);
+  list_delete (spftree->reseed);
+  list_delete (spftree->touched);
+
+  while (spftree->tents_count > 0)
+    isis_vertex_del (spftree->tents[--spftree->tents_count]);
+  XFREE (MTYPE_ISIS_SPF_TENT, spftree->tents);
+  spftree->tents_size = 0;
+
+  hash_clean (spftree->vertices, NULL);
+  hash_free (spftree->vertices);
+  spftree->vertices = NULL;
 
   spftree->paths->del = (void (*)(void *)) isis_vertex_del;
   list_delete (spftree->paths);
@@ -292,10 +535,13 @@ void
 isis_spftree_adj_del (struct isis_spftree *spftree, struct isis_adjacency *adj)
 {
   struct listnode *node;
+  unsigned int i;
   if (!adj)
     return;
-  for (node = listhead (spftree->tents); node; node = listnextnode (node))
-    isis_vertex_adj_del (listgetdata (node), adj);
+  /* The edges from the root may still hold it. */
+  spftree->full = 1;
+  for (i = 0; i < spftree->tents_count; i++)
+    isis_vertex_adj_del (spftree->tents[i], adj);
   for (node = listhead (spftree->paths); node; node = listnextnode (node))
     isis_vertex_adj_del (listgetdata (node), adj);
   return;
@@ -420,6 +666,8 @@ isis_spf_add_root (struct isis_spftree *spftree, int level, u_char *sysid)
     vertex = isis_vertex_new (sysid, VTYPE_NONPSEUDO_IS);
 
   listnode_add (spftree->paths, vertex);
+  vertex->paths_node = listtail (spftree->paths);
+  hash_get (spftree->vertices, vertex, hash_alloc_intern);
 
 #ifdef EXTREME_DEBUG
   zlog_debug ("ISIS-Spf: added this IS  %s %s depth %d dist %d to PATHS",
@@ -430,46 +678,151 @@ isis_spf_add_root (struct isis_spftree *spftree, int level, u_char *sysid)
   return vertex;
 }
 
+/*
+ * Find a vertex in TENT or PATHS, tent_index tells which.
+ */
 static struct isis_vertex *
-isis_find_vertex (struct list *list, void *id, enum vertextype vtype)
+isis_find_vertex (struct isis_spftree *spftree, void *id,
+		  enum vertextype vtype)
+{
+  struct isis_vertex key;
+
+  isis_vertex_id_init (&key, id, vtype);
+  return hash_lookup (spftree->vertices, &key);
+}
+
+/*
+ * Link a vertex that has no parents yet to its parent, and take the
+ * adjacencies to it from there.
+ */
+static void
+isis_vertex_parent_set (struct isis_vertex *vertex,
+			struct isis_adjacency *adj, struct isis_vertex *parent)
 {
   struct listnode *node;
-  struct isis_vertex *vertex;
-  struct prefix *p1, *p2;
+  struct isis_adjacency *parent_adj;
+
+  /* The vertex has no parents, so it cannot be among the children. */
+  if (parent) {
+    listnode_add (vertex->parents, parent);
+    listnode_add (parent->children, vertex);
+  }
+
+  if (parent && parent->Adj_N && listcount(parent->Adj_N) > 0) {
+    for (ALL_LIST_ELEMENTS_RO (parent->Adj_N, node, parent_adj))
+      listnode_add (vertex->Adj_N, parent_adj);
+  } else if (adj) {
+    listnode_add (vertex->Adj_N, adj);
+  }
+}
+
+/*
+ * A shorter path to a vertex in TENT has been found: start it over from
+ * the new parent.  This is done in place, so that the paths offered to it
+ * so far stay with it.
+ */
+static void
+isis_tent_update (struct isis_spftree *spftree, struct isis_vertex *vertex,
+		  uint32_t cost, int depth, struct isis_adjacency *adj,
+		  struct isis_vertex *parent)
+{
+  struct listnode *pnode, *pnextnode;
+  struct isis_vertex *pvertex;
 
-  for (ALL_LIST_ELEMENTS_RO (list, node, vertex))
+  assert (listcount (vertex->children) == 0);
+  for (ALL_LIST_ELEMENTS (vertex->parents, pnode, pnextnode, pvertex))
+    listnode_delete (pvertex->children, vertex);
+  list_delete_all_node (vertex->parents);
+  list_delete_all_node (vertex->Adj_N);
+
+  vertex->d_N = cost;
+  vertex->depth = depth;
+  isis_vertex_parent_set (vertex, adj, parent);
+
+  vertex->serial = spftree->serial++;
+  isis_tent_up (spftree, vertex->tent_index);
+}
+
+/*
+ * Take a vertex off the tree in a partial run, and queue it for the paths
+ * into it to be offered again.
+ */
+static void
+isis_spf_detach_one (struct isis_spftree *spftree, struct isis_vertex *vertex)
+{
+  struct listnode *node;
+  struct isis_vertex *parent;
+
+  /* What this run has put on PATHS already is final, or should be. */
+  if (vertex->run == spftree->runcount + 1)
+    spftree->abort = 1;
+
+  if (vertex->tent_index >= 0)
+    isis_tent_remove (spftree, vertex);
+  else
     {
-      if (vertex->type != vtype)
-	continue;
-      switch (vtype)
-	{
-	case VTYPE_ES:
-	case VTYPE_NONPSEUDO_IS:
-	case VTYPE_NONPSEUDO_TE_IS:
-	  if (memcmp ((u_char *) id, vertex->N.id, ISIS_SYS_ID_LEN) == 0)
-	    return vertex;
-	  break;
-	case VTYPE_PSEUDO_IS:
-	case VTYPE_PSEUDO_TE_IS:
-	  if (memcmp ((u_char *) id, vertex->N.id, ISIS_SYS_ID_LEN + 1) == 0)
-	    return vertex;
-	  break;
-	case VTYPE_IPREACH_INTERNAL:
-	case VTYPE_IPREACH_EXTERNAL:
-	case VTYPE_IPREACH_TE:
-	case VTYPE_IP6REACH_INTERNAL:
-	case VTYPE_IP6REACH_EXTERNAL:
-	  p1 = (struct prefix *) id;
-	  p2 = (struct prefix *) &vertex->N.id;
-	  if (p1->family == p2->family && p1->prefixlen == p2->prefixlen &&
-	      memcmp (&p1->u.prefix, &p2->u.prefix,
-		      PSIZE (p1->prefixlen)) == 0)
-	    return vertex;
-	  break;
-	}
+      list_delete_node (spftree->paths, vertex->paths_node);
+      vertex->paths_node = NULL;
     }
+  hash_release (spftree->vertices, vertex);
+  vertex->tent_index = ISIS_VERTEX_DETACHED;
 
-  return NULL;
+  for (ALL_LIST_ELEMENTS_RO (vertex->parents, node, parent))
+    if (parent->tent_index != ISIS_VERTEX_DETACHED)
+      listnode_delete (parent->children, vertex);
+  /* It offers its paths again once it is back on PATHS. */
+  while (vertex->edges_out)
+    isis_spf_edge_del (vertex->edges_out);
+
+  if (vertex->type > VTYPE_ES)
+    {
+      isis_route_invalidate_prefix (spftree->area, spftree->level,
+				    &vertex->N.prefix);
+      listnode_add (spftree->touched, vertex);
+    }
+
+  listnode_add (spftree->detached, vertex);
+  listnode_add (spftree->reseed, vertex);
+
+  /* Past this point, a full run is cheaper. */
+  if (listcount (spftree->detached) > listcount (spftree->paths))
+    spftree->abort = 1;
+}
+
+/*
+ * Take a vertex off the tree in a partial run, with everything that hangs
+ * off it.
+ */
+static void
+isis_spf_detach (struct isis_spftree *spftree, struct isis_vertex *vertex)
+{
+  struct listnode *qnode, *node;
+  struct isis_vertex *child;
+
+  isis_spf_detach_one (spftree, vertex);
+  for (qnode = listtail (spftree->detached); qnode;
+       qnode = listnextnode (qnode))
+    {
+      vertex = listgetdata (qnode);
+      for (ALL_LIST_ELEMENTS_RO (vertex->children, node, child))
+	if (child->tent_index != ISIS_VERTEX_DETACHED)
+	  isis_spf_detach_one (spftree, child);
+    }
+}
+
+/*
+ * Whether a path offered in a partial run to a vertex it kept on PATHS
+ * shows that the vertex has to be computed again: it is shorter, or as
+ * short through a parent a full run would have put on PATHS before it.
+ */
+static int
+isis_spf_improves (struct isis_vertex *vertex, uint32_t dist,
+		   struct isis_vertex *parent)
+{
+  if (dist != vertex->d_N)
+    return dist < vertex->d_N;
+  return (parent && (parent->d_N < dist || parent->type < vertex->type)
+	  && listnode_lookup (vertex->parents, parent) == NULL);
 }
 
 /*
@@ -480,31 +833,16 @@ isis_spf_add2tent (struct isis_spftree *spftree, enum vertextype vtype,
 		   void *id, uint32_t cost, int depth, int family,
 		   struct isis_adjacency *adj, struct isis_vertex *parent)
 {
-  struct isis_vertex *vertex, *v;
-  struct listnode *node;
-  struct isis_adjacency *parent_adj;
+  struct isis_vertex *vertex;
 #ifdef EXTREME_DEBUG
   char buff[PREFIX2STR_BUFFER];
 #endif
 
-  assert (isis_find_vertex (spftree->paths, id, vtype) == NULL);
-  assert (isis_find_vertex (spftree->tents, id, vtype) == NULL);
+  assert (isis_find_vertex (spftree, id, vtype) == NULL);
   vertex = isis_vertex_new (id, vtype);
   vertex->d_N = cost;
   vertex->depth = depth;
-
-  if (parent) {
-    listnode_add (vertex->parents, parent);
-    if (listnode_lookup (parent->children, vertex) == NULL)
-      listnode_add (parent->children, vertex);
-  }
-
-  if (parent && parent->Adj_N && listcount(parent->Adj_N) > 0) {
-    for (ALL_LIST_ELEMENTS_RO (parent->Adj_N, node, parent_adj))
-      listnode_add (vertex->Adj_N, parent_adj);
-  } else if (adj) {
-    listnode_add (vertex->Adj_N, adj);
-  }
+  isis_vertex_parent_set (vertex, adj, parent);
 
 #ifdef EXTREME_DEBUG
   zlog_debug ("ISIS-Spf: add to TENT %s %s %s depth %d dist %d adjcount %d",
@@ -513,31 +851,8 @@ isis_spf_add2tent (struct isis_spftree *spftree, enum vertextype vtype,
 	      vertex->depth, vertex->d_N, listcount(vertex->Adj_N));
 #endif /* EXTREME_DEBUG */
 
-  if (list_isempty (spftree->tents))
-    {
-      listnode_add (spftree->tents, vertex);
-      return vertex;
-    }
-
-  /* XXX: This cant use the standard ALL_LIST_ELEMENTS macro */
-  for (node = listhead (spftree->tents); node; node = listnextnode (node))
-    {
-      v = listgetdata (node);
-      if (v->d_N > vertex->d_N)
-	{
-	  listnode_add_before (spftree->tents, node, vertex);
-	  break;
-	}
-      else if (v->d_N == vertex->d_N && v->type > vertex->type)
-	{
-	  /*  Tie break, add according to type */
-          listnode_add_before (spftree->tents, node, vertex);
-	  break;
-	}
-    }
-
-  if (node == NULL)
-      listnode_add (spftree->tents, vertex);
+  isis_tent_add (spftree, vertex);
+  hash_get (spftree->vertices, vertex, hash_alloc_intern);
 
   return vertex;
 }
@@ -549,9 +864,21 @@ isis_spf_add_local (struct isis_spftree *spftree, enum vertextype vtype,
 {
   struct isis_vertex *vertex;
 
-  vertex = isis_find_vertex (spftree->tents, id, vtype);
+  vertex = isis_find_vertex (spftree, id, vtype);
 
-  if (vertex)
+  if (vertex && vertex->tent_index < 0 && spftree->incremental)
+    {
+      if (!isis_spf_improves (vertex, cost, parent))
+	{
+	  if (parent)
+	    isis_spf_edge_add (parent, vertex, cost, adj);
+	  return;
+	}
+      isis_spf_detach (spftree, vertex);
+      vertex = NULL;
+    }
+
+  if (vertex && vertex->tent_index >= 0)
     {
       /* C.2.5   c) */
       if (vertex->d_N == cost)
@@ -565,26 +892,20 @@ isis_spf_add_local (struct isis_spftree *spftree, enum vertextype vtype,
 	    listnode_add (vertex->parents, parent);
 	  if (parent && (listnode_lookup (parent->children, vertex) == NULL))
 	    listnode_add (parent->children, vertex);
-	  return;
 	}
-      else if (vertex->d_N < cost)
+      else if (vertex->d_N > cost)
 	{
-	  /*       e) do nothing */
-	  return;
-	}
-      else {  /* vertex->d_N > cost */
 	  /*         f) */
-	  struct listnode *pnode, *pnextnode;
-	  struct isis_vertex *pvertex;
-	  listnode_delete (spftree->tents, vertex);
-	  assert (listcount (vertex->children) == 0);
-	  for (ALL_LIST_ELEMENTS (vertex->parents, pnode, pnextnode, pvertex))
-	    listnode_delete(pvertex->children, vertex);
-	  isis_vertex_del (vertex);
-      }
+	  isis_tent_update (spftree, vertex, cost, 1, adj, parent);
+	}
+      /*       e) otherwise do nothing, but for keeping the edge */
     }
+  else
+    vertex = isis_spf_add2tent (spftree, vtype, id, cost, 1, family, adj,
+				parent);
 
-  isis_spf_add2tent (spftree, vtype, id, cost, 1, family, adj, parent);
+  if (parent)
+    isis_spf_edge_add (parent, vertex, cost, adj);
   return;
 }
 
@@ -614,19 +935,26 @@ process_N (struct isis_spftree *spftree, enum vertextype vtype, void *id,
     }
 
   /*       c)    */
-  vertex = isis_find_vertex (spftree->paths, id, vtype);
-  if (vertex)
+  vertex = isis_find_vertex (spftree, id, vtype);
+  if (vertex && vertex->tent_index < 0)
     {
 #ifdef EXTREME_DEBUG
       zlog_debug ("ISIS-Spf: process_N %s %s %s dist %d already found from PATH",
 	          print_sys_hostname (vertex->N.id),
 		  vtype2string (vtype), vid2string (vertex, buff, sizeof (buff)), dist);
 #endif /* EXTREME_DEBUG */
-      assert (dist >= vertex->d_N);
-      return;
+      if (!spftree->incremental
+	  || !isis_spf_improves (vertex, dist, parent))
+	{
+	  assert (dist >= vertex->d_N);
+	  isis_spf_edge_add (parent, vertex, dist - parent->d_N, NULL);
+	  return;
+	}
+      /* A partial run kept the vertex, but has to compute it again. */
+      isis_spf_detach (spftree, vertex);
+      vertex = NULL;
     }
 
-  vertex = isis_find_vertex (spftree->tents, id, vtype);
   /*       d)    */
   if (vertex)
     {
@@ -653,23 +981,12 @@ process_N (struct isis_spftree *spftree, enum vertextype vtype, void *id,
 	  if (listnode_lookup (parent->children, vertex) == NULL)
 	    listnode_add (parent->children, vertex);
 	  /*      3) */
-	  return;
-	}
-      else if (vertex->d_N < dist)
-	{
-	  return;
-	  /*      4) */
-	}
-      else
-	{
-	  struct listnode *pnode, *pnextnode;
-	  struct isis_vertex *pvertex;
-	  listnode_delete (spftree->tents, vertex);
-	  assert (listcount (vertex->children) == 0);
-	  for (ALL_LIST_ELEMENTS (vertex->parents, pnode, pnextnode, pvertex))
-	    listnode_delete(pvertex->children, vertex);
-	  isis_vertex_del (vertex);
 	}
+      else if (vertex->d_N > dist)
+	isis_tent_update (spftree, vertex, dist, depth, NULL, parent);
+      /*      4) otherwise nothing but the edge */
+      isis_spf_edge_add (parent, vertex, dist - parent->d_N, NULL);
+      return;
     }
 
 #ifdef EXTREME_DEBUG
@@ -678,10 +995,50 @@ process_N (struct isis_spftree *spftree, enum vertextype vtype, void *id,
               (parent ? print_sys_hostname (parent->N.id) : "null"));
 #endif /* EXTREME_DEBUG */
 
-  isis_spf_add2tent (spftree, vtype, id, dist, depth, family, NULL, parent);
+  vertex = isis_spf_add2tent (spftree, vtype, id, dist, depth, family, NULL,
+			      parent);
+  isis_spf_edge_add (parent, vertex, dist - parent->d_N, NULL);
   return;
 }
 
+/*
+ * Offer again the paths into the vertices a partial run has taken off the
+ * tree, from the vertices still on it.  Each of them is offered as it was,
+ * and replaced by the edge that offering it records.
+ */
+static void
+isis_spf_reseed (struct isis_spftree *spftree, int family)
+{
+  struct listnode *node;
+  struct isis_vertex *vertex, *from;
+  struct isis_spf_edge *edge;
+  struct isis_adjacency *adj;
+  u_int32_t metric;
+
+  while ((node = listhead (spftree->reseed)) != NULL && !spftree->abort)
+    {
+      vertex = listgetdata (node);
+      list_delete_node (spftree->reseed, node);
+
+      /* Vertices taken off the tree have no edges out, so these are all
+       * from the vertices still on it. */
+      while ((edge = vertex->edges_in) != NULL && !spftree->abort)
+	{
+	  from = edge->from;
+	  adj = edge->adj;
+	  metric = edge->metric;
+	  isis_spf_edge_del (edge);
+
+	  if (adj)
+	    isis_spf_add_local (spftree, vertex->type, &vertex->N, adj,
+				metric, family, from);
+	  else
+	    process_N (spftree, vertex->type, &vertex->N, from->d_N + metric,
+		       from->depth + 1, family, from);
+	}
+    }
+}
+
 /*
  * C.2.6 Step 1
  */
@@ -690,7 +1047,8 @@ isis_spf_process_lsp (struct isis_spftree *spftree, struct isis_lsp *lsp,
 		      uint32_t cost, uint16_t depth, int family,
 		      u_char *root_sysid, struct isis_vertex *parent)
 {
-  struct listnode *node, *fragnode = NULL;
+  struct listnode *fragnode = NULL;
+  struct tlv_view view;
   uint32_t dist;
   struct is_neigh *is_neigh;
   struct te_is_neigh *te_is_neigh;
@@ -717,27 +1075,25 @@ lspfragloop:
 
   if (!ISIS_MASK_LSP_OL_BIT (lsp->lsp_header->lsp_bits))
   {
-    if (lsp->tlv_data.is_neighs)
+    lsp_tlv_view_init (&view, lsp->pdu, IS_NEIGHBOURS);
+    while ((is_neigh = tlv_view_next (&view)))
     {
-      for (ALL_LIST_ELEMENTS_RO (lsp->tlv_data.is_neighs, node, is_neigh))
-      {
-        /* C.2.6 a) */
-        /* Two way connectivity */
-        if (!memcmp (is_neigh->neigh_id, root_sysid, ISIS_SYS_ID_LEN))
-          continue;
-        if (!memcmp (is_neigh->neigh_id, null_sysid, ISIS_SYS_ID_LEN))
-          continue;
-        dist = cost + is_neigh->metrics.metric_default;
-        vtype = LSP_PSEUDO_ID (is_neigh->neigh_id) ? VTYPE_PSEUDO_IS
-          : VTYPE_NONPSEUDO_IS;
-        process_N (spftree, vtype, (void *) is_neigh->neigh_id, dist,
-            depth + 1, family, parent);
-      }
+      /* C.2.6 a) */
+      /* Two way connectivity */
+      if (!memcmp (is_neigh->neigh_id, root_sysid, ISIS_SYS_ID_LEN))
+        continue;
+      if (!memcmp (is_neigh->neigh_id, null_sysid, ISIS_SYS_ID_LEN))
+        continue;
+      dist = cost + is_neigh->metrics.metric_default;
+      vtype = LSP_PSEUDO_ID (is_neigh->neigh_id) ? VTYPE_PSEUDO_IS
+        : VTYPE_NONPSEUDO_IS;
+      process_N (spftree, vtype, (void *) is_neigh->neigh_id, dist,
+          depth + 1, family, parent);
     }
-    if (lsp->tlv_data.te_is_neighs)
+    if (spftree->area->newmetric)
     {
-      for (ALL_LIST_ELEMENTS_RO (lsp->tlv_data.te_is_neighs, node,
-            te_is_neigh))
+      lsp_tlv_view_init (&view, lsp->pdu, TE_IS_NEIGHBOURS);
+      while ((te_is_neigh = tlv_view_next (&view)))
       {
         if (!memcmp (te_is_neigh->neigh_id, root_sysid, ISIS_SYS_ID_LEN))
           continue;
@@ -752,10 +1108,11 @@ lspfragloop:
     }
   }
 
-  if (family == AF_INET && lsp->tlv_data.ipv4_int_reachs)
+  if (family == AF_INET)
   {
     prefix.family = AF_INET;
-    for (ALL_LIST_ELEMENTS_RO (lsp->tlv_data.ipv4_int_reachs, node, ipreach))
+    lsp_tlv_view_init (&view, lsp->pdu, IPV4_INT_REACHABILITY);
+    while ((ipreach = tlv_view_next (&view)))
     {
       dist = cost + ipreach->metrics.metric_default;
       vtype = VTYPE_IPREACH_INTERNAL;
@@ -766,10 +1123,11 @@ lspfragloop:
                  family, parent);
     }
   }
-  if (family == AF_INET && lsp->tlv_data.ipv4_ext_reachs)
+  if (family == AF_INET)
   {
     prefix.family = AF_INET;
-    for (ALL_LIST_ELEMENTS_RO (lsp->tlv_data.ipv4_ext_reachs, node, ipreach))
+    lsp_tlv_view_init (&view, lsp->pdu, IPV4_EXT_REACHABILITY);
+    while ((ipreach = tlv_view_next (&view)))
     {
       dist = cost + ipreach->metrics.metric_default;
       vtype = VTYPE_IPREACH_EXTERNAL;
@@ -780,14 +1138,13 @@ lspfragloop:
                  family, parent);
     }
   }
-  if (family == AF_INET && lsp->tlv_data.te_ipv4_reachs)
+  if (family == AF_INET && spftree->area->newmetric)
   {
     prefix.family = AF_INET;
-    for (ALL_LIST_ELEMENTS_RO (lsp->tlv_data.te_ipv4_reachs,
-                               node, te_ipv4_reach))
+    /* The view has checked the prefix lengths. */
+    lsp_tlv_view_init (&view, lsp->pdu, TE_IPV4_REACHABILITY);
+    while ((te_ipv4_reach = tlv_view_next (&view)))
     {
-      assert ((te_ipv4_reach->control & 0x3F) <= IPV4_MAX_BITLEN);
-
       dist = cost + ntohl (te_ipv4_reach->te_metric);
       vtype = VTYPE_IPREACH_TE;
       prefix.u.prefix4 = newprefix2inaddr (&te_ipv4_reach->prefix_start,
@@ -798,13 +1155,12 @@ lspfragloop:
                  family, parent);
     }
   }
-  if (family == AF_INET6 && lsp->tlv_data.ipv6_reachs)
+  if (family == AF_INET6)
   {
     prefix.family = AF_INET6;
-    for (ALL_LIST_ELEMENTS_RO (lsp->tlv_data.ipv6_reachs, node, ip6reach))
+    lsp_tlv_view_init (&view, lsp->pdu, IPV6_REACHABILITY);
+    while ((ip6reach = tlv_view_next (&view)))
     {
-      assert (ip6reach->prefix_len <= IPV6_MAX_BITLEN);
-
       dist = cost + ntohl(ip6reach->metric);
       vtype = (ip6reach->control_info & CTRL_INFO_DISTRIBUTION) ?
         VTYPE_IP6REACH_EXTERNAL : VTYPE_IP6REACH_INTERNAL;
@@ -838,7 +1194,8 @@ isis_spf_process_pseudo_lsp (struct isis_spftree *spftree,
 			     u_char *root_sysid,
 			     struct isis_vertex *parent)
 {
-  struct listnode *node, *fragnode = NULL;
+  struct listnode *fragnode = NULL;
+  struct tlv_view view;
   struct is_neigh *is_neigh;
   struct te_is_neigh *te_is_neigh;
   enum vertextype vtype;
@@ -860,30 +1217,33 @@ pseudofragloop:
 
   /* RFC3787 section 4 SHOULD ignore overload bit in pseudo LSPs */
 
-  if (lsp->tlv_data.is_neighs)
-    for (ALL_LIST_ELEMENTS_RO (lsp->tlv_data.is_neighs, node, is_neigh))
-      {
-	/* Two way connectivity */
-	if (!memcmp (is_neigh->neigh_id, root_sysid, ISIS_SYS_ID_LEN))
-	  continue;
-        dist = cost + is_neigh->metrics.metric_default;
-        vtype = LSP_PSEUDO_ID (is_neigh->neigh_id) ? VTYPE_PSEUDO_IS
-          : VTYPE_NONPSEUDO_IS;
-        process_N (spftree, vtype, (void *) is_neigh->neigh_id, dist,
-            depth + 1, family, parent);
-      }
-  if (lsp->tlv_data.te_is_neighs)
-    for (ALL_LIST_ELEMENTS_RO (lsp->tlv_data.te_is_neighs, node, te_is_neigh))
-      {
-	/* Two way connectivity */
-	if (!memcmp (te_is_neigh->neigh_id, root_sysid, ISIS_SYS_ID_LEN))
-	  continue;
-        dist = cost + GET_TE_METRIC(te_is_neigh);
-        vtype = LSP_PSEUDO_ID (te_is_neigh->neigh_id) ? VTYPE_PSEUDO_TE_IS
-          : VTYPE_NONPSEUDO_TE_IS;
-        process_N (spftree, vtype, (void *) te_is_neigh->neigh_id, dist,
-            depth + 1, family, parent);
-      }
+  lsp_tlv_view_init (&view, lsp->pdu, IS_NEIGHBOURS);
+  while ((is_neigh = tlv_view_next (&view)))
+    {
+      /* Two way connectivity */
+      if (!memcmp (is_neigh->neigh_id, root_sysid, ISIS_SYS_ID_LEN))
+	continue;
+      dist = cost + is_neigh->metrics.metric_default;
+      vtype = LSP_PSEUDO_ID (is_neigh->neigh_id) ? VTYPE_PSEUDO_IS
+	: VTYPE_NONPSEUDO_IS;
+      process_N (spftree, vtype, (void *) is_neigh->neigh_id, dist,
+		 depth + 1, family, parent);
+    }
+  if (spftree->area->newmetric)
+    {
+      lsp_tlv_view_init (&view, lsp->pdu, TE_IS_NEIGHBOURS);
+      while ((te_is_neigh = tlv_view_next (&view)))
+	{
+	  /* Two way connectivity */
+	  if (!memcmp (te_is_neigh->neigh_id, root_sysid, ISIS_SYS_ID_LEN))
+	    continue;
+	  dist = cost + GET_TE_METRIC(te_is_neigh);
+	  vtype = LSP_PSEUDO_ID (te_is_neigh->neigh_id) ? VTYPE_PSEUDO_TE_IS
+	    : VTYPE_NONPSEUDO_TE_IS;
+	  process_N (spftree, vtype, (void *) te_is_neigh->neigh_id, dist,
+		     depth + 1, family, parent);
+	}
+    }
 
   if (fragnode == NULL)
     fragnode = listhead (lsp->lspu.frags);
@@ -1099,9 +1459,10 @@ add_to_paths (struct isis_spftree *spftree, struct isis_vertex *vertex,
 {
   char buff[PREFIX2STR_BUFFER];
 
-  if (isis_find_vertex (spftree->paths, vertex->N.id, vertex->type))
-    return;
   listnode_add (spftree->paths, vertex);
+  vertex->paths_node = listtail (spftree->paths);
+  vertex->run = spftree->runcount + 1;
+  spftree->computed++;
 
 #ifdef EXTREME_DEBUG
   zlog_debug ("ISIS-Spf: added %s %s %s depth %d dist %d to PATHS",
@@ -1112,6 +1473,8 @@ add_to_paths (struct isis_spftree *spftree, struct isis_vertex *vertex,
 
   if (vertex->type > VTYPE_ES)
     {
+      if (spftree->incremental)
+	listnode_add (spftree->touched, vertex);
       if (listcount (vertex->Adj_N) > 0)
 	isis_route_create ((struct prefix *) &vertex->N.prefix, vertex->d_N,
 			   vertex->depth, vertex->Adj_N, spftree->area, level);
@@ -1124,26 +1487,130 @@ add_to_paths (struct isis_spftree *spftree, struct isis_vertex *vertex,
   return;
 }
 
+/*
+ * C.2.6 Step 1, for a vertex just put on PATHS
+ */
+static void
+isis_spf_process_vertex (struct isis_spftree *spftree,
+			 struct isis_vertex *vertex, int level, int family,
+			 u_char *sysid)
+{
+  u_char lsp_id[ISIS_SYS_ID_LEN + 2];
+  struct isis_lsp *lsp;
+
+  switch (vertex->type)
+    {
+    case VTYPE_PSEUDO_IS:
+    case VTYPE_NONPSEUDO_IS:
+    case VTYPE_PSEUDO_TE_IS:
+    case VTYPE_NONPSEUDO_TE_IS:
+      memcpy (lsp_id, vertex->N.id, ISIS_SYS_ID_LEN + 1);
+      LSP_FRAGMENT (lsp_id) = 0;
+      lsp = lsp_search (lsp_id, spftree->area->lspdb[level - 1]);
+      if (lsp && lsp->lsp_header->rem_lifetime != 0)
+	{
+	  if (LSP_PSEUDO_ID (lsp_id))
+	    {
+	      isis_spf_process_pseudo_lsp (spftree, lsp, vertex->d_N,
+					   vertex->depth, family, sysid,
+					   vertex);
+	    }
+	  else
+	    {
+	      isis_spf_process_lsp (spftree, lsp, vertex->d_N,
+				    vertex->depth, family, sysid, vertex);
+	    }
+	}
+      else
+	{
+	  zlog_warn ("ISIS-Spf: No LSP found for %s",
+		     rawlspid_print (lsp_id));
+	}
+      break;
+    default:;
+    }
+}
+
+/*
+ * C.2.7 Step 2, until TENT is empty.  A partial run first offers again
+ * the paths into the vertices it has taken off the tree, which are never
+ * shorter than the vertex about to be put on PATHS.
+ */
+static void
+isis_spf_loop (struct isis_spftree *spftree, int level, int family,
+	       u_char *sysid)
+{
+  struct isis_vertex *vertex;
+
+  for (;;)
+    {
+      if (spftree->incremental)
+	{
+	  isis_spf_reseed (spftree, family);
+	  if (spftree->abort)
+	    return;
+	}
+
+      vertex = isis_tent_pop (spftree);
+      if (vertex == NULL)
+	break;
+
+#ifdef EXTREME_DEBUG
+  zlog_debug ("ISIS-Spf: get TENT node %s %s depth %d dist %d to PATHS",
+              print_sys_hostname (vertex->N.id),
+	      vtype2string (vertex->type), vertex->depth, vertex->d_N);
+#endif /* EXTREME_DEBUG */
+
+      /* Removed from tent list, add to paths list */
+      add_to_paths (spftree, vertex, level);
+      isis_spf_process_vertex (spftree, vertex, level, family, sysid);
+    }
+}
+
 static void
 init_spt (struct isis_spftree *spftree)
 {
-  spftree->tents->del = spftree->paths->del = (void (*)(void *)) isis_vertex_del;
-  list_delete_all_node (spftree->tents);
+  while (spftree->tents_count > 0)
+    isis_vertex_del (spftree->tents[--spftree->tents_count]);
+  spftree->paths->del = (void (*)(void *)) isis_vertex_del;
   list_delete_all_node (spftree->paths);
-  spftree->tents->del = spftree->paths->del = NULL;
+  spftree->paths->del = NULL;
+  hash_clean (spftree->vertices, NULL);
+  spftree->serial = 0;
   return;
 }
 
-static int
+/* Account for a run, and clear the changes it was for. */
+static void
+isis_spf_log_run (struct isis_spftree *spftree, enum isis_spf_kind kind,
+		  unsigned long duration)
+{
+  struct isis_spf_log *log;
+
+  spftree->kind_runs[kind]++;
+  spftree->kind_duration[kind] += duration;
+
+  log = &spftree->log[spftree->log_next];
+  spftree->log_next = (spftree->log_next + 1) % ISIS_SPF_LOG_SIZE;
+  log->timestamp = time (NULL);
+  log->kind = kind;
+  log->duration = duration;
+  log->vertices = spftree->computed;
+  log->changes = spftree->changes_count;
+  if (spftree->changes_count > 0)
+    memcpy (log->trigger, spftree->changes[0].id, ISIS_SYS_ID_LEN + 1);
+  else
+    memset (log->trigger, 0, ISIS_SYS_ID_LEN + 1);
+
+  spftree->changes_count = 0;
+}
+
+int
 isis_run_spf (struct isis_area *area, int level, int family, u_char *sysid)
 {
   int retval = ISIS_OK;
-  struct listnode *node;
-  struct isis_vertex *vertex;
   struct isis_vertex *root_vertex;
   struct isis_spftree *spftree = NULL;
-  u_char lsp_id[ISIS_SYS_ID_LEN + 2];
-  struct isis_lsp *lsp;
   struct route_table *table = NULL;
   struct timeval time_now;
   unsigned long long start_time, end_time;
@@ -1172,6 +1639,7 @@ isis_run_spf (struct isis_area *area, int level, int family, u_char *sysid)
    * C.2.5 Step 0
    */
   init_spt (spftree);
+  spftree->computed = 0;
   /*              a) */
   root_vertex = isis_spf_add_root (spftree, level, sysid);
   /*              b) */
@@ -1185,61 +1653,169 @@ isis_run_spf (struct isis_area *area, int level, int family, u_char *sysid)
   /*
    * C.2.7 Step 2
    */
-  if (listcount (spftree->tents) == 0)
+  if (spftree->tents_count == 0)
     {
       zlog_warn ("ISIS-Spf: TENT is empty SPF-root:%s", print_sys_hostname(sysid));
       goto out;
     }
 
-  while (listcount (spftree->tents) > 0)
+  isis_spf_loop (spftree, level, family, sysid);
+
+out:
+  isis_route_validate (area);
+  spftree->pending = 0;
+  spftree->runcount++;
+  spftree->last_run_timestamp = time (NULL);
+  monotime(&time_now);
+  end_time = time_now.tv_sec;
+  end_time = (end_time * 1000000) + time_now.tv_usec;
+  spftree->last_run_duration = end_time - start_time;
+
+  isis_spf_log_run (spftree, ISIS_SPF_FULL, spftree->last_run_duration);
+  spftree->valid = (retval == ISIS_OK);
+  spftree->full = 0;
+
+  return retval;
+}
+
+/*
+ * Changes at the root, or on a LAN the root is on, come in through
+ * isis_spf_preload_tent, which only a full run goes through.
+ */
+static int
+isis_spf_change_local (struct isis_area *area, int level, u_char *id,
+		       u_char *sysid)
+{
+  struct listnode *node;
+  struct isis_circuit *circuit;
+  u_char *dis;
+
+  if (memcmp (id, sysid, ISIS_SYS_ID_LEN) == 0)
+    return 1;
+  if (LSP_PSEUDO_ID (id) == 0 || area->circuit_list == NULL)
+    return 0;
+
+  for (ALL_LIST_ELEMENTS_RO (area->circuit_list, node, circuit))
     {
-      node = listhead (spftree->tents);
-      vertex = listgetdata (node);
+      if (circuit->circ_type != CIRCUIT_T_BROADCAST)
+	continue;
+      dis = (level == 1) ? circuit->u.bc.l1_desig_is
+	: circuit->u.bc.l2_desig_is;
+      if (memcmp (dis, id, ISIS_SYS_ID_LEN + 1) == 0)
+	return 1;
+    }
+  return 0;
+}
 
-#ifdef EXTREME_DEBUG
-  zlog_debug ("ISIS-Spf: get TENT node %s %s depth %d dist %d to PATHS",
-              print_sys_hostname (vertex->N.id),
-	      vtype2string (vertex->type), vertex->depth, vertex->d_N);
-#endif /* EXTREME_DEBUG */
+/*
+ * Run SPF again for just the part of the tree the LSPs changed since the
+ * last run can reach: what hangs off an IS whose neighbours changed, or
+ * only the prefixes of an IS whose reachability did (partial route
+ * calculation).  The paths into those vertices from the rest of the tree
+ * are offered again, and the run goes on from there.  A path that improves
+ * on a vertex kept on the tree takes that vertex off as well.  What this
+ * cannot handle falls back to a full run.
+ */
+int
+isis_run_ispf (struct isis_area *area, int level, int family, u_char *sysid)
+{
+  static const enum vertextype nonpseudo[] = { VTYPE_NONPSEUDO_TE_IS,
+					       VTYPE_NONPSEUDO_IS };
+  static const enum vertextype pseudo[] = { VTYPE_PSEUDO_TE_IS,
+					    VTYPE_PSEUDO_IS };
+  struct isis_spftree *spftree = NULL;
+  struct isis_spf_change *change;
+  struct isis_vertex *changed[2 * ISIS_SPF_MAX_CHANGES];
+  struct isis_vertex *vertex, *child;
+  const enum vertextype *vtypes;
+  struct list *children;
+  struct listnode *node;
+  enum isis_spf_kind kind = ISIS_SPF_PRC;
+  unsigned int i, j, count = 0;
+  struct timeval time_now;
+  unsigned long long start_time, end_time;
 
-      /* Remove from tent list and add to paths list */
-      list_delete_node (spftree->tents, node);
-      add_to_paths (spftree, vertex, level);
-      switch (vertex->type)
-        {
-	case VTYPE_PSEUDO_IS:
-	case VTYPE_NONPSEUDO_IS:
-	case VTYPE_PSEUDO_TE_IS:
-	case VTYPE_NONPSEUDO_TE_IS:
-	  memcpy (lsp_id, vertex->N.id, ISIS_SYS_ID_LEN + 1);
-	  LSP_FRAGMENT (lsp_id) = 0;
-	  lsp = lsp_search (lsp_id, area->lspdb[level - 1]);
-	  if (lsp && lsp->lsp_header->rem_lifetime != 0)
-	    {
-	      if (LSP_PSEUDO_ID (lsp_id))
-		{
-		  isis_spf_process_pseudo_lsp (spftree, lsp, vertex->d_N,
-					       vertex->depth, family, sysid,
-					       vertex);
-		}
-	      else
-		{
-		  isis_spf_process_lsp (spftree, lsp, vertex->d_N,
-					vertex->depth, family, sysid, vertex);
-		}
-	    }
-	  else
-	    {
-	      zlog_warn ("ISIS-Spf: No LSP found for %s",
-			 rawlspid_print (lsp_id));
-	    }
-	  break;
-	default:;
+  if (family == AF_INET)
+    spftree = area->spftree[level - 1];
+  else if (family == AF_INET6)
+    spftree = area->spftree6[level - 1];
+  assert (spftree);
+  assert (sysid);
+
+  if (spftree->full || !spftree->valid || spftree->changes_count == 0)
+    return isis_run_spf (area, level, family, sysid);
+  for (i = 0; i < spftree->changes_count; i++)
+    if (isis_spf_change_local (area, level, spftree->changes[i].id, sysid))
+      return isis_run_spf (area, level, family, sysid);
+
+  monotime(&time_now);
+  start_time = time_now.tv_sec;
+  start_time = (start_time * 1000000) + time_now.tv_usec;
+
+  spftree->incremental = 1;
+  spftree->level = level;
+  spftree->abort = 0;
+  spftree->computed = 0;
+
+  /* Take off the tree what the changes can reach.  An IS that is not on
+   * the tree offers nothing, changed or not. */
+  children = list_new ();
+  for (i = 0; i < spftree->changes_count; i++)
+    {
+      change = &spftree->changes[i];
+      vtypes = LSP_PSEUDO_ID (change->id) ? pseudo : nonpseudo;
+      if (change->change == ISIS_LSP_CHANGE_TOPOLOGY)
+	kind = ISIS_SPF_INCREMENTAL;
+
+      for (j = 0; j < 2; j++)
+	{
+	  vertex = isis_find_vertex (spftree, change->id, vtypes[j]);
+	  if (vertex == NULL || vertex->tent_index != -1)
+	    continue;
+
+	  for (ALL_LIST_ELEMENTS_RO (vertex->children, node, child))
+	    if (change->change == ISIS_LSP_CHANGE_TOPOLOGY
+		|| child->type > VTYPE_ES)
+	      listnode_add (children, child);
+	  for (ALL_LIST_ELEMENTS_RO (children, node, child))
+	    if (child->tent_index != ISIS_VERTEX_DETACHED)
+	      isis_spf_detach (spftree, child);
+	  list_delete_all_node (children);
+
+	  changed[count++] = vertex;
 	}
     }
+  list_delete (children);
+
+  /* The changed LSPs offer their paths anew. */
+  for (i = 0; i < count && !spftree->abort; i++)
+    {
+      vertex = changed[i];
+      if (vertex->tent_index == ISIS_VERTEX_DETACHED)
+	continue;
+      while (vertex->edges_out)
+	isis_spf_edge_del (vertex->edges_out);
+      isis_spf_process_vertex (spftree, vertex, level, family, sysid);
+    }
+
+  if (!spftree->abort)
+    isis_spf_loop (spftree, level, family, sysid);
+
+  if (spftree->abort)
+    {
+      if (isis->debugs & DEBUG_SPF_EVENTS)
+	zlog_debug ("ISIS-Spf (%s) L%d partial SPF gave up after %u vertices",
+		    area->area_tag, level, listcount (spftree->detached));
+      isis_spf_detached_free (spftree);
+      spftree->incremental = 0;
+      return isis_run_spf (area, level, family, sysid);
+    }
+
+  for (ALL_LIST_ELEMENTS_RO (spftree->touched, node, vertex))
+    isis_route_validate_prefix (area, &vertex->N.prefix);
+  isis_spf_detached_free (spftree);
+  spftree->incremental = 0;
 
-out:
-  isis_route_validate (area);
   spftree->pending = 0;
   spftree->runcount++;
   spftree->last_run_timestamp = time (NULL);
@@ -1248,8 +1824,73 @@ out:
   end_time = (end_time * 1000000) + time_now.tv_usec;
   spftree->last_run_duration = end_time - start_time;
 
+  isis_spf_log_run (spftree, kind, spftree->last_run_duration);
 
-  return retval;
+  return ISIS_OK;
+}
+
+/* Note a change to an LSP, by its LSP ID without the fragment. */
+static void
+isis_spftree_lsp_change (struct isis_spftree *spftree, u_char *lsp_id,
+			 enum isis_lsp_change change)
+{
+  unsigned int i;
+
+  for (i = 0; i < spftree->changes_count; i++)
+    if (memcmp (spftree->changes[i].id, lsp_id, ISIS_SYS_ID_LEN + 1) == 0)
+      {
+	if (change > spftree->changes[i].change)
+	  spftree->changes[i].change = change;
+	return;
+      }
+
+  if (spftree->changes_count == ISIS_SPF_MAX_CHANGES)
+    {
+      spftree->full = 1;
+      return;
+    }
+  memcpy (spftree->changes[i].id, lsp_id, ISIS_SYS_ID_LEN + 1);
+  spftree->changes[i].change = change;
+  spftree->changes_count++;
+}
+
+/*
+ * Note a change to an LSP for the next run of the trees of its level.  A
+ * change to our own LSPs takes a full run.
+ */
+void
+isis_spf_lsp_change (struct isis_lsp *lsp, enum isis_lsp_change change)
+{
+  struct isis_area *area = lsp->area;
+  struct isis_spftree *trees[2];
+  int i;
+
+  if (change == ISIS_LSP_CHANGE_NONE)
+    return;
+
+  trees[0] = area->spftree[lsp->level - 1];
+  trees[1] = area->spftree6[lsp->level - 1];
+  for (i = 0; i < 2; i++)
+    {
+      if (trees[i] == NULL)
+	continue;
+      if (lsp->own_lsp)
+	trees[i]->full = 1;
+      else
+	isis_spftree_lsp_change (trees[i], lsp->lsp_header->lsp_id, change);
+    }
+}
+
+int
+isis_spf_schedule_lsp (struct isis_lsp *lsp, enum isis_lsp_change change)
+{
+  if (change == ISIS_LSP_CHANGE_NONE)
+    return ISIS_OK;
+
+  isis_spf_lsp_change (lsp, change);
+  isis_spf_schedule (lsp->area, lsp->level);
+  isis_spf_schedule6 (lsp->area, lsp->level);
+  return ISIS_OK;
 }
 
 int
@@ -1276,7 +1917,7 @@ isis_run_spf_l1 (struct thread *thread)
     zlog_debug ("ISIS-Spf (%s) L1 SPF needed, periodic SPF", area->area_tag);
 
   if (area->ip_circuits)
-    retval = isis_run_spf (area, 1, AF_INET, isis->sysid);
+    retval = isis_run_ispf (area, 1, AF_INET, isis->sysid);
 
   return retval;
 }
@@ -1304,7 +1945,7 @@ isis_run_spf_l2 (struct thread *thread)
     zlog_debug ("ISIS-Spf (%s) L2 SPF needed, periodic SPF", area->area_tag);
 
   if (area->ip_circuits)
-    retval = isis_run_spf (area, 2, AF_INET, isis->sysid);
+    retval = isis_run_ispf (area, 2, AF_INET, isis->sysid);
 
   return retval;
 }
@@ -1330,7 +1971,7 @@ isis_spf_schedule (struct isis_area *area, int level)
 
   /* wait configured min_spf_interval before doing the SPF */
   if (diff >= area->min_spf_interval[level-1])
-      return isis_run_spf (area, level, AF_INET, isis->sysid);
+      return isis_run_ispf (area, level, AF_INET, isis->sysid);
 
   if (level == 1)
     THREAD_TIMER_ON (master, spftree->t_spf, isis_run_spf_l1, area,
@@ -1371,7 +2012,7 @@ isis_run_spf6_l1 (struct thread *thread)
     zlog_debug ("ISIS-Spf (%s) L1 SPF needed, periodic SPF", area->area_tag);
 
   if (area->ipv6_circuits)
-    retval = isis_run_spf (area, 1, AF_INET6, isis->sysid);
+    retval = isis_run_ispf (area, 1, AF_INET6, isis->sysid);
 
   return retval;
 }
@@ -1399,7 +2040,7 @@ isis_run_spf6_l2 (struct thread *thread)
     zlog_debug ("ISIS-Spf (%s) L2 SPF needed, periodic SPF.", area->area_tag);
 
   if (area->ipv6_circuits)
-    retval = isis_run_spf (area, 2, AF_INET6, isis->sysid);
+    retval = isis_run_ispf (area, 2, AF_INET6, isis->sysid);
 
   return retval;
 }
@@ -1426,7 +2067,7 @@ isis_spf_schedule6 (struct isis_area *area, int level)
 
   /* wait configured min_spf_interval before doing the SPF */
   if (diff >= area->min_spf_interval[level-1])
-      return isis_run_spf (area, level, AF_INET6, isis->sysid);
+      return isis_run_ispf (area, level, AF_INET6, isis->sysid);
 
   if (level == 1)
     THREAD_TIMER_ON (master, spftree->t_spf, isis_run_spf6_l1, area,
@@ -1632,10 +2273,98 @@ DEFUN (show_isis_topology_l2,
   return CMD_SUCCESS;
 }
 
+static const char *
+spf_kind2string (enum isis_spf_kind kind)
+{
+  switch (kind)
+    {
+    case ISIS_SPF_FULL:
+      return "full";
+    case ISIS_SPF_INCREMENTAL:
+      return "incremental";
+    case ISIS_SPF_PRC:
+      return "prc";
+    default:
+      return "unknown";
+    }
+}
+
+static void
+isis_print_spf_log (struct vty *vty, struct isis_spftree *spftree)
+{
+  struct isis_spf_log *log;
+  enum isis_spf_kind kind;
+  unsigned int i;
+
+  for (kind = ISIS_SPF_FULL; kind < ISIS_SPF_KINDS; kind++)
+    vty_out (vty, "  %-12s %8u runs, %10llu usec total%s",
+	     spf_kind2string (kind), spftree->kind_runs[kind],
+	     spftree->kind_duration[kind], VTY_NEWLINE);
+
+  vty_out (vty, "  When      Type         Duration  Nodes Changes Trigger%s",
+	   VTY_NEWLINE);
+  for (i = 1; i <= ISIS_SPF_LOG_SIZE; i++)
+    {
+      /* Most recent first */
+      log = &spftree->log[(spftree->log_next + ISIS_SPF_LOG_SIZE - i)
+			  % ISIS_SPF_LOG_SIZE];
+      if (log->timestamp == 0)
+	break;
+      vty_out (vty, "  %-9s %-12s %8lu %6u %7u %s%s",
+	       time2string (time (NULL) - log->timestamp),
+	       spf_kind2string (log->kind), log->duration, log->vertices,
+	       log->changes,
+	       log->changes ? print_sys_hostname (log->trigger) : "-",
+	       VTY_NEWLINE);
+    }
+}
+
+DEFUN (show_isis_spf_log,
+       show_isis_spf_log_cmd,
+       "show isis spf-log",
+       SHOW_STR
+       "IS-IS information\n"
+       "IS-IS SPF runs, full and partial\n")
+{
+  struct listnode *node;
+  struct isis_area *area;
+  int level;
+
+  if (!isis->area_list || isis->area_list->count == 0)
+    return CMD_SUCCESS;
+
+  for (ALL_LIST_ELEMENTS_RO (isis->area_list, node, area))
+    {
+      vty_out (vty, "Area %s:%s", area->area_tag ? area->area_tag : "null",
+	       VTY_NEWLINE);
+
+      for (level = 0; level < ISIS_LEVELS; level++)
+	{
+	  if (area->ip_circuits > 0 && area->spftree[level])
+	    {
+	      vty_out (vty, " Level-%d IPv4 SPF runs:%s", level + 1,
+		       VTY_NEWLINE);
+	      isis_print_spf_log (vty, area->spftree[level]);
+	    }
+	  if (area->ipv6_circuits > 0 && area->spftree6[level])
+	    {
+	      vty_out (vty, " Level-%d IPv6 SPF runs:%s", level + 1,
+		       VTY_NEWLINE);
+	      isis_print_spf_log (vty, area->spftree6[level]);
+	    }
+	}
+
+      vty_out (vty, "%s", VTY_NEWLINE);
+    }
+
+  return CMD_SUCCESS;
+}
+
 void
 isis_spf_cmds_init ()
 {
   install_element (VIEW_NODE, &show_isis_topology_cmd);
   install_element (VIEW_NODE, &show_isis_topology_l1_cmd);
   install_element (VIEW_NODE, &show_isis_topology_l2_cmd);
+  install_element (VIEW_NODE, &show_isis_spf_log_cmd);
 }
@@ -38,6 +38,25 @@ enum vertextype
   VTYPE_IP6REACH_EXTERNAL
 };
 
+/* What an LSP change touches, which decides how much SPF has to redo. */
+enum isis_lsp_change
+{
+  ISIS_LSP_CHANGE_NONE = 0,	/* refresh, nothing SPF looks at */
+  ISIS_LSP_CHANGE_REACH,	/* IP reachability only: partial route calc */
+  ISIS_LSP_CHANGE_TOPOLOGY,	/* neighbours or flags: incremental SPF */
+};
+
+enum isis_spf_kind
+{
+  ISIS_SPF_FULL = 0,
+  ISIS_SPF_INCREMENTAL,
+  ISIS_SPF_PRC,
+  ISIS_SPF_KINDS,
+};
+
+struct isis_spf_edge;
+struct isis_lsp;
+
 /*
  * Triple <N, d(N), {Adj(N)}> 
  */
@@ -56,18 +75,64 @@ struct isis_vertex
   struct list *Adj_N;		/* {Adj(N)} next hop or neighbor list */
   struct list *parents;         /* list of parents for ECMP */
   struct list *children;        /* list of children used for tree dump */
+  int tent_index;		/* position in TENT, -1 when on PATHS,
+				 * -2 once taken off the tree by a partial run */
+  u_int64_t serial;		/* order of addition, for ties in TENT */
+  unsigned int run;		/* run that put the vertex on PATHS */
+  struct listnode *paths_node;	/* its node in PATHS */
+  struct isis_spf_edge *edges_in;	/* paths offered to this vertex */
+  struct isis_spf_edge *edges_out;	/* paths offered by this vertex */
+};
+
+/* An LSP changed since the last run, by LSP ID without the fragment. */
+struct isis_spf_change
+{
+  u_char id[ISIS_SYS_ID_LEN + 1];
+  enum isis_lsp_change change;
+};
+
+#define ISIS_SPF_MAX_CHANGES 32
+#define ISIS_SPF_LOG_SIZE    32
+
+struct isis_spf_log
+{
+  time_t timestamp;
+  enum isis_spf_kind kind;
+  unsigned long duration;	/* usec */
+  unsigned int vertices;	/* vertices computed */
+  unsigned int changes;		/* LSPs changed */
+  u_char trigger[ISIS_SYS_ID_LEN + 1];
 };
 
 struct isis_spftree
 {
   struct thread *t_spf;		/* spf threads */
   struct list *paths;		/* the SPT */
-  struct list *tents;		/* TENT */
+  struct isis_vertex **tents;	/* TENT, a binary heap on d(N) */
+  unsigned int tents_count;
+  unsigned int tents_size;
+  u_int64_t serial;		/* vertices added to TENT so far */
+  struct hash *vertices;	/* TENT and PATHS, by vertextype and id */
   struct isis_area *area;       /* back pointer to area */
   int pending;			/* already scheduled */
   unsigned int runcount;        /* number of runs since uptime */
   time_t last_run_timestamp;    /* last run timestamp for scheduling */
   time_t last_run_duration;     /* last run duration in msec */
+  int valid;			/* the tree can be rerun from in part */
+  int full;			/* the next run has to be a full one */
+  int incremental;		/* a partial run is in progress */
+  int level;			/* ... of this level */
+  int abort;			/* ... and has to fall back to a full one */
+  struct list *detached;	/* vertices taken off the tree by it */
+  struct list *reseed;		/* ... whose paths in are still to offer */
+  struct list *touched;		/* prefix vertices whose routes to redo */
+  unsigned int computed;	/* vertices put on PATHS by the run */
+  struct isis_spf_change changes[ISIS_SPF_MAX_CHANGES];
+  unsigned int changes_count;
+  unsigned int kind_runs[ISIS_SPF_KINDS];
+  unsigned long long kind_duration[ISIS_SPF_KINDS];	/* usec */
+  struct isis_spf_log log[ISIS_SPF_LOG_SIZE];
+  unsigned int log_next;
 };
 
 struct isis_spftree * isis_spftree_new (struct isis_area *area);
@@ -78,6 +143,12 @@ void spftree_area_init (struct isis_area *area);
 void spftree_area_del (struct isis_area *area);
 void spftree_area_adj_del (struct isis_area *area,
                            struct isis_adjacency *adj);
+int isis_run_spf (struct isis_area *area, int level, int family,
+                  u_char *sysid);
+int isis_run_ispf (struct isis_area *area, int level, int family,
+                   u_char *sysid);
+void isis_spf_lsp_change (struct isis_lsp *lsp, enum isis_lsp_change change);
+int isis_spf_schedule_lsp (struct isis_lsp *lsp, enum isis_lsp_change change);
 int isis_spf_schedule (struct isis_area *area, int level);
 void isis_spf_cmds_init (void);
 int isis_spf_schedule6 (struct isis_area *area, int level);
@@ -757,6 +757,135 @@ parse_tlvs (char *areatag, u_char * stream, int size, u_int32_t * expected,
   return retval;
 }
 
+void
+tlv_view_init (struct tlv_view *view, u_char type, u_char *tlvs, int size)
+{
+  view->type = type;
+  view->pnt = tlvs;
+  view->end = tlvs + (size > 0 ? size : 0);
+  view->entry = view->value_end = NULL;
+}
+
+/*
+ * Length of the entry of a TLV of the given type at pnt, with avail octets
+ * left in the TLV, or 0 if it does not fit or is malformed.
+ */
+static int
+tlv_entry_len (u_char type, u_char *pnt, int avail)
+{
+  int len;
+
+  switch (type)
+    {
+    case AREA_ADDRESSES:
+      len = 1 + pnt[0];
+      break;
+    case IS_NEIGHBOURS:
+      len = IS_NEIGHBOURS_LEN;
+      break;
+    case TE_IS_NEIGHBOURS:
+      /* neighbour ID, TE metric, length of the sub-TLVs that follow */
+      if (avail < IS_NEIGHBOURS_LEN)
+        return 0;
+      len = IS_NEIGHBOURS_LEN + pnt[IS_NEIGHBOURS_LEN - 1];
+      break;
+    case LAN_NEIGHBOURS:
+      len = LAN_NEIGHBOURS_LEN;
+      break;
+    case LSP_ENTRIES:
+      len = LSP_ENTRIES_LEN;
+      break;
+    case IPV4_ADDR:
+      len = IPV4_MAX_BYTELEN;
+      break;
+    case IPV6_ADDR:
+      len = IPV6_MAX_BYTELEN;
+      break;
+    case IPV4_INT_REACHABILITY:
+    case IPV4_EXT_REACHABILITY:
+      len = IPV4_REACH_LEN;
+      break;
+    case TE_IPV4_REACHABILITY:
+      /* TE metric, control with the prefix length, the prefix, and the
+       * sub-TLVs if the control says so */
+      if (avail < 5 || (pnt[4] & 0x3F) > IPV4_MAX_BITLEN)
+        return 0;
+      len = 5 + PSIZE (pnt[4] & 0x3F);
+      if (pnt[4] & 0x40)
+        {
+          if (avail < len + 1)
+            return 0;
+          len += 1 + pnt[len];
+        }
+      break;
+    case IPV6_REACHABILITY:
+      /* metric, control, prefix length, the prefix, and the sub-TLVs if
+       * the control says so */
+      if (avail < 6 || pnt[5] > IPV6_MAX_BITLEN)
+        return 0;
+      len = 6 + PSIZE (pnt[5]);
+      if (pnt[4] & CTRL_INFO_SUBTLVS)
+        {
+          if (avail < len + 1)
+            return 0;
+          len += 1 + pnt[len];
+        }
+      break;
+    default:
+      /* the whole value is one entry */
+      len = avail;
+      break;
+    }
+
+  return (len > 0 && len <= avail) ? len : 0;
+}
+
+void *
+tlv_view_next (struct tlv_view *view)
+{
+  u_char type, length;
+  u_char *entry;
+  int len;
+
+  for (;;)
+    {
+      if (view->entry < view->value_end)
+        {
+          len = tlv_entry_len (view->type, view->entry,
+                               view->value_end - view->entry);
+          if (len)
+            {
+              entry = view->entry;
+              view->entry += len;
+              return entry;
+            }
+          view->entry = view->value_end;
+        }
+
+      /* on to the next TLV of the type */
+      for (;;)
+        {
+          if (view->pnt + 2 > view->end)
+            return NULL;
+          type = view->pnt[0];
+          length = view->pnt[1];
+          if (view->pnt + 2 + length > view->end)
+            {
+              view->pnt = view->end;
+              return NULL;
+            }
+          view->entry = view->pnt + 2;
+          view->pnt = view->value_end = view->entry + length;
+          if (type == view->type)
+            break;
+        }
+
+      /* IS neighbours start with the virtual flag */
+      if (view->type == IS_NEIGHBOURS && view->entry < view->value_end)
+        view->entry++;
+    }
+}
+
 int
 add_tlv (u_char tag, u_char len, u_char * value, struct stream *stream)
 {
@@ -827,6 +956,8 @@ tlv_add_is_neighs (struct list *is_neighs, struct stream *stream)
 	  if (retval != ISIS_OK)
 	    return retval;
 	  pos = value;
+	  *pos = 0;		/* each TLV starts with the virtual flag */
+	  pos++;
 	}
       *pos = is_neigh->metrics.metric_default;
       pos++;
@@ -994,6 +1125,7 @@ tlv_add_lsp_entries (struct list *lsps, struct stream *stream)
 	    return retval;
 	  pos = value;
 	}
+      lsp_set_time (lsp);
       *((u_int16_t *) pos) = lsp->lsp_header->rem_lifetime;
       pos += 2;
       memcpy (pos, lsp->lsp_header->lsp_id, ISIS_SYS_ID_LEN + 2);
@@ -302,11 +302,29 @@ struct tlvs
 #define TLVFLAG_CHECKSUM                  (1<<20)
 #define TLVFLAG_GRACEFUL_RESTART          (1<<21)
 
+/*
+ * View of the entries of one type of TLV in a PDU, walked in place: no
+ * list is built and nothing is copied.  Each entry tlv_view_next () returns
+ * points into the PDU, as one of the structs above, and lies within its
+ * TLV.  Malformed entries end the walk of their TLV.
+ */
+struct tlv_view
+{
+  u_char type;
+  u_char *pnt;			/* next TLV */
+  u_char *end;			/* end of the TLVs */
+  u_char *entry;		/* next entry in the current TLV */
+  u_char *value_end;		/* end of the current TLV */
+};
+
 void init_tlvs (struct tlvs *tlvs, uint32_t expected);
 void free_tlvs (struct tlvs *tlvs);
 int parse_tlvs (char *areatag, u_char * stream, int size,
 		u_int32_t * expected, u_int32_t * found, struct tlvs *tlvs,
                 u_int32_t * auth_tlv_offset);
+void tlv_view_init (struct tlv_view *view, u_char type, u_char *tlvs,
+                    int size);
+void *tlv_view_next (struct tlv_view *view);
 int add_tlv (u_char, u_char, u_char *, struct stream *);
 void free_tlv (void *val);
 
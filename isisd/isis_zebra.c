@@ -317,7 +317,7 @@ isis_zebra_route_add_ipv4 (struct prefix *prefix,
 	stream_putl (stream, route_info->cost);
 
       stream_putw_at (stream, 0, stream_get_endp (stream));
-      zclient_send_message(zclient);
+      zclient_send_route(zclient);
       SET_FLAG (route_info->flag, ISIS_ROUTE_FLAG_ZEBRA_SYNCED);
       UNSET_FLAG (route_info->flag, ISIS_ROUTE_FLAG_ZEBRA_RESYNC);
     }
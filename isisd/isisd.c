@@ -135,7 +135,6 @@ isis_area_create (const char *area_tag)
 
   area->circuit_list = list_new ();
   area->area_addrs = list_new ();
-  THREAD_TIMER_ON (master, area->t_tick, lsp_tick, area, 1);
   flags_initialize (&area->flags);
 
   /*
@@ -279,7 +278,6 @@ isis_area_destroy (struct vty *vty, const char *area_tag)
     }
   area->area_addrs = NULL;
 
-  THREAD_TIMER_OFF (area->t_tick);
   THREAD_TIMER_OFF (area->t_lsp_refresh[0]);
   THREAD_TIMER_OFF (area->t_lsp_refresh[1]);
 
@@ -75,7 +75,6 @@ struct isis_area
   unsigned int lsp_mtu;				  /* Size of LSPs to generate */
   struct list *circuit_list;	/* IS-IS circuits */
   struct flags flags;
-  struct thread *t_tick;	/* LSP walker */
   struct thread *t_lsp_refresh[ISIS_LEVELS];
   /* t_lsp_refresh is used in two ways:
    * a) regular refresh of LSPs
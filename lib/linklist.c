@@ -25,7 +25,7 @@
 #include "memory.h"
 
 DEFINE_MTYPE_STATIC(LIB, LINK_LIST, "Link List")
-DEFINE_MTYPE_STATIC(LIB, LINK_NODE, "Link Node")
+DEFINE_MTYPE_STATIC_SLAB(LIB, LINK_NODE, "Link Node")
 
 /* Allocate new list. */
 struct list *
@@ -989,6 +989,10 @@ static const struct zebra_desc_table command_types[] = {
   DESC_ENTRY	(ZEBRA_IPV6_NEXTHOP_ADD),
   DESC_ENTRY	(ZEBRA_IPV6_NEXTHOP_DELETE),
   DESC_ENTRY    (ZEBRA_IPMR_ROUTE_STATS),
+  DESC_ENTRY	(ZEBRA_IPV4_ROUTE_BULK_ADD),
+  DESC_ENTRY	(ZEBRA_IPV4_ROUTE_BULK_DELETE),
+  DESC_ENTRY	(ZEBRA_IPV6_ROUTE_BULK_ADD),
+  DESC_ENTRY	(ZEBRA_IPV6_ROUTE_BULK_DELETE),
 };
 #undef DESC_ENTRY
 
@@ -17,6 +17,7 @@
 #include <zebra.h>
 
 #include <stdlib.h>
+#include <sys/mman.h>
 
 #include "memory.h"
 
@@ -43,6 +44,202 @@ mt_count_free (struct memtype *mt)
   mt->n_alloc--;
 }
 
+/* Slab pages are aligned on their size, so the page of an object is found
+ * from its address.  Each page keeps a list of the objects freed back to
+ * it, and hands out the ones never used from the end of that list.  Pages
+ * with free objects are on the slab's partial list; a page that empties
+ * goes back to a pool shared by all slabs, but for one kept spare so that
+ * an object allocated and freed over and over doesn't keep a page coming
+ * and going.
+ *
+ * Pages are cut from chunks mmap()ed from the system: malloc() can only
+ * align them by wasting about as much memory again.  The memory of pages
+ * in the pool is given back to the system, the pages stay mapped.
+ */
+struct memslab_page
+{
+  struct memslab *slab;
+  struct memslab_page *next, *prev;
+  void *free;
+  char *fresh;
+  size_t inuse;
+};
+
+#define MEMSLAB_ALIGN	sizeof (void *)
+#define MEMSLAB_HDR \
+  ((sizeof (struct memslab_page) + MEMSLAB_ALIGN - 1) & ~(MEMSLAB_ALIGN - 1))
+
+#define MEMSLAB_CHUNK_PAGES 64
+
+/* The pool is kept apart from the pages, so none of their memory has to
+   stay. */
+static struct
+{
+  void **pages;
+  size_t count, size;
+} memslab_pool;
+
+static void
+memslab_page_put (void *page)
+{
+  void **pages;
+
+  if (memslab_pool.count == memslab_pool.size)
+    {
+      pages = realloc (memslab_pool.pages, (memslab_pool.size + 256)
+                       * sizeof (void *));
+      /* Without room to remember it, the page is only lost. */
+      if (pages == NULL)
+        return;
+      memslab_pool.pages = pages;
+      memslab_pool.size += 256;
+    }
+  memslab_pool.pages[memslab_pool.count++] = page;
+}
+
+static struct memslab_page *
+memslab_page_get (void)
+{
+  size_t len = (MEMSLAB_CHUNK_PAGES + 1) * MEMSLAB_PAGE_SIZE;
+  uintptr_t head;
+  char *chunk;
+  int i;
+
+  if (memslab_pool.count)
+    return memslab_pool.pages[--memslab_pool.count];
+
+  chunk = mmap (NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON,
+                -1, 0);
+  if (chunk == MAP_FAILED)
+    return NULL;
+
+  /* One page more than needed was mapped, trim it to aligned pages. */
+  head = -(uintptr_t) chunk & (MEMSLAB_PAGE_SIZE - 1);
+  if (head)
+    munmap (chunk, head);
+  munmap (chunk + head + MEMSLAB_CHUNK_PAGES * MEMSLAB_PAGE_SIZE,
+          MEMSLAB_PAGE_SIZE - head);
+  chunk += head;
+
+  for (i = MEMSLAB_CHUNK_PAGES - 1; i > 0; i--)
+    memslab_page_put (chunk + i * MEMSLAB_PAGE_SIZE);
+  return (struct memslab_page *) chunk;
+}
+
+static void
+memslab_page_release (struct memslab_page *pg)
+{
+#ifdef MADV_DONTNEED
+  madvise (pg, MEMSLAB_PAGE_SIZE, MADV_DONTNEED);
+#endif
+  memslab_page_put (pg);
+}
+
+static inline int
+memslab_page_full (struct memslab *ms, struct memslab_page *pg)
+{
+  return pg->free == NULL
+         && pg->fresh + ms->objsize > (char *) pg + MEMSLAB_PAGE_SIZE;
+}
+
+static void
+memslab_link (struct memslab *ms, struct memslab_page *pg)
+{
+  pg->prev = NULL;
+  pg->next = ms->partial;
+  if (ms->partial)
+    ms->partial->prev = pg;
+  ms->partial = pg;
+}
+
+static void
+memslab_unlink (struct memslab *ms, struct memslab_page *pg)
+{
+  if (pg->next)
+    pg->next->prev = pg->prev;
+  if (pg->prev)
+    pg->prev->next = pg->next;
+  else
+    ms->partial = pg->next;
+}
+
+static void *
+memslab_alloc (struct memslab *ms, size_t size)
+{
+  struct memslab_page *pg;
+  void *obj;
+
+  if (ms->objsize == 0)
+    {
+      ms->objsize = MAX (size, sizeof (void *));
+      ms->objsize = (ms->objsize + MEMSLAB_ALIGN - 1) & ~(MEMSLAB_ALIGN - 1);
+      assert (ms->objsize * 8 <= MEMSLAB_PAGE_SIZE - MEMSLAB_HDR);
+    }
+  assert (size <= ms->objsize);
+
+  if ((pg = ms->partial) == NULL)
+    {
+      if ((pg = ms->spare) != NULL)
+        ms->spare = NULL;
+      else
+        {
+          if ((pg = memslab_page_get ()) == NULL)
+            return NULL;
+          pg->slab = ms;
+          pg->free = NULL;
+          pg->fresh = (char *) pg + MEMSLAB_HDR;
+          pg->inuse = 0;
+          ms->pages++;
+        }
+      memslab_link (ms, pg);
+    }
+
+  if ((obj = pg->free) != NULL)
+    pg->free = *(void **) obj;
+  else
+    {
+      obj = pg->fresh;
+      pg->fresh += ms->objsize;
+    }
+  pg->inuse++;
+
+  if (memslab_page_full (ms, pg))
+    memslab_unlink (ms, pg);
+  return obj;
+}
+
+static void
+memslab_free (struct memslab *ms, void *ptr)
+{
+  struct memslab_page *pg;
+
+  pg = (struct memslab_page *)
+    ((uintptr_t) ptr & ~(uintptr_t) (MEMSLAB_PAGE_SIZE - 1));
+  assert (pg->slab == ms);
+
+  if (memslab_page_full (ms, pg))
+    memslab_link (ms, pg);
+
+  *(void **) ptr = pg->free;
+  pg->free = ptr;
+
+  if (--pg->inuse > 0)
+    return;
+
+  memslab_unlink (ms, pg);
+  if (ms->spare == NULL)
+    {
+      pg->free = NULL;
+      pg->fresh = (char *) pg + MEMSLAB_HDR;
+      ms->spare = pg;
+    }
+  else
+    {
+      memslab_page_release (pg);
+      ms->pages--;
+    }
+}
+
 static inline void *
 mt_checkalloc (struct memtype *mt, void *ptr, size_t size)
 {
@@ -58,18 +255,34 @@ mt_checkalloc (struct memtype *mt, void *ptr, size_t size)
 void *
 qmalloc (struct memtype *mt, size_t size)
 {
+  if (mt->slab)
+    return mt_checkalloc (mt, memslab_alloc (mt->slab, size), size);
   return mt_checkalloc (mt, malloc (size), size);
 }
 
 void *
 qcalloc (struct memtype *mt, size_t size)
 {
+  void *ptr;
+
+  if (mt->slab)
+    {
+      ptr = mt_checkalloc (mt, memslab_alloc (mt->slab, size), size);
+      return memset (ptr, 0, size);
+    }
   return mt_checkalloc (mt, calloc (size, 1), size);
 }
 
 void *
 qrealloc (struct memtype *mt, void *ptr, size_t size)
 {
+  if (mt->slab)
+    {
+      if (ptr == NULL)
+        return qmalloc (mt, size);
+      assert (size <= mt->slab->objsize);
+      return ptr;
+    }
   if (ptr)
     mt_count_free (mt);
   return mt_checkalloc (mt, ptr ? realloc (ptr, size) : malloc (size), size);
@@ -78,15 +291,20 @@ qrealloc (struct memtype *mt, void *ptr, size_t size)
 void *
 qstrdup (struct memtype *mt, const char *str)
 {
+  assert (mt->slab == NULL);
   return mt_checkalloc (mt, strdup (str), strlen (str) + 1);
 }
 
 void
 qfree (struct memtype *mt, void *ptr)
 {
-  if (ptr)
-    mt_count_free (mt);
-  free (ptr);
+  if (!ptr)
+    return;
+  mt_count_free (mt);
+  if (mt->slab)
+    memslab_free (mt->slab, ptr);
+  else
+    free (ptr);
 }
 
 int
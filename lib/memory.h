@@ -22,12 +22,23 @@
 #define array_size(ar) (sizeof(ar) / sizeof(ar[0]))
 
 #define SIZE_VAR ~0UL
+
+/* Object cache of a fixed size MTYPE, see DEFINE_MTYPE_SLAB. */
+struct memslab
+{
+  size_t objsize;
+  struct memslab_page *partial;
+  struct memslab_page *spare;
+  size_t pages;
+};
+
 struct memtype
 {
   struct memtype *next, **ref;
   const char *name;
   size_t n_alloc;
   size_t size;
+  struct memslab *slab;
 };
 
 struct memgroup
@@ -124,11 +135,12 @@ struct memgroup
 	extern struct memtype _mt_##name; \
 	static struct memtype * const MTYPE_ ## name = &_mt_##name;
 
-#define DEFINE_MTYPE_ATTR(group, mname, attr, desc) \
+#define DEFINE_MTYPE_ATTR(group, mname, attr, desc, slabp) \
 	attr struct memtype _mt_##mname \
 	__attribute__ ((section (".data.mtypes"))) = { \
 		.name = desc, \
 		.next = NULL, .n_alloc = 0, .size = 0, .ref = NULL, \
+		.slab = slabp, \
 	}; \
 	static void _mtinit_##mname (void) \
 	  __attribute__ ((_CONSTRUCTOR (1001))); \
@@ -146,11 +158,27 @@ struct memgroup
 		*_mt_##mname.ref = _mt_##mname.next; }
 
 #define DEFINE_MTYPE(group, name, desc) \
-	DEFINE_MTYPE_ATTR(group, name, , desc)
+	DEFINE_MTYPE_ATTR(group, name, , desc, NULL)
 #define DEFINE_MTYPE_STATIC(group, name, desc) \
-	DEFINE_MTYPE_ATTR(group, name, static, desc) \
+	DEFINE_MTYPE_ATTR(group, name, static, desc, NULL) \
 	static struct memtype * const MTYPE_ ## name = &_mt_##name;
 
+/* An MTYPE whose objects all have the same size, taken from the first
+ * allocation, and are carved out of pages of MEMSLAB_PAGE_SIZE rather than
+ * each malloc()ed.  Allocations may be smaller than that size, never
+ * larger; XREALLOC can't grow them and XSTRDUP can't be used.  Like the
+ * rest of qmem, this is for the main thread only.
+ */
+#define DEFINE_MTYPE_SLAB(group, name, desc) \
+	static struct memslab _ms_##name; \
+	DEFINE_MTYPE_ATTR(group, name, , desc, &_ms_##name)
+#define DEFINE_MTYPE_STATIC_SLAB(group, name, desc) \
+	static struct memslab _ms_##name; \
+	DEFINE_MTYPE_ATTR(group, name, static, desc, &_ms_##name) \
+	static struct memtype * const MTYPE_ ## name = &_mt_##name;
+
+#define MEMSLAB_PAGE_SIZE 16384
+
 DECLARE_MGROUP(LIB)
 DECLARE_MTYPE(TMP)
 
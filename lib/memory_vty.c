@@ -84,12 +84,17 @@ static int qmem_walker(void *arg, struct memgroup *mg, struct memtype *mt)
 	else {
 		if (mt->n_alloc != 0) {
 			char size[32];
+			char slab[48] = "";
 			snprintf(size, sizeof(size), "%6zu", mt->size);
-			vty_out (vty, "%-30s: %10zu  %s%s",
+			if (mt->slab)
+				snprintf(slab, sizeof(slab),
+					 "  in %zu pages of %d",
+					 mt->slab->pages, MEMSLAB_PAGE_SIZE);
+			vty_out (vty, "%-30s: %10zu  %s%s%s",
 				 mt->name, mt->n_alloc,
 				 mt->size == 0 ? "" :
 				 mt->size == SIZE_VAR ? "(variably sized)" :
-				 size, VTY_NEWLINE);
+				 size, slab, VTY_NEWLINE);
 		}
 	}
 	return 0;
@@ -33,7 +33,7 @@
 #include "nexthop.h"
 #include "mpls.h"
 
-DEFINE_MTYPE_STATIC(LIB, NEXTHOP,	"Nexthop")
+DEFINE_MTYPE_STATIC_SLAB(LIB, NEXTHOP,	"Nexthop")
 DEFINE_MTYPE_STATIC(LIB, NH_LABEL,	"Nexthop label")
 
 /* check if nexthops are same, non-recursive */
@@ -661,10 +661,11 @@ struct route_map_list
   void (*add_hook) (const char *);
   void (*delete_hook) (const char *);
   void (*event_hook) (route_map_event_t, const char *);
+  void (*cache_hook) (void *);
 };
 
 /* Master list of route map. */
-static struct route_map_list route_map_master = { NULL, NULL, NULL, NULL, NULL };
+static struct route_map_list route_map_master = { NULL, NULL, NULL, NULL, NULL, NULL };
 struct hash *route_map_master_hash = NULL;
 
 static unsigned int
@@ -736,6 +737,15 @@ static int rmap_debug = 0;
 static void
 route_map_index_delete (struct route_map_index *, int);
 
+/* Forget the cached results of MAP, and whether it may be cached. */
+static void
+route_map_cache_flush (struct route_map *map)
+{
+  map->cacheable = -1;
+  if (map->cache)
+    hash_clean (map->cache, route_map_master.cache_hook);
+}
+
 /* New route map allocation. Please note route map's name must be
    specified. */
 static struct route_map *
@@ -745,6 +755,7 @@ route_map_new (const char *name)
 
   new =  XCALLOC (MTYPE_ROUTE_MAP, sizeof (struct route_map));
   new->name = XSTRDUP (MTYPE_ROUTE_MAP_NAME, name);
+  new->cacheable = -1;
   QOBJ_REG (new, route_map);
   return new;
 }
@@ -819,6 +830,11 @@ route_map_free_map (struct route_map *map)
 	list->head = map->next;
 
       hash_release(route_map_master_hash, map);
+      if (map->cache)
+        {
+          route_map_cache_flush (map);
+          hash_free (map->cache);
+        }
       XFREE (MTYPE_ROUTE_MAP_NAME, map->name);
       XFREE (MTYPE_ROUTE_MAP, map);
     }
@@ -898,6 +914,7 @@ route_map_mark_updated (const char *name, int del_later)
   if (map)
     {
       map->to_be_processed = 1;
+      route_map_cache_flush (map);
       ret = 0;
     }
 
@@ -1112,6 +1129,8 @@ route_map_index_delete (struct route_map_index *index, int notify)
   if (index->nextrm)
     XFREE (MTYPE_ROUTE_MAP_NAME, index->nextrm);
 
+  route_map_cache_flush (index->map);
+
     /* Execute event hook. */
   if (route_map_master.event_hook && notify)
     {
@@ -1179,6 +1198,7 @@ route_map_index_add (struct route_map *map, enum route_map_type type,
 	point->prev->next = index;
       point->prev = index;
     }
+  route_map_cache_flush (map);
 
   /* Execute event hook. */
   if (route_map_master.event_hook)
@@ -1341,6 +1361,57 @@ route_map_get_match_arg(struct route_map_index *index, const char *match_name)
   return (NULL);
 }
 
+/* The same for the argument of a set rule. */
+const char *
+route_map_get_set_arg(struct route_map_index *index, const char *set_name)
+{
+  struct route_map_rule *rule;
+  struct route_map_rule_cmd *cmd;
+
+  cmd = route_map_lookup_set (set_name);
+  if (cmd == NULL)
+    return NULL;
+
+  for (rule = index->set_list.head; rule; rule = rule->next)
+    if (rule->cmd == cmd && rule->rule_str != NULL)
+      return (rule->rule_str);
+
+  return (NULL);
+}
+
+/* Whether a match or set rule called RULE_NAME in the route-map
+ * RMAP_NAME has an argument starting with the word NAME.  Dependencies
+ * only record the map, so this tells if one is still needed when a
+ * rule goes away.
+ */
+int
+route_map_rule_names (const char *rmap_name, const char *rule_name,
+		      const char *name)
+{
+  struct route_map *map;
+  struct route_map_index *index;
+  struct route_map_rule *rule;
+  size_t len = strlen (name);
+
+  if ((map = route_map_lookup_by_name (rmap_name)) == NULL)
+    return 0;
+
+  for (index = map->head; index; index = index->next)
+    {
+      for (rule = index->match_list.head; rule; rule = rule->next)
+	if (strcmp (rule->cmd->str, rule_name) == 0 && rule->rule_str
+	    && strncmp (rule->rule_str, name, len) == 0
+	    && (rule->rule_str[len] == '\0' || rule->rule_str[len] == ' '))
+	  return 1;
+      for (rule = index->set_list.head; rule; rule = rule->next)
+	if (strcmp (rule->cmd->str, rule_name) == 0 && rule->rule_str
+	    && strncmp (rule->rule_str, name, len) == 0
+	    && (rule->rule_str[len] == '\0' || rule->rule_str[len] == ' '))
+	  return 1;
+    }
+  return 0;
+}
+
 /* Add match statement to route map. */
 int
 route_map_add_match (struct route_map_index *index, const char *match_name,
@@ -1389,6 +1460,7 @@ route_map_add_match (struct route_map_index *index, const char *match_name,
 
   /* Add new route match rule to linked list. */
   route_map_rule_add (&index->match_list, rule);
+  route_map_cache_flush (index->map);
 
   /* Execute event hook. */
   if (route_map_master.event_hook)
@@ -1420,6 +1492,7 @@ route_map_delete_match (struct route_map_index *index, const char *match_name,
 	(rulecmp (rule->rule_str, match_arg) == 0 || match_arg == NULL))
       {
 	route_map_rule_delete (&index->match_list, rule);
+	route_map_cache_flush (index->map);
 	/* Execute event hook. */
 	if (route_map_master.event_hook)
 	  {
@@ -1482,6 +1555,7 @@ route_map_add_set (struct route_map_index *index, const char *set_name,
 
   /* Add new route match rule to linked list. */
   route_map_rule_add (&index->set_list, rule);
+  route_map_cache_flush (index->map);
 
   /* Execute event hook. */
   if (route_map_master.event_hook)
@@ -1512,6 +1586,7 @@ route_map_delete_set (struct route_map_index *index, const char *set_name,
          (rulecmp (rule->rule_str, set_arg) == 0 || set_arg == NULL))
       {
         route_map_rule_delete (&index->set_list, rule);
+	route_map_cache_flush (index->map);
 	/* Execute event hook. */
 	if (route_map_master.event_hook)
 	  {
@@ -1714,6 +1789,56 @@ route_map_event_hook (void (*func) (route_map_event_t, const char *))
   route_map_master.event_hook = func;
 }
 
+/* Function freeing the entries the daemon put in a map's cache. */
+void
+route_map_cache_hook (void (*func) (void *))
+{
+  route_map_master.cache_hook = func;
+}
+
+static int
+route_map_rule_list_attr_only (struct route_map_rule_list *list)
+{
+  struct route_map_rule *rule;
+
+  for (rule = list->head; rule; rule = rule->next)
+    if (! rule->cmd->func_attr_only
+        || ! (*rule->cmd->func_attr_only) (rule->value))
+      return 0;
+  return 1;
+}
+
+/* Whether the outcome of applying MAP only depends on the attributes of
+   the object, so that the daemon may cache it in MAP->cache, per set of
+   attributes.  Maps calling other maps are never cacheable, as they are
+   not told when the called map changes. */
+int
+route_map_cacheable (struct route_map *map)
+{
+  struct route_map_index *index;
+
+  if (map->cacheable >= 0)
+    return map->cacheable;
+
+  map->cacheable = 1;
+  for (index = map->head; index; index = index->next)
+    if (index->nextrm
+        || ! route_map_rule_list_attr_only (&index->match_list)
+        || ! route_map_rule_list_attr_only (&index->set_list))
+      {
+        map->cacheable = 0;
+        break;
+      }
+  return map->cacheable;
+}
+
+/* func_attr_only for rules which never look beyond the attributes. */
+int
+route_map_rule_attr_only (void *rule)
+{
+  return 1;
+}
+
 /* Routines for route map dependency lists and dependency processing */
 static int
 route_map_rmap_hash_cmp (const void *p1, const void *p2)
@@ -1921,6 +2046,7 @@ static void
 route_map_process_dependency (struct hash_backet *backet, void *data)
 {
   char *rmap_name;
+  struct route_map *map;
   route_map_event_t type = (route_map_event_t)(ptrdiff_t)data;
 
   rmap_name = (char *)backet->data;
@@ -1930,6 +2056,10 @@ route_map_process_dependency (struct hash_backet *backet, void *data)
       if (rmap_debug)
 	zlog_debug("%s: Notifying %s of dependency", __FUNCTION__,
 		   rmap_name);
+      /* Whatever the daemon does with the event, what the map made of
+         its objects may have changed. */
+      if ((map = route_map_lookup_by_name (rmap_name)) != NULL)
+	route_map_cache_flush (map);
       if (route_map_master.event_hook)
 	(*route_map_master.event_hook) (type, rmap_name);
     }
@@ -2644,6 +2774,7 @@ DEFUN (rmap_onmatch_next,
 	  return CMD_WARNING;
         }
       index->exitpolicy = RMAP_NEXT;
+      route_map_cache_flush (index->map);
     }
   return CMD_SUCCESS;
 }
@@ -2658,7 +2789,10 @@ DEFUN (no_rmap_onmatch_next,
   struct route_map_index *index = VTY_GET_CONTEXT (route_map_index);
   
   if (index)
-    index->exitpolicy = RMAP_EXIT;
+    {
+      index->exitpolicy = RMAP_EXIT;
+      route_map_cache_flush (index->map);
+    }
 
   return CMD_SUCCESS;
 }
@@ -2703,6 +2837,7 @@ DEFUN (rmap_onmatch_goto,
 	{
 	  index->exitpolicy = RMAP_GOTO;
 	  index->nextpref = d;
+	  route_map_cache_flush (index->map);
 	}
     }
   return CMD_SUCCESS;
@@ -2718,7 +2853,10 @@ DEFUN (no_rmap_onmatch_goto,
   struct route_map_index *index = VTY_GET_CONTEXT (route_map_index);
 
   if (index)
-    index->exitpolicy = RMAP_EXIT;
+    {
+      index->exitpolicy = RMAP_EXIT;
+      route_map_cache_flush (index->map);
+    }
   
   return CMD_SUCCESS;
 }
@@ -2778,6 +2916,7 @@ DEFUN (rmap_call,
       XFREE (MTYPE_ROUTE_MAP_NAME, index->nextrm);
     }
   index->nextrm = XSTRDUP (MTYPE_ROUTE_MAP_NAME, rmap);
+  route_map_cache_flush (index->map);
 
   /* Execute event hook. */
   route_map_upd8_dependency (RMAP_EVENT_CALL_ADDED,
@@ -2801,6 +2940,7 @@ DEFUN (no_rmap_call,
 				 index->map->name);
       XFREE (MTYPE_ROUTE_MAP_NAME, index->nextrm);
       index->nextrm = NULL;
+      route_map_cache_flush (index->map);
     }
 
   return CMD_SUCCESS;
@@ -108,6 +108,11 @@ struct route_map_rule_cmd
 
   /* Free allocated value by func_compile (). */
   void (*func_free)(void *);
+
+  /* Whether the compiled rule looks at nothing but the object's own
+     attributes: not at the prefix, nor at the peer or anything else.
+     Rules without it are assumed to. */
+  int (*func_attr_only)(void *);
 };
 
 /* Route map apply error. */
@@ -178,6 +183,11 @@ struct route_map
   int to_be_processed;	 /* True if modification isn't acted on yet */
   int deleted;		 /* If 1, then this node will be deleted */
 
+  /* Results of applying the map, kept by the daemon when the map is
+     cacheable, and emptied whenever the map is updated. */
+  struct hash *cache;
+  int cacheable;	 /* -1 if not known yet */
+
   QOBJ_FIELDS
 };
 DECLARE_QOBJ_TYPE(route_map)
@@ -199,6 +209,12 @@ extern int route_map_delete_match (struct route_map_index *index,
 extern const char *route_map_get_match_arg (struct route_map_index *index,
 					    const char *match_name);
 
+extern const char *route_map_get_set_arg (struct route_map_index *index,
+					  const char *set_name);
+
+extern int route_map_rule_names (const char *rmap_name, const char *rule_name,
+				 const char *name);
+
 /* Add route-map set statement to the route map. */
 extern int route_map_add_set (struct route_map_index *index, 
 		              const char *set_name,
@@ -228,6 +244,9 @@ extern void route_map_add_hook (void (*func) (const char *));
 extern void route_map_delete_hook (void (*func) (const char *));
 extern void route_map_event_hook (void (*func) (route_map_event_t,
 						const char *));
+extern void route_map_cache_hook (void (*func) (void *));
+extern int route_map_cacheable (struct route_map *map);
+extern int route_map_rule_attr_only (void *rule);
 extern int route_map_mark_updated (const char *name, int deleted);
 extern int route_map_clear_updated (struct route_map *rmap);
 extern void route_map_walk_update_list (int (*update_fn) (char *name));
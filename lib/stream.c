@@ -29,7 +29,7 @@
 #include "prefix.h"
 #include "log.h"
 
-DEFINE_MTYPE_STATIC(LIB, STREAM,      "Stream")
+DEFINE_MTYPE_STATIC_SLAB(LIB, STREAM,      "Stream")
 DEFINE_MTYPE_STATIC(LIB, STREAM_DATA, "Stream data")
 DEFINE_MTYPE_STATIC(LIB, STREAM_FIFO, "Stream FIFO")
 
@@ -1087,6 +1087,20 @@ stream_reset (struct stream *s)
   s->getp = s->endp = 0;
 }
 
+/* Discard the data that has already been read, moving whatever is
+   still unread to the beginning of the stream. */
+void
+stream_pulldown (struct stream *s)
+{
+  size_t rlen = STREAM_READABLE (s);
+
+  STREAM_VERIFY_SANE (s);
+
+  memmove (s->data, s->data + s->getp, rlen);
+  s->getp = 0;
+  s->endp = rlen;
+}
+
 /* Write stream contens to the file discriptor. */
 int
 stream_flush (struct stream *s, int fd)
@@ -28,10 +28,13 @@
 #include "sockunion.h"
 
 DEFINE_MTYPE(       LIB, ROUTE_TABLE, "Route table")
-DEFINE_MTYPE_STATIC(LIB, ROUTE_NODE,  "Route node")
+DEFINE_MTYPE_STATIC_SLAB(LIB, ROUTE_NODE,  "Route node")
+DEFINE_MTYPE_STATIC(LIB, ROUTE_LPM,       "Route table index")
+DEFINE_MTYPE_STATIC(LIB, ROUTE_LPM_CHUNK, "Route table index chunk")
 
 static void route_node_delete (struct route_node *);
 static void route_table_free (struct route_table *);
+static void route_lpm_free (struct route_lpm *);
 
 
 /*
@@ -91,6 +94,9 @@ route_table_free (struct route_table *rt)
   if (rt == NULL)
     return;
 
+  if (rt->lpm)
+    route_lpm_free (rt->lpm);
+
   node = rt->top;
 
   /* Bulk deletion of nodes remaining in this table.  This function is not
@@ -186,6 +192,508 @@ set_link (struct route_node *node, struct route_node *new)
   new->parent = node;
 }
 
+/*
+ * Longest-match index.
+ *
+ * route_node_match() walks the radix tree a bit at a time, and every
+ * level costs a full route_node and a prefix compare.  A table can keep,
+ * next to the tree, a compressed multibit trie in the style of Poptrie
+ * (Asai and Ohara, SIGCOMM 2015), which finds the deepest node covering
+ * an address in a few cache lines:
+ *
+ * - the first LPM_DIR_BITS bits of the address index a direct array.
+ *   An entry is either the answer itself, when no node under it is longer
+ *   than LPM_DIR_BITS, or a chunk tagged with LPM_CHUNK;
+ *
+ * - a chunk is the trie for that part of the address space, in a single
+ *   allocation.  A trie node takes LPM_STRIDE bits, and has a bitmap of
+ *   its slots that go on to a child node and a bitmap of the slots that
+ *   start a run of equal leaves.  Its children and its leaves are stored
+ *   next to each other, and are found by a popcount of the bitmaps.
+ *
+ * The tree stays the authority, and the index is a cache of its shape
+ * only: it never looks at node->info, the match walks up from the node
+ * it finds to the nearest one with info, like the tree walk would.
+ *
+ * A node which comes or goes marks the direct entry it falls under as
+ * dirty.  Matches under a dirty entry walk the tree, until they have cost
+ * about as much as rebuilding the entry, so a burst of updates to a busy
+ * part of the table is not followed by a rebuild per match.  Nodes
+ * shorter than LPM_DIR_BITS span several entries, and are rare, so those
+ * patch the leaves in place instead.
+ *
+ * The index keeps IPv4 keys as IPv6 ones with the low bits zero, and
+ * only works for tables which hold a single address family.
+ */
+#define LPM_DIR_BITS	16	/* lpm_build_slot() relies on 16 */
+#define LPM_DIR_SIZE	(1 << LPM_DIR_BITS)
+#define LPM_STRIDE	6
+#define LPM_SLOTS	(1 << LPM_STRIDE)
+#define LPM_CHUNK	((uintptr_t) 1)
+
+struct lpm_node
+{
+  u_int64_t vector;		/* slots going on to a child node */
+  u_int64_t leafvec;		/* slots starting a run of equal leaves */
+  u_int32_t base0;		/* index of the first leaf */
+  u_int32_t base1;		/* index of the first child node */
+};
+
+struct lpm_chunk
+{
+  struct lpm_node *nodes;
+  struct route_node **leaves;
+  u_int32_t nnodes;
+  u_int32_t nleaves;
+
+  /* Matches walking the tree since the chunk went dirty. */
+  u_int32_t misses;
+};
+
+struct route_lpm
+{
+  int family;
+
+  /* Direct array, allocated at the first match. */
+  uintptr_t *dir;
+
+  /* Direct entries which no longer reflect the tree. */
+  u_int64_t dirty[LPM_DIR_SIZE / 64];
+
+  /* Scratch space for building a chunk. */
+  struct lpm_node *nodes;
+  struct route_node **leaves;
+  u_int32_t nnodes, nodes_size;
+  u_int32_t nleaves, leaves_size;
+};
+
+#define LPM_DIRTY(L,I)	((L)->dirty[(I) / 64] & (1ULL << ((I) % 64)))
+
+/* Does 'key' match the first 'len' bits of 'prefix'? */
+static int
+lpm_match (const u_char *prefix, const u_char *key, int len)
+{
+  int bytes = len / 8;
+
+  if (memcmp (prefix, key, bytes))
+    return 0;
+  if ((len % 8) && ((prefix[bytes] ^ key[bytes]) & maskbit[len % 8]))
+    return 0;
+  return 1;
+}
+
+/* Bits 'off' to 'off + n' of 'prefix'. */
+static unsigned int
+lpm_getbits (const u_char *prefix, int off, int n)
+{
+  unsigned int v = 0;
+
+  for (; n > 0; n--, off++)
+    v = (v << 1) | prefix_bit (prefix, off);
+  return v;
+}
+
+/* Bits 'off' to 'off + LPM_STRIDE' of the key (hi, lo), past its end
+   reading as zero. */
+static inline unsigned int
+lpm_bits (u_int64_t hi, u_int64_t lo, unsigned int off)
+{
+  if (off <= 64 - LPM_STRIDE)
+    return (hi >> (64 - LPM_STRIDE - off)) & (LPM_SLOTS - 1);
+  if (off < 64)
+    return ((hi << (off - (64 - LPM_STRIDE)))
+	    | (lo >> (128 - LPM_STRIDE - off))) & (LPM_SLOTS - 1);
+  off -= 64;
+  if (off <= 64 - LPM_STRIDE)
+    return (lo >> (64 - LPM_STRIDE - off)) & (LPM_SLOTS - 1);
+  return (lo << (off - (64 - LPM_STRIDE))) & (LPM_SLOTS - 1);
+}
+
+/* Walk down from 'node' towards the first 'len' bits of 'key', keeping the
+   deepest node covering them in *cover.  If there are nodes longer than
+   'len' under them, returns the node to go on from, else NULL. */
+static struct route_node *
+lpm_descend (struct route_node *node, const u_char *key, int len,
+	     struct route_node **cover)
+{
+  while (node)
+    {
+      int plen = node->p.prefixlen;
+
+      if (plen > len)
+	return lpm_match (&node->p.u.prefix, key, len) ? node : NULL;
+      if (!lpm_match (&node->p.u.prefix, key, plen))
+	return NULL;
+      *cover = node;
+      if (plen == len)
+	return (node->l_left || node->l_right) ? node : NULL;
+      node = node->link[prefix_bit (key, plen)];
+    }
+  return NULL;
+}
+
+/* Fill in the slots for the 'stride' bits from 'off' on, from 'node' and
+   the nodes under it, all of which lie under those slots: in covers[] the
+   deepest node covering a slot, and in subs[] the node to go on from for
+   slots with nodes longer than 'off + stride' under them. */
+static void
+lpm_fill (struct route_node *node, int off, int stride,
+	  struct route_node **covers, struct route_node **subs)
+{
+  int len = off + stride;
+  int plen = node->p.prefixlen;
+  unsigned int first, n, v;
+
+  if (plen > len)
+    {
+      subs[lpm_getbits (&node->p.u.prefix, off, stride)] = node;
+      return;
+    }
+
+  if (plen <= off)
+    {
+      first = 0;
+      n = 1 << stride;
+    }
+  else
+    {
+      n = 1 << (len - plen);
+      first = lpm_getbits (&node->p.u.prefix, off, plen - off) << (len - plen);
+    }
+  for (v = first; v < first + n; v++)
+    covers[v] = node;
+
+  if (plen == len)
+    {
+      if (node->l_left || node->l_right)
+	subs[first] = node;
+      return;
+    }
+  if (node->l_left)
+    lpm_fill (node->l_left, off, stride, covers, subs);
+  if (node->l_right)
+    lpm_fill (node->l_right, off, stride, covers, subs);
+}
+
+static void
+lpm_grow (void **array, u_int32_t *size, u_int32_t need, size_t elem)
+{
+  if (need <= *size)
+    return;
+  while (*size < need)
+    *size = *size ? *size * 2 : 64;
+  *array = XREALLOC (MTYPE_ROUTE_LPM, *array, *size * elem);
+}
+
+/* Build trie node 'idx' for the slots from 'off' on, with their nodes
+   under 'start', and 'cover' covering them. */
+static void
+lpm_build_node (struct route_lpm *lpm, u_int32_t idx, int off,
+		struct route_node *start, struct route_node *cover)
+{
+  struct route_node *covers[LPM_SLOTS];
+  struct route_node *subs[LPM_SLOTS];
+  u_int64_t vector = 0, leafvec = 0;
+  u_int32_t base0, base1, n;
+  unsigned int v;
+
+  for (v = 0; v < LPM_SLOTS; v++)
+    {
+      covers[v] = cover;
+      subs[v] = NULL;
+    }
+  lpm_fill (start, off, LPM_STRIDE, covers, subs);
+  for (v = 0; v < LPM_SLOTS; v++)
+    if (subs[v])
+      vector |= 1ULL << v;
+
+  /* Children first, so that they are contiguous. */
+  base1 = lpm->nnodes;
+  lpm->nnodes += __builtin_popcountll (vector);
+  lpm_grow ((void **) &lpm->nodes, &lpm->nodes_size, lpm->nnodes,
+	    sizeof (struct lpm_node));
+
+  base0 = lpm->nleaves;
+  for (v = 0; v < LPM_SLOTS; v++)
+    {
+      if (vector & (1ULL << v))
+	continue;
+      if (lpm->nleaves == base0 || covers[v] != lpm->leaves[lpm->nleaves - 1])
+	{
+	  lpm_grow ((void **) &lpm->leaves, &lpm->leaves_size,
+		    lpm->nleaves + 1, sizeof (struct route_node *));
+	  lpm->leaves[lpm->nleaves++] = covers[v];
+	  leafvec |= 1ULL << v;
+	}
+    }
+
+  lpm->nodes[idx].vector = vector;
+  lpm->nodes[idx].leafvec = leafvec;
+  lpm->nodes[idx].base0 = base0;
+  lpm->nodes[idx].base1 = base1;
+
+  n = base1;
+  for (v = 0; v < LPM_SLOTS; v++)
+    if (vector & (1ULL << v))
+      lpm_build_node (lpm, n++, off + LPM_STRIDE, subs[v], covers[v]);
+}
+
+static void
+lpm_free_slot (struct route_lpm *lpm, unsigned int i)
+{
+  struct lpm_chunk *chunk;
+
+  if (lpm->dir[i] & LPM_CHUNK)
+    {
+      chunk = (struct lpm_chunk *) (lpm->dir[i] & ~LPM_CHUNK);
+      XFREE (MTYPE_ROUTE_LPM_CHUNK, chunk);
+    }
+  lpm->dir[i] = 0;
+}
+
+/* Set direct entry 'i', from 'start' and the nodes under it, with 'cover'
+   covering all of them. */
+static void
+lpm_set_slot (struct route_lpm *lpm, unsigned int i,
+	      struct route_node *start, struct route_node *cover)
+{
+  struct lpm_chunk *chunk;
+  size_t nodes_len, leaves_len;
+
+  lpm_free_slot (lpm, i);
+  lpm->dirty[i / 64] &= ~(1ULL << (i % 64));
+
+  if (!start)
+    {
+      lpm->dir[i] = (uintptr_t) cover;
+      return;
+    }
+
+  lpm->nnodes = 1;
+  lpm->nleaves = 0;
+  lpm_grow ((void **) &lpm->nodes, &lpm->nodes_size, 1,
+	    sizeof (struct lpm_node));
+  lpm_build_node (lpm, 0, LPM_DIR_BITS, start, cover);
+
+  nodes_len = lpm->nnodes * sizeof (struct lpm_node);
+  leaves_len = lpm->nleaves * sizeof (struct route_node *);
+  chunk = XMALLOC (MTYPE_ROUTE_LPM_CHUNK,
+		   sizeof (*chunk) + nodes_len + leaves_len);
+  chunk->nodes = (struct lpm_node *) (chunk + 1);
+  chunk->leaves = (struct route_node **) ((char *) chunk->nodes + nodes_len);
+  chunk->nnodes = lpm->nnodes;
+  chunk->nleaves = lpm->nleaves;
+  chunk->misses = 0;
+  memcpy (chunk->nodes, lpm->nodes, nodes_len);
+  memcpy (chunk->leaves, lpm->leaves, leaves_len);
+  lpm->dir[i] = (uintptr_t) chunk | LPM_CHUNK;
+}
+
+/* Rebuild direct entry 'i' from the tree. */
+static void
+lpm_build_slot (const struct route_table *table, struct route_lpm *lpm,
+		unsigned int i)
+{
+  u_char key[IPV6_MAX_BYTELEN];
+  struct route_node *cover = NULL;
+  struct route_node *start;
+
+  memset (key, 0, sizeof (key));
+  key[0] = i >> 8;
+  key[1] = i & 0xff;
+  start = lpm_descend (table->top, key, LPM_DIR_BITS, &cover);
+  lpm_set_slot (lpm, i, start, cover);
+}
+
+/* Build the whole index, in one walk over the tree. */
+static void
+lpm_build (const struct route_table *table, struct route_lpm *lpm)
+{
+  struct route_node **covers, **subs;
+  unsigned int i;
+
+  lpm->dir = XCALLOC (MTYPE_ROUTE_LPM, LPM_DIR_SIZE * sizeof (uintptr_t));
+  covers = XCALLOC (MTYPE_TMP, LPM_DIR_SIZE * sizeof (struct route_node *));
+  subs = XCALLOC (MTYPE_TMP, LPM_DIR_SIZE * sizeof (struct route_node *));
+
+  if (table->top)
+    lpm_fill (table->top, 0, LPM_DIR_BITS, covers, subs);
+  for (i = 0; i < LPM_DIR_SIZE; i++)
+    lpm_set_slot (lpm, i, subs[i], covers[i]);
+
+  XFREE (MTYPE_TMP, covers);
+  XFREE (MTYPE_TMP, subs);
+}
+
+/* Patch a leaf for 'node' coming, or going with 'parent' taking its
+   place. */
+static inline void
+lpm_patch_leaf (struct route_node **leaf, struct route_node *node,
+		struct route_node *parent, int add)
+{
+  if (add)
+    {
+      if (!*leaf || (*leaf)->p.prefixlen < node->p.prefixlen)
+	*leaf = node;
+    }
+  else if (*leaf == node)
+    *leaf = parent;
+}
+
+/* The tree gained or lost 'node'. */
+static void
+lpm_node_change (struct route_lpm *lpm, struct route_node *node,
+		 struct route_node *parent, int add)
+{
+  const u_char *prefix = &node->p.u.prefix;
+  struct lpm_chunk *chunk;
+  unsigned int i, first, n;
+  u_int32_t l;
+
+  if (!lpm->dir)
+    return;
+
+  first = (prefix[0] << 8) | prefix[1];
+  if (node->p.prefixlen >= LPM_DIR_BITS)
+    {
+      if (!LPM_DIRTY (lpm, first) && (lpm->dir[first] & LPM_CHUNK))
+	{
+	  chunk = (struct lpm_chunk *) (lpm->dir[first] & ~LPM_CHUNK);
+	  chunk->misses = 0;
+	}
+      lpm->dirty[first / 64] |= 1ULL << (first % 64);
+      return;
+    }
+
+  n = 1 << (LPM_DIR_BITS - node->p.prefixlen);
+  first &= ~(n - 1);
+  for (i = first; i < first + n; i++)
+    {
+      if (LPM_DIRTY (lpm, i))
+	continue;
+      if (lpm->dir[i] & LPM_CHUNK)
+	{
+	  chunk = (struct lpm_chunk *) (lpm->dir[i] & ~LPM_CHUNK);
+	  for (l = 0; l < chunk->nleaves; l++)
+	    lpm_patch_leaf (&chunk->leaves[l], node, parent, add);
+	}
+      else
+	lpm_patch_leaf ((struct route_node **) &lpm->dir[i], node, parent,
+			add);
+    }
+}
+
+/* The deepest node covering the key (hi, lo). */
+static inline struct route_node *
+lpm_lookup (uintptr_t entry, u_int64_t hi, u_int64_t lo)
+{
+  const struct lpm_chunk *chunk;
+  const struct lpm_node *node;
+  unsigned int off, v;
+
+  if (!(entry & LPM_CHUNK))
+    return (struct route_node *) entry;
+
+  chunk = (const struct lpm_chunk *) (entry & ~LPM_CHUNK);
+  node = chunk->nodes;
+  off = LPM_DIR_BITS;
+  v = lpm_bits (hi, lo, off);
+  while (node->vector & (1ULL << v))
+    {
+      node = &chunk->nodes[node->base1
+			   + __builtin_popcountll (node->vector
+						   & ((2ULL << v) - 1)) - 1];
+      off += LPM_STRIDE;
+      v = lpm_bits (hi, lo, off);
+    }
+  return chunk->leaves[node->base0
+		       + __builtin_popcountll (node->leafvec
+					       & ((2ULL << v) - 1)) - 1];
+}
+
+/* Match 'p' in the index.  Returns 0 if the tree has to be walked
+   instead, else the node with info found, if any, in *matched. */
+static int
+lpm_node_match (const struct route_table *table, const struct prefix *p,
+		struct route_node **matched)
+{
+  struct route_lpm *lpm = table->lpm;
+  struct route_node *node;
+  u_int64_t hi = 0, lo = 0;
+  unsigned int i;
+
+  if (p->family == AF_INET)
+    hi = (u_int64_t) ntohl (p->u.prefix4.s_addr) << 32;
+  else
+    for (i = 0; i < 8; i++)
+      {
+	hi = (hi << 8) | p->u.prefix6.s6_addr[i];
+	lo = (lo << 8) | p->u.prefix6.s6_addr[i + 8];
+      }
+
+  if (!lpm->dir)
+    lpm_build (table, lpm);
+
+  i = hi >> (64 - LPM_DIR_BITS);
+  if (LPM_DIRTY (lpm, i))
+    {
+      /* A rebuild costs a few times the trie nodes, and a walk down the
+	 tree about as much as a trie node. */
+      if (lpm->dir[i] & LPM_CHUNK)
+	{
+	  struct lpm_chunk *chunk;
+
+	  chunk = (struct lpm_chunk *) (lpm->dir[i] & ~LPM_CHUNK);
+	  if (++chunk->misses < chunk->nnodes * 4)
+	    return 0;
+	}
+      lpm_build_slot (table, lpm, i);
+    }
+
+  node = lpm_lookup (lpm->dir[i], hi, lo);
+  while (node && (!node->info || node->p.prefixlen > p->prefixlen))
+    node = node->parent;
+
+  *matched = node;
+  return 1;
+}
+
+static void
+route_lpm_free (struct route_lpm *lpm)
+{
+  unsigned int i;
+
+  if (lpm->dir)
+    {
+      for (i = 0; i < LPM_DIR_SIZE; i++)
+	lpm_free_slot (lpm, i);
+      XFREE (MTYPE_ROUTE_LPM, lpm->dir);
+    }
+  if (lpm->nodes)
+    XFREE (MTYPE_ROUTE_LPM, lpm->nodes);
+  if (lpm->leaves)
+    XFREE (MTYPE_ROUTE_LPM, lpm->leaves);
+  XFREE (MTYPE_ROUTE_LPM, lpm);
+}
+
+/*
+ * route_table_enable_lpm
+ *
+ * Keep a longest-match index for route_node_match() on a table which
+ * holds prefixes of the given family only, AF_INET or AF_INET6.  It is
+ * built at the first match.
+ */
+void
+route_table_enable_lpm (struct route_table *table, int family)
+{
+  assert (family == AF_INET || family == AF_INET6);
+
+  if (table->lpm)
+    return;
+  table->lpm = XCALLOC (MTYPE_ROUTE_LPM, sizeof (struct route_lpm));
+  table->lpm->family = family;
+}
+
 /* Lock node. */
 struct route_node *
 route_lock_node (struct route_node *node)
@@ -212,6 +720,10 @@ route_node_match (const struct route_table *table, const struct prefix *p)
   struct route_node *node;
   struct route_node *matched;
 
+  if (table->lpm && p->family == table->lpm->family
+      && lpm_node_match (table, p, &matched))
+    return matched ? route_lock_node (matched) : NULL;
+
   matched = NULL;
   node = table->top;
 
@@ -315,6 +827,8 @@ route_node_get (struct route_table *const table, const struct prefix *p)
 	set_link (match, new);
       else
 	table->top = new;
+      if (table->lpm)
+	lpm_node_change (table->lpm, new, NULL, 1);
     }
   else
     {
@@ -328,6 +842,8 @@ route_node_get (struct route_table *const table, const struct prefix *p)
 	set_link (match, new);
       else
 	table->top = new;
+      if (table->lpm)
+	lpm_node_change (table->lpm, new, NULL, 1);
 
       if (new->p.prefixlen != p->prefixlen)
 	{
@@ -335,6 +851,8 @@ route_node_get (struct route_table *const table, const struct prefix *p)
 	  new = route_node_set (table, p);
 	  set_link (match, new);
 	  table->count++;
+	  if (table->lpm)
+	    lpm_node_change (table->lpm, new, NULL, 1);
 	}
     }
   table->count++;
@@ -378,6 +896,9 @@ route_node_delete (struct route_node *node)
 
   node->table->count--;
 
+  if (node->table->lpm)
+    lpm_node_change (node->table->lpm, node, parent, 0);
+
   route_node_free (node->table, node);
 
   /* If parent node is stub then delete it also. */
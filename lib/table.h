@@ -31,6 +31,7 @@ DECLARE_MTYPE(ROUTE_TABLE)
  */
 struct route_node;
 struct route_table;
+struct route_lpm;
 
 /*
  * route_table_delegate_t
@@ -63,6 +64,11 @@ struct route_table
   route_table_delegate_t *delegate;
   
   unsigned long count;
+
+  /*
+   * Longest-match index, if enabled with route_table_enable_lpm().
+   */
+  struct route_lpm *lpm;
   
   /*
    * User data.
@@ -147,6 +153,8 @@ route_table_init_with_delegate (route_table_delegate_t *);
 extern route_table_delegate_t *
 route_table_get_default_delegate(void);
 
+extern void route_table_enable_lpm (struct route_table *, int family);
+
 extern void route_table_finish (struct route_table *);
 extern void route_unlock_node (struct route_node *node);
 extern struct route_node *route_top (struct route_table *);
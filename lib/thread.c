@@ -317,9 +317,38 @@ thread_timer_update(void *node, int actual_position)
   thread->index = actual_position;
 }
 
+/* I/O multiplexer backend.  A thread_master keeps m->read[] / m->write[]
+ * indexed by fd; the backend only has to tell the kernel which of those
+ * fds we are interested in, wait, and hand ready fds back through
+ * thread_process_fd().
+ */
+struct thread_io_backend
+{
+  const char *name;
+  int (*init) (struct thread_master *);
+  void (*finish) (struct thread_master *);
+  /* arm / disarm interest in one direction (THREAD_READ/THREAD_WRITE) */
+  int (*add) (struct thread_master *, int fd, int dir);
+  void (*cancel) (struct thread_master *, int fd, int dir);
+  /* block until I/O or timeout, returns number of events or -1 */
+  int (*wait) (struct thread_master *, struct timeval *timer_wait);
+  /* move the threads of the fds that fired onto the ready list */
+  void (*process) (struct thread_master *, int num);
+};
+
+static const struct thread_io_backend *thread_io_backend_get (enum thread_io_type);
+
 /* Allocate new thread master.  */
 struct thread_master *
 thread_master_create (void)
+{
+  return thread_master_create_io (THREAD_IO_DEFAULT);
+}
+
+/* Allocate new thread master using a specific I/O backend.  Falls back
+ * to the default if the requested one is not available. */
+struct thread_master *
+thread_master_create_io (enum thread_io_type type)
 {
   struct thread_master *rv;
   struct rlimit limit;
@@ -359,15 +388,23 @@ thread_master_create (void)
   rv->timer->cmp = rv->background->cmp = thread_timer_cmp;
   rv->timer->update = rv->background->update = thread_timer_update;
 
-#if defined(HAVE_POLL)
-  rv->handler.pfdsize = rv->fd_limit;
-  rv->handler.pfdcount = 0;
-  rv->handler.pfds = (struct pollfd *) malloc (sizeof (struct pollfd) * rv->handler.pfdsize);
-  memset (rv->handler.pfds, 0, sizeof (struct pollfd) * rv->handler.pfdsize);
-#endif
+  rv->io = thread_io_backend_get (type);
+  if (rv->io->init (rv) < 0)
+    {
+      zlog_warn ("thread: %s backend unavailable (%s), falling back to poll",
+                 rv->io->name, safe_strerror (errno));
+      rv->io = thread_io_backend_get (THREAD_IO_POLL);
+      rv->io->init (rv);
+    }
   return rv;
 }
 
+const char *
+thread_master_io_name (struct thread_master *m)
+{
+  return m->io->name;
+}
+
 /* Add a new thread to the list.  */
 static void
 thread_list_add (struct thread_list *list, struct thread *thread)
@@ -517,9 +554,7 @@ thread_master_free (struct thread_master *m)
   thread_list_free (m, &m->unuse);
   thread_queue_free (m, m->background);
 
-#if defined(HAVE_POLL)
-  XFREE (MTYPE_THREAD_MASTER, m->handler.pfds);
-#endif
+  m->io->finish (m);
   XFREE (MTYPE_THREAD_MASTER, m);
 
   if (cpu_record)
@@ -596,103 +631,567 @@ thread_get (struct thread_master *m, u_char type,
   return thread;
 }
 
-#if defined (HAVE_POLL)
+/* Hand the thread waiting on fd in thread_array over to the ready list. */
+static int
+thread_process_fd (struct thread_master *m, struct thread **thread_array,
+                   int fd)
+{
+  struct thread *thread = thread_array[fd];
+
+  if (!thread)
+    return 0;
 
-#define fd_copy_fd_set(X) (X)
+  thread_array[fd] = NULL;
+  thread_list_add (&m->ready, thread);
+  thread->type = THREAD_READY;
+  return 1;
+}
 
-/* generic add thread function */
-static struct thread *
-generic_thread_add(struct thread_master *m, int (*func) (struct thread *),
-		   void *arg, int fd, int dir, debugargdef)
+/* select() backend.  Bounded by FD_SETSIZE, O(fd_limit) per wakeup. */
+static int
+select_io_init (struct thread_master *m)
 {
-  struct thread *thread;
+  FD_ZERO (&m->handler.readfd);
+  FD_ZERO (&m->handler.writefd);
+  FD_ZERO (&m->handler.exceptfd);
+  return 0;
+}
 
-  u_char type;
-  short int event;
+static void
+select_io_finish (struct thread_master *m)
+{
+}
 
-  if (dir == THREAD_READ)
+static int
+select_io_add (struct thread_master *m, int fd, int dir)
+{
+  fd_set *fdset = (dir == THREAD_READ) ? &m->handler.readfd
+                                       : &m->handler.writefd;
+
+  if (fd >= FD_SETSIZE)
     {
-      event = (POLLIN | POLLHUP);
-      type = THREAD_READ;
+      zlog_warn ("select: fd %d exceeds FD_SETSIZE", fd);
+      return -1;
     }
-  else
+  FD_SET (fd, fdset);
+  return 0;
+}
+
+static void
+select_io_cancel (struct thread_master *m, int fd, int dir)
+{
+  fd_set *fdset = (dir == THREAD_READ) ? &m->handler.readfd
+                                       : &m->handler.writefd;
+
+  FD_CLR (fd, fdset);
+}
+
+static int
+select_io_wait (struct thread_master *m, struct timeval *timer_wait)
+{
+  m->handler.rset = m->handler.readfd;
+  m->handler.wset = m->handler.writefd;
+  m->handler.eset = m->handler.exceptfd;
+
+  return select (FD_SETSIZE, &m->handler.rset, &m->handler.wset,
+                 &m->handler.eset, timer_wait);
+}
+
+static void
+select_io_process (struct thread_master *m, int num)
+{
+  int ready = 0, fd;
+  int limit = MIN (m->fd_limit, FD_SETSIZE);
+
+  for (fd = 0; fd < limit && ready < num; ++fd)
     {
-      event = (POLLOUT | POLLHUP);
-      type = THREAD_WRITE;
+      if (FD_ISSET (fd, &m->handler.rset))
+        {
+          FD_CLR (fd, &m->handler.readfd);
+          ready += thread_process_fd (m, m->read, fd);
+        }
+      if (FD_ISSET (fd, &m->handler.wset))
+        {
+          FD_CLR (fd, &m->handler.writefd);
+          ready += thread_process_fd (m, m->write, fd);
+        }
     }
+}
 
-  nfds_t queuepos = m->handler.pfdcount;
-  nfds_t i=0;
-  for (i=0; i<m->handler.pfdcount; i++)
-    if (m->handler.pfds[i].fd == fd)
-      {
-        queuepos = i;
-        break;
-      }
+/* poll() backend.  pfdindex maps an fd to its slot in pfds so arming and
+ * disarming are O(1); the kernel still scans the whole set per wakeup. */
+static int
+poll_io_init (struct thread_master *m)
+{
+  int fd;
+
+  m->handler.pfdsize = m->fd_limit;
+  m->handler.pfdcount = 0;
+  m->handler.pfds = XCALLOC (MTYPE_THREAD_MASTER,
+                             sizeof (struct pollfd) * m->handler.pfdsize);
+  m->handler.pfdindex = XMALLOC (MTYPE_THREAD_MASTER,
+                                 sizeof (int) * m->fd_limit);
+  for (fd = 0; fd < m->fd_limit; fd++)
+    m->handler.pfdindex[fd] = -1;
+  return 0;
+}
 
-  /* is there enough space for a new fd? */
-  assert (queuepos < m->handler.pfdsize);
+static void
+poll_io_finish (struct thread_master *m)
+{
+  XFREE (MTYPE_THREAD_MASTER, m->handler.pfds);
+  XFREE (MTYPE_THREAD_MASTER, m->handler.pfdindex);
+}
 
-  thread = thread_get (m, type, func, arg, debugargpass);
-  m->handler.pfds[queuepos].fd = fd;
-  m->handler.pfds[queuepos].events |= event;
-  if (queuepos == m->handler.pfdcount)
-    m->handler.pfdcount++;
+/* Drop slot pos by moving the last entry into it. */
+static void
+poll_io_remove (struct thread_master *m, nfds_t pos)
+{
+  struct fd_handler *h = &m->handler;
+  nfds_t last = --h->pfdcount;
 
-  return thread;
+  h->pfdindex[h->pfds[pos].fd] = -1;
+  if (pos != last)
+    {
+      h->pfds[pos] = h->pfds[last];
+      h->pfdindex[h->pfds[pos].fd] = pos;
+    }
+  memset (&h->pfds[last], 0, sizeof (struct pollfd));
 }
-#else
 
-#define fd_copy_fd_set(X) (X)
-#endif
+static int
+poll_io_add (struct thread_master *m, int fd, int dir)
+{
+  struct fd_handler *h = &m->handler;
+  int pos = h->pfdindex[fd];
+
+  if (pos < 0)
+    {
+      /* is there enough space for a new fd? */
+      assert (h->pfdcount < h->pfdsize);
+
+      pos = h->pfdcount++;
+      h->pfdindex[fd] = pos;
+      h->pfds[pos].fd = fd;
+      h->pfds[pos].events = 0;
+      h->pfds[pos].revents = 0;
+    }
+  h->pfds[pos].events |= (dir == THREAD_READ) ? POLLIN : POLLOUT;
+  return 0;
+}
+
+static void
+poll_io_cancel (struct thread_master *m, int fd, int dir)
+{
+  struct fd_handler *h = &m->handler;
+  int pos = h->pfdindex[fd];
+
+  if (pos < 0)
+    return;
+
+  h->pfds[pos].events &= ~((dir == THREAD_READ) ? POLLIN : POLLOUT);
+  if (h->pfds[pos].events == 0)
+    poll_io_remove (m, pos);
+}
 
 static int
-fd_select (struct thread_master *m, int size, thread_fd_set *read, thread_fd_set *write, thread_fd_set *except, struct timeval *timer_wait)
+poll_io_wait (struct thread_master *m, struct timeval *timer_wait)
 {
-  int num;
-#if defined(HAVE_POLL)
   /* recalc timeout for poll. Attention NULL pointer is no timeout with
   select, where with poll no timeount is -1 */
   int timeout = -1;
   if (timer_wait != NULL)
     timeout = (timer_wait->tv_sec*1000) + (timer_wait->tv_usec/1000);
 
-  num = poll (m->handler.pfds, m->handler.pfdcount + m->handler.pfdcountsnmp, timeout);
-#else
-  num = select (size, read, write, except, timer_wait);
-#endif
+  return poll (m->handler.pfds, m->handler.pfdcount, timeout);
+}
+
+static void
+poll_io_process (struct thread_master *m, int num)
+{
+  struct fd_handler *h = &m->handler;
+  nfds_t i = 0;
+  int ready = 0;
+
+  while (i < h->pfdcount && ready < num)
+    {
+      struct pollfd *pfd = &h->pfds[i];
+      short revents = pfd->revents;
+
+      /* no event for current fd? immideatly continue */
+      if (revents == 0)
+        {
+          i++;
+          continue;
+        }
+
+      ready++;
+      pfd->revents = 0;
+
+      /* remove fd from list on POLLNVAL, it was closed under us */
+      if (revents & POLLNVAL)
+        pfd->events = 0;
+
+      /* hangup and error are reported to whoever is waiting, like select
+       * does, so the owner gets to see the failing read/write */
+      if ((pfd->events & POLLIN) && (revents & (POLLIN | POLLHUP | POLLERR)))
+        {
+          pfd->events &= ~POLLIN;
+          thread_process_fd (m, m->read, pfd->fd);
+        }
+      if ((pfd->events & POLLOUT) && (revents & (POLLOUT | POLLHUP | POLLERR)))
+        {
+          pfd->events &= ~POLLOUT;
+          thread_process_fd (m, m->write, pfd->fd);
+        }
 
-  return num;
+      /* an emptied slot is refilled from the end; look at it again */
+      if (pfd->events == 0)
+        poll_io_remove (m, i);
+      else
+        i++;
+    }
 }
 
+#if defined(HAVE_EPOLL)
+/* epoll() backend.
+ *
+ * Registrations are persistent: once an fd is known to the kernel we only
+ * touch it again when the interest set has to change, so arming and
+ * disarming are O(1) and a wakeup costs O(ready fds) instead of O(all fds).
+ *
+ * Disarming is lazy.  Cancelling a thread (or dispatching it, since threads
+ * are one-shot) leaves the kernel registration alone; most fds are re-armed
+ * right away by their handler.  If the kernel reports an fd nobody waits
+ * on, a level-triggered fd has that direction dropped from its registration
+ * and an edge-triggered one is remembered as pending, to be dispatched as
+ * soon as a thread is armed on it again.
+ *
+ * An fd with nothing armed in the other direction may have been closed and
+ * reused since we last saw it, so arming it always goes to the kernel;
+ * EPOLL_CTL_MOD failing with ENOENT is how a stale registration shows up.
+ */
+#define THREAD_EPOLL_MAXEVENTS    1024
+
+#define THREAD_EPOLL_REG          0x01	/* known to the kernel */
+#define THREAD_EPOLL_IN           0x02	/* registered for EPOLLIN */
+#define THREAD_EPOLL_OUT          0x04	/* registered for EPOLLOUT */
+#define THREAD_EPOLL_EDGE         0x08	/* registered with EPOLLET */
+#define THREAD_EPOLL_PEND_IN      0x10	/* readable, nobody was waiting */
+#define THREAD_EPOLL_PEND_OUT     0x20	/* writable, nobody was waiting */
+#define THREAD_EPOLL_QUEUED       0x40	/* on the eppending list */
+
+#define THREAD_EPOLL_DIR(dir) \
+  ((dir) == THREAD_READ ? THREAD_EPOLL_IN : THREAD_EPOLL_OUT)
+#define THREAD_EPOLL_PEND(dir) \
+  ((dir) == THREAD_READ ? THREAD_EPOLL_PEND_IN : THREAD_EPOLL_PEND_OUT)
+
 static int
-fd_is_set (struct thread *thread, thread_fd_set *fdset, int pos)
+epoll_io_init (struct thread_master *m)
 {
-#if defined(HAVE_POLL)
-  return 1;
+  struct fd_handler *h = &m->handler;
+
+  h->epfd = epoll_create1 (EPOLL_CLOEXEC);
+  if (h->epfd < 0)
+    return -1;
+
+  h->epeventsize = MIN (m->fd_limit, THREAD_EPOLL_MAXEVENTS);
+  h->epevents = XCALLOC (MTYPE_THREAD_MASTER,
+                         sizeof (struct epoll_event) * h->epeventsize);
+  h->epflags = XCALLOC (MTYPE_THREAD_MASTER, m->fd_limit);
+  h->eppending = XCALLOC (MTYPE_THREAD_MASTER, sizeof (int) * m->fd_limit);
+  h->eppendcount = 0;
+  return 0;
+}
+
+static void
+epoll_io_finish (struct thread_master *m)
+{
+  close (m->handler.epfd);
+  XFREE (MTYPE_THREAD_MASTER, m->handler.epevents);
+  XFREE (MTYPE_THREAD_MASTER, m->handler.epflags);
+  XFREE (MTYPE_THREAD_MASTER, m->handler.eppending);
+}
+
+static void
+epoll_io_queue (struct thread_master *m, int fd)
+{
+  struct fd_handler *h = &m->handler;
+
+  if (h->epflags[fd] & THREAD_EPOLL_QUEUED)
+    return;
+  h->epflags[fd] |= THREAD_EPOLL_QUEUED;
+  h->eppending[h->eppendcount++] = fd;
+}
+
+/* Bring the kernel registration of fd in line with want (a mask of
+ * THREAD_EPOLL_IN / THREAD_EPOLL_OUT). */
+static int
+epoll_io_ctl (struct thread_master *m, int fd, u_char want)
+{
+  struct fd_handler *h = &m->handler;
+  u_char *flags = &h->epflags[fd];
+  struct epoll_event ev;
+  int op, ret;
+
+  memset (&ev, 0, sizeof (ev));
+  ev.data.fd = fd;
+  if (want & THREAD_EPOLL_IN)
+    ev.events |= EPOLLIN;
+  if (want & THREAD_EPOLL_OUT)
+    ev.events |= EPOLLOUT;
+  if (*flags & THREAD_EPOLL_EDGE)
+    ev.events |= EPOLLET;
+
+  if (!want && !(*flags & THREAD_EPOLL_EDGE))
+    {
+      /* a level-triggered registration with no interest left would
+       * still report hangups forever, so drop it.  This may fail if the
+       * fd was closed already, which is fine. */
+      if (*flags & THREAD_EPOLL_REG)
+        epoll_ctl (h->epfd, EPOLL_CTL_DEL, fd, &ev);
+      *flags &= ~(THREAD_EPOLL_REG | THREAD_EPOLL_IN | THREAD_EPOLL_OUT);
+      return 0;
+    }
+
+  op = (*flags & THREAD_EPOLL_REG) ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+  ret = epoll_ctl (h->epfd, op, fd, &ev);
+  if (ret < 0 && op == EPOLL_CTL_MOD && errno == ENOENT)
+    {
+      /* fd was closed (and maybe reused) since it was registered:
+       * whatever we remembered about it is stale */
+      *flags &= ~(THREAD_EPOLL_REG | THREAD_EPOLL_IN | THREAD_EPOLL_OUT
+                  | THREAD_EPOLL_EDGE | THREAD_EPOLL_PEND_IN
+                  | THREAD_EPOLL_PEND_OUT);
+      ev.events &= ~EPOLLET;
+      ret = epoll_ctl (h->epfd, EPOLL_CTL_ADD, fd, &ev);
+    }
+  else if (ret < 0 && op == EPOLL_CTL_ADD && errno == EEXIST)
+    ret = epoll_ctl (h->epfd, EPOLL_CTL_MOD, fd, &ev);
+
+  if (ret < 0)
+    return -1;
+
+  *flags &= ~(THREAD_EPOLL_IN | THREAD_EPOLL_OUT);
+  *flags |= THREAD_EPOLL_REG | want;
+  return 0;
+}
+
+static int
+epoll_io_add (struct thread_master *m, int fd, int dir)
+{
+  u_char *flags = &m->handler.epflags[fd];
+  struct thread **other = (dir == THREAD_READ) ? m->write : m->read;
+  u_char otherbit = THREAD_EPOLL_DIR (dir == THREAD_READ ? THREAD_WRITE
+                                                         : THREAD_READ);
+  u_char want;
+
+  /* fd is live and already registered the way we need: nothing to do */
+  if (other[fd] && (*flags & THREAD_EPOLL_DIR (dir)))
+    {
+      if (*flags & THREAD_EPOLL_PEND (dir))
+        epoll_io_queue (m, fd);
+      return 0;
+    }
+
+  want = THREAD_EPOLL_DIR (dir) | (other[fd] ? otherbit : 0);
+  if (epoll_io_ctl (m, fd, want) < 0)
+    {
+      if (errno != EPERM)
+        {
+          zlog_warn ("epoll_ctl fd %d: %s", fd, safe_strerror (errno));
+          return -1;
+        }
+      /* regular files and the like can't be polled, and are always
+       * ready in select/poll terms */
+      *flags |= THREAD_EPOLL_PEND (dir);
+      epoll_io_queue (m, fd);
+      return 0;
+    }
+
+  /* the kernel re-checks readiness when (re)registering */
+  *flags &= ~THREAD_EPOLL_PEND (dir);
+  return 0;
+}
+
+static void
+epoll_io_cancel (struct thread_master *m, int fd, int dir)
+{
+  /* lazy, see above */
+}
+
+/* Nobody is waiting for the directions in idle that the kernel reported. */
+static void
+epoll_io_idle (struct thread_master *m, int fd, u_char idle)
+{
+  u_char *flags = &m->handler.epflags[fd];
+
+  if (*flags & THREAD_EPOLL_EDGE)
+    {
+      if (idle & THREAD_EPOLL_IN)
+        *flags |= THREAD_EPOLL_PEND_IN;
+      if (idle & THREAD_EPOLL_OUT)
+        *flags |= THREAD_EPOLL_PEND_OUT;
+      return;
+    }
+
+  epoll_io_ctl (m, fd, *flags & (THREAD_EPOLL_IN | THREAD_EPOLL_OUT) & ~idle);
+}
+
+static int
+epoll_io_wait (struct thread_master *m, struct timeval *timer_wait)
+{
+  struct fd_handler *h = &m->handler;
+  int timeout = -1, num;
+
+  /* round up, or we would spin until a sub-millisecond timer is due */
+  if (timer_wait != NULL)
+    timeout = (timer_wait->tv_sec * 1000)
+              + (timer_wait->tv_usec + 999) / 1000;
+  if (h->eppendcount)
+    timeout = 0;
+
+  num = epoll_wait (h->epfd, h->epevents, h->epeventsize, timeout);
+  if (num < 0)
+    return num;
+  return num + h->eppendcount;
+}
+
+static void
+epoll_io_process (struct thread_master *m, int num)
+{
+  struct fd_handler *h = &m->handler;
+  int i, fd, nevents = num - h->eppendcount;
+
+  for (i = 0; i < nevents; i++)
+    {
+      uint32_t events = h->epevents[i].events;
+      u_char idle = 0;
+
+      fd = h->epevents[i].data.fd;
+      if (events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+        {
+          if (!thread_process_fd (m, m->read, fd))
+            idle |= THREAD_EPOLL_IN;
+        }
+      if (events & (EPOLLOUT | EPOLLHUP | EPOLLERR))
+        {
+          if (!thread_process_fd (m, m->write, fd))
+            idle |= THREAD_EPOLL_OUT;
+        }
+      if (idle)
+        epoll_io_idle (m, fd, idle);
+    }
+
+  for (i = 0; i < h->eppendcount; i++)
+    {
+      u_char *flags;
+
+      fd = h->eppending[i];
+      flags = &h->epflags[fd];
+      *flags &= ~THREAD_EPOLL_QUEUED;
+      if ((*flags & THREAD_EPOLL_PEND_IN)
+          && thread_process_fd (m, m->read, fd))
+        *flags &= ~THREAD_EPOLL_PEND_IN;
+      if ((*flags & THREAD_EPOLL_PEND_OUT)
+          && thread_process_fd (m, m->write, fd))
+        *flags &= ~THREAD_EPOLL_PEND_OUT;
+    }
+  h->eppendcount = 0;
+}
+
+static const struct thread_io_backend epoll_io_backend =
+{
+  .name = "epoll",
+  .init = epoll_io_init,
+  .finish = epoll_io_finish,
+  .add = epoll_io_add,
+  .cancel = epoll_io_cancel,
+  .wait = epoll_io_wait,
+  .process = epoll_io_process,
+};
+#endif /* HAVE_EPOLL */
+
+static const struct thread_io_backend select_io_backend =
+{
+  .name = "select",
+  .init = select_io_init,
+  .finish = select_io_finish,
+  .add = select_io_add,
+  .cancel = select_io_cancel,
+  .wait = select_io_wait,
+  .process = select_io_process,
+};
+
+static const struct thread_io_backend poll_io_backend =
+{
+  .name = "poll",
+  .init = poll_io_init,
+  .finish = poll_io_finish,
+  .add = poll_io_add,
+  .cancel = poll_io_cancel,
+  .wait = poll_io_wait,
+  .process = poll_io_process,
+};
+
+static const struct thread_io_backend *
+thread_io_backend_get (enum thread_io_type type)
+{
+  switch (type)
+    {
+    case THREAD_IO_SELECT:
+      return &select_io_backend;
+    case THREAD_IO_POLL:
+      return &poll_io_backend;
+    case THREAD_IO_EPOLL:
+    case THREAD_IO_DEFAULT:
+#if defined(HAVE_EPOLL)
+      return &epoll_io_backend;
+#elif defined(HAVE_POLL)
+      return &poll_io_backend;
 #else
-  return FD_ISSET (THREAD_FD (thread), fdset);
+      return (type == THREAD_IO_EPOLL) ? &poll_io_backend
+                                       : &select_io_backend;
 #endif
+    }
+  return &select_io_backend;
 }
 
-static int
-fd_clear_read_write (struct thread *thread)
+/* Select edge- or level-triggered (THREAD_FD_EDGE / THREAD_FD_LEVEL)
+ * wakeups for fd.  With edge-triggering an fd is only reported when new
+ * data arrives or buffer space frees up, so the read handler has to
+ * drain the socket until EAGAIN before re-arming itself. Backends other
+ * than epoll ignore this and stay level-triggered. */
+void
+thread_fd_set_trigger (struct thread_master *m, int fd, int trigger)
 {
-#if !defined(HAVE_POLL)
-  thread_fd_set *fdset = NULL;
-  int fd = THREAD_FD (thread);
+#if defined(HAVE_EPOLL)
+  u_char *flags;
 
-  if (thread->type == THREAD_READ)
-    fdset = &thread->master->handler.readfd;
-  else
-    fdset = &thread->master->handler.writefd;
+  if (m->io != &epoll_io_backend || fd < 0 || fd >= m->fd_limit)
+    return;
 
-  if (!FD_ISSET (fd, fdset))
-    return 0;
+  flags = &m->handler.epflags[fd];
+  if (((*flags & THREAD_EPOLL_EDGE) != 0) == (trigger == THREAD_FD_EDGE))
+    return;
 
-  FD_CLR (fd, fdset);
+  /* make sure a stale registration doesn't swallow the new setting */
+  if ((*flags & THREAD_EPOLL_REG)
+      && !m->read[fd] && !m->write[fd])
+    {
+      epoll_ctl (m->handler.epfd, EPOLL_CTL_DEL, fd, NULL);
+      *flags &= ~(THREAD_EPOLL_REG | THREAD_EPOLL_IN | THREAD_EPOLL_OUT);
+    }
+
+  if (trigger == THREAD_FD_EDGE)
+    *flags |= THREAD_EPOLL_EDGE;
+  else
+    *flags &= ~(THREAD_EPOLL_EDGE | THREAD_EPOLL_PEND_IN
+                | THREAD_EPOLL_PEND_OUT);
+
+  if (*flags & THREAD_EPOLL_REG)
+    epoll_io_ctl (m, fd, *flags & (THREAD_EPOLL_IN | THREAD_EPOLL_OUT));
 #endif
-  return 1;
 }
 
 /* Add new read thread. */
@@ -702,36 +1201,21 @@ funcname_thread_add_read_write (int dir, struct thread_master *m,
 				debugargdef)
 {
   struct thread *thread = NULL;
+  struct thread **thread_array = (dir == THREAD_READ) ? m->read : m->write;
 
-#if !defined(HAVE_POLL)
-  thread_fd_set *fdset = NULL;
-  if (dir == THREAD_READ)
-    fdset = &m->handler.readfd;
-  else
-    fdset = &m->handler.writefd;
-#endif
-
-#if defined (HAVE_POLL)
-  thread = generic_thread_add(m, func, arg, fd, dir, debugargpass);
-
-  if (thread == NULL)
-    return NULL;
-#else
-  if (FD_ISSET (fd, fdset))
+  if (thread_array[fd])
     {
-      zlog (NULL, LOG_WARNING, "There is already %s fd [%d]", (dir = THREAD_READ) ? "read" : "write", fd);
+      zlog (NULL, LOG_WARNING, "There is already %s fd [%d]",
+            (dir == THREAD_READ) ? "read" : "write", fd);
       return NULL;
     }
 
-  FD_SET (fd, fdset);
-  thread = thread_get (m, dir, func, arg, debugargpass);
-#endif
+  if (m->io->add (m, fd, dir) < 0)
+    return NULL;
 
+  thread = thread_get (m, dir, func, arg, debugargpass);
   thread->u.fd = fd;
-  if (dir == THREAD_READ)
-    thread_add_fd (m->read, thread);
-  else
-    thread_add_fd (m->write, thread);
+  thread_add_fd (thread_array, thread);
 
   return thread;
 }
@@ -853,32 +1337,6 @@ funcname_thread_add_event (struct thread_master *m,
   return thread;
 }
 
-static void
-thread_cancel_read_or_write (struct thread *thread, short int state)
-{
-#if defined(HAVE_POLL)
-  nfds_t i;
-
-  for (i=0;i<thread->master->handler.pfdcount;++i)
-    if (thread->master->handler.pfds[i].fd == thread->u.fd)
-      {
-        thread->master->handler.pfds[i].events &= ~(state);
-
-        /* remove thread fds from pfd list */
-        if (thread->master->handler.pfds[i].events == 0)
-          {
-            memmove(thread->master->handler.pfds+i,
-                    thread->master->handler.pfds+i+1,
-                    (thread->master->handler.pfdsize-i-1) * sizeof(struct pollfd));
-            thread->master->handler.pfdcount--;
-            return;
-          }
-      }
-#endif
-
-  fd_clear_read_write (thread);
-}
-
 /* Cancel thread from scheduler. */
 void
 thread_cancel (struct thread *thread)
@@ -890,19 +1348,11 @@ thread_cancel (struct thread *thread)
   switch (thread->type)
     {
     case THREAD_READ:
-#if defined (HAVE_POLL)
-      thread_cancel_read_or_write (thread, POLLIN | POLLHUP);
-#else
-      thread_cancel_read_or_write (thread, 0);
-#endif
+      thread->master->io->cancel (thread->master, thread->u.fd, THREAD_READ);
       thread_array = thread->master->read;
       break;
     case THREAD_WRITE:
-#if defined (HAVE_POLL)
-      thread_cancel_read_or_write (thread, POLLOUT | POLLHUP);
-#else
-      thread_cancel_read_or_write (thread, 0);
-#endif
+      thread->master->io->cancel (thread->master, thread->u.fd, THREAD_WRITE);
       thread_array = thread->master->write;
       break;
     case THREAD_TIMER:
@@ -1007,109 +1457,6 @@ thread_run (struct thread_master *m, struct thread *thread,
   return fetch;
 }
 
-static int
-thread_process_fds_helper (struct thread_master *m, struct thread *thread, thread_fd_set *fdset, short int state, int pos)
-{
-  struct thread **thread_array;
-
-  if (!thread)
-    return 0;
-
-  if (thread->type == THREAD_READ)
-    thread_array = m->read;
-  else
-    thread_array = m->write;
-
-  if (fd_is_set (thread, fdset, pos))
-    {
-      fd_clear_read_write (thread);
-      thread_delete_fd (thread_array, thread);
-      thread_list_add (&m->ready, thread);
-      thread->type = THREAD_READY;
-#if defined(HAVE_POLL)
-      thread->master->handler.pfds[pos].events &= ~(state);
-#endif
-      return 1;
-    }
-  return 0;
-}
-
-#if defined(HAVE_POLL)
-
-#if defined(HAVE_SNMP)
-/* add snmp fds to poll set */
-static void
-add_snmp_pollfds(struct thread_master *m, fd_set *snmpfds, int fdsetsize)
-{
-  int i;
-  m->handler.pfdcountsnmp = m->handler.pfdcount;
-  /* cycle trough fds and add neccessary fds to poll set */
-  for (i=0;i<fdsetsize;++i)
-    {
-      if (FD_ISSET(i, snmpfds))
-        {
-          assert (m->handler.pfdcountsnmp <= m->handler.pfdsize);
-
-          m->handler.pfds[m->handler.pfdcountsnmp].fd = i;
-          m->handler.pfds[m->handler.pfdcountsnmp].events = POLLIN;
-          m->handler.pfdcountsnmp++;
-        }
-    }
-}
-#endif
-
-/* check poll events */
-static void
-check_pollfds(struct thread_master *m, fd_set *readfd, int num)
-{
-  nfds_t i = 0;
-  int ready = 0;
-  for (i = 0; i < m->handler.pfdcount && ready < num ; ++i)
-    {
-      /* no event for current fd? immideatly continue */
-      if(m->handler.pfds[i].revents == 0)
-        continue;
-
-      ready++;
-
-      /* POLLIN / POLLOUT process event */
-      if (m->handler.pfds[i].revents & POLLIN)
-        thread_process_fds_helper(m, m->read[m->handler.pfds[i].fd], NULL, POLLIN, i);
-      if (m->handler.pfds[i].revents & POLLOUT)
-        thread_process_fds_helper(m, m->write[m->handler.pfds[i].fd], NULL, POLLOUT, i);
-
-      /* remove fd from list on POLLNVAL */
-      if (m->handler.pfds[i].revents & POLLNVAL ||
-          m->handler.pfds[i].revents & POLLHUP)
-        {
-           memmove(m->handler.pfds+i,
-                   m->handler.pfds+i+1,
-                   (m->handler.pfdsize-i-1) * sizeof(struct pollfd));
-           m->handler.pfdcount--;
-           i--;
-        }
-      else
-          m->handler.pfds[i].revents = 0;
-    }
-}
-#endif
-
-static void
-thread_process_fds (struct thread_master *m, thread_fd_set *rset, thread_fd_set *wset, int num)
-{
-#if defined (HAVE_POLL)
-  check_pollfds (m, rset, num);
-#else
-  int ready = 0, index;
-
-  for (index = 0; index < m->fd_limit && ready < num; ++index)
-    {
-      ready += thread_process_fds_helper (m, m->read[index], rset, 0, 0);
-      ready += thread_process_fds_helper (m, m->write[index], wset, 0, 0);
-    }
-#endif
-}
-
 /* Add all timers that have popped to the ready list. */
 static unsigned int
 thread_timer_process (struct pqueue *queue, struct timeval *timenow)
@@ -1155,9 +1502,6 @@ struct thread *
 thread_fetch (struct thread_master *m, struct thread *fetch)
 {
   struct thread *thread;
-  thread_fd_set readfd;
-  thread_fd_set writefd;
-  thread_fd_set exceptfd;
   struct timeval now;
   struct timeval timer_val = { .tv_sec = 0, .tv_usec = 0 };
   struct timeval timer_val_bg;
@@ -1185,13 +1529,6 @@ thread_fetch (struct thread_master *m, struct thread *fetch)
       /* Normal event are the next highest priority.  */
       thread_process (&m->event);
       
-      /* Structure copy.  */
-#if !defined(HAVE_POLL)
-      readfd = fd_copy_fd_set(m->handler.readfd);
-      writefd = fd_copy_fd_set(m->handler.writefd);
-      exceptfd = fd_copy_fd_set(m->handler.exceptfd);
-#endif
-      
       /* Calculate select wait timer if nothing else to do */
       if (m->ready.count == 0)
         {
@@ -1209,14 +1546,14 @@ thread_fetch (struct thread_master *m, struct thread *fetch)
           timer_wait = &timer_val;
         }
 
-      num = fd_select (m, FD_SETSIZE, &readfd, &writefd, &exceptfd, timer_wait);
+      num = m->io->wait (m, timer_wait);
       
       /* Signals should get quick treatment */
       if (num < 0)
         {
           if (errno == EINTR)
             continue; /* signal received - process it */
-          zlog_warn ("select() error: %s", safe_strerror (errno));
+          zlog_warn ("%s() error: %s", m->io->name, safe_strerror (errno));
           return NULL;
         }
 
@@ -1228,7 +1565,7 @@ thread_fetch (struct thread_master *m, struct thread *fetch)
       
       /* Got IO, process it */
       if (num > 0)
-        thread_process_fds (m, &readfd, &writefd, num);
+        m->io->process (m, num);
 
 #if 0
       /* If any threads were made ready above (I/O or foreground timer),
@@ -50,27 +50,54 @@ struct pqueue;
  */
 typedef fd_set thread_fd_set;
 
-#if defined(HAVE_POLL)
-#include <poll.h>
-struct fd_handler
+/* I/O multiplexer backends a thread_master can be created with. */
+enum thread_io_type
 {
-  /* number of pfd stored in pfds */
-  nfds_t pfdcount;
-  /* number of pfd stored in pfds + number of snmp pfd */
-  nfds_t pfdcountsnmp;
-  /* number of pfd that fit in the allocated space of pfds */
-  nfds_t pfdsize;
-  struct pollfd *pfds;
+  THREAD_IO_DEFAULT = 0,	/* best available: epoll > poll > select */
+  THREAD_IO_SELECT,
+  THREAD_IO_POLL,
+  THREAD_IO_EPOLL,
 };
-#else
+
+/* Per-fd event semantics, see thread_fd_set_trigger().  Only the epoll
+ * backend can do edge-triggered; the others are always level-triggered. */
+#define THREAD_FD_LEVEL  0
+#define THREAD_FD_EDGE   1
+
+struct thread_io_backend;
+
+#include <poll.h>
+#if defined(HAVE_EPOLL)
+#include <sys/epoll.h>
+#endif
+
 struct fd_handler
 {
+  /* select: armed fds, and the working copies handed to select() */
   fd_set readfd;
   fd_set writefd;
   fd_set exceptfd;
-};
-#endif
+  fd_set rset, wset, eset;
 
+  /* poll: number of pfd stored in pfds */
+  nfds_t pfdcount;
+  /* number of pfd that fit in the allocated space of pfds */
+  nfds_t pfdsize;
+  struct pollfd *pfds;
+  /* position of each fd in pfds, -1 if not present */
+  int *pfdindex;
+
+#if defined(HAVE_EPOLL)
+  /* epoll: persistent registrations, see the THREAD_EPOLL_* flags */
+  int epfd;
+  int epeventsize;
+  struct epoll_event *epevents;
+  u_char *epflags;
+  /* fds that are ready without the kernel telling us so again */
+  int *eppending;
+  int eppendcount;
+#endif
+};
 /* Master of the theads. */
 struct thread_master
 {
@@ -82,6 +109,7 @@ struct thread_master
   struct thread_list unuse;
   struct pqueue *background;
   int fd_limit;
+  const struct thread_io_backend *io;
   struct fd_handler handler;
   unsigned long alloc;
 };
@@ -204,6 +232,8 @@ enum quagga_clkid {
 
 /* Prototypes. */
 extern struct thread_master *thread_master_create (void);
+extern struct thread_master *thread_master_create_io (enum thread_io_type);
+extern const char *thread_master_io_name (struct thread_master *);
 extern void thread_master_free (struct thread_master *);
 extern void thread_master_free_unused(struct thread_master *);
 
@@ -235,6 +265,7 @@ extern struct thread *funcname_thread_execute (struct thread_master *,
 
 extern void thread_cancel (struct thread *);
 extern unsigned int thread_cancel_event (struct thread_master *, void *);
+extern void thread_fd_set_trigger (struct thread_master *, int fd, int trigger);
 extern struct thread *thread_fetch (struct thread_master *, struct thread *);
 extern void thread_call (struct thread *);
 extern unsigned long thread_timer_remain_second (struct thread *);
@@ -56,6 +56,7 @@ zclient_new (struct thread_master *master)
 
   zclient->ibuf = stream_new (ZEBRA_MAX_PACKET_SIZ);
   zclient->obuf = stream_new (ZEBRA_MAX_PACKET_SIZ);
+  zclient->bulk = stream_new (ZEBRA_MAX_PACKET_SIZ);
   zclient->wb = buffer_new(0);
   zclient->master = master;
 
@@ -74,6 +75,8 @@ zclient_free (struct zclient *zclient)
     stream_free(zclient->ibuf);
   if (zclient->obuf)
     stream_free(zclient->obuf);
+  if (zclient->bulk)
+    stream_free(zclient->bulk);
   if (zclient->wb)
     buffer_free(zclient->wb);
 
@@ -130,6 +133,8 @@ redist_del_instance (struct redist_proto *red, u_short instance)
     }
 }
 
+static size_t zclient_bulk_put (struct zclient *zclient);
+
 /* Stop zebra client services. */
 void
 zclient_stop (struct zclient *zclient)
@@ -149,8 +154,15 @@ zclient_stop (struct zclient *zclient)
   stream_reset(zclient->ibuf);
   stream_reset(zclient->obuf);
 
+  /* Route messages may still be waiting to be coalesced, try to get them
+     out before the socket goes away. */
+  if (zclient->sock >= 0 && (zclient_bulk_put(zclient) || zclient->coalesced))
+    buffer_flush_all(zclient->wb, zclient->sock);
+
   /* Empty the write buffer. */
   buffer_reset(zclient->wb);
+  stream_reset(zclient->bulk);
+  zclient->coalesced = 0;
 
   /* Close socket. */
   if (zclient->sock >= 0)
@@ -298,8 +310,10 @@ zclient_flush_data(struct thread *thread)
   struct zclient *zclient = THREAD_ARG(thread);
 
   zclient->t_write = NULL;
+  zclient->coalesced = 0;
   if (zclient->sock < 0)
     return -1;
+  zclient_bulk_put(zclient);
   switch (buffer_flush_available(zclient->wb, zclient->sock))
     {
     case BUFFER_ERROR:
@@ -322,6 +336,7 @@ zclient_send_message(struct zclient *zclient)
 {
   if (zclient->sock < 0)
     return -1;
+  zclient_bulk_put(zclient);
   switch (buffer_write(zclient->wb, zclient->sock, STREAM_DATA(zclient->obuf),
 		       stream_get_endp(zclient->obuf)))
     {
@@ -341,6 +356,220 @@ zclient_send_message(struct zclient *zclient)
   return 0;
 }
 
+/* Route messages tend to come in bursts.  Rather than writing each one
+   out on its own, queue it behind whatever is already waiting and let
+   zclient_flush_data() send the lot with one writev() once we are back
+   in the event loop, or as soon as enough has piled up.  Anything sent
+   with zclient_send_message() meanwhile is queued behind it, so the
+   order of messages is kept. */
+#define ZCLIENT_COALESCE_MAX 65536
+
+/* len bytes have been put in wb, send them in due time. */
+static int
+zclient_queued(struct zclient *zclient, size_t len)
+{
+  zclient->coalesced += len;
+
+  if (zclient->coalesced >= ZCLIENT_COALESCE_MAX)
+    {
+      THREAD_OFF(zclient->t_write);
+      zclient->coalesced = 0;
+      switch (buffer_flush_available(zclient->wb, zclient->sock))
+	{
+	case BUFFER_ERROR:
+	  zlog_warn("%s: buffer_flush_available failed on zclient fd %d, closing",
+		    __func__, zclient->sock);
+	  return zclient_failed(zclient);
+	case BUFFER_EMPTY:
+	  return 0;
+	case BUFFER_PENDING:
+	  break;
+	}
+    }
+
+  THREAD_WRITE_ON(zclient->master, zclient->t_write,
+		  zclient_flush_data, zclient, zclient->sock);
+  return 0;
+}
+
+static int
+zclient_send_message_coalesced(struct zclient *zclient)
+{
+  if (zclient->sock < 0)
+    return -1;
+
+  zclient_bulk_put(zclient);
+  buffer_put(zclient->wb, STREAM_DATA(zclient->obuf),
+	     stream_get_endp(zclient->obuf));
+  return zclient_queued(zclient, stream_get_endp(zclient->obuf));
+}
+
+/*
+ * Route messages that differ only in their prefix are merged into one
+ * bulk message (ZEBRA_IPV4_ROUTE_BULK_ADD and so on), which carries the
+ * shared part once, followed by a count of prefixes and the prefixes.
+ * The bulk message is built in zclient->bulk and put in the write buffer
+ * when a route with other attributes comes along, when it is full, and
+ * before anything else is sent.  A bulk message that ends up with a
+ * single prefix goes out as the plain route message it started as.
+ */
+
+/* Offset of the prefix in a route message: header, type, instance,
+   flags, message, safi. */
+#define ZAPI_ROUTE_PREFIX_OFFSET (ZEBRA_HEADER_SIZE + 10)
+
+static u_int16_t
+zapi_route_bulk_command(u_int16_t cmd)
+{
+  switch (cmd)
+    {
+    case ZEBRA_IPV4_ROUTE_ADD:
+      return ZEBRA_IPV4_ROUTE_BULK_ADD;
+    case ZEBRA_IPV4_ROUTE_DELETE:
+      return ZEBRA_IPV4_ROUTE_BULK_DELETE;
+    case ZEBRA_IPV6_ROUTE_ADD:
+      return ZEBRA_IPV6_ROUTE_BULK_ADD;
+    case ZEBRA_IPV6_ROUTE_DELETE:
+      return ZEBRA_IPV6_ROUTE_BULK_DELETE;
+    default:
+      return 0;
+    }
+}
+
+/* Move the bulk message being built to the write buffer.  Returns the
+   number of bytes put there. */
+static size_t
+zclient_bulk_put(struct zclient *zclient)
+{
+  struct stream *b = zclient->bulk;
+  u_char *data = STREAM_DATA(b);
+  size_t len = stream_get_endp(b);
+  size_t poff = ZAPI_ROUTE_PREFIX_OFFSET;
+  size_t coff = poff + zclient->bulk_attrlen;
+
+  if (!len)
+    return 0;
+
+  if (zapi_route_bulk_command(zclient->bulk_cmd)
+      && stream_getw_from(b, coff) == 1)
+    {
+      /* Put the prefix back in its place and drop the count.  The
+         header still has the plain command. */
+      stream_putw_at(b, 0, len - 2);
+      buffer_put(zclient->wb, data, poff);
+      buffer_put(zclient->wb, data + coff + 2, len - coff - 2);
+      buffer_put(zclient->wb, data + poff, zclient->bulk_attrlen);
+      len -= 2;
+    }
+  else
+    buffer_put(zclient->wb, data, len);
+
+  stream_reset(b);
+  return len;
+}
+
+/* Send the route message in zclient->obuf, merging it into a bulk
+   message if it can be. */
+int
+zclient_send_route(struct zclient *zclient)
+{
+  struct stream *s = zclient->obuf;
+  struct stream *b = zclient->bulk;
+  size_t poff = ZAPI_ROUTE_PREFIX_OFFSET;
+  size_t plen, attrlen, len;
+  u_int16_t cmd, bulk_cmd, count;
+
+  if (zclient->sock < 0)
+    return -1;
+
+  cmd = stream_getw_from(s, 6);
+  bulk_cmd = zapi_route_bulk_command(cmd);
+  if (!bulk_cmd)
+    return zclient_send_message_coalesced(zclient);
+
+  plen = 1 + PSIZE(stream_getc_from(s, poff));
+  attrlen = stream_get_endp(s) - poff - plen;
+
+  /* Same command, VRF, type, flags and so on, and same nexthops and
+     attributes: add the prefix.  The command in the header of the bulk
+     message is the bulk one from its second prefix on, so it is left
+     out of the compare. */
+  if (stream_get_endp(b)
+      && cmd == zclient->bulk_cmd
+      && attrlen == zclient->bulk_attrlen
+      && STREAM_WRITEABLE(b) >= plen
+      && !memcmp(STREAM_DATA(b) + 4, STREAM_DATA(s) + 4, 2)
+      && !memcmp(STREAM_DATA(b) + ZEBRA_HEADER_SIZE,
+		 STREAM_DATA(s) + ZEBRA_HEADER_SIZE, poff - ZEBRA_HEADER_SIZE)
+      && !memcmp(STREAM_DATA(b) + poff, STREAM_DATA(s) + poff + plen,
+		 attrlen))
+    {
+      count = stream_getw_from(b, poff + attrlen);
+      stream_putw_at(b, poff + attrlen, count + 1);
+      stream_putw_at(b, 6, bulk_cmd);
+      stream_put(b, STREAM_DATA(s) + poff, plen);
+      stream_putw_at(b, 0, stream_get_endp(b));
+      return 0;
+    }
+
+  len = zclient_bulk_put(zclient);
+  if (len && zclient_queued(zclient, len) < 0)
+    return -1;
+
+  /* Start a new bulk message with this route. */
+  stream_put(b, STREAM_DATA(s), poff);
+  stream_put(b, STREAM_DATA(s) + poff + plen, attrlen);
+  stream_putw(b, 1);
+  stream_put(b, STREAM_DATA(s) + poff, plen);
+  stream_putw_at(b, 0, stream_get_endp(b));
+  zclient->bulk_cmd = cmd;
+  zclient->bulk_attrlen = attrlen;
+
+  THREAD_WRITE_ON(zclient->master, zclient->t_write,
+		  zclient_flush_data, zclient, zclient->sock);
+  return 0;
+}
+
+/* Send the nexthop (or import route) register or unregister message in
+   zclient->obuf.  zebra takes any number of entries in one of these, so
+   a message for the same command and VRF as the one being built is
+   merged into it, in zclient->bulk as well. */
+int
+zclient_send_rnh(struct zclient *zclient)
+{
+  struct stream *s = zclient->obuf;
+  struct stream *b = zclient->bulk;
+  size_t len = stream_get_endp(s);
+  size_t blen;
+
+  if (zclient->sock < 0)
+    return -1;
+
+  if (stream_get_endp(b)
+      && zclient->bulk_cmd == stream_getw_from(s, 6)
+      && STREAM_WRITEABLE(b) >= len - ZEBRA_HEADER_SIZE
+      && !memcmp(STREAM_DATA(b) + 2, STREAM_DATA(s) + 2,
+		 ZEBRA_HEADER_SIZE - 2))
+    {
+      stream_put(b, STREAM_DATA(s) + ZEBRA_HEADER_SIZE,
+		 len - ZEBRA_HEADER_SIZE);
+      stream_putw_at(b, 0, stream_get_endp(b));
+      return 0;
+    }
+
+  blen = zclient_bulk_put(zclient);
+  if (blen && zclient_queued(zclient, blen) < 0)
+    return -1;
+
+  stream_put(b, STREAM_DATA(s), len);
+  zclient->bulk_cmd = stream_getw_from(s, 6);
+  zclient->bulk_attrlen = 0;
+
+  THREAD_WRITE_ON(zclient->master, zclient->t_write,
+		  zclient_flush_data, zclient, zclient->sock);
+  return 0;
+}
+
 void
 zclient_create_header (struct stream *s, uint16_t command, vrf_id_t vrf_id)
 {
@@ -783,7 +1012,7 @@ zapi_ipv4_route (u_char cmd, struct zclient *zclient, struct prefix_ipv4 *p,
   /* Put length at the first point of the stream. */
   stream_putw_at (s, 0, stream_get_endp (s));
 
-  return zclient_send_message(zclient);
+  return zclient_send_route(zclient);
 }
 
 int
@@ -849,7 +1078,7 @@ zapi_ipv4_route_ipv6_nexthop (u_char cmd, struct zclient *zclient,
   /* Put length at the first point of the stream. */
   stream_putw_at (s, 0, stream_get_endp (s));
 
-  return zclient_send_message(zclient);
+  return zclient_send_message_coalesced(zclient);
 }
 
 int
@@ -915,7 +1144,7 @@ zapi_ipv6_route (u_char cmd, struct zclient *zclient, struct prefix_ipv6 *p,
   /* Put length at the first point of the stream. */
   stream_putw_at (s, 0, stream_get_endp (s));
 
-  return zclient_send_message(zclient);
+  return zclient_send_route(zclient);
 }
 
 /* 
@@ -75,6 +75,16 @@ struct zclient
   /* Thread to write buffered data to zebra. */
   struct thread *t_write;
 
+  /* Bytes of route messages queued in wb since it was last flushed. */
+  size_t coalesced;
+
+  /* Route messages being merged into one bulk message, see
+     zclient_send_route(), or nexthop registrations, see
+     zclient_send_rnh(). */
+  struct stream *bulk;
+  u_int16_t bulk_cmd;
+  size_t bulk_attrlen;
+
   /* Redistribute information. */
   u_char redist_default; /* clients protocol */
   u_short instance;
@@ -194,6 +204,14 @@ extern void zclient_redistribute_default (int command, struct zclient *,
    Returns 0 for success or -1 on an I/O error. */
 extern int zclient_send_message(struct zclient *);
 
+/* Same for a route add or delete message, which may be merged with the
+   routes around it into a bulk message. */
+extern int zclient_send_route(struct zclient *);
+
+/* Same for a nexthop or import route register or unregister message,
+   which may be merged with the ones around it. */
+extern int zclient_send_rnh(struct zclient *);
+
 /* create header for command, length to be filled in by user later */
 extern void zclient_create_header (struct stream *, uint16_t, vrf_id_t);
 extern int zclient_read_header (struct stream *s, int sock, u_int16_t *size,
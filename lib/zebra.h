@@ -406,6 +406,10 @@ typedef enum {
   ZEBRA_IPV6_NEXTHOP_ADD,
   ZEBRA_IPV6_NEXTHOP_DELETE,
   ZEBRA_IPMR_ROUTE_STATS,
+  ZEBRA_IPV4_ROUTE_BULK_ADD,
+  ZEBRA_IPV4_ROUTE_BULK_DELETE,
+  ZEBRA_IPV6_ROUTE_BULK_ADD,
+  ZEBRA_IPV6_ROUTE_BULK_DELETE,
 } zebra_message_types_t;
 
 /* Marker value used in new Zserv, in the byte location corresponding
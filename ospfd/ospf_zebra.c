@@ -483,7 +483,7 @@ ospf_zebra_add (struct prefix_ipv4 *p, struct ospf_route *or)
 
       stream_putw_at (s, 0, stream_get_endp (s));
 
-      zclient_send_message(zclient);
+      zclient_send_route(zclient);
     }
 }
 
@@ -575,7 +575,7 @@ ospf_zebra_delete (struct prefix_ipv4 *p, struct ospf_route *or)
 
       stream_putw_at (s, 0, stream_get_endp (s));
 
-      zclient_send_message(zclient);
+      zclient_send_route(zclient);
     }
 }
 
@@ -30,6 +30,7 @@
 #include "bgpd/bgpd.h"
 #include "bgpd/bgp_aspath.h"
 #include "bgpd/bgp_attr.h"
+#include "bgpd/bgp_regex.h"
 
 #define VT100_RESET "\x1b[0m"
 #define VT100_RED "\x1b[31m"
@@ -977,6 +978,7 @@ validate (struct aspath *as, const struct test_spec *sp)
   if (strcmp(aspath_print (as), sp->shouldbe)
          /* hash validation */
       || (aspath_key_make (as) != aspath_key_make (asinout))
+      || (asstr && aspath_key_make (as) != aspath_key_make (asstr))
          /* by string */
       || strcmp(aspath_print (asinout), sp->shouldbe)
          /* By 4-byte parsing */
@@ -1251,6 +1253,74 @@ cmp_test ()
     }
 }
 
+/* Matching on the segments must agree with the regex on the string. */
+static int
+regex_match_check (struct aspath *as, const char *str)
+{
+  struct bgp_asregex *asregex;
+  regex_t *regex;
+  int ret = 0;
+
+  asregex = bgp_asregex_comp (str);
+  regex = bgp_regcomp (str);
+
+  if (bgp_asregex_match (asregex, as)
+      != (bgp_regexec (regex, as) != REG_NOMATCH))
+    {
+      printf ("regex %s on %s: segments %d, string %d\n", str,
+              aspath_print (as), bgp_asregex_match (asregex, as),
+              bgp_regexec (regex, as) != REG_NOMATCH);
+      ret = 1;
+    }
+
+  bgp_regex_free (regex);
+  bgp_asregex_free (asregex);
+  return ret;
+}
+
+static void
+regex_test (struct test_segment *t)
+{
+  static const char *forms[] = { "_%u_", "^%u_", "_%u$", "^%u$", "_%u", };
+  static const char *fixed[] = { ".*", "^$", "_1_", "^01_", "_4294967296_", };
+  struct aspath *as;
+  struct assegment *seg;
+  char str[64];
+  unsigned int i, j;
+  int fail = 0;
+
+  printf ("%s: %s\n", t->name, t->desc);
+
+  as = make_aspath (t->asdata, t->len, 0);
+  if (! as)
+    {
+      printf (OK "\n\n");
+      return;
+    }
+
+  for (i = 0; i < sizeof (fixed) / sizeof (fixed[0]); i++)
+    fail |= regex_match_check (as, fixed[i]);
+
+  for (seg = as->segments; seg; seg = seg->next)
+    for (i = 0; i < seg->length; i++)
+      for (j = 0; j < sizeof (forms) / sizeof (forms[0]); j++)
+        {
+          snprintf (str, sizeof (str), forms[j], seg->as[i]);
+          fail |= regex_match_check (as, str);
+        }
+
+  if (fail)
+    {
+      failed++;
+      printf (FAILED "\n");
+    }
+  else
+    printf (OK "\n");
+
+  printf ("\n");
+  aspath_unintern (&as);
+}
+
 static int
 handle_attr_test (struct aspath_tests *t)
 {
@@ -1298,17 +1368,17 @@ handle_attr_test (struct aspath_tests *t)
       printf ("aspath is NULL, but should be: %s\n", t->shouldbe);
       failed++;
     }
-  if (t->shouldbe && attr.aspath && strcmp (attr.aspath->str, t->shouldbe))
+  if (t->shouldbe && attr.aspath && strcmp (aspath_print (attr.aspath), t->shouldbe))
     {
       printf ("attr str and 'shouldbe' mismatched!\n"
               "attr str:  %s\n"
               "shouldbe:  %s\n",
-              attr.aspath->str, t->shouldbe);
+              aspath_print (attr.aspath), t->shouldbe);
       failed++;
     }
   if (!t->shouldbe && attr.aspath)
     {
-      printf ("aspath should be NULL, but is: %s\n", attr.aspath->str);
+      printf ("aspath should be NULL, but is: %s\n", aspath_print (attr.aspath));
       failed++;
     }
 
@@ -1376,6 +1446,14 @@ main (void)
   
   i = 0;
   
+  while (test_segments[i].name)
+    {
+      printf ("regex test %u\n", i);
+      regex_test (&test_segments[i++]);
+    }
+  
+  i = 0;
+  
   while (aspath_tests[i].desc)
     {
       printf ("aspath_attr test %d\n", i);
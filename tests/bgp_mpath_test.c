@@ -288,16 +288,18 @@ testcase_t test_bgp_mp_list = {
  * Testcase for bgp_info_mpath_update
  */
 
-struct bgp_node test_rn;
+struct bgp_node *test_rn;
 
 static int
 setup_bgp_info_mpath_update (testcase_t *t)
 {
+  struct prefix p;
   int i;
-  str2prefix ("42.1.1.0/24", &test_rn.p);
+  str2prefix ("42.1.1.0/24", &p);
+  test_rn = bgp_node_get (bgp_table_init (AFI_IP, SAFI_UNICAST), &p);
   setup_bgp_mp_list (t);
   for (i = 0; i < test_mp_list_info_count; i++)
-    bgp_info_add (&test_rn, &test_mp_list_info[i]);
+    bgp_info_add (test_rn, &test_mp_list_info[i]);
   return 0;
 }
 
@@ -315,7 +317,7 @@ run_bgp_info_mpath_update (testcase_t *t)
   bgp_mp_list_add (&mp_list, &test_mp_list_info[1]);
   new_best = &test_mp_list_info[3];
   old_best = NULL;
-  bgp_info_mpath_update (&test_rn, new_best, old_best, &mp_list, &mp_cfg);
+  bgp_info_mpath_update (test_rn, new_best, old_best, &mp_list, &mp_cfg);
   bgp_mp_list_clear (&mp_list);
   EXPECT_TRUE (bgp_info_mpath_count (new_best) == 2, test_result);
   mpath = bgp_info_mpath_first (new_best);
@@ -329,7 +331,7 @@ run_bgp_info_mpath_update (testcase_t *t)
   bgp_mp_list_add (&mp_list, &test_mp_list_info[1]);
   new_best = &test_mp_list_info[0];
   old_best = &test_mp_list_info[3];
-  bgp_info_mpath_update (&test_rn, new_best, old_best, &mp_list, &mp_cfg);
+  bgp_info_mpath_update (test_rn, new_best, old_best, &mp_list, &mp_cfg);
   bgp_mp_list_clear (&mp_list);
   EXPECT_TRUE (bgp_info_mpath_count (new_best) == 1, test_result);
   mpath = bgp_info_mpath_first (new_best);
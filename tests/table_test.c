@@ -533,6 +533,180 @@ test_iter_pause (void)
   route_table_finish (table);
 }
 
+/*
+ * rand32
+ *
+ * Random 32 bits, from random() which gives 31.
+ */
+static u_int32_t
+rand32 (void)
+{
+  return ((u_int32_t) random () << 16) ^ random ();
+}
+
+/*
+ * random_bits
+ *
+ * Fill in the address of the given prefix with random bits after the
+ * first 'from' bits, and mask it to its length.
+ */
+static void
+random_bits (struct prefix *p, int from)
+{
+  u_char *bytes = &p->u.prefix;
+  int i, len = PSIZE (prefix_blen (p) * 8);
+
+  for (i = from / 8; i < len; i++)
+    {
+      u_char r = rand32 ();
+
+      if (i == from / 8 && from % 8)
+	bytes[i] = (bytes[i] & ~(0xff >> (from % 8))) | (r & (0xff >> (from % 8)));
+      else
+	bytes[i] = r;
+    }
+  apply_mask (p);
+}
+
+/*
+ * lpm_test_prefix
+ *
+ * Random prefix for checking the longest-match index, of any length,
+ * clustered in a few places so that prefixes nest often.
+ */
+static void
+lpm_test_prefix (int family, int len, struct prefix *p)
+{
+  static const u_char first[] = { 10, 11, 172, 192 };
+
+  memset (p, 0, sizeof (*p));
+  p->family = family;
+  p->prefixlen = len;
+  p->u.val[0] = first[rand32 () % 4];
+  p->u.val[1] = rand32 () % 4;
+  p->u.val[2] = rand32 () % 16;
+  random_bits (p, 24);
+}
+
+/*
+ * verify_lpm_match
+ *
+ * Verify that the tree walk and the index find the same node for the
+ * given prefix.
+ */
+static void
+verify_lpm_match (struct route_table *plain, struct route_table *indexed,
+		  struct prefix *p)
+{
+  struct route_node *rn1, *rn2;
+
+  rn1 = route_node_match (plain, p);
+  rn2 = route_node_match (indexed, p);
+
+  assert (!rn1 == !rn2);
+  if (rn1)
+    {
+      assert (prefix_same (&rn1->p, &rn2->p));
+      route_unlock_node (rn1);
+      route_unlock_node (rn2);
+    }
+}
+
+/*
+ * test_lpm_family
+ *
+ * Add and delete random prefixes in two tables, one with the
+ * longest-match index, and verify that they match the same.
+ */
+static void
+test_lpm_family (int family)
+{
+  struct route_table *plain, *indexed;
+  struct route_node *rn;
+  struct prefix p;
+  int maxlen, round, i;
+
+  maxlen = family == AF_INET ? IPV4_MAX_BITLEN : IPV6_MAX_BITLEN;
+  plain = route_table_init ();
+  indexed = route_table_init ();
+  route_table_enable_lpm (indexed, family);
+
+  for (round = 0; round < 50; round++)
+    {
+      /*
+       * Toggle prefixes, short ones included so that the index gets
+       * patched as well as rebuilt.
+       */
+      for (i = 0; i < 100; i++)
+	{
+	  lpm_test_prefix (family, rand32 () % (maxlen + 1), &p);
+
+	  rn = route_node_lookup (plain, &p);
+	  if (rn)
+	    {
+	      rn->info = NULL;
+	      route_unlock_node (rn);
+	      route_unlock_node (rn);
+
+	      rn = route_node_lookup (indexed, &p);
+	      assert (rn);
+	      rn->info = NULL;
+	      route_unlock_node (rn);
+	      route_unlock_node (rn);
+	    }
+	  else
+	    {
+	      rn = route_node_get (plain, &p);
+	      rn->info = rn;
+	      rn = route_node_get (indexed, &p);
+	      rn->info = rn;
+	    }
+	}
+
+      /*
+       * Match addresses and prefixes of any length.
+       */
+      for (i = 0; i < 1000; i++)
+	{
+	  lpm_test_prefix (family,
+			   i % 2 ? maxlen : (int) (rand32 () % (maxlen + 1)),
+			   &p);
+	  verify_lpm_match (plain, indexed, &p);
+	}
+    }
+
+  assert (route_table_count (plain) == route_table_count (indexed));
+  printf ("Verified longest-match index on %s table with %lu nodes\n",
+	  family == AF_INET ? "IPv4" : "IPv6", route_table_count (indexed));
+
+  for (rn = route_top (plain); rn; rn = route_next (rn))
+    if (rn->info)
+      {
+	rn->info = NULL;
+	route_unlock_node (rn);
+      }
+  for (rn = route_top (indexed); rn; rn = route_next (rn))
+    if (rn->info)
+      {
+	rn->info = NULL;
+	route_unlock_node (rn);
+      }
+  route_table_finish (plain);
+  route_table_finish (indexed);
+}
+
+/*
+ * test_lpm
+ */
+static void
+test_lpm (void)
+{
+  printf ("\n\nTesting the longest-match index\n");
+  srandom (1);
+  test_lpm_family (AF_INET);
+  test_lpm_family (AF_INET6);
+}
+
 /*
  * run_tests
  */
@@ -542,13 +716,318 @@ run_tests (void)
   test_prefix_iter_cmp ();
   test_get_next ();
   test_iter_pause ();
+  test_lpm ();
+}
+
+/*
+ * Benchmark.
+ *
+ * Prefix lengths are drawn from a distribution close to that of the IPv4
+ * and IPv6 default-free zones, in parts per ten thousand.  A third of the
+ * prefixes are more specifics of one drawn earlier, as happens with
+ * deaggregation, and the rest are spread over the unicast space.  Half of
+ * the addresses matched fall in a prefix of the table, the other half
+ * anywhere.
+ */
+struct len_weight
+{
+  int len;
+  int weight;
+};
+
+static const struct len_weight ipv4_lens[] =
+{
+  {  8,    1 }, { 11,    1 }, { 12,    4 }, { 13,    8 }, { 14,   15 },
+  { 15,   27 }, { 16,  200 }, { 17,  115 }, { 18,  195 }, { 19,  370 },
+  { 20,  620 }, { 21,  680 }, { 22, 1320 }, { 23,  930 }, { 24, 5514 },
+  {  0,    0 }
+};
+
+static const struct len_weight ipv6_lens[] =
+{
+  { 19,    2 }, { 20,   10 }, { 22,    5 }, { 24,   20 }, { 28,   50 },
+  { 29,  350 }, { 32, 2300 }, { 33,  150 }, { 36,  250 }, { 40,  450 },
+  { 44,  650 }, { 46,   50 }, { 47,   50 }, { 48, 5500 }, { 56,   90 },
+  { 64,   73 }, {  0,    0 }
+};
+
+static unsigned long
+now_ns (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000UL + ts.tv_nsec;
+}
+
+/* Resident set size, in kB. */
+static unsigned long
+rss_kb (void)
+{
+  unsigned long size, resident;
+  FILE *f;
+
+  f = fopen ("/proc/self/statm", "r");
+  if (!f)
+    return 0;
+  if (fscanf (f, "%lu %lu", &size, &resident) != 2)
+    resident = 0;
+  fclose (f);
+  return resident * (sysconf (_SC_PAGESIZE) / 1024);
+}
+
+/*
+ * bench_prefix
+ *
+ * Draw a prefix for the benchmark into p, with the first i of the array
+ * drawn already.
+ */
+static void
+bench_prefix (int family, struct prefix *pfx, int i,
+	      struct prefix *p)
+{
+  const struct len_weight *lens;
+  int w, len;
+
+  lens = family == AF_INET ? ipv4_lens : ipv6_lens;
+  w = rand32 () % 10000;
+  for (len = 0; lens[len].weight && w >= lens[len].weight; len++)
+    w -= lens[len].weight;
+  len = lens[len].weight ? lens[len].len : lens[len - 1].len;
+
+  memset (p, 0, sizeof (*p));
+  p->family = family;
+  p->prefixlen = len;
+
+  if (i && rand32 () % 3 == 0)
+    {
+      struct prefix *agg = &pfx[rand32 () % i];
+
+      if (agg->prefixlen < len)
+	{
+	  p->u.prefix6 = agg->u.prefix6;
+	  random_bits (p, agg->prefixlen);
+	  return;
+	}
+    }
+
+  if (family == AF_INET)
+    {
+      /* 1/8 to 223/8, less 10/8 and 127/8. */
+      do
+	p->u.val[0] = 1 + rand32 () % 223;
+      while (p->u.val[0] == 10 || p->u.val[0] == 127);
+      random_bits (p, 8);
+    }
+  else
+    {
+      /* 2001::/16, and 2400::/12 to 2c00::/12 by twos. */
+      p->u.val[0] = 0x20 + 4 * (rand32 () % 4);
+      if (p->u.val[0] == 0x20)
+	{
+	  p->u.val[1] = 0x01;
+	  random_bits (p, 16);
+	}
+      else
+	random_bits (p, 8);
+    }
+}
+
+struct bench_result
+{
+  unsigned long insert_ns, walk_ns, build_us, match_ns, churn_ns, delete_ns;
+  unsigned long index_kb;
+  unsigned long nodes, hits;
+};
+
+/*
+ * bench_run
+ *
+ * Time a table, with or without the index, over the given prefixes and
+ * addresses.
+ */
+static void
+bench_run (int family, int lpm, struct prefix *pfx, int count,
+	   struct prefix *addrs, int naddrs, struct bench_result *res)
+{
+  struct route_table *table;
+  struct route_node *rn;
+  unsigned long start, kb;
+  int i;
+
+  table = route_table_init ();
+  if (lpm)
+    route_table_enable_lpm (table, family);
+
+  start = now_ns ();
+  for (i = 0; i < count; i++)
+    {
+      rn = route_node_get (table, &pfx[i]);
+      if (rn->info)
+	route_unlock_node (rn);
+      else
+	rn->info = rn;
+    }
+  res->insert_ns = (now_ns () - start) / count;
+
+  res->nodes = 0;
+  start = now_ns ();
+  for (rn = route_top (table); rn; rn = route_next (rn))
+    res->nodes++;
+  res->walk_ns = (now_ns () - start) / res->nodes;
+
+  /* The first match builds the index. */
+  kb = rss_kb ();
+  start = now_ns ();
+  rn = route_node_match (table, &addrs[0]);
+  if (rn)
+    route_unlock_node (rn);
+  res->build_us = (now_ns () - start) / 1000;
+  res->index_kb = rss_kb () - kb;
+
+  res->hits = 0;
+  start = now_ns ();
+  for (i = 0; i < naddrs; i++)
+    {
+      rn = route_node_match (table, &addrs[i]);
+      if (rn)
+	{
+	  res->hits++;
+	  route_unlock_node (rn);
+	}
+    }
+  res->match_ns = (now_ns () - start) / naddrs;
+
+  /* Route flaps, each followed by a match. */
+  start = now_ns ();
+  for (i = 0; i < count / 10; i++)
+    {
+      rn = route_node_lookup (table, &pfx[i * 10]);
+      if (!rn)
+	continue;
+      rn->info = NULL;
+      route_unlock_node (rn);
+      route_unlock_node (rn);
+
+      rn = route_node_match (table, &addrs[i % naddrs]);
+      if (rn)
+	route_unlock_node (rn);
+
+      rn = route_node_get (table, &pfx[i * 10]);
+      rn->info = rn;
+
+      rn = route_node_match (table, &addrs[i % naddrs]);
+      if (rn)
+	route_unlock_node (rn);
+    }
+  res->churn_ns = (now_ns () - start) / (count / 10);
+
+  start = now_ns ();
+  for (i = 0; i < count; i++)
+    {
+      rn = route_node_lookup (table, &pfx[i]);
+      if (!rn)
+	continue;
+      rn->info = NULL;
+      route_unlock_node (rn);
+      route_unlock_node (rn);
+    }
+  res->delete_ns = (now_ns () - start) / count;
+
+  assert (route_table_count (table) == 0);
+  route_table_finish (table);
+}
+
+/*
+ * bench_family
+ */
+static void
+bench_family (int family, int count, int naddrs)
+{
+  struct prefix *pfx, *addrs;
+  struct bench_result res;
+  int i, from, maxlen;
+
+  maxlen = family == AF_INET ? IPV4_MAX_BITLEN : IPV6_MAX_BITLEN;
+  pfx = calloc (count, sizeof (struct prefix));
+  addrs = calloc (naddrs, sizeof (struct prefix));
+  assert (pfx && addrs);
+
+  srandom (1);
+  for (i = 0; i < count; i++)
+    bench_prefix (family, pfx, i, &pfx[i]);
+  for (i = 0; i < naddrs; i++)
+    {
+      if (i % 2)
+	addrs[i] = pfx[rand32 () % count];
+      else
+	bench_prefix (family, pfx, count, &addrs[i]);
+      from = addrs[i].prefixlen;
+      addrs[i].prefixlen = maxlen;
+      random_bits (&addrs[i], from);
+    }
+
+  printf ("%s:\n", family == AF_INET ? "IPv4" : "IPv6");
+  printf ("  %-6s %10s %10s %10s %10s %10s %10s %10s\n", "table",
+	  "insert ns", "walk ns", "match ns", "churn ns", "delete ns",
+	  "build us", "index kB");
+  for (i = 0; i < 2; i++)
+    {
+      bench_run (family, i, pfx, count, addrs, naddrs, &res);
+      printf ("  %-6s %10lu %10lu %10lu %10lu %10lu", i ? "index" : "tree",
+	      res.insert_ns, res.walk_ns, res.match_ns, res.churn_ns,
+	      res.delete_ns);
+      if (i)
+	printf (" %10lu %10lu\n", res.build_us, res.index_kb);
+      else
+	printf (" %10s %10s\n", "-", "-");
+    }
+  printf ("  %d prefixes in %lu nodes, %lu of %d addresses matched\n",
+	  count, res.nodes, res.hits, naddrs);
+
+  free (pfx);
+  free (addrs);
 }
 
 /*
  * main
  */
 int
-main (void)
+main (int argc, char **argv)
 {
-  run_tests ();
+  int bench = 0, count = 500000, naddrs = 1000000;
+  int opt;
+
+  while ((opt = getopt (argc, argv, "bn:m:")) != -1)
+    switch (opt)
+      {
+      case 'b':
+	bench = 1;
+	break;
+      case 'n':
+	count = atoi (optarg);
+	break;
+      case 'm':
+	naddrs = atoi (optarg);
+	break;
+      default:
+	fprintf (stderr, "usage: %s [-b [-n prefixes] [-m matches]]\n",
+		 argv[0]);
+	return 1;
+      }
+
+  if (!bench)
+    {
+      run_tests ();
+      return 0;
+    }
+
+  if (count < 10 || naddrs < 1)
+    {
+      fprintf (stderr, "bad arguments\n");
+      return 1;
+    }
+  bench_family (AF_INET, count, naddrs);
+  bench_family (AF_INET6, count, naddrs);
+  return 0;
 }
@@ -0,0 +1,378 @@
+/*
+ * Test program which checks how a BGP checkpoint file is loaded.
+ *
+ * Routes from a peer are written to a checkpoint, and taken away.  The
+ * file is then loaded back as written, and damaged in various ways:
+ * cut short, with an object of an unknown type, with counts at the end
+ * that do not match the records, and written too long ago.  Only the
+ * whole file may load without error, with all the routes stale, and
+ * whatever is loaded, the file must be renamed so that it is not loaded
+ * again.  Last the peer's End-of-RIB has to end the use of its loaded
+ * routes while it is down.
+ *
+ * This file is part of Quagga
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <zebra.h>
+
+#include "thread.h"
+#include "vty.h"
+#include "command.h"
+#include "prefix.h"
+#include "memory.h"
+#include "memory_vty.h"
+#include "privs.h"
+#include "vrf.h"
+#include "workqueue.h"
+#include "qobj.h"
+
+#include "bgpd/bgpd.h"
+#include "bgpd/bgp_table.h"
+#include "bgpd/bgp_attr.h"
+#include "bgpd/bgp_aspath.h"
+#include "bgpd/bgp_community.h"
+#include "bgpd/bgp_route.h"
+#include "bgpd/bgp_fsm.h"
+#include "bgpd/bgp_checkpoint.h"
+
+#define AFI AFI_IP
+#define SAFI SAFI_UNICAST
+
+/* need these to link in libbgp */
+struct thread_master *master = NULL;
+struct zebra_privs_t bgpd_privs =
+{
+  .user = NULL,
+  .group = NULL,
+  .vty_group = NULL,
+};
+
+static struct bgp *bgp;
+static struct peer *peer;
+static int nprefixes = 1000;
+static char path[64];
+static char loaded[80];
+static int failed;
+
+static void
+setup (void)
+{
+  as_t as = 65000;
+  union sockunion su;
+
+  qobj_init ();
+  bgp_master_init ();
+  master = bm->master;
+  bgp_option_set (BGP_OPT_NO_LISTEN);
+  bgp_option_set (BGP_OPT_NO_FIB);
+  cmd_init (1);
+  vty_init (master);
+  memory_init ();
+  vrf_init ();
+  bgp_init ();
+
+  /* Run the queue as soon as there is work. */
+  bm->process_main_queue->spec.hold = 0;
+
+  if (bgp_get (&bgp, &as, NULL, BGP_INSTANCE_TYPE_DEFAULT) < 0)
+    {
+      fprintf (stderr, "bgp_get failed\n");
+      exit (1);
+    }
+
+  str2sockunion ("192.0.2.1", &su);
+  peer = peer_create (&su, NULL, bgp, as, 64512, AS_SPECIFIED, AFI, SAFI,
+                      NULL);
+  BGP_TIMER_OFF (peer->t_start);
+  peer->afc_nego[AFI][SAFI] = 1;
+  peer->nexthop.v4 = peer->su.sin.sin_addr;
+}
+
+/* Process everything queued. */
+static void
+drain (void)
+{
+  struct thread thread;
+
+  while (listcount (bm->process_main_queue->items)
+         && thread_fetch (master, &thread))
+    thread_call (&thread);
+}
+
+static void
+announce (int n)
+{
+  struct attr attr;
+  struct prefix p;
+  char str[64];
+
+  memset (&attr, 0, sizeof (attr));
+  attr.origin = BGP_ORIGIN_IGP;
+  attr.flag |= ATTR_FLAG_BIT (BGP_ATTR_ORIGIN);
+
+  snprintf (str, sizeof (str), "64512 174 %u", 3000 + n % 7);
+  attr.aspath = aspath_intern (aspath_str2aspath (str));
+  attr.flag |= ATTR_FLAG_BIT (BGP_ATTR_AS_PATH);
+
+  snprintf (str, sizeof (str), "174:21000 65000:%u", n % 5);
+  attr.community = community_intern (community_str2com (str));
+  attr.flag |= ATTR_FLAG_BIT (BGP_ATTR_COMMUNITIES);
+
+  attr.nexthop = peer->su.sin.sin_addr;
+  attr.flag |= ATTR_FLAG_BIT (BGP_ATTR_NEXT_HOP);
+
+  memset (&p, 0, sizeof (p));
+  p.family = AF_INET;
+  p.prefixlen = 24;
+  p.u.prefix4.s_addr = htonl (0x0a000000 + (n << 8));
+
+  bgp_update (peer, &p, 0, &attr, AFI, SAFI, ZEBRA_ROUTE_BGP,
+              BGP_ROUTE_NORMAL, NULL, NULL, 0);
+  bgp_attr_unintern_sub (&attr);
+}
+
+/* Takes the peer's routes away. */
+static void
+clear (void)
+{
+  struct bgp_info *ri;
+
+  for (ri = peer->paths[AFI][SAFI]; ri; ri = ri->peer_next)
+    if (!CHECK_FLAG (ri->flags, BGP_INFO_REMOVED))
+      {
+        bgp_info_delete (ri->net, ri);
+        bgp_process (bgp, ri->net, AFI, SAFI);
+      }
+  drain ();
+}
+
+static int
+stale_routes (void)
+{
+  struct bgp_info *ri;
+  int n = 0;
+
+  for (ri = peer->paths[AFI][SAFI]; ri; ri = ri->peer_next)
+    if (CHECK_FLAG (ri->flags, BGP_INFO_STALE)
+        && !CHECK_FLAG (ri->flags, BGP_INFO_REMOVED))
+      n++;
+  return n;
+}
+
+static void
+write_file (const u_char *data, size_t size)
+{
+  FILE *fp;
+
+  fp = fopen (path, "w");
+  if (!fp || fwrite (data, 1, size, fp) != size || fclose (fp) != 0)
+    {
+      perror (path);
+      exit (1);
+    }
+}
+
+static u_char *
+read_file (size_t *size)
+{
+  struct stat st;
+  u_char *data;
+  FILE *fp;
+
+  fp = fopen (path, "r");
+  if (!fp || fstat (fileno (fp), &st) < 0)
+    {
+      perror (path);
+      exit (1);
+    }
+  data = malloc (st.st_size);
+  if (fread (data, 1, st.st_size, fp) != (size_t) st.st_size)
+    {
+      perror (path);
+      exit (1);
+    }
+  fclose (fp);
+  *size = st.st_size;
+  return data;
+}
+
+/* Loads DATA as the checkpoint, which has to give RET and load WANT
+   routes, or any number of them if WANT is -1. */
+static void
+load (const char *what, const u_char *data, size_t size, int ret, int want)
+{
+  struct stat st;
+  int got_ret, got;
+
+  write_file (data, size);
+  peer->status = Idle;
+  got_ret = bgp_checkpoint_read ();
+  got = stale_routes ();
+  clear ();
+  UNSET_FLAG (peer->sflags, PEER_STATUS_CHECKPOINT);
+
+  if (got_ret != ret || (want >= 0 && got != want))
+    {
+      fprintf (stderr, "%s: returned %d with %d routes, not %d with %d\n",
+               what, got_ret, got, ret, want);
+      failed = 1;
+    }
+  else if (stat (path, &st) == 0 || stat (loaded, &st) < 0)
+    {
+      fprintf (stderr, "%s: %s was not renamed\n", what, path);
+      failed = 1;
+    }
+  else
+    printf ("%s: ok\n", what);
+  unlink (path);
+  unlink (loaded);
+}
+
+/* The first record of TYPE in DATA, or NULL. */
+static struct bgp_checkpoint_record *
+find_record (u_char *data, size_t size, int type)
+{
+  struct bgp_checkpoint_record *rec;
+  size_t pos = sizeof (struct bgp_checkpoint_header);
+
+  while (pos + sizeof (*rec) <= size)
+    {
+      rec = (void *) (data + pos);
+      if (rec->type == type)
+        return rec;
+      pos += sizeof (*rec) + ((rec->length + 3) & ~3);
+    }
+  return NULL;
+}
+
+/* Loads DATA with the end counts changed by CHANGE. */
+static void
+load_bad_end (const char *what, const u_char *data, size_t size,
+              void (*change) (struct bgp_checkpoint_end *))
+{
+  struct bgp_checkpoint_record *rec;
+  u_char *copy;
+
+  copy = malloc (size);
+  memcpy (copy, data, size);
+  rec = find_record (copy, size, BGP_CHECKPOINT_END);
+  assert (rec);
+  change ((void *) (rec + 1));
+  load (what, copy, size, -1, -1);
+  free (copy);
+}
+
+static void
+more_attrs (struct bgp_checkpoint_end *end)
+{
+  end->attrs++;
+}
+
+static void
+fewer_paths (struct bgp_checkpoint_end *end)
+{
+  end->paths--;
+}
+
+static void
+more_paths (struct bgp_checkpoint_end *end)
+{
+  end->paths++;
+}
+
+int
+main (void)
+{
+  struct bgp_checkpoint_header *hdr;
+  struct bgp_checkpoint_record *rec;
+  u_char *data, *copy;
+  size_t size;
+  int i;
+
+  snprintf (path, sizeof (path), "/tmp/test-bgp-checkpoint.%d",
+            (int) getpid ());
+  snprintf (loaded, sizeof (loaded), "%s.loaded", path);
+
+  setup ();
+  peer->status = Established;
+  for (i = 0; i < nprefixes; i++)
+    announce (i);
+  drain ();
+
+  bgp_checkpoint_set (path);
+  if (bgp_checkpoint_save () < 0)
+    {
+      fprintf (stderr, "can't write the checkpoint\n");
+      return 1;
+    }
+  data = read_file (&size);
+  clear ();
+
+  load ("whole", data, size, 0, nprefixes);
+
+  copy = malloc (size);
+
+  memcpy (copy, data, size);
+  hdr = (void *) copy;
+  hdr->time -= 2 * BGP_CHECKPOINT_MAX_AGE_DEFAULT;
+  load ("too old", copy, size, -1, 0);
+
+  load ("header only", data, sizeof (struct bgp_checkpoint_header), -1, 0);
+  load ("cut in the middle", data, size / 2, -1, -1);
+  load ("cut in the end record", data, size - 1, -1, nprefixes);
+  rec = find_record (data, size, BGP_CHECKPOINT_END);
+  assert (rec);
+  load ("no end record", data, (u_char *) rec - data, -1, nprefixes);
+
+  memcpy (copy, data, size);
+  rec = find_record (copy, size, BGP_CHECKPOINT_OBJ);
+  assert (rec);
+  rec->subtype = 99;
+  load ("unknown object type", copy, size, -1, 0);
+
+  load_bad_end ("attribute count", data, size, more_attrs);
+  load_bad_end ("fewer paths", data, size, fewer_paths);
+  load_bad_end ("more paths", data, size, more_paths);
+
+  /* Loaded routes are used while the peer is down, until its End-of-RIB
+     for all it sends. */
+  write_file (data, size);
+  peer->status = Idle;
+  bgp_checkpoint_read ();
+  if (!CHECK_FLAG (peer->sflags, PEER_STATUS_CHECKPOINT))
+    {
+      fprintf (stderr, "End-of-RIB: the peer's routes are not in use\n");
+      failed = 1;
+    }
+  SET_FLAG (peer->af_sflags[AFI][SAFI], PEER_STATUS_EOR_RECEIVED);
+  bgp_clear_stale_route (peer, AFI, SAFI);
+  bgp_checkpoint_eor (peer);
+  drain ();
+  if (CHECK_FLAG (peer->sflags, PEER_STATUS_CHECKPOINT) || stale_routes ())
+    {
+      fprintf (stderr, "End-of-RIB: the peer's routes are still in use\n");
+      failed = 1;
+    }
+  else
+    printf ("End-of-RIB: ok\n");
+  unlink (loaded);
+
+  free (copy);
+  free (data);
+  return failed;
+}
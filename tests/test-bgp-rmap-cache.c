@@ -0,0 +1,232 @@
+/*
+ * Test program which checks that route-maps which cache their results
+ * see the community-lists they use change.
+ *
+ * Route-maps and community-lists are configured from the CLI, and the
+ * maps are applied to routes with a few communities.  After each edit
+ * of a list the maps have to give the result the new list makes, not
+ * the one they cached: for "set comm-list ... delete", for one such
+ * rule replaced with another list, for "match community ... exact-match",
+ * and for a match which stays when a set using the same list goes.
+ *
+ * This file is part of Quagga
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <zebra.h>
+
+#include "thread.h"
+#include "vty.h"
+#include "command.h"
+#include "vector.h"
+#include "prefix.h"
+#include "routemap.h"
+#include "hash.h"
+#include "memory.h"
+#include "memory_vty.h"
+#include "privs.h"
+#include "vrf.h"
+#include "qobj.h"
+
+#include "bgpd/bgpd.h"
+#include "bgpd/bgp_attr.h"
+#include "bgpd/bgp_aspath.h"
+#include "bgpd/bgp_community.h"
+#include "bgpd/bgp_route.h"
+#include "bgpd/bgp_fsm.h"
+
+/* need these to link in libbgp */
+struct thread_master *master = NULL;
+struct zebra_privs_t bgpd_privs =
+{
+  .user = NULL,
+  .group = NULL,
+  .vty_group = NULL,
+};
+
+static struct vty *vty;
+static struct peer *peer;
+static int failed;
+
+static void
+setup (void)
+{
+  as_t as = 65000;
+  union sockunion su;
+  struct bgp *bgp;
+
+  qobj_init ();
+  bgp_master_init ();
+  master = bm->master;
+  bgp_option_set (BGP_OPT_NO_LISTEN);
+  bgp_option_set (BGP_OPT_NO_FIB);
+  cmd_init (1);
+  vty_init (master);
+  memory_init ();
+  vrf_init ();
+  bgp_init ();
+
+  if (bgp_get (&bgp, &as, NULL, BGP_INSTANCE_TYPE_DEFAULT) < 0)
+    {
+      fprintf (stderr, "bgp_get failed\n");
+      exit (1);
+    }
+  str2sockunion ("192.0.2.1", &su);
+  peer = peer_create (&su, NULL, bgp, as, 64512, AS_SPECIFIED,
+                      AFI_IP, SAFI_UNICAST, NULL);
+  BGP_TIMER_OFF (peer->t_start);
+
+  vty = vty_new ();
+  vty->type = VTY_TERM;
+}
+
+/* Runs LINE in the node the last command left the vty in. */
+static void
+cli (const char *line)
+{
+  vector vline;
+  int ret;
+
+  vline = cmd_make_strvec (line);
+  ret = cmd_execute_command (vline, vty, NULL, 0);
+  cmd_free_strvec (vline);
+  if (ret != CMD_SUCCESS)
+    {
+      fprintf (stderr, "\"%s\" failed: %d\n", line, ret);
+      exit (1);
+    }
+}
+
+/* Runs LINE from the configuration node. */
+static void
+config (const char *line)
+{
+  vty->node = CONFIG_NODE;
+  cli (line);
+}
+
+/* Applies the route-map NAME, as for routes from the peer, to a route
+   with the communities COMMS.  Gives the communities it ends up with, or
+   "deny". */
+static const char *
+apply (const char *name, const char *comms)
+{
+  static char buf[256];
+  struct route_map *map;
+  struct bgp_info info;
+  struct attr attr, tmp;
+  struct prefix p;
+  route_map_result_t ret;
+
+  map = route_map_lookup_by_name (name);
+  assert (map);
+
+  memset (&attr, 0, sizeof (attr));
+  attr.origin = BGP_ORIGIN_IGP;
+  attr.flag |= ATTR_FLAG_BIT (BGP_ATTR_ORIGIN);
+  attr.aspath = aspath_intern (aspath_str2aspath ("64512"));
+  attr.flag |= ATTR_FLAG_BIT (BGP_ATTR_AS_PATH);
+  attr.community = community_intern (community_str2com (comms));
+  attr.flag |= ATTR_FLAG_BIT (BGP_ATTR_COMMUNITIES);
+
+  str2prefix ("10.0.0.0/24", &p);
+  bgp_attr_dup (&tmp, &attr);
+  memset (&info, 0, sizeof (info));
+  info.peer = peer;
+  info.attr = &tmp;
+
+  SET_FLAG (peer->rmap_type, PEER_RMAP_TYPE_IN);
+  ret = bgp_route_map_apply (map, &p, &info);
+  peer->rmap_type = 0;
+
+  /* Otherwise this checks nothing. */
+  if (! map->cache || ! map->cache->count)
+    {
+      fprintf (stderr, "route-map %s did not cache its result\n", name);
+      exit (1);
+    }
+
+  if (ret == RMAP_DENYMATCH)
+    snprintf (buf, sizeof (buf), "deny");
+  else
+    snprintf (buf, sizeof (buf), "%s",
+              tmp.community ? community_str (tmp.community) : "");
+  bgp_attr_flush (&tmp);
+  bgp_attr_unintern_sub (&attr);
+  return buf;
+}
+
+static void
+check (const char *what, const char *name, const char *comms,
+       const char *want)
+{
+  const char *got = apply (name, comms);
+
+  if (strcmp (got, want))
+    {
+      fprintf (stderr, "%s: route-map %s gave \"%s\" for \"%s\", "
+               "not \"%s\"\n", what, name, got, comms, want);
+      failed = 1;
+    }
+  else
+    printf ("%s: ok\n", what);
+}
+
+int
+main (void)
+{
+  const char *comms = "65000:1 65000:2 65000:3";
+
+  setup ();
+
+  config ("ip community-list standard L permit 65000:1");
+  config ("route-map DEL permit 10");
+  cli ("set comm-list L delete");
+  check ("set", "DEL", comms, "65000:2 65000:3");
+  config ("ip community-list standard L permit 65000:2");
+  check ("set, entry added", "DEL", comms, "65000:3");
+  config ("no ip community-list standard L permit 65000:1");
+  check ("set, entry deleted", "DEL", comms, "65000:1 65000:3");
+
+  config ("ip community-list standard L2 permit 65000:3");
+  config ("route-map DEL permit 10");
+  cli ("set comm-list L2 delete");
+  check ("set replaced", "DEL", comms, "65000:1 65000:2");
+  config ("ip community-list standard L2 permit 65000:1");
+  check ("set replaced, entry added", "DEL", comms, "65000:2");
+
+  config ("ip community-list standard X permit 65000:1 65000:2 65000:3");
+  config ("route-map EX permit 10");
+  cli ("match community X exact-match");
+  check ("exact-match", "EX", comms, comms);
+  config ("no ip community-list standard X permit 65000:1 65000:2 65000:3");
+  config ("ip community-list standard X permit 65000:1");
+  check ("exact-match, list changed", "EX", comms, "deny");
+
+  config ("ip community-list standard M permit 65000:1");
+  config ("route-map BOTH permit 10");
+  cli ("match community M");
+  cli ("set comm-list M delete");
+  check ("match and set", "BOTH", comms, "65000:2 65000:3");
+  config ("route-map BOTH permit 10");
+  cli ("no set comm-list");
+  check ("set gone", "BOTH", comms, comms);
+  config ("no ip community-list standard M permit 65000:1");
+  check ("set gone, list deleted", "BOTH", comms, "deny");
+
+  return failed;
+}
@@ -0,0 +1,316 @@
+/*
+ * Test program which measures how fast bgpd converges on a full table
+ * depending on the number of best path selection workers.
+ *
+ * Usage: test-bgp-select-performance [-n peers] [-p prefixes] [-w workers,...]
+ *
+ * Every peer announces the same prefixes, each with a random AS path,
+ * origin and MED, and then withdraws them.  For each number of workers,
+ * the time to replay the updates and the time to process them are
+ * reported, and the best paths and multipaths are checked to be the
+ * same as without workers.  Deterministic MED and multipath are on, so
+ * that all of selection is exercised.  Multicast is used so that the
+ * paths are valid without nexthop tracking.
+ *
+ * This file is part of Quagga
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <zebra.h>
+
+#include "qobj.h"
+#include "vty.h"
+#include "command.h"
+#include "memory.h"
+#include "memory_vty.h"
+#include "privs.h"
+#include "sockunion.h"
+#include "workqueue.h"
+#include "vrf.h"
+
+#include "bgpd/bgpd.h"
+#include "bgpd/bgp_fsm.h"
+#include "bgpd/bgp_table.h"
+#include "bgpd/bgp_route.h"
+#include "bgpd/bgp_attr.h"
+#include "bgpd/bgp_aspath.h"
+#include "bgpd/bgp_mpath.h"
+#include "bgpd/bgp_select.h"
+
+#include "prng.h"
+
+#define AFI AFI_IP
+#define SAFI SAFI_MULTICAST
+
+/* need these to link in libbgp */
+struct thread_master *master = NULL;
+struct zebra_privs_t bgpd_privs =
+{
+  .user = NULL,
+  .group = NULL,
+  .vty_group = NULL,
+};
+
+static struct bgp *bgp;
+static struct peer **peers;
+static int npeers = 8;
+static int nprefixes = 100000;
+
+static unsigned long
+elapsed_us (struct timeval *start)
+{
+  struct timeval now;
+
+  gettimeofday (&now, NULL);
+  return (now.tv_sec - start->tv_sec) * 1000000
+         + (now.tv_usec - start->tv_usec);
+}
+
+static void
+prefix_nth (struct prefix *p, int i)
+{
+  memset (p, 0, sizeof (*p));
+  p->family = AF_INET;
+  p->prefixlen = 24;
+  p->u.prefix4.s_addr = htonl (0x0a000000 + (i << 8));
+}
+
+static void
+setup (void)
+{
+  as_t as = 65000;
+  union sockunion su;
+  char addr[32];
+  int i;
+
+  qobj_init ();
+  bgp_master_init ();
+  master = bm->master;
+  bgp_option_set (BGP_OPT_NO_LISTEN);
+  bgp_option_set (BGP_OPT_NO_FIB);
+  cmd_init (1);
+  vty_init (master);
+  memory_init ();
+  vrf_init ();
+  bgp_init ();
+  bgp_select_start ();
+
+  /* Run the queue as soon as there is work. */
+  bm->process_main_queue->spec.hold = 0;
+
+  if (bgp_get (&bgp, &as, NULL, BGP_INSTANCE_TYPE_DEFAULT) < 0)
+    {
+      fprintf (stderr, "bgp_get failed\n");
+      exit (1);
+    }
+  bgp_flag_set (bgp, BGP_FLAG_DETERMINISTIC_MED);
+  bgp_flag_set (bgp, BGP_FLAG_ASPATH_MULTIPATH_RELAX);
+  bgp->maxpaths[AFI][SAFI].maxpaths_ebgp = 4;
+
+  peers = calloc (npeers, sizeof (struct peer *));
+  for (i = 0; i < npeers; i++)
+    {
+      snprintf (addr, sizeof (addr), "192.0.2.%d", i + 1);
+      str2sockunion (addr, &su);
+      peers[i] = peer_create (&su, NULL, bgp, as, 64512 + i, AS_SPECIFIED,
+                              AFI, SAFI, NULL);
+
+      /* Pretend the session is up, and keep the FSM from starting it. */
+      BGP_TIMER_OFF (peers[i]->t_start);
+      peers[i]->status = Established;
+      peers[i]->afc_nego[AFI][SAFI] = 1;
+    }
+}
+
+/* Process everything queued. */
+static void
+drain (void)
+{
+  struct thread thread;
+
+  while (listcount (bm->process_main_queue->items)
+         && thread_fetch (master, &thread))
+    thread_call (&thread);
+}
+
+static void
+announce (struct prng *prng)
+{
+  struct attr attr;
+  struct prefix p;
+  char path[64];
+  int i, j, k, len;
+
+  for (i = 0; i < nprefixes; i++)
+    {
+      prefix_nth (&p, i);
+      for (j = 0; j < npeers; j++)
+        {
+          memset (&attr, 0, sizeof (attr));
+          bgp_attr_extra_get (&attr);
+          attr.origin = prng_rand (prng) % 3;
+          attr.flag |= ATTR_FLAG_BIT (BGP_ATTR_ORIGIN);
+
+          len = snprintf (path, sizeof (path), "%u", peers[j]->as);
+          for (k = prng_rand (prng) % 4; k > 0; k--)
+            len += snprintf (path + len, sizeof (path) - len, " %u",
+                             1 + prng_rand (prng) % 8);
+          attr.aspath = aspath_intern (aspath_str2aspath (path));
+          attr.flag |= ATTR_FLAG_BIT (BGP_ATTR_AS_PATH);
+
+          attr.med = prng_rand (prng) % 4;
+          attr.flag |= ATTR_FLAG_BIT (BGP_ATTR_MULTI_EXIT_DISC);
+          attr.nexthop = peers[j]->su.sin.sin_addr;
+          attr.flag |= ATTR_FLAG_BIT (BGP_ATTR_NEXT_HOP);
+
+          bgp_update (peers[j], &p, 0, &attr, AFI, SAFI, ZEBRA_ROUTE_BGP,
+                      BGP_ROUTE_NORMAL, NULL, NULL, 0);
+          bgp_attr_unintern_sub (&attr);
+          bgp_attr_extra_free (&attr);
+        }
+    }
+}
+
+static void
+withdraw (void)
+{
+  struct prefix p;
+  int i, j;
+
+  for (i = 0; i < nprefixes; i++)
+    {
+      prefix_nth (&p, i);
+      for (j = 0; j < npeers; j++)
+        bgp_withdraw (peers[j], &p, 0, NULL, AFI, SAFI, ZEBRA_ROUTE_BGP,
+                      BGP_ROUTE_NORMAL, NULL, NULL);
+    }
+}
+
+/* Which peer each prefix is best from, and its number of multipaths. */
+static void
+snapshot (int *best)
+{
+  struct bgp_node *rn;
+  struct bgp_info *ri;
+  int i = 0, j;
+
+  for (rn = bgp_table_top (bgp->rib[AFI][SAFI]); rn; rn = bgp_route_next (rn))
+    {
+      if (!rn->info || i == nprefixes)
+        continue;
+      best[i] = -1;
+      for (ri = rn->info; ri; ri = ri->next)
+        if (CHECK_FLAG (ri->flags, BGP_INFO_SELECTED))
+          for (j = 0; j < npeers; j++)
+            if (ri->peer == peers[j])
+              best[i] = j * 256 + bgp_info_mpath_count (ri);
+      i++;
+    }
+}
+
+static void
+run (int workers, int *best, int *ref)
+{
+  struct prng *prng;
+  struct timeval start;
+  unsigned long t_replay, t_process, t_withdraw;
+
+  if (bgp_select_workers_set (workers) < 0)
+    {
+      fprintf (stderr, "could not start %d workers\n", workers);
+      exit (1);
+    }
+
+  /* The same updates for every run. */
+  prng = prng_new (0);
+  gettimeofday (&start, NULL);
+  announce (prng);
+  t_replay = elapsed_us (&start);
+  drain ();
+  t_process = elapsed_us (&start) - t_replay;
+  prng_free (prng);
+
+  snapshot (best);
+  if (ref && memcmp (best, ref, nprefixes * sizeof (int)))
+    {
+      fprintf (stderr, "best paths differ with %d workers\n", workers);
+      exit (1);
+    }
+
+  gettimeofday (&start, NULL);
+  withdraw ();
+  drain ();
+  t_withdraw = elapsed_us (&start);
+
+  printf ("%7d %10lu.%03lu %10lu.%03lu %10lu.%03lu %10lu.%03lu\n", workers,
+          t_replay / 1000, t_replay % 1000,
+          t_process / 1000, t_process % 1000,
+          (t_replay + t_process) / 1000, (t_replay + t_process) % 1000,
+          t_withdraw / 1000, t_withdraw % 1000);
+}
+
+int
+main (int argc, char **argv)
+{
+  const char *workers = "1,2,4";
+  char *list, *tok, *save;
+  int *ref, *best;
+  int opt;
+
+  while ((opt = getopt (argc, argv, "n:p:w:")) != -1)
+    switch (opt)
+      {
+      case 'n':
+        npeers = atoi (optarg);
+        break;
+      case 'p':
+        nprefixes = atoi (optarg);
+        break;
+      case 'w':
+        workers = optarg;
+        break;
+      default:
+        fprintf (stderr, "usage: %s [-n peers] [-p prefixes] "
+                 "[-w workers,...]\n", argv[0]);
+        return 1;
+      }
+  if (npeers < 1 || npeers > 250 || nprefixes < 1 || nprefixes > 65536 * 256)
+    {
+      fprintf (stderr, "bad number of peers or prefixes\n");
+      return 1;
+    }
+
+  setup ();
+  ref = calloc (nprefixes, sizeof (int));
+  best = calloc (nprefixes, sizeof (int));
+
+  /* A serial run first, to compare with. */
+  printf ("%d peers, %d prefixes, times in ms\n", npeers, nprefixes);
+  printf ("%7s %14s %14s %14s %14s\n", "workers", "replay", "process",
+          "converged", "withdraw");
+  run (0, ref, NULL);
+
+  list = strdup (workers);
+  for (tok = strtok_r (list, ",", &save); tok;
+       tok = strtok_r (NULL, ",", &save))
+    run (atoi (tok), best, ref);
+
+  free (list);
+  free (best);
+  free (ref);
+  return 0;
+}
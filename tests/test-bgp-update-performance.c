@@ -0,0 +1,373 @@
+/*
+ * Test program which measures how fast bgpd builds UPDATE messages for
+ * an update subgroup, with and without the encoded attribute cache.
+ *
+ * Usage: test-bgp-update-performance [-n peers] [-p prefixes]
+ *                                    [-a attributes] [-b batch] [-r rounds]
+ *                                    [-c sizes,...]
+ *
+ * One peer announces the prefixes, each with one of a few attribute
+ * sets, to the others.  Then, for a number of rounds, batches of the
+ * prefixes move to another of the attribute sets, as route churn would,
+ * and the UPDATEs for each batch are built.  For each cache size, the
+ * time spent building the UPDATEs is reported, and the UPDATEs are
+ * checked to be the same as without the cache.  Multicast is used so
+ * that the paths are valid without nexthop tracking, and so that the
+ * MP_REACH_NLRI is built as well.
+ *
+ * This file is part of Quagga
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <zebra.h>
+
+#include "qobj.h"
+#include "vty.h"
+#include "command.h"
+#include "memory.h"
+#include "memory_vty.h"
+#include "privs.h"
+#include "sockunion.h"
+#include "workqueue.h"
+#include "stream.h"
+#include "jhash.h"
+#include "queue.h"
+#include "vrf.h"
+
+#include "bgpd/bgpd.h"
+#include "bgpd/bgp_fsm.h"
+#include "bgpd/bgp_table.h"
+#include "bgpd/bgp_route.h"
+#include "bgpd/bgp_attr.h"
+#include "bgpd/bgp_aspath.h"
+#include "bgpd/bgp_community.h"
+#include "bgpd/bgp_advertise.h"
+#include "bgpd/bgp_updgrp.h"
+
+#define AFI AFI_IP
+#define SAFI SAFI_MULTICAST
+
+/* need these to link in libbgp */
+struct thread_master *master = NULL;
+struct zebra_privs_t bgpd_privs =
+{
+  .user = NULL,
+  .group = NULL,
+  .vty_group = NULL,
+};
+
+static struct bgp *bgp;
+static struct peer **peers;
+static int npeers = 4;
+static int nprefixes = 10000;
+static int nattrs = 16;
+static int batch = 10;
+static int rounds = 20;
+
+/* What was built in a run. */
+struct result
+{
+  unsigned long packets;
+  unsigned long bytes;
+  u_int32_t digest;
+  unsigned long us;
+};
+
+static unsigned long
+elapsed_us (struct timeval *start)
+{
+  struct timeval now;
+
+  gettimeofday (&now, NULL);
+  return (now.tv_sec - start->tv_sec) * 1000000
+         + (now.tv_usec - start->tv_usec);
+}
+
+static void
+prefix_nth (struct prefix *p, int i)
+{
+  memset (p, 0, sizeof (*p));
+  p->family = AF_INET;
+  p->prefixlen = 24;
+  p->u.prefix4.s_addr = htonl (0x0a000000 + (i << 8));
+}
+
+static void
+setup (void)
+{
+  as_t as = 65000;
+  union sockunion su;
+  char addr[32];
+  int i;
+
+  qobj_init ();
+  bgp_master_init ();
+  master = bm->master;
+  bgp_option_set (BGP_OPT_NO_LISTEN);
+  bgp_option_set (BGP_OPT_NO_FIB);
+  cmd_init (1);
+  vty_init (master);
+  memory_init ();
+  vrf_init ();
+  bgp_init ();
+
+  /* Run the queue as soon as there is work. */
+  bm->process_main_queue->spec.hold = 0;
+
+  if (bgp_get (&bgp, &as, NULL, BGP_INSTANCE_TYPE_DEFAULT) < 0)
+    {
+      fprintf (stderr, "bgp_get failed\n");
+      exit (1);
+    }
+
+  /* Packets are built here rather than as peers can take them. */
+  bgp->default_subgroup_pkt_queue_max = UINT32_MAX;
+  bgp->coalesce_time = 0;
+
+  /* peers[0] announces, the others receive. */
+  peers = calloc (npeers + 1, sizeof (struct peer *));
+  for (i = 0; i <= npeers; i++)
+    {
+      snprintf (addr, sizeof (addr), "192.0.2.%d", i + 1);
+      str2sockunion (addr, &su);
+      peers[i] = peer_create (&su, NULL, bgp, as, 64512 + i, AS_SPECIFIED,
+                              AFI, SAFI, NULL);
+
+      /* Pretend the session is up, and keep the FSM from starting it. */
+      BGP_TIMER_OFF (peers[i]->t_start);
+      peers[i]->status = Established;
+      peers[i]->afc_nego[AFI][SAFI] = 1;
+      peers[i]->nexthop.v4 = peers[i]->su.sin.sin_addr;
+      if (i == 0)
+        continue;
+
+      /* Keep the UPDATEs from being written, there is no socket. */
+      peers[i]->v_routeadv = 3600;
+      peers[i]->last_update = bgp_clock ();
+      update_group_adjust_peer_afs (peers[i]);
+      peers[i]->status = OpenConfirm;
+    }
+}
+
+/* Process everything queued. */
+static void
+drain (void)
+{
+  struct thread thread;
+
+  while (listcount (bm->process_main_queue->items)
+         && thread_fetch (master, &thread))
+    thread_call (&thread);
+}
+
+/* Attribute set n, with a path and communities as often seen. */
+static void
+announce (int prefix, int n)
+{
+  struct attr attr;
+  struct prefix p;
+  char path[64];
+  char comms[64];
+
+  memset (&attr, 0, sizeof (attr));
+  bgp_attr_extra_get (&attr);
+  attr.origin = BGP_ORIGIN_IGP;
+  attr.flag |= ATTR_FLAG_BIT (BGP_ATTR_ORIGIN);
+
+  snprintf (path, sizeof (path), "%u 174 %u %u", peers[0]->as,
+            3000 + n, 64000 + n % 7);
+  attr.aspath = aspath_intern (aspath_str2aspath (path));
+  attr.flag |= ATTR_FLAG_BIT (BGP_ATTR_AS_PATH);
+
+  snprintf (comms, sizeof (comms), "174:21000 174:22013 65000:%u", n);
+  attr.community = community_intern (community_str2com (comms));
+  attr.flag |= ATTR_FLAG_BIT (BGP_ATTR_COMMUNITIES);
+
+  attr.med = n;
+  attr.flag |= ATTR_FLAG_BIT (BGP_ATTR_MULTI_EXIT_DISC);
+  attr.nexthop = peers[0]->su.sin.sin_addr;
+  attr.flag |= ATTR_FLAG_BIT (BGP_ATTR_NEXT_HOP);
+  attr.extra->mp_nexthop_global_in = attr.nexthop;
+  attr.extra->mp_nexthop_len = BGP_ATTR_NHLEN_IPV4;
+
+  prefix_nth (&p, prefix);
+  bgp_update (peers[0], &p, 0, &attr, AFI, SAFI, ZEBRA_ROUTE_BGP,
+              BGP_ROUTE_NORMAL, NULL, NULL, 0);
+  bgp_attr_unintern_sub (&attr);
+  bgp_attr_extra_free (&attr);
+}
+
+static void
+withdraw (void)
+{
+  struct prefix p;
+  int i;
+
+  for (i = 0; i < nprefixes; i++)
+    {
+      prefix_nth (&p, i);
+      bgp_withdraw (peers[0], &p, 0, NULL, AFI, SAFI, ZEBRA_ROUTE_BGP,
+                    BGP_ROUTE_NORMAL, NULL, NULL);
+    }
+}
+
+static int
+build_walkcb (struct update_group *updgrp, void *arg)
+{
+  struct result *res = arg;
+  struct update_subgroup *subgrp;
+  struct bpacket *pkt;
+  struct timeval start;
+  unsigned long us;
+  size_t len;
+
+  UPDGRP_FOREACH_SUBGRP (updgrp, subgrp)
+    {
+      for (;;)
+        {
+          gettimeofday (&start, NULL);
+          pkt = subgroup_update_packet (subgrp);
+          us = elapsed_us (&start);
+          if (!pkt)
+            break;
+
+          res->us += us;
+          res->packets++;
+          len = stream_get_endp (pkt->buffer);
+          res->bytes += len;
+          res->digest = jhash (STREAM_DATA (pkt->buffer), len, res->digest);
+          res->digest = jhash (&pkt->arr, sizeof (pkt->arr), res->digest);
+        }
+
+      /* Withdrawals are not what is measured, but keep them going. */
+      while (subgroup_withdraw_packet (subgrp))
+        ;
+    }
+  return UPDWALK_CONTINUE;
+}
+
+/* Build all the UPDATEs the subgroups have to send. */
+static void
+build (struct result *res)
+{
+  update_group_af_walk (bgp, AFI, SAFI, build_walkcb, res);
+}
+
+static void
+run (unsigned int size, struct result *res, struct result *ref)
+{
+  struct result *full = &res[0], *churn = &res[1];
+  int r, i, j;
+
+  bpacket_attr_cache_size = size;
+  memset (res, 0, 2 * sizeof (struct result));
+
+  /* The full table. */
+  for (i = 0; i < nprefixes; i++)
+    announce (i, i % nattrs);
+  drain ();
+  build (full);
+
+  /* Then batches of it moving to the next attribute set. */
+  for (r = 1; r <= rounds; r++)
+    for (i = 0; i < nprefixes; i += batch)
+      {
+        for (j = i; j < i + batch && j < nprefixes; j++)
+          announce (j, (j + r) % nattrs);
+        drain ();
+        build (churn);
+      }
+
+  withdraw ();
+  drain ();
+  build (churn);
+
+  if (ref)
+    for (i = 0; i < 2; i++)
+      if (res[i].packets != ref[i].packets || res[i].bytes != ref[i].bytes
+          || res[i].digest != ref[i].digest)
+        {
+          fprintf (stderr, "UPDATEs differ with a cache of %u\n", size);
+          exit (1);
+        }
+
+  printf ("%7u %10lu %10lu.%03lu %10lu %10lu.%03lu %10lu\n", size,
+          full->packets, full->us / 1000, full->us % 1000,
+          churn->packets, churn->us / 1000, churn->us % 1000,
+          churn->packets ? churn->us * 1000 / churn->packets : 0);
+}
+
+int
+main (int argc, char **argv)
+{
+  const char *sizes = "8,64";
+  struct result ref[2], res[2];
+  char *list, *tok, *save;
+  int opt;
+
+  while ((opt = getopt (argc, argv, "n:p:a:b:r:c:")) != -1)
+    switch (opt)
+      {
+      case 'n':
+        npeers = atoi (optarg);
+        break;
+      case 'p':
+        nprefixes = atoi (optarg);
+        break;
+      case 'a':
+        nattrs = atoi (optarg);
+        break;
+      case 'b':
+        batch = atoi (optarg);
+        break;
+      case 'r':
+        rounds = atoi (optarg);
+        break;
+      case 'c':
+        sizes = optarg;
+        break;
+      default:
+        fprintf (stderr, "usage: %s [-n peers] [-p prefixes] "
+                 "[-a attributes] [-b batch] [-r rounds] [-c sizes,...]\n",
+                 argv[0]);
+        return 1;
+      }
+  if (npeers < 1 || npeers > 250 || nprefixes < 1 || nprefixes > 65536 * 256
+      || nattrs < 1 || batch < 1 || rounds < 0)
+    {
+      fprintf (stderr, "bad arguments\n");
+      return 1;
+    }
+
+  setup ();
+
+  /* A run without the cache first, to compare with. */
+  printf ("%d peers, %d prefixes, %d attribute sets, batches of %d, "
+          "%d rounds, times in ms\n", npeers, nprefixes, nattrs, batch,
+          rounds);
+  printf ("%7s %10s %14s %10s %14s %10s\n", "cache", "full pkts", "full",
+          "churn pkts", "churn", "ns/pkt");
+  run (0, ref, NULL);
+
+  list = strdup (sizes);
+  for (tok = strtok_r (list, ",", &save); tok;
+       tok = strtok_r (NULL, ",", &save))
+    run (atoi (tok), res, ref);
+
+  free (list);
+  return 0;
+}
@@ -0,0 +1,182 @@
+/*
+ * Test program which measures event loop dispatch latency with many
+ * idle file descriptors and a few busy ones, for each I/O backend.
+ *
+ * This file is part of Quagga
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <zebra.h>
+
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+#include "thread.h"
+
+#define IDLE_FDS    10000
+#define ACTIVE_FDS    100
+#define DISPATCHES 200000
+
+struct thread_master *master;
+
+struct active
+{
+  int rfd, wfd;
+};
+
+static unsigned long dispatched;
+
+static int dummy_func(struct thread *thread)
+{
+  return 0;
+}
+
+/* consume the byte, put a new one in flight and wait for it */
+static int active_read(struct thread *thread)
+{
+  struct active *a = THREAD_ARG(thread);
+  char c;
+
+  if (read(a->rfd, &c, 1) != 1 || write(a->wfd, &c, 1) != 1)
+    {
+      perror("active fd");
+      exit(1);
+    }
+  dispatched++;
+  thread_add_read(thread->master, active_read, a, a->rfd);
+  return 0;
+}
+
+static void run(enum thread_io_type type, const char *name, int idle_fds)
+{
+  struct thread_master *m;
+  struct thread fetch;
+  struct active active[ACTIVE_FDS];
+  int *idle;
+  int i;
+  struct timeval tv_start, tv_lap, tv_stop;
+  unsigned long t_setup, t_run;
+
+  if (type == THREAD_IO_SELECT && idle_fds + 2 * ACTIVE_FDS >= FD_SETSIZE)
+    {
+      printf("%-6s: skipped, %d fds exceed FD_SETSIZE.\n", name,
+             idle_fds + 2 * ACTIVE_FDS);
+      return;
+    }
+
+  m = thread_master_create_io(type);
+  if (strcmp(thread_master_io_name(m), name))
+    {
+      printf("%-6s: not available.\n", name);
+      thread_master_free(m);
+      return;
+    }
+
+  idle = calloc(idle_fds, sizeof(*idle));
+
+  monotime(&tv_start);
+
+  /* idle: sockets nothing is ever sent to */
+  for (i = 0; i < idle_fds; i++)
+    {
+      idle[i] = socket(AF_INET, SOCK_DGRAM, 0);
+      if (idle[i] < 0)
+        {
+          perror("socket");
+          exit(1);
+        }
+      thread_add_read(m, dummy_func, NULL, idle[i]);
+    }
+
+  for (i = 0; i < ACTIVE_FDS; i++)
+    {
+      int sv[2];
+
+      if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0)
+        {
+          perror("socketpair");
+          exit(1);
+        }
+      active[i].rfd = sv[0];
+      active[i].wfd = sv[1];
+      if (write(active[i].wfd, "x", 1) != 1)
+        exit(1);
+      thread_add_read(m, active_read, &active[i], active[i].rfd);
+    }
+
+  monotime(&tv_lap);
+
+  dispatched = 0;
+  while (dispatched < DISPATCHES && thread_fetch(m, &fetch))
+    thread_call(&fetch);
+
+  monotime(&tv_stop);
+
+  t_setup = 1000000 * (tv_lap.tv_sec - tv_start.tv_sec);
+  t_setup += tv_lap.tv_usec - tv_start.tv_usec;
+
+  t_run = 1000000 * (tv_stop.tv_sec - tv_lap.tv_sec);
+  t_run += tv_stop.tv_usec - tv_lap.tv_usec;
+
+  printf("%-6s: armed %d idle + %d active fds in %lu.%03lu ms, "
+         "%lu dispatches in %lu.%03lu ms, %lu ns/dispatch.\n",
+         name, idle_fds, ACTIVE_FDS, t_setup / 1000, t_setup % 1000,
+         dispatched, t_run / 1000, t_run % 1000,
+         1000 * t_run / dispatched);
+  fflush(stdout);
+
+  thread_master_free(m);
+  for (i = 0; i < idle_fds; i++)
+    close(idle[i]);
+  for (i = 0; i < ACTIVE_FDS; i++)
+    {
+      close(active[i].rfd);
+      close(active[i].wfd);
+    }
+  free(idle);
+}
+
+int main(int argc, char **argv)
+{
+  struct rlimit limit;
+  int idle_fds = IDLE_FDS;
+
+  /* make room for all the fds; thread masters size their tables by it */
+  getrlimit(RLIMIT_NOFILE, &limit);
+  if (limit.rlim_cur < limit.rlim_max)
+    {
+      limit.rlim_cur = limit.rlim_max;
+      setrlimit(RLIMIT_NOFILE, &limit);
+    }
+  if (limit.rlim_cur < (rlim_t)(idle_fds + 2 * ACTIVE_FDS + 64))
+    {
+      idle_fds = limit.rlim_cur - 2 * ACTIVE_FDS - 64;
+      printf("RLIMIT_NOFILE is %lu, using %d idle fds.\n",
+             (unsigned long)limit.rlim_cur, idle_fds);
+    }
+
+  run(THREAD_IO_SELECT, "select", idle_fds);
+  run(THREAD_IO_POLL, "poll", idle_fds);
+  run(THREAD_IO_EPOLL, "epoll", idle_fds);
+
+  /* and once more with a small set, where select still works */
+  run(THREAD_IO_SELECT, "select", 500);
+  run(THREAD_IO_POLL, "poll", 500);
+  run(THREAD_IO_EPOLL, "epoll", 500);
+  return 0;
+}
@@ -0,0 +1,344 @@
+/*
+ * Test program which checks that our own LSP keeps its prefixes in the
+ * fragments they were put in, and that a change only reissues the
+ * fragment it is in.
+ *
+ * Usage: test-isis-lsp-frag [-n prefixes] [-c changes]
+ *
+ * A level-1 area redistributes the given number of prefixes, /24s and
+ * /32s out of a pool twice that size, and generates its LSP.  Then the prefixes change
+ * at random, one at a time: one comes or goes, or its metric changes.
+ * After each change the LSP is regenerated, and has to announce the
+ * prefixes of the pool that are up, each once and with its metric, with
+ * no fragment over the threshold, and just one fragment may have a new
+ * sequence number.  Last the LSP is regenerated without any change, and
+ * no fragment may have a new sequence number.
+ *
+ * This file is part of Quagga
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <zebra.h>
+
+#include "thread.h"
+#include "linklist.h"
+#include "memory.h"
+#include "prefix.h"
+#include "if.h"
+#include "table.h"
+#include "stream.h"
+#include "privs.h"
+#include "zclient.h"
+#include "qobj.h"
+
+#include "isisd/dict.h"
+#include "isisd/isis_memory.h"
+#include "isisd/isis_constants.h"
+#include "isisd/isis_common.h"
+#include "isisd/isis_flags.h"
+#include "isisd/isisd.h"
+#include "isisd/isis_circuit.h"
+#include "isisd/isis_tlv.h"
+#include "isisd/isis_pdu.h"
+#include "isisd/isis_lsp.h"
+#include "isisd/isis_route.h"
+#include "isisd/isis_redist.h"
+#include "isisd/isis_zebra.h"
+#include "isisd/isis_network.h"
+
+#include "prng.h"
+
+/* need these to link in libisis */
+struct thread_master *master = NULL;
+struct zebra_privs_t isisd_privs =
+{
+  .user = NULL,
+  .group = NULL,
+  .vty_group = NULL,
+};
+
+/* The sockets live outside of libisis, and no circuit is brought up. */
+int
+isis_sock_init (struct isis_circuit *circuit)
+{
+  return ISIS_ERROR;
+}
+
+/* A prefix of the pool; info is what the route table points to. */
+struct pfx
+{
+  struct isis_ext_info info;
+  struct prefix_ipv4 p;
+  int up;
+  int seen;
+};
+
+static int nprefixes = 5000;
+static int changes = 200;
+
+static void
+pfx_set (struct route_table *table, struct pfx *pfx, int up)
+{
+  struct route_node *rn;
+
+  /* A node keeps the lock it is looked up with for as long as it has
+   * info. */
+  rn = route_node_get (table, (struct prefix *) &pfx->p);
+  if (rn->info)
+    route_unlock_node (rn);
+  rn->info = up ? &pfx->info : NULL;
+  if (!up)
+    route_unlock_node (rn);
+  pfx->up = up;
+}
+
+/* The sequence numbers of our fragments, by fragment number. */
+static void
+frag_seqnums (struct isis_lsp *lsp, u_int32_t *seqnums)
+{
+  struct isis_lsp *frag;
+  struct listnode *node;
+
+  memset (seqnums, 0, 256 * sizeof (*seqnums));
+  seqnums[0] = ntohl (lsp->lsp_header->seq_num);
+  for (ALL_LIST_ELEMENTS_RO (lsp->lspu.frags, node, frag))
+    seqnums[LSP_FRAGMENT (frag->lsp_header->lsp_id)] =
+      ntohl (frag->lsp_header->seq_num);
+}
+
+/* Checks one fragment against the pool; returns the number of entries. */
+static int
+check_frag (struct isis_area *area, struct isis_lsp *lsp,
+            struct route_table *table)
+{
+  struct tlv_view view;
+  struct te_ipv4_reachability *te_ipreach;
+  struct prefix_ipv4 p;
+  struct route_node *rn;
+  struct pfx *pfx;
+  size_t len = stream_get_endp (lsp->pdu);
+  int count = 0;
+
+  if (len > STREAM_SIZE (lsp->pdu) * area->lsp_frag_threshold / 100
+      || ntohs (lsp->lsp_header->pdu_len) != len)
+    {
+      fprintf (stderr, "fragment %d is %zu octets, pdu_len %d\n",
+               LSP_FRAGMENT (lsp->lsp_header->lsp_id), len,
+               ntohs (lsp->lsp_header->pdu_len));
+      return -1;
+    }
+
+  lsp_tlv_view_init (&view, lsp->pdu, TE_IPV4_REACHABILITY);
+  while ((te_ipreach = tlv_view_next (&view)))
+    {
+      memset (&p, 0, sizeof (p));
+      p.family = AF_INET;
+      p.prefixlen = te_ipreach->control & 0x3F;
+      memcpy (&p.prefix, &te_ipreach->prefix_start, PSIZE (p.prefixlen));
+      rn = route_node_lookup (table, (struct prefix *) &p);
+      pfx = rn ? rn->info : NULL;
+      if (rn)
+        route_unlock_node (rn);
+      if (!pfx || pfx->seen
+          || ntohl (te_ipreach->te_metric) != pfx->info.metric)
+        {
+          fprintf (stderr, "fragment %d: bad entry for %s/%d\n",
+                   LSP_FRAGMENT (lsp->lsp_header->lsp_id),
+                   inet_ntoa (p.prefix), p.prefixlen);
+          return -1;
+        }
+      pfx->seen = 1;
+      count++;
+    }
+  return count;
+}
+
+/* Checks the whole LSP against the pool. */
+static int
+check_lsp (struct isis_area *area, struct isis_lsp *lsp,
+           struct route_table *table, struct pfx *pool, int npool)
+{
+  struct isis_lsp *frag;
+  struct listnode *node;
+  int count, total, up, i;
+
+  for (i = 0; i < npool; i++)
+    pool[i].seen = 0;
+
+  if ((total = check_frag (area, lsp, table)) < 0)
+    return -1;
+  for (ALL_LIST_ELEMENTS_RO (lsp->lspu.frags, node, frag))
+    {
+      if ((count = check_frag (area, frag, table)) < 0)
+        return -1;
+      total += count;
+    }
+
+  for (up = 0, i = 0; i < npool; i++)
+    up += pool[i].up;
+  if (total != up)
+    {
+      fprintf (stderr, "%d prefixes announced, %d up\n", total, up);
+      return -1;
+    }
+  return 0;
+}
+
+/* Runs the pending regeneration now, rather than when its timer fires. */
+static void
+regenerate (struct isis_area *area)
+{
+  struct thread fake, *thread;
+  int (*func) (struct thread *);
+
+  lsp_regenerate_schedule (area, IS_LEVEL_1, 0);
+  thread = area->t_lsp_refresh[0];
+  assert (thread);
+  func = thread->func;
+  THREAD_TIMER_OFF (area->t_lsp_refresh[0]);
+
+  memset (&fake, 0, sizeof (fake));
+  fake.arg = area;
+  (*func) (&fake);
+}
+
+/* Number of fragments reissued since the sequence numbers were taken. */
+static int
+reissued (struct isis_lsp *lsp, u_int32_t *before)
+{
+  u_int32_t after[256];
+  int i, count = 0;
+
+  frag_seqnums (lsp, after);
+  for (i = 0; i < 256; i++)
+    if (after[i] != before[i])
+      count++;
+  memcpy (before, after, sizeof (after));
+  return count;
+}
+
+static int
+run (void)
+{
+  struct isis_area *area;
+  struct isis_lsp *lsp;
+  struct route_table *table;
+  struct pfx *pool;
+  struct prng *prng;
+  u_int32_t seqnums[256];
+  u_char lspid[ISIS_SYS_ID_LEN + 2];
+  int npool = 2 * nprefixes;
+  int frags, i, n;
+
+  area = isis_area_create ("frag");
+  area->is_type = IS_LEVEL_1;
+  area->lsp_gen_interval[0] = 0;
+  table = route_table_init ();
+  area->ext_reach[0][0] = table;
+
+  pool = calloc (npool, sizeof (*pool));
+  prng = prng_new (0);
+  for (i = 0; i < npool; i++)
+    {
+      pool[i].p.family = AF_INET;
+      pool[i].p.prefixlen = (prng_rand (prng) % 2) ? 24 : 32;
+      pool[i].p.prefix.s_addr = htonl (0x0a000000 + (i << 8));
+      pool[i].info.metric = 1 + prng_rand (prng) % 1000;
+      if (i < nprefixes)
+        pfx_set (table, &pool[i], 1);
+    }
+
+  lsp_generate (area, IS_LEVEL_1);
+  memset (lspid, 0, sizeof (lspid));
+  memcpy (lspid, isis->sysid, ISIS_SYS_ID_LEN);
+  lsp = lsp_search (lspid, area->lspdb[0]);
+  assert (lsp);
+  if (check_lsp (area, lsp, table, pool, npool) < 0)
+    return -1;
+  frags = listcount (lsp->lspu.frags) + 1;
+  frag_seqnums (lsp, seqnums);
+
+  for (i = 0; i < changes; i++)
+    {
+      struct pfx *pfx = &pool[prng_rand (prng) % npool];
+
+      if (pfx->up && prng_rand (prng) % 2)
+        pfx->info.metric = pfx->info.metric % 1000 + 1;
+      else
+        pfx_set (table, pfx, !pfx->up);
+
+      regenerate (area);
+      if (check_lsp (area, lsp, table, pool, npool) < 0)
+        return -1;
+      if ((n = reissued (lsp, seqnums)) != 1)
+        {
+          fprintf (stderr, "change %d reissued %d fragments\n", i, n);
+          return -1;
+        }
+    }
+
+  regenerate (area);
+  if (check_lsp (area, lsp, table, pool, npool) < 0)
+    return -1;
+  if ((n = reissued (lsp, seqnums)) != 0)
+    {
+      fprintf (stderr, "no change reissued %d fragments\n", n);
+      return -1;
+    }
+
+  printf ("%d prefixes in %d fragments, now %d, %d changes reissued one "
+          "fragment each\n", nprefixes, frags,
+          listcount (lsp->lspu.frags) + 1, changes);
+
+  prng_free (prng);
+  return 0;
+}
+
+int
+main (int argc, char **argv)
+{
+  int opt;
+
+  while ((opt = getopt (argc, argv, "n:c:")) != -1)
+    switch (opt)
+      {
+      case 'n':
+        nprefixes = atoi (optarg);
+        break;
+      case 'c':
+        changes = atoi (optarg);
+        break;
+      default:
+        fprintf (stderr, "usage: %s [-n prefixes] [-c changes]\n", argv[0]);
+        return 1;
+      }
+  /* The pool has to fit in 10.0.0.0/8, and the LSP in 256 fragments. */
+  if (nprefixes < 1 || nprefixes > 20000 || changes < 0)
+    {
+      fprintf (stderr, "bad number of prefixes or of changes\n");
+      return 1;
+    }
+
+  qobj_init ();
+  master = thread_master_create ();
+  /* Routes are not sent anywhere. */
+  zclient = zclient_new (master);
+  zclient->sock = -1;
+  isis_new (1);
+
+  return run () < 0;
+}
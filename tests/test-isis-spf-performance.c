@@ -0,0 +1,824 @@
+/*
+ * Test program which measures how long an IS-IS SPF run takes on a
+ * synthetic level-1 topology.
+ *
+ * Usage: test-isis-spf-performance [-n nodes,...] [-d degree] [-r runs]
+ *                                   [-c changes]
+ *
+ * For each size a new area is set up with one LSP per router.  The
+ * routers are connected in a ring, with random chords on top so that
+ * the average degree is as given, and each link has a random metric.
+ * Every router announces a loopback /32 and a /31 per link, so that
+ * most prefixes are reached over two routers.  The root reaches its
+ * neighbours over point-to-point circuits.  isis_run_spf is timed over
+ * the given number of runs, and the distances it finds are checked
+ * against a plain Dijkstra on the same graph.
+ *
+ * Then the LSPs are changed at random, one at a time: a link metric
+ * changes, a link goes away or comes back, or a router starts or stops
+ * announcing a prefix from a small pool that other routers share.  After
+ * each change isis_run_ispf computes the tree again in part, and a second
+ * area sharing the LSPs runs isis_run_spf in full, and the two trees and
+ * route tables have to come out the same.
+ *
+ * This file is part of Quagga
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <zebra.h>
+
+#include "thread.h"
+#include "linklist.h"
+#include "memory.h"
+#include "prefix.h"
+#include "if.h"
+#include "hash.h"
+#include "table.h"
+#include "stream.h"
+#include "privs.h"
+#include "zclient.h"
+#include "qobj.h"
+
+#include "isisd/dict.h"
+#include "isisd/isis_memory.h"
+#include "isisd/isis_constants.h"
+#include "isisd/isis_common.h"
+#include "isisd/isis_flags.h"
+#include "isisd/isisd.h"
+#include "isisd/isis_circuit.h"
+#include "isisd/isis_adjacency.h"
+#include "isisd/isis_tlv.h"
+#include "isisd/isis_pdu.h"
+#include "isisd/isis_lsp.h"
+#include "isisd/isis_spf.h"
+#include "isisd/isis_route.h"
+#include "isisd/isis_zebra.h"
+#include "isisd/isis_csm.h"
+#include "isisd/isis_network.h"
+
+#include "prng.h"
+
+#define LEVEL 1
+
+/* need these to link in libisis */
+struct thread_master *master = NULL;
+struct zebra_privs_t isisd_privs =
+{
+  .user = NULL,
+  .group = NULL,
+  .vty_group = NULL,
+};
+
+/* The sockets live outside of libisis, and no circuit is brought up. */
+int
+isis_sock_init (struct isis_circuit *circuit)
+{
+  return ISIS_ERROR;
+}
+
+struct link
+{
+  int from, to;
+  u_int32_t metric;
+  int index;			/* for the /31 */
+  int down;
+  struct te_is_neigh *neigh[2];	/* in the LSPs of from and to */
+  struct te_ipv4_reachability *reach[2];
+};
+
+static int degree = 4;
+static int runs = 5;
+static int changes = 200;
+
+static unsigned long
+elapsed_us (struct timeval *start)
+{
+  struct timeval now;
+
+  gettimeofday (&now, NULL);
+  return (now.tv_sec - start->tv_sec) * 1000000
+         + (now.tv_usec - start->tv_usec);
+}
+
+static void
+node_sysid (int node, u_char *sysid)
+{
+  sysid[0] = 0x19;
+  sysid[1] = 0x20;
+  sysid[2] = (node >> 24) & 0xff;
+  sysid[3] = (node >> 16) & 0xff;
+  sysid[4] = (node >> 8) & 0xff;
+  sysid[5] = node & 0xff;
+}
+
+static int
+sysid_node (u_char *sysid)
+{
+  return (sysid[2] << 24) | (sysid[3] << 16) | (sysid[4] << 8) | sysid[5];
+}
+
+static struct in_addr
+link_addr (int index)
+{
+  struct in_addr addr;
+
+  addr.s_addr = htonl (0x0a000000 + 2 * index);
+  return addr;
+}
+
+static struct te_ipv4_reachability *
+lsp_add_prefix (struct isis_lsp *lsp, struct in_addr addr, int plen,
+		u_int32_t metric)
+{
+  struct te_ipv4_reachability *reach;
+
+  /* The prefix runs on past the end of the struct. */
+  reach = XCALLOC (MTYPE_ISIS_TLV, sizeof (*reach) + sizeof (addr));
+  reach->te_metric = htonl (metric);
+  reach->control = plen;
+  memcpy (&reach->prefix_start, &addr, PSIZE (plen));
+  listnode_add (lsp->tlv_data.te_ipv4_reachs, reach);
+  return reach;
+}
+
+static struct te_is_neigh *
+lsp_add_neigh (struct isis_lsp *lsp, int node, u_int32_t metric)
+{
+  struct te_is_neigh *neigh;
+
+  neigh = XCALLOC (MTYPE_ISIS_TLV, sizeof (*neigh));
+  node_sysid (node, neigh->neigh_id);
+  SET_TE_METRIC (neigh, metric);
+  listnode_add (lsp->tlv_data.te_is_neighs, neigh);
+  return neigh;
+}
+
+/* SPF reads the TLVs from the PDU, so write them there from the lists
+ * after each change. */
+static void
+lsp_encode (struct isis_lsp *lsp)
+{
+  stream_set_endp (lsp->pdu, ISIS_FIXED_HDR_LEN + ISIS_LSP_HDR_LEN);
+  if (tlv_add_nlpid (lsp->tlv_data.nlpids, lsp->pdu) != ISIS_OK
+      || (listcount (lsp->tlv_data.te_is_neighs)
+          && tlv_add_te_is_neighs (lsp->tlv_data.te_is_neighs, lsp->pdu)
+             != ISIS_OK)
+      || (listcount (lsp->tlv_data.te_ipv4_reachs)
+          && tlv_add_te_ipv4_reachs (lsp->tlv_data.te_ipv4_reachs, lsp->pdu)
+             != ISIS_OK))
+    {
+      fprintf (stderr, "LSP does not fit its PDU\n");
+      exit (1);
+    }
+  lsp->lsp_header->pdu_len = htons (stream_get_endp (lsp->pdu));
+}
+
+static void
+link_add (struct isis_lsp **lsps, struct link *l)
+{
+  l->neigh[0] = lsp_add_neigh (lsps[l->from], l->to, l->metric);
+  l->neigh[1] = lsp_add_neigh (lsps[l->to], l->from, l->metric);
+  l->reach[0] = lsp_add_prefix (lsps[l->from], link_addr (l->index), 31,
+                                l->metric);
+  l->reach[1] = lsp_add_prefix (lsps[l->to], link_addr (l->index), 31,
+                                l->metric);
+}
+
+static void
+link_del (struct isis_lsp **lsps, struct link *l)
+{
+  listnode_delete (lsps[l->from]->tlv_data.te_is_neighs, l->neigh[0]);
+  listnode_delete (lsps[l->to]->tlv_data.te_is_neighs, l->neigh[1]);
+  listnode_delete (lsps[l->from]->tlv_data.te_ipv4_reachs, l->reach[0]);
+  listnode_delete (lsps[l->to]->tlv_data.te_ipv4_reachs, l->reach[1]);
+  XFREE (MTYPE_ISIS_TLV, l->neigh[0]);
+  XFREE (MTYPE_ISIS_TLV, l->neigh[1]);
+  XFREE (MTYPE_ISIS_TLV, l->reach[0]);
+  XFREE (MTYPE_ISIS_TLV, l->reach[1]);
+}
+
+/* The root reaches a neighbour over a circuit of its own. */
+static void
+add_circuit (struct isis_area *area, int node, u_int32_t metric)
+{
+  struct isis_circuit *circuit;
+  struct isis_adjacency *adj;
+  struct prefix_ipv4 *addr;
+
+  circuit = XCALLOC (MTYPE_ISIS_CIRCUIT, sizeof (*circuit));
+  circuit->area = area;
+  circuit->state = C_STATE_UP;
+  circuit->circ_type = CIRCUIT_T_P2P;
+  circuit->is_type = IS_LEVEL_1;
+  circuit->ip_router = 1;
+  circuit->ip_addrs = list_new ();
+  circuit->te_metric[0] = metric;
+  circuit->interface = XCALLOC (MTYPE_TMP, sizeof (struct interface));
+  circuit->interface->ifindex = listcount (area->circuit_list) + 1;
+  snprintf (circuit->interface->name, sizeof (circuit->interface->name),
+            "eth%d", circuit->interface->ifindex);
+
+  adj = XCALLOC (MTYPE_ISIS_ADJACENCY, sizeof (*adj));
+  node_sysid (node, adj->sysid);
+  adj->adj_state = ISIS_ADJ_UP;
+  adj->sys_type = ISIS_SYSTYPE_L1_IS;
+  adj->level = IS_LEVEL_1;
+  adj->nlpids.count = 1;
+  adj->nlpids.nlpids[0] = NLPID_IP;
+  adj->ipv4_addrs = list_new ();
+  addr = XCALLOC (MTYPE_TMP, sizeof (*addr));
+  addr->family = AF_INET;
+  addr->prefix.s_addr = htonl (0x0b000000 + node);
+  addr->prefixlen = 32;
+  listnode_add (adj->ipv4_addrs, &addr->prefix);
+  adj->circuit = circuit;
+  circuit->u.p2p.neighbor = adj;
+
+  listnode_add (area->circuit_list, circuit);
+}
+
+static struct isis_area *
+area_new (void)
+{
+  static int areas;
+  struct isis_area *area;
+  char tag[16];
+
+  snprintf (tag, sizeof (tag), "bench%d", areas++);
+  area = isis_area_create (tag);
+  area->is_type = IS_LEVEL_1;
+  /* Room for the neighbours of the busiest routers in one fragment. */
+  area->lsp_mtu = 8192;
+  return area;
+}
+
+/* One LSP per router, belonging to the given area. */
+static struct isis_lsp **
+make_lsps (struct isis_area *area, int nodes, struct link *links, int nlinks)
+{
+  struct isis_lsp **lsps;
+  u_char lsp_id[ISIS_SYS_ID_LEN + 2];
+  struct in_addr addr;
+  int i;
+
+  lsps = calloc (nodes, sizeof (*lsps));
+  for (i = 0; i < nodes; i++)
+    {
+      node_sysid (i, lsp_id);
+      LSP_PSEUDO_ID (lsp_id) = 0;
+      LSP_FRAGMENT (lsp_id) = 0;
+      lsps[i] = lsp_new (area, lsp_id, MAX_AGE, 1, IS_LEVEL_1, 0, LEVEL);
+      lsps[i]->tlv_data.nlpids = XCALLOC (MTYPE_ISIS_TLV,
+                                          sizeof (struct nlpids));
+      lsps[i]->tlv_data.nlpids->count = 1;
+      lsps[i]->tlv_data.nlpids->nlpids[0] = NLPID_IP;
+      lsps[i]->tlv_data.te_is_neighs = list_new ();
+      lsps[i]->tlv_data.te_ipv4_reachs = list_new ();
+      addr.s_addr = htonl (0x0b000000 + i);
+      lsp_add_prefix (lsps[i], addr, 32, 0);
+    }
+
+  for (i = 0; i < nlinks; i++)
+    link_add (lsps, &links[i]);
+  for (i = 0; i < nodes; i++)
+    lsp_encode (lsps[i]);
+  return lsps;
+}
+
+/* Put the LSPs in the database of an area, and bring up its circuits. */
+static void
+setup (struct isis_area *area, struct isis_lsp **lsps, int nodes,
+       struct link *links, int nlinks)
+{
+  int i;
+
+  for (i = 0; i < nlinks; i++)
+    {
+      if (links[i].from == 0)
+        add_circuit (area, links[i].to, links[i].metric);
+      else if (links[i].to == 0)
+        add_circuit (area, links[i].from, links[i].metric);
+    }
+
+  /* Not with lsp_insert, which would schedule SPF runs. */
+  for (i = 0; i < nodes; i++)
+    dict_alloc_insert (area->lspdb[LEVEL - 1],
+                       lsps[i]->lsp_header->lsp_id, lsps[i]);
+}
+
+/* A ring, and random chords on top up to the average degree. */
+static struct link *
+make_links (struct prng *prng, int nodes, int *nlinks)
+{
+  struct link *links;
+  int n, i;
+
+  n = nodes * degree / 2;
+  if (n < nodes)
+    n = nodes;
+  links = calloc (n, sizeof (*links));
+  for (i = 0; i < n; i++)
+    {
+      if (i < nodes)
+        {
+          links[i].from = i;
+          links[i].to = (i + 1) % nodes;
+        }
+      else
+        {
+          links[i].from = prng_rand (prng) % nodes;
+          do
+            links[i].to = prng_rand (prng) % nodes;
+          while (links[i].to == links[i].from);
+        }
+      links[i].metric = 1 + prng_rand (prng) % 64;
+      links[i].index = i;
+    }
+  *nlinks = n;
+  return links;
+}
+
+/* Plain O(V^2) Dijkstra, to check against. */
+static u_int32_t *
+reference_spf (int nodes, struct link *links, int nlinks)
+{
+  u_int32_t *dist;
+  char *done;
+  int i, j, u;
+
+  dist = calloc (nodes, sizeof (*dist));
+  done = calloc (nodes, 1);
+  for (i = 0; i < nodes; i++)
+    dist[i] = UINT32_MAX;
+  dist[0] = 0;
+  for (i = 0; i < nodes; i++)
+    {
+      u = -1;
+      for (j = 0; j < nodes; j++)
+        if (!done[j] && dist[j] != UINT32_MAX
+            && (u < 0 || dist[j] < dist[u]))
+          u = j;
+      if (u < 0)
+        break;
+      done[u] = 1;
+      for (j = 0; j < nlinks; j++)
+        {
+          int v;
+
+          if (links[j].down)
+            continue;
+          if (links[j].from == u)
+            v = links[j].to;
+          else if (links[j].to == u)
+            v = links[j].from;
+          else
+            continue;
+          if (dist[u] + links[j].metric < dist[v])
+            dist[v] = dist[u] + links[j].metric;
+        }
+    }
+  free (done);
+  return dist;
+}
+
+static int
+check (struct isis_spftree *spftree, int nodes, u_int32_t *dist)
+{
+  struct listnode *node;
+  struct isis_vertex *vertex;
+  int systems = 0, prefixes = 0;
+
+  for (ALL_LIST_ELEMENTS_RO (spftree->paths, node, vertex))
+    {
+      if (vertex->type == VTYPE_NONPSEUDO_TE_IS)
+        {
+          int n = sysid_node (vertex->N.id);
+
+          if (n < 0 || n >= nodes || vertex->d_N != dist[n])
+            {
+              fprintf (stderr, "node %d: distance %u, expected %u\n", n,
+                       vertex->d_N, n < nodes ? dist[n] : 0);
+              return -1;
+            }
+          systems++;
+        }
+      else if (vertex->type == VTYPE_IPREACH_TE)
+        {
+          struct prefix *p = &vertex->N.prefix;
+          int n = ntohl (p->u.prefix4.s_addr) - 0x0b000000;
+
+          if (p->prefixlen == 32 && (n < 0 || vertex->d_N != dist[n]))
+            {
+              fprintf (stderr, "loopback %d: distance %u, expected %u\n", n,
+                       vertex->d_N, dist[n]);
+              return -1;
+            }
+          prefixes++;
+        }
+    }
+
+  if (systems != nodes)
+    {
+      fprintf (stderr, "%d systems on PATHS, expected %d\n", systems, nodes);
+      return -1;
+    }
+  return prefixes;
+}
+
+/* Extra prefixes come from a pool small enough for them to be shared. */
+#define POOL_SIZE 64
+
+/* Change an LSP at random, away from the root, and note it for SPF. */
+static enum isis_lsp_change
+mutate (struct prng *prng, struct isis_lsp **lsps, int nodes,
+        struct link *links, int nlinks,
+        struct te_ipv4_reachability **extra)
+{
+  struct in_addr addr;
+  struct link *l;
+  int n;
+
+  switch (prng_rand (prng) % 4)
+    {
+    case 0:
+    case 1:
+      do
+        l = &links[prng_rand (prng) % nlinks];
+      while (l->from == 0 || l->to == 0);
+
+      if (l->down)
+        {
+          l->down = 0;
+          l->metric = 1 + prng_rand (prng) % 64;
+          link_add (lsps, l);
+        }
+      else if (prng_rand (prng) % 2)
+        {
+          l->down = 1;
+          link_del (lsps, l);
+        }
+      else
+        {
+          l->metric = 1 + prng_rand (prng) % 64;
+          SET_TE_METRIC (l->neigh[0], l->metric);
+          SET_TE_METRIC (l->neigh[1], l->metric);
+          l->reach[0]->te_metric = htonl (l->metric);
+          l->reach[1]->te_metric = htonl (l->metric);
+        }
+      lsp_encode (lsps[l->from]);
+      lsp_encode (lsps[l->to]);
+      isis_spf_lsp_change (lsps[l->from], ISIS_LSP_CHANGE_TOPOLOGY);
+      isis_spf_lsp_change (lsps[l->to], ISIS_LSP_CHANGE_TOPOLOGY);
+      return ISIS_LSP_CHANGE_TOPOLOGY;
+
+    default:
+      n = 1 + prng_rand (prng) % (nodes - 1);
+      if (extra[n] == NULL)
+        {
+          addr.s_addr = htonl (0x0c000000 + prng_rand (prng) % POOL_SIZE);
+          extra[n] = lsp_add_prefix (lsps[n], addr, 32,
+                                     1 + prng_rand (prng) % 64);
+        }
+      else if (prng_rand (prng) % 2)
+        {
+          listnode_delete (lsps[n]->tlv_data.te_ipv4_reachs, extra[n]);
+          XFREE (MTYPE_ISIS_TLV, extra[n]);
+          extra[n] = NULL;
+        }
+      else
+        extra[n]->te_metric = htonl (1 + prng_rand (prng) % 64);
+      lsp_encode (lsps[n]);
+      isis_spf_lsp_change (lsps[n], ISIS_LSP_CHANGE_REACH);
+      return ISIS_LSP_CHANGE_REACH;
+    }
+}
+
+static const char *
+vertex_name (struct isis_vertex *vertex)
+{
+  static char buf[64];
+
+  if (vertex->type > VTYPE_ES)
+    prefix2str (&vertex->N.prefix, buf, sizeof (buf));
+  else
+    snprintf (buf, sizeof (buf), "node %d", sysid_node (vertex->N.id));
+  return buf;
+}
+
+static int
+adj_find (struct list *adjs, struct isis_adjacency *adj)
+{
+  struct listnode *node;
+  struct isis_adjacency *a;
+
+  for (ALL_LIST_ELEMENTS_RO (adjs, node, a))
+    if (!memcmp (a->sysid, adj->sysid, ISIS_SYS_ID_LEN))
+      return 1;
+  return 0;
+}
+
+/* The trees of two areas have the same vertices, with the same distances,
+ * parents and first hops. */
+static int
+compare_trees (struct isis_spftree *spftree, struct isis_spftree *ref)
+{
+  struct listnode *node, *pnode;
+  struct isis_vertex *vertex, *v, *parent, *p;
+  struct isis_adjacency *adj;
+
+  if (listcount (spftree->paths) != listcount (ref->paths))
+    {
+      fprintf (stderr, "%u vertices on PATHS, expected %u\n",
+               listcount (spftree->paths), listcount (ref->paths));
+      return -1;
+    }
+
+  for (ALL_LIST_ELEMENTS_RO (ref->paths, node, vertex))
+    {
+      v = hash_lookup (spftree->vertices, vertex);
+      if (v == NULL || v->tent_index != -1)
+        {
+          fprintf (stderr, "%s missing\n", vertex_name (vertex));
+          return -1;
+        }
+      if (v->d_N != vertex->d_N)
+        {
+          fprintf (stderr, "%s: distance %u, expected %u\n",
+                   vertex_name (vertex), v->d_N, vertex->d_N);
+          return -1;
+        }
+      if (listcount (v->parents) != listcount (vertex->parents)
+          || listcount (v->Adj_N) != listcount (vertex->Adj_N))
+        {
+          fprintf (stderr, "%s: %u parents and %u first hops, expected %u "
+                   "and %u\n", vertex_name (vertex), listcount (v->parents),
+                   listcount (v->Adj_N), listcount (vertex->parents),
+                   listcount (vertex->Adj_N));
+          return -1;
+        }
+      for (ALL_LIST_ELEMENTS_RO (vertex->parents, pnode, parent))
+        {
+          p = hash_lookup (spftree->vertices, parent);
+          if (p == NULL || listnode_lookup (v->parents, p) == NULL)
+            {
+              fprintf (stderr, "%s: parent differs\n", vertex_name (vertex));
+              return -1;
+            }
+        }
+      for (ALL_LIST_ELEMENTS_RO (vertex->Adj_N, pnode, adj))
+        if (!adj_find (v->Adj_N, adj))
+          {
+            fprintf (stderr, "%s: first hop differs\n", vertex_name (vertex));
+            return -1;
+          }
+    }
+  return 0;
+}
+
+static int
+nexthop_find (struct list *nexthops, struct isis_nexthop *nh)
+{
+  struct listnode *node;
+  struct isis_nexthop *n;
+
+  for (ALL_LIST_ELEMENTS_RO (nexthops, node, n))
+    if (n->ip.s_addr == nh->ip.s_addr && n->ifindex == nh->ifindex)
+      return 1;
+  return 0;
+}
+
+static int
+compare_routes (struct route_table *table, struct route_table *ref)
+{
+  struct route_node *rn, *tn;
+  struct isis_route_info *rinfo, *tinfo;
+  struct listnode *node;
+  struct isis_nexthop *nh;
+  char buf[PREFIX2STR_BUFFER];
+  int count = 0;
+
+  for (rn = route_top (table); rn; rn = route_next (rn))
+    if (rn->info)
+      count++;
+
+  for (rn = route_top (ref); rn; rn = route_next (rn))
+    {
+      if ((rinfo = rn->info) == NULL)
+        continue;
+      count--;
+      prefix2str (&rn->p, buf, sizeof (buf));
+      tn = route_node_lookup (table, &rn->p);
+      tinfo = tn ? tn->info : NULL;
+      if (tn)
+        route_unlock_node (tn);
+      if (tinfo == NULL || tinfo->cost != rinfo->cost
+          || listcount (tinfo->nexthops) != listcount (rinfo->nexthops))
+        {
+          fprintf (stderr, "route %s differs\n", buf);
+          return -1;
+        }
+      for (ALL_LIST_ELEMENTS_RO (rinfo->nexthops, node, nh))
+        if (!nexthop_find (tinfo->nexthops, nh))
+          {
+            fprintf (stderr, "route %s: nexthop differs\n", buf);
+            return -1;
+          }
+    }
+
+  if (count != 0)
+    {
+      fprintf (stderr, "%d routes too many\n", count);
+      return -1;
+    }
+  return 0;
+}
+
+/* Change the LSPs one at a time, and compare the partial runs with full
+ * ones in a second area.  The times are averages in ms, by kind of run. */
+static int
+churn (struct isis_area *area, struct isis_lsp **lsps, int nodes,
+       struct link *links, int nlinks, double *times, int *fallbacks)
+{
+  struct isis_spftree *spftree = area->spftree[LEVEL - 1];
+  struct te_ipv4_reachability **extra;
+  unsigned long us[ISIS_SPF_KINDS] = { 0 };
+  unsigned int count[ISIS_SPF_KINDS] = { 0 };
+  struct isis_area *ref;
+  struct prng *prng;
+  struct timeval start;
+  enum isis_spf_kind kind;
+  unsigned int full_runs;
+  int i, ret = 0;
+
+  ref = area_new ();
+  setup (ref, lsps, nodes, links, nlinks);
+  isis_run_spf (ref, LEVEL, AF_INET, isis->sysid);
+
+  extra = calloc (nodes, sizeof (*extra));
+  prng = prng_new (nodes + 1);
+  full_runs = spftree->kind_runs[ISIS_SPF_FULL];
+  for (i = 0; i < changes; i++)
+    {
+      if (mutate (prng, lsps, nodes, links, nlinks, extra)
+          == ISIS_LSP_CHANGE_REACH)
+        kind = ISIS_SPF_PRC;
+      else
+        kind = ISIS_SPF_INCREMENTAL;
+
+      gettimeofday (&start, NULL);
+      isis_run_ispf (area, LEVEL, AF_INET, isis->sysid);
+      us[kind] += elapsed_us (&start);
+      count[kind]++;
+
+      gettimeofday (&start, NULL);
+      isis_run_spf (ref, LEVEL, AF_INET, isis->sysid);
+      us[ISIS_SPF_FULL] += elapsed_us (&start);
+      count[ISIS_SPF_FULL]++;
+
+      if (compare_trees (spftree, ref->spftree[LEVEL - 1]) < 0
+          || compare_routes (area->route_table[LEVEL - 1],
+                             ref->route_table[LEVEL - 1]) < 0)
+        {
+          fprintf (stderr, "%d nodes: wrong after change %d\n", nodes, i);
+          ret = -1;
+          break;
+        }
+    }
+  *fallbacks = spftree->kind_runs[ISIS_SPF_FULL] - full_runs;
+  for (kind = ISIS_SPF_FULL; kind < ISIS_SPF_KINDS; kind++)
+    times[kind] = count[kind] ? us[kind] / 1000.0 / count[kind] : 0;
+
+  prng_free (prng);
+  free (extra);
+  return ret;
+}
+
+static int
+run (int nodes)
+{
+  struct prng *prng;
+  struct isis_area *area;
+  struct isis_lsp **lsps;
+  struct link *links;
+  u_int32_t *dist;
+  struct timeval start;
+  unsigned long us, best = ULONG_MAX, total = 0;
+  double times[ISIS_SPF_KINDS];
+  int nlinks, prefixes, fallbacks = 0, i;
+
+  prng = prng_new (nodes);
+  links = make_links (prng, nodes, &nlinks);
+  prng_free (prng);
+
+  area = area_new ();
+  lsps = make_lsps (area, nodes, links, nlinks);
+  setup (area, lsps, nodes, links, nlinks);
+  node_sysid (0, isis->sysid);
+  isis->sysid_set = 1;
+
+  for (i = 0; i < runs; i++)
+    {
+      gettimeofday (&start, NULL);
+      isis_run_spf (area, LEVEL, AF_INET, isis->sysid);
+      us = elapsed_us (&start);
+      total += us;
+      if (us < best)
+        best = us;
+    }
+
+  dist = reference_spf (nodes, links, nlinks);
+  prefixes = check (area->spftree[LEVEL - 1], nodes, dist);
+  free (dist);
+  if (prefixes < 0
+      || churn (area, lsps, nodes, links, nlinks, times, &fallbacks) < 0)
+    {
+      free (links);
+      free (lsps);
+      return -1;
+    }
+  free (links);
+  free (lsps);
+
+  printf ("%8d %8d %10d %9.3f %9.3f %9.3f %9.3f %9.3f %9d\n", nodes, nlinks,
+          prefixes, total / 1000.0 / runs, best / 1000.0,
+          times[ISIS_SPF_FULL], times[ISIS_SPF_INCREMENTAL],
+          times[ISIS_SPF_PRC], fallbacks);
+  return 0;
+}
+
+int
+main (int argc, char **argv)
+{
+  const char *sizes = "100,1000,10000";
+  char *list, *tok, *save;
+  int opt, ret = 0;
+
+  while ((opt = getopt (argc, argv, "n:d:r:c:")) != -1)
+    switch (opt)
+      {
+      case 'n':
+        sizes = optarg;
+        break;
+      case 'd':
+        degree = atoi (optarg);
+        break;
+      case 'r':
+        runs = atoi (optarg);
+        break;
+      case 'c':
+        changes = atoi (optarg);
+        break;
+      default:
+        fprintf (stderr, "usage: %s [-n nodes,...] [-d degree] [-r runs] "
+                 "[-c changes]\n", argv[0]);
+        return 1;
+      }
+  if (degree < 2 || runs < 1 || changes < 0)
+    {
+      fprintf (stderr, "bad degree, number of runs or of changes\n");
+      return 1;
+    }
+
+  qobj_init ();
+  master = thread_master_create ();
+  /* Routes are not sent anywhere. */
+  zclient = zclient_new (master);
+  zclient->sock = -1;
+  isis_new (1);
+
+  printf ("average degree %d, %d runs, %d changes, times in ms\n", degree,
+          runs, changes);
+  printf ("%8s %8s %10s %9s %9s %9s %9s %9s %9s\n", "nodes", "links",
+          "prefixes", "average", "best", "full", "incr", "prc", "fellback");
+
+  list = strdup (sizes);
+  for (tok = strtok_r (list, ",", &save); tok && !ret;
+       tok = strtok_r (NULL, ",", &save))
+    {
+      int nodes = atoi (tok);
+
+      if (nodes < 3 || nodes > 1000000)
+        {
+          fprintf (stderr, "bad number of nodes: %s\n", tok);
+          ret = 1;
+        }
+      else if (run (nodes) < 0)
+        ret = 1;
+    }
+  free (list);
+  return ret;
+}
@@ -0,0 +1,318 @@
+/*
+ * Test program which measures allocation throughput and resident memory
+ * for a synthetic BGP table, with the objects malloc()ed one by one and
+ * with slab MTYPEs.
+ *
+ * Usage: test-memory-performance [-n prefixes] [-p paths] [-a adj-outs]
+ *                                [-r rounds]
+ *
+ * Each prefix gets a node, a number of paths, each with a list node, and
+ * a number of adj-outs with an advertisement each, of the sizes bgpd
+ * uses.  The table is built, then in each churn round a tenth of the
+ * paths chosen at random are freed and allocated again, and last the
+ * table is freed.  Each allocator is run in a child process of its own so
+ * that the resident set of one does not carry over to the other.
+ *
+ * This file is part of Quagga
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <zebra.h>
+
+#include <sys/wait.h>
+
+#include "memory.h"
+#include "linklist.h"
+
+#include "bgpd/bgpd.h"
+#include "bgpd/bgp_table.h"
+#include "bgpd/bgp_route.h"
+#include "bgpd/bgp_advertise.h"
+
+#include "prng.h"
+
+DEFINE_MGROUP(TEST_MEMORY, "memory performance test")
+DEFINE_MTYPE_STATIC(TEST_MEMORY, M_NODE, "node")
+DEFINE_MTYPE_STATIC(TEST_MEMORY, M_PATH, "path")
+DEFINE_MTYPE_STATIC(TEST_MEMORY, M_LISTNODE, "list node")
+DEFINE_MTYPE_STATIC(TEST_MEMORY, M_ADJ, "adj-out")
+DEFINE_MTYPE_STATIC(TEST_MEMORY, M_ADV, "advertisement")
+DEFINE_MTYPE_STATIC_SLAB(TEST_MEMORY, S_NODE, "node, slab")
+DEFINE_MTYPE_STATIC_SLAB(TEST_MEMORY, S_PATH, "path, slab")
+DEFINE_MTYPE_STATIC_SLAB(TEST_MEMORY, S_LISTNODE, "list node, slab")
+DEFINE_MTYPE_STATIC_SLAB(TEST_MEMORY, S_ADJ, "adj-out, slab")
+DEFINE_MTYPE_STATIC_SLAB(TEST_MEMORY, S_ADV, "advertisement, slab")
+
+struct thread_master *master;
+
+static int nprefixes = 1000000;
+static int npaths = 2;
+static int nadjs = 1;
+static int rounds = 3;
+
+/* The MTYPEs an allocator is run with. */
+struct mtypes
+{
+  const char *name;
+  struct memtype *node, *path, *listnode, *adj, *adv;
+};
+
+/* What is kept for a prefix, so it can be freed. */
+struct entry
+{
+  void *node;
+  void **paths;
+  void **listnodes;
+  void **adjs;
+  void **advs;
+};
+
+struct result
+{
+  unsigned long build_ns, churn_ns, free_ns;
+  unsigned long build_kb, churn_kb, free_kb;
+};
+
+static unsigned long
+now_ns (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000UL + ts.tv_nsec;
+}
+
+/* Resident set size, in kB. */
+static unsigned long
+rss_kb (void)
+{
+  unsigned long size, resident;
+  FILE *f;
+
+  f = fopen ("/proc/self/statm", "r");
+  if (!f)
+    return 0;
+  if (fscanf (f, "%lu %lu", &size, &resident) != 2)
+    resident = 0;
+  fclose (f);
+  return resident * (sysconf (_SC_PAGESIZE) / 1024);
+}
+
+static void
+entry_alloc (struct mtypes *mt, struct entry *e)
+{
+  int i;
+
+  e->node = XCALLOC (mt->node, sizeof (struct bgp_node));
+  for (i = 0; i < npaths; i++)
+    {
+      e->paths[i] = XCALLOC (mt->path, sizeof (struct bgp_info));
+      e->listnodes[i] = XCALLOC (mt->listnode, sizeof (struct listnode));
+    }
+  for (i = 0; i < nadjs; i++)
+    {
+      e->adjs[i] = XCALLOC (mt->adj, sizeof (struct bgp_adj_out));
+      e->advs[i] = XCALLOC (mt->adv, sizeof (struct bgp_advertise));
+    }
+}
+
+static void
+entry_free (struct mtypes *mt, struct entry *e)
+{
+  int i;
+
+  XFREE (mt->node, e->node);
+  for (i = 0; i < npaths; i++)
+    {
+      XFREE (mt->path, e->paths[i]);
+      XFREE (mt->listnode, e->listnodes[i]);
+    }
+  for (i = 0; i < nadjs; i++)
+    {
+      XFREE (mt->adj, e->adjs[i]);
+      XFREE (mt->adv, e->advs[i]);
+    }
+}
+
+static void
+run (struct mtypes *mt, struct result *res)
+{
+  struct entry *table;
+  void **ptrs;
+  struct prng *prng;
+  unsigned long base, start, objs;
+  int per, i, j, r;
+
+  /* The bookkeeping is allocated up front, and left out of the sizes. */
+  per = 2 * npaths + 2 * nadjs;
+  table = calloc (nprefixes, sizeof (struct entry));
+  ptrs = calloc ((size_t) nprefixes * per, sizeof (void *));
+  if (!table || !ptrs)
+    {
+      fprintf (stderr, "out of memory\n");
+      exit (1);
+    }
+  for (i = 0; i < nprefixes; i++)
+    {
+      table[i].paths = ptrs + (size_t) i * per;
+      table[i].listnodes = table[i].paths + npaths;
+      table[i].adjs = table[i].listnodes + npaths;
+      table[i].advs = table[i].adjs + nadjs;
+    }
+  base = rss_kb ();
+  objs = (unsigned long) nprefixes * (1 + per);
+
+  start = now_ns ();
+  for (i = 0; i < nprefixes; i++)
+    entry_alloc (mt, &table[i]);
+  res->build_ns = (now_ns () - start) / objs;
+  res->build_kb = rss_kb () - base;
+
+  /* Paths come and go, in no particular order. */
+  prng = prng_new (0);
+  start = now_ns ();
+  for (r = 0; r < rounds; r++)
+    for (j = 0; j < nprefixes / 10; j++)
+      {
+        struct entry *e = &table[prng_rand (prng) % nprefixes];
+        int p = prng_rand (prng) % npaths;
+
+        XFREE (mt->path, e->paths[p]);
+        XFREE (mt->listnode, e->listnodes[p]);
+        e->paths[p] = XCALLOC (mt->path, sizeof (struct bgp_info));
+        e->listnodes[p] = XCALLOC (mt->listnode, sizeof (struct listnode));
+      }
+  objs = 4UL * rounds * (nprefixes / 10);
+  res->churn_ns = objs ? (now_ns () - start) / objs : 0;
+  res->churn_kb = rss_kb () - base;
+  prng_free (prng);
+
+  objs = (unsigned long) nprefixes * (1 + per);
+  start = now_ns ();
+  for (i = 0; i < nprefixes; i++)
+    entry_free (mt, &table[i]);
+  res->free_ns = (now_ns () - start) / objs;
+  res->free_kb = rss_kb () - base;
+
+  if (mtype_stats_alloc (mt->node) || mtype_stats_alloc (mt->path)
+      || mtype_stats_alloc (mt->listnode) || mtype_stats_alloc (mt->adj)
+      || mtype_stats_alloc (mt->adv))
+    {
+      fprintf (stderr, "%s: objects left allocated\n", mt->name);
+      exit (1);
+    }
+
+  free (ptrs);
+  free (table);
+}
+
+/* Run in a child, and pass the result back through a pipe. */
+static int
+run_child (struct mtypes *mt, struct result *res)
+{
+  int fds[2];
+  pid_t pid;
+  int status;
+  ssize_t n;
+
+  if (pipe (fds) < 0)
+    return -1;
+
+  pid = fork ();
+  if (pid < 0)
+    return -1;
+  if (pid == 0)
+    {
+      close (fds[0]);
+      run (mt, res);
+      if (write (fds[1], res, sizeof (*res)) != sizeof (*res))
+        _exit (1);
+      _exit (0);
+    }
+
+  close (fds[1]);
+  n = read (fds[0], res, sizeof (*res));
+  close (fds[0]);
+  if (waitpid (pid, &status, 0) < 0 || !WIFEXITED (status)
+      || WEXITSTATUS (status) != 0 || n != sizeof (*res))
+    return -1;
+  return 0;
+}
+
+int
+main (int argc, char **argv)
+{
+  struct mtypes mtypes[] =
+  {
+    { "malloc", MTYPE_M_NODE, MTYPE_M_PATH, MTYPE_M_LISTNODE, MTYPE_M_ADJ,
+      MTYPE_M_ADV },
+    { "slab", MTYPE_S_NODE, MTYPE_S_PATH, MTYPE_S_LISTNODE, MTYPE_S_ADJ,
+      MTYPE_S_ADV },
+  };
+  struct result res;
+  unsigned int i;
+  int opt;
+
+  while ((opt = getopt (argc, argv, "n:p:a:r:")) != -1)
+    switch (opt)
+      {
+      case 'n':
+        nprefixes = atoi (optarg);
+        break;
+      case 'p':
+        npaths = atoi (optarg);
+        break;
+      case 'a':
+        nadjs = atoi (optarg);
+        break;
+      case 'r':
+        rounds = atoi (optarg);
+        break;
+      default:
+        fprintf (stderr, "usage: %s [-n prefixes] [-p paths] [-a adj-outs] "
+                 "[-r rounds]\n", argv[0]);
+        return 1;
+      }
+  if (nprefixes < 10 || npaths < 1 || nadjs < 0 || rounds < 0)
+    {
+      fprintf (stderr, "bad arguments\n");
+      return 1;
+    }
+
+  printf ("%d prefixes, %d paths and %d adj-outs each, %d churn rounds\n",
+          nprefixes, npaths, nadjs, rounds);
+  printf ("object sizes: node %zu, path %zu, list node %zu, adj-out %zu, "
+          "advertisement %zu\n", sizeof (struct bgp_node),
+          sizeof (struct bgp_info), sizeof (struct listnode),
+          sizeof (struct bgp_adj_out), sizeof (struct bgp_advertise));
+  printf ("%-8s %10s %10s %10s %12s %12s %12s\n", "alloc", "build ns",
+          "churn ns", "free ns", "build kB", "churn kB", "freed kB");
+
+  for (i = 0; i < array_size (mtypes); i++)
+    {
+      if (run_child (&mtypes[i], &res) < 0)
+        {
+          fprintf (stderr, "%s: run failed\n", mtypes[i].name);
+          return 1;
+        }
+      printf ("%-8s %10lu %10lu %10lu %12lu %12lu %12lu\n", mtypes[i].name,
+              res.build_ns, res.churn_ns, res.free_ns,
+              res.build_kb, res.churn_kb, res.free_kb);
+    }
+
+  return 0;
+}
@@ -0,0 +1,173 @@
+/*
+ * Test program which measures how fast routes go across the zebra API
+ * socket: it adds and then deletes a number of routes through a running
+ * zebra and reports routes per second for each.
+ *
+ * Usage: test-zapi-performance [-s] [-n routes] [zserv socket path]
+ *   -s  write every message on its own, as clients used to, instead of
+ *       coalescing them and merging routes into bulk messages
+ *
+ * The routes are /32s with an unreachable nexthop, so they do not get
+ * installed in the kernel.  A nexthop lookup is sent after the last
+ * route; when its reply arrives, zebra has read all the routes.
+ *
+ * This file is part of Quagga
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <zebra.h>
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include "thread.h"
+#include "stream.h"
+#include "buffer.h"
+#include "prefix.h"
+#include "zclient.h"
+
+struct thread_master *master;
+
+static int single;
+
+static void send_routes(struct zclient *zclient, u_char cmd, int count)
+{
+  struct zapi_ipv4 api;
+  struct prefix_ipv4 p;
+  struct in_addr nexthop;
+  struct in_addr *nexthop_p = &nexthop;
+  struct thread thread;
+  int i;
+
+  memset(&api, 0, sizeof(api));
+  api.type = ZEBRA_ROUTE_STATIC;
+  api.safi = SAFI_UNICAST;
+  api.vrf_id = VRF_DEFAULT;
+  SET_FLAG(api.message, ZAPI_MESSAGE_NEXTHOP);
+  api.nexthop_num = 1;
+  api.nexthop = &nexthop_p;
+  inet_pton(AF_INET, "198.51.100.1", &nexthop);
+
+  memset(&p, 0, sizeof(p));
+  p.family = AF_INET;
+  p.prefixlen = IPV4_MAX_BITLEN;
+
+  for (i = 0; i < count; i++)
+    {
+      p.prefix.s_addr = htonl(0x0a000000 + i);
+      if (zapi_ipv4_route(cmd, zclient, &p, &api) < 0)
+        {
+          fprintf(stderr, "zapi_ipv4_route failed\n");
+          exit(1);
+        }
+      /* Let the write thread send the message right away. */
+      while (single && zclient->t_write && thread_fetch(master, &thread))
+        thread_call(&thread);
+    }
+}
+
+/* Send a lookup behind the routes and wait for its reply. */
+static void sync_zebra(struct zclient *zclient)
+{
+  struct thread thread;
+  struct stream *s = zclient->obuf;
+  struct in_addr addr;
+  u_int16_t size, cmd;
+  u_char marker, version;
+  vrf_id_t vrf_id;
+
+  stream_reset(s);
+  zclient_create_header(s, ZEBRA_IPV4_NEXTHOP_LOOKUP_MRIB, VRF_DEFAULT);
+  addr.s_addr = htonl(0x0a000000);
+  stream_put_in_addr(s, &addr);
+  stream_putw_at(s, 0, stream_get_endp(s));
+  zclient_send_message(zclient);
+
+  /* Let the write thread send whatever is still queued. */
+  while (zclient->t_write && thread_fetch(master, &thread))
+    thread_call(&thread);
+
+  do
+    {
+      stream_reset(zclient->ibuf);
+      if (zclient_read_header(zclient->ibuf, zclient->sock, &size, &marker,
+                              &version, &vrf_id, &cmd) < 0)
+        {
+          fprintf(stderr, "lost connection to zebra\n");
+          exit(1);
+        }
+    }
+  while (cmd != ZEBRA_IPV4_NEXTHOP_LOOKUP_MRIB);
+}
+
+static void run(struct zclient *zclient, u_char cmd, const char *name,
+                int count)
+{
+  struct timeval tv_start, tv_stop;
+  unsigned long t_run;
+
+  gettimeofday(&tv_start, NULL);
+  send_routes(zclient, cmd, count);
+  sync_zebra(zclient);
+  gettimeofday(&tv_stop, NULL);
+
+  t_run = (tv_stop.tv_sec - tv_start.tv_sec) * 1000000
+          + (tv_stop.tv_usec - tv_start.tv_usec);
+  printf("%-7s %d routes in %lu.%03lums, %.0f routes/s\n", name, count,
+         t_run / 1000, t_run % 1000,
+         t_run ? count * 1000000.0 / t_run : 0.0);
+}
+
+int main(int argc, char **argv)
+{
+  struct zclient *zclient;
+  int count = 100000;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "sn:")) != -1)
+    switch (opt)
+      {
+      case 's':
+        single = 1;
+        break;
+      case 'n':
+        count = atoi(optarg);
+        break;
+      default:
+        fprintf(stderr, "usage: %s [-s] [-n routes] [path]\n", argv[0]);
+        return 1;
+      }
+  if (optind < argc)
+    zclient_serv_path_set(argv[optind]);
+
+  master = thread_master_create();
+  zclient = zclient_new(master);
+  if (zclient_socket_connect(zclient) < 0)
+    {
+      perror("connect to zebra");
+      return 1;
+    }
+
+  printf("%s writes\n", single ? "Single" : "Coalesced");
+  run(zclient, ZEBRA_IPV4_ROUTE_ADD, "Add", count);
+  run(zclient, ZEBRA_IPV4_ROUTE_DELETE, "Delete", count);
+
+  zclient_stop(zclient);
+  zclient_free(zclient);
+  thread_master_free(master);
+  return 0;
+}
@@ -0,0 +1,244 @@
+/*
+ * Test program which checks that route messages sent one after the
+ * other are merged into bulk messages.
+ *
+ * Usage: test-zclient-bulk [-n routes]
+ *
+ * A zclient writes to one end of a socket pair, and the messages are
+ * read back from the other end.  The given number of route adds, all
+ * with the same nexthop, have to go out as one bulk add carrying all
+ * the prefixes in order; the same for deletes.  A single route has to
+ * go out as the plain message, and when the nexthop changes halfway the
+ * routes have to go out as two bulk messages.
+ *
+ * This file is part of Quagga
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <zebra.h>
+
+#include "thread.h"
+#include "stream.h"
+#include "buffer.h"
+#include "prefix.h"
+#include "zclient.h"
+
+struct thread_master *master;
+
+/* A message as read back: its command, and for a route message the
+ * prefixes it carries. */
+struct msg
+{
+  u_int16_t cmd;
+  int count;
+  u_int32_t first;
+};
+
+/* Prefixes are 10.0.0.0/32 onwards; /32s take 5 bytes. */
+#define PREFIX_SIZE 5
+
+/* A route message has type, instance, flags, message and safi after the
+ * header, then the prefix, then a single IPv4 nexthop here: count, type
+ * and address.  A bulk message has the nexthop before the prefixes,
+ * with the number of prefixes between them. */
+#define ROUTE_PREFIX_OFFSET (ZEBRA_HEADER_SIZE + 10)
+#define ROUTE_ATTR_SIZE 6
+
+static void
+send_routes (struct zclient *zclient, u_char cmd, int from, int count,
+             int nexthop_change)
+{
+  struct zapi_ipv4 api;
+  struct prefix_ipv4 p;
+  struct in_addr nexthop;
+  struct in_addr *nexthop_p = &nexthop;
+  struct thread thread;
+  int i;
+
+  memset (&api, 0, sizeof (api));
+  api.type = ZEBRA_ROUTE_STATIC;
+  api.safi = SAFI_UNICAST;
+  api.vrf_id = VRF_DEFAULT;
+  SET_FLAG (api.message, ZAPI_MESSAGE_NEXTHOP);
+  api.nexthop_num = 1;
+  api.nexthop = &nexthop_p;
+
+  memset (&p, 0, sizeof (p));
+  p.family = AF_INET;
+  p.prefixlen = IPV4_MAX_BITLEN;
+
+  for (i = 0; i < count; i++)
+    {
+      inet_pton (AF_INET, (nexthop_change && i >= nexthop_change)
+                 ? "198.51.100.2" : "198.51.100.1", &nexthop);
+      p.prefix.s_addr = htonl (0x0a000000 + from + i);
+      if (zapi_ipv4_route (cmd, zclient, &p, &api) < 0)
+        {
+          fprintf (stderr, "zapi_ipv4_route failed\n");
+          exit (1);
+        }
+    }
+
+  /* Let the write thread send what is queued. */
+  while (zclient->t_write && thread_fetch (master, &thread))
+    thread_call (&thread);
+}
+
+/* Reads back the messages waiting on the socket. */
+static int
+read_msgs (int sock, struct msg *msgs, int max)
+{
+  static u_char buf[ZEBRA_MAX_PACKET_SIZ];
+  u_int16_t len;
+  int n = 0;
+  ssize_t got;
+  size_t end;
+
+  while (n < max)
+    {
+      got = recv (sock, buf, ZEBRA_HEADER_SIZE, MSG_DONTWAIT | MSG_WAITALL);
+      if (got <= 0)
+        break;
+      assert (got == ZEBRA_HEADER_SIZE);
+      len = (buf[0] << 8) | buf[1];
+      assert (len >= ZEBRA_HEADER_SIZE);
+      if (recv (sock, buf + ZEBRA_HEADER_SIZE, len - ZEBRA_HEADER_SIZE,
+                MSG_WAITALL) != len - ZEBRA_HEADER_SIZE)
+        {
+          fprintf (stderr, "short message\n");
+          exit (1);
+        }
+
+      msgs[n].cmd = (buf[6] << 8) | buf[7];
+      switch (msgs[n].cmd)
+        {
+        case ZEBRA_IPV4_ROUTE_BULK_ADD:
+        case ZEBRA_IPV4_ROUTE_BULK_DELETE:
+          end = ROUTE_PREFIX_OFFSET + ROUTE_ATTR_SIZE;
+          msgs[n].count = (buf[end] << 8) | buf[end + 1];
+          if (len != end + 2 + msgs[n].count * PREFIX_SIZE)
+            {
+              fprintf (stderr, "bad bulk message length %u\n", len);
+              exit (1);
+            }
+          memcpy (&msgs[n].first, buf + end + 3, 4);
+          break;
+        case ZEBRA_IPV4_ROUTE_ADD:
+        case ZEBRA_IPV4_ROUTE_DELETE:
+          msgs[n].count = 1;
+          memcpy (&msgs[n].first, buf + ROUTE_PREFIX_OFFSET + 1, 4);
+          break;
+        default:
+          msgs[n].count = 0;
+          break;
+        }
+      msgs[n].first = ntohl (msgs[n].first) - 0x0a000000;
+      n++;
+    }
+  return n;
+}
+
+static int
+check (const char *name, int sock, struct msg *want, int nwant)
+{
+  struct msg got[8];
+  int n, i;
+
+  n = read_msgs (sock, got, 8);
+  for (i = 0; i < n && i < nwant; i++)
+    if (got[i].cmd != want[i].cmd || got[i].count != want[i].count
+        || got[i].first != want[i].first)
+      break;
+  if (n != nwant || i != nwant)
+    {
+      fprintf (stderr, "%s: got %d messages:", name, n);
+      for (i = 0; i < n; i++)
+        fprintf (stderr, " [cmd %u, %d prefixes from %u]", got[i].cmd,
+                 got[i].count, got[i].first);
+      fprintf (stderr, "\n");
+      return -1;
+    }
+  printf ("%s: ok\n", name);
+  return 0;
+}
+
+int
+main (int argc, char **argv)
+{
+  struct zclient *zclient;
+  int count = 100;
+  int sv[2];
+  int opt, ret = 0;
+
+  while ((opt = getopt (argc, argv, "n:")) != -1)
+    switch (opt)
+      {
+      case 'n':
+        count = atoi (optarg);
+        break;
+      default:
+        fprintf (stderr, "usage: %s [-n routes]\n", argv[0]);
+        return 1;
+      }
+  /* All of them have to fit in one bulk message. */
+  if (count < 2 || count > 1000)
+    {
+      fprintf (stderr, "bad number of routes\n");
+      return 1;
+    }
+
+  if (socketpair (AF_UNIX, SOCK_STREAM, 0, sv) < 0)
+    {
+      perror ("socketpair");
+      return 1;
+    }
+
+  master = thread_master_create ();
+  zclient = zclient_new (master);
+  zclient->sock = sv[0];
+
+  {
+    struct msg want[] = { { ZEBRA_IPV4_ROUTE_BULK_ADD, count, 0 } };
+    send_routes (zclient, ZEBRA_IPV4_ROUTE_ADD, 0, count, 0);
+    ret |= check ("add", sv[1], want, 1);
+  }
+  {
+    struct msg want[] = { { ZEBRA_IPV4_ROUTE_BULK_DELETE, count, 0 } };
+    send_routes (zclient, ZEBRA_IPV4_ROUTE_DELETE, 0, count, 0);
+    ret |= check ("delete", sv[1], want, 1);
+  }
+  {
+    struct msg want[] = { { ZEBRA_IPV4_ROUTE_ADD, 1, 7 } };
+    send_routes (zclient, ZEBRA_IPV4_ROUTE_ADD, 7, 1, 0);
+    ret |= check ("single add", sv[1], want, 1);
+  }
+  {
+    struct msg want[] = {
+      { ZEBRA_IPV4_ROUTE_BULK_ADD, count / 2, 0 },
+      { ZEBRA_IPV4_ROUTE_BULK_ADD, count - count / 2, count / 2 },
+    };
+    send_routes (zclient, ZEBRA_IPV4_ROUTE_ADD, 0, count, count / 2);
+    ret |= check ("nexthop change", sv[1], want, 2);
+  }
+
+  zclient->sock = -1;
+  zclient_free (zclient);
+  close (sv[0]);
+  close (sv[1]);
+  thread_master_free (master);
+  return ret ? 1 : 0;
+}
@@ -47,6 +47,7 @@
 #include "zebra/irdp.h"
 #include "zebra/zebra_ptm.h"
 #include "zebra/rt_netlink.h"
+#include "zebra/zebra_nhg.h"
 #include "zebra/interface.h"
 
 #define ZEBRA_PTM_SUPPORT
@@ -855,6 +856,9 @@ if_down (struct interface *ifp)
   zif->down_count++;
   quagga_timestamp (2, zif->down_last, sizeof (zif->down_last));
 
+  /* The kernel drops the nexthop objects over the interface. */
+  zebra_nhg_if_down (ifp->ifindex);
+
   /* Notify to the protocol daemons. */
   zebra_interface_down_update (ifp);
 
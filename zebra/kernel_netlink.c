@@ -40,6 +40,8 @@
 #include "zebra/zebra_ns.h"
 #include "zebra/zebra_vrf.h"
 #include "zebra/debug.h"
+#include "zebra/rt.h"
+#include "zebra/zebra_dplane.h"
 #include "zebra/kernel_netlink.h"
 #include "zebra/rt_netlink.h"
 #include "zebra/if_netlink.h"
@@ -48,6 +50,8 @@
 #define SO_RCVBUFFORCE  (33)
 #endif
 
+DEFINE_MTYPE_STATIC(ZEBRA, NL_BATCH, "Netlink route batch")
+
 /* Hack for GNU libc version 2. */
 #ifndef MSG_TRUNC
 #define MSG_TRUNC      0x20
@@ -84,6 +88,9 @@ static const struct message nlmsg_str[] = {
   {RTM_NEWNEIGH, "RTM_NEWNEIGH"},
   {RTM_DELNEIGH, "RTM_DELNEIGH"},
   {RTM_GETNEIGH, "RTM_GETNEIGH"},
+  {RTM_NEWNEXTHOP, "RTM_NEWNEXTHOP"},
+  {RTM_DELNEXTHOP, "RTM_DELNEXTHOP"},
+  {RTM_GETNEXTHOP, "RTM_GETNEXTHOP"},
   {0, NULL}
 };
 
@@ -288,24 +295,26 @@ kernel_read (struct thread *thread)
 }
 
 /* Filter out messages from self that occur on listener socket,
- * caused by our actions on the command socket
+ * caused by our actions on the command and dataplane sockets
  */
-static void netlink_install_filter (int sock, __u32 pid)
+static void netlink_install_filter (int sock, __u32 pid, __u32 dplane_pid)
 {
   struct sock_filter filter[] = {
     /* 0: ldh [4]	          */
     BPF_STMT(BPF_LD|BPF_ABS|BPF_H, offsetof(struct nlmsghdr, nlmsg_type)),
-    /* 1: jeq 0x18 jt 3 jf 6  */
+    /* 1: jeq 0x18 jt 3 jf 2  */
     BPF_JUMP(BPF_JMP|BPF_JEQ|BPF_K, htons(RTM_NEWROUTE), 1, 0),
-    /* 2: jeq 0x19 jt 3 jf 6  */
-    BPF_JUMP(BPF_JMP|BPF_JEQ|BPF_K, htons(RTM_DELROUTE), 0, 3),
+    /* 2: jeq 0x19 jt 3 jf 7  */
+    BPF_JUMP(BPF_JMP|BPF_JEQ|BPF_K, htons(RTM_DELROUTE), 0, 4),
     /* 3: ldw [12]		  */
     BPF_STMT(BPF_LD|BPF_ABS|BPF_W, offsetof(struct nlmsghdr, nlmsg_pid)),
-    /* 4: jeq XX  jt 5 jf 6   */
-    BPF_JUMP(BPF_JMP|BPF_JEQ|BPF_K, htonl(pid), 0, 1),
-    /* 5: ret 0    (skip)     */
+    /* 4: jeq XX  jt 6 jf 5   */
+    BPF_JUMP(BPF_JMP|BPF_JEQ|BPF_K, htonl(pid), 1, 0),
+    /* 5: jeq YY  jt 6 jf 7   */
+    BPF_JUMP(BPF_JMP|BPF_JEQ|BPF_K, htonl(dplane_pid), 0, 1),
+    /* 6: ret 0    (skip)     */
     BPF_STMT(BPF_RET|BPF_K, 0),
-    /* 6: ret 0xffff (keep)   */
+    /* 7: ret 0xffff (keep)   */
     BPF_STMT(BPF_RET|BPF_K, 0xffff),
   };
 
@@ -444,6 +453,26 @@ nl_rttype_to_str (u_char rttype)
   return lookup (rttype_str, rttype);
 }
 
+/* Errors on the command socket that occur because of races in link
+   handling; the kernel is already in the state that was asked for. */
+static int
+netlink_cmd_error_benign (int msg_type, int errnum)
+{
+  return ((msg_type == RTM_DELROUTE && (-errnum == ENODEV || -errnum == ESRCH))
+          || (msg_type == RTM_NEWROUTE
+              && (-errnum == ENETDOWN || -errnum == EEXIST))
+          || (msg_type == RTM_DELNEXTHOP && -errnum == ENOENT));
+}
+
+/* Route install errors that are known to happen in some situations and
+   are not logged as errors. */
+int
+netlink_cmd_error_quiet (int msg_type, int errnum)
+{
+  return (msg_type == RTM_NEWROUTE
+          && (-errnum == ESRCH || -errnum == ENETUNREACH));
+}
+
 /* Receive message from netlink interface and pass those information
    to the given function. */
 int
@@ -554,10 +583,7 @@ netlink_parse_info (int (*filter) (struct sockaddr_nl *, struct nlmsghdr *,
 
               /* Deal with errors that occur because of races in link handling */
 	      if (nl == &zns->netlink_cmd
-		  && ((msg_type == RTM_DELROUTE &&
-		       (-errnum == ENODEV || -errnum == ESRCH))
-		      || (msg_type == RTM_NEWROUTE &&
-			  (-errnum == ENETDOWN || -errnum == EEXIST))))
+		  && netlink_cmd_error_benign (msg_type, errnum))
 		{
 		  if (IS_ZEBRA_DEBUG_KERNEL)
 		    zlog_debug ("%s: error: %s type=%s(%u), seq=%u, pid=%u",
@@ -572,8 +598,8 @@ netlink_parse_info (int (*filter) (struct sockaddr_nl *, struct nlmsghdr *,
                * so do not log these as an error.
                */
               if (msg_type == RTM_DELNEIGH ||
-                  (nl == &zns->netlink_cmd && msg_type == RTM_NEWROUTE &&
-                   (-errnum == ESRCH || -errnum == ENETUNREACH)))
+                  (nl == &zns->netlink_cmd &&
+                   netlink_cmd_error_quiet (msg_type, errnum)))
 		{
                   /* This is known to happen in some situations, don't log
                    * as error.
@@ -604,7 +630,8 @@ netlink_parse_info (int (*filter) (struct sockaddr_nl *, struct nlmsghdr *,
            * linux sets the originators port-id for {NEW|DEL}ADDR messages,
            * so this has to be checked here. */
           if (nl != &zns->netlink_cmd
-              && h->nlmsg_pid == zns->netlink_cmd.snl.nl_pid
+              && (h->nlmsg_pid == zns->netlink_cmd.snl.nl_pid
+                  || h->nlmsg_pid == zns->netlink_dplane.snl.nl_pid)
               && (h->nlmsg_type != RTM_NEWADDR && h->nlmsg_type != RTM_DELADDR))
             {
               if (IS_ZEBRA_DEBUG_KERNEL)
@@ -758,6 +785,257 @@ netlink_request (int family, int type, struct nlsock *nl)
   return 0;
 }
 
+/*
+ * Route update batching, used by the dataplane thread on its own socket.
+ *
+ * Route messages are collected in a buffer and sent with one sendmsg();
+ * only the last message of each send asks for an ACK.  The kernel still
+ * answers every message that fails, so after a send the replies are read
+ * up to that ACK, and each error is mapped back to its request by
+ * sequence number.  The sequence numbers within a send are consecutive,
+ * so requests can be indexed directly.
+ *
+ * All of this runs on the dataplane thread: it neither logs nor
+ * allocates, results are left in the status each request points to.
+ */
+#define NL_BATCH_BUF_SIZE  65536
+#define NL_BATCH_MAX       1024
+
+struct nl_batch_req
+{
+  u_int32_t seq;
+  u_int16_t type;
+  int *status;
+};
+
+struct nl_batch
+{
+  /* Messages queued, and the offset of the last one. */
+  char buf[NL_BATCH_BUF_SIZE];
+  size_t len;
+  size_t last;
+
+  struct nl_batch_req reqs[NL_BATCH_MAX];
+  unsigned int count;
+
+  /* Statistics. */
+  unsigned long sends;
+  unsigned long msgs;
+  unsigned long errors;
+  unsigned long lost;
+  unsigned int most;
+};
+
+static int netlink_batch_enabled = 0;
+
+/* Main thread, before the dataplane thread uses the socket. */
+int
+netlink_batch_init (struct nlsock *nl)
+{
+  if (!nl->batch)
+    nl->batch = XCALLOC (MTYPE_NL_BATCH, sizeof (struct nl_batch));
+
+  /* Errors for a whole batch can arrive at once. */
+  netlink_recvbuf (nl, nl_rcvbufsize);
+  return 0;
+}
+
+void
+netlink_batch_fini (struct nlsock *nl)
+{
+  if (nl->batch)
+    XFREE (MTYPE_NL_BATCH, nl->batch);
+}
+
+/* Give up on the requests from 'from' on, none of them got a reply. */
+static void
+netlink_batch_fail (struct nl_batch *nb, unsigned int from, int errnum)
+{
+  unsigned int i;
+
+  for (i = from; i < nb->count; i++)
+    *nb->reqs[i].status = errnum;
+  nb->lost += nb->count - from;
+}
+
+/* Read one datagram of replies.  Returns the index of the last request
+   answered in it, -1 if none was, or -2 with errno set on error. */
+static int
+netlink_batch_recv (struct nlsock *nl, struct nl_batch *nb)
+{
+  char buf[NL_PKT_BUF_SIZE];
+  struct iovec iov = {
+    .iov_base = buf,
+    .iov_len = sizeof buf
+  };
+  struct sockaddr_nl snl;
+  struct msghdr msg = {
+    .msg_name = (void *) &snl,
+    .msg_namelen = sizeof snl,
+    .msg_iov = &iov,
+    .msg_iovlen = 1
+  };
+  struct nlmsghdr *h;
+  int status;
+  int last = -1;
+
+  status = recvmsg (nl->sock, &msg, 0);
+  if (status <= 0)
+    {
+      if (status == 0)
+        errno = EPIPE;
+      return -2;
+    }
+
+  for (h = (struct nlmsghdr *) buf; NLMSG_OK (h, (unsigned int) status);
+       h = NLMSG_NEXT (h, status))
+    {
+      struct nlmsgerr *err;
+      struct nl_batch_req *req;
+      u_int32_t off;
+
+      if (h->nlmsg_type != NLMSG_ERROR
+          || h->nlmsg_len < NLMSG_LENGTH (sizeof (struct nlmsgerr)))
+        continue;
+
+      err = (struct nlmsgerr *) NLMSG_DATA (h);
+      off = err->msg.nlmsg_seq - nb->reqs[0].seq;
+      if (off >= nb->count)
+        continue;
+
+      req = &nb->reqs[off];
+      if (err->error && !netlink_cmd_error_benign (req->type, err->error))
+        {
+          *req->status = err->error;
+          nb->errors++;
+        }
+      last = off;
+    }
+
+  return last;
+}
+
+/* Send the queued messages and wait for the kernel's answer. */
+void
+netlink_batch_flush (struct nlsock *nl)
+{
+  struct nl_batch *nb = nl->batch;
+  struct nlmsghdr *n;
+  struct sockaddr_nl snl;
+  struct iovec iov = {
+    .iov_base = (void *) nb->buf,
+    .iov_len = nb->len
+  };
+  struct msghdr msg = {
+    .msg_name = (void *) &snl,
+    .msg_namelen = sizeof snl,
+    .msg_iov = &iov,
+    .msg_iovlen = 1,
+  };
+  int answered = -1;
+  int ret;
+
+  if (!nb->count)
+    return;
+
+  memset (&snl, 0, sizeof snl);
+  snl.nl_family = AF_NETLINK;
+
+  n = (struct nlmsghdr *) (nb->buf + nb->last);
+  n->nlmsg_flags |= NLM_F_ACK;
+
+  if (sendmsg (nl->sock, &msg, 0) < 0)
+    {
+      netlink_batch_fail (nb, 0, -errno);
+      goto done;
+    }
+
+  nb->sends++;
+  nb->msgs += nb->count;
+  if (nb->count > nb->most)
+    nb->most = nb->count;
+
+  /* Replies come in order; the last request's is the end. */
+  while (answered < (int) nb->count - 1)
+    {
+      ret = netlink_batch_recv (nl, nb);
+      if (ret == -2)
+        {
+          if (errno == EINTR)
+            continue;
+          netlink_batch_fail (nb, answered + 1, -errno);
+          break;
+        }
+      if (ret > answered)
+        answered = ret;
+    }
+
+ done:
+  nb->len = 0;
+  nb->count = 0;
+}
+
+/* Queue a route message; its result will be left in *status. */
+void
+netlink_batch_add (struct nlsock *nl, struct nlmsghdr *n, int *status)
+{
+  struct nl_batch *nb = nl->batch;
+  struct nl_batch_req *req;
+
+  if (nb->count == NL_BATCH_MAX
+      || nb->len + NLMSG_ALIGN (n->nlmsg_len) > NL_BATCH_BUF_SIZE)
+    netlink_batch_flush (nl);
+
+  n->nlmsg_seq = ++nl->seq;
+  n->nlmsg_pid = nl->snl.nl_pid;
+  memcpy (nb->buf + nb->len, n, n->nlmsg_len);
+  nb->last = nb->len;
+  nb->len += NLMSG_ALIGN (n->nlmsg_len);
+
+  req = &nb->reqs[nb->count++];
+  req->seq = n->nlmsg_seq;
+  req->type = n->nlmsg_type;
+  req->status = status;
+  *status = 0;
+
+  if (!netlink_batch_enabled)
+    netlink_batch_flush (nl);
+}
+
+void
+kernel_route_batch_set (int enable)
+{
+  netlink_batch_enabled = enable;
+}
+
+int
+kernel_route_batch_get (void)
+{
+  return netlink_batch_enabled;
+}
+
+void
+kernel_route_batch_show (struct vty *vty)
+{
+  struct zebra_ns *zns = zebra_ns_lookup (NS_DEFAULT);
+  struct nl_batch *nb = zns ? zns->netlink_dplane.batch : NULL;
+
+  vty_out (vty, "Netlink route batching is %s%s%s",
+           netlink_batch_enabled ? "enabled" : "disabled",
+           netlink_batch_enabled && !zebra_dplane_kernel ()
+           ? ", but inactive: the kernel dataplane thread is not running" : "",
+           VTY_NEWLINE);
+  if (!nb)
+    return;
+
+  /* Updated by the dataplane thread, may be slightly behind. */
+  vty_out (vty, "%-30s %10lu%s", "Batches sent", nb->sends, VTY_NEWLINE);
+  vty_out (vty, "%-30s %10lu%s", "Route updates sent", nb->msgs, VTY_NEWLINE);
+  vty_out (vty, "%-30s %10lu%s", "Errors", nb->errors, VTY_NEWLINE);
+  vty_out (vty, "%-30s %10lu%s", "Replies lost", nb->lost, VTY_NEWLINE);
+  vty_out (vty, "%-30s %10u%s", "Largest batch", nb->most, VTY_NEWLINE);
+}
+
 /* Exported interface function.  This function simply calls
    netlink_socket (). */
 void
@@ -780,6 +1058,11 @@ kernel_init (struct zebra_ns *zns)
   zns->netlink_cmd.sock = -1;
   netlink_socket (&zns->netlink_cmd, 0, zns->ns_id);
 
+  snprintf (zns->netlink_dplane.name, sizeof (zns->netlink_dplane.name),
+	    "netlink-dplane (NS %u)", zns->ns_id);
+  zns->netlink_dplane.sock = -1;
+  netlink_socket (&zns->netlink_dplane, 0, zns->ns_id);
+
   /* Register kernel socket. */
   if (zns->netlink.sock > 0)
     {
@@ -792,7 +1075,8 @@ kernel_init (struct zebra_ns *zns)
       if (nl_rcvbufsize)
         netlink_recvbuf (&zns->netlink, nl_rcvbufsize);
 
-      netlink_install_filter (zns->netlink.sock, zns->netlink_cmd.snl.nl_pid);
+      netlink_install_filter (zns->netlink.sock, zns->netlink_cmd.snl.nl_pid,
+                              zns->netlink_dplane.snl.nl_pid);
       zns->t_netlink = thread_add_read (zebrad.master, kernel_read, zns,
                                          zns->netlink.sock);
     }
@@ -814,4 +1098,11 @@ kernel_terminate (struct zebra_ns *zns)
       close (zns->netlink_cmd.sock);
       zns->netlink_cmd.sock = -1;
     }
+
+  if (zns->netlink_dplane.sock >= 0)
+    {
+      close (zns->netlink_dplane.sock);
+      zns->netlink_dplane.sock = -1;
+    }
+  netlink_batch_fini (&zns->netlink_dplane);
 }
@@ -26,6 +26,13 @@
 
 #define NL_PKT_BUF_SIZE         8192
 
+/* Kernel nexthop objects, Linux 5.3 and later. */
+#ifndef RTM_NEWNEXTHOP
+#define RTM_NEWNEXTHOP   104
+#define RTM_DELNEXTHOP   105
+#define RTM_GETNEXTHOP   106
+#endif
+
 extern void netlink_parse_rtattr (struct rtattr **tb, int max,
                                   struct rtattr *rta, int len);
 extern int addattr_l (struct nlmsghdr *n, unsigned int maxlen,
@@ -53,6 +60,12 @@ extern int netlink_talk (int (*filter) (struct sockaddr_nl *, struct nlmsghdr *,
 			 struct nlmsghdr *n, struct nlsock *nl,
                          struct zebra_ns *zns);
 extern int netlink_request (int family, int type, struct nlsock *nl);
+extern int netlink_cmd_error_quiet (int msg_type, int errnum);
+extern int netlink_batch_init (struct nlsock *nl);
+extern void netlink_batch_fini (struct nlsock *nl);
+extern void netlink_batch_add (struct nlsock *nl, struct nlmsghdr *n,
+                               int *status);
+extern void netlink_batch_flush (struct nlsock *nl);
 
 #endif /* HAVE_NETLINK */
 
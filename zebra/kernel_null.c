@@ -34,6 +34,15 @@
 
 int kernel_route_rib (struct prefix *a, struct rib *old, struct rib *new) { return 0; }
 
+const struct dplane_provider *kernel_dplane_provider (void) { return NULL; }
+
+void kernel_route_batch_set (int enable) { return; }
+int kernel_route_batch_get (void) { return 0; }
+void kernel_route_batch_show (struct vty *vty) { return; }
+
+int kernel_nhg_update (struct nhg_hash_entry *nhe, int install) { return -1; }
+int kernel_nhg_sweep (void) { return -1; }
+
 int kernel_address_add_ipv4 (struct interface *a, struct connected *b)
 {
   zlog_debug ("%s", __func__);
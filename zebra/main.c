@@ -47,6 +47,9 @@
 #include "zebra/zebra_ns.h"
 #include "zebra/redistribute.h"
 #include "zebra/zebra_mpls.h"
+#include "zebra/zebra_dplane.h"
+#include "zebra/rt.h"
+#include "zebra/zebra_nhg.h"
 
 #define ZEBRA_PTM_SUPPORT
 
@@ -54,6 +57,7 @@
 struct zebra_t zebrad =
 {
   .rtm_table_default = 0,
+  .packets_to_process = ZEBRA_ZAPI_PACKETS_TO_PROCESS,
 };
 
 /* process id. */
@@ -92,6 +96,7 @@ struct option longopts[] =
   { "vty_port",     required_argument, NULL, 'P'},
   { "retain",       no_argument,       NULL, 'r'},
   { "dryrun",       no_argument,       NULL, 'C'},
+  { "dplane",       required_argument, NULL, 'D'},
 #ifdef HAVE_NETLINK
   { "nl-bufsize",   required_argument, NULL, 's'},
 #endif /* HAVE_NETLINK */
@@ -150,6 +155,7 @@ usage (char *progname, int status)
 	      "-k, --keep_kernel  Don't delete old routes which installed by "\
 				  "zebra.\n"\
 	      "-C, --dryrun       Check configuration for validity and exit\n"\
+	      "-D, --dplane       Dataplane provider: 'kernel', 'null' or 'off'\n"\
 	      "-A, --vty_addr     Set vty's bind address\n"\
 	      "-P, --vty_port     Set vty's port number\n"\
 	      "-r, --retain       When program terminates, retain added route "\
@@ -188,6 +194,9 @@ sigint (void)
 
   zlog_notice ("Terminating on signal");
 
+  /* Finish queued route updates; the rest are made inline. */
+  zebra_dplane_finish ();
+
 #ifdef HAVE_IRDP
   irdp_finish();
 #endif
@@ -286,9 +295,9 @@ main (int argc, char **argv)
       int opt;
   
 #ifdef HAVE_NETLINK  
-      opt = getopt_long (argc, argv, "bdakf:F:i:z:hA:P:ru:g:vs:C", longopts, 0);
+      opt = getopt_long (argc, argv, "bdakf:F:i:z:hA:P:ru:g:vs:CD:", longopts, 0);
 #else
-      opt = getopt_long (argc, argv, "bdakf:F:i:z:hA:P:ru:g:vC", longopts, 0);
+      opt = getopt_long (argc, argv, "bdakf:F:i:z:hA:P:ru:g:vCD:", longopts, 0);
 #endif /* HAVE_NETLINK */
 
       if (opt == EOF)
@@ -342,6 +351,13 @@ main (int argc, char **argv)
 	case 'r':
 	  retain_mode = 1;
 	  break;
+	case 'D':
+	  if (dplane_provider_set (optarg) < 0)
+	    {
+	      fprintf (stderr, "Unknown dataplane provider %s\n", optarg);
+	      exit (1);
+	    }
+	  break;
 #ifdef HAVE_NETLINK
 	case 's':
 	  nl_rcvbufsize = atoi (optarg);
@@ -398,6 +414,8 @@ main (int argc, char **argv)
 
   zebra_mpls_init ();
   zebra_mpls_vty_init ();
+  zebra_dplane_init ();
+  zebra_nhg_init ();
 
   /* For debug purpose. */
   /* SET_FLAG (zebra_debug_event, ZEBRA_DEBUG_EVENT); */
@@ -456,6 +474,12 @@ main (int argc, char **argv)
   if (! keep_kernel_mode)
     rib_sweep_route ();
 
+  /* Threads do not survive daemon(), so only start this now. */
+  zebra_dplane_start ();
+  if (kernel_route_batch_get () && !zebra_dplane_kernel ())
+    zlog_warn ("netlink batch is configured, but the kernel dataplane "
+               "thread is not running: route updates are not batched");
+
   /* Needed for BSD routing socket. */
   pid = getpid ();
 
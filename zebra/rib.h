@@ -36,6 +36,8 @@
 #define DISTANCE_INFINITY  255
 #define ZEBRA_KERNEL_TABLE_MAX 252 /* support for no more than this rt tables */
 
+struct nhg_hash_entry;
+
 struct rib
 {
   /* Link list. */
@@ -89,6 +91,16 @@ struct rib
 #define RIB_ENTRY_NEXTHOPS_CHANGED 0x2
 #define RIB_ENTRY_CHANGED          0x4
 #define RIB_ENTRY_SELECTED_FIB     0x8
+  /* installed referring to its nexthop group's kernel object */
+#define RIB_ENTRY_NHG_KERNEL       0x10
+
+  /* Sequence number of the last install handed to the dataplane, used
+   * to match a failure reported later back to this entry. */
+  u_int32_t fib_seq;
+
+  /* Shared nexthop group the entry is installed with, see zebra_nhg.c.
+   * The nexthop list below stays the entry's own. */
+  struct nhg_hash_entry *nhe;
 
   /* Nexthop information. */
   u_char nexthop_num;
@@ -336,6 +348,8 @@ extern void rib_addnode (struct route_node *rn, struct rib *rib, int process);
 extern void rib_delnode (struct route_node *rn, struct rib *rib);
 extern int rib_install_kernel (struct route_node *rn, struct rib *rib, struct rib *old);
 extern int rib_uninstall_kernel (struct route_node *rn, struct rib *rib);
+extern void rib_install_kernel_failed (struct prefix *p, vrf_id_t vrf_id,
+                                       u_int32_t table_id, u_int32_t seq);
 
 /* NOTE:
  * All rib_add function will not just add prefix into RIB, but
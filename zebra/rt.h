@@ -25,12 +25,29 @@
 
 #include "prefix.h"
 #include "if.h"
+#include "vty.h"
 #include "zebra/rib.h"
 #include "zebra/zebra_ns.h"
 #include "zebra/zebra_mpls.h"
 
 extern int kernel_route_rib (struct prefix *, struct rib *, struct rib *);
 
+/* Dataplane provider for the kernel, NULL if route updates can only be
+ * made inline. */
+struct dplane_provider;
+extern const struct dplane_provider *kernel_dplane_provider (void);
+
+/* Batching of route updates to the kernel, where the kernel interface
+ * supports it. */
+extern void kernel_route_batch_set (int enable);
+extern int kernel_route_batch_get (void);
+extern void kernel_route_batch_show (struct vty *vty);
+
+/* Nexthop groups as kernel objects, where the kernel supports them. */
+struct nhg_hash_entry;
+extern int kernel_nhg_update (struct nhg_hash_entry *nhe, int install);
+extern int kernel_nhg_sweep (void);
+
 extern int kernel_address_add_ipv4 (struct interface *, struct connected *);
 extern int kernel_address_delete_ipv4 (struct interface *, struct connected *);
 extern int kernel_neigh_update (int, int, uint32_t, char *, int);
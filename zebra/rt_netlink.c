@@ -54,6 +54,8 @@
 #include "zebra/zebra_ptm.h"
 #include "zebra/zebra_mpls.h"
 #include "zebra/kernel_netlink.h"
+#include "zebra/zebra_dplane.h"
+#include "zebra/zebra_nhg.h"
 #include "zebra/rt_netlink.h"
 #include "zebra/zebra_mroute.h"
 
@@ -94,6 +96,51 @@
 #ifndef NDA_MASTER
 #define NDA_MASTER   9
 #endif
+
+#ifdef HAVE_LINUX_NEXTHOP_H
+#include <linux/nexthop.h>
+#else
+struct nhmsg
+{
+  unsigned char nh_family;
+  unsigned char nh_scope;
+  unsigned char nh_protocol;
+  unsigned char resvd;
+  unsigned int nh_flags;
+};
+
+struct nexthop_grp
+{
+  u_int32_t id;
+  u_int8_t weight;
+  u_int8_t resvd1;
+  u_int16_t resvd2;
+};
+
+enum
+{
+  NHA_UNSPEC,
+  NHA_ID,
+  NHA_GROUP,
+  NHA_GROUP_TYPE,
+  NHA_BLACKHOLE,
+  NHA_OIF,
+  NHA_GATEWAY,
+  NHA_ENCAP_TYPE,
+  NHA_ENCAP,
+  NHA_GROUPS,
+  NHA_MASTER,
+  __NHA_MAX,
+};
+#define NHA_MAX	(__NHA_MAX - 1)
+
+#define RTA_NH_ID	30
+#endif /* HAVE_LINUX_NEXTHOP_H */
+
+#ifndef RTM_NHA
+#define RTM_NHA(h) \
+        ((struct rtattr *) (((char *) (h)) + NLMSG_ALIGN (sizeof (struct nhmsg))))
+#endif
 /* End of temporary definitions */
 
 struct gw_family_t
@@ -1230,11 +1277,53 @@ netlink_neigh_update (int cmd, int ifindex, uint32_t addr, char *lla, int llalen
   return netlink_talk (netlink_talk_filter, &req.n, &zns->netlink_cmd, zns);
 }
 
+/* The preferred source of a route, for when its nexthops are not
+ * encoded with it: the first one set on an active or recursive nexthop.
+ */
+static int
+_netlink_route_prefsrc (struct rib *rib, int family, union g_addr *src)
+{
+  struct nexthop *nexthop, *tnexthop;
+  int recursing;
+
+  for (ALL_NEXTHOPS_RO(rib->nexthop, nexthop, tnexthop, recursing))
+    {
+      if (!CHECK_FLAG (nexthop->flags, NEXTHOP_FLAG_RECURSIVE)
+          && !CHECK_FLAG (nexthop->flags, NEXTHOP_FLAG_ACTIVE))
+        continue;
+
+      if (family == AF_INET)
+        {
+          if (nexthop->rmap_src.ipv4.s_addr)
+            src->ipv4 = nexthop->rmap_src.ipv4;
+          else if (nexthop->src.ipv4.s_addr)
+            src->ipv4 = nexthop->src.ipv4;
+          else
+            continue;
+          return 1;
+        }
+      else if (family == AF_INET6)
+        {
+          if (!IN6_IS_ADDR_UNSPECIFIED (&nexthop->rmap_src.ipv6))
+            src->ipv6 = nexthop->rmap_src.ipv6;
+          else if (!IN6_IS_ADDR_UNSPECIFIED (&nexthop->src.ipv6))
+            src->ipv6 = nexthop->src.ipv6;
+          else
+            continue;
+          return 1;
+        }
+    }
+
+  return 0;
+}
+
 /* Routing table change via netlink interface. */
 /* Update flag indicates whether this is a "replace" or not. */
+/* With a buffer given, the message is only encoded into it and its
+   length returned. */
 static int
 netlink_route_multipath (int cmd, struct prefix *p, struct rib *rib,
-                         int update)
+                         int update, u_char *buf, size_t buflen)
 {
   int bytelen;
   struct sockaddr_nl snl;
@@ -1323,6 +1412,24 @@ netlink_route_multipath (int cmd, struct prefix *p, struct rib *rib,
                  RTA_PAYLOAD (rta));
     }
 
+  /* The nexthops are in a kernel nexthop object already. */
+  if (CHECK_FLAG (rib->status, RIB_ENTRY_NHG_KERNEL) && rib->nhe)
+    {
+      addattr32 (&req.n, sizeof req, RTA_NH_ID, rib->nhe->id);
+      if (cmd == RTM_NEWROUTE && _netlink_route_prefsrc (rib, family, &src))
+        addattr_l (&req.n, sizeof req, RTA_PREFSRC, &src, bytelen);
+
+      if (IS_ZEBRA_DEBUG_KERNEL)
+        {
+          char pbuf[PREFIX_STRLEN];
+          zlog_debug ("netlink_route_multipath(): %s %s vrf %u "
+                      "nexthop group %u", nl_msg_type_to_str (cmd),
+                      prefix2str (p, pbuf, sizeof (pbuf)), zvrf_id (zvrf),
+                      rib->nhe->id);
+        }
+      goto skip;
+    }
+
   if (discard)
     {
       if (cmd == RTM_NEWROUTE)
@@ -1521,10 +1628,191 @@ skip:
   memset (&snl, 0, sizeof snl);
   snl.nl_family = AF_NETLINK;
 
+  if (buf)
+    {
+      if (req.n.nlmsg_len > buflen)
+        return -1;
+      memcpy (buf, &req.n, req.n.nlmsg_len);
+      return req.n.nlmsg_len;
+    }
+
   /* Talk to netlink socket. */
   return netlink_talk (netlink_talk_filter, &req.n, &zns->netlink_cmd, zns);
 }
 
+/* Nexthop group change via netlink, as a kernel nexthop object.  A
+ * multipath group is a group object made of single nexthop objects.
+ * With a buffer given, the message is only encoded into it and its
+ * length returned. */
+static int
+netlink_nhg_msg (int cmd, struct nhg_hash_entry *nhe, u_char *buf,
+                 size_t buflen)
+{
+  struct nexthop *nexthop = nhe->nexthop;
+  int i;
+
+  struct
+  {
+    struct nlmsghdr n;
+    struct nhmsg nhm;
+    char buf[NL_PKT_BUF_SIZE];
+  } req;
+
+  struct zebra_ns *zns = zebra_ns_lookup (NS_DEFAULT);
+
+  memset (&req, 0, sizeof req - NL_PKT_BUF_SIZE);
+
+  req.n.nlmsg_len = NLMSG_LENGTH (sizeof (struct nhmsg));
+  req.n.nlmsg_flags = NLM_F_REQUEST;
+  req.n.nlmsg_type = cmd;
+
+  addattr32 (&req.n, sizeof req, NHA_ID, nhe->id);
+
+  if (cmd == RTM_NEWNEXTHOP)
+    {
+      req.n.nlmsg_flags |= NLM_F_CREATE | NLM_F_REPLACE;
+      req.nhm.nh_protocol = RTPROT_ZEBRA;
+
+      if (nhe->depends)
+        {
+          struct nexthop_grp grp[MULTIPATH_NUM];
+
+          memset (grp, 0, sizeof grp);
+          for (i = 0; i < nhe->nexthop_num; i++)
+            grp[i].id = nhe->depends[i]->id;
+          addattr_l (&req.n, sizeof req, NHA_GROUP, grp,
+                     nhe->nexthop_num * sizeof (struct nexthop_grp));
+        }
+      else
+        {
+          switch (nexthop->type)
+            {
+            case NEXTHOP_TYPE_IPV4:
+            case NEXTHOP_TYPE_IPV4_IFINDEX:
+              req.nhm.nh_family = AF_INET;
+              addattr_l (&req.n, sizeof req, NHA_GATEWAY,
+                         &nexthop->gate.ipv4, 4);
+              break;
+            case NEXTHOP_TYPE_IPV6:
+            case NEXTHOP_TYPE_IPV6_IFINDEX:
+              req.nhm.nh_family = AF_INET6;
+              addattr_l (&req.n, sizeof req, NHA_GATEWAY,
+                         &nexthop->gate.ipv6, 16);
+              break;
+            default:
+              req.nhm.nh_family = afi2family (nhe->afi);
+              break;
+            }
+          addattr32 (&req.n, sizeof req, NHA_OIF, nexthop->ifindex);
+          if (CHECK_FLAG (nexthop->flags, NEXTHOP_FLAG_ONLINK))
+            req.nhm.nh_flags |= RTNH_F_ONLINK;
+        }
+    }
+
+  if (IS_ZEBRA_DEBUG_KERNEL)
+    zlog_debug ("netlink_nhg_msg(): %s nexthop group %u, %u nexthops",
+                nl_msg_type_to_str (cmd), nhe->id, nhe->nexthop_num);
+
+  if (buf)
+    {
+      if (req.n.nlmsg_len > buflen)
+        return -1;
+      memcpy (buf, &req.n, req.n.nlmsg_len);
+      return req.n.nlmsg_len;
+    }
+
+  return netlink_talk (netlink_talk_filter, &req.n, &zns->netlink_cmd, zns);
+}
+
+int
+kernel_nhg_update (struct nhg_hash_entry *nhe, int install)
+{
+  return netlink_nhg_msg (install ? RTM_NEWNEXTHOP : RTM_DELNEXTHOP, nhe,
+                          NULL, 0);
+}
+
+/* Nexthop objects of ours found in the kernel that we did not install. */
+static u_int32_t *nhg_sweep_ids;
+static unsigned int nhg_sweep_count;
+static unsigned int nhg_sweep_size;
+
+static int
+netlink_nhg_sweep_filter (struct sockaddr_nl *snl, struct nlmsghdr *h,
+                          ns_id_t ns_id)
+{
+  struct nhmsg *nhm;
+  struct rtattr *tb[NHA_MAX + 1];
+  u_int32_t id;
+
+  if (h->nlmsg_type != RTM_NEWNEXTHOP)
+    return 0;
+  if (h->nlmsg_len < NLMSG_LENGTH (sizeof (struct nhmsg)))
+    return -1;
+
+  nhm = NLMSG_DATA (h);
+  if (nhm->nh_protocol != RTPROT_ZEBRA)
+    return 0;
+
+  memset (tb, 0, sizeof tb);
+  netlink_parse_rtattr (tb, NHA_MAX, RTM_NHA (nhm),
+                        h->nlmsg_len - NLMSG_LENGTH (sizeof (struct nhmsg)));
+  if (!tb[NHA_ID])
+    return 0;
+
+  id = *(u_int32_t *) RTA_DATA (tb[NHA_ID]);
+  if (zebra_nhg_id_installed (id))
+    return 0;
+
+  if (nhg_sweep_count == nhg_sweep_size)
+    {
+      nhg_sweep_size = nhg_sweep_size ? nhg_sweep_size * 2 : 64;
+      nhg_sweep_ids = XREALLOC (MTYPE_TMP, nhg_sweep_ids,
+                                nhg_sweep_size * sizeof (u_int32_t));
+    }
+  nhg_sweep_ids[nhg_sweep_count++] = id;
+  return 0;
+}
+
+/* Delete the nexthop objects an earlier zebra left behind.  Returns -1
+ * if the kernel has no nexthop objects. */
+int
+kernel_nhg_sweep (void)
+{
+  struct nhg_hash_entry nhe;
+  unsigned int i;
+  int ret;
+
+  struct
+  {
+    struct nlmsghdr n;
+    struct nhmsg nhm;
+  } req;
+
+  struct zebra_ns *zns = zebra_ns_lookup (NS_DEFAULT);
+
+  memset (&req, 0, sizeof req);
+  req.n.nlmsg_len = NLMSG_LENGTH (sizeof (struct nhmsg));
+  req.n.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+  req.n.nlmsg_type = RTM_GETNEXTHOP;
+
+  nhg_sweep_count = 0;
+  ret = netlink_talk (netlink_nhg_sweep_filter, &req.n, &zns->netlink_cmd,
+                      zns);
+
+  memset (&nhe, 0, sizeof nhe);
+  for (i = 0; i < nhg_sweep_count; i++)
+    {
+      nhe.id = nhg_sweep_ids[i];
+      netlink_nhg_msg (RTM_DELNEXTHOP, &nhe, NULL, 0);
+    }
+
+  if (nhg_sweep_ids)
+    XFREE (MTYPE_TMP, nhg_sweep_ids);
+  nhg_sweep_count = nhg_sweep_size = 0;
+
+  return ret < 0 ? -1 : 0;
+}
+
 int
 kernel_get_ipmr_sg_stats (void *in)
 {
@@ -1562,11 +1850,81 @@ int
 kernel_route_rib (struct prefix *p, struct rib *old, struct rib *new)
 {
   if (!old && new)
-    return netlink_route_multipath (RTM_NEWROUTE, p, new, 0);
+    return netlink_route_multipath (RTM_NEWROUTE, p, new, 0, NULL, 0);
+  if (old && !new)
+    return netlink_route_multipath (RTM_DELROUTE, p, old, 0, NULL, 0);
+
+  return netlink_route_multipath (RTM_NEWROUTE, p, new, 1, NULL, 0);
+}
+
+/*
+ * Dataplane provider.  Route messages are encoded on the main thread,
+ * and sent on the dataplane socket by the dataplane thread, batched
+ * when "netlink batch" is configured.
+ */
+static int
+netlink_dplane_start (void)
+{
+  struct zebra_ns *zns = zebra_ns_lookup (NS_DEFAULT);
+
+  if (zns->netlink_dplane.sock < 0)
+    return -1;
+  return netlink_batch_init (&zns->netlink_dplane);
+}
+
+static int
+netlink_dplane_encode (struct prefix *p, struct rib *old, struct rib *new,
+                       u_char *buf, size_t buflen)
+{
+  if (!old && new)
+    return netlink_route_multipath (RTM_NEWROUTE, p, new, 0, buf, buflen);
   if (old && !new)
-    return netlink_route_multipath (RTM_DELROUTE, p, old, 0);
+    return netlink_route_multipath (RTM_DELROUTE, p, old, 0, buf, buflen);
+
+  return netlink_route_multipath (RTM_NEWROUTE, p, new, 1, buf, buflen);
+}
+
+static int
+netlink_dplane_encode_nhg (struct nhg_hash_entry *nhe, int install,
+                           u_char *buf, size_t buflen)
+{
+  return netlink_nhg_msg (install ? RTM_NEWNEXTHOP : RTM_DELNEXTHOP, nhe,
+                          buf, buflen);
+}
+
+static void
+netlink_dplane_process (struct dplane_ctx *list)
+{
+  struct zebra_ns *zns = zebra_ns_lookup (NS_DEFAULT);
+  struct dplane_ctx *ctx;
+  struct nlmsghdr *n;
+
+  for (ctx = list; ctx; ctx = ctx->next)
+    netlink_batch_add (&zns->netlink_dplane, (struct nlmsghdr *) ctx->data,
+                       &ctx->status);
+  netlink_batch_flush (&zns->netlink_dplane);
+
+  for (ctx = list; ctx; ctx = ctx->next)
+    {
+      n = (struct nlmsghdr *) ctx->data;
+      if (ctx->status && netlink_cmd_error_quiet (n->nlmsg_type, ctx->status))
+        ctx->quiet = 1;
+    }
+}
 
-  return netlink_route_multipath (RTM_NEWROUTE, p, new, 1);
+static const struct dplane_provider netlink_dplane_provider =
+{
+  .name = "kernel",
+  .start = netlink_dplane_start,
+  .encode = netlink_dplane_encode,
+  .encode_nhg = netlink_dplane_encode_nhg,
+  .process = netlink_dplane_process,
+};
+
+const struct dplane_provider *
+kernel_dplane_provider (void)
+{
+  return &netlink_dplane_provider;
 }
 
 int
@@ -410,6 +410,24 @@ kernel_route_rib (struct prefix *p, struct rib *old, struct rib *new)
   return route;
 }
 
+const struct dplane_provider *
+kernel_dplane_provider (void)
+{
+  return NULL;
+}
+
+int
+kernel_nhg_update (struct nhg_hash_entry *nhe, int install)
+{
+  return -1;
+}
+
+int
+kernel_nhg_sweep (void)
+{
+  return -1;
+}
+
 int
 kernel_neigh_update (int add, int ifindex, uint32_t addr, char *lla, int llalen)
 {
@@ -40,11 +40,13 @@
 #include "zebra/debug.h"
 #include "zebra/router-id.h"
 #include "zebra/interface.h"
+#include "zebra/zebra_nhg.h"
 
 /* Zebra instance */
 struct zebra_t zebrad =
 {
   .rtm_table_default = 0,
+  .packets_to_process = ZEBRA_ZAPI_PACKETS_TO_PROCESS,
 };
 
 /* process id. */
@@ -81,6 +83,14 @@ zebra_capabilities_t _caps_p [] =
   ZCAP_NET_RAW,
 };
 
+/* zebra privileges to run with */
+struct zebra_privs_t zserv_privs =
+{
+  .caps_p = _caps_p,
+  .cap_num_p = array_size(_caps_p),
+  .cap_num_i = 0
+};
+
 /* Default configuration file path. */
 char config_default[] = SYSCONFDIR DEFAULT_CONFIG_FILE;
 
@@ -306,6 +316,7 @@ main (int argc, char **argv)
   /* Make kernel routing socket. */
   zebra_vrf_init ();
   zebra_vty_init();
+  zebra_nhg_init ();
 
   /* Configuration file read*/
   vty_read_config (config_file, config_default);
@@ -0,0 +1,561 @@
+/*
+ * Zebra dataplane thread
+ *
+ * This file is part of GNU Zebra.
+ *
+ * GNU Zebra is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * GNU Zebra is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Zebra; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+/*
+ * Route updates are handed from rib_install_kernel() and
+ * rib_uninstall_kernel() to a separate pthread, so that RIB processing
+ * and client I/O do not wait on the kernel.
+ *
+ * The main thread encodes each update into a dataplane context and
+ * queues it.  Contexts are passed to the dataplane thread in chunks, at
+ * most DPLANE_INFLIGHT_MAX at a time; the rest wait on the main thread.
+ * The dataplane thread hands each chunk to the provider, which carries
+ * it out and sets a result per context, and then queues the chunk back.
+ * The main thread is woken through a pipe, and logs failures and takes
+ * back the FIB flags of routes the provider could not install.
+ *
+ * The two queues between the threads are the only shared state, and
+ * are protected by a single mutex.
+ */
+
+#include <zebra.h>
+#include <pthread.h>
+
+#include "log.h"
+#include "memory.h"
+#include "zebra_memory.h"
+#include "command.h"
+#include "thread.h"
+#include "network.h"
+#include "prefix.h"
+#include "table.h"
+#include "privs.h"
+
+#include "zebra/rib.h"
+#include "zebra/rt.h"
+#include "zebra/zserv.h"
+#include "zebra/debug.h"
+#include "zebra/zebra_dplane.h"
+#include "zebra/zebra_nhg.h"
+
+extern struct zebra_privs_t zserv_privs;
+
+DEFINE_MTYPE_STATIC(ZEBRA, DPLANE_CTX, "Dataplane context")
+
+/* Contexts owned by the dataplane thread at any one time. */
+#define DPLANE_INFLIGHT_MAX 4096
+
+static struct
+{
+  const struct dplane_provider *provider;
+  int off;
+  int started;
+  int running;
+  pthread_t thread;
+
+  /* Shared with the dataplane thread, under the mutex. */
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  int stopping;
+  struct dplane_ctx *in_head, *in_tail;
+  struct dplane_ctx *out_head, *out_tail;
+
+  /* Main thread only. */
+  struct dplane_ctx *pend_head, *pend_tail;
+  unsigned int pending;
+  unsigned int inflight;
+  int wakeup[2];
+  struct thread *t_push;
+  struct thread *t_results;
+  u_int32_t seq;
+
+  /* Statistics. */
+  unsigned long queued;
+  unsigned long completed;
+  unsigned long errors;
+  unsigned int max_pending;
+  unsigned int max_inflight;
+} dplane = {
+  .mutex = PTHREAD_MUTEX_INITIALIZER,
+  .cond = PTHREAD_COND_INITIALIZER,
+  .wakeup = { -1, -1 },
+};
+
+/* The null provider drops every update, for measuring the rest of
+ * zebra without the kernel. */
+static int
+dplane_null_encode (struct prefix *p, struct rib *old, struct rib *new,
+                    u_char *buf, size_t buflen)
+{
+  buf[0] = 0;
+  return 1;
+}
+
+static void
+dplane_null_process (struct dplane_ctx *list)
+{
+  return;
+}
+
+static const struct dplane_provider dplane_null_provider =
+{
+  .name = "null",
+  .encode = dplane_null_encode,
+  .process = dplane_null_process,
+};
+
+static const char *
+dplane_op2str (enum dplane_op op)
+{
+  switch (op)
+    {
+    case DPLANE_OP_ROUTE_INSTALL:
+      return "install";
+    case DPLANE_OP_ROUTE_UPDATE:
+      return "update";
+    case DPLANE_OP_ROUTE_DELETE:
+      return "delete";
+    case DPLANE_OP_NHG_INSTALL:
+      return "install";
+    case DPLANE_OP_NHG_DELETE:
+      return "delete";
+    }
+  return "unknown";
+}
+
+static void *
+dplane_thread (void *arg)
+{
+  struct dplane_ctx *list, *tail;
+  int wake;
+
+  for (;;)
+    {
+      pthread_mutex_lock (&dplane.mutex);
+      while (!dplane.in_head && !dplane.stopping)
+        pthread_cond_wait (&dplane.cond, &dplane.mutex);
+      list = dplane.in_head;
+      tail = dplane.in_tail;
+      dplane.in_head = dplane.in_tail = NULL;
+      pthread_mutex_unlock (&dplane.mutex);
+
+      if (!list)
+        break;
+
+      dplane.provider->process (list);
+
+      pthread_mutex_lock (&dplane.mutex);
+      wake = (dplane.out_head == NULL);
+      if (dplane.out_tail)
+        dplane.out_tail->next = list;
+      else
+        dplane.out_head = list;
+      dplane.out_tail = tail;
+      pthread_mutex_unlock (&dplane.mutex);
+
+      /* If the pipe is full the main thread is awake anyway. */
+      if (wake)
+        (void) write (dplane.wakeup[1], "", 1);
+    }
+
+  return NULL;
+}
+
+/* Move pending contexts over to the dataplane thread, as many as it may
+ * own, or all of them. */
+static void
+dplane_push_pending (int all)
+{
+  struct dplane_ctx *head, *tail;
+  unsigned int n = 0;
+
+  if (!dplane.pend_head)
+    return;
+
+  head = tail = dplane.pend_head;
+  n = 1;
+  while (tail->next && (all || dplane.inflight + n < DPLANE_INFLIGHT_MAX))
+    {
+      tail = tail->next;
+      n++;
+    }
+  if (!all && dplane.inflight + n > DPLANE_INFLIGHT_MAX)
+    return;
+
+  dplane.pend_head = tail->next;
+  if (!dplane.pend_head)
+    dplane.pend_tail = NULL;
+  tail->next = NULL;
+  dplane.pending -= n;
+  dplane.inflight += n;
+  if (dplane.inflight > dplane.max_inflight)
+    dplane.max_inflight = dplane.inflight;
+
+  pthread_mutex_lock (&dplane.mutex);
+  if (dplane.in_tail)
+    dplane.in_tail->next = head;
+  else
+    dplane.in_head = head;
+  dplane.in_tail = tail;
+  pthread_cond_signal (&dplane.cond);
+  pthread_mutex_unlock (&dplane.mutex);
+}
+
+static int
+dplane_push (struct thread *thread)
+{
+  dplane.t_push = NULL;
+  dplane_push_pending (0);
+  return 0;
+}
+
+static void
+dplane_ctx_complete (struct dplane_ctx *ctx)
+{
+  char buf[PREFIX_STRLEN];
+
+  dplane.completed++;
+  if (!ctx->status)
+    return;
+
+  dplane.errors++;
+  if (ctx->op == DPLANE_OP_NHG_INSTALL || ctx->op == DPLANE_OP_NHG_DELETE)
+    {
+      zlog_err ("%u: %s nexthop group %u %s failed: %s", ctx->vrf_id,
+                dplane.provider->name, ctx->nhg_id, dplane_op2str (ctx->op),
+                safe_strerror (-ctx->status));
+      if (ctx->op == DPLANE_OP_NHG_INSTALL)
+        zebra_nhg_install_failed (ctx->nhg_id);
+      return;
+    }
+
+  prefix2str (&ctx->p, buf, sizeof buf);
+  if (!ctx->quiet)
+    zlog_err ("%u:%s: %s route %s failed: %s", ctx->vrf_id, buf,
+              dplane.provider->name, dplane_op2str (ctx->op),
+              safe_strerror (-ctx->status));
+  else if (IS_ZEBRA_DEBUG_KERNEL)
+    zlog_debug ("%u:%s: %s route %s failed: %s", ctx->vrf_id, buf,
+                dplane.provider->name, dplane_op2str (ctx->op),
+                safe_strerror (-ctx->status));
+
+  if (ctx->op != DPLANE_OP_ROUTE_DELETE)
+    rib_install_kernel_failed (&ctx->p, ctx->vrf_id, ctx->table, ctx->seq);
+}
+
+/* Collect the contexts the dataplane thread is done with. */
+static void
+dplane_collect (void)
+{
+  struct dplane_ctx *ctx, *next;
+
+  pthread_mutex_lock (&dplane.mutex);
+  ctx = dplane.out_head;
+  dplane.out_head = dplane.out_tail = NULL;
+  pthread_mutex_unlock (&dplane.mutex);
+
+  for (; ctx; ctx = next)
+    {
+      next = ctx->next;
+      dplane_ctx_complete (ctx);
+      dplane.inflight--;
+      XFREE (MTYPE_DPLANE_CTX, ctx);
+    }
+}
+
+static int
+dplane_results (struct thread *thread)
+{
+  char buf[64];
+
+  dplane.t_results = NULL;
+
+  while (read (dplane.wakeup[0], buf, sizeof buf) > 0)
+    ;
+
+  dplane_collect ();
+  dplane_push_pending (0);
+
+  dplane.t_results = thread_add_read (zebrad.master, dplane_results, NULL,
+                                      dplane.wakeup[0]);
+  return 0;
+}
+
+static void
+dplane_enqueue (struct dplane_ctx *ctx)
+{
+  if (dplane.pend_tail)
+    dplane.pend_tail->next = ctx;
+  else
+    dplane.pend_head = ctx;
+  dplane.pend_tail = ctx;
+  dplane.queued++;
+  if (++dplane.pending > dplane.max_pending)
+    dplane.max_pending = dplane.pending;
+
+  /* Updates queued by the current thread go over together. */
+  if (!dplane.t_push)
+    dplane.t_push = thread_add_event (zebrad.master, dplane_push, NULL, 0);
+}
+
+/* Queue a route update for the dataplane.  Returns 0 when queued or when
+ * there is nothing to send, -1 if the update could not be encoded. */
+int
+dplane_route_update (struct route_node *rn, struct rib *old, struct rib *new)
+{
+  u_char buf[DPLANE_ENCODE_MAX];
+  struct dplane_ctx *ctx;
+  struct rib *rib = new ? new : old;
+  int len;
+
+  len = dplane.provider->encode (&rn->p, old, new, buf, sizeof buf);
+  if (len <= 0)
+    return len;
+
+  ctx = XMALLOC (MTYPE_DPLANE_CTX, sizeof (struct dplane_ctx) + len);
+  memset (ctx, 0, sizeof (struct dplane_ctx));
+  if (!old)
+    ctx->op = DPLANE_OP_ROUTE_INSTALL;
+  else if (!new)
+    ctx->op = DPLANE_OP_ROUTE_DELETE;
+  else
+    ctx->op = DPLANE_OP_ROUTE_UPDATE;
+  prefix_copy (&ctx->p, &rn->p);
+  ctx->vrf_id = rib->vrf_id;
+  ctx->table = rib->table;
+  ctx->seq = ++dplane.seq;
+  if (new)
+    new->fib_seq = ctx->seq;
+  ctx->len = len;
+  memcpy (ctx->data, buf, len);
+
+  dplane_enqueue (ctx);
+  return 0;
+}
+
+/* Queue a nexthop group install or delete, in order with the route
+ * updates around it. */
+int
+dplane_nhg_update (struct nhg_hash_entry *nhe, int install)
+{
+  u_char buf[DPLANE_ENCODE_MAX];
+  struct dplane_ctx *ctx;
+  int len;
+
+  if (!dplane.provider->encode_nhg)
+    return 0;
+
+  len = dplane.provider->encode_nhg (nhe, install, buf, sizeof buf);
+  if (len <= 0)
+    return len;
+
+  ctx = XMALLOC (MTYPE_DPLANE_CTX, sizeof (struct dplane_ctx) + len);
+  memset (ctx, 0, sizeof (struct dplane_ctx));
+  ctx->op = install ? DPLANE_OP_NHG_INSTALL : DPLANE_OP_NHG_DELETE;
+  ctx->vrf_id = nhe->vrf_id;
+  ctx->nhg_id = nhe->id;
+  ctx->len = len;
+  memcpy (ctx->data, buf, len);
+
+  dplane_enqueue (ctx);
+  return 0;
+}
+
+int
+zebra_dplane_active (void)
+{
+  return dplane.running;
+}
+
+/* Whether route updates go, or once started will go, to the kernel
+ * through the dataplane thread.  Before zebra_dplane_start() this is
+ * what the options ask for; afterwards, whether the thread is running. */
+int
+zebra_dplane_kernel (void)
+{
+  const struct dplane_provider *kernel = kernel_dplane_provider ();
+
+  if (dplane.off || !kernel)
+    return 0;
+  if (dplane.started)
+    return dplane.running && dplane.provider == kernel;
+  return !dplane.provider || dplane.provider == kernel;
+}
+
+/* Choose the provider; must be called before zebra_dplane_start(). */
+int
+dplane_provider_set (const char *name)
+{
+  dplane.off = 0;
+
+  if (strcmp (name, "off") == 0)
+    {
+      dplane.provider = NULL;
+      dplane.off = 1;
+    }
+  else if (strcmp (name, "null") == 0)
+    dplane.provider = &dplane_null_provider;
+  else if (strcmp (name, "kernel") == 0 && kernel_dplane_provider ())
+    dplane.provider = kernel_dplane_provider ();
+  else
+    return -1;
+
+  return 0;
+}
+
+void
+zebra_dplane_start (void)
+{
+  sigset_t set, oset;
+  int ret;
+
+  if (dplane.running || dplane.off)
+    return;
+  dplane.started = 1;
+
+  if (!dplane.provider)
+    dplane.provider = kernel_dplane_provider ();
+  if (!dplane.provider)
+    return;
+
+#ifndef HAVE_CAPABILITIES
+  /* Without capabilities, privileges are raised by switching the euid of
+   * the whole process, which the dataplane thread can't follow. */
+  if (geteuid () != 0)
+    {
+      zlog_warn ("Not running as root and no capabilities, "
+                 "updating routes inline");
+      return;
+    }
+#endif /* HAVE_CAPABILITIES */
+
+  if (dplane.provider->start && dplane.provider->start () < 0)
+    {
+      zlog_err ("Can't start %s dataplane, updating routes inline",
+                dplane.provider->name);
+      return;
+    }
+
+  if (pipe (dplane.wakeup) < 0)
+    {
+      zlog_err ("Can't create dataplane wakeup pipe: %s",
+                safe_strerror (errno));
+      return;
+    }
+  set_nonblocking (dplane.wakeup[0]);
+  set_nonblocking (dplane.wakeup[1]);
+
+  /* Signals are for the main thread.  Capabilities are per thread on
+   * Linux, and the dataplane thread can't change them safely itself, so
+   * it is started with them raised and keeps them. */
+  sigfillset (&set);
+  pthread_sigmask (SIG_SETMASK, &set, &oset);
+  if (zserv_privs.change (ZPRIVS_RAISE))
+    zlog_err ("Can't raise privileges for the dataplane thread");
+  dplane.stopping = 0;
+  ret = pthread_create (&dplane.thread, NULL, dplane_thread, NULL);
+  if (zserv_privs.change (ZPRIVS_LOWER))
+    zlog_err ("Can't lower privileges");
+  pthread_sigmask (SIG_SETMASK, &oset, NULL);
+
+  if (ret)
+    {
+      zlog_err ("Can't create dataplane thread: %s", safe_strerror (ret));
+      close (dplane.wakeup[0]);
+      close (dplane.wakeup[1]);
+      return;
+    }
+
+  dplane.running = 1;
+  dplane.t_results = thread_add_read (zebrad.master, dplane_results, NULL,
+                                      dplane.wakeup[0]);
+
+  zlog_info ("Dataplane thread started, provider %s", dplane.provider->name);
+}
+
+/* Hand over everything still queued, wait for the dataplane thread to
+ * carry it out and stop it.  Route updates are made inline after this. */
+void
+zebra_dplane_finish (void)
+{
+  if (!dplane.running)
+    return;
+
+  THREAD_OFF (dplane.t_push);
+  dplane_push_pending (1);
+
+  pthread_mutex_lock (&dplane.mutex);
+  dplane.stopping = 1;
+  pthread_cond_signal (&dplane.cond);
+  pthread_mutex_unlock (&dplane.mutex);
+
+  pthread_join (dplane.thread, NULL);
+  dplane.running = 0;
+
+  dplane_collect ();
+
+  THREAD_READ_OFF (dplane.t_results);
+  close (dplane.wakeup[0]);
+  close (dplane.wakeup[1]);
+  dplane.wakeup[0] = dplane.wakeup[1] = -1;
+
+  if (dplane.provider->stop)
+    dplane.provider->stop ();
+}
+
+DEFUN (show_zebra_dataplane,
+       show_zebra_dataplane_cmd,
+       "show zebra dataplane",
+       SHOW_STR
+       "Zebra information\n"
+       "Dataplane thread\n")
+{
+  if (!dplane.provider)
+    {
+      vty_out (vty, "Dataplane thread is off, routes are updated inline%s",
+               VTY_NEWLINE);
+      return CMD_SUCCESS;
+    }
+
+  vty_out (vty, "Dataplane provider %s, thread %s%s", dplane.provider->name,
+           dplane.running ? "running" : "stopped", VTY_NEWLINE);
+  vty_out (vty, "%-30s %10lu%s", "Updates queued", dplane.queued,
+           VTY_NEWLINE);
+  vty_out (vty, "%-30s %10lu%s", "Updates completed", dplane.completed,
+           VTY_NEWLINE);
+  vty_out (vty, "%-30s %10lu%s", "Updates failed", dplane.errors,
+           VTY_NEWLINE);
+  vty_out (vty, "%-30s %10u%s", "Pending", dplane.pending, VTY_NEWLINE);
+  vty_out (vty, "%-30s %10u%s", "In dataplane", dplane.inflight,
+           VTY_NEWLINE);
+  vty_out (vty, "%-30s %10u%s", "Most pending", dplane.max_pending,
+           VTY_NEWLINE);
+  vty_out (vty, "%-30s %10u%s", "Most in dataplane", dplane.max_inflight,
+           VTY_NEWLINE);
+
+  return CMD_SUCCESS;
+}
+
+void
+zebra_dplane_init (void)
+{
+  install_element (VIEW_NODE, &show_zebra_dataplane_cmd);
+}
@@ -0,0 +1,114 @@
+/*
+ * Zebra dataplane thread
+ *
+ * This file is part of GNU Zebra.
+ *
+ * GNU Zebra is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * GNU Zebra is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Zebra; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#ifndef _ZEBRA_DPLANE_H
+#define _ZEBRA_DPLANE_H
+
+#include "prefix.h"
+#include "vrf.h"
+#include "vty.h"
+#include "zebra/rib.h"
+
+/* Largest encoded update a provider may produce. */
+#define DPLANE_ENCODE_MAX   16384
+
+enum dplane_op
+{
+  DPLANE_OP_ROUTE_INSTALL,
+  DPLANE_OP_ROUTE_UPDATE,
+  DPLANE_OP_ROUTE_DELETE,
+  DPLANE_OP_NHG_INSTALL,
+  DPLANE_OP_NHG_DELETE,
+};
+
+struct nhg_hash_entry;
+
+/*
+ * An update on its way to the dataplane.  The main thread copies
+ * in everything the dataplane thread needs; the dataplane thread only
+ * sets the result.  Contexts are allocated and freed by the main thread.
+ */
+struct dplane_ctx
+{
+  struct dplane_ctx *next;
+
+  enum dplane_op op;
+  struct prefix p;
+  vrf_id_t vrf_id;
+  u_int32_t table;
+
+  /* Matches rib->fib_seq of the entry being installed. */
+  u_int32_t seq;
+
+  /* Nexthop group updates: the group's id. */
+  u_int32_t nhg_id;
+
+  /* Result: 0 or a negative errno.  'quiet' marks failures that are
+   * known to happen and are only logged when debugging. */
+  int status;
+  u_char quiet;
+
+  /* The update as encoded by the provider. */
+  size_t len;
+  u_char data[];
+};
+
+/*
+ * A dataplane provider.  encode() runs on the main thread and may look
+ * at the RIB; process() runs on the dataplane thread and must not touch
+ * anything but the contexts it is given (no logging, no allocation).
+ */
+struct dplane_provider
+{
+  const char *name;
+
+  /* Main thread, before the dataplane thread starts. */
+  int (*start) (void);
+
+  /* Main thread: encode an update into buf.  Returns its length, 0 if
+   * there is nothing to send, or -1 on error. */
+  int (*encode) (struct prefix *p, struct rib *old, struct rib *new,
+                 u_char *buf, size_t buflen);
+
+  /* Main thread, optional: the same for installing or deleting a
+   * nexthop group. */
+  int (*encode_nhg) (struct nhg_hash_entry *nhe, int install,
+                     u_char *buf, size_t buflen);
+
+  /* Dataplane thread: carry out a list of updates, in order, setting
+   * the status of each. */
+  void (*process) (struct dplane_ctx *list);
+
+  /* Main thread, after the dataplane thread has stopped. */
+  void (*stop) (void);
+};
+
+extern void zebra_dplane_init (void);
+extern int dplane_provider_set (const char *name);
+extern void zebra_dplane_start (void);
+extern void zebra_dplane_finish (void);
+extern int zebra_dplane_active (void);
+extern int zebra_dplane_kernel (void);
+extern int dplane_route_update (struct route_node *rn, struct rib *old,
+                                struct rib *new);
+extern int dplane_nhg_update (struct nhg_hash_entry *nhe, int install);
+
+#endif /* _ZEBRA_DPLANE_H */
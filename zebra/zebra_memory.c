@@ -29,7 +29,7 @@
 DEFINE_MGROUP(ZEBRA, "zebra")
 DEFINE_MTYPE(ZEBRA, RTADV_PREFIX,   "Router Advertisement Prefix")
 DEFINE_MTYPE(ZEBRA, ZEBRA_VRF,      "ZEBRA VRF")
-DEFINE_MTYPE(ZEBRA, RIB,            "RIB")
+DEFINE_MTYPE_SLAB(ZEBRA, RIB,            "RIB")
 DEFINE_MTYPE(ZEBRA, RIB_QUEUE,      "RIB process work queue")
 DEFINE_MTYPE(ZEBRA, STATIC_ROUTE,   "Static route")
 DEFINE_MTYPE(ZEBRA, RIB_DEST,       "RIB destination")
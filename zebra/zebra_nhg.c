@@ -0,0 +1,513 @@
+/*
+ * Zebra shared nexthop groups
+ *
+ * This file is part of GNU Zebra.
+ *
+ * GNU Zebra is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * GNU Zebra is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Zebra; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+/*
+ * Every route installed in the FIB holds a reference to the nexthop
+ * group it forwards over.  Groups are interned by contents, so routes
+ * learned over the same paths share one entry, and each entry has an id.
+ * A route still keeps its own nexthop list, which carries its resolution
+ * state; the entry only holds a flattened copy of what is installed, so
+ * sharing saves encoding and kernel updates, not RIB memory.
+ *
+ * With "netlink nexthop-group", entries are also installed as kernel
+ * nexthop objects, a multipath group as a group of single nexthop
+ * objects, and routes refer to them by id instead of carrying their
+ * nexthops.  An object is installed before the first route using it
+ * and deleted after the last one is gone.
+ */
+
+#include <zebra.h>
+
+#include "log.h"
+#include "memory.h"
+#include "zebra_memory.h"
+#include "hash.h"
+#include "jhash.h"
+#include "command.h"
+#include "nexthop.h"
+
+#include "zebra/rib.h"
+#include "zebra/rt.h"
+#include "zebra/debug.h"
+#include "zebra/zebra_dplane.h"
+#include "zebra/zebra_nhg.h"
+
+DEFINE_MTYPE_STATIC(ZEBRA, NHG, "Nexthop group")
+DEFINE_MTYPE_STATIC(ZEBRA, NHG_DEPENDS, "Nexthop group members")
+
+/* Entries by contents, and by id. */
+static struct hash *nhg_hash;
+static struct hash *nhg_id_hash;
+
+static u_int32_t nhg_id_next = 1;
+
+/* Use kernel nexthop objects. */
+static int nhg_kernel = 0;
+static int nhg_kernel_swept = 0;
+
+/* Statistics. */
+static unsigned long nhg_installs;
+static unsigned long nhg_deletes;
+static unsigned long nhg_failures;
+
+static unsigned int
+nhg_hash_key (void *arg)
+{
+  struct nhg_hash_entry *nhe = arg;
+  struct nexthop *nh;
+  u_int32_t key;
+
+  key = jhash_3words (nhe->afi, nhe->vrf_id, nhe->nexthop_num, 0);
+  for (nh = nhe->nexthop; nh; nh = nh->next)
+    {
+      key = jhash_3words (nh->type, nh->ifindex, nh->flags, key);
+      key = jhash (&nh->gate, sizeof (nh->gate), key);
+      if (nh->nh_label)
+        key = jhash (nh->nh_label->label,
+                     nh->nh_label->num_labels * sizeof (mpls_label_t), key);
+    }
+
+  return key;
+}
+
+static int
+nhg_nexthop_same (struct nexthop *nh1, struct nexthop *nh2)
+{
+  if (nh1->type != nh2->type
+      || nh1->ifindex != nh2->ifindex
+      || nh1->flags != nh2->flags
+      || memcmp (&nh1->gate, &nh2->gate, sizeof (nh1->gate)))
+    return 0;
+
+  if (!nh1->nh_label || !nh2->nh_label)
+    return nh1->nh_label == nh2->nh_label;
+
+  return (nh1->nh_label->num_labels == nh2->nh_label->num_labels
+          && !memcmp (nh1->nh_label->label, nh2->nh_label->label,
+                      nh1->nh_label->num_labels * sizeof (mpls_label_t)));
+}
+
+static int
+nhg_hash_cmp (const void *arg1, const void *arg2)
+{
+  const struct nhg_hash_entry *nhe1 = arg1;
+  const struct nhg_hash_entry *nhe2 = arg2;
+  struct nexthop *nh1, *nh2;
+
+  if (nhe1->afi != nhe2->afi
+      || nhe1->vrf_id != nhe2->vrf_id
+      || nhe1->nexthop_num != nhe2->nexthop_num)
+    return 0;
+
+  for (nh1 = nhe1->nexthop, nh2 = nhe2->nexthop; nh1 && nh2;
+       nh1 = nh1->next, nh2 = nh2->next)
+    if (!nhg_nexthop_same (nh1, nh2))
+      return 0;
+
+  return (nh1 == NULL && nh2 == NULL);
+}
+
+static unsigned int
+nhg_id_key (void *arg)
+{
+  struct nhg_hash_entry *nhe = arg;
+
+  return nhe->id;
+}
+
+static int
+nhg_id_cmp (const void *arg1, const void *arg2)
+{
+  const struct nhg_hash_entry *nhe1 = arg1;
+  const struct nhg_hash_entry *nhe2 = arg2;
+
+  return nhe1->id == nhe2->id;
+}
+
+static struct nhg_hash_entry *
+nhg_lookup_id (u_int32_t id)
+{
+  struct nhg_hash_entry lookup;
+
+  lookup.id = id;
+  return hash_lookup (nhg_id_hash, &lookup);
+}
+
+static u_int32_t
+nhg_id_alloc (void)
+{
+  u_int32_t id;
+
+  do
+    id = nhg_id_next++;
+  while (id == 0 || nhg_lookup_id (id));
+
+  return id;
+}
+
+/* Copy of a nexthop with just what it forwards over. */
+static struct nexthop *
+nhg_nexthop_copy (struct nexthop *nexthop)
+{
+  struct nexthop *copy;
+
+  copy = nexthop_new ();
+  copy->type = nexthop->type;
+  copy->ifindex = nexthop->ifindex;
+  copy->flags = nexthop->flags & NEXTHOP_FLAG_ONLINK;
+
+  switch (nexthop->type)
+    {
+    case NEXTHOP_TYPE_IPV4:
+    case NEXTHOP_TYPE_IPV4_IFINDEX:
+      copy->gate.ipv4 = nexthop->gate.ipv4;
+      break;
+    case NEXTHOP_TYPE_IPV6:
+    case NEXTHOP_TYPE_IPV6_IFINDEX:
+      copy->gate.ipv6 = nexthop->gate.ipv6;
+      break;
+    default:
+      break;
+    }
+
+  if (nexthop->nh_label)
+    nexthop_add_labels (copy, nexthop->nh_label_type,
+                        nexthop->nh_label->num_labels,
+                        &nexthop->nh_label->label[0]);
+  return copy;
+}
+
+/* Whether a single nexthop can be a kernel nexthop object. */
+static int
+nhg_nexthop_kernel_ok (afi_t afi, struct nexthop *nexthop)
+{
+  if (nexthop->nh_label || !nexthop->ifindex)
+    return 0;
+
+  switch (nexthop->type)
+    {
+    case NEXTHOP_TYPE_IFINDEX:
+    case NEXTHOP_TYPE_IPV4:
+    case NEXTHOP_TYPE_IPV4_IFINDEX:
+      return 1;
+    case NEXTHOP_TYPE_IPV6:
+    case NEXTHOP_TYPE_IPV6_IFINDEX:
+      /* IPv4 over IPv6 nexthops is encoded specially. */
+      return afi == AFI_IP6;
+    default:
+      return 0;
+    }
+}
+
+/* Find the entry for the given nexthops, or create it.  The nexthop
+ * list is either taken over or freed.  A reference is returned. */
+static struct nhg_hash_entry *
+nhg_find (afi_t afi, vrf_id_t vrf_id, struct nexthop *nexthop,
+          u_char nexthop_num)
+{
+  struct nhg_hash_entry lookup;
+  struct nhg_hash_entry *nhe;
+  struct nexthop *nh;
+  int i, j;
+
+  memset (&lookup, 0, sizeof (lookup));
+  lookup.afi = afi;
+  lookup.vrf_id = vrf_id;
+  lookup.nexthop = nexthop;
+  lookup.nexthop_num = nexthop_num;
+
+  nhe = hash_lookup (nhg_hash, &lookup);
+  if (nhe)
+    {
+      nexthops_free (nexthop);
+      nhe->refcnt++;
+      return nhe;
+    }
+
+  nhe = XCALLOC (MTYPE_NHG, sizeof (struct nhg_hash_entry));
+  *nhe = lookup;
+  nhe->id = nhg_id_alloc ();
+  nhe->refcnt = 1;
+
+  if (nexthop_num == 1)
+    {
+      if (nhg_nexthop_kernel_ok (afi, nexthop))
+        SET_FLAG (nhe->flags, NHG_FLAG_KERNEL_OK);
+    }
+  else
+    {
+      /* A kernel group is made of single nexthop objects, each of which
+       * may appear only once. */
+      SET_FLAG (nhe->flags, NHG_FLAG_KERNEL_OK);
+      nhe->depends = XCALLOC (MTYPE_NHG_DEPENDS,
+                              nexthop_num * sizeof (struct nhg_hash_entry *));
+      for (i = 0, nh = nexthop; nh; i++, nh = nh->next)
+        {
+          nhe->depends[i] = nhg_find (afi, vrf_id, nhg_nexthop_copy (nh), 1);
+          if (!CHECK_FLAG (nhe->depends[i]->flags, NHG_FLAG_KERNEL_OK))
+            UNSET_FLAG (nhe->flags, NHG_FLAG_KERNEL_OK);
+          for (j = 0; j < i; j++)
+            if (nhe->depends[j] == nhe->depends[i])
+              UNSET_FLAG (nhe->flags, NHG_FLAG_KERNEL_OK);
+        }
+    }
+
+  hash_get (nhg_hash, nhe, hash_alloc_intern);
+  hash_get (nhg_id_hash, nhe, hash_alloc_intern);
+  return nhe;
+}
+
+/* The nexthop group a route forwards over, as the kernel code installs
+ * it.  Returns a reference, or NULL if the route has no nexthops to
+ * install. */
+struct nhg_hash_entry *
+zebra_nhg_rib_find (struct rib *rib, afi_t afi)
+{
+  struct nexthop *nexthop, *tnexthop;
+  struct nexthop *copy = NULL;
+  int recursing;
+  u_char nexthop_num = 0;
+
+  if (CHECK_FLAG (rib->flags, ZEBRA_FLAG_BLACKHOLE)
+      || CHECK_FLAG (rib->flags, ZEBRA_FLAG_REJECT))
+    return NULL;
+
+  for (ALL_NEXTHOPS_RO(rib->nexthop, nexthop, tnexthop, recursing))
+    {
+      if (CHECK_FLAG (nexthop->flags, NEXTHOP_FLAG_RECURSIVE)
+          || !CHECK_FLAG (nexthop->flags, NEXTHOP_FLAG_ACTIVE))
+        continue;
+      if (nexthop_num >= MULTIPATH_NUM)
+        break;
+
+      nexthop_add (&copy, nhg_nexthop_copy (nexthop));
+      nexthop_num++;
+    }
+
+  if (!copy)
+    return NULL;
+
+  return nhg_find (afi, rib->vrf_id, copy, nexthop_num);
+}
+
+static int
+nhg_kernel_update (struct nhg_hash_entry *nhe, int install)
+{
+  if (install)
+    nhg_installs++;
+  else
+    nhg_deletes++;
+
+  if (zebra_dplane_active ())
+    return dplane_nhg_update (nhe, install);
+  return kernel_nhg_update (nhe, install);
+}
+
+static int
+nhg_install (struct nhg_hash_entry *nhe)
+{
+  int i;
+
+  if (CHECK_FLAG (nhe->flags, NHG_FLAG_INSTALLED))
+    return 0;
+
+  if (nhe->depends)
+    for (i = 0; i < nhe->nexthop_num; i++)
+      if (nhg_install (nhe->depends[i]) < 0)
+        return -1;
+
+  if (nhg_kernel_update (nhe, 1) < 0)
+    {
+      nhg_failures++;
+      zlog_warn ("%u: Nexthop group %u install failed", nhe->vrf_id, nhe->id);
+      return -1;
+    }
+
+  SET_FLAG (nhe->flags, NHG_FLAG_INSTALLED);
+  return 0;
+}
+
+/* Drop a reference; the last one deletes the entry, and its kernel
+ * object if it has one. */
+void
+zebra_nhg_release (struct nhg_hash_entry *nhe)
+{
+  int i;
+
+  if (!nhe || --nhe->refcnt)
+    return;
+
+  hash_release (nhg_hash, nhe);
+  hash_release (nhg_id_hash, nhe);
+
+  if (CHECK_FLAG (nhe->flags, NHG_FLAG_INSTALLED))
+    nhg_kernel_update (nhe, 0);
+
+  if (nhe->depends)
+    {
+      for (i = 0; i < nhe->nexthop_num; i++)
+        zebra_nhg_release (nhe->depends[i]);
+      XFREE (MTYPE_NHG_DEPENDS, nhe->depends);
+    }
+
+  nexthops_free (nhe->nexthop);
+  XFREE (MTYPE_NHG, nhe);
+}
+
+/* Whether a route should refer to its group by id.  Installs the group
+ * in the kernel first if need be. */
+int
+zebra_nhg_kernel_use (struct nhg_hash_entry *nhe)
+{
+  if (!nhg_kernel || !nhe || !CHECK_FLAG (nhe->flags, NHG_FLAG_KERNEL_OK))
+    return 0;
+
+  return (nhg_install (nhe) == 0);
+}
+
+/* The dataplane could not install a group after all.  It is installed
+ * again for the next route that uses it. */
+void
+zebra_nhg_install_failed (u_int32_t id)
+{
+  struct nhg_hash_entry *nhe;
+
+  nhg_failures++;
+  nhe = nhg_lookup_id (id);
+  if (nhe)
+    UNSET_FLAG (nhe->flags, NHG_FLAG_INSTALLED);
+}
+
+static void
+nhg_if_down_entry (struct hash_backet *backet, void *arg)
+{
+  struct nhg_hash_entry *nhe = backet->data;
+  ifindex_t ifindex = *(ifindex_t *) arg;
+  struct nexthop *nexthop;
+
+  for (nexthop = nhe->nexthop; nexthop; nexthop = nexthop->next)
+    if (nexthop->ifindex == ifindex)
+      {
+        UNSET_FLAG (nhe->flags, NHG_FLAG_INSTALLED);
+        return;
+      }
+}
+
+/* An interface went down.  The kernel flushes the nexthop objects over
+ * it, and takes them out of the groups they are in, without telling
+ * anyone: no RTM_DELNEXTHOP is sent for these.  The entries over the
+ * interface, single nexthops and groups alike, are installed again for
+ * the next route that uses them. */
+void
+zebra_nhg_if_down (ifindex_t ifindex)
+{
+  hash_iterate (nhg_hash, nhg_if_down_entry, &ifindex);
+}
+
+int
+zebra_nhg_id_installed (u_int32_t id)
+{
+  struct nhg_hash_entry *nhe;
+
+  nhe = nhg_lookup_id (id);
+  return (nhe && CHECK_FLAG (nhe->flags, NHG_FLAG_INSTALLED));
+}
+
+/* Returns -1 if the kernel has no nexthop objects. */
+int
+zebra_nhg_kernel_set (int enable)
+{
+  /* Objects left behind by an earlier zebra could clash with ours. */
+  if (enable && !nhg_kernel_swept)
+    {
+      if (kernel_nhg_sweep () < 0)
+        return -1;
+      nhg_kernel_swept = 1;
+    }
+  nhg_kernel = enable;
+  return 0;
+}
+
+int
+zebra_nhg_kernel_get (void)
+{
+  return nhg_kernel;
+}
+
+static void
+nhg_show_entry (struct hash_backet *backet, void *arg)
+{
+  struct vty *vty = arg;
+  struct nhg_hash_entry *nhe = backet->data;
+  struct nexthop *nexthop;
+  char buf[NEXTHOP_STRLEN];
+  int i;
+
+  vty_out (vty, "ID %u, %s, VRF %u, refcnt %lu%s%s", nhe->id,
+           afi2str (nhe->afi), nhe->vrf_id, nhe->refcnt,
+           CHECK_FLAG (nhe->flags, NHG_FLAG_INSTALLED) ? ", installed" : "",
+           VTY_NEWLINE);
+
+  if (nhe->depends)
+    {
+      vty_out (vty, "  Members:");
+      for (i = 0; i < nhe->nexthop_num; i++)
+        vty_out (vty, " %u", nhe->depends[i]->id);
+      vty_out (vty, "%s", VTY_NEWLINE);
+    }
+  else
+    for (nexthop = nhe->nexthop; nexthop; nexthop = nexthop->next)
+      vty_out (vty, "  %s%s", nexthop2str (nexthop, buf, sizeof (buf)),
+               VTY_NEWLINE);
+}
+
+DEFUN (show_zebra_nexthop_group,
+       show_zebra_nexthop_group_cmd,
+       "show zebra nexthop-group",
+       SHOW_STR
+       "Zebra information\n"
+       "Nexthop groups shared by routes\n")
+{
+  vty_out (vty, "Kernel nexthop objects are %s%s",
+           nhg_kernel ? "in use" : "not in use", VTY_NEWLINE);
+  vty_out (vty, "%-30s %10lu%s", "Nexthop groups", nhg_hash->count,
+           VTY_NEWLINE);
+  vty_out (vty, "%-30s %10lu%s", "Kernel installs", nhg_installs,
+           VTY_NEWLINE);
+  vty_out (vty, "%-30s %10lu%s", "Kernel deletes", nhg_deletes,
+           VTY_NEWLINE);
+  vty_out (vty, "%-30s %10lu%s", "Kernel install failures", nhg_failures,
+           VTY_NEWLINE);
+  vty_out (vty, "%s", VTY_NEWLINE);
+
+  hash_iterate (nhg_id_hash, nhg_show_entry, vty);
+
+  return CMD_SUCCESS;
+}
+
+void
+zebra_nhg_init (void)
+{
+  nhg_hash = hash_create_size (8192, nhg_hash_key, nhg_hash_cmp);
+  nhg_id_hash = hash_create_size (8192, nhg_id_key, nhg_id_cmp);
+
+  install_element (VIEW_NODE, &show_zebra_nexthop_group_cmd);
+}
@@ -0,0 +1,66 @@
+/*
+ * Zebra shared nexthop groups
+ *
+ * This file is part of GNU Zebra.
+ *
+ * GNU Zebra is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * GNU Zebra is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Zebra; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#ifndef _ZEBRA_NHG_H
+#define _ZEBRA_NHG_H
+
+#include "nexthop.h"
+#include "vrf.h"
+#include "zebra/rib.h"
+
+/*
+ * The set of nexthops a route is forwarded over, as installed in the
+ * FIB: the active nexthops, with recursive ones replaced by what they
+ * resolve to.  Routes forwarding the same way share one entry, which
+ * can be installed in the kernel once and referred to by its id.
+ */
+struct nhg_hash_entry
+{
+  u_int32_t id;
+  afi_t afi;
+  vrf_id_t vrf_id;
+
+  /* Flattened copy of the forwarding nexthops. */
+  struct nexthop *nexthop;
+  u_char nexthop_num;
+
+  /* For a multipath group, the single nexthop entries it is made of. */
+  struct nhg_hash_entry **depends;
+
+  /* Routes and groups using this entry. */
+  unsigned long refcnt;
+
+  u_char flags;
+#define NHG_FLAG_KERNEL_OK   0x1   /* Can be installed as a kernel object */
+#define NHG_FLAG_INSTALLED   0x2   /* Installed in the kernel */
+};
+
+extern void zebra_nhg_init (void);
+extern struct nhg_hash_entry *zebra_nhg_rib_find (struct rib *rib, afi_t afi);
+extern void zebra_nhg_release (struct nhg_hash_entry *nhe);
+extern int zebra_nhg_kernel_use (struct nhg_hash_entry *nhe);
+extern void zebra_nhg_install_failed (u_int32_t id);
+extern void zebra_nhg_if_down (ifindex_t ifindex);
+extern int zebra_nhg_kernel_set (int enable);
+extern int zebra_nhg_kernel_get (void);
+extern int zebra_nhg_id_installed (u_int32_t id);
+
+#endif /* _ZEBRA_NHG_H */
@@ -26,6 +26,8 @@
 #include <lib/ns.h>
 
 #ifdef HAVE_NETLINK
+struct nl_batch;
+
 /* Socket interface to kernel */
 struct nlsock
 {
@@ -33,6 +35,7 @@ struct nlsock
   int seq;
   struct sockaddr_nl snl;
   char name[64];
+  struct nl_batch *batch;    /* route update batching, see kernel_netlink.c */
 };
 #endif
 
@@ -47,6 +50,7 @@ struct zebra_ns
 #ifdef HAVE_NETLINK
   struct nlsock netlink;     /* kernel messages */
   struct nlsock netlink_cmd; /* command channel */
+  struct nlsock netlink_dplane; /* route updates from the dataplane thread */
   struct thread *t_netlink;
 #endif
 
@@ -47,6 +47,8 @@
 #include "zebra/zebra_routemap.h"
 #include "zebra/debug.h"
 #include "zebra/zebra_fpm.h"
+#include "zebra/zebra_dplane.h"
+#include "zebra/zebra_nhg.h"
 #include "zebra/zebra_rnh.h"
 #include "zebra/interface.h"
 #include "zebra/connected.h"
@@ -1207,6 +1209,14 @@ nexthop_active_update (struct route_node *rn, struct rib *rib, int set)
 }
 
 
+/* Drop the entry's reference to its shared nexthop group. */
+static void
+rib_nhg_release (struct rib *rib)
+{
+  zebra_nhg_release (rib->nhe);
+  rib->nhe = NULL;
+  UNSET_FLAG (rib->status, RIB_ENTRY_NHG_KERNEL);
+}
 
 /* Update flag indicates whether this is a "replace" or not. Currently, this
  * is only used for IPv4.
@@ -1215,6 +1225,7 @@ int
 rib_install_kernel (struct route_node *rn, struct rib *rib, struct rib *old)
 {
   int ret = 0;
+  struct nhg_hash_entry *nhe;
   struct nexthop *nexthop, *tnexthop;
   rib_table_info_t *info = rn->table->info;
   int recursing;
@@ -1226,14 +1237,31 @@ rib_install_kernel (struct route_node *rn, struct rib *rib, struct rib *old)
       return ret;
     }
 
+  /* Take the shared group of the nexthops installed now, and let go
+   * of the one installed before once the update has gone out. */
+  nhe = rib->nhe;
+  rib->nhe = zebra_nhg_rib_find (rib, family2afi (rn->p.family));
+  if (zebra_nhg_kernel_use (rib->nhe))
+    SET_FLAG (rib->status, RIB_ENTRY_NHG_KERNEL);
+  else
+    UNSET_FLAG (rib->status, RIB_ENTRY_NHG_KERNEL);
+
   /*
    * Make sure we update the FPM any time we send new information to
    * the kernel.
    */
   zfpm_trigger_update (rn, "installing in kernel");
-  ret = kernel_route_rib (&rn->p, old, rib);
+  if (zebra_dplane_active ())
+    ret = dplane_route_update (rn, old, rib);
+  else
+    ret = kernel_route_rib (&rn->p, old, rib);
+
+  zebra_nhg_release (nhe);
+  if (old && old != rib)
+    rib_nhg_release (old);
 
-  /* If install succeeds, update FIB flag for nexthops. */
+  /* If install succeeds, update FIB flag for nexthops.  The dataplane
+   * takes them back if it fails later. */
   if (!ret)
     {
       for (ALL_NEXTHOPS_RO(rib->nexthop, nexthop, tnexthop, recursing))
@@ -1251,6 +1279,48 @@ rib_install_kernel (struct route_node *rn, struct rib *rib, struct rib *old)
   return ret;
 }
 
+/* The dataplane failed an install that rib_install_kernel() had already
+ * reported as successful.  Find the entry it was for, unless it has been
+ * replaced or reinstalled since, and take back its FIB flags.
+ */
+void
+rib_install_kernel_failed (struct prefix *p, vrf_id_t vrf_id,
+                           u_int32_t table_id, u_int32_t seq)
+{
+  struct route_table *table;
+  struct route_node *rn;
+  struct rib *rib;
+  struct nexthop *nexthop, *tnexthop;
+  int recursing;
+  char buf[PREFIX_STRLEN];
+
+  table = zebra_vrf_table_with_table_id (family2afi (p->family), SAFI_UNICAST,
+                                         vrf_id, table_id);
+  if (!table)
+    return;
+
+  rn = route_node_lookup (table, p);
+  if (!rn)
+    return;
+
+  RNODE_FOREACH_RIB (rn, rib)
+    if (rib->fib_seq == seq)
+      break;
+
+  if (rib)
+    {
+      rib->fib_seq = 0;
+      for (ALL_NEXTHOPS_RO(rib->nexthop, nexthop, tnexthop, recursing))
+        UNSET_FLAG (nexthop->flags, NEXTHOP_FLAG_FIB);
+
+      zfpm_trigger_update (rn, "kernel install failed");
+      zlog_warn ("%u:%s: Route install failed", vrf_id,
+                 prefix2str (p, buf, sizeof buf));
+    }
+
+  route_unlock_node (rn);
+}
+
 /* Uninstall the route from kernel. */
 int
 rib_uninstall_kernel (struct route_node *rn, struct rib *rib)
@@ -1272,7 +1342,11 @@ rib_uninstall_kernel (struct route_node *rn, struct rib *rib)
    * the kernel.
    */
   zfpm_trigger_update (rn, "uninstalling from kernel");
-  ret = kernel_route_rib (&rn->p, rib, NULL);
+  if (zebra_dplane_active ())
+    ret = dplane_route_update (rn, rib, NULL);
+  else
+    ret = kernel_route_rib (&rn->p, rib, NULL);
+  rib_nhg_release (rib);
 
   for (ALL_NEXTHOPS_RO(rib->nexthop, nexthop, tnexthop, recursing))
     UNSET_FLAG (nexthop->flags, NEXTHOP_FLAG_FIB);
@@ -1633,6 +1707,9 @@ rib_process (struct route_node *rn)
   if (IS_ZEBRA_DEBUG_RIB_DETAILED)
     zlog_debug ("%u:%s/%d: Processing rn %p", vrf_id, buf, rn->p.prefixlen, rn);
 
+  if (zvrf)
+    zebra_rnh_route_changed (vrf_id, rn);
+
   RNODE_FOREACH_RIB_SAFE (rn, rib, next)
     {
       if (IS_ZEBRA_DEBUG_RIB_DETAILED)
@@ -2052,9 +2129,8 @@ meta_queue_process_complete (struct work_queue *dummy)
   struct vrf *vrf;
   struct zebra_vrf *zvrf;
 
-  /* Evaluate nexthops for those VRFs which underwent route processing. This
-   * should limit the evaluation to the necessary VRFs in most common
-   * situations.
+  /* Evaluate nexthops for those VRFs which underwent route processing,
+   * only those which the processed routes may resolve differently.
    */
   RB_FOREACH (vrf, vrf_id_head, &vrfs_by_id)
     {
@@ -2063,10 +2139,7 @@ meta_queue_process_complete (struct work_queue *dummy)
 	continue;
 
       zvrf->flags &= ~ZEBRA_VRF_RIB_SCHEDULED;
-      zebra_evaluate_rnh(zvrf_id (zvrf), AF_INET, 0, RNH_NEXTHOP_TYPE, NULL);
-      zebra_evaluate_rnh(zvrf_id (zvrf), AF_INET, 0, RNH_IMPORT_CHECK_TYPE, NULL);
-      zebra_evaluate_rnh(zvrf_id (zvrf), AF_INET6, 0, RNH_NEXTHOP_TYPE, NULL);
-      zebra_evaluate_rnh(zvrf_id (zvrf), AF_INET6, 0, RNH_IMPORT_CHECK_TYPE, NULL);
+      zebra_evaluate_rnh_changed (zvrf_id (zvrf));
     }
 
   /* Schedule LSPs for processing, if needed. */
@@ -2383,6 +2456,7 @@ rib_unlink (struct route_node *rn, struct rib *rib)
 
   /* free RIB and nexthops */
   zebra_deregister_rnh_static_nexthops (rib->vrf_id, rib->nexthop, rn);
+  rib_nhg_release (rib);
   nexthops_free(rib->nexthop);
   XFREE (MTYPE_RIB, rib);
 
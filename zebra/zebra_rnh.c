@@ -70,6 +70,16 @@ static void print_rnh(struct route_node *rn, struct vty *vty);
 int zebra_rnh_ip_default_route = 0;
 int zebra_rnh_ipv6_default_route = 0;
 
+/* Evaluation counters, for "show zebra nht stats" */
+static struct
+{
+  unsigned long walks;		/* whole tables evaluated */
+  unsigned long routes;		/* route changes looked up */
+  unsigned long runs;		/* evaluations after RIB processing */
+  unsigned long evaluated;	/* entries evaluated by them */
+  unsigned long skipped;	/* entries they left alone */
+} rnh_stats;
+
 static inline struct route_table *get_rnh_table(vrf_id_t vrfid, int family,
 						rnh_type_t type)
 {
@@ -127,6 +137,8 @@ zebra_add_rnh (struct prefix *p, vrf_id_t vrfid, rnh_type_t type)
 
   if (!rn->info)
     {
+      struct zebra_vrf *zvrf = zebra_vrf_lookup_by_id (vrfid);
+
       rnh = XCALLOC(MTYPE_RNH, sizeof(struct rnh));
       rnh->client_list = list_new();
       rnh->vrf_id = vrfid;
@@ -134,6 +146,7 @@ zebra_add_rnh (struct prefix *p, vrf_id_t vrfid, rnh_type_t type)
       route_lock_node (rn);
       rn->info = rnh;
       rnh->node = rn;
+      zvrf->rnh_count++;
     }
 
   route_unlock_node (rn);
@@ -165,6 +178,10 @@ zebra_lookup_rnh (struct prefix *p, vrf_id_t vrfid, rnh_type_t type)
 void
 zebra_free_rnh (struct rnh *rnh)
 {
+  struct zebra_vrf *zvrf = zebra_vrf_lookup_by_id (rnh->vrf_id);
+
+  if (zvrf)
+    zvrf->rnh_count--;
   rnh->flags |= ZEBRA_NHT_DELETED;
   list_free (rnh->client_list);
   list_free (rnh->zebra_static_route_list);
@@ -719,6 +736,7 @@ zebra_evaluate_rnh (vrf_id_t vrfid, int family, int force, rnh_type_t type,
   else
     {
       /* Evaluate entire table. */
+      rnh_stats.walks++;
       nrn = route_top (rnh_table);
       while (nrn)
         {
@@ -729,6 +747,112 @@ zebra_evaluate_rnh (vrf_id_t vrfid, int family, int force, rnh_type_t type,
     }
 }
 
+/* Queue the entries of a tracking table whose resolution a change to the
+ * route for p may affect: those whose longest match may now be, or have
+ * been, p.  Entries resolved over a more specific route are not.
+ */
+static void
+zebra_rnh_mark_changed (struct zebra_vrf *zvrf, struct route_table *table,
+                        struct prefix *p)
+{
+  struct route_node *nrn;
+  struct rnh *rnh;
+
+  nrn = route_node_lookup (table, p);
+  if (!nrn)
+    nrn = route_table_get_next (table, p);
+
+  while (nrn && prefix_match (p, &nrn->p))
+    {
+      rnh = nrn->info;
+      if (rnh && !(rnh->flags & ZEBRA_NHT_PENDING)
+          && !(rnh->state && rnh->resolved_route.prefixlen > p->prefixlen))
+        {
+          rnh->flags |= ZEBRA_NHT_PENDING;
+          listnode_add (zvrf->rnh_changed, route_lock_node (nrn));
+        }
+      nrn = route_next (nrn);
+    }
+
+  if (nrn)
+    route_unlock_node (nrn);
+}
+
+/* The route for a node of a VRF's unicast table is being processed;
+ * queue the tracked entries it may resolve for zebra_evaluate_rnh_changed.
+ */
+void
+zebra_rnh_route_changed (vrf_id_t vrfid, struct route_node *rn)
+{
+  struct zebra_vrf *zvrf;
+  afi_t afi;
+
+  zvrf = zebra_vrf_lookup_by_id (vrfid);
+  afi = family2afi (rn->p.family);
+  if (!zvrf || !afi || rn->table != zvrf->table[afi][SAFI_UNICAST])
+    return;
+
+  rnh_stats.routes++;
+  zebra_rnh_mark_changed (zvrf, zvrf->rnh_table[afi], &rn->p);
+  zebra_rnh_mark_changed (zvrf, zvrf->import_check_table[afi], &rn->p);
+}
+
+/* Evaluate the tracked entries of a VRF queued by route changes. */
+void
+zebra_evaluate_rnh_changed (vrf_id_t vrfid)
+{
+  struct zebra_vrf *zvrf;
+  struct listnode *node;
+  struct route_node *nrn;
+  struct rnh *rnh;
+  rnh_type_t type;
+  u_int32_t evaluated = 0;
+
+  zvrf = zebra_vrf_lookup_by_id (vrfid);
+  if (!zvrf)
+    return;
+
+  while ((node = listhead (zvrf->rnh_changed)) != NULL)
+    {
+      nrn = listgetdata (node);
+      list_delete_node (zvrf->rnh_changed, node);
+
+      /* The entry may have gone, or been replaced, since it was queued. */
+      rnh = nrn->info;
+      if (rnh && (rnh->flags & ZEBRA_NHT_PENDING))
+        {
+          rnh->flags &= ~ZEBRA_NHT_PENDING;
+          if (nrn->table == zvrf->import_check_table[family2afi (nrn->p.family)])
+            type = RNH_IMPORT_CHECK_TYPE;
+          else
+            type = RNH_NEXTHOP_TYPE;
+          zebra_rnh_evaluate_entry (vrfid, nrn->p.family, 0, type, nrn);
+          evaluated++;
+        }
+      route_unlock_node (nrn);
+    }
+
+  rnh_stats.runs++;
+  rnh_stats.evaluated += evaluated;
+  if (zvrf->rnh_count > evaluated)
+    rnh_stats.skipped += zvrf->rnh_count - evaluated;
+}
+
+void
+zebra_print_rnh_stats (struct vty *vty)
+{
+  vty_out (vty, "%-30s %10lu%s", "Full table evaluations",
+           rnh_stats.walks, VTY_NEWLINE);
+  vty_out (vty, "%-30s %10lu%s", "Route changes", rnh_stats.routes,
+           VTY_NEWLINE);
+  vty_out (vty, "%-30s %10lu%s", "Evaluations after changes",
+           rnh_stats.runs, VTY_NEWLINE);
+  vty_out (vty, "%-30s %10lu%s", "Entries evaluated", rnh_stats.evaluated,
+           VTY_NEWLINE);
+  vty_out (vty, "%-30s %10lu%s", "Entries skipped", rnh_stats.skipped,
+           VTY_NEWLINE);
+}
+
 void
 zebra_print_rnh_table (vrf_id_t vrfid, int af, struct vty *vty, rnh_type_t type)
 {
@@ -923,8 +1047,7 @@ send_client (struct rnh *rnh, struct zserv *client, rnh_type_t type, vrf_id_t vr
   stream_putw_at (s, 0, stream_get_endp (s));
 
   client->nh_last_upd_time = monotime(NULL);
-  client->last_write_cmd = cmd;
-  return zebra_server_send_message(client);
+  return zebra_server_send_nexthop_update(client);
 }
 
 static void
@@ -34,6 +34,7 @@ struct rnh
 #define ZEBRA_NHT_CONNECTED  	0x1
 #define ZEBRA_NHT_DELETED       0x2
 #define ZEBRA_NHT_EXACT_MATCH   0x4
+#define ZEBRA_NHT_PENDING       0x8	/* on the VRF's rnh_changed list */
 
   /* VRF identifier. */
   vrf_id_t vrf_id;
@@ -71,7 +72,10 @@ extern void zebra_remove_rnh_client(struct rnh *rnh, struct zserv *client,
 				    rnh_type_t type);
 extern void zebra_evaluate_rnh(vrf_id_t vrfid, int family, int force, rnh_type_t type,
 			      struct prefix *p);
+extern void zebra_rnh_route_changed (vrf_id_t vrfid, struct route_node *rn);
+extern void zebra_evaluate_rnh_changed (vrf_id_t vrfid);
 extern void zebra_print_rnh_table(vrf_id_t vrfid, int family, struct vty *vty, rnh_type_t);
+extern void zebra_print_rnh_stats (struct vty *vty);
 extern char *rnh_str(struct rnh *rnh, char *buf, int size);
 extern int zebra_cleanup_rnh_client(vrf_id_t vrf, int family, struct zserv *client,
 				    rnh_type_t type);
@@ -35,10 +35,19 @@ void zebra_evaluate_rnh (vrf_id_t vrfid, int family, int force, rnh_type_t type,
 		        struct prefix *p)
 {}
 
+void zebra_rnh_route_changed (vrf_id_t vrfid, struct route_node *rn)
+{}
+
+void zebra_evaluate_rnh_changed (vrf_id_t vrfid)
+{}
+
 void zebra_print_rnh_table (vrf_id_t vrfid, int family, struct vty *vty,
 			    rnh_type_t type)
 {}
 
+void zebra_print_rnh_stats (struct vty *vty)
+{}
+
 void zebra_register_rnh_static_nh(vrf_id_t vrfid, struct prefix *p, struct route_node *rn)
 {}
 
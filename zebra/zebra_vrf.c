@@ -269,6 +269,15 @@ zebra_vrf_delete (struct vrf *vrf)
     }
 
   /* release allocated memory */
+  while (!list_isempty (zvrf->rnh_changed))
+    {
+      struct route_node *rnode = listgetdata (listhead (zvrf->rnh_changed));
+
+      list_delete_node (zvrf->rnh_changed, listhead (zvrf->rnh_changed));
+      route_unlock_node (rnode);
+    }
+  list_free (zvrf->rnh_changed);
+
   for (afi = AFI_IP; afi <= AFI_IP6; afi++)
     {
       void *table_info;
@@ -398,6 +407,8 @@ zebra_vrf_table_create (struct zebra_vrf *zvrf, afi_t afi, safi_t safi)
   assert (!zvrf->table[afi][safi]);
 
   table = route_table_init_with_delegate (&zebra_rtable_delegate);
+  /* Nexthop resolution matches in here all the time. */
+  route_table_enable_lpm (table, afi2family (afi));
   zvrf->table[afi][safi] = table;
 
   info = XCALLOC (MTYPE_RIB_TABLE_INFO, sizeof (*info));
@@ -431,6 +442,7 @@ zebra_vrf_alloc (void)
       zvrf->import_check_table[afi] =
 	route_table_init_with_delegate (&zebra_rnhtable_delegate);
     }
+  zvrf->rnh_changed = list_new ();
 
   zebra_mpls_init_tables (zvrf);
 
@@ -56,6 +56,12 @@ struct zebra_vrf
   /* Import check table (used mostly by BGP */
   struct route_table *import_check_table[AFI_MAX];
 
+  /* Number of entries in the two tables above, and their nodes to
+   * evaluate after the RIB is processed (locked).
+   */
+  u_int32_t rnh_count;
+  struct list *rnh_changed;
+
   /* Routing tables off of main table for redistribute table */
   struct route_table *other_table[AFI_MAX][ZEBRA_KERNEL_TABLE_MAX];
 
@@ -40,6 +40,9 @@
 #include "zebra/redistribute.h"
 #include "zebra/zebra_routemap.h"
 #include "zebra/zebra_static.h"
+#include "zebra/rt.h"
+#include "zebra/zebra_dplane.h"
+#include "zebra/zebra_nhg.h"
 #include "lib/json.h"
 
 extern int allow_delete;
@@ -1255,6 +1258,18 @@ DEFUN (show_ipv6_nht_vrf_all,
   return CMD_SUCCESS;
 }
 
+DEFUN (show_zebra_nht_stats,
+       show_zebra_nht_stats_cmd,
+       "show zebra nht stats",
+       SHOW_STR
+       "Zebra information\n"
+       "Nexthop tracking\n"
+       "Statistics\n")
+{
+  zebra_print_rnh_stats (vty);
+  return CMD_SUCCESS;
+}
+
 DEFUN (ip_nht_default_route,
        ip_nht_default_route_cmd,
        "ip nht resolve-via-default",
@@ -3672,6 +3687,79 @@ DEFUN (no_allow_external_route_update,
   return CMD_SUCCESS;
 }
 
+#ifdef HAVE_NETLINK
+DEFUN (netlink_batch,
+       netlink_batch_cmd,
+       "netlink batch",
+       "Kernel netlink interface\n"
+       "Send route updates to the kernel in batches\n")
+{
+  /* Only the dataplane thread sends route updates in batches. */
+  if (!zebra_dplane_kernel ())
+    {
+      vty_out (vty, "%% Batching needs the kernel dataplane thread, "
+               "which is not running%s", VTY_NEWLINE);
+      return CMD_WARNING;
+    }
+  kernel_route_batch_set (1);
+
+  return CMD_SUCCESS;
+}
+
+DEFUN (no_netlink_batch,
+       no_netlink_batch_cmd,
+       "no netlink batch",
+       NO_STR
+       "Kernel netlink interface\n"
+       "Send route updates to the kernel in batches\n")
+{
+  kernel_route_batch_set (0);
+
+  return CMD_SUCCESS;
+}
+
+DEFUN (netlink_nexthop_group,
+       netlink_nexthop_group_cmd,
+       "netlink nexthop-group",
+       "Kernel netlink interface\n"
+       "Install nexthop groups as kernel nexthop objects\n")
+{
+  if (zebra_nhg_kernel_set (1) < 0)
+    {
+      vty_out (vty, "%% Kernel does not support nexthop objects%s",
+               VTY_NEWLINE);
+      return CMD_WARNING;
+    }
+
+  return CMD_SUCCESS;
+}
+
+DEFUN (no_netlink_nexthop_group,
+       no_netlink_nexthop_group_cmd,
+       "no netlink nexthop-group",
+       NO_STR
+       "Kernel netlink interface\n"
+       "Install nexthop groups as kernel nexthop objects\n")
+{
+  zebra_nhg_kernel_set (0);
+
+  return CMD_SUCCESS;
+}
+
+DEFUN (show_zebra_netlink_batch,
+       show_zebra_netlink_batch_cmd,
+       "show zebra netlink batch",
+       SHOW_STR
+       "Zebra information\n"
+       "Kernel netlink interface\n"
+       "Route update batching\n")
+{
+  kernel_route_batch_show (vty);
+
+  return CMD_SUCCESS;
+}
+#endif /* HAVE_NETLINK */
+
 /* show vrf */
 DEFUN (show_vrf,
        show_vrf_cmd,
@@ -3793,6 +3881,13 @@ config_write_protocol (struct vty *vty)
   if (allow_delete)
     vty_out(vty, "allow-external-route-update%s", VTY_NEWLINE);
 
+#ifdef HAVE_NETLINK
+  if (kernel_route_batch_get ())
+    vty_out(vty, "netlink batch%s", VTY_NEWLINE);
+  if (zebra_nhg_kernel_get ())
+    vty_out(vty, "netlink nexthop-group%s", VTY_NEWLINE);
+#endif
+
   if (zebra_rnh_ip_default_route)
     vty_out(vty, "ip nht resolve-via-default%s", VTY_NEWLINE);
 
@@ -3828,6 +3923,13 @@ zebra_vty_init (void)
 
   install_element (CONFIG_NODE, &allow_external_route_update_cmd);
   install_element (CONFIG_NODE, &no_allow_external_route_update_cmd);
+#ifdef HAVE_NETLINK
+  install_element (CONFIG_NODE, &netlink_batch_cmd);
+  install_element (CONFIG_NODE, &no_netlink_batch_cmd);
+  install_element (VIEW_NODE, &show_zebra_netlink_batch_cmd);
+  install_element (CONFIG_NODE, &netlink_nexthop_group_cmd);
+  install_element (CONFIG_NODE, &no_netlink_nexthop_group_cmd);
+#endif
   install_element (CONFIG_NODE, &ip_mroute_dist_cmd);
   install_element (CONFIG_NODE, &no_ip_mroute_dist_cmd);
   install_element (CONFIG_NODE, &ip_multicast_mode_cmd);
@@ -3849,6 +3951,7 @@ zebra_vty_init (void)
   install_element (VIEW_NODE, &show_ip_nht_vrf_all_cmd);
   install_element (VIEW_NODE, &show_ipv6_nht_cmd);
   install_element (VIEW_NODE, &show_ipv6_nht_vrf_all_cmd);
+  install_element (VIEW_NODE, &show_zebra_nht_stats_cmd);
   install_element (VIEW_NODE, &show_ip_route_addr_cmd);
   install_element (VIEW_NODE, &show_ip_route_prefix_cmd);
   install_element (VIEW_NODE, &show_ip_route_prefix_longer_cmd);
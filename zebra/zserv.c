@@ -64,6 +64,7 @@ static void zebra_event (enum event event, int sock, struct zserv *client);
 extern struct zebra_privs_t zserv_privs;
 
 static void zebra_client_close (struct zserv *client);
+static void zserv_nhbuf_put (struct zserv *client);
 
 static int
 zserv_delayed_close(struct thread *thread)
@@ -86,6 +87,7 @@ zserv_flush_data(struct thread *thread)
       zebra_client_close(client);
       return -1;
     }
+  zserv_nhbuf_put(client);
   switch (buffer_flush_available(client->wb, client->sock))
     {
     case BUFFER_ERROR:
@@ -111,6 +113,7 @@ zebra_server_send_message(struct zserv *client)
   if (client->t_suicide)
     return -1;
 
+  zserv_nhbuf_put(client);
   stream_set_getp(client->obuf, 0);
   client->last_write_cmd = stream_getw_from(client->obuf, 6);
   switch (buffer_write(client->wb, client->sock, STREAM_DATA(client->obuf),
@@ -139,6 +142,60 @@ zebra_server_send_message(struct zserv *client)
   return 0;
 }
 
+/*
+ * Nexthop tracking updates come in bursts: when a client registers many
+ * nexthops at once, and when a route change moves many of them.  Updates
+ * of the same kind for the same VRF are merged into one message, which
+ * carries one entry after the other, in client->nhbuf.  It is put in the
+ * write buffer when an update of another kind comes along, when it is
+ * full, before anything else is sent, and at the latest once we are back
+ * in the event loop and zserv_flush_data() runs.
+ */
+
+/* Move the nexthop updates being merged to the write buffer. */
+static void
+zserv_nhbuf_put (struct zserv *client)
+{
+  struct stream *b = client->nhbuf;
+
+  if (!stream_get_endp(b))
+    return;
+  buffer_put(client->wb, STREAM_DATA(b), stream_get_endp(b));
+  stream_reset(b);
+}
+
+/* Send the nexthop tracking update in client->obuf, merging it with the
+   updates before it if it can be. */
+int
+zebra_server_send_nexthop_update (struct zserv *client)
+{
+  struct stream *s = client->obuf;
+  struct stream *b = client->nhbuf;
+  size_t len = stream_get_endp(s);
+
+  if (client->t_suicide)
+    return -1;
+
+  /* Same marker, version, VRF and command: add the entry. */
+  if (stream_get_endp(b)
+      && STREAM_WRITEABLE(b) >= len - ZEBRA_HEADER_SIZE
+      && !memcmp(STREAM_DATA(b) + 2, STREAM_DATA(s) + 2,
+                 ZEBRA_HEADER_SIZE - 2))
+    {
+      stream_put(b, STREAM_DATA(s) + ZEBRA_HEADER_SIZE,
+                 len - ZEBRA_HEADER_SIZE);
+      stream_putw_at(b, 0, stream_get_endp(b));
+      return 0;
+    }
+
+  zserv_nhbuf_put(client);
+  stream_put(b, STREAM_DATA(s), len);
+  client->last_write_cmd = stream_getw_from(s, 6);
+  THREAD_WRITE_ON(zebrad.master, client->t_write,
+                  zserv_flush_data, client, client->sock);
+  return 0;
+}
+
 void
 zserv_create_header (struct stream *s, uint16_t cmd, vrf_id_t vrf_id)
 {
@@ -1049,13 +1106,112 @@ zserv_nexthop_num_warn (const char *caller, const struct prefix *p, const unsign
     }
 }
 
+/*
+ * Bulk route messages (ZEBRA_IPV{4,6}_ROUTE_BULK_{ADD,DELETE}) are laid
+ * out as the single route ones, except that the prefix is left out of
+ * its place and a count of prefixes followed by the prefixes comes after
+ * everything else.  The shared part is parsed once, then each prefix is
+ * added or deleted with it.
+ */
+
+/* Read the next prefix of a bulk message. */
+static int
+zread_bulk_prefix (struct stream *s, afi_t afi, struct prefix *p)
+{
+  memset (p, 0, sizeof (struct prefix));
+  p->family = afi2family (afi);
+
+  if (STREAM_READABLE (s) < 1)
+    return -1;
+  p->prefixlen = stream_getc (s);
+  if (p->prefixlen > prefix_blen (p) * 8
+      || STREAM_READABLE (s) < (size_t) PSIZE (p->prefixlen))
+    return -1;
+  stream_get (&p->u.prefix, s, PSIZE (p->prefixlen));
+  return 0;
+}
+
+/* A copy of the rib read from a bulk message, for one of its prefixes. */
+static struct rib *
+zserv_rib_dup (struct rib *rib)
+{
+  struct rib *new;
+  struct nexthop *nexthop;
+
+  new = XCALLOC (MTYPE_RIB, sizeof (struct rib));
+  new->type = rib->type;
+  new->instance = rib->instance;
+  new->flags = rib->flags;
+  new->uptime = rib->uptime;
+  new->distance = rib->distance;
+  new->metric = rib->metric;
+  new->tag = rib->tag;
+  new->mtu = rib->mtu;
+  new->vrf_id = rib->vrf_id;
+  new->table = rib->table;
+
+  for (nexthop = rib->nexthop; nexthop; nexthop = nexthop->next)
+    rib_copy_nexthops (new, nexthop);
+
+  return new;
+}
+
+/* Add the rib parsed from a bulk message for each of its prefixes. */
+static void
+zread_route_add_bulk (struct zserv *client, afi_t afi, safi_t safi,
+                      struct rib *rib)
+{
+  struct stream *s = client->ibuf;
+  struct prefix p;
+  u_int16_t count, i;
+  int ret;
+
+  count = stream_getw (s);
+  for (i = 0; i < count; i++)
+    {
+      if (zread_bulk_prefix (s, afi, &p) < 0)
+        {
+          zlog_warn ("%s: malformed bulk route message from client %d",
+                     __func__, client->sock);
+          break;
+        }
+
+      /* The last prefix takes the rib itself. */
+      ret = rib_add_multipath (afi, safi, &p,
+                               i == count - 1 ? rib : zserv_rib_dup (rib));
+
+      /* Stats */
+      if (afi == AFI_IP)
+        {
+          if (ret > 0)
+            client->v4_route_add_cnt++;
+          else if (ret < 0)
+            client->v4_route_upd8_cnt++;
+        }
+      else
+        {
+          if (ret > 0)
+            client->v6_route_add_cnt++;
+          else if (ret < 0)
+            client->v6_route_upd8_cnt++;
+        }
+    }
+
+  if (i < count || count == 0)
+    {
+      nexthops_free (rib->nexthop);
+      XFREE (MTYPE_RIB, rib);
+    }
+}
+
 /* This function support multiple nexthop. */
 /* 
  * Parse the ZEBRA_IPV4_ROUTE_ADD sent from client. Update rib and
  * add kernel route. 
  */
 static int
-zread_ipv4_add (struct zserv *client, u_short length, struct zebra_vrf *zvrf)
+zread_ipv4_add (struct zserv *client, u_short length, struct zebra_vrf *zvrf,
+                int bulk)
 {
   int i;
   struct rib *rib;
@@ -1083,11 +1239,14 @@ zread_ipv4_add (struct zserv *client, u_short length, struct zebra_vrf *zvrf)
   safi = stream_getw (s);
   rib->uptime = time (NULL);
 
-  /* IPv4 prefix. */
+  /* IPv4 prefix, bulk messages have theirs at the end. */
   memset (&p, 0, sizeof (struct prefix_ipv4));
   p.family = AF_INET;
-  p.prefixlen = stream_getc (s);
-  stream_get (&p.u.prefix4, s, PSIZE (p.prefixlen));
+  if (!bulk)
+    {
+      p.prefixlen = stream_getc (s);
+      stream_get (&p.u.prefix4, s, PSIZE (p.prefixlen));
+    }
 
   /* VRF ID */
   rib->vrf_id = zvrf_id (zvrf);
@@ -1149,6 +1308,12 @@ zread_ipv4_add (struct zserv *client, u_short length, struct zebra_vrf *zvrf)
   /* Table */
   rib->table = zvrf->table_id;
 
+  if (bulk)
+    {
+      zread_route_add_bulk (client, AFI_IP, safi, rib);
+      return 0;
+    }
+
   ret = rib_add_multipath (AFI_IP, safi, &p, rib);
 
   /* Stats */
@@ -1161,7 +1326,8 @@ zread_ipv4_add (struct zserv *client, u_short length, struct zebra_vrf *zvrf)
 
 /* Zebra server IPv4 prefix delete function. */
 static int
-zread_ipv4_delete (struct zserv *client, u_short length, struct zebra_vrf *zvrf)
+zread_ipv4_delete (struct zserv *client, u_short length, struct zebra_vrf *zvrf,
+                   int bulk)
 {
   int i;
   struct stream *s;
@@ -1186,11 +1352,14 @@ zread_ipv4_delete (struct zserv *client, u_short length, struct zebra_vrf *zvrf)
   api.message = stream_getc (s);
   api.safi = stream_getw (s);
 
-  /* IPv4 prefix. */
+  /* IPv4 prefix, bulk messages have theirs at the end. */
   memset (&p, 0, sizeof (struct prefix_ipv4));
   p.family = AF_INET;
-  p.prefixlen = stream_getc (s);
-  stream_get (&p.u.prefix4, s, PSIZE (p.prefixlen));
+  if (!bulk)
+    {
+      p.prefixlen = stream_getc (s);
+      stream_get (&p.u.prefix4, s, PSIZE (p.prefixlen));
+    }
 
   /* Nexthop, ifindex, distance, metric. */
   if (CHECK_FLAG (api.message, ZAPI_MESSAGE_NEXTHOP))
@@ -1242,6 +1411,26 @@ zread_ipv4_delete (struct zserv *client, u_short length, struct zebra_vrf *zvrf)
 
   table_id = zvrf->table_id;
 
+  if (bulk)
+    {
+      u_int16_t count = stream_getw (s);
+
+      for (i = 0; i < count; i++)
+        {
+          if (zread_bulk_prefix (s, AFI_IP, &p) < 0)
+            {
+              zlog_warn ("%s: malformed bulk route message from client %d",
+                         __func__, client->sock);
+              break;
+            }
+          rib_delete (AFI_IP, api.safi, zvrf_id (zvrf), api.type,
+                      api.instance, api.flags, &p, nexthop_p, ifindex,
+                      table_id);
+          client->v4_route_del_cnt++;
+        }
+      return 0;
+    }
+
   rib_delete (AFI_IP, api.safi, zvrf_id (zvrf), api.type, api.instance,
 	      api.flags, &p, nexthop_p, ifindex, table_id);
   client->v4_route_del_cnt++;
@@ -1389,7 +1578,8 @@ zread_ipv4_route_ipv6_nexthop_add (struct zserv *client, u_short length, struct
 }
 
 static int
-zread_ipv6_add (struct zserv *client, u_short length, struct zebra_vrf *zvrf)
+zread_ipv6_add (struct zserv *client, u_short length, struct zebra_vrf *zvrf,
+                int bulk)
 {
   int i;
   struct stream *s;
@@ -1420,11 +1610,14 @@ zread_ipv6_add (struct zserv *client, u_short length, struct zebra_vrf *zvrf)
   safi = stream_getw (s);
   rib->uptime = time (NULL);
 
-  /* IPv6 prefix. */
+  /* IPv6 prefix, bulk messages have theirs at the end. */
   memset (&p, 0, sizeof (struct prefix_ipv6));
   p.family = AF_INET6;
-  p.prefixlen = stream_getc (s);
-  stream_get (&p.u.prefix6, s, PSIZE (p.prefixlen));
+  if (!bulk)
+    {
+      p.prefixlen = stream_getc (s);
+      stream_get (&p.u.prefix6, s, PSIZE (p.prefixlen));
+    }
 
   /* We need to give nh-addr, nh-ifindex with the same next-hop object
    * to the rib to ensure that IPv6 multipathing works; need to coalesce
@@ -1500,6 +1693,12 @@ zread_ipv6_add (struct zserv *client, u_short length, struct zebra_vrf *zvrf)
   rib->vrf_id = zvrf_id (zvrf);
   rib->table = zvrf->table_id;
 
+  if (bulk)
+    {
+      zread_route_add_bulk (client, AFI_IP6, safi, rib);
+      return 0;
+    }
+
   ret = rib_add_multipath (AFI_IP6, safi, &p, rib);
   /* Stats */
   if (ret > 0)
@@ -1512,7 +1711,8 @@ zread_ipv6_add (struct zserv *client, u_short length, struct zebra_vrf *zvrf)
 
 /* Zebra server IPv6 prefix delete function. */
 static int
-zread_ipv6_delete (struct zserv *client, u_short length, struct zebra_vrf *zvrf)
+zread_ipv6_delete (struct zserv *client, u_short length, struct zebra_vrf *zvrf,
+                   int bulk)
 {
   int i;
   struct stream *s;
@@ -1533,11 +1733,14 @@ zread_ipv6_delete (struct zserv *client, u_short length, struct zebra_vrf *zvrf)
   api.message = stream_getc (s);
   api.safi = stream_getw (s);
 
-  /* IPv4 prefix. */
+  /* IPv6 prefix, bulk messages have theirs at the end. */
   memset (&p, 0, sizeof (struct prefix_ipv6));
   p.family = AF_INET6;
-  p.prefixlen = stream_getc (s);
-  stream_get (&p.u.prefix6, s, PSIZE (p.prefixlen));
+  if (!bulk)
+    {
+      p.prefixlen = stream_getc (s);
+      stream_get (&p.u.prefix6, s, PSIZE (p.prefixlen));
+    }
 
   /* Nexthop, ifindex, distance, metric. */
   if (CHECK_FLAG (api.message, ZAPI_MESSAGE_NEXTHOP))
@@ -1581,11 +1784,30 @@ zread_ipv6_delete (struct zserv *client, u_short length, struct zebra_vrf *zvrf)
     api.tag = 0;
 
   if (IN6_IS_ADDR_UNSPECIFIED (&nexthop))
-    rib_delete (AFI_IP6, api.safi, zvrf_id (zvrf), api.type, api.instance,
-		api.flags, &p, NULL, ifindex, client->rtm_table);
-  else
-    rib_delete (AFI_IP6, api.safi, zvrf_id (zvrf), api.type, api.instance,
-		api.flags, &p, pnexthop, ifindex, client->rtm_table);
+    pnexthop = NULL;
+
+  if (bulk)
+    {
+      u_int16_t count = stream_getw (s);
+
+      for (i = 0; i < count; i++)
+        {
+          if (zread_bulk_prefix (s, AFI_IP6, &p) < 0)
+            {
+              zlog_warn ("%s: malformed bulk route message from client %d",
+                         __func__, client->sock);
+              break;
+            }
+          rib_delete (AFI_IP6, api.safi, zvrf_id (zvrf), api.type,
+                      api.instance, api.flags, &p, pnexthop, ifindex,
+                      client->rtm_table);
+          client->v6_route_del_cnt++;
+        }
+      return 0;
+    }
+
+  rib_delete (AFI_IP6, api.safi, zvrf_id (zvrf), api.type, api.instance,
+	      api.flags, &p, pnexthop, ifindex, client->rtm_table);
 
   client->v6_route_del_cnt++;
   return 0;
@@ -1790,6 +2012,10 @@ zebra_client_close (struct zserv *client)
     stream_free (client->ibuf);
   if (client->obuf)
     stream_free (client->obuf);
+  if (client->rbuf)
+    stream_free (client->rbuf);
+  if (client->nhbuf)
+    stream_free (client->nhbuf);
   if (client->wb)
     buffer_free(client->wb);
 
@@ -1820,6 +2046,8 @@ zebra_client_create (int sock)
   client->sock = sock;
   client->ibuf = stream_new (ZEBRA_MAX_PACKET_SIZ);
   client->obuf = stream_new (ZEBRA_MAX_PACKET_SIZ);
+  client->rbuf = stream_new (ZSERV_RBUF_SIZE);
+  client->nhbuf = stream_new (ZEBRA_MAX_PACKET_SIZ);
   client->wb = buffer_new(0);
 
   /* Set table number. */
@@ -1843,104 +2071,22 @@ zebra_client_create (int sock)
   zebra_vrf_update_all (client);
 }
 
-/* Handler of zebra service request. */
+/* Handle the message in client->ibuf, whose header has been checked.
+   Returns -1 if the client has been closed. */
 static int
-zebra_client_read (struct thread *thread)
+zebra_client_handle (struct zserv *client, int sock)
 {
-  int sock;
-  struct zserv *client;
-  size_t already;
   uint16_t length, command;
-  uint8_t marker, version;
   vrf_id_t vrf_id;
   struct zebra_vrf *zvrf;
 
-  /* Get thread data.  Reset reading thread because I'm running. */
-  sock = THREAD_FD (thread);
-  client = THREAD_ARG (thread);
-  client->t_read = NULL;
-
-  if (client->t_suicide)
-    {
-      zebra_client_close(client);
-      return -1;
-    }
-
-  /* Read length and command (if we don't have it already). */
-  if ((already = stream_get_endp(client->ibuf)) < ZEBRA_HEADER_SIZE)
-    {
-      ssize_t nbyte;
-      if (((nbyte = stream_read_try (client->ibuf, sock,
-				     ZEBRA_HEADER_SIZE-already)) == 0) ||
-	  (nbyte == -1))
-	{
-	  if (IS_ZEBRA_DEBUG_EVENT)
-	    zlog_debug ("connection closed socket [%d]", sock);
-	  zebra_client_close (client);
-	  return -1;
-	}
-      if (nbyte != (ssize_t)(ZEBRA_HEADER_SIZE-already))
-	{
-	  /* Try again later. */
-	  zebra_event (ZEBRA_READ, sock, client);
-	  return 0;
-	}
-      already = ZEBRA_HEADER_SIZE;
-    }
-
-  /* Reset to read from the beginning of the incoming packet. */
-  stream_set_getp(client->ibuf, 0);
-
   /* Fetch header values */
+  stream_set_getp (client->ibuf, 0);
   length = stream_getw (client->ibuf);
-  marker = stream_getc (client->ibuf);
-  version = stream_getc (client->ibuf);
+  stream_forward_getp (client->ibuf, 2);
   vrf_id = stream_getw (client->ibuf);
   command = stream_getw (client->ibuf);
 
-  if (marker != ZEBRA_HEADER_MARKER || version != ZSERV_VERSION)
-    {
-      zlog_err("%s: socket %d version mismatch, marker %d, version %d",
-               __func__, sock, marker, version);
-      zebra_client_close (client);
-      return -1;
-    }
-  if (length < ZEBRA_HEADER_SIZE) 
-    {
-      zlog_warn("%s: socket %d message length %u is less than header size %d",
-	        __func__, sock, length, ZEBRA_HEADER_SIZE);
-      zebra_client_close (client);
-      return -1;
-    }
-  if (length > STREAM_SIZE(client->ibuf))
-    {
-      zlog_warn("%s: socket %d message length %u exceeds buffer size %lu",
-	        __func__, sock, length, (u_long)STREAM_SIZE(client->ibuf));
-      zebra_client_close (client);
-      return -1;
-    }
-
-  /* Read rest of data. */
-  if (already < length)
-    {
-      ssize_t nbyte;
-      if (((nbyte = stream_read_try (client->ibuf, sock,
-				     length-already)) == 0) ||
-	  (nbyte == -1))
-	{
-	  if (IS_ZEBRA_DEBUG_EVENT)
-	    zlog_debug ("connection closed [%d] when reading zebra data", sock);
-	  zebra_client_close (client);
-	  return -1;
-	}
-      if (nbyte != (ssize_t)(length-already))
-        {
-	  /* Try again later. */
-	  zebra_event (ZEBRA_READ, sock, client);
-	  return 0;
-	}
-    }
-
   length -= ZEBRA_HEADER_SIZE;
 
   /* Debug packet information. */
@@ -1959,7 +2105,7 @@ zebra_client_read (struct thread *thread)
     {
       if (IS_ZEBRA_DEBUG_PACKET && IS_ZEBRA_DEBUG_RECV)
         zlog_debug ("zebra received unknown VRF[%u]", vrf_id);
-      goto zclient_read_out;
+      return 0;
     }
 
   switch (command) 
@@ -1977,25 +2123,37 @@ zebra_client_read (struct thread *thread)
       zread_interface_delete (client, length, zvrf);
       break;
     case ZEBRA_IPV4_ROUTE_ADD:
-      zread_ipv4_add (client, length, zvrf);
+      zread_ipv4_add (client, length, zvrf, 0);
       break;
     case ZEBRA_IPV4_ROUTE_DELETE:
-      zread_ipv4_delete (client, length, zvrf);
+      zread_ipv4_delete (client, length, zvrf, 0);
+      break;
+    case ZEBRA_IPV4_ROUTE_BULK_ADD:
+      zread_ipv4_add (client, length, zvrf, 1);
+      break;
+    case ZEBRA_IPV4_ROUTE_BULK_DELETE:
+      zread_ipv4_delete (client, length, zvrf, 1);
       break;
     case ZEBRA_IPV4_ROUTE_IPV6_NEXTHOP_ADD:
       zread_ipv4_route_ipv6_nexthop_add (client, length, zvrf);
       break;
     case ZEBRA_IPV4_NEXTHOP_ADD:
-      zread_ipv4_add(client, length, zvrf); /* LB: r1.0 merge - id was 1 */
+      zread_ipv4_add(client, length, zvrf, 0); /* LB: r1.0 merge - id was 1 */
       break;
     case ZEBRA_IPV4_NEXTHOP_DELETE:
-      zread_ipv4_delete(client, length, zvrf); /* LB: r1.0 merge - id was 1 */
+      zread_ipv4_delete(client, length, zvrf, 0); /* LB: r1.0 merge - id was 1 */
       break;
     case ZEBRA_IPV6_ROUTE_ADD:
-      zread_ipv6_add (client, length, zvrf);
+      zread_ipv6_add (client, length, zvrf, 0);
       break;
     case ZEBRA_IPV6_ROUTE_DELETE:
-      zread_ipv6_delete (client, length, zvrf);
+      zread_ipv6_delete (client, length, zvrf, 0);
+      break;
+    case ZEBRA_IPV6_ROUTE_BULK_ADD:
+      zread_ipv6_add (client, length, zvrf, 1);
+      break;
+    case ZEBRA_IPV6_ROUTE_BULK_DELETE:
+      zread_ipv6_delete (client, length, zvrf, 1);
       break;
     case ZEBRA_REDISTRIBUTE_ADD:
       zebra_redistribute_add (command, client, length, zvrf);
@@ -2065,9 +2223,125 @@ zebra_client_read (struct thread *thread)
       return -1;
     }
 
- zclient_read_out:
-  stream_reset (client->ibuf);
-  zebra_event (ZEBRA_READ, sock, client);
+  return 0;
+}
+
+/* Handler of zebra service request.  Reads whatever the client has sent
+   and handles each complete message in it, up to zebrad.packets_to_process
+   of them; the rest wait for the next run. */
+static int
+zebra_client_read (struct thread *thread)
+{
+  int sock;
+  struct zserv *client;
+  struct stream *rbuf;
+  u_int32_t budget;
+  size_t room;
+  ssize_t nbyte;
+  int eof = 0;
+
+  /* Get thread data.  Reset reading thread because I'm running. */
+  client = THREAD_ARG (thread);
+  client->t_read = NULL;
+  sock = client->sock;
+  rbuf = client->rbuf;
+  budget = zebrad.packets_to_process;
+
+  if (client->t_suicide)
+    {
+      zebra_client_close(client);
+      return -1;
+    }
+
+  do
+    {
+      /* Read as much as there is room for. */
+      room = STREAM_WRITEABLE (rbuf);
+      nbyte = -2;
+      if (room && !eof)
+	{
+	  nbyte = stream_read_try (rbuf, sock, room);
+	  if (nbyte == -1)
+	    {
+	      if (IS_ZEBRA_DEBUG_EVENT)
+		zlog_debug ("connection closed [%d] when reading zebra data",
+			    sock);
+	      zebra_client_close (client);
+	      return -1;
+	    }
+	  /* Handle all that was sent before the client went away. */
+	  if (nbyte == 0)
+	    {
+	      eof = 1;
+	      budget = UINT32_MAX;
+	    }
+	}
+
+      while (budget && STREAM_READABLE (rbuf) >= ZEBRA_HEADER_SIZE)
+	{
+	  size_t getp = stream_get_getp (rbuf);
+	  uint16_t length;
+	  uint8_t marker, version;
+
+	  length = stream_getw_from (rbuf, getp);
+	  marker = stream_getc_from (rbuf, getp + 2);
+	  version = stream_getc_from (rbuf, getp + 3);
+
+	  if (marker != ZEBRA_HEADER_MARKER || version != ZSERV_VERSION)
+	    {
+	      zlog_err("%s: socket %d version mismatch, marker %d, version %d",
+		       __func__, sock, marker, version);
+	      zebra_client_close (client);
+	      return -1;
+	    }
+	  if (length < ZEBRA_HEADER_SIZE)
+	    {
+	      zlog_warn("%s: socket %d message length %u is less than header size %d",
+			__func__, sock, length, ZEBRA_HEADER_SIZE);
+	      zebra_client_close (client);
+	      return -1;
+	    }
+	  if (length > STREAM_SIZE(client->ibuf))
+	    {
+	      zlog_warn("%s: socket %d message length %u exceeds buffer size %lu",
+			__func__, sock, length, (u_long)STREAM_SIZE(client->ibuf));
+	      zebra_client_close (client);
+	      return -1;
+	    }
+
+	  /* Wait for the rest of the message. */
+	  if (STREAM_READABLE (rbuf) < length)
+	    break;
+
+	  /* Handlers parse client->ibuf, give them the message alone. */
+	  stream_reset (client->ibuf);
+	  stream_put (client->ibuf, STREAM_DATA (rbuf) + getp, length);
+	  stream_forward_getp (rbuf, length);
+	  budget--;
+
+	  if (zebra_client_handle (client, sock) < 0)
+	    return -1;
+	}
+
+      stream_pulldown (rbuf);
+    }
+  /* A full buffer means there may be more waiting on the socket. */
+  while (budget && nbyte > 0 && (size_t) nbyte == room);
+
+  if (eof)
+    {
+      if (IS_ZEBRA_DEBUG_EVENT)
+	zlog_debug ("connection closed socket [%d]", sock);
+      zebra_client_close (client);
+      return -1;
+    }
+
+  /* Out of budget: come back for the rest once other work had its turn. */
+  if (!budget)
+    client->t_read = thread_add_event (zebrad.master, zebra_client_read,
+				       client, 0);
+  else
+    zebra_event (ZEBRA_READ, sock, client);
   return 0;
 }
 
@@ -2423,6 +2697,29 @@ DEFUN (no_config_table,
 }
 #endif
 
+DEFUN (zebra_zapi_packets,
+       zebra_zapi_packets_cmd,
+       "zebra zapi-packets (1-10000)",
+       "Zebra information\n"
+       "Client messages handled per read before yielding\n"
+       "Number of messages\n")
+{
+  zebrad.packets_to_process = strtoul (argv[2]->arg, NULL, 10);
+  return CMD_SUCCESS;
+}
+
+DEFUN (no_zebra_zapi_packets,
+       no_zebra_zapi_packets_cmd,
+       "no zebra zapi-packets [(1-10000)]",
+       NO_STR
+       "Zebra information\n"
+       "Client messages handled per read before yielding\n"
+       "Number of messages\n")
+{
+  zebrad.packets_to_process = ZEBRA_ZAPI_PACKETS_TO_PROCESS;
+  return CMD_SUCCESS;
+}
+
 DEFUN (ip_forwarding,
        ip_forwarding_cmd,
        "ip forwarding",
@@ -2513,6 +2810,9 @@ config_write_table (struct vty *vty)
   if (zebrad.rtm_table_default)
     vty_out (vty, "table %d%s", zebrad.rtm_table_default,
 	     VTY_NEWLINE);
+  if (zebrad.packets_to_process != ZEBRA_ZAPI_PACKETS_TO_PROCESS)
+    vty_out (vty, "zebra zapi-packets %u%s", zebrad.packets_to_process,
+	     VTY_NEWLINE);
   return 0;
 }
 
@@ -2677,6 +2977,8 @@ zebra_init (void)
   install_element (CONFIG_NODE, &no_ip_forwarding_cmd);
   install_element (ENABLE_NODE, &show_zebra_client_cmd);
   install_element (ENABLE_NODE, &show_zebra_client_summary_cmd);
+  install_element (CONFIG_NODE, &zebra_zapi_packets_cmd);
+  install_element (CONFIG_NODE, &no_zebra_zapi_packets_cmd);
 
 #ifdef HAVE_NETLINK
   install_element (VIEW_NODE, &show_table_cmd);
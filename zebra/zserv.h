@@ -49,9 +49,16 @@ struct zserv
   struct stream *ibuf;
   struct stream *obuf;
 
+  /* Data read from the client, possibly several messages at once. */
+  struct stream *rbuf;
+
   /* Buffer of data waiting to be written to client. */
   struct buffer *wb;
 
+  /* Nexthop tracking updates being merged into one message, see
+     zebra_server_send_nexthop_update(). */
+  struct stream *nhbuf;
+
   /* Threads for read/write. */
   struct thread *t_read;
   struct thread *t_write;
@@ -127,6 +134,9 @@ struct zebra_t
   /* default table */
   u_int32_t rtm_table_default;
 
+  /* Client messages handled per read before yielding */
+  u_int32_t packets_to_process;
+
   /* rib work queue */
   struct work_queue *ribq;
   struct meta_queue *mq;
@@ -136,6 +146,11 @@ struct zebra_t
 };
 extern struct zebra_t zebrad;
 
+#define ZEBRA_ZAPI_PACKETS_TO_PROCESS 1000
+
+/* Size of the buffer client messages are read into. */
+#define ZSERV_RBUF_SIZE (ZEBRA_MAX_PACKET_SIZ * 16)
+
 /* Prototypes. */
 extern void zebra_init (void);
 extern void zebra_if_init (void);
@@ -175,6 +190,7 @@ extern pid_t pid;
 extern void zserv_create_header(struct stream *s, uint16_t cmd, vrf_id_t vrf_id);
 extern void zserv_nexthop_num_warn(const char *, const struct prefix *, const unsigned int);
 extern int zebra_server_send_message(struct zserv *client);
+extern int zebra_server_send_nexthop_update(struct zserv *client);
 
 extern struct zserv *zebra_find_client (u_char proto);
 